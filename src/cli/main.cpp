@@ -39,7 +39,9 @@
 #include <hydrogen/Preferences.h>
 #include <hydrogen/h2_exception.h>
 #include <hydrogen/playlist.h>
+#include <hydrogen/helpers/drumkit_archive.h>
 #include <hydrogen/helpers/filesystem.h>
+#include <hydrogen/helpers/sound_library_index.h>
 #include <hydrogen/LocalFileMng.h>
 
 #include <iostream>
@@ -50,6 +52,9 @@ using namespace H2Core;
 
 void showInfo();
 void showUsage();
+void showSoundLibrary();
+bool installDrumkit( const QString& archivePath );
+bool exportDrumkit( const QString& drumkitName, const QString& archivePath );
 
 #define HAS_ARG 1
 static struct option long_opts[] = {
@@ -67,7 +72,12 @@ static struct option long_opts[] = {
 	{"verbose", optional_argument, NULL, 'V'},
 	{"help", 0, NULL, 'h'},
 	{"install", required_argument, NULL, 'i'},
+	{"export-drumkit", required_argument, NULL, 'x'},
 	{"drumkit", required_argument, NULL, 'k'},
+	{"profile", 0, NULL, 'P'},
+	{"import-midi", required_argument, NULL, 'm'},
+	{"save", required_argument, NULL, 'w'},
+	{"list", 0, NULL, 'l'},
 	{0, 0, 0, 0},
 };
 
@@ -130,10 +140,15 @@ int main(int argc, char *argv[])
 		const char* logLevelOpt = "Error";
 		bool showHelpOpt = false;
 		QString drumkitName;
+		QString drumkitToExport;
 		QString drumkitToLoad;
 		short bits = 16;
 		int rate = 44100;
 		short interpolation = 0;
+		bool bProfile = false;
+		QString midiFilename;
+		QString saveFilename;
+		bool bListLibrary = false;
 #ifdef H2CORE_HAVE_JACKSESSION
 		QString sessionId;
 #endif
@@ -159,6 +174,9 @@ int main(int argc, char *argv[])
 				//install h2drumkit
 				drumkitName = QString::fromLocal8Bit(optarg);
 				break;
+			case 'x':
+				drumkitToExport = QString::fromLocal8Bit(optarg);
+				break;
 			case 'k':
 				//load Drumkit
 				drumkitToLoad = QString::fromLocal8Bit(optarg);
@@ -172,6 +190,18 @@ int main(int argc, char *argv[])
 			case 'v':
 				showVersionOpt = true;
 				break;
+			case 'P':
+				bProfile = true;
+				break;
+			case 'm':
+				midiFilename = QString::fromLocal8Bit(optarg);
+				break;
+			case 'w':
+				saveFilename = QString::fromLocal8Bit(optarg);
+				break;
+			case 'l':
+				bListLibrary = true;
+				break;
 			case 'V':
 				logLevelOpt = (optarg) ? optarg : "Warning";
 				break;
@@ -216,7 +246,15 @@ int main(int argc, char *argv[])
 #endif
 
 		if ( ! drumkitName.isEmpty() ){
-			Drumkit::install( drumkitName );
+			exit( installDrumkit( drumkitName ) ? 0 : 1 );
+		}
+
+		if ( ! drumkitToExport.isEmpty() ){
+			exit( exportDrumkit( drumkitToExport, outFilename ) ? 0 : 1 );
+		}
+
+		if ( bListLibrary ) {
+			showSoundLibrary();
 			exit(0);
 		}
 
@@ -330,8 +368,28 @@ int main(int argc, char *argv[])
 			}
 		}
 
+		if ( ! midiFilename.isEmpty() ) {
+			LocalFileMng fileMng;
+			AudioEngine::get_instance()->lock( RIGHT_HERE );
+			if ( fileMng.importMidiFile( pSong, midiFilename ) == 0 ) {
+				pHydrogen->setBPM( pSong->__bpm );
+			} else {
+				___ERRORLOG ( "Error importing the MIDI file" );
+			}
+			AudioEngine::get_instance()->unlock();
+		}
+
+		/* Batch conversion, save and quit */
+		if ( ! saveFilename.isEmpty() ) {
+			if ( ! pSong->save( saveFilename ) ) {
+				___ERRORLOG ( "Error saving the song" );
+			}
+			quit = true;
+		}
+
 		AudioEngine* AudioEngine = AudioEngine::get_instance();
 		Sampler* sampler = AudioEngine->get_sampler();
+		AudioEngine->get_profiler()->setEnabled( bProfile );
 		switch ( interpolation ) {
 			case 1:
 					sampler->setInterpolateMode( Sampler::COSINE );
@@ -387,6 +445,11 @@ int main(int argc, char *argv[])
 					}
 				}
 				break;
+			case EVENT_TEMPO_CHANGED: /* Tempo of a MIDI clock master */
+				AudioEngine->lock( RIGHT_HERE );
+				pHydrogen->setBPM( event.value / 10.0 );
+				AudioEngine->unlock();
+				break;
 			case EVENT_NONE: /* Sleep if there is no more events */
 				Sleeper::msleep ( 100 );
 				break;
@@ -396,6 +459,10 @@ int main(int argc, char *argv[])
 		if ( pHydrogen->getState() == STATE_PLAYING )
 			pHydrogen->sequencer_stop();
 
+		if ( bProfile ) {
+			cout << endl << AudioEngine->get_profiler()->reportText().toLocal8Bit().constData() << endl;
+		}
+
 		delete pSong;
 		delete pPlaylist;
 
@@ -448,15 +515,21 @@ void showUsage()
 {
 	cout << "Usage: hydrogen [-v] [-h] -s file" << endl;
 	cout << "   -d, --driver AUDIODRIVER - Use the selected audio driver (jack, alsa, oss)" << endl;
-	cout << "   -s, --song FILE - Load a song (*.h2song) at startup" << endl;
+	cout << "   -s, --song FILE - Load a song (*.h2song or *.h2snap) at startup" << endl;
 	cout << "   -p, --playlist FILE - Load a playlist (*.h2playlist) at startup" << endl;
 	cout << "   -o, --outfile FILE - Output to file (export)" << endl;
 	cout << "   -r, --rate RATE - Set bitrate while exporting file" << endl;
 	cout << "   -b, --bits BITS - Set bits depth while exporting file" << endl;
 	cout << "   -k, --kit drumkit_name - Load a drumkit at startup" << endl;
 	cout << "   -i, --install FILE - install a drumkit (*.h2drumkit)" << endl;
+	cout << "   -x, --export-drumkit drumkit_name - Archive a drumkit to drumkit_name.h2drumkit, or to the -o FILE" << endl;
 	cout << "   -I, --interpolate INT - Interpolation" << endl;
 	cout << "       (0:linear [default],1:cosine,2:third,3:cubic,4:hermite)" << endl;
+	cout << "   -P, --profile - Profile the audio engine and print a report at exit" << endl;
+	cout << "   -m, --import-midi FILE - Append the notes of a MIDI file to the song, one pattern per bar" << endl;
+	cout << "   -w, --save FILE - Save the song and quit, as a binary snapshot if FILE ends with .h2snap" << endl;
+	cout << "       (convert with -s song.h2song -w song.h2snap, and back)" << endl;
+	cout << "   -l, --list - List the installed drumkits and patterns" << endl;
 
 #ifdef H2CORE_HAVE_JACKSESSION
 	cout << "   -S, --jacksessionid ID - Start a JackSessionHandler session" << endl;
@@ -473,3 +546,77 @@ void showUsage()
 	cout << "   -v, --version - Show version info" << endl;
 	cout << "   -h, --help - Show this help message" << endl;
 }
+
+/**
+ * List the sound library, from its index
+ */
+void showSoundLibrary()
+{
+	SoundLibraryIndex index;
+	index.update();
+
+	const std::vector<SoundLibraryIndex::DrumkitInfo>& drumkits = index.drumkits();
+	cout << "Drumkits:" << endl;
+	for ( uint i = 0; i < drumkits.size(); i++ ) {
+		const SoundLibraryIndex::DrumkitInfo& drumkit = drumkits[i];
+		cout << "   " << drumkit.name.toLocal8Bit().constData()
+			 << ( drumkit.user ? " (user)" : " (system)" )
+			 << ", " << drumkit.instruments.size() << " instruments"
+			 << ", " << drumkit.author.toLocal8Bit().constData()
+			 << ", " << drumkit.license.toLocal8Bit().constData() << endl;
+	}
+
+	const std::vector<SoundLibraryIndex::PatternInfo>& patterns = index.patterns();
+	cout << "Patterns:" << endl;
+	for ( uint i = 0; i < patterns.size(); i++ ) {
+		const SoundLibraryIndex::PatternInfo& pattern = patterns[i];
+		cout << "   " << pattern.name.toLocal8Bit().constData()
+			 << " [" << pattern.category.toLocal8Bit().constData() << "]";
+		if ( !pattern.drumkit.isEmpty() ) {
+			cout << ", for " << pattern.drumkit.toLocal8Bit().constData();
+		}
+		cout << endl;
+	}
+}
+
+/**
+ * Install a drumkit archive, its samples are decoded from the archive and kept in the SamplePool
+ */
+bool installDrumkit( const QString& archivePath )
+{
+#ifdef H2CORE_HAVE_LIBARCHIVE
+	DrumkitArchive::Stats stats;
+	if ( !DrumkitArchive::extract( archivePath, Filesystem::usr_drumkits_dir(), &stats ) ) {
+		cout << "Error installing " << archivePath.toLocal8Bit().constData() << endl;
+		return false;
+	}
+	cout << "Installed " << stats.files << " files, " << stats.samples << " samples, "
+		 << stats.data_size / 1048576.0 << " MB in " << stats.elapsed << " ms, "
+		 << stats.throughput() << " MB/s" << endl;
+	return true;
+#else
+	return Drumkit::install( archivePath );
+#endif
+}
+
+/**
+ * Archive an installed drumkit
+ */
+bool exportDrumkit( const QString& drumkitName, const QString& archivePath )
+{
+	QString dkPath = Filesystem::drumkit_path_search( drumkitName );
+	if ( dkPath.isEmpty() ) {
+		cout << "Drumkit " << drumkitName.toLocal8Bit().constData() << " not found" << endl;
+		return false;
+	}
+	QString outPath = archivePath.isEmpty() ? drumkitName + ".h2drumkit" : archivePath;
+	DrumkitArchive::Stats stats;
+	if ( !DrumkitArchive::create( dkPath, outPath, &stats ) ) {
+		cout << "Error exporting " << drumkitName.toLocal8Bit().constData() << endl;
+		return false;
+	}
+	cout << "Exported " << stats.files << " files, " << stats.data_size / 1048576.0 << " MB to "
+		 << stats.archive_size / 1048576.0 << " MB in " << stats.elapsed << " ms, "
+		 << stats.throughput() << " MB/s" << endl;
+	return true;
+}
@@ -52,9 +52,10 @@ public:
 
 	void midi_action( snd_seq_t *seq_handle );
 	void getPortInfo( const QString& sPortName, int& nClient, int& nPort );
-	virtual void handleQueueNote(Note* pNote);
-	virtual void handleQueueNoteOff( int channel, int key, int velocity );
+	virtual void handleQueueNote( Note* pNote, unsigned nFrameOffset );
+	virtual void handleQueueNoteOff( int channel, int key, int velocity, unsigned nFrameOffset );
 	virtual void handleQueueAllNoteOff();
+	virtual void handleQueueSystemMessage( const unsigned char* pData, unsigned nLength, unsigned nFrameOffset );
 
 private:
 };
@@ -27,6 +27,8 @@
 #include <hydrogen/object.h>
 #include <hydrogen/IO/TransportInfo.h>
 
+#include <inttypes.h>
+
 namespace H2Core
 {
 
@@ -58,6 +60,13 @@ public:
 	virtual void locate( unsigned long nFrame ) = 0;
 	virtual void setBpm( float fBPM ) = 0;
 
+	/**
+	 * Frame time of the driver clock at the start of the current cycle,
+	 * the realtime notes are queued at their frame on this clock.
+	 */
+	virtual uint32_t getCycleFrameTime() {
+		return 0;
+	}
 
 	bool has_track_outs() {
 		return __track_out_enabled;
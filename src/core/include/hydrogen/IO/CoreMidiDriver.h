@@ -51,9 +51,10 @@ public:
 	virtual void close();
 	virtual std::vector<QString> getOutputPortList();
 
-	virtual void handleQueueNote(Note* pNote);
-	virtual void handleQueueNoteOff( int channel, int key, int velocity );
+	virtual void handleQueueNote( Note* pNote, unsigned nFrameOffset );
+	virtual void handleQueueNoteOff( int channel, int key, int velocity, unsigned nFrameOffset );
 	virtual void handleQueueAllNoteOff();
+	virtual void handleQueueSystemMessage( const unsigned char* pData, unsigned nLength, unsigned nFrameOffset );
 
 	MIDIClientRef  h2MIDIClient;
 	ItemCount cmSources;
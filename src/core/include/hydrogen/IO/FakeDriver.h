@@ -53,16 +53,22 @@ public:
 	float* getOut_R();
 
 	virtual void play();
+	/// run a single cycle of the process callback, returns its result
+	int processCycle();
 	virtual void stop();
 	virtual void locate( unsigned long nFrame );
 	virtual void updateTransportInfo();
 	virtual void setBpm( float fBPM );
+	virtual uint32_t getCycleFrameTime() {
+		return m_nFrameTime;
+	}
 
 private:
 	audioProcessCallback m_processCallback;
 	unsigned m_nBufferSize;
 	float* m_pOut_L;
 	float* m_pOut_R;
+	uint32_t m_nFrameTime;		///< frames processed since the driver was created
 
 };
 
@@ -32,7 +32,11 @@
 
 #ifdef H2CORE_HAVE_JACK
 
+#include <hydrogen/IO/MidiEventQueue.h>
+
+#include <QAtomicInt>
 #include <pthread.h>
+#include <semaphore.h>
 
 #include <jack/jack.h>
 #include <jack/midiport.h>
@@ -41,11 +45,32 @@
 #include <string>
 #include <vector>
 
-#define	JACK_MIDI_BUFFER_MAX 64	/* events */
+#define	JACK_MIDI_BUFFER_MAX 256	/* events, power of two */
+#define	JACK_MIDI_EVENT_MAX 10		/* bytes, fits a MTC full frame message */
 
 namespace H2Core
 {
 
+class JackOutput;
+
+/**
+ * JACK MIDI input and output.
+ *
+ * When the audio driver is JackOutput the RX and TX ports are registered
+ * on its client and processed in its process callback: the input before
+ * the audio engine and the output after, so the events are in sync with
+ * the audio of the cycle. Otherwise the driver opens its own client.
+ *
+ * On the client of JackOutput the process callback posts the notes,
+ * stamped with their frame, to the engine which plays them in the same
+ * cycle. Otherwise the notes carry the Clock time of their event and are
+ * played one period later. Every event is then copied to a lock-free
+ * queue, the input thread of the driver handles the rest: the MIDI
+ * actions and the transport messages.
+ *
+ * Outgoing events are stamped with their frame offset in the cycle and
+ * go through a lock-free ring which any thread may write to.
+ */
 class JackMidiDriver : public virtual MidiInput, public virtual MidiOutput
 {
 	H2_OBJECT
@@ -58,26 +83,47 @@ public:
 	virtual std::vector<QString> getOutputPortList();
 
 	void getPortInfo( const QString& sPortName, int& nClient, int& nPort );
+	/// read the input port, post its notes and queue its events to the input thread
 	void JackMidiWrite(jack_nframes_t nframes);
+	/// handle the queued events until the driver is deleted, sleeps while the queue is empty
+	void JackMidiInput();
+	/// write the queued events to the output port
 	void JackMidiRead(jack_nframes_t nframes);
-		virtual void handleQueueNote(Note* pNote);
-		virtual void handleQueueNoteOff( int channel, int key, int velocity );
-		virtual void handleQueueAllNoteOff();
+	virtual void handleQueueNote( Note* pNote, unsigned nFrameOffset );
+	virtual void handleQueueNoteOff( int channel, int key, int velocity, unsigned nFrameOffset );
+	virtual void handleQueueAllNoteOff();
+	virtual void handleQueueSystemMessage( const unsigned char* pData, unsigned nLength, unsigned nFrameOffset );
 
 private:
-	void JackMidiOutEvent(uint8_t *buf, uint8_t len);
+	struct OutEvent {
+		uint8_t data[JACK_MIDI_EVENT_MAX];
+		uint8_t len;
+		jack_nframes_t offset;
+	};
 
-	void lock();
-	void unlock();
+	void JackMidiOutEvent(uint8_t *buf, uint8_t len, jack_nframes_t offset);
+	void JackMidiInEvent(MidiMessage& msg);
+	bool JackMidiPostNote(const MidiMessage& msg);
 
 	jack_port_t *output_port;
 	jack_port_t *input_port;
 	jack_client_t *jack_client;
-	pthread_mutex_t mtx;
+	JackOutput *jack_output;	///< owner of jack_client, NULL if the client is ours
 	int running;
-		uint8_t jack_buffer[JACK_MIDI_BUFFER_MAX * 4];
-	uint32_t rx_in_pos;
-	uint32_t rx_out_pos;
+
+	// events of the input port, handled by in_thread
+	MidiEventQueue in_events;
+	MidiMessage in_message;		///< its sysex data is reserved, not allocated in the callback
+	pthread_t in_thread;
+	sem_t in_sem;			///< posted for each queued event, sem_post() is realtime safe
+	QAtomicInt in_quit;
+
+	// bounded multi producer, single consumer queue
+	OutEvent out_events[JACK_MIDI_BUFFER_MAX];
+	QAtomicInt out_sequence[JACK_MIDI_BUFFER_MAX];
+	QAtomicInt out_write_pos;
+	int out_read_pos;
+	OutEvent cycle_events[JACK_MIDI_BUFFER_MAX];	///< events of the cycle, sorted before writing
 };
 
 };
@@ -50,6 +50,7 @@ namespace H2Core
 class Song;
 class Instrument;
 class InstrumentComponent;
+class JackMidiDriver;
 
 ///
 /// Jack (Jack Audio Connection Kit) server driver.
@@ -90,10 +91,29 @@ public:
 
 	float* getOut_L();
 	float* getOut_R();
-	float* getTrackOut_L( unsigned nTrack );
-	float* getTrackOut_R( unsigned nTrack );
+
+	/**
+	 * Attach the MIDI driver whose ports are registered on our client.
+	 * Its input is read before the audio engine runs and its output is
+	 * written after, in the same process callback. Detaching waits for
+	 * the callback to leave the driver.
+	 */
+	void setMidiDriver( JackMidiDriver* pMidiDriver );
+	/// process callback of the client
+	int process( jack_nframes_t nframes );
+
+	/**
+	 * Fetch the buffers of the track ports for this cycle. Only the
+	 * tracks written in the previous cycle are zeroed, the others
+	 * still hold the silence of the last clear.
+	 */
+	void prepareTrackOutputs( unsigned nFrames );
+	/**
+	 * Buffers of the track of an instrument component for this cycle,
+	 * NULL if it has none. Marks the track as written.
+	 */
 	float* getTrackOut_L( Instrument *, InstrumentComponent * );
-    float* getTrackOut_R( Instrument *, InstrumentComponent * );
+	float* getTrackOut_R( Instrument *, InstrumentComponent * );
 
 	int init( unsigned bufferSize );
 
@@ -102,6 +122,7 @@ public:
 	virtual void locate( unsigned long nFrame );
 	virtual void updateTransportInfo();
 	virtual void setBpm( float fBPM );
+	virtual uint32_t getCycleFrameTime();
 	void calculateFrameOffset();
 	void locateInNCycles( unsigned long frame, int cycles_to_wait = 2 );
 
@@ -137,14 +158,22 @@ private:
 	unsigned long			locate_frame;		// The frame to locate to (used in 'locateInNCycles'.)
 
 	JackProcessCallback		processCallback;
+	JackMidiDriver *		m_pMidiDriver;
+	pthread_mutex_t			m_midiMutex;		///< held by the process callback while it uses m_pMidiDriver
 	jack_port_t *			output_port_1;
 	jack_port_t *			output_port_2;
 	QString					output_port_name_1;
 	QString					output_port_name_2;
-	int						track_map[MAX_INSTRUMENTS][MAX_COMPONENTS];
+	int						track_map[MAX_INSTRUMENTS][MAX_COMPONENTS];	///< track of instrument/component, -1 if none
 	int						track_port_count;
 	jack_port_t *			track_output_ports_L[MAX_INSTRUMENTS];
 	jack_port_t *			track_output_ports_R[MAX_INSTRUMENTS];
+	float *					track_buffers_L[MAX_INSTRUMENTS];	///< port buffers of the current cycle
+	float *					track_buffers_R[MAX_INSTRUMENTS];
+	bool					track_written[MAX_INSTRUMENTS];		///< written since the last clear
+
+	void resetTrackOutputs();
+	int getTrack( Instrument *, InstrumentComponent * );
 
 	jack_transport_state_t	m_JackTransportState;
 	jack_position_t			m_JackTransportPos;
@@ -0,0 +1,108 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2_MIDI_CLOCK_GENERATOR_H
+#define H2_MIDI_CLOCK_GENERATOR_H
+
+#include <hydrogen/object.h>
+
+namespace H2Core
+{
+
+class MidiOutput;
+
+/**
+ * MIDI clock and MIDI time code sent to the MIDI output.
+ *
+ * process() is called by the audio engine once per cycle with the
+ * transport position, and sends the messages due in the cycle stamped
+ * with their frame offset, so they are sample accurate on the drivers
+ * processed in the audio callback (JACK).
+ *
+ * The clock is 24 pulses per quarter note placed on the ticks of the
+ * transport, so it follows the tempo changes of the timeline. It is
+ * started with a start message from the beginning of the song, or else
+ * with a song position pointer and a continue message, and stopped with
+ * a stop message. A jump of the transport position, by a seek or a
+ * relocation of the JACK transport, stops the clock and starts it again
+ * from the new position.
+ *
+ * MTC is sent as quarter frames at 25 fps, timed on the frames of the
+ * transport. A jump of the position is sent as a full frame message.
+ * Hydrogen moves the frame position on a tempo change to keep the tick
+ * position, a slave sees it as a relocation.
+ */
+class MidiClockGenerator : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	enum {
+		PULSES_PER_QUARTER = 24,
+		PULSES_PER_BEAT = 6,		///< unit of the song position pointer, a sixteenth note
+		MTC_FPS = 25
+	};
+
+	MidiClockGenerator();
+	~MidiClockGenerator();
+
+	void setClockEnabled( bool bEnabled ) {
+		m_bClockEnabled = bEnabled;
+	}
+	void setTimecodeEnabled( bool bEnabled ) {
+		m_bTimecodeEnabled = bEnabled;
+	}
+
+	/**
+	 * Send the messages of a cycle. Called from the audio thread.
+	 * \param pOut MIDI output
+	 * \param bPlaying the transport is rolling
+	 * \param nFrame transport position at the start of the cycle
+	 * \param fTickSize frames per tick
+	 * \param nResolution ticks per quarter note
+	 * \param nFrames size of the cycle
+	 * \param nSampleRate sample rate of the audio driver
+	 */
+	void process( MidiOutput* pOut, bool bPlaying, long long nFrame, float fTickSize,
+				  int nResolution, unsigned nFrames, unsigned nSampleRate );
+
+private:
+	bool m_bClockEnabled;
+	bool m_bTimecodeEnabled;
+
+	bool m_bClockRunning;			///< a slave has been started
+	double m_fNextTick;				///< expected tick position of the next cycle
+	long long m_nNextPulse;			///< next clock pulse, counted from the start of the song
+
+	bool m_bTimecodeRunning;
+	long long m_nNextFrame;			///< expected frame position of the next cycle
+	long long m_nNextQuarterFrame;	///< next quarter frame, counted from the start of the song
+
+	void processClock( MidiOutput* pOut, bool bPlaying, double fTickStart, double fTickEnd,
+					   float fTickSize, int nResolution, unsigned nFrames );
+	void processTimecode( MidiOutput* pOut, bool bPlaying, long long nFrame,
+						  unsigned nFrames, unsigned nSampleRate );
+	void sendFullFrame( MidiOutput* pOut, long long nTimecodeFrame );
+};
+
+};
+
+#endif
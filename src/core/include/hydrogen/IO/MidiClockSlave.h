@@ -0,0 +1,127 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2_MIDI_CLOCK_SLAVE_H
+#define H2_MIDI_CLOCK_SLAVE_H
+
+#include <hydrogen/object.h>
+
+#include <QAtomicInt>
+
+namespace H2Core
+{
+
+/**
+ * Tempo and position of a MIDI clock or MTC master.
+ *
+ * The MIDI input feeds the clock pulses, or the MTC quarter frames, with
+ * the time of their event. A delay locked loop, like the one of
+ * AudioClock, filters the jitter of the events and follows the period
+ * of the pulses, from which the tempo (clock) or the speed (MTC) of the
+ * master is derived. The position of the master is counted in pulses
+ * from the start, the song position pointer, or the decoded time code.
+ *
+ * The audio engine reads the state once per cycle, extrapolates the
+ * position of the master at the start of the cycle and adjusts its own
+ * tempo to close the phase error: it is the oscillator of the phase
+ * locked loop.
+ *
+ * The input side is called by the MIDI driver thread, the state is
+ * published with a sequence counter like Meter does.
+ */
+class MidiClockSlave : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	/// Preferences::m_nMidiSyncInput
+	enum Source {
+		SYNC_NONE,
+		SYNC_CLOCK,
+		SYNC_TIMECODE
+	};
+
+	enum {
+		PULSES_PER_QUARTER = 24,
+		PULSES_PER_BEAT = 6			///< unit of the song position pointer
+	};
+
+	struct State {
+		bool bRunning;				///< the master plays and a pulse has been received since
+		double fPosition;			///< of the last pulse, in pulses or quarter frames from the start of the song
+		double fTime;				///< filtered time of the last pulse, on Clock
+		double fPeriod;				///< filtered period of the pulses in seconds, 0 until known
+		int nFps;					///< MTC frame rate
+	};
+
+	MidiClockSlave();
+	~MidiClockSlave();
+
+	/// \name MIDI clock, called from the MIDI input
+	//@{
+	void start();
+	void cont();
+	void stop();
+	/// \param nBeats position in sixteenth notes
+	void songPosition( int nBeats );
+	/// \param fTime Clock time of the event
+	void clock( double fTime );
+	//@}
+
+	/// \name MTC, called from the MIDI input
+	//@{
+	void quarterFrame( int nData, double fTime );
+	void fullFrame( int nHours, int nMinutes, int nSeconds, int nFrames, int nRate );
+	//@}
+
+	/// latest state, called from the audio thread
+	State read();
+	/**
+	 * \return the position of the master at fTime in pulses or quarter
+	 * frames, extrapolated up to the next pulse
+	 */
+	static double position( const State& state, double fTime );
+
+private:
+	double m_fBandwidth;			///< of the DLL, in Hz
+	double m_fT0;					///< filtered time of the last pulse
+	double m_fT1;					///< predicted time of the next pulse
+	double m_fE2;					///< filtered period
+	int m_nPulses;					///< pulses since the DLL was started
+
+	bool m_bRunning;				///< between start or continue and stop
+	long long m_nPosition;			///< position of the next pulse
+
+	int m_nNextPiece;				///< MTC quarter frame piece expected next, -1 to wait for piece 0
+	int m_pieces[ 8 ];
+	int m_nFps;
+
+	State m_state;					///< input thread copy
+	State m_publishedState;			///< written under m_nSequence
+	QAtomicInt m_nSequence;			///< odd while m_publishedState is written
+
+	void pulse( double fTime );
+	void publish();
+};
+
+};
+
+#endif
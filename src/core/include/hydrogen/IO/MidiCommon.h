@@ -49,20 +49,30 @@ public:
 		CONTINUE,
 		STOP,
 		SONG_POS,
-		QUARTER_FRAME
+		QUARTER_FRAME,
+		TIMING_CLOCK
 	};
 
 	MidiMessageType m_type;
 	int m_nData1;
 	int m_nData2;
 	int m_nChannel;
+	/// Clock time of the event, 0 if unknown
+	double m_fTime;
+	/// frame time of the event on the audio driver clock, -1 if unknown
+	long long m_nFrame;
+	/// the driver already posted the note to the engine, only its action is left
+	bool m_bNotePosted;
 	std::vector<unsigned char> m_sysexData;
 
 	MidiMessage()
 			: m_type( UNKNOWN )
 			, m_nData1( -1 )
 			, m_nData2( -1 )
-			, m_nChannel( -1 ) {}
+			, m_nChannel( -1 )
+			, m_fTime( 0.0 )
+			, m_nFrame( -1 )
+			, m_bNotePosted( false ) {}
 };
 
 
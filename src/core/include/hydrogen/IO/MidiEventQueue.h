@@ -0,0 +1,80 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2_MIDI_EVENT_QUEUE_H
+#define H2_MIDI_EVENT_QUEUE_H
+
+#include <hydrogen/object.h>
+#include <hydrogen/IO/MidiCommon.h>
+
+#include <QAtomicInt>
+
+namespace H2Core
+{
+
+/**
+ * Single producer, single consumer queue of MIDI messages.
+ *
+ * The realtime thread of the MIDI driver pushes the messages it receives,
+ * stamped with their Clock time, and the input thread of the driver pops
+ * and handles them. The producer neither locks nor allocates. Up to
+ * SYSEX_SIZE bytes of system exclusive data are queued.
+ */
+class MidiEventQueue : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	enum {
+		SIZE = 1024,			///< a power of two
+		SYSEX_SIZE = 16
+	};
+
+	MidiEventQueue();
+	~MidiEventQueue();
+
+	/// \return false if the queue is full, called by the producer
+	bool push( const MidiMessage& msg );
+	/// \return false if the queue is empty, called by the consumer
+	bool pop( MidiMessage& msg );
+
+private:
+	struct Event {
+		MidiMessage::MidiMessageType type;
+		int nData1;
+		int nData2;
+		int nChannel;
+		double fTime;
+		long long nFrame;
+		bool bNotePosted;
+		unsigned char sysex[ SYSEX_SIZE ];
+		unsigned nSysexLength;
+	};
+
+	Event m_events[ SIZE ];
+	/// counted modulo 2 * SIZE, to tell a full queue from an empty one
+	QAtomicInt m_nWrite;
+	QAtomicInt m_nRead;
+};
+
+};
+
+#endif
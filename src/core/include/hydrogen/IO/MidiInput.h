@@ -47,6 +47,11 @@ public:
 	void setActive( bool isActive ) {
 		m_bActive = isActive;
 	}
+	/**
+	 * Called by the thread of the driver, never by the audio thread. The
+	 * notes are posted to the audio engine without locking it, the other
+	 * messages are handled right away.
+	 */
 	void handleMidiMessage( const MidiMessage& msg );
 	void handleSysexMessage( const MidiMessage& msg );
 	void handleControlChangeMessage( const MidiMessage& msg );
@@ -58,12 +63,17 @@ protected:
 
 	void handleNoteOnMessage( const MidiMessage& msg );
 	void handleNoteOffMessage( const MidiMessage& msg, bool CymbalChoke );
+	/**
+	 * post the note of msg to the audio thread, which plays it at the time
+	 * of its event. It neither locks nor allocates.
+	 * \return false if the queue of the engine is full
+	 */
+	bool postNote( const MidiMessage& msg, bool bNoteOff );
 
 
 private:
-	unsigned long  __noteOnTick;
-	unsigned long  __noteOffTick;
-	unsigned long computeDeltaNoteOnOfftime();
+	/// MIDI clock and MTC quarter frames, fed to Hydrogen::getMidiClockSlave()
+	void handleSyncMessage( const MidiMessage& msg );
 
 	int __hihat_cc_openess;
 
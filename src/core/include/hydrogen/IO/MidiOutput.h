@@ -42,9 +42,22 @@ public:
 	MidiOutput( const char* class_name );
 	virtual ~MidiOutput();
 
-	virtual void handleQueueNote(Note* pNote) = 0;
-	virtual void handleQueueNoteOff( int channel, int key, int velocity ) = 0;
+	/**
+	 * Send a note. Called by the sampler from the audio thread.
+	 * \param nFrameOffset frame of the note in the current cycle, only
+	 * used by the drivers processed in the audio callback
+	 */
+	virtual void handleQueueNote( Note* pNote, unsigned nFrameOffset ) = 0;
+	virtual void handleQueueNoteOff( int channel, int key, int velocity, unsigned nFrameOffset ) = 0;
 	virtual void handleQueueAllNoteOff() = 0;
+	/**
+	 * Send a system common or realtime message, or a system exclusive
+	 * one. Called from the audio thread.
+	 * \param pData the message, status byte first
+	 * \param nLength bytes of the message
+	 * \param nFrameOffset frame of the message in the current cycle
+	 */
+	virtual void handleQueueSystemMessage( const unsigned char* pData, unsigned nLength, unsigned nFrameOffset ) = 0;
 };
 
 };
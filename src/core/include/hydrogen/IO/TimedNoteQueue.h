@@ -0,0 +1,122 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2_TIMED_NOTE_QUEUE_H
+#define H2_TIMED_NOTE_QUEUE_H
+
+#include <hydrogen/object.h>
+
+#include <inttypes.h>
+
+#include <QAtomicInt>
+
+namespace H2Core
+{
+
+class Note;
+
+/**
+ * Realtime notes stamped with the frame time of the MIDI event which
+ * triggered them.
+ *
+ * The MIDI drivers post the notes they receive without locking the
+ * engine. At the start of the next cycle the audio thread receives them,
+ * builds the Note and pushes it at the frame of the event: the note is
+ * never moved to a tick boundary.
+ *
+ * The JACK MIDI ports of the audio client stamp the notes with their
+ * frame in the current cycle. The other drivers only know the Clock time
+ * of the event, their notes are played one period later.
+ *
+ * post() may be called by any thread, the other methods are called with
+ * the audio engine locked. None of them allocates.
+ */
+class TimedNoteQueue : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	enum {
+		POST_SIZE = 256,		///< notes posted in a cycle at most, a power of two
+		SIZE = 256			///< notes waiting for their cycle at most, a power of two
+	};
+
+	/// a note on or note off received by a MIDI driver
+	struct MidiNote {
+		int nNote;
+		float fVelocity;
+		bool bNoteOff;
+		int nHihatOpenness;		///< last value of the hihat pedal CC
+		double fTime;			///< Clock time of the event
+		long long nFrame;		///< frame time of the event on the audio driver clock, -1 if unknown
+	};
+
+	TimedNoteQueue();
+	~TimedNoteQueue();
+
+	/**
+	 * post a note received by a MIDI driver. It neither locks nor allocates.
+	 * \return false if POST_SIZE notes are already waiting
+	 */
+	bool post( const MidiNote& note );
+	/**
+	 * next posted note, called by the audio thread at the start of a cycle
+	 * \return false once all the posted notes are received
+	 */
+	bool receive( MidiNote& note );
+	/**
+	 * queue pNote, received at frame time nFrame
+	 * \return false if SIZE notes are already queued, pNote is left to the caller
+	 */
+	bool push( Note* pNote, uint32_t nFrame );
+	/**
+	 * pop the next note due in the cycle starting at frame time nCycleFrame
+	 * \param nFrames size of the cycle
+	 * \param nOffset set to the frame of the note in the cycle, 0 if it is late
+	 * \return NULL if no note is due in this cycle
+	 */
+	Note* pop( uint32_t nCycleFrame, unsigned nFrames, unsigned& nOffset );
+	/** drop the posted notes and delete the queued ones */
+	void clear();
+
+	bool empty() const {
+		return m_nCount == 0;
+	}
+
+private:
+	struct TimedNote {
+		Note* pNote;
+		uint32_t nFrame;
+	};
+	TimedNote m_notes[ SIZE ];		///< ring, in arrival order
+	unsigned m_nFirst;
+	unsigned m_nCount;
+
+	// bounded multi producer, single consumer queue, as the JACK MIDI output
+	MidiNote m_posted[ POST_SIZE ];
+	QAtomicInt m_postSequence[ POST_SIZE ];
+	QAtomicInt m_nPostWrite;
+	int m_nPostRead;
+};
+
+};
+
+#endif
@@ -74,6 +74,7 @@ public:
 
 	Pattern* loadPattern( const QString& directory );
 	int savePattern( Song *song , const QString& drumkit_name, int selectedpattern , const QString& patternname, const QString& realpatternname, int mode);
+	int importMidiFile( Song *song, const QString& filename );
 
 	int savePlayList( const std::string& patternname );
 	int loadPlayList( const std::string& patternname);
@@ -112,6 +113,9 @@ public:
 	int writeSong( Song *song, const QString& filename );
 };
 
+/// \return the path of a sample relative to its drumkit, as it is saved in the songs
+QString prepare_filename( QString fname );
+
 };
 
 
@@ -201,6 +201,8 @@ public:
 	bool m_bUseMetronome;		///< Use metronome?
 	float m_fMetronomeVolume;	///< Metronome volume FIXME: remove this volume!!
 	unsigned m_nMaxNotes;		///< max notes
+	bool m_bLazyLayerLoading;	///< load the layers of the instruments the first time they are needed, see LayerLoader
+	int m_nFXSlots;				///< number of FX slots of the rack, read at startup
 	unsigned m_nBufferSize;		///< Audio buffer size
 	unsigned m_nSampleRate;		///< Audio sample rate
 
@@ -213,6 +215,10 @@ public:
 	int m_nMidiChannelFilter;
 	bool m_bMidiNoteOffIgnore;
 	bool m_bMidiDiscardNoteAfterAction;
+	bool m_bMidiClockOutput;		///< send MIDI clock, start, stop and song position
+	bool m_bMidiTimecodeOutput;		///< send MIDI time code
+	int m_nMidiSyncInput;			///< follow a MIDI clock or MTC master, see MidiClockSlave::Source
+	int m_nMidiThreadPriority;		///< SCHED_FIFO priority of the MIDI input thread, 0 for the normal scheduling
 
 	//___  alsa audio driver properties ___
 	QString m_sAlsaAudioDevice;
@@ -538,9 +544,17 @@ public:
 	}
 
 	WindowProperties getLadspaProperties( unsigned nFX ) {
+		if ( nFX >= m_ladspaProperties.size() ) {
+			WindowProperties prop;
+			prop.set( 2, 20, 0, 0, false );
+			return prop;
+		}
 		return m_ladspaProperties[nFX];
 	}
 	void setLadspaProperties( unsigned nFX, const WindowProperties& prop ) {
+		while ( m_ladspaProperties.size() <= nFX ) {
+			m_ladspaProperties.push_back( getLadspaProperties( m_ladspaProperties.size() ) );
+		}
 		m_ladspaProperties[nFX] = prop;
 	}
 
@@ -624,13 +638,6 @@ public:
 		__useTimelineBpm = val;
 	}
 
-	int getRubberBandCalcTime(){
-		return __rubberBandCalcTime;
-	}
-	void setRubberBandCalcTime( int val ){
-		__rubberBandCalcTime = val;
-	}
-
 	int getRubberBandBatchMode(){
 		return m_useTheRubberbandBpmChangeEvent;
 	}
@@ -664,7 +671,6 @@ private:
 
 	//___ General properties ___
 	QString m_sH2ProcessName; //Name of hydrogen's main process
-	int __rubberBandCalcTime;
 	bool m_useTheRubberbandBpmChangeEvent; ///rubberband bpm change queue
 	bool m_bPatternModePlaysSelected; /// Behaviour of Pattern Mode
 	bool m_brestoreLastSong;		///< Restore last song?
@@ -721,7 +727,7 @@ private:
 	WindowProperties songEditorProperties;
 	WindowProperties drumkitManagerProperties;
 	WindowProperties audioEngineInfoProperties;
-	WindowProperties m_ladspaProperties[MAX_FX];
+	std::vector<WindowProperties> m_ladspaProperties;	///< one per FX slot
 
 	UIStyle*  m_pDefaultUIStyle;
 
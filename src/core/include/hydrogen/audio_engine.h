@@ -27,6 +27,7 @@
 #include <hydrogen/object.h>
 #include <hydrogen/sampler/Sampler.h>
 #include <hydrogen/synth/Synth.h>
+#include <hydrogen/helpers/profiler.h>
 
 #include <pthread.h>
 #include <string>
@@ -76,12 +77,14 @@ public:
 
 	Sampler* get_sampler();
 	Synth* get_synth();
+	Profiler* get_profiler();
 
 private:
 	static AudioEngine* __instance;
 
 	Sampler* __sampler;
 	Synth* __synth;
+	Profiler* __profiler;
 
 	/// Mutex for syncronized access to the Song object and the AudioEngine.
 	pthread_mutex_t __engine_mutex;
@@ -50,9 +50,10 @@ class Drumkit : public H2Core::Object
 		 * load drumkit information from a directory
 		 * \param dk_dir like one returned by Filesystem::drumkit_path
 		 * \param load_samples automatically load sample data if set to true
+		 * \param validate validate the file against the XML Schema, otherwise only its root node is checked
 		 * \return a Drumkit on success, NULL otherwise
 		 */
-		static Drumkit* load( const QString& dk_dir, bool load_samples=false );
+		static Drumkit* load( const QString& dk_dir, bool load_samples=false, bool validate=true );
 		/**
 		 * Simple wrapper for 'load' - use Filesystem::drumkit_path_search
 		 */
@@ -61,9 +62,10 @@ class Drumkit : public H2Core::Object
 		 * load drumkit information from a file
 		 * \param dk_path is a path to an xml file
 		 * \param load_samples automatically load sample data if set to true
+		 * \param validate validate the file against the XML Schema, otherwise only its root node is checked
 		 * \return a Drumkit on success, NULL otherwise
 		 */
-		static Drumkit* load_file( const QString& dk_path, bool load_samples=false );
+		static Drumkit* load_file( const QString& dk_path, bool load_samples=false, bool validate=true );
 		/**
 		 * load the instrument samples
 		 */
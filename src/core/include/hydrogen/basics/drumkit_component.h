@@ -27,6 +27,7 @@
 #include <inttypes.h>
 
 #include <hydrogen/object.h>
+#include <hydrogen/helpers/meter.h>
 
 namespace H2Core
 {
@@ -68,11 +69,16 @@ class DrumkitComponent : public H2Core::Object
 		float get_peak_l() const;
 		void set_peak_r( float val );
 		float get_peak_r() const;
+		/** return the peak and reset it, lock free against update_peaks() */
+		float take_peak_l();
+		float take_peak_r();
 
 		void reset_outs( uint32_t nFrames );
 		void set_outs( int nBufferPos, float valL, float valR );
 		float get_out_L( int nBufferPos );
 		float get_out_R( int nBufferPos );
+		/** raise the peaks with the outs of the current cycle */
+		void update_peaks( uint32_t nFrames );
 
 	private:
 		int __id;
@@ -81,8 +87,8 @@ class DrumkitComponent : public H2Core::Object
 		bool __muted;
 		bool __soloed;
 
-		float __peak_l;
-		float __peak_r;
+		AtomicPeak __peak_l;
+		AtomicPeak __peak_r;
 
 		float *__out_L;
 		float *__out_R;
@@ -142,22 +148,48 @@ inline bool DrumkitComponent::is_soloed() const
 
 inline void DrumkitComponent::set_peak_l( float val )
 {
-	__peak_l = val;
+	__peak_l.set( val );
 }
 
 inline float DrumkitComponent::get_peak_l() const
 {
-	return __peak_l;
+	return __peak_l.get();
 }
 
 inline void DrumkitComponent::set_peak_r( float val )
 {
-	__peak_r = val;
+	__peak_r.set( val );
 }
 
 inline float DrumkitComponent::get_peak_r() const
 {
-	return __peak_r;
+	return __peak_r.get();
+}
+
+inline float DrumkitComponent::take_peak_l()
+{
+	return __peak_l.take();
+}
+
+inline float DrumkitComponent::take_peak_r()
+{
+	return __peak_r.take();
+}
+
+inline void DrumkitComponent::set_outs( int nBufferPos, float valL, float valR )
+{
+	__out_L[nBufferPos] += valL;
+	__out_R[nBufferPos] += valR;
+}
+
+inline float DrumkitComponent::get_out_L( int nBufferPos )
+{
+	return __out_L[nBufferPos];
+}
+
+inline float DrumkitComponent::get_out_R( int nBufferPos )
+{
+	return __out_R[nBufferPos];
 }
 
 };
@@ -24,6 +24,7 @@
 #define H2C_INSTRUMENT_H
 
 #include <cassert>
+#include <vector>
 
 #include <hydrogen/object.h>
 #include <hydrogen/basics/adsr.h>
@@ -188,10 +189,19 @@ class Instrument : public H2Core::Object
 		/** get the right peak of the instrument */
 		float get_peak_r() const;
 
-		/** set the fx level of the instrument */
+		/** set the fx level of the instrument, ignored if index is not an FX slot */
 		void set_fx_level( float level, int index );
-		/** get the fx level of the instrument */
+		/** get the fx level of the instrument, 0 if index is not an FX slot */
 		float get_fx_level( int index ) const;
+		/**
+		 * set the number of fx levels of the instruments created afterwards,
+		 * called by Effects with the number of FX slots, never less than MAX_FX
+		 */
+		static void set_fx_slots( int slots );
+		/** number of fx levels of the instruments, see set_fx_slots() */
+		static int get_fx_slots() {
+			return __fx_slots;
+		}
 
 		/** set the random pitch factor of the instrument */
 		void set_random_pitch_factor( float val );
@@ -270,13 +280,14 @@ class Instrument : public H2Core::Object
 		bool __muted;                           ///< is the instrument muted?
 		int __mute_group;		                ///< mute group of the instrument
 		int __queued;                           ///< count the number of notes queued within Sampler::__playing_notes_queue or std::priority_queue m_songNoteQueue
-		float __fx_level[MAX_FX];	            ///< Ladspa FX level array
+		std::vector<float> __fx_level;	        ///< Ladspa FX level of each FX slot
 		bool __hihat;                           ///< the instrument is a hihat
 		int __lower_cc;                         ///< lower cc level
 		int __higher_cc;                        ///< higher cc level
 		bool __is_preview_instrument;			///< is the instrument an hydrogen preview instrument?
 		bool __is_metronome_instrument;			///< is the instrument an metronome instrument?
 		std::vector<InstrumentComponent*>* __components;  ///< InstrumentLayer array
+		static int __fx_slots;                  ///< size of __fx_level
 };
 
 // DEFINITIONS
@@ -451,11 +462,12 @@ inline float Instrument::get_peak_r() const
 
 inline void Instrument::set_fx_level( float level, int index )
 {
-	__fx_level[index] = level;
+	if ( index >= 0 && index < ( int )__fx_level.size() ) __fx_level[index] = level;
 }
 
 inline float Instrument::get_fx_level( int index ) const
 {
+	if ( index < 0 || index >= ( int )__fx_level.size() ) return 0.0;
 	return __fx_level[index];
 }
 
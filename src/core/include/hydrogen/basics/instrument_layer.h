@@ -80,6 +80,12 @@ class InstrumentLayer : public H2Core::Object
 		void set_sample( Sample* sample );
 		/** get the sample of the layer */
 		Sample* get_sample() const;
+		/** return true if the sample of the layer holds its data */
+		bool is_loaded() const;
+		/** set the flag telling the LayerLoader was asked for the data of the sample */
+		void set_load_requested( bool requested );
+		/** get the flag telling the LayerLoader was asked for the data of the sample */
+		bool is_load_requested() const;
 
 		/**
 		 * load the sample data
@@ -109,6 +115,7 @@ class InstrumentLayer : public H2Core::Object
 		float __start_velocity;     ///< the start velocity of the sample, 0.0 by default
 		float __end_velocity;       ///< the end velocity of the sample, 1.0 by default
 		Sample* __sample;           ///< the underlaying sample
+		bool __load_requested;      ///< the data of the sample was requested from the LayerLoader, reset with the sample
 };
 
 // DEFINITIONS
@@ -156,6 +163,7 @@ inline float InstrumentLayer::get_end_velocity() const
 inline void InstrumentLayer::set_sample( Sample* sample )
 {
 	__sample = sample;
+	__load_requested = false;
 }
 
 inline Sample* InstrumentLayer::get_sample() const
@@ -163,6 +171,16 @@ inline Sample* InstrumentLayer::get_sample() const
 	return __sample;
 }
 
+inline void InstrumentLayer::set_load_requested( bool requested )
+{
+	__load_requested = requested;
+}
+
+inline bool InstrumentLayer::is_load_requested() const
+{
+	return __load_requested;
+}
+
 };
 
 #endif // H2C_INSTRUMENT_LAYER_H
@@ -27,6 +27,8 @@
 
 #include <hydrogen/object.h>
 
+#include <QtCore/QHash>
+
 namespace H2Core
 {
 
@@ -35,6 +37,11 @@ class Instrument;
 
 /**
  * InstrumentList is a collection of instruments used within a song, a drumkit, ...
+ *
+ * The lookups by id and by name go through hash tables of the indexes of the
+ * instruments, rebuilt on the first lookup after the list changed. As the ids
+ * and the names can be changed on the instruments themselves, a lookup checks
+ * the instrument it finds and falls back to a scan of the list if it misses.
 */
 class InstrumentList : public H2Core::Object
 {
@@ -144,6 +151,11 @@ class InstrumentList : public H2Core::Object
 
 	private:
 		std::vector<Instrument*> __instruments;            ///< the list of instruments
+		QHash<int, int> __id_indexes;                      ///< index of the first instrument of each id
+		QHash<QString, int> __name_indexes;                ///< index of the first instrument of each name
+		bool __indexes_valid;                              ///< false if __instruments changed since the tables were built
+		/** rebuild __id_indexes and __name_indexes */
+		void build_indexes();
 };
 
 // DEFINITIONS
@@ -0,0 +1,129 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_LAYER_LOADER_H
+#define H2C_LAYER_LOADER_H
+
+#include <hydrogen/object.h>
+
+#include <cassert>
+#include <vector>
+#include <pthread.h>
+
+namespace H2Core
+{
+
+class InstrumentLayer;
+class Sample;
+class Song;
+
+/**
+ * Loads the samples of the instrument layers when they are needed.
+ *
+ * With Preferences::m_bLazyLayerLoading, the layers of the instruments
+ * loaded from a drumkit or a song get a sample holding only its filepath,
+ * see create_sample(). The sampler requests the data of such a layer the
+ * first time a note hits its velocity range and plays the nearest loaded
+ * layer meanwhile. The data is read by the loader thread and the sample
+ * of the layer is replaced with the audio engine locked.
+ *
+ * prefetch() queues the layers the notes of a song hit, ahead of the
+ * playback. The queued layers are looked up in the current song and the
+ * preview instrument before their sample is replaced, a request never
+ * outlives its layer.
+ */
+class LayerLoader : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	static void create_instance();
+	static LayerLoader* get_instance() { assert(__instance); return __instance; }
+	/// the queued layers are dropped, the thread is stopped
+	~LayerLoader();
+
+	/**
+	 * create the sample of a layer, without its data if the layers are loaded when needed
+	 * \param sFilepath the audio file
+	 * \return NULL if the file is not readable
+	 */
+	static Sample* create_sample( const QString& sFilepath );
+
+	/**
+	 * queue a layer whose sample has no data, called by the sampler with the audio engine locked.
+	 * It doesn't block: if the loader is busy, the request is dropped and made again by the next buffer.
+	 */
+	void request( InstrumentLayer* pLayer );
+	/**
+	 * queue the layers without data the notes of a song hit, ahead of the ones requested by the sampler
+	 * \return the number of layers queued
+	 */
+	int prefetch( Song* pSong );
+	/// wait for the queued layers to be loaded
+	void wait();
+
+	/**
+	 * the layers the notes of the patterns of a song hit, loaded or not,
+	 * including the ones the humanization of the velocity may reach
+	 * \param pSong the song
+	 * \param layers filled with the layers, each once
+	 */
+	static void needed_layers( Song* pSong, std::vector<InstrumentLayer*>& layers );
+
+	/// body of the loader thread
+	void loaderLoop();
+
+private:
+	static LayerLoader* __instance;
+
+	pthread_t m_thread;
+	bool m_bThreadRunning;
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_workCond;
+	pthread_cond_t m_doneCond;
+
+	// protected by m_mutex
+	std::vector<InstrumentLayer*> m_queue;	///< ring of the queued layers, only prefetch() grows it
+	unsigned m_nQueueHead;		///< first queued layer in m_queue
+	unsigned m_nQueued;			///< number of queued layers
+	bool m_bBusy;				///< the thread is loading a layer
+	bool m_bQuit;
+
+	LayerLoader();
+
+	/// queue a layer at the end, \return false if the ring is full
+	bool push_back( InstrumentLayer* pLayer );
+	/// queue a layer first, the ring grows if it is full
+	void push_front( InstrumentLayer* pLayer );
+	/// take the first queued layer
+	InstrumentLayer* pop_front();
+
+	/// read the data of a layer and give it its sample
+	void load( InstrumentLayer* pLayer );
+	/// \return true if the layer belongs to the current song or to the preview instrument, the audio engine must be locked
+	static bool is_in_use( InstrumentLayer* pLayer );
+};
+
+};
+
+#endif // H2C_LAYER_LOADER_H
+
+/* vim: set softtabstop=4 expandtab: */
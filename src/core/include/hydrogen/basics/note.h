@@ -48,6 +48,7 @@ namespace H2Core
 {
 
 class XMLNode;
+class XMLReader;
 class ADSR;
 class Instrument;
 class InstrumentList;
@@ -90,12 +91,12 @@ class Note : public H2Core::Object
 		 */
 		void save_to( XMLNode* node );
 		/**
-		 * load a note from an XMLNode
-		 * \param node the XMLDode to read from
+		 * load a note from the current note element of an XMLReader
+		 * \param reader the XMLReader to read from, left at the end of the note element
 		 * \param instruments the current instrument list to search instrument into
 		 * \return a new Note instance
 		 */
-		static Note* load_from( XMLNode* node, InstrumentList* instruments );
+		static Note* load_from( XMLReader* reader, InstrumentList* instruments );
 
 		/** output details through logger with DEBUG severity */
 		void dump();
@@ -191,6 +192,14 @@ class Note : public H2Core::Object
 		/** __sample_position accessor */
 		float get_sample_position(int CompoID) ;
 		std::map<int, float> get_samples_position();
+		/**
+		 * __layers_selected setter
+		 * \param CompoID the drumkit component, one of the instrument the note was created with
+		 * \param nLayer the layer of the component the note plays
+		 */
+		void set_layer_selected( int CompoID, int nLayer );
+		/** __layers_selected accessor, -1 if no layer was selected for the component */
+		int get_layer_selected( int CompoID ) const;
 
 		/**
 		 * __humanize_delay setter
@@ -288,6 +297,7 @@ class Note : public H2Core::Object
 		float __resonance;          ///< filter resonant frequency [0;1]
 		int __humanize_delay;       ///< used in "humanize" function
 		std::map< int, float > __samples_position;    ///< place marker for overlapping process() cycles
+		std::map< int, int > __layers_selected;       ///< the layer played for each component, kept once the sample started, filled by the constructors
 		float __bpfb_l;             ///< left band pass filter buffer
 		float __bpfb_r;             ///< right band pass filter buffer
 		float __lpfb_l;             ///< left low pass filter buffer
@@ -421,6 +431,21 @@ inline float Note::get_sample_position( int CompoID )
 	return __samples_position[ CompoID ];
 }
 
+inline void Note::set_layer_selected( int CompoID, int nLayer )
+{
+	// the sampler calls it, never insert
+	std::map< int, int >::iterator it = __layers_selected.find( CompoID );
+	if ( it != __layers_selected.end() ) {
+		it->second = nLayer;
+	}
+}
+
+inline int Note::get_layer_selected( int CompoID ) const
+{
+	std::map< int, int >::const_iterator it = __layers_selected.find( CompoID );
+	return ( it == __layers_selected.end() ? -1 : it->second );
+}
+
 inline void Note::set_humanize_delay( int value )
 {
 	__humanize_delay = value;
@@ -32,6 +32,7 @@ namespace H2Core
 {
 
 class XMLNode;
+class XMLReader;
 class Instrument;
 class InstrumentList;
 class PatternList;
@@ -194,12 +195,12 @@ class Pattern : public H2Core::Object
 		 */
 		void save_to( XMLNode* node );
 		/**
-		 * load a pattern from an XMLNode
-		 * \param node the XMLDode to read from
+		 * load a pattern from the current pattern element of an XMLReader
+		 * \param reader the XMLReader to read from, left at the end of the pattern element
 		 * \param instruments the current instrument list to search instrument into
 		 * \return a new Pattern instance
 		 */
-		static Pattern* load_from( XMLNode* node, InstrumentList* instruments );
+		static Pattern* load_from( XMLReader* reader, InstrumentList* instruments );
 };
 
 #define FOREACH_NOTE_CST_IT_BEGIN_END(_notes,_it) \
@@ -143,12 +143,13 @@ class Sample : public H2Core::Object
 		bool write( const QString& path, int format= ( SF_FORMAT_WAV|SF_FORMAT_PCM_16 ) );
 
 		/**
-		 * load a sample from a file
+		 * load a sample from a file, its data is shared with the samples loaded from the same file
 		 * \param filepath the file to load audio data from
 		 */
 		static Sample* load( const QString& filepath );
 		/**
-		 * load a sample from a file and apply the transformations to the sample data
+		 * load a sample from a file and apply the transformations to the sample data,
+		 * the result is shared with the samples loaded from the same file with the same transformations
 		 * \param filepath the file to load audio data from
 		 * \param loops transformation parameters
 		 * \param rubber band transformation parameters
@@ -156,9 +157,15 @@ class Sample : public H2Core::Object
 		 * \param pan envelope points
 		 */
 		static Sample* load( const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan );
+		/**
+		 * load a sample from the content of its file, already in memory, the data is shared as if it was read from the file
+		 * \param filepath the file the content was read from or written to
+		 * \param content the content of the file
+		 */
+		static Sample* load( const QString& filepath, const QByteArray& content );
 
 		/**
-		 * load sample data
+		 * load sample data, from the SamplePool if the file is already loaded
 		 */
 		void load();
 		/**
@@ -172,8 +179,9 @@ class Sample : public H2Core::Object
 		 * \param rubber band transformation parameters
 		 * \param velocity envelope points
 		 * \param pan envelope points
+		 * \return false if a transformation failed
 		 */
-		void apply( const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan );
+		bool apply( const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan );
 		/**
 		 * aplly loop transformation to the sample
 		 * \param lo loops parameters
@@ -199,6 +207,8 @@ class Sample : public H2Core::Object
 		 * \param r rubberband parameters
 		 */
 		bool exec_rubberband_cli( const Rubberband& rb );
+		/** return true if the samples can be stretched, in process with librubberband or else with the rubberband CLI */
+		static bool rubberband_available();
 
 		/** return true if both data channels are null pointers */
 		bool is_empty() const;
@@ -265,18 +275,28 @@ class Sample : public H2Core::Object
 		VelocityEnvelope __velocity_envelope;   ///< velocity envelope vector
 		Loops __loops;                          ///< set of loop parameters
 		Rubberband __rubberband;                ///< set of rubberband parameters
+		bool __is_shared;                       ///< true if the data is held by the SamplePool
 		/** loop modes string */
 		static const char* __loop_modes[];
+
+		/** read the audio data of __filepath, without the SamplePool */
+		bool load_data();
+		/** decode the audio data of __filepath from the content of the file */
+		bool load_data( const QByteArray& content );
+		/** read the audio data of an opened sound file, closed once read */
+		bool read_data( SNDFILE* file, SF_INFO& sound_info );
+		/** release or delete the data */
+		void free_data();
+		/** replace shared data with a private copy, before modifying it */
+		void detach();
 };
 
 // DEFINITIONS
 
 inline void Sample::unload()
 {
-	if( __data_l ) delete __data_l;
-	if( __data_r ) delete __data_r;
+	free_data();
 	__frames = __sample_rate = 0;
-	__data_l = __data_r = 0;
 	// __is_modified = false; leave this unchanged as pan, velocity, loop and rubberband are kept unchanged
 }
 
@@ -0,0 +1,100 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_SAMPLE_POOL_H
+#define H2C_SAMPLE_POOL_H
+
+#include <hydrogen/object.h>
+
+namespace H2Core
+{
+
+/**
+ * Reference counted store of the audio data of the samples.
+ *
+ * The data is stored under a key made of the identity of the file it comes
+ * from, see file_key(), followed by the edits applied to it, if any. The
+ * samples loaded from the same file with the same edits share a single
+ * copy of the data, read only, whatever layer, instrument, drumkit or song
+ * they belong to. The data is deleted with its last reference, unless
+ * the pool keeps one itself, see keep().
+ */
+class SamplePool : public H2Core::Object
+{
+		H2_OBJECT
+	public:
+		/**
+		 * \return the key of the content of a file: its canonical path, size and modification time
+		 * \param filepath the path to the file
+		 * \return an empty string if the file doesn't exist
+		 */
+		static QString file_key( const QString& filepath );
+		/**
+		 * take a reference to the data stored under a key
+		 * \param key the key of the data
+		 * \param frames set to the number of frames per channel
+		 * \param sample_rate set to the sample rate
+		 * \param data_l set to the left channel
+		 * \param data_r set to the right channel
+		 * \return false if no data is stored under the key
+		 */
+		static bool acquire( const QString& key, int& frames, int& sample_rate, float*& data_l, float*& data_r );
+		/**
+		 * store data under a key, the caller gets the first reference to it.
+		 * If data was stored under the same key in the meantime, the given data
+		 * is deleted and replaced by a reference to the stored one.
+		 * \param key the key of the data
+		 * \param frames the number of frames per channel
+		 * \param sample_rate the sample rate
+		 * \param data_l the left channel, allocated with new[], owned by the pool from then
+		 * \param data_r the right channel, allocated with new[], owned by the pool from then
+		 */
+		static void share( const QString& key, int& frames, int& sample_rate, float*& data_l, float*& data_r );
+		/**
+		 * take one more reference to stored data
+		 * \param data_l the left channel of the data
+		 */
+		static void retain( const float* data_l );
+		/**
+		 * drop a reference to stored data, the last one deletes it
+		 * \param data_l the left channel of the data
+		 */
+		static void release( const float* data_l );
+		/**
+		 * keep a reference to stored data, for data costly to compute again which may be needed after its samples are gone.
+		 * The kept data is released from the least recently kept, as long as it takes more than the given size.
+		 * \param data_l the left channel of the data, kept again if it already is
+		 * \param max_bytes the size the kept data may take
+		 */
+		static void keep( const float* data_l, qint64 max_bytes );
+		/**
+		 * \return the number of stored data
+		 * \param bytes if not null, set to their size in bytes
+		 */
+		static int size( qint64* bytes=0 );
+};
+
+};
+
+#endif // H2C_SAMPLE_POOL_H
+
+/* vim: set softtabstop=4 expandtab: */
@@ -45,6 +45,7 @@ class Pattern;
 class Song;
 class DrumkitComponent;
 class PatternList;
+class XMLReader;
 
 /**
 \ingroup H2CORE
@@ -235,8 +236,12 @@ class SongReader : public H2Core::Object
 	private:
 		QString m_sSongVersion;
 
-		/// Dato un XmlNode restituisce un oggetto Pattern
-		Pattern* getPattern( QDomNode pattern, InstrumentList* instrList );
+		/// reads the instrument element the reader is at, NULL if it has no id
+		Instrument* readInstrument( XMLReader& reader, bool bUseRubberband );
+		/// reads the pattern element the reader is at
+		Pattern* readPattern( XMLReader& reader, InstrumentList* instrList );
+		/// reads the notes of the noteList element the reader is at into pPattern
+		void readNoteList( XMLReader& reader, InstrumentList* instrList, Pattern* pPattern );
 };
 
 };
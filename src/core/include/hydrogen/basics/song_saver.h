@@ -0,0 +1,92 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_SONG_SAVER_H
+#define H2C_SONG_SAVER_H
+
+#include <hydrogen/object.h>
+
+#include <QByteArray>
+#include <QString>
+#include <pthread.h>
+
+namespace H2Core
+{
+
+class Song;
+
+/**
+ * Saves songs from a thread of its own, for the autosave.
+ *
+ * The calling thread, the one editing the song, only takes a snapshot of
+ * it (see SongSnapshot::encode()) with the AudioEngine locked, so the
+ * audio thread can't change the song meanwhile; the XML is written by the saver thread
+ * and the file replaced atomically. A save waiting for the thread is
+ * replaced by a newer one. Unlike Song::save(), the song is left as is,
+ * neither its filename nor its modified flag are changed.
+ */
+class SongSaver : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	SongSaver();
+	/// the pending save is finished before the thread is stopped
+	~SongSaver();
+
+	/**
+	 * save a song, as a snapshot if the filename ends with SongSnapshot::extension, as XML otherwise
+	 * \param pSong the song
+	 * \param sFilename the file to write
+	 * \param bSkipUnchanged skip the save if the song didn't change since its last save to the same file
+	 * \return false if the save was skipped
+	 */
+	bool save( Song* pSong, const QString& sFilename, bool bSkipUnchanged = true );
+	/// wait for the pending save, \return false if a save failed since the last call
+	bool wait();
+
+	/// body of the saver thread
+	void saverLoop();
+
+private:
+	pthread_t m_thread;
+	bool m_bThreadRunning;
+	pthread_mutex_t m_mutex;
+	pthread_cond_t m_workCond;
+	pthread_cond_t m_doneCond;
+
+	// protected by m_mutex
+	bool m_bPending;			///< a save is waiting for the thread
+	bool m_bBusy;				///< the thread is writing a file
+	bool m_bQuit;
+	bool m_bFailed;
+	QString m_sFilename;		///< the pending save
+	QByteArray m_snapshot;
+	QString m_sSavedFilename;	///< the last successful save
+	QByteArray m_savedSnapshot;
+
+	/// \return false on error
+	bool write( const QString& sFilename, const QByteArray& snapshot );
+};
+
+};
+
+#endif // H2C_SONG_SAVER_H
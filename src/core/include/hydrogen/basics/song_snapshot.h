@@ -0,0 +1,115 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_SONG_SNAPSHOT_H
+#define H2C_SONG_SNAPSHOT_H
+
+#include <hydrogen/object.h>
+#include <hydrogen/timeline.h>
+
+#include <QByteArray>
+#include <vector>
+
+namespace H2Core
+{
+
+class Song;
+
+/**
+ * Binary container of a song, the compact alternative to the .h2song XML.
+ *
+ * It holds the same data as SongWriter writes, a song converted from XML
+ * and back gives the same XML. The file is made of a header, the tables
+ * of the song and a string table:
+ * - header: the "H2SS" magic, the format version, the offset and the
+ *   number of entries of the string table
+ * - the song properties, the drumkit components, the instruments with
+ *   their components and layers
+ * - the patterns, each with its notes packed in fixed size records
+ * - the virtual patterns and the pattern groups, as indexes of patterns
+ * - the LADSPA effects and the timeline
+ * - the string table: every string once, referenced by its index
+ *
+ * The numbers are little endian, the strings UTF-8. The file is mapped
+ * to be loaded, the notes are decoded straight from the mapping.
+ */
+class SongSnapshot : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	/// extension of the snapshot files, Song::save() writes a snapshot to the filenames ending with it
+	static const char* extension;
+
+	/// a LADSPA effect of the song
+	struct Fx {
+		Fx() : bEnabled( false ), fVolume( 0.0 ) {}
+		QString sName;				///< "no plugin" for an empty slot
+		QString sFilename;
+		bool bEnabled;
+		float fVolume;
+		std::vector< std::pair<QString, float> > inputControlPorts;
+	};
+
+	/// state of the engine saved with the song
+	struct Settings {
+		Settings() : bPatternModePlaysSelected( true ) {}
+		bool bPatternModePlaysSelected;
+		std::vector<Fx> fx;
+		std::vector<Timeline::HTimelineVector> timeline;
+		std::vector<Timeline::HTimelineTagVector> timelineTags;
+	};
+
+	/// \return true if the file starts with the magic of a snapshot
+	static bool is_snapshot( const QString& sFilename );
+
+	/// \return the state of the engine to save with a song
+	static Settings current_settings();
+
+	/// save a song and the state of the engine, \return false on error
+	static bool save( Song* pSong, const QString& sFilename );
+	/// load a song and apply the saved state to the engine, \return NULL on error
+	static Song* load( const QString& sFilename );
+
+	/// encode a song, without touching the engine
+	static QByteArray encode( Song* pSong, const Settings& settings );
+	/**
+	 * decode a song, without touching the engine
+	 * \param pData the snapshot
+	 * \param nSize its size in bytes
+	 * \param settings filled with the saved state of the engine
+	 * \param bUseRubberband the rubberband settings of the layers are dropped if false
+	 * \return NULL if the snapshot is truncated or corrupted
+	 */
+	static Song* decode( const char* pData, qint64 nSize, Settings& settings, bool bUseRubberband );
+	/**
+	 * convert a snapshot into the XML of a .h2song, without touching the song nor the engine,
+	 * so that a snapshot taken by the thread editing the song can be written by another one
+	 * \param snapshot the snapshot
+	 * \param bReportProgress push EVENT_PROGRESS events if the song has some 100000 notes or more
+	 * \return an empty array if the snapshot is truncated or corrupted
+	 */
+	static QByteArray to_xml( const QByteArray& snapshot, bool bReportProgress = false );
+};
+
+};
+
+#endif // H2C_SONG_SNAPSHOT_H
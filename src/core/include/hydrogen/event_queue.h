@@ -49,7 +49,8 @@ enum EventType {
 	EVENT_JACK_SESSION,
 	EVENT_PLAYLIST_LOADSONG,
 	EVENT_UNDO_REDO,
-	EVENT_SONG_MODIFIED
+	EVENT_SONG_MODIFIED,
+	EVENT_TEMPO_CHANGED		///< tempo of a MIDI clock master, value is the tempo * 10
 };
 
 
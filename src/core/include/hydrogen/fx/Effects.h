@@ -32,6 +32,9 @@
 
 #include <vector>
 #include <cassert>
+#include <pthread.h>
+
+#include <QAtomicInt>
 
 namespace H2Core
 {
@@ -50,9 +53,31 @@ public:
 	LadspaFX* getLadspaFX( int nFX );
 	void  setLadspaFX( LadspaFX* pFX, int nFX );
 
+	/**
+	 * Number of slots of the rack, from the fx_slots preference.
+	 * Read once at startup.
+	 */
+	int getNumberOfSlots() {
+		return m_nSlots;
+	}
+
 	std::vector<LadspaFXInfo*> getPluginList();
 	LadspaFXGroup* getLadspaFXGroup();
 
+	/**
+	 * Run all enabled FX for the current cycle.
+	 * Slots are independent of each other, so they are spread over the
+	 * worker threads, the calling thread taking its share of the work.
+	 * It never blocks on the workers: it spins until their jobs are done,
+	 * and runs the plugins itself when the pool is busy.
+	 */
+	void processFX( unsigned nFrames );
+	/// Zero the buffers of all the slots written to in the last cycle.
+	void clearBuffers( unsigned nFrames );
+
+	/// body of the worker threads
+	void workerLoop();
+
 
 private:
 	static Effects* __instance;
@@ -62,10 +87,32 @@ private:
 
 	void updateRecentGroup();
 
-	LadspaFX* m_FXList[ MAX_FX ];
+	std::vector<LadspaFX*> m_FXList;
+	int m_nSlots;
+
+	// FX worker pool
+	std::vector<pthread_t> m_workers;
+	int m_nWorkers;
+	int m_nSchedPolicy;		///< scheduling copied from the audio thread
+	int m_nSchedPriority;
+	pthread_mutex_t m_workMutex;
+	pthread_cond_t m_workCond;
+	unsigned m_nGeneration;	///< bumped for every dispatched cycle
+	int m_nBusyWorkers;		///< protected by m_workMutex
+	bool m_bQuitWorkers;
+	std::vector<LadspaFX*> m_jobs;
+	int m_nJobs;
+	unsigned m_nJobFrames;
+	QAtomicInt m_nNextJob;
+	QAtomicInt m_nDoneJobs;	///< jobs of the cycle completed, the audio thread spins on it
 
 	Effects();
 
+	void startWorkers();
+	void stopWorkers();
+	void updateWorkersPriority();
+	void runJobs();
+
 	void RDFDescend( const QString& sBase, LadspaFXGroup *pGroup, std::vector<LadspaFXInfo*> pluginList );
 	void getRDF( LadspaFXGroup *pGroup, std::vector<LadspaFXInfo*> pluginList );
 
@@ -129,12 +129,31 @@ public:
 	std::vector<LadspaControlPort*> inputControlPorts;
 	std::vector<LadspaControlPort*> outputControlPorts;
 
-	~LadspaFX();
-
-	void connectAudioPorts( float* pIn_L, float* pIn_R, float* pOut_L, float* pOut_R );
-	void activate();
-	void deactivate();
-	void processFX( unsigned nFrames );
+	virtual ~LadspaFX();
+
+	virtual void connectAudioPorts( float* pIn_L, float* pIn_R, float* pOut_L, float* pOut_R );
+	virtual void activate();
+	virtual void deactivate();
+
+	/**
+	 * Run the plugin on its buffers.
+	 * The plugin is bypassed while nothing is sent to it and its
+	 * output has decayed below DSP::SILENCE_THRESHOLD.
+	 * \return true if the buffers hold output to be mixed
+	 */
+	bool processFX( unsigned nFrames );
+
+	/// Called by the Sampler when a voice sends to this FX in the current cycle.
+	void setInputActive() {
+		m_bInputActive = true;
+		m_bBufferDirty = true;
+	}
+	/// Zero the buffers if anything was written to them since the last call.
+	void clearBuffers( unsigned nFrames );
+	/// true if processFX() produced output in the current cycle
+	bool isOutputActive() {
+		return m_bOutputActive;
+	}
 
 
 	const QString& getPluginLabel() {
@@ -159,6 +178,13 @@ public:
 		m_bEnabled = value;
 	}
 
+	/**
+	 * Load a plugin.
+	 * \param sLibraryPath path of the LADSPA library, or an LV2 plugin
+	 * URI prefixed with Lv2FX::URI_PREFIX
+	 * \param sPluginLabel LADSPA label of the plugin
+	 * \param nSampleRate sample rate of the audio driver
+	 */
 	static LadspaFX* load( const QString& sLibraryPath, const QString& sPluginLabel, long nSampleRate );
 
 	int getPluginType() {
@@ -171,7 +197,7 @@ public:
 	}
 
 
-private:
+protected:
 	bool m_pluginType;
 	bool m_bEnabled;
 	bool m_bActivated;	// Guard against plugins that can't be deactivated before being activated (
@@ -185,13 +211,22 @@ private:
 	LADSPA_Handle m_handle;
 	float m_fVolume;
 
+	long m_nSampleRate;
+	bool m_bInputActive;	///< a voice sent to this FX in the current cycle
+	bool m_bOutputActive;	///< the buffers hold output of the current cycle
+	bool m_bBufferDirty;	///< the buffers have to be cleared before the next cycle
+	long m_nSilentFrames;	///< frames since the plugin output fell silent
+
 	unsigned m_nICPorts;	///< input control port
 	unsigned m_nOCPorts;	///< output control port
 	unsigned m_nIAPorts;	///< input audio port
 	unsigned m_nOAPorts;	///< output audio port
 
 
-	LadspaFX( const QString& sLibraryPath, const QString& sPluginLabel );
+	LadspaFX( const QString& sLibraryPath, const QString& sPluginLabel, const char* sClassName = __class_name );
+
+	/// Run the plugin in place on m_pBuffer_L/R.
+	virtual void runPlugin( unsigned nFrames );
 };
 
 };
@@ -0,0 +1,165 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+#ifndef LV2_FX_H
+#define LV2_FX_H
+
+#include "hydrogen/config.h"
+#if defined(H2CORE_HAVE_LADSPA) && defined(H2CORE_HAVE_LV2)
+
+#include <hydrogen/fx/LadspaFX.h>
+
+#include <pthread.h>
+#include <vector>
+
+#include <lilv/lilv.h>
+#include <lv2/lv2plug.in/ns/ext/atom/atom.h>
+#include <lv2/lv2plug.in/ns/ext/options/options.h>
+#include <lv2/lv2plug.in/ns/ext/urid/urid.h>
+#include <lv2/lv2plug.in/ns/ext/worker/worker.h>
+
+namespace H2Core
+{
+
+class Lv2Ring;
+
+/**
+ * LV2 plugin living in a slot of the Effects rack.
+ *
+ * It shares the LadspaFX interface: audio is processed in place on
+ * m_pBuffer_L/R and the control input ports are exposed as
+ * LadspaControlPort, so the mixer and the song files handle both kinds
+ * of plugins alike. Its library path is the plugin URI prefixed with
+ * URI_PREFIX.
+ *
+ * Supported host features are URID map/unmap, options with bounded
+ * block length and the worker extension, whose work is done on a
+ * thread owned by the plugin instance. Plugins flagged
+ * lv2:inPlaceBroken write to buffers of their own, copied back to
+ * m_pBuffer_L/R after each run.
+ */
+class Lv2FX : public LadspaFX
+{
+	H2_OBJECT
+public:
+	static const char* URI_PREFIX;
+
+	~Lv2FX();
+
+	/** \return true if sLibraryPath designates an LV2 plugin */
+	static bool isLv2Path( const QString& sLibraryPath );
+	/**
+	 * instantiate an LV2 plugin
+	 * \param sLibraryPath the plugin URI prefixed with URI_PREFIX
+	 * \param nSampleRate sample rate of the audio driver
+	 * \return the plugin, or NULL if it can't be hosted
+	 */
+	static Lv2FX* load( const QString& sLibraryPath, long nSampleRate );
+	/** append the mono and stereo LV2 plugins installed to pluginList */
+	static void getPluginList( std::vector<LadspaFXInfo*>& pluginList );
+
+	/** URID map shared by all the instances, not realtime safe */
+	static LV2_URID mapURI( const char* sURI );
+	static const char* unmapURI( LV2_URID nURID );
+
+	void connectAudioPorts( float* pIn_L, float* pIn_R, float* pOut_L, float* pOut_R );
+	void activate();
+	void deactivate();
+
+	/**
+	 * Send a patch:Set message for a parameter which is not exposed as
+	 * a control port. The message is delivered through the atom input
+	 * port at the start of the next cycle.
+	 * \return false if the plugin has no atom input or the queue is full
+	 */
+	bool setProperty( const QString& sPropertyURI, float fValue );
+
+	/// body of the worker thread
+	void workerLoop();
+
+protected:
+	void runPlugin( unsigned nFrames );
+
+private:
+	const LilvPlugin* m_pPlugin;
+	LilvInstance* m_pInstance;
+	const LV2_Worker_Interface* m_pWorkerInterface;
+
+	std::vector<uint32_t> m_audioInPorts;
+	std::vector<uint32_t> m_audioOutPorts;
+	int m_nAtomInPort;				///< -1 if the plugin has no atom input
+	int m_nAtomOutPort;				///< -1 if the plugin has no atom output
+	LV2_Atom_Sequence* m_pAtomIn;
+	LV2_Atom_Sequence* m_pAtomOut;
+
+	bool m_bInPlaceBroken;			///< the plugin can't share its input and output buffers
+	float* m_pOutBuffer_L;			///< output of an in place broken plugin
+	float* m_pOutBuffer_R;
+	float* m_pOut_L;				///< where m_pOutBuffer_L/R are copied after the run
+	float* m_pOut_R;
+
+	Lv2Ring* m_pAtomRequests;		///< messages for the atom input port
+	Lv2Ring* m_pWorkRequests;		///< audio thread -> worker
+	Lv2Ring* m_pWorkResponses;		///< worker -> audio thread
+	char* m_pMessageBuffer;			///< used by the audio thread only
+
+	pthread_t m_workerThread;
+	pthread_mutex_t m_workerMutex;
+	pthread_cond_t m_workerCond;
+	bool m_bWorkerRunning;
+
+	// host features
+	int32_t m_nMinBlockLength;
+	int32_t m_nMaxBlockLength;
+	LV2_URID_Map m_uridMap;
+	LV2_URID_Unmap m_uridUnmap;
+	LV2_Worker_Schedule m_workerSchedule;
+	LV2_Options_Option m_options[ 3 ];
+	LV2_Feature m_features[ 5 ];
+	const LV2_Feature* m_featureList[ 6 ];
+
+	// URIDs used while processing, mapped on instantiation since
+	// mapURI() locks
+	LV2_URID m_nSequenceType;
+	LV2_URID m_nChunkType;
+	LV2_URID m_nPatchSet;
+	LV2_URID m_nPatchProperty;
+	LV2_URID m_nPatchValue;
+
+	Lv2FX( const QString& sLibraryPath, const QString& sPluginURI );
+
+	void initFeatures();
+	bool createPorts();
+	void startWorker();
+	void stopWorker();
+
+	static LilvWorld* world();
+	static LV2_URID uridMap( LV2_URID_Map_Handle handle, const char* sURI );
+	static const char* uridUnmap( LV2_URID_Unmap_Handle handle, LV2_URID nURID );
+	static LV2_Worker_Status scheduleWork( LV2_Worker_Schedule_Handle handle, uint32_t nSize, const void* pData );
+	static LV2_Worker_Status respond( LV2_Worker_Respond_Handle handle, uint32_t nSize, const void* pData );
+};
+
+};
+
+#endif
+
+#endif // LV2_FX_H
@@ -29,6 +29,8 @@
 
 #define SAMPLE_CHANNELS         2
 
+#define FX_SLOTS_MAX            16      // upper bound of the fx_slots preference, FX1Level to FX16Level in the files
+
 #define TWOPI                   6.28318530717958647692
 
 #define UNUSED( v )             (v = v)
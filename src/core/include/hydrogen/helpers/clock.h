@@ -0,0 +1,141 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_CLOCK_H
+#define H2C_CLOCK_H
+
+#include <hydrogen/object.h>
+
+#include <QAtomicInt>
+
+namespace H2Core
+{
+
+/**
+ * Monotonic time source. Unlike gettimeofday() it is never stepped by
+ * NTP or by the user, and it is read without a syscall on most systems.
+ */
+class Clock
+{
+public:
+	/// \return seconds since an arbitrary origin
+	static double now();
+};
+
+
+
+/// Audio cycle statistics published by AudioClock, times in milliseconds.
+struct CycleStats
+{
+	float fProcessTime;			///< time spent in the last cycle
+	float fProcessTimeAvg;		///< average over the last second
+	float fProcessTimeMax;		///< max since the last read
+	float fPeriod;				///< nominal period of the driver
+	float fJitter;				///< max distance of a cycle start to the DLL estimate since the last read
+	float fSampleRate;			///< sample rate measured against the system clock
+	int nLateCycles;			///< cycles which took longer than the period
+};
+
+
+
+/**
+ * Time of the audio cycles, filtered by a delay locked loop.
+ *
+ * The DLL (F. Adriaensen, "Using a DLL to filter time") follows the
+ * start time of the cycles, so the time of any frame of the audio clock
+ * can be computed without the jitter of the driver wakeups, and the
+ * actual sample rate of the soundcard is measured against Clock.
+ *
+ * cycleStart() and cycleEnd() are called by the audio thread. The other
+ * threads read the state published at the start of each cycle with a
+ * sequence counter, like Meter does, and never block the audio thread.
+ */
+class AudioClock : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	AudioClock();
+
+	/// restart the DLL at the next cycle. Not thread safe, call with the engine locked.
+	void reset();
+
+	/**
+	 * \param fTime Clock::now() at the wakeup of the audio thread
+	 * \param nFrames frames of the cycle
+	 * \param nSampleRate nominal sample rate of the driver
+	 */
+	void cycleStart( double fTime, unsigned nFrames, unsigned nSampleRate );
+	/// \return the time spent since cycleStart() in milliseconds
+	float cycleEnd();
+	/// \return filtered start of the current cycle, called from the audio thread
+	double getCycleTime() const {
+		return m_fT0;
+	}
+
+	/// \return frames of the audio clock elapsed since the start of the current cycle at fTime
+	double framesSinceCycleStart( double fTime );
+	/// \return time of frame nFrame of the audio clock, counted from the last reset()
+	double frameToTime( long long nFrame );
+	/// \return frame of the audio clock at fTime, counted from the last reset()
+	double timeToFrame( double fTime );
+
+	/// Latest statistics, called from the GUI.
+	CycleStats read();
+
+private:
+	/// filter state shared with the readers
+	struct State {
+		double fCycleTime;			///< filtered start of the current cycle
+		double fPeriod;				///< filtered length of the current cycle, in seconds
+		long long nCycleFrame;		///< first frame of the current cycle
+		unsigned nFrames;
+	};
+
+	double m_fBandwidth;			///< of the DLL, in Hz
+	double m_fB;					///< loop coefficients
+	double m_fC;
+	double m_fT0;					///< filtered start of the current cycle
+	double m_fT1;					///< predicted start of the next cycle
+	double m_fE2;					///< filtered period
+	unsigned m_nFrames;
+	unsigned m_nSampleRate;
+	long long m_nFrame;				///< frames since the last reset
+	bool m_bRunning;
+
+	double m_fStartTime;			///< unfiltered start of the current cycle
+
+	CycleStats m_stats;				///< audio thread copy
+	State m_state;
+	CycleStats m_publishedStats;	///< written under m_nSequence
+	State m_publishedState;
+	QAtomicInt m_nSequence;			///< odd while the published values are written
+	QAtomicInt m_nReadCount;		///< bumped by each read()
+	int m_nResetCount;				///< last m_nReadCount seen by the audio thread
+
+	void init( double fTime, unsigned nFrames, unsigned nSampleRate );
+	void publish();
+	State readState();
+};
+
+};
+
+#endif  // H2C_CLOCK_H
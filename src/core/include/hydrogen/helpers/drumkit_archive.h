@@ -0,0 +1,84 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_DRUMKIT_ARCHIVE_H
+#define H2C_DRUMKIT_ARCHIVE_H
+
+#include <hydrogen/object.h>
+
+namespace H2Core
+{
+
+/**
+ * Reads and writes the .h2drumkit archives, gzip compressed tar files.
+ *
+ * The archive is read as a stream: the content of each file is handed to
+ * a WorkerPool as soon as it is decompressed, the threads write the files
+ * and may decode the samples straight from the content read, the data
+ * being kept in the SamplePool for the drumkit to be loaded without
+ * reading them again.
+ * The archive is written by compressing each file in a gzip member of its
+ * own, in parallel, the members being written in order one after the
+ * other. A gzip file made of several members decompresses as the
+ * concatenation of their content, the archive is a regular .tar.gz.
+ */
+class DrumkitArchive : public H2Core::Object
+{
+		H2_OBJECT
+	public:
+		/** figures of an extraction or a creation */
+		struct Stats {
+			Stats() : files( 0 ), samples( 0 ), archive_size( 0 ), data_size( 0 ), elapsed( 0 ) {}
+			int files;                  ///< number of files extracted or archived
+			int samples;                ///< number of samples decoded
+			qint64 archive_size;        ///< size of the archive, in bytes
+			qint64 data_size;           ///< size of the files, in bytes
+			qint64 elapsed;             ///< in ms
+			/** return the size of the files processed per second, in MB */
+			double throughput() const;
+		};
+
+		/**
+		 * extract a drumkit archive
+		 * \param archive_path the archive
+		 * \param dst_dir the directory to extract to, usually Filesystem::usr_drumkits_dir()
+		 * \param stats filled with the figures of the extraction if not null
+		 * \param keep_samples if true, the samples of the archive are decoded from its content and kept in the SamplePool,
+		 * the samples loaded from the extracted files afterwards share their data as long as the pool keeps it
+		 * \return false on error
+		 */
+		static bool extract( const QString& archive_path, const QString& dst_dir, Stats* stats=0, bool keep_samples=true );
+		/**
+		 * create a drumkit archive, the files are stored in a directory named as the drumkit directory
+		 * \param dk_dir the drumkit directory
+		 * \param archive_path the archive to write
+		 * \param stats filled with the figures of the creation if not null
+		 * \return false on error
+		 */
+		static bool create( const QString& dk_dir, const QString& archive_path, Stats* stats=0 );
+};
+
+};
+
+#endif  // H2C_DRUMKIT_ARCHIVE_H
+
+/* vim: set softtabstop=4 expandtab: */
@@ -0,0 +1,130 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_DSP_H
+#define H2C_DSP_H
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+namespace H2Core
+{
+
+/**
+ * Small buffer kernels used by the audio engine on every cycle.
+ * They work on unaligned buffers, use SSE when the compiler targets it
+ * and fall back to plain loops otherwise.
+ */
+namespace DSP
+{
+
+/** level below which a buffer is treated as silent (about -120dB) */
+static const float SILENCE_THRESHOLD = 1.0e-6f;
+
+#ifdef __SSE__
+inline float __hmax( __m128 v )
+{
+	v = _mm_max_ps( v, _mm_movehl_ps( v, v ) );
+	v = _mm_max_ss( v, _mm_shuffle_ps( v, v, 1 ) );
+	return _mm_cvtss_f32( v );
+}
+#endif
+
+/**
+ * pDst[i] += pSrc[i]
+ */
+inline void add( float* pDst, const float* pSrc, unsigned nFrames )
+{
+	unsigned i = 0;
+#ifdef __SSE__
+	for ( ; i + 4 <= nFrames; i += 4 ) {
+		_mm_storeu_ps( pDst + i, _mm_add_ps( _mm_loadu_ps( pDst + i ), _mm_loadu_ps( pSrc + i ) ) );
+	}
+#endif
+	for ( ; i < nFrames; ++i ) {
+		pDst[ i ] += pSrc[ i ];
+	}
+}
+
+/**
+ * \return the greater of fPeak and the highest sample of pBuf
+ */
+inline float peak( const float* pBuf, unsigned nFrames, float fPeak )
+{
+	unsigned i = 0;
+#ifdef __SSE__
+	if ( nFrames >= 4 ) {
+		__m128 vPeak = _mm_set1_ps( fPeak );
+		for ( ; i + 4 <= nFrames; i += 4 ) {
+			vPeak = _mm_max_ps( vPeak, _mm_loadu_ps( pBuf + i ) );
+		}
+		fPeak = __hmax( vPeak );
+	}
+#endif
+	for ( ; i < nFrames; ++i ) {
+		if ( pBuf[ i ] > fPeak ) {
+			fPeak = pBuf[ i ];
+		}
+	}
+	return fPeak;
+}
+
+/**
+ * \return the greater of fPeak and the highest absolute sample of pBuf
+ */
+inline float abs_peak( const float* pBuf, unsigned nFrames, float fPeak )
+{
+	unsigned i = 0;
+#ifdef __SSE__
+	if ( nFrames >= 4 ) {
+		const __m128 vZero = _mm_setzero_ps();
+		__m128 vPeak = _mm_set1_ps( fPeak );
+		for ( ; i + 4 <= nFrames; i += 4 ) {
+			__m128 v = _mm_loadu_ps( pBuf + i );
+			vPeak = _mm_max_ps( vPeak, _mm_max_ps( v, _mm_sub_ps( vZero, v ) ) );
+		}
+		fPeak = __hmax( vPeak );
+	}
+#endif
+	for ( ; i < nFrames; ++i ) {
+		float fVal = pBuf[ i ] < 0 ? -pBuf[ i ] : pBuf[ i ];
+		if ( fVal > fPeak ) {
+			fPeak = fVal;
+		}
+	}
+	return fPeak;
+}
+
+/**
+ * \return true if no sample of pBuf exceeds SILENCE_THRESHOLD
+ */
+inline bool is_silent( const float* pBuf, unsigned nFrames )
+{
+	return abs_peak( pBuf, nFrames, 0.0f ) < SILENCE_THRESHOLD;
+}
+
+};
+
+};
+
+#endif  // H2C_DSP_H
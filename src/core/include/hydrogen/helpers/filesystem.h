@@ -4,6 +4,7 @@
 
 #include <hydrogen/object.h>
 #include <QtCore/QString>
+#include <QtCore/QByteArray>
 
 namespace H2Core
 {
@@ -52,6 +53,8 @@ class Filesystem : public H2Core::Object
 		static QString click_file();
 		/** returns click file path from user directory if exists, otherwise from system */
 		static QString usr_click_file();
+		/** returns the path to the index of the sound library, in the user cache */
+		static QString sound_library_index();
 		/** returns the path to the drumkit XSD (xml schema definition) file */
 		static QString drumkit_xsd( );
 		/** returns the path to the drumkit pattern XSD (xml schema definition) file */
@@ -195,6 +198,13 @@ class Filesystem : public H2Core::Object
 		 * \param content then string to write
 		 */
 		static bool write_to_file( const QString& dst, const QString& content );
+		/**
+		 * writes to a temporary file, synced to the disk, then renamed to the destination,
+		 * the former file is kept if the write fails
+		 * \param dst the destination path
+		 * \param data the bytes to write
+		 */
+		static bool write_atomic( const QString& dst, const QByteArray& data );
 		/**
 		 * copy a source file to a destination
 		 * \param src source file path
@@ -0,0 +1,179 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_METER_H
+#define H2C_METER_H
+
+#include <hydrogen/object.h>
+
+#include <QAtomicInt>
+#include <cstring>
+
+namespace H2Core
+{
+
+/**
+ * Peak level raised by the audio thread and taken by the GUI.
+ * Both sides are lock free and a peak raised while the GUI resets the
+ * value is never lost. Only levels >= 0 are stored, which keeps the
+ * ordering of the float bits the same as the ordering of the values.
+ */
+class AtomicPeak
+{
+public:
+	AtomicPeak() : m_nBits( 0 ) { }
+
+	/// m_value = max( m_value, fValue )
+	void raise( float fValue ) {
+		int nNew = toBits( fValue );
+		int nOld = m_nBits;
+		while ( nNew > nOld && !m_nBits.testAndSetOrdered( nOld, nNew ) ) {
+			nOld = m_nBits;
+		}
+	}
+	void set( float fValue ) {
+		m_nBits.fetchAndStoreOrdered( toBits( fValue ) );
+	}
+	float get() const {
+		return toFloat( m_nBits );
+	}
+	/// \return the current value and reset it to 0
+	float take() {
+		return toFloat( m_nBits.fetchAndStoreOrdered( 0 ) );
+	}
+
+private:
+	QAtomicInt m_nBits;
+
+	static int toBits( float fValue ) {
+		int nBits;
+		if ( !( fValue > 0.0f ) ) {
+			fValue = 0.0f;
+		}
+		memcpy( &nBits, &fValue, sizeof( nBits ) );
+		return nBits;
+	}
+	static float toFloat( int nBits ) {
+		float fValue;
+		memcpy( &fValue, &nBits, sizeof( fValue ) );
+		return fValue;
+	}
+};
+
+
+
+/// Levels published by Meter, all linear except fLufs.
+struct MeterValues
+{
+	float fPeak_L;			///< sample peak since the last read
+	float fPeak_R;
+	float fTruePeak_L;		///< inter-sample peak since the last read (4x oversampling)
+	float fTruePeak_R;
+	float fRms_L;			///< RMS over the last 300ms
+	float fRms_R;
+	float fLufs;			///< short term loudness (K-weighted, 3s window)
+};
+
+
+
+/**
+ * Stereo bus meter.
+ *
+ * process() runs in the audio thread and publishes the levels at the end
+ * of each cycle with a sequence counter, so read() gets a coherent
+ * snapshot without ever blocking the audio thread. Reading restarts the
+ * peaks from zero at the next cycle.
+ */
+class Meter : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	/// lowest loudness reported, in LUFS
+	static const float LUFS_FLOOR;
+
+	Meter();
+	~Meter();
+
+	/// clear all the levels. Not thread safe, call with the engine locked.
+	void reset();
+	void process( const float* pBuf_L, const float* pBuf_R, unsigned nFrames, unsigned nSampleRate );
+
+	/// Latest levels, called from the GUI.
+	MeterValues read();
+
+private:
+	enum {
+		TP_PHASES = 4,
+		TP_TAPS = 12,				///< taps per phase
+		LOUDNESS_BLOCKS = 30,		///< 100ms blocks in the short term window
+		RMS_BLOCKS = 3
+	};
+
+	struct Biquad {
+		double b0, b1, b2, a1, a2;
+		double z1, z2;
+
+		double process( double x ) {
+			double y = b0 * x + z1;
+			z1 = b1 * x - a1 * y + z2;
+			z2 = b2 * x - a2 * y;
+			return y;
+		}
+	};
+
+	unsigned m_nSampleRate;
+
+	// true peak interpolator, history of TP_TAPS - 1 samples followed by the cycle
+	float m_fTruePeakCoeffs[ TP_TAPS ][ TP_PHASES ];
+	float* m_pHistory_L;
+	float* m_pHistory_R;
+
+	// K-weighting filters, shelf then high pass
+	Biquad m_shelf[ 2 ];
+	Biquad m_highPass[ 2 ];
+
+	// loudness and RMS, squares summed per 100ms block
+	unsigned m_nBlockSize;
+	unsigned m_nBlockFrames;
+	double m_fBlockLoudness;
+	double m_fBlockSquares_L;
+	double m_fBlockSquares_R;
+	double m_loudnessBlocks[ LOUDNESS_BLOCKS ];
+	double m_squareBlocks_L[ RMS_BLOCKS ];
+	double m_squareBlocks_R[ RMS_BLOCKS ];
+	int m_nBlocks;					///< blocks completed, capped at LOUDNESS_BLOCKS
+	int m_nBlockPos;
+
+	MeterValues m_values;			///< audio thread copy
+	MeterValues m_published;		///< written under m_nSequence
+	QAtomicInt m_nSequence;			///< odd while m_published is written
+	QAtomicInt m_nReadCount;		///< bumped by each read()
+	int m_nResetCount;				///< last m_nReadCount seen by the audio thread
+
+	void setSampleRate( unsigned nSampleRate );
+	void processTruePeak( float* pHistory, const float* pBuf, unsigned nFrames, float& fTruePeak );
+	void endBlock();
+};
+
+};
+
+#endif  // H2C_METER_H
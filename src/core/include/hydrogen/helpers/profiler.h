@@ -0,0 +1,150 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_PROFILER_H
+#define H2C_PROFILER_H
+
+#include <hydrogen/object.h>
+#include <hydrogen/helpers/clock.h>
+
+#include <QAtomicInt>
+
+namespace H2Core
+{
+
+/**
+ * DSP load profiler of the audio thread.
+ *
+ * The time spent in each section of a cycle goes into a histogram with
+ * four buckets per octave, from which the median, the 99th percentile
+ * and the maximum are reported. The histograms are written by the audio
+ * thread only and read without locking, a report may be a cycle late.
+ *
+ * It is off by default. The enabled flag is latched at the start of
+ * each cycle, when it is off a section costs a test of a member.
+ *
+ * Usage in the audio thread:
+ * \code
+ * pProfiler->beginCycle();
+ * double fStart = pProfiler->start();
+ * ... section ...
+ * pProfiler->stop( Profiler::SAMPLER, fStart );
+ * pProfiler->endCycle( fProcessTime, nVoices, fPeriod );
+ * \endcode
+ */
+class Profiler : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	enum Section {
+		CYCLE,			///< the whole audioEngine_process()
+		TRANSPORT,
+		NOTE_QUEUE,		///< song and realtime notes scheduled for the cycle
+		SAMPLER,		///< notes started and rendered by the sampler
+		VOICE,			///< rendering of a single note
+		SYNTH,
+		FX,
+		METERING,
+		SECTIONS
+	};
+
+	/// times in microseconds
+	struct SectionStats {
+		unsigned nCount;
+		float fP50;
+		float fP99;
+		float fMax;
+	};
+
+	struct Report {
+		SectionStats sections[ SECTIONS ];
+		float fVoicesAvg;		///< notes rendered per cycle, average over the last second
+		int nVoicesMax;
+		unsigned nLateCycles;	///< cycles which took longer than the period
+	};
+
+	Profiler();
+	~Profiler();
+
+	static const char* sectionName( Section section );
+
+	void setEnabled( bool bEnabled );
+	bool isEnabled();
+	/// clear the histograms, applied by the audio thread at its next cycle
+	void reset();
+
+	/// called by the audio thread at the start of the cycle
+	void beginCycle();
+	/// \return the start time of a section, 0 if the profiler is off
+	double start() const {
+		return m_bActive ? Clock::now() : 0.0;
+	}
+	void stop( Section section, double fStart ) {
+		if ( m_bActive ) {
+			record( section, Clock::now() - fStart );
+		}
+	}
+	/// add the time of a section measured by the caller, in seconds
+	void record( Section section, double fTime );
+	/**
+	 * called by the audio thread at the end of the cycle
+	 * \param fProcessTime time spent in the cycle, in ms
+	 * \param nVoices notes playing in the sampler
+	 * \param fPeriod period of the driver, in ms
+	 */
+	void endCycle( float fProcessTime, int nVoices, float fPeriod );
+
+	Report report();
+	/// report as a table in plain text
+	QString reportText();
+
+private:
+	enum {
+		BUCKETS_PER_OCTAVE = 4,
+		OCTAVES = 24,			///< up to 16s
+		BUCKETS = 1 + BUCKETS_PER_OCTAVE * OCTAVES
+	};
+
+	struct Histogram {
+		unsigned nCount;
+		float fMax;					///< in microseconds
+		unsigned buckets[ BUCKETS ];
+	};
+
+	Histogram m_histograms[ SECTIONS ];
+	float m_fVoicesAvg;
+	int m_nVoicesMax;
+	unsigned m_nLateCycles;
+
+	bool m_bActive;					///< enabled flag latched for the cycle
+	QAtomicInt m_nEnabled;
+	QAtomicInt m_nResetRequest;		///< bumped by reset()
+	int m_nResetCount;				///< last m_nResetRequest seen by the audio thread
+
+	void clear();
+	static int bucket( float fMicroseconds );
+	static float bucketValue( int nBucket );
+};
+
+};
+
+#endif  // H2C_PROFILER_H
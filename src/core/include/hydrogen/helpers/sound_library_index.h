@@ -0,0 +1,151 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_SOUND_LIBRARY_INDEX_H
+#define H2C_SOUND_LIBRARY_INDEX_H
+
+#include <hydrogen/object.h>
+
+#include <QtCore/QHash>
+#include <QtCore/QStringList>
+#include <vector>
+
+namespace H2Core
+{
+
+/**
+ * Metadata of the installed drumkits and patterns, kept in a file of the
+ * user data directory so that the sound library is listed without parsing
+ * the XML files.
+ *
+ * update() walks the drumkit and pattern directories and only parses the
+ * files which are new or whose size or modification time changed since
+ * the last update, the index file is rewritten if anything changed.
+ * It is not thread safe.
+ */
+class SoundLibraryIndex : public H2Core::Object
+{
+		H2_OBJECT
+	public:
+		/** metadata of a drumkit */
+		struct DrumkitInfo {
+			DrumkitInfo() : user( false ), size( 0 ), mtime( 0 ) {}
+			QString path;               ///< the directory of the drumkit
+			QString name;
+			QString author;
+			QString info;
+			QString license;
+			QStringList instruments;    ///< the names of the instruments, in order
+			bool user;                  ///< installed in the user drumkits directory
+			qint64 size;                ///< size of its drumkit.xml
+			qint64 mtime;               ///< modification time of its drumkit.xml, in ms
+		};
+		/** metadata of a pattern */
+		struct PatternInfo {
+			PatternInfo() : size( 0 ), mtime( 0 ) {}
+			QString path;               ///< the .h2pattern file, cleaned by QDir::cleanPath
+			QString name;
+			QString info;
+			QString category;
+			QString author;
+			QString license;
+			QString drumkit;            ///< the drumkit the pattern was written for
+			qint64 size;
+			qint64 mtime;               ///< in ms
+		};
+
+		/** index of the sound library of the Filesystem, saved in Filesystem::sound_library_index() */
+		SoundLibraryIndex();
+		/**
+		 * index of the given directories
+		 * \param index_path the file to save the index in
+		 * \param sys_drumkits_dir the directory of the system drumkits
+		 * \param usr_drumkits_dir the directory of the user drumkits
+		 * \param patterns_dir the directory of the patterns, each subdirectory holds the patterns of a drumkit
+		 */
+		SoundLibraryIndex( const QString& index_path, const QString& sys_drumkits_dir, const QString& usr_drumkits_dir, const QString& patterns_dir );
+
+		/**
+		 * bring the index up to date with the directories, the saved index is read on the first call
+		 * \return the number of files parsed
+		 */
+		int update();
+
+		/** the system drumkits then the user ones, in the order of their directories */
+		const std::vector<DrumkitInfo>& drumkits() const { return __drumkits; }
+		/** the patterns of the drumkit subdirectories then the ones of the patterns directory */
+		const std::vector<PatternInfo>& patterns() const { return __patterns; }
+		/**
+		 * find a drumkit by name, the user drumkits are searched first as in Filesystem::drumkit_path_search
+		 * \return NULL if it's not indexed
+		 */
+		const DrumkitInfo* find_drumkit( const QString& name ) const;
+		/**
+		 * find a pattern by the path of its file
+		 * \return NULL if it's not indexed
+		 */
+		const PatternInfo* find_pattern( const QString& path ) const;
+		/** \return the categories of the patterns, each once, in the order of the patterns */
+		QStringList pattern_categories() const;
+
+	private:
+		QString __index_path;
+		QString __sys_drumkits_dir;
+		QString __usr_drumkits_dir;
+		QString __patterns_dir;
+		bool __loaded;                          ///< the saved index was read
+		std::vector<DrumkitInfo> __drumkits;
+		std::vector<PatternInfo> __patterns;
+		QHash<QString, int> __pattern_paths;    ///< index in __patterns by path
+
+		/** read the saved index, \return false if missing or not readable */
+		bool load();
+		/** save the index */
+		bool save() const;
+		/**
+		 * append the drumkits of a directory
+		 * \param dir the drumkits directory
+		 * \param user the user drumkits directory or not
+		 * \param previous the drumkits indexed before the update, by path
+		 * \param drumkits the list to append to
+		 * \return the number of drumkits parsed
+		 */
+		int scan_drumkits( const QString& dir, bool user, const QHash<QString, const DrumkitInfo*>& previous, std::vector<DrumkitInfo>& drumkits );
+		/**
+		 * append the patterns of a directory
+		 * \param dir the patterns directory
+		 * \param previous the patterns indexed before the update, by path
+		 * \param patterns the list to append to
+		 * \return the number of patterns parsed
+		 */
+		int scan_patterns( const QString& dir, const QHash<QString, const PatternInfo*>& previous, std::vector<PatternInfo>& patterns );
+		/** read the metadata of a drumkit.xml, \return false if it's not a drumkit */
+		static bool read_drumkit( const QString& filepath, DrumkitInfo& drumkit );
+		/** read the metadata of a .h2pattern, \return false if it's not a pattern */
+		static bool read_pattern( const QString& filepath, PatternInfo& pattern );
+};
+
+};
+
+#endif  // H2C_SOUND_LIBRARY_INDEX_H
+
+/* vim: set softtabstop=4 expandtab: */
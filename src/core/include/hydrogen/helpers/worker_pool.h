@@ -0,0 +1,98 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef H2C_WORKER_POOL_H
+#define H2C_WORKER_POOL_H
+
+#include <hydrogen/object.h>
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+namespace H2Core
+{
+
+/**
+ * Threads running jobs in the background, for the long non realtime
+ * tasks which split into independent pieces: the files of a drumkit
+ * archive, the samples to stretch...
+ *
+ * The jobs are run in the order they are added, each by any of the
+ * threads. If no thread can be created, add() runs the job itself.
+ */
+class WorkerPool : public H2Core::Object
+{
+		H2_OBJECT
+	public:
+		/** a piece of work, deleted once run */
+		class Job
+		{
+			public:
+				virtual ~Job() {}
+				virtual void run() = 0;
+		};
+
+		/**
+		 * start the threads
+		 * \param nWorkers the number of threads, one per processor if 0
+		 * \param nMaxPending add() waits while as many jobs are waiting for a thread, no limit if 0
+		 */
+		WorkerPool( int nWorkers = 0, int nMaxPending = 0 );
+		/** the jobs added are run before the threads are stopped */
+		~WorkerPool();
+
+		/**
+		 * run a job in one of the threads
+		 * \param pJob the job, owned by the pool from then
+		 */
+		void add( Job* pJob );
+		/** wait for all the jobs added to be run */
+		void wait();
+		/** return the number of threads */
+		int workers() const;
+
+		/** body of the threads */
+		void workerLoop();
+
+	private:
+		std::vector<pthread_t> __threads;
+		int __max_pending;
+		pthread_mutex_t __mutex;
+		pthread_cond_t __work_cond;             ///< a job was added or the pool is stopping
+		pthread_cond_t __done_cond;             ///< a job was taken or finished
+		// protected by __mutex
+		std::deque<Job*> __jobs;
+		int __busy;                             ///< number of jobs running
+		bool __quit;
+};
+
+inline int WorkerPool::workers() const
+{
+	return __threads.size();
+}
+
+};
+
+#endif // H2C_WORKER_POOL_H
+
+/* vim: set softtabstop=4 expandtab: */
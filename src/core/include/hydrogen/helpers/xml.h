@@ -4,6 +4,8 @@
 
 #include <hydrogen/object.h>
 #include <QtCore/QString>
+#include <QtCore/QByteArray>
+#include <QtCore/QXmlStreamReader>
 #include <QtXml/QDomDocument>
 
 namespace H2Core
@@ -106,9 +108,16 @@ class XMLDoc : public H2Core::Object, public QDomDocument
 		/**
 		 * read the content of an xml file
 		 * \param filepath the path to the file to read from
-		 * \param schema_path the path to the XML Schema file
+		 * \param schema_path the path to the XML Schema file, the document is not validated if empty
 		 */
 		bool read( const QString& filepath, const QString& schemapath=0 );
+		/**
+		 * check the name and the namespace of the root node, as written by set_root,
+		 * to tell the current format from the former ones without validating the document
+		 * \param node_name, the expected name of the root node
+		 * \param xmlns, the expected xml namespace prefix after XMLNS_BASE
+		 */
+		bool check_root( const QString& node_name, const QString& xmlns );
 		/**
 		 * write itself into a file
 		 * \param filepath the path to the file to write to
@@ -120,6 +129,71 @@ class XMLDoc : public H2Core::Object, public QDomDocument
 		 * \param xmlns, the xml namespace prefix to add after XMLNS_BASE
 		 */
 		void set_root( const QString& node_name, const QString& xmlns );
+		/**
+		 * validate the content of an xml file against an XML Schema.
+		 * The schemas are compiled once and kept for the whole process.
+		 * \param data the content of the file
+		 * \param filepath the path of the file, to resolve its relative references
+		 * \param schemapath the path to the XML Schema file
+		 * \return false if the document is not valid, true if it is or if the schema is not usable
+		 */
+		static bool validate( const QByteArray& data, const QString& filepath, const QString& schemapath );
+};
+
+/**
+ * XMLReader is a subclass of QXmlStreamReader with read values methods.
+ *
+ * Unlike XMLDoc it doesn't build a tree of the document, the objects are
+ * built while the elements are read, in a single pass. The children of the
+ * current element are walked with readNextStartElement(), the read methods
+ * consume the current element:
+ * \code
+ * while( reader.readNextStartElement() ) {
+ *     if( reader.name_is( "size" ) ) size = reader.read_int( -1 );
+ *     else reader.skipCurrentElement();
+ * }
+ * \endcode
+*/
+class XMLReader : public H2Core::Object, public QXmlStreamReader
+{
+		H2_OBJECT
+	public:
+		/** basic constructor */
+		XMLReader( );
+		/**
+		 * read the content of an xml file and move to its root element,
+		 * files written by TinyXML are converted as in LocalFileMng::openXmlDocument
+		 * \param filepath the path to the file to read from
+		 * \param root_name the name of the expected root element
+		 * \param schemapath the path to the XML Schema file
+		 */
+		bool read( const QString& filepath, const QString& root_name, const QString& schemapath=0 );
+		/** true if the current element is named element_name */
+		bool name_is( const char* element_name ) const {
+			return name() == QLatin1String( element_name );
+		}
+		/**
+		 * reads the text of the current element
+		 * \param default_value the value returned if the element is empty
+		 */
+		QString read_string( const QString& default_value );
+		/**
+		 * reads an integer stored into the current element
+		 * \param default_value the value returned if the element is empty
+		 */
+		int read_int( int default_value );
+		/**
+		 * reads a float stored into the current element
+		 * \param default_value the value returned if the element is empty
+		 */
+		float read_float( float default_value );
+		/**
+		 * reads a boolean stored into the current element
+		 * \param default_value the value returned if the element is empty
+		 */
+		bool read_bool( bool default_value );
+	private:
+		QByteArray __data;      ///< content of the file, the reader doesn't copy it
 };
 
 };
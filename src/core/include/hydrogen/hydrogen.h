@@ -32,7 +32,10 @@
 #include <hydrogen/IO/AudioOutput.h>
 #include <hydrogen/IO/MidiInput.h>
 #include <hydrogen/IO/MidiOutput.h>
+#include <hydrogen/IO/TimedNoteQueue.h>
 #include <hydrogen/basics/drumkit.h>
+#include <hydrogen/helpers/meter.h>
+#include <hydrogen/helpers/clock.h>
 #include <cassert>
 #include <hydrogen/timehelper.h>
 
@@ -48,6 +51,8 @@ inline int randomValue( int max );
 namespace H2Core
 {
 
+class MidiClockSlave;
+
 ///
 /// Hydrogen Audio Engine.
 ///
@@ -84,6 +89,7 @@ public:
 
 	void			removeSong();
 
+	/// Called by the GUI, it locks the engine.
 	void			addRealtimeNote ( int instrument,
 									  float velocity,
 									  float pan_L=1.0,
@@ -92,12 +98,16 @@ public:
 									  bool noteoff=false,
 									  bool forcePlay=false,
 									  int msg1=0 );
+	/**
+	 * Post a note received by a MIDI driver to the audio thread, which
+	 * plays it at the time of its event. Any thread may call it, it
+	 * neither locks nor allocates.
+	 * \return false if the queue is full
+	 */
+	bool			postMidiNote( const TimedNoteQueue::MidiNote& note );
 
-	float			getMasterPeak_L();
-	void			setMasterPeak_L( float value );
-
-	float			getMasterPeak_R();
-	void			setMasterPeak_R( float value );
+	/// Levels of the master bus, the peaks restart from zero after each call.
+	MeterValues		readMasterMeter();
 
 	void			getLadspaFXPeak( int nFX, float *fL, float *fR );
 	void			setLadspaFXPeak( int nFX, float fL, float fR );
@@ -130,11 +140,17 @@ public:
 	AudioOutput*	getAudioOutput();
 	MidiInput*		getMidiInput();
 	MidiOutput*		getMidiOutput();
+	/// Tempo and position of the MIDI clock or MTC master, see Preferences::m_nMidiSyncInput
+	MidiClockSlave*	getMidiClockSlave();
+	/// Filtered start time of the audio cycles, the time of the realtime notes refers to it
+	AudioClock*		getAudioClock();
 
 	int				getState();
 
 	float			getProcessTime();
 	float			getMaxProcessTime();
+	/// Statistics of the audio cycles, the maxima restart from zero after each call.
+	CycleStats		readCycleStats();
 
 	int				loadDrumkit( Drumkit *pDrumkitInfo );
 
@@ -166,6 +182,14 @@ public:
 	void			onTapTempoAccelEvent();
 	void			setTapTempo( float fInterval );
 	void			setBPM( float fBPM );
+	/**
+	 * Stretch the samples of the layers using rubberband to a tempo, in parallel on a WorkerPool.
+	 * The stretched data is kept by the SamplePool, a tempo used before is not computed again.
+	 * It returns once the layers have their new sample, called by the GUI or the export thread.
+	 * \param fBpm the tempo, set as Hydrogen::getNewBpmJTM()
+	 * \return the number of layers stretched
+	 */
+	int				recalculateRubberband( float fBpm );
 
 	void			restartLadspaFX();
 	void			setSelectedPatternNumberWithoutGuiEvent( int nPat );
@@ -217,6 +241,11 @@ public:
 	void			__panic();
 	int				__get_selected_PatterNumber();
 	unsigned int	__getMidiRealtimeNoteTickPosition();
+	/// addRealtimeNote() with the engine locked, at frame time nFrame of the audio driver or at the next tick if -1
+	void			__addRealtimeNote( int instrument, float velocity, float pan_L, float pan_R,
+									   bool noteOff, bool forcePlay, int msg1, long long nFrame );
+	/// play a note posted by a MIDI driver at frame time nFrame, called by the audio thread
+	void			__playMidiNote( const TimedNoteQueue::MidiNote& note, uint32_t nFrame );
 
 	void			setTimelineBpm();
 	float			getTimelineBpm( int Beat );
@@ -239,8 +268,8 @@ private:
 	int		m_nTempoChangeCounter;	///< count tempochanges for timeArray
 	int		m_nBeatCount;			///< beatcounter beat to count
 	double	m_nBeatDiffs[16];		///< beat diff
-	timeval m_CurrentTime;			///< timeval
-	timeval	m_LastTime;				///< timeval
+	double	m_fCurrentTime;			///< Clock::now() of the last beat
+	double	m_fLastTime;			///< Clock::now() of the beat before
 	double	m_nLastBeatTime;		///< timediff
 	double	m_nCurrentBeatTime;		///< timediff
 	double	m_nBeatDiff;			///< timediff
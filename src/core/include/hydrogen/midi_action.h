@@ -23,6 +23,7 @@
 #define ACTION_H
 #include <hydrogen/object.h>
 #include <map>
+#include <vector>
 #include <string>
 #include <cassert>
 
@@ -36,28 +37,62 @@ class MidiAction : public H2Core::Object {
 
 		void setParameter1( QString text ){
 			parameter1 = text;
+			__parameter1_value = text.toInt();
 		}
 
 		void setParameter2( QString text ){
 			parameter2 = text;
+			__parameter2_value = text.toInt();
+			__parameter2_from_value = false;
+		}
+
+		/// set parameter 2 from the value of a midi event, without going through a string
+		void setParameter2( int nValue ){
+			__parameter2_value = nValue;
+			__parameter2_from_value = true;
 		}
 
 		QString getParameter1(){
 			return parameter1;
 		}
 
+		/// the text parameter 2 was set to, or its value if it was set from an int
 		QString getParameter2(){
+			if ( __parameter2_from_value ) {
+				return QString::number( __parameter2_value );
+			}
 			return parameter2;
 		}
 
+		int getParameter1Value() const {
+			return __parameter1_value;
+		}
+
+		int getParameter2Value() const {
+			return __parameter2_value;
+		}
+
 		QString getType(){
 			return type;
 		}
 
+		/// index of the handler in the MidiActionManager, -1 until the first dispatch
+		int getHandlerId() const {
+			return __handler_id;
+		}
+
+		void setHandlerId( int nId ){
+			__handler_id = nId;
+		}
+
 	private:
 		QString type;
 		QString parameter1;
 		QString parameter2;
+		int __parameter1_value;
+		int __parameter2_value;
+		bool __parameter2_from_value;	///< getParameter2() formats __parameter2_value
+		int __handler_id;
 };
 
 bool setAbsoluteFXLevel( int nLine, int fx_channel , int fx_param);
@@ -66,12 +101,73 @@ class MidiActionManager : public H2Core::Object
 {
 	H2_OBJECT
 	private:
+		typedef bool (MidiActionManager::*action_f)( MidiAction* );
+
 		static MidiActionManager *__instance;
 		QStringList actionList;
 		QStringList eventList;
 
+		/*
+			handlers of the actions, the type of an action is looked up in
+			actionHandlerIds once and the index is kept in the action itself.
+			Index 0 is the handler of the unknown actions.
+		*/
+		std::vector<action_f> actionHandlers;
+		std::map<QString, int> actionHandlerIds;
+
 		int m_nLastBpmChangeCCParameter;
 
+		void registerHandler( const QString& sType, action_f handler );
+		int resolveHandler( const QString& sType );
+
+		bool nothing( MidiAction* );
+		bool play( MidiAction* );
+		bool playStopToggle( MidiAction* );
+		bool playPauseToggle( MidiAction* );
+		bool pause( MidiAction* );
+		bool stop( MidiAction* );
+		bool mute( MidiAction* );
+		bool unmute( MidiAction* );
+		bool muteToggle( MidiAction* );
+		bool beatcounter( MidiAction* );
+		bool tapTempo( MidiAction* );
+		bool selectNextPattern( MidiAction* );
+		bool selectNextPatternRelative( MidiAction* );
+		bool selectPrevPatternRelative( MidiAction* );
+		bool selectNextPatternCcAbsolute( MidiAction* );
+		bool selectNextPatternPromptly( MidiAction* );
+		bool selectAndPlayPattern( MidiAction* );
+		bool selectInstrument( MidiAction* );
+		bool effect1LevelAbsolute( MidiAction* );
+		bool effect2LevelAbsolute( MidiAction* );
+		bool effect3LevelAbsolute( MidiAction* );
+		bool effect4LevelAbsolute( MidiAction* );
+		bool masterVolumeRelative( MidiAction* );
+		bool masterVolumeAbsolute( MidiAction* );
+		bool stripVolumeRelative( MidiAction* );
+		bool stripVolumeAbsolute( MidiAction* );
+		bool panAbsolute( MidiAction* );
+		bool panRelative( MidiAction* );
+		bool bpmCcRelative( MidiAction* );
+		bool bpmFineCcRelative( MidiAction* );
+		bool bpmIncr( MidiAction* );
+		bool bpmDecr( MidiAction* );
+		bool nextBar( MidiAction* );
+		bool previousBar( MidiAction* );
+		bool playlistSong( MidiAction* );
+		bool playlistNextSong( MidiAction* );
+		bool playlistPrevSong( MidiAction* );
+		bool recordReady( MidiAction* );
+		bool recordStrobeToggle( MidiAction* );
+		bool recordStrobe( MidiAction* );
+		bool recordExit( MidiAction* );
+		bool toggleMetronome( MidiAction* );
+		bool undoAction( MidiAction* );
+		bool redoAction( MidiAction* );
+
+		bool togglePlay( bool bRewind );
+		bool changeBpmCc( MidiAction*, float fStep );
+
 	public:
 		bool handleAction( MidiAction * );
 
@@ -36,6 +36,21 @@ class MidiMap : public H2Core::Object
 	H2_OBJECT
 	public:
 		typedef std::map< QString, MidiAction* > map_t;
+
+		/// MMC commands, as sent in the 5th byte of the sysex message
+		enum MMCCommand {
+			MMC_STOP = 1,
+			MMC_PLAY,
+			MMC_DEFERRED_PLAY,
+			MMC_FAST_FORWARD,
+			MMC_REWIND,
+			MMC_RECORD_STROBE,
+			MMC_RECORD_EXIT,
+			MMC_RECORD_READY,
+			MMC_PAUSE,
+			MMC_COMMANDS
+		};
+
 		static MidiMap* __instance;
 		~MidiMap();
 
@@ -53,6 +68,7 @@ class MidiMap : public H2Core::Object
 		map_t getMMCMap();
 
 		MidiAction* getMMCAction( QString );
+		MidiAction* getMMCAction( int nCommand );
 		MidiAction* getNoteAction( int note );
 		MidiAction* getCCAction( int parameter );
 		MidiAction* getPCAction();
@@ -64,8 +80,11 @@ class MidiMap : public H2Core::Object
 		MidiAction* __note_array[ 128 ];
 		MidiAction* __cc_array[ 128 ];
 		MidiAction* __pc_action;
+		MidiAction* __mmc_array[ MMC_COMMANDS ];	///< mmcMap indexed by MMCCommand
 
 		map_t mmcMap;
+
+		static int mmcCommand( const QString& sEventString );
 		QMutex __mutex;
 };
 #endif
@@ -72,6 +72,9 @@ public:
 
 	void preview_sample( Sample* sample, int length );
 	void preview_instrument( Instrument* instr );
+	Instrument* get_preview_instrument() const {
+		return __preview_instrument;
+	}
 
 	void setPlayingNotelength( Instrument* instrument, unsigned long ticks, unsigned long noteOnTick );
 	bool is_instrument_playing( Instrument* pInstr );
@@ -91,12 +94,25 @@ public:
 private:
 	std::vector<Note*> __playing_notes_queue;
 	std::vector<Note*> __queuedNoteOffs;
+	int __note_end_frame;		///< frame where the last note rendered ended
 
 	/// Instrument used for the preview feature.
 	Instrument* __preview_instrument;
 
 	unsigned __render_note( Note* pNote, unsigned nBufferSize, Song* pSong );
 
+	/// the layer of the component to play a velocity with, the nearest loaded one if its data is not loaded yet, -1 if none
+	int __select_layer( InstrumentComponent* pCompo, float fVelocity );
+
+#ifdef H2CORE_HAVE_LADSPA
+	// FX sends of the note being rendered, one entry per FX slot
+	std::vector<float*> __fx_buf_L;
+	std::vector<float*> __fx_buf_R;
+	std::vector<float> __fx_cost;
+
+	int __get_fx_sends( Instrument *pInstr, Song* pSong, float **pBuf_L, float **pBuf_R, float *pCost );
+#endif
+
 		InterpolateMode __interpolateMode;
 
 		/*
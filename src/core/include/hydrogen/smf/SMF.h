@@ -88,18 +88,160 @@ private:
 
 
 
-class SMFWriter : Object
+/**
+ * Streaming writer of a Standard MIDI File.
+ *
+ * The chunks are encoded straight into one buffer, there is no object
+ * per event and no intermediate copy. The channel events of a track are
+ * passed as plain structs, they are sorted by tick and delta-time encoded
+ * into the buffer, the lengths of the track and the number of tracks are
+ * patched in the chunk headers.
+ *
+ * \code
+ * SMFStream stream( 1, 192 );
+ * stream.beginTrack();
+ * stream.writeTrackName( "drums", 0 );
+ * stream.writeEvents( events );
+ * stream.endTrack();
+ * stream.save( sFilename );
+ * \endcode
+ */
+class SMFStream : public H2Core::Object
 {
 	H2_OBJECT
 public:
-	SMFWriter();
-	~SMFWriter();
+	/// channel event, three bytes
+	struct Event {
+		unsigned nTicks;		///< absolute time, in ticks of the file
+		unsigned char nStatus;	///< event type + channel
+		unsigned char nData1;
+		unsigned char nData2;
+	};
+
+	SMFStream( int nFormat, int nTPQN );
+	~SMFStream();
+
+	/// reserve room for nBytes more bytes in the buffer
+	void reserve( size_t nBytes );
+
+	void beginTrack();
+	/// the meta events must be written before the channel events of the track
+	void writeCopyRightNotice( const QString& sAuthor, unsigned nDeltaTime );
+	void writeTrackName( const QString& sTrackName, unsigned nDeltaTime );
+	void writeTempo( float fBPM, unsigned nDeltaTime );
+	void writeTimeSignature( unsigned nBeats, unsigned nNote, unsigned nMTPMC, unsigned nTSNP24, unsigned nDeltaTime );
+	/// sort events by tick, keeping the order of simultaneous events, and append them to the track
+	void writeEvents( std::vector<Event>& events );
+	void endTrack();
+
+	const std::vector<char>& getBuffer() const {
+		return m_buffer;
+	}
+	/// \return false if the file can't be written
+	bool save( const QString& sFilename );
 
-	void save( const QString& sFilename, Song *pSong );
+private:
+	std::vector<char> m_buffer;
+	size_t m_nTrackStart;		///< offset of the chunk header of the open track
+	unsigned m_nTrackTicks;		///< time of the last event of the open track
+	int m_nTracks;
+
+	void writeByte( int nByte ) {
+		m_buffer.push_back( ( char )nByte );
+	}
+	void writeWord( int nVal );
+	void writeDWord( long nVal );
+	void writeVarLen( unsigned long nVal );
+	void writeString( const QString& sMsg );
+	void patchDWord( size_t nOffset, long nVal );
+	void patchWord( size_t nOffset, int nVal );
+};
+
+
+
+/**
+ * Reader of Standard MIDI Files of format 0 and 1.
+ *
+ * The chunks are read one at a time and their events decoded in place,
+ * only the note on events and the first tempo and time signature are
+ * kept, the notes as plain structs. The notes of all the tracks are
+ * merged and sorted by tick.
+ */
+class SMFReader : public H2Core::Object
+{
+	H2_OBJECT
+public:
+	struct Note {
+		unsigned nTicks;		///< absolute time, in ticks of the file
+		unsigned char nChannel;
+		unsigned char nKey;
+		unsigned char nVelocity;
+	};
+
+	SMFReader();
+	~SMFReader();
+
+	/// \return false if the file can't be read or is not a SMF of format 0 or 1
+	bool load( const QString& sFilename );
+
+	int getFormat() const {
+		return m_nFormat;
+	}
+	int getTPQN() const {
+		return m_nTPQN;
+	}
+	/// \return the first tempo of the file, 0 if it has none
+	float getBPM() const {
+		return m_fBPM;
+	}
+	/// time signature, 4/4 if the file has none
+	unsigned getBeats() const {
+		return m_nBeats;
+	}
+	unsigned getNote() const {
+		return m_nNote;
+	}
+	const std::vector<Note>& getNotes() const {
+		return m_notes;
+	}
+
+	/**
+	 * Append the notes to the song, one column per bar.
+	 *
+	 * The notes are mapped to the instruments of the song by their MIDI
+	 * out note, on any channel. Each bar becomes a pattern named after
+	 * sName, bars with the same notes share a pattern and empty bars give
+	 * empty columns.
+	 * \return the number of columns added
+	 */
+	int createPatterns( Song *pSong, const QString& sName );
 
 private:
-	FILE *m_file;
+	int m_nFormat;
+	int m_nTPQN;
+	float m_fBPM;
+	unsigned m_nBeats;
+	unsigned m_nNote;
+	std::vector<Note> m_notes;
+	std::vector<unsigned char> m_track;		///< data of the chunk being decoded
+
+	bool readTrack();
+};
+
+
+
+class SMFWriter : Object
+{
+	H2_OBJECT
+public:
+	SMFWriter();
+	~SMFWriter();
 
+	/**
+	 * \param bTrackPerInstrument write a track named after each instrument
+	 * instead of a single track with all the notes
+	 */
+	void save( const QString& sFilename, Song *pSong, bool bTrackPerInstrument = false );
 };
 
 };
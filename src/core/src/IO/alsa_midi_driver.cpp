@@ -29,6 +29,7 @@
 
 #include <hydrogen/globals.h>
 #include <hydrogen/event_queue.h>
+#include <hydrogen/helpers/clock.h>
 
 #include <pthread.h>
 #include <hydrogen/basics/note.h>
@@ -54,6 +55,9 @@ struct pollfd *pfd;
 int portId;
 int clientId;
 int outPortId;
+int queueId = -1;
+double queueStartTime = 0.0;	///< Clock time of the start of the queue
+snd_midi_event_t *midiEncoder = NULL;
 
 
 void* alsaMidiDriver_thread( void* param )
@@ -62,6 +66,17 @@ void* alsaMidiDriver_thread( void* param )
 	AlsaMidiDriver *pDriver = ( AlsaMidiDriver* )param;
 	__INFOLOG( "starting" );
 
+	int nPriority = Preferences::get_instance()->m_nMidiThreadPriority;
+	if ( nPriority > 0 ) {
+		struct sched_param sched;
+		sched.sched_priority = nPriority;
+		if ( sched_setscheduler( 0, SCHED_FIFO, &sched ) != 0 ) {
+			__ERRORLOG( "Can't set realtime scheduling for the MIDI input" );
+		}
+		sched_getparam( 0, &sched );
+		__INFOLOG( QString( "Scheduling priority = %1" ).arg( sched.sched_priority ) );
+	}
+
 	if ( seq_handle != NULL ) {
 		__ERRORLOG( "seq_handle != NULL" );
 		pthread_exit( NULL );
@@ -97,6 +112,35 @@ void* alsaMidiDriver_thread( void* param )
 		pthread_exit( NULL );
 	}
 
+	/*
+	 * The system messages are scheduled on a queue, see
+	 * handleQueueSystemMessage(), and the kernel stamps the input events
+	 * with the real time of the same queue for the MIDI clock slave.
+	 */
+	if ( ( queueId = snd_seq_alloc_named_queue( seq_handle, "Hydrogen" ) ) < 0 ) {
+		__ERRORLOG( "Error creating sequencer queue." );
+	} else {
+		snd_seq_start_queue( seq_handle, queueId, NULL );
+		snd_seq_drain_output( seq_handle );
+		queueStartTime = Clock::now();
+
+		snd_seq_port_info_t *portInfo;
+		snd_seq_port_info_alloca( &portInfo );
+		if ( snd_seq_get_port_info( seq_handle, portId, portInfo ) == 0 ) {
+			snd_seq_port_info_set_timestamping( portInfo, 1 );
+			snd_seq_port_info_set_timestamp_real( portInfo, 1 );
+			snd_seq_port_info_set_timestamp_queue( portInfo, queueId );
+			if ( snd_seq_set_port_info( seq_handle, portId, portInfo ) < 0 ) {
+				__ERRORLOG( "Error enabling the timestamps of the input port." );
+			}
+		}
+	}
+
+	if ( snd_midi_event_new( 16, &midiEncoder ) < 0 ) {
+		__ERRORLOG( "Error creating MIDI event encoder." );
+		midiEncoder = NULL;
+	}
+
 	clientId = snd_seq_client_id( seq_handle );
 
 #ifdef H2CORE_HAVE_LASH
@@ -154,6 +198,14 @@ void* alsaMidiDriver_thread( void* param )
 			pDriver->midi_action( seq_handle );
 		}
 	}
+	if ( midiEncoder != NULL ) {
+		snd_midi_event_free( midiEncoder );
+		midiEncoder = NULL;
+	}
+	if ( queueId >= 0 ) {
+		snd_seq_free_queue( seq_handle, queueId );
+		queueId = -1;
+	}
 	snd_seq_close ( seq_handle );
 	seq_handle = NULL;
 	__INFOLOG( "MIDI Thread DESTROY" );
@@ -227,6 +279,11 @@ void AlsaMidiDriver::midi_action( snd_seq_t *seq_handle )
 		if ( m_bActive ) {
 
 			MidiMessage msg;
+			if ( ( ev->flags & SND_SEQ_TIME_STAMP_MASK ) == SND_SEQ_TIME_STAMP_REAL && ev->queue == queueId ) {
+				msg.m_fTime = queueStartTime + ev->time.time.tv_sec + ev->time.time.tv_nsec * 1e-9;
+			} else {
+				msg.m_fTime = Clock::now();
+			}
 
 			switch ( ev->type ) {
 			case SND_SEQ_EVENT_NOTEON:
@@ -274,14 +331,17 @@ void AlsaMidiDriver::midi_action( snd_seq_t *seq_handle )
 
 			case SND_SEQ_EVENT_QFRAME:
 				msg.m_type = MidiMessage::QUARTER_FRAME;
+				msg.m_nData1 = ev->data.control.value;
 				break;
 
 			case SND_SEQ_EVENT_CLOCK:
-				//cout << "!!! Midi CLock" << endl;
+				msg.m_type = MidiMessage::TIMING_CLOCK;
 				break;
 
 			case SND_SEQ_EVENT_SONGPOS:
 				msg.m_type = MidiMessage::SONG_POS;
+				msg.m_nData1 = ev->data.control.value & 0x7F;
+				msg.m_nData2 = ev->data.control.value >> 7;
 				break;
 
 			case SND_SEQ_EVENT_START:
@@ -328,7 +388,8 @@ void AlsaMidiDriver::midi_action( snd_seq_t *seq_handle )
 			}
 		}
 		snd_seq_free_event( ev );
-	} while ( snd_seq_event_input_pending( seq_handle, 0 ) > 0 );
+		// drain the events already received by the sequencer, not only the buffered ones
+	} while ( snd_seq_event_input_pending( seq_handle, 1 ) > 0 );
 }
 
 
@@ -436,7 +497,7 @@ void AlsaMidiDriver::getPortInfo( const QString& sPortName, int& nClient, int& n
 	ERRORLOG( "Midi port " + sPortName + " not found" );
 }
 
-void AlsaMidiDriver::handleQueueNote(Note* pNote)
+void AlsaMidiDriver::handleQueueNote( Note* pNote, unsigned /*nFrameOffset*/ )
 {
 	if ( seq_handle == NULL ) {
 		ERRORLOG( "seq_handle = NULL " );
@@ -477,7 +538,7 @@ void AlsaMidiDriver::handleQueueNote(Note* pNote)
 	snd_seq_drain_output(seq_handle);
 }
 
-void AlsaMidiDriver::handleQueueNoteOff( int channel, int key, int velocity )
+void AlsaMidiDriver::handleQueueNoteOff( int channel, int key, int velocity, unsigned /*nFrameOffset*/ )
 {
 	if ( seq_handle == NULL ) {
 		ERRORLOG( "seq_handle = NULL " );
@@ -504,6 +565,42 @@ void AlsaMidiDriver::handleQueueNoteOff( int channel, int key, int velocity )
 	snd_seq_drain_output(seq_handle);
 }
 
+void AlsaMidiDriver::handleQueueSystemMessage( const unsigned char* pData, unsigned nLength, unsigned nFrameOffset )
+{
+	if ( seq_handle == NULL || midiEncoder == NULL ) {
+		ERRORLOG( "seq_handle = NULL " );
+		return;
+	}
+
+	snd_seq_event_t ev;
+	snd_seq_ev_clear(&ev);
+	snd_midi_event_reset_encode( midiEncoder );
+	if ( snd_midi_event_encode( midiEncoder, pData, nLength, &ev ) <= 0
+		 || ev.type == SND_SEQ_EVENT_NONE ) {
+		return;
+	}
+	snd_seq_ev_set_source(&ev, outPortId);
+	snd_seq_ev_set_subs(&ev);
+
+	/*
+	 * The sequencer does not know the audio cycle. The messages of a
+	 * cycle are sent together, delay them by their offset in the cycle
+	 * so that the clock pulses keep their spacing.
+	 */
+	AudioOutput* pAudioOutput = Hydrogen::get_instance()->getAudioOutput();
+	unsigned nSampleRate = pAudioOutput ? pAudioOutput->getSampleRate() : 0;
+	if ( queueId >= 0 && nFrameOffset > 0 && nSampleRate > 0 ) {
+		snd_seq_real_time_t time;
+		time.tv_sec = nFrameOffset / nSampleRate;
+		time.tv_nsec = ( unsigned )( ( nFrameOffset % nSampleRate ) * ( 1000000000.0 / nSampleRate ) );
+		snd_seq_ev_schedule_real( &ev, queueId, 1, &time );
+	} else {
+		snd_seq_ev_set_direct(&ev);
+	}
+	snd_seq_event_output(seq_handle, &ev);
+	snd_seq_drain_output(seq_handle);
+}
+
 void AlsaMidiDriver::handleQueueAllNoteOff()
 {
 	if ( seq_handle == NULL ) {
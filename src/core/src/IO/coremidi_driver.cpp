@@ -33,12 +33,28 @@
 #include <hydrogen/basics/instrument_list.h>
 #include <hydrogen/Preferences.h>
 #include <hydrogen/IO/CoreMidiDriver.h>
+#include <hydrogen/helpers/clock.h>
 
 #ifdef H2CORE_HAVE_COREMIDI
 
+#include <mach/mach_time.h>
+
 namespace H2Core
 {
 
+/// Clock time of a packet, its host time stamp is the base of Clock on OS X
+static double packetTime( const MIDIPacket* packet )
+{
+	static mach_timebase_info_data_t timebase = { 0, 0 };
+	if ( packet->timeStamp == 0 ) {
+		return Clock::now();
+	}
+	if ( timebase.denom == 0 ) {
+		mach_timebase_info( &timebase );
+	}
+	return packet->timeStamp * ( double )timebase.numer / ( double )timebase.denom * 1e-9;
+}
+
 
 static void midiProc ( const MIDIPacketList * pktlist,
 					   void * readProcRefCon,
@@ -53,6 +69,7 @@ static void midiProc ( const MIDIPacketList * pktlist,
 	CoreMidiDriver *instance = ( CoreMidiDriver * )readProcRefCon;
 	MidiMessage msg;
 	for ( uint i = 0; i < pktlist->numPackets; i++ ) {
+		msg.m_fTime = packetTime( packet );
 		int nEventType = packet->data[0];
 		if ( ( nEventType >= 128 ) && ( nEventType < 144 ) ) {	// note off
 			msg.m_nChannel = nEventType - 128;
@@ -217,7 +234,7 @@ std::vector<QString> CoreMidiDriver::getOutputPortList()
 	return cmPortList;
 }
 
-void CoreMidiDriver::handleQueueNote(Note* pNote)
+void CoreMidiDriver::handleQueueNote( Note* pNote, unsigned /*nFrameOffset*/ )
 {
 	if (cmH2Dst == NULL ) {
 		ERRORLOG( "cmH2Dst = NULL " );
@@ -251,7 +268,7 @@ void CoreMidiDriver::handleQueueNote(Note* pNote)
 	MIDISend(h2OutputRef, cmH2Dst, &packetList);
 }
 
-void CoreMidiDriver::handleQueueNoteOff( int channel, int key, int velocity )
+void CoreMidiDriver::handleQueueNoteOff( int channel, int key, int velocity, unsigned /*nFrameOffset*/ )
 {
 	if (cmH2Dst == NULL ) {
 		ERRORLOG( "cmH2Dst = NULL " );
@@ -279,6 +296,26 @@ void CoreMidiDriver::handleQueueNoteOff( int channel, int key, int velocity )
 	MIDISend(h2OutputRef, cmH2Dst, &packetList);
 }
 
+void CoreMidiDriver::handleQueueSystemMessage( const unsigned char* pData, unsigned nLength, unsigned /*nFrameOffset*/ )
+{
+	if (cmH2Dst == NULL ) {
+		ERRORLOG( "cmH2Dst = NULL " );
+		return;
+	}
+
+	MIDIPacketList packetList;
+	if ( nLength == 0 || nLength > sizeof( packetList.packet->data ) ) {
+		return;
+	}
+	packetList.numPackets = 1;
+
+	packetList.packet->timeStamp = 0;
+	packetList.packet->length = nLength;
+	memcpy( packetList.packet->data, pData, nLength );
+
+	MIDISend(h2OutputRef, cmH2Dst, &packetList);
+}
+
 void CoreMidiDriver::handleQueueAllNoteOff()
 {
 	if (cmH2Dst == NULL ) {
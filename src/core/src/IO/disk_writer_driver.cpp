@@ -19,8 +19,6 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  */
-#include <unistd.h>
-
 
 #include <hydrogen/Preferences.h>
 #include <hydrogen/event_queue.h>
@@ -33,18 +31,6 @@
 #include <pthread.h>
 #include <cassert>
 
-#ifdef WIN32
-#include <windows.h>
-/*
- * In Windows the unistd function sleep( seconds ) is not available.
- * Treat sleep( SECONDS ) as a macro that uses SleepEx.
- * Convert seconds to milliseconds for the first argument of SleepEx.
- * Use false for the second argument of SleepEx.
- * This way SleepEx always returns 0, after the specified time has passed.
- */
-#define sleep( SECONDS ) SleepEx( SECONDS * 1000, false )
-#endif
-
 namespace H2Core
 {
 
@@ -185,11 +171,9 @@ void* diskWriterDriver_thread( void* param )
 						pDriver->audioEngine_process_checkBPMChanged();
 						engine->setPatternPos(patternposition);
 
-						// delay needed time to calculate all rubberband samples
+						// the samples are stretched to the tempo before rendering the pattern
 						if( Preferences::get_instance()->getRubberBandBatchMode() && validBpm != oldBPM ){
-								EventQueue::get_instance()->push_event( EVENT_RECALCULATERUBBERBAND, -1);
-								int sleepTime = Preferences::get_instance()->getRubberBandCalcTime()+1;
-								while ((sleepTime = sleep(sleepTime)) > 0);
+								engine->recalculateRubberband( validBpm );
 						}
 						oldBPM = validBpm;
 
@@ -33,6 +33,7 @@ FakeDriver::FakeDriver( audioProcessCallback processCallback )
 		, m_pOut_L( NULL )
 		, m_pOut_R( NULL )
 		, m_nBufferSize( 0 )
+		, m_nFrameTime( 0 )
 {
 	INFOLOG( "INIT" );
 }
@@ -100,11 +101,17 @@ void FakeDriver::play()
 {
 	m_transport.m_status = TransportInfo::ROLLING;
 
-	while ( m_processCallback( m_nBufferSize, NULL ) == 0 ) {
-		// process...
+	while ( processCycle() == 0 ) {
 	}
 }
 
+int FakeDriver::processCycle()
+{
+	int nRes = m_processCallback( m_nBufferSize, NULL );
+	m_nFrameTime += m_nBufferSize;
+	return nRes;
+}
+
 void FakeDriver::stop()
 {
 	m_transport.m_status = TransportInfo::STOPPED;
@@ -28,9 +28,11 @@
 
 #ifdef H2CORE_HAVE_JACK
 
+#include <hydrogen/IO/JackOutput.h>
 #include <hydrogen/Preferences.h>
 #include <hydrogen/hydrogen.h>
 #include <hydrogen/globals.h>
+#include <hydrogen/helpers/clock.h>
 #include <hydrogen/event_queue.h>
 #include <hydrogen/basics/note.h>
 #include <hydrogen/basics/instrument.h>
@@ -47,18 +49,6 @@ namespace H2Core
 
 const char* JackMidiDriver::__class_name = "JackMidiDriver";
 
-void
-JackMidiDriver::lock(void)
-{
-	pthread_mutex_lock(&mtx);
-}
-
-void
-JackMidiDriver::unlock(void)
-{
-	pthread_mutex_unlock(&mtx);
-}
-
 void
 JackMidiDriver::JackMidiWrite(jack_nframes_t nframes)
 {
@@ -82,8 +72,25 @@ JackMidiDriver::JackMidiWrite(jack_nframes_t nframes)
 	events = jack_midi_get_event_count(buf);
 #endif
 
+	/*
+	 * Clock time of the first frame of the events, the notes are played
+	 * at this offset and the MIDI clock slave follows it. The events are
+	 * read in the process callback, so the cycle started
+	 * jack_frames_since_cycle_start() frames ago.
+	 */
+	double fSampleRate = jack_get_sample_rate(jack_client);
+	double fCycleTime = Clock::now() - jack_frames_since_cycle_start(jack_client) / fSampleRate;
+	/* on the client of the audio driver the frames are those of the engine */
+	jack_nframes_t cycle_frame = jack_last_frame_time(jack_client);
+
 	for (i = 0; i < events; i++) {
-		MidiMessage msg;
+		MidiMessage& msg = in_message;
+		msg.m_type = MidiMessage::UNKNOWN;
+		msg.m_nData1 = -1;
+		msg.m_nData2 = -1;
+		msg.m_nFrame = -1;
+		msg.m_bNotePosted = false;
+		msg.m_sysexData.clear();
 
 #ifdef JACK_MIDI_NEEDS_NFRAMES
 		error = jack_midi_event_get(&event, buf, i, nframes);
@@ -102,41 +109,45 @@ JackMidiDriver::JackMidiWrite(jack_nframes_t nframes)
 		memset(buffer, 0, sizeof(buffer));
 		memcpy(buffer, event.buffer, error);
 
+		msg.m_fTime = fCycleTime + event.time / fSampleRate;
+		if (jack_output != NULL)
+			msg.m_nFrame = (jack_nframes_t)(cycle_frame + event.time);
+
 		switch (buffer[0] >> 4) {
 		case 0x8:	 /* note off */
 			msg.m_type = MidiMessage::NOTE_OFF;
 			msg.m_nData1 = buffer[1];
 			msg.m_nData2 = buffer[2];
 			msg.m_nChannel = buffer[0] & 0xF;
-			handleMidiMessage(msg);
+			JackMidiInEvent(msg);
 			break;
 		case 0x9:	 /* note on */
 			msg.m_type = MidiMessage::NOTE_ON;
 			msg.m_nData1 = buffer[1];
 			msg.m_nData2 = buffer[2];
 						msg.m_nChannel = buffer[0] & 0xF;
-						handleMidiMessage(msg);
+						JackMidiInEvent(msg);
 			break;
 		case 0xA:	 /* aftertouch */
 			msg.m_type = MidiMessage::POLYPHONIC_KEY_PRESSURE;
 			msg.m_nData1 = buffer[1];
 			msg.m_nData2 = buffer[2];
 			msg.m_nChannel = buffer[0] & 0xF;
-			handleMidiMessage(msg);
+			JackMidiInEvent(msg);
 			break;
 		case 0xB:	 /* control change */
 			msg.m_type = MidiMessage::CONTROL_CHANGE;
 			msg.m_nData1 = buffer[1];
 			msg.m_nData2 = buffer[2];
 			msg.m_nChannel = buffer[0] & 0xF;
-			handleMidiMessage(msg);
+			JackMidiInEvent(msg);
 			break;
 		case 0xC:	 /* program change */
 			msg.m_type = MidiMessage::PROGRAM_CHANGE;
 			msg.m_nData1 = buffer[1];
 			msg.m_nData2 = buffer[2];
 			msg.m_nChannel = buffer[0] & 0xF;
-			handleMidiMessage(msg);
+			JackMidiInEvent(msg);
 			break;
 				case 0xF:
 					switch (buffer[0]) {
@@ -152,42 +163,47 @@ JackMidiDriver::JackMidiWrite(jack_nframes_t nframes)
 											 msg.m_sysexData.push_back( buffer[i] );
 									}
 								}
-								handleMidiMessage(msg);
+								JackMidiInEvent(msg);
 								break;
 			case 0xF1:
 				msg.m_type = MidiMessage::QUARTER_FRAME;
 				msg.m_nData1 = buffer[1];
 				msg.m_nData2 = buffer[2];
 				msg.m_nChannel = 0;
-				handleMidiMessage(msg);
+				JackMidiInEvent(msg);
 				break;
 			case 0xF2:
 				msg.m_type = MidiMessage::SONG_POS;
 				msg.m_nData1 = buffer[1];
 				msg.m_nData2 = buffer[2];
 				msg.m_nChannel = 0;
-				handleMidiMessage(msg);
+				JackMidiInEvent(msg);
+				break;
+			case 0xF8:
+				msg.m_type = MidiMessage::TIMING_CLOCK;
+				msg.m_nChannel = 0;
+				JackMidiInEvent(msg);
 				break;
 			case 0xFA:
 				msg.m_type = MidiMessage::START;
 				msg.m_nData1 = buffer[1];
 				msg.m_nData2 = buffer[2];
 				msg.m_nChannel = 0;
-				handleMidiMessage(msg);
+				JackMidiInEvent(msg);
 				break;
 			case 0xFB:
 				msg.m_type = MidiMessage::CONTINUE;
 				msg.m_nData1 = buffer[1];
 				msg.m_nData2 = buffer[2];
 				msg.m_nChannel = 0;
-				handleMidiMessage(msg);
+				JackMidiInEvent(msg);
 				break;
 			case 0xFC:
 				msg.m_type = MidiMessage::STOP;
 				msg.m_nData1 = buffer[1];
 				msg.m_nData2 = buffer[2];
 				msg.m_nChannel = 0;
-				handleMidiMessage(msg);
+				JackMidiInEvent(msg);
 				break;
 			default:
 				break;
@@ -198,14 +214,69 @@ JackMidiDriver::JackMidiWrite(jack_nframes_t nframes)
 	}
 }
 
+void
+JackMidiDriver::JackMidiInEvent(MidiMessage& msg)
+{
+	if (msg.m_nFrame >= 0 &&
+		(msg.m_type == MidiMessage::NOTE_ON || msg.m_type == MidiMessage::NOTE_OFF))
+		msg.m_bNotePosted = JackMidiPostNote(msg);
+
+	/* nothing else is handled here: the actions load songs, lock the engine and log */
+	if (in_events.push(msg))
+		sem_post(&in_sem);
+}
+
+bool
+JackMidiDriver::JackMidiPostNote(const MidiMessage& msg)
+{
+	Preferences *pref = Preferences::get_instance();
+
+	if (pref->m_nMidiChannelFilter != -1 &&
+		pref->m_nMidiChannelFilter != msg.m_nChannel)
+		return (false);
+
+	if (msg.m_type == MidiMessage::NOTE_OFF || msg.m_nData2 == 0) {
+		if (pref->m_bMidiNoteOffIgnore)
+			return (true);
+		return (postNote(msg, true));
+	}
+
+	/* the input thread looks up the action of the note first */
+	if (pref->m_bMidiDiscardNoteAfterAction)
+		return (false);
+	return (postNote(msg, false));
+}
+
+void
+JackMidiDriver::JackMidiInput()
+{
+	MidiMessage msg;
+
+	while (in_quit == 0) {
+		if (!in_events.pop(msg)) {
+			/* posted by the process callback after each event */
+			sem_wait(&in_sem);
+			continue;
+		}
+		handleMidiMessage(msg);
+	}
+}
+
+static void *
+JackMidiInputThread(void *arg)
+{
+	((JackMidiDriver *)arg)->JackMidiInput();
+	return (NULL);
+}
+
 void
 JackMidiDriver::JackMidiRead(jack_nframes_t nframes)
 {
 	uint8_t *buffer;
 	void *buf;
-	jack_nframes_t t;
-	uint8_t data[1];
-	uint8_t len;
+	int events;
+	int i;
+	int j;
 
 	if (output_port == NULL)
 		return;
@@ -220,63 +291,66 @@ JackMidiDriver::JackMidiRead(jack_nframes_t nframes)
 	jack_midi_clear_buffer(buf);
 #endif
 
-	t = 0;
-	lock();
-	while ((t < nframes) &&
-		   (rx_out_pos != rx_in_pos)) {
-
-				len = jack_buffer[4 * rx_in_pos];
-		if (len == 0) {
-			rx_in_pos++;
-			if (rx_in_pos >= JACK_MIDI_BUFFER_MAX)
-				rx_in_pos = 0;
-			continue;
-		}
+	/* take the events of the cycle out of the ring */
+	events = 0;
+	while (events < JACK_MIDI_BUFFER_MAX) {
+		int pos = out_read_pos;
+		int slot = pos & (JACK_MIDI_BUFFER_MAX - 1);
+		if (out_sequence[slot] != pos + 1)
+			break;	/* empty, or the producer is not done yet */
+
+		OutEvent ev = out_events[slot];
+		out_sequence[slot].fetchAndStoreRelease(pos + JACK_MIDI_BUFFER_MAX);
+		out_read_pos = pos + 1;
+
+		if (ev.offset >= nframes)
+			ev.offset = nframes - 1;
+
+		/* insertion sort, events with the same offset keep their order */
+		for (j = events; j > 0 && cycle_events[j - 1].offset > ev.offset; j--)
+			cycle_events[j] = cycle_events[j - 1];
+		cycle_events[j] = ev;
+		events++;
+	}
 
+	for (i = 0; i < events; i++) {
 #ifdef JACK_MIDI_NEEDS_NFRAMES
-		buffer = jack_midi_event_reserve(buf, t, len, nframes);
+		buffer = jack_midi_event_reserve(buf, cycle_events[i].offset, cycle_events[i].len, nframes);
 #else
-		buffer = jack_midi_event_reserve(buf, t, len);
+		buffer = jack_midi_event_reserve(buf, cycle_events[i].offset, cycle_events[i].len);
 #endif
 		if (buffer == NULL)
 			break;
-		t++;
-		rx_in_pos++;
-		if (rx_in_pos >= JACK_MIDI_BUFFER_MAX)
-			rx_in_pos = 0;
-		memcpy(buffer, jack_buffer + (4 * rx_in_pos) + 1, len);
+		memcpy(buffer, cycle_events[i].data, cycle_events[i].len);
 	}
-	unlock();
 }
 
 void
-JackMidiDriver::JackMidiOutEvent(uint8_t buf[4], uint8_t len)
+JackMidiDriver::JackMidiOutEvent(uint8_t *buf, uint8_t len, jack_nframes_t offset)
 {
-	uint32_t next_pos;
-
-	lock();
+	int pos;
+	int slot;
 
-	next_pos = rx_out_pos + 1;
-	if (next_pos >= JACK_MIDI_BUFFER_MAX)
-		next_pos = 0;
-
-	if (next_pos == rx_in_pos) {
-		/* buffer is full */
-		unlock();
+	if (len > JACK_MIDI_EVENT_MAX)
 		return;
-	}
 
-	if (len > 3)
-		len = 3;
-
-		jack_buffer[(4 * next_pos)] = len;
-		jack_buffer[(4 * next_pos) + 1] = buf[0];
-		jack_buffer[(4 * next_pos) + 2] = buf[1];
-		jack_buffer[(4 * next_pos) + 3] = buf[2];
+	/* claim a slot, give up if the ring is full */
+	for (;;) {
+		pos = out_write_pos;
+		slot = pos & (JACK_MIDI_BUFFER_MAX - 1);
+		int diff = out_sequence[slot] - pos;
+		if (diff < 0)
+			return;
+		if (diff == 0 && out_write_pos.testAndSetOrdered(pos, pos + 1))
+			break;
+	}
 
-	rx_out_pos = next_pos;
+	OutEvent& ev = out_events[slot];
+	memcpy(ev.data, buf, len);
+	ev.len = len;
+	ev.offset = offset;
 
-	unlock();
+	out_sequence[slot].fetchAndStoreRelease(pos + 1);
 }
 
 static int
@@ -303,38 +377,51 @@ JackMidiShutdown(void *arg)
 JackMidiDriver::JackMidiDriver()
 	: MidiInput( __class_name ), MidiOutput( __class_name ), Object( __class_name )
 {
-	pthread_mutex_init(&mtx, NULL);
-
 	running = 0;
-	rx_in_pos = 0;
-	rx_out_pos = 0;
 	output_port = 0;
 	input_port = 0;
-
-	QString jackMidiClientId = "hydrogen";
+	jack_output = NULL;
+	out_read_pos = 0;
+	for (int i = 0; i < JACK_MIDI_BUFFER_MAX; i++)
+		out_sequence[i].fetchAndStoreOrdered(i);
+	in_message.m_sysexData.reserve(MidiEventQueue::SYSEX_SIZE);
+	in_quit = 0;
+	sem_init(&in_sem, 0, 0);
+	pthread_create(&in_thread, NULL, JackMidiInputThread, this);
+
+	/* share the client of the audio driver when there is one */
+	AudioOutput *pAudioOutput = Hydrogen::get_instance()->getAudioOutput();
+	if (pAudioOutput != NULL &&
+		pAudioOutput->class_name() == JackOutput::class_name() &&
+		static_cast<JackOutput *>(pAudioOutput)->client != NULL) {
+		jack_output = static_cast<JackOutput *>(pAudioOutput);
+		jack_client = jack_output->client;
+	} else {
+		QString jackMidiClientId = "hydrogen";
 
 #ifdef H2CORE_HAVE_NSMSESSION
-	Preferences* pref = Preferences::get_instance();
-	QString nsmClientId = pref->getNsmClientId();
+		Preferences* pref = Preferences::get_instance();
+		QString nsmClientId = pref->getNsmClientId();
 
-	if(!nsmClientId.isEmpty()){
-		jackMidiClientId = nsmClientId;
-	}
+		if(!nsmClientId.isEmpty()){
+			jackMidiClientId = nsmClientId;
+		}
 #endif
 
-	jackMidiClientId.append("-midi");
+		jackMidiClientId.append("-midi");
 
-	jack_client = jack_client_open(jackMidiClientId.toLocal8Bit(),
-		JackNoStartServer, NULL);
+		jack_client = jack_client_open(jackMidiClientId.toLocal8Bit(),
+			JackNoStartServer, NULL);
 
-	if (jack_client == NULL)
-		return;
+		if (jack_client == NULL)
+			return;
 
-	jack_set_process_callback(jack_client,
-		JackMidiProcessCallback, this);
+		jack_set_process_callback(jack_client,
+			JackMidiProcessCallback, this);
 
-	jack_on_shutdown(jack_client,
-		JackMidiShutdown, 0);
+		jack_on_shutdown(jack_client,
+			JackMidiShutdown, 0);
+	}
 
 	output_port = jack_port_register(
 		jack_client, "TX", JACK_DEFAULT_MIDI_TYPE,
@@ -344,11 +431,24 @@ JackMidiDriver::JackMidiDriver()
 		jack_client, "RX", JACK_DEFAULT_MIDI_TYPE,
 		JackPortIsInput, 0);
 
-	jack_activate(jack_client);
+	if (jack_output != NULL)
+		jack_output->setMidiDriver(this);
+	else
+		jack_activate(jack_client);
 }
 
 JackMidiDriver::~JackMidiDriver()
 {
+	if (jack_output != NULL) {
+		jack_output->setMidiDriver(NULL);
+		/* the client is gone if the server shut down */
+		jack_client = jack_output->client;
+	}
+
+	in_quit.fetchAndStoreOrdered(1);
+	sem_post(&in_sem);
+	pthread_join(in_thread, NULL);
+	sem_destroy(&in_sem);
 
 	if (jack_client != NULL)
 	{
@@ -360,17 +460,16 @@ JackMidiDriver::~JackMidiDriver()
 			ERRORLOG("Failed to unregister jack midi input out");
 		}
 
-		//jack_port_unregister( jack_client, output_port);
-		if( jack_deactivate(jack_client) != 0){
-			ERRORLOG("Failed to unregister jack midi input out");
-		}
+		if (jack_output == NULL) {
+			if( jack_deactivate(jack_client) != 0){
+				ERRORLOG("Failed to unregister jack midi input out");
+			}
 
-		if( jack_client_close(jack_client) != 0){
-			ERRORLOG("Failed close jack midi client");
+			if( jack_client_close(jack_client) != 0){
+				ERRORLOG("Failed close jack midi client");
+			}
 		}
 	}
-	pthread_mutex_destroy(&mtx);
-
 }
 
 void
@@ -408,7 +507,7 @@ JackMidiDriver::getPortInfo(const QString& sPortName, int& nClient, int& nPort)
 	nPort = 0;
 }
 
-void JackMidiDriver::handleQueueNote(Note* pNote)
+void JackMidiDriver::handleQueueNote(Note* pNote, unsigned nFrameOffset)
 {
 
 	uint8_t buffer[4];
@@ -433,18 +532,18 @@ void JackMidiDriver::handleQueueNote(Note* pNote)
 	buffer[2] = 0;
 	buffer[3] = 0;
 
-	JackMidiOutEvent(buffer, 3);
+	JackMidiOutEvent(buffer, 3, nFrameOffset);
 
 	buffer[0] = 0x90 | channel;	/* note on */
 	buffer[1] = key;
 	buffer[2] = vel;
 	buffer[3] = 0;
 
-	JackMidiOutEvent(buffer, 3);
+	JackMidiOutEvent(buffer, 3, nFrameOffset);
 }
 
 void
-JackMidiDriver::handleQueueNoteOff(int channel, int key, int vel)
+JackMidiDriver::handleQueueNoteOff(int channel, int key, int vel, unsigned nFrameOffset)
 {
 	uint8_t buffer[4];
 
@@ -460,7 +559,16 @@ JackMidiDriver::handleQueueNoteOff(int channel, int key, int vel)
 	buffer[2] = 0;
 	buffer[3] = 0;
 
-	JackMidiOutEvent(buffer, 3);
+	JackMidiOutEvent(buffer, 3, nFrameOffset);
+}
+
+void
+JackMidiDriver::handleQueueSystemMessage(const unsigned char *pData, unsigned nLength, unsigned nFrameOffset)
+{
+	if (nLength == 0 || nLength > JACK_MIDI_EVENT_MAX)
+		return;
+
+	JackMidiOutEvent((uint8_t *)pData, nLength, nFrameOffset);
 }
 
 void JackMidiDriver::handleQueueAllNoteOff()
@@ -482,7 +590,7 @@ void JackMidiDriver::handleQueueAllNoteOff()
 		if (key < 0 || key > 127)
 			continue;
 
-		handleQueueNoteOff(channel, key, 0);
+		handleQueueNoteOff(channel, key, 0, 0);
 	}
 }
 
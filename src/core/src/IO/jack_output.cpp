@@ -23,6 +23,8 @@
 #include <hydrogen/IO/JackOutput.h>
 #ifdef H2CORE_HAVE_JACK
 
+#include <hydrogen/IO/JackMidiDriver.h>
+
 #include <sys/types.h>
 #include <unistd.h>
 #include <cstdlib>
@@ -70,6 +72,11 @@ int jackDriverBufferSize( jack_nframes_t nframes, void * /*arg*/ )
 	return 0;
 }
 
+int jackDriverProcess( jack_nframes_t nframes, void *arg )
+{
+	return static_cast<JackOutput*>( arg )->process( nframes );
+}
+
 void jackDriverShutdown( void *arg )
 {
 	UNUSED( arg );
@@ -89,20 +96,50 @@ JackOutput::JackOutput( JackProcessCallback processCallback )
 
 	jackDriverInstance = this;
 	this->processCallback = processCallback;
+	m_pMidiDriver = NULL;
+	pthread_mutex_init( &m_midiMutex, NULL );
 
 	must_relocate = 0;
 	locate_countdown = 0;
 	bbt_frame_offset = 0;
 	track_port_count = 0;
 
-	memset( track_output_ports_L, 0, sizeof(track_output_ports_L) );
-	memset( track_output_ports_R, 0, sizeof(track_output_ports_R) );
+	memset( track_map, -1, sizeof(track_map) );
+	resetTrackOutputs();
 }
 
 JackOutput::~JackOutput()
 {
 	INFOLOG( "DESTROY" );
 	disconnect();
+	pthread_mutex_destroy( &m_midiMutex );
+}
+
+void JackOutput::setMidiDriver( JackMidiDriver* pMidiDriver )
+{
+	pthread_mutex_lock( &m_midiMutex );
+	m_pMidiDriver = pMidiDriver;
+	pthread_mutex_unlock( &m_midiMutex );
+}
+
+int JackOutput::process( jack_nframes_t nframes )
+{
+	// the MIDI driver is only (de)attached when the drivers are (re)started,
+	// skip MIDI for this cycle rather than wait
+	if ( pthread_mutex_trylock( &m_midiMutex ) != 0 ) {
+		return processCallback( nframes, 0 );
+	}
+
+	if ( m_pMidiDriver ) {
+		m_pMidiDriver->JackMidiWrite( nframes );
+	}
+	int res = processCallback( nframes, 0 );
+	if ( m_pMidiDriver ) {
+		m_pMidiDriver->JackMidiRead( nframes );
+	}
+
+	pthread_mutex_unlock( &m_midiMutex );
+	return res;
 }
 
 // return 0: ok
@@ -122,8 +159,7 @@ int JackOutput::connect()
 
 	bool connect_output_ports = m_bConnectOutFlag;
 
-	memset( track_output_ports_L, 0, sizeof(track_output_ports_L) );
-	memset( track_output_ports_R, 0, sizeof(track_output_ports_R) );
+	resetTrackOutputs();
 
 #ifdef H2CORE_HAVE_LASH
 	if ( Preferences::get_instance()->useLash() ){
@@ -196,8 +232,7 @@ void JackOutput::deactivate()
 			ERRORLOG( "Error in jack_deactivate" );
 		}
 	}
-	memset( track_output_ports_L, 0, sizeof(track_output_ports_L) );
-	memset( track_output_ports_R, 0, sizeof(track_output_ports_R) );
+	resetTrackOutputs();
 }
 
 unsigned JackOutput::getBufferSize()
@@ -417,36 +452,72 @@ float* JackOutput::getOut_R()
 	return out;
 }
 
-float* JackOutput::getTrackOut_L( unsigned nTrack )
+void JackOutput::resetTrackOutputs()
 {
-	if(nTrack > (unsigned)track_port_count ) return 0;
-	jack_port_t *p = track_output_ports_L[nTrack];
-	jack_default_audio_sample_t* out = 0;
-	if( p ) {
-		out = (jack_default_audio_sample_t*) jack_port_get_buffer( p, jack_server_bufferSize);
+	memset( track_output_ports_L, 0, sizeof(track_output_ports_L) );
+	memset( track_output_ports_R, 0, sizeof(track_output_ports_R) );
+	memset( track_buffers_L, 0, sizeof(track_buffers_L) );
+	memset( track_buffers_R, 0, sizeof(track_buffers_R) );
+	for ( int n = 0; n < MAX_INSTRUMENTS; n++ ) {
+		track_written[n] = true;
 	}
-	return out;
 }
 
-float* JackOutput::getTrackOut_R( unsigned nTrack )
+void JackOutput::prepareTrackOutputs( unsigned nFrames )
 {
-	if(nTrack > (unsigned)track_port_count ) return 0;
-	jack_port_t *p = track_output_ports_R[nTrack];
-	jack_default_audio_sample_t* out = 0;
-	if( p ) {
-		out = (jack_default_audio_sample_t*) jack_port_get_buffer( p, jack_server_bufferSize);
+	for ( int n = 0; n < track_port_count; n++ ) {
+		float *pBuf_L = 0, *pBuf_R = 0;
+		if ( track_output_ports_L[n] && track_output_ports_R[n] ) {
+			pBuf_L = (float*) jack_port_get_buffer( track_output_ports_L[n], nFrames );
+			pBuf_R = (float*) jack_port_get_buffer( track_output_ports_R[n], nFrames );
+		}
+		// a buffer we haven't seen before holds garbage
+		if ( track_written[n] || pBuf_L != track_buffers_L[n] || pBuf_R != track_buffers_R[n] ) {
+			if ( pBuf_L ) {
+				memset( pBuf_L, 0, nFrames * sizeof( float ) );
+			}
+			if ( pBuf_R ) {
+				memset( pBuf_R, 0, nFrames * sizeof( float ) );
+			}
+			track_written[n] = false;
+		}
+		track_buffers_L[n] = pBuf_L;
+		track_buffers_R[n] = pBuf_R;
 	}
-	return out;
+}
+
+int JackOutput::getTrack( Instrument * instr, InstrumentComponent * pCompo )
+{
+	int nInstr = instr->get_id();
+	int nCompo = pCompo->get_drumkit_componentID();
+	if ( nInstr < 0 || nInstr >= MAX_INSTRUMENTS || nCompo < 0 || nCompo >= MAX_COMPONENTS ) {
+		return -1;
+	}
+	int nTrack = track_map[nInstr][nCompo];
+	if ( nTrack >= track_port_count ) {
+		return -1;
+	}
+	return nTrack;
 }
 
 float* JackOutput::getTrackOut_L( Instrument * instr, InstrumentComponent * pCompo)
 {
-	return getTrackOut_L(track_map[instr->get_id()][pCompo->get_drumkit_componentID()]);
+	int nTrack = getTrack( instr, pCompo );
+	if ( nTrack < 0 ) {
+		return 0;
+	}
+	track_written[nTrack] = true;
+	return track_buffers_L[nTrack];
 }
 
 float* JackOutput::getTrackOut_R( Instrument * instr, InstrumentComponent * pCompo)
 {
-	return getTrackOut_R(track_map[instr->get_id()][pCompo->get_drumkit_componentID()]);
+	int nTrack = getTrack( instr, pCompo );
+	if ( nTrack < 0 ) {
+		return 0;
+	}
+	track_written[nTrack] = true;
+	return track_buffers_R[nTrack];
 }
 
 
@@ -571,7 +642,7 @@ int JackOutput::init( unsigned /*nBufferSize*/ )
 	/* tell the JACK server to call `process()' whenever
 	   there is work to be done.
 	*/
-	jack_set_process_callback ( client, this->processCallback, 0 );
+	jack_set_process_callback ( client, jackDriverProcess, this );
 
 	/* tell the JACK server to call `srate()' whenever
 	   the sample rate of the system changes.
@@ -644,16 +715,23 @@ void JackOutput::makeTrackOutputs( Song * song )
 
 	int p_trackCount = 0;
 
-	for( int i = 0 ; i < MAX_INSTRUMENTS ; i++ ){
-		for ( int j = 0 ; j < MAX_COMPONENTS ; j++ ){
-			track_map[i][j] = 0;
-		}
-	}
+	memset( track_map, -1, sizeof(track_map) );
 
 	for ( int n = nInstruments - 1; n >= 0; n-- ) {
 		instr = instruments->get( n );
+		if ( instr->get_id() < 0 || instr->get_id() >= MAX_INSTRUMENTS ) {
+			ERRORLOG( QString( "No track output for instrument id %1" ).arg( instr->get_id() ) );
+			continue;
+		}
 		for (std::vector<InstrumentComponent*>::iterator it = instr->get_components()->begin() ; it != instr->get_components()->end(); ++it) {
 			InstrumentComponent* pCompo = *it;
+			if ( pCompo->get_drumkit_componentID() < 0 || pCompo->get_drumkit_componentID() >= MAX_COMPONENTS ) {
+				continue;
+			}
+			if ( p_trackCount >= MAX_INSTRUMENTS ) {
+				ERRORLOG( QString( "Too many track outputs, max %1" ).arg( MAX_INSTRUMENTS ) );
+				break;
+			}
 			setTrackOutput( p_trackCount, instr , pCompo, song);
 			track_map[instr->get_id()][pCompo->get_drumkit_componentID()] = p_trackCount;
 			p_trackCount++;
@@ -671,6 +749,11 @@ void JackOutput::makeTrackOutputs( Song * song )
 	}
 
 	track_port_count = p_trackCount;
+
+	// renamed tracks must start from silence
+	for ( int n = 0; n < MAX_INSTRUMENTS; n++ ) {
+		track_written[n] = true;
+	}
 }
 
 /**
@@ -751,6 +834,14 @@ void JackOutput::setBpm( float fBPM )
 	m_transport.m_nBPM = fBPM;
 }
 
+uint32_t JackOutput::getCycleFrameTime()
+{
+	if ( client == NULL ) {
+		return 0;
+	}
+	return jack_last_frame_time( client );
+}
+
 int JackOutput::getNumTracks()
 {
 	//	INFOLOG( "get num tracks()" );
@@ -0,0 +1,201 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/IO/MidiClockGenerator.h>
+#include <hydrogen/IO/MidiOutput.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace H2Core
+{
+
+const char* MidiClockGenerator::__class_name = "MidiClockGenerator";
+
+/// MTC rate code of MTC_FPS
+static const int nMtcRate = 1;
+
+MidiClockGenerator::MidiClockGenerator()
+	: Object( __class_name )
+	, m_bClockEnabled( false )
+	, m_bTimecodeEnabled( false )
+	, m_bClockRunning( false )
+	, m_fNextTick( 0.0 )
+	, m_nNextPulse( 0 )
+	, m_bTimecodeRunning( false )
+	, m_nNextFrame( 0 )
+	, m_nNextQuarterFrame( 0 )
+{
+}
+
+MidiClockGenerator::~MidiClockGenerator()
+{
+}
+
+static inline void sendMessage( MidiOutput* pOut, unsigned char nStatus, unsigned nOffset )
+{
+	pOut->handleQueueSystemMessage( &nStatus, 1, nOffset );
+}
+
+void MidiClockGenerator::process( MidiOutput* pOut, bool bPlaying, long long nFrame, float fTickSize,
+								  int nResolution, unsigned nFrames, unsigned nSampleRate )
+{
+	if ( pOut == NULL || nFrames == 0 ) {
+		return;
+	}
+
+	if ( fTickSize > 0 && nResolution > 0 ) {
+		double fTickStart = nFrame / fTickSize;
+		double fTickEnd = ( nFrame + nFrames ) / fTickSize;
+		processClock( pOut, bPlaying, fTickStart, fTickEnd, fTickSize, nResolution, nFrames );
+	}
+	processTimecode( pOut, bPlaying, nFrame, nFrames, nSampleRate );
+}
+
+void MidiClockGenerator::processClock( MidiOutput* pOut, bool bPlaying, double fTickStart, double fTickEnd,
+									   float fTickSize, int nResolution, unsigned nFrames )
+{
+	bool bClock = bPlaying && m_bClockEnabled;
+	double fTicksPerPulse = ( double )nResolution / PULSES_PER_QUARTER;
+
+	/*
+	 * A tempo change moves the position to the next tick, anything
+	 * further away is a relocation.
+	 */
+	if ( m_bClockRunning
+		 && ( !bClock || fabs( fTickStart - m_fNextTick ) > fTicksPerPulse + 1.0 ) ) {
+		sendMessage( pOut, 0xFC, 0 );	// stop
+		m_bClockRunning = false;
+	}
+	if ( !bClock ) {
+		return;
+	}
+
+	if ( !m_bClockRunning ) {
+		long long nPulse = ( long long )ceil( fTickStart / fTicksPerPulse - 1e-6 );
+		if ( nPulse <= 0 ) {
+			sendMessage( pOut, 0xFA, 0 );	// start
+			m_nNextPulse = 0;
+		} else {
+			// the slave starts at the song position, on the next sixteenth
+			int nBeat = ( int )std::min( ( nPulse + PULSES_PER_BEAT - 1 ) / PULSES_PER_BEAT, 0x3FFFLL );
+			unsigned char songPosition[3] = { 0xF2, ( unsigned char )( nBeat & 0x7F ), ( unsigned char )( ( nBeat >> 7 ) & 0x7F ) };
+			pOut->handleQueueSystemMessage( songPosition, 3, 0 );
+			sendMessage( pOut, 0xFB, 0 );	// continue
+			m_nNextPulse = ( long long )nBeat * PULSES_PER_BEAT;
+		}
+		m_bClockRunning = true;
+	}
+
+	for ( ;; ) {
+		double fPulseTick = m_nNextPulse * fTicksPerPulse;
+		if ( fPulseTick >= fTickEnd ) {
+			break;
+		}
+		unsigned nOffset = 0;
+		if ( fPulseTick > fTickStart ) {
+			nOffset = std::min( ( unsigned )( ( fPulseTick - fTickStart ) * fTickSize + 0.5 ), nFrames - 1 );
+		}
+		sendMessage( pOut, 0xF8, nOffset );	// clock
+		++m_nNextPulse;
+	}
+	m_fNextTick = fTickEnd;
+}
+
+/// split an MTC frame count into hours, minutes, seconds and frames
+static void timecode( long long nTimecodeFrame, int& nHours, int& nMinutes, int& nSeconds, int& nFrames )
+{
+	const int nFps = MidiClockGenerator::MTC_FPS;
+	nFrames = nTimecodeFrame % nFps;
+	nSeconds = ( nTimecodeFrame / nFps ) % 60;
+	nMinutes = ( nTimecodeFrame / ( nFps * 60 ) ) % 60;
+	nHours = ( nTimecodeFrame / ( nFps * 3600 ) ) % 24;
+}
+
+void MidiClockGenerator::processTimecode( MidiOutput* pOut, bool bPlaying, long long nFrame,
+										  unsigned nFrames, unsigned nSampleRate )
+{
+	bool bTimecode = bPlaying && m_bTimecodeEnabled && nSampleRate > 0 && nFrame >= 0;
+	if ( m_bTimecodeRunning && ( !bTimecode || nFrame != m_nNextFrame ) ) {
+		m_bTimecodeRunning = false;
+	}
+	if ( !bTimecode ) {
+		return;
+	}
+
+	double fQuarterFrameLength = nSampleRate / ( 4.0 * MTC_FPS );	// in audio frames
+	if ( !m_bTimecodeRunning ) {
+		sendFullFrame( pOut, ( long long )( nFrame / ( 4.0 * fQuarterFrameLength ) ) );
+		m_nNextQuarterFrame = ( long long )ceil( nFrame / fQuarterFrameLength );
+		m_bTimecodeRunning = true;
+	}
+
+	for ( ;; ) {
+		double fQuarterFrame = m_nNextQuarterFrame * fQuarterFrameLength;
+		if ( fQuarterFrame >= nFrame + nFrames ) {
+			break;
+		}
+		unsigned nOffset = 0;
+		if ( fQuarterFrame > nFrame ) {
+			nOffset = std::min( ( unsigned )( fQuarterFrame - nFrame + 0.5 ), nFrames - 1 );
+		}
+
+		// the eight pieces carry the time of the frame of the first one
+		int nPiece = m_nNextQuarterFrame % 8;
+		int nHours, nMinutes, nSeconds, nTimecodeFrames;
+		timecode( ( m_nNextQuarterFrame - nPiece ) / 4, nHours, nMinutes, nSeconds, nTimecodeFrames );
+
+		int nValue = 0;
+		switch ( nPiece ) {
+		case 0: nValue = nTimecodeFrames & 0xF; break;
+		case 1: nValue = nTimecodeFrames >> 4; break;
+		case 2: nValue = nSeconds & 0xF; break;
+		case 3: nValue = nSeconds >> 4; break;
+		case 4: nValue = nMinutes & 0xF; break;
+		case 5: nValue = nMinutes >> 4; break;
+		case 6: nValue = nHours & 0xF; break;
+		case 7: nValue = ( nHours >> 4 ) | ( nMtcRate << 1 ); break;
+		}
+		unsigned char quarterFrame[2] = { 0xF1, ( unsigned char )( ( nPiece << 4 ) | nValue ) };
+		pOut->handleQueueSystemMessage( quarterFrame, 2, nOffset );
+		++m_nNextQuarterFrame;
+	}
+	m_nNextFrame = nFrame + nFrames;
+}
+
+void MidiClockGenerator::sendFullFrame( MidiOutput* pOut, long long nTimecodeFrame )
+{
+	int nHours, nMinutes, nSeconds, nFrames;
+	timecode( nTimecodeFrame, nHours, nMinutes, nSeconds, nFrames );
+
+	unsigned char fullFrame[10] = {
+		0xF0, 0x7F, 0x7F, 0x01, 0x01,
+		( unsigned char )( ( nMtcRate << 5 ) | nHours ),
+		( unsigned char )nMinutes,
+		( unsigned char )nSeconds,
+		( unsigned char )nFrames,
+		0xF7
+	};
+	pOut->handleQueueSystemMessage( fullFrame, 10, 0 );
+}
+
+};
@@ -0,0 +1,225 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/IO/MidiClockSlave.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace H2Core
+{
+
+const char* MidiClockSlave::__class_name = "MidiClockSlave";
+
+/// frame rates of the MTC rate codes, drop frame is counted as 30 fps
+static const int mtcFps[ 4 ] = { 24, 25, 30, 30 };
+
+MidiClockSlave::MidiClockSlave()
+	: Object( __class_name )
+	, m_fBandwidth( 0.5 )
+	, m_fT0( 0.0 )
+	, m_fT1( 0.0 )
+	, m_fE2( 0.0 )
+	, m_nPulses( 0 )
+	, m_bRunning( false )
+	, m_nPosition( 0 )
+	, m_nNextPiece( -1 )
+	, m_nFps( 25 )
+	, m_nSequence( 0 )
+{
+	memset( m_pieces, 0, sizeof( m_pieces ) );
+	m_state.bRunning = false;
+	m_state.fPosition = 0.0;
+	m_state.fTime = 0.0;
+	m_state.fPeriod = 0.0;
+	m_state.nFps = m_nFps;
+	publish();
+}
+
+MidiClockSlave::~MidiClockSlave()
+{
+}
+
+void MidiClockSlave::start()
+{
+	m_bRunning = true;
+	m_nPosition = 0;
+	// the master starts on the next pulse
+	m_state.bRunning = false;
+	publish();
+}
+
+void MidiClockSlave::cont()
+{
+	m_bRunning = true;
+	m_state.bRunning = false;
+	publish();
+}
+
+void MidiClockSlave::stop()
+{
+	m_bRunning = false;
+	m_state.bRunning = false;
+	publish();
+}
+
+void MidiClockSlave::songPosition( int nBeats )
+{
+	m_nPosition = ( long long )nBeats * PULSES_PER_BEAT;
+}
+
+void MidiClockSlave::clock( double fTime )
+{
+	pulse( fTime );
+	if ( m_bRunning ) {
+		m_state.fPosition = m_nPosition++;
+		m_state.bRunning = true;
+	}
+	m_state.fTime = m_fT0;
+	m_state.fPeriod = m_fE2;
+	publish();
+}
+
+void MidiClockSlave::quarterFrame( int nData, double fTime )
+{
+	pulse( fTime );
+
+	int nPiece = ( nData >> 4 ) & 7;
+	if ( nPiece == 0 || nPiece == m_nNextPiece ) {
+		m_pieces[ nPiece ] = nData & 0xF;
+		m_nNextPiece = nPiece + 1;
+	} else {
+		m_nNextPiece = -1;
+	}
+
+	if ( m_bRunning ) {
+		m_state.fPosition = m_nPosition++;
+		m_state.bRunning = true;
+	}
+
+	if ( nPiece == 7 && m_nNextPiece == 8 ) {
+		// the eight pieces carry the time of the frame of the first one
+		m_nFps = mtcFps[ ( m_pieces[ 7 ] >> 1 ) & 3 ];
+		int nFrames = m_pieces[ 0 ] | ( ( m_pieces[ 1 ] & 1 ) << 4 );
+		int nSeconds = m_pieces[ 2 ] | ( ( m_pieces[ 3 ] & 3 ) << 4 );
+		int nMinutes = m_pieces[ 4 ] | ( ( m_pieces[ 5 ] & 3 ) << 4 );
+		int nHours = m_pieces[ 6 ] | ( ( m_pieces[ 7 ] & 1 ) << 4 );
+		long long nQuarterFrame = ( ( ( ( long long )nHours * 60 + nMinutes ) * 60 + nSeconds ) * m_nFps + nFrames ) * 4 + 7;
+		if ( !m_bRunning || m_state.fPosition != nQuarterFrame ) {
+			m_state.fPosition = nQuarterFrame;
+			m_nPosition = nQuarterFrame + 1;
+			m_bRunning = true;
+			m_state.bRunning = true;
+		}
+		m_nNextPiece = -1;
+	}
+
+	m_state.fTime = m_fT0;
+	m_state.fPeriod = m_fE2;
+	m_state.nFps = m_nFps;
+	publish();
+}
+
+void MidiClockSlave::fullFrame( int nHours, int nMinutes, int nSeconds, int nFrames, int nRate )
+{
+	// the master located, the quarter frames start again from this frame
+	m_nFps = mtcFps[ nRate & 3 ];
+	m_nPosition = ( ( ( ( long long )nHours * 60 + nMinutes ) * 60 + nSeconds ) * m_nFps + nFrames ) * 4;
+	m_bRunning = true;
+	m_nPulses = 0;
+	m_nNextPiece = -1;
+	m_state.bRunning = false;
+	m_state.nFps = m_nFps;
+	publish();
+}
+
+void MidiClockSlave::pulse( double fTime )
+{
+	if ( m_nPulses == 0 ) {
+		m_fT0 = fTime;
+		m_fT1 = fTime + m_fE2;
+		m_nPulses = 1;
+		return;
+	}
+
+	if ( m_fE2 <= 0.0 ) {
+		// second pulse, first estimate of the period
+		if ( fTime > m_fT0 ) {
+			m_fE2 = fTime - m_fT0;
+		}
+		m_fT0 = fTime;
+		m_fT1 = fTime + m_fE2;
+		++m_nPulses;
+		return;
+	}
+
+	double fError = fTime - m_fT1;
+	if ( fabs( fError ) > 4 * m_fE2 ) {
+		// the pulses stopped for a while, restart with the last period
+		m_fT0 = fTime;
+		m_fT1 = fTime + m_fE2;
+		m_nPulses = 1;
+		return;
+	}
+
+	// lock faster during the first seconds
+	double fBandwidth = m_nPulses * m_fE2 < 2.0 ? 4 * m_fBandwidth : m_fBandwidth;
+	double fOmega = 2.0 * M_PI * fBandwidth * m_fE2;
+	m_fT0 = m_fT1;
+	m_fT1 += sqrt( 2.0 ) * fOmega * fError + m_fE2;
+	m_fE2 += fOmega * fOmega * fError;
+	++m_nPulses;
+}
+
+void MidiClockSlave::publish()
+{
+	m_nSequence.fetchAndAddOrdered( 1 );
+	m_publishedState = m_state;
+	m_nSequence.fetchAndAddOrdered( 1 );
+}
+
+MidiClockSlave::State MidiClockSlave::read()
+{
+	State state;
+	int nSequence;
+	do {
+		nSequence = m_nSequence.fetchAndAddOrdered( 0 );
+		state = m_publishedState;
+	} while ( ( nSequence & 1 ) || nSequence != m_nSequence.fetchAndAddOrdered( 0 ) );
+	return state;
+}
+
+double MidiClockSlave::position( const State& state, double fTime )
+{
+	if ( state.fPeriod <= 0.0 ) {
+		return state.fPosition;
+	}
+	// do not run ahead of a master which stopped sending
+	return state.fPosition + std::min( ( fTime - state.fTime ) / state.fPeriod, 1.0 );
+}
+
+};
@@ -0,0 +1,89 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/IO/MidiEventQueue.h>
+
+#include <algorithm>
+
+namespace H2Core
+{
+
+const char* MidiEventQueue::__class_name = "MidiEventQueue";
+
+MidiEventQueue::MidiEventQueue()
+	: Object( __class_name )
+	, m_nWrite( 0 )
+	, m_nRead( 0 )
+{
+}
+
+MidiEventQueue::~MidiEventQueue()
+{
+}
+
+bool MidiEventQueue::push( const MidiMessage& msg )
+{
+	int nWrite = m_nWrite.fetchAndAddOrdered( 0 );
+	int nRead = m_nRead.fetchAndAddOrdered( 0 );
+	if ( ( ( nWrite - nRead ) & ( 2 * SIZE - 1 ) ) == SIZE ) {
+		return false;
+	}
+
+	Event& event = m_events[ nWrite & ( SIZE - 1 ) ];
+	event.type = msg.m_type;
+	event.nData1 = msg.m_nData1;
+	event.nData2 = msg.m_nData2;
+	event.nChannel = msg.m_nChannel;
+	event.fTime = msg.m_fTime;
+	event.nFrame = msg.m_nFrame;
+	event.bNotePosted = msg.m_bNotePosted;
+	event.nSysexLength = std::min( ( unsigned )msg.m_sysexData.size(), ( unsigned )SYSEX_SIZE );
+	for ( unsigned i = 0; i < event.nSysexLength; ++i ) {
+		event.sysex[ i ] = msg.m_sysexData[ i ];
+	}
+
+	m_nWrite.fetchAndStoreOrdered( ( nWrite + 1 ) & ( 2 * SIZE - 1 ) );
+	return true;
+}
+
+bool MidiEventQueue::pop( MidiMessage& msg )
+{
+	int nRead = m_nRead.fetchAndAddOrdered( 0 );
+	if ( nRead == m_nWrite.fetchAndAddOrdered( 0 ) ) {
+		return false;
+	}
+
+	const Event& event = m_events[ nRead & ( SIZE - 1 ) ];
+	msg.m_type = event.type;
+	msg.m_nData1 = event.nData1;
+	msg.m_nData2 = event.nData2;
+	msg.m_nChannel = event.nChannel;
+	msg.m_fTime = event.fTime;
+	msg.m_nFrame = event.nFrame;
+	msg.m_bNotePosted = event.bNotePosted;
+	msg.m_sysexData.assign( event.sysex, event.sysex + event.nSysexLength );
+
+	m_nRead.fetchAndStoreOrdered( ( nRead + 1 ) & ( 2 * SIZE - 1 ) );
+	return true;
+}
+
+};
@@ -21,15 +21,13 @@
  */
 
 #include <hydrogen/IO/MidiInput.h>
+#include <hydrogen/IO/MidiClockSlave.h>
 #include <hydrogen/event_queue.h>
 #include <hydrogen/Preferences.h>
 #include <hydrogen/hydrogen.h>
-#include <hydrogen/basics/instrument.h>
-#include <hydrogen/basics/instrument_list.h>
-#include <hydrogen/basics/note.h>
 #include <hydrogen/midi_action.h>
-#include <hydrogen/audio_engine.h>
 #include <hydrogen/midi_map.h>
+#include <hydrogen/helpers/clock.h>
 
 namespace H2Core
 {
@@ -38,8 +36,6 @@ MidiInput::MidiInput( const char* class_name )
 		: Object( class_name )
 		, m_bActive( false )
 		, __hihat_cc_openess ( 127 )
-		, __noteOffTick( 0 )
-		, __noteOnTick( 0 )
 {
 	//INFOLOG( "INIT" );
 
@@ -53,6 +49,12 @@ MidiInput::~MidiInput()
 
 void MidiInput::handleMidiMessage( const MidiMessage& msg )
 {
+		// the clock pulses and the quarter frames come 24 to 120 times per second
+		if ( MidiMessage::TIMING_CLOCK == msg.m_type || MidiMessage::QUARTER_FRAME == msg.m_type ) {
+			handleSyncMessage( msg );
+			return;
+		}
+
 		EventQueue::get_instance()->push_event( EVENT_MIDI_ACTIVITY, -1 );
 
 		INFOLOG( "[start of handleMidiMessage]" );
@@ -85,6 +87,8 @@ void MidiInput::handleMidiMessage( const MidiMessage& msg )
 		if ( !bIsChannelValid) return;
 
 		Hydrogen* pHydrogen = Hydrogen::get_instance();
+		MidiClockSlave* pSlave = pHydrogen->getMidiClockSlave();
+		bool bClockSlave = pSlave && pPref->m_nMidiSyncInput == MidiClockSlave::SYNC_CLOCK;
 		switch ( type ) {
 		case MidiMessage::SYSEX:
 				handleSysexMessage( msg );
@@ -133,7 +137,9 @@ void MidiInput::handleMidiMessage( const MidiMessage& msg )
 
 		case MidiMessage::START: /* Start from position 0 */
 				INFOLOG( "START event" );
-				if ( pHydrogen->getState() != STATE_PLAYING ) {
+				if ( bClockSlave ) {
+					pSlave->start();
+				} else if ( pHydrogen->getState() != STATE_PLAYING ) {
 					pHydrogen->setPatternPos( 0 );
 					pHydrogen->setTimelineBpm();
 					pHydrogen->sequencer_play();
@@ -142,22 +148,26 @@ void MidiInput::handleMidiMessage( const MidiMessage& msg )
 
 		case MidiMessage::CONTINUE: /* Just start */
 				ERRORLOG( "CONTINUE event" );
-				if ( pHydrogen->getState() != STATE_PLAYING )
+				if ( bClockSlave ) {
+					pSlave->cont();
+				} else if ( pHydrogen->getState() != STATE_PLAYING )
 					pHydrogen->sequencer_play();
 				break;
 
 		case MidiMessage::STOP: /* Stop in current position i.e. Pause */
 				INFOLOG( "STOP event" );
-				if ( pHydrogen->getState() == STATE_PLAYING )
+				if ( bClockSlave ) {
+					pSlave->stop();
+				} else if ( pHydrogen->getState() == STATE_PLAYING )
 					pHydrogen->sequencer_stop();
 				break;
 
 		case MidiMessage::SONG_POS:
-				ERRORLOG( "SONG_POS event not handled yet" );
-				break;
-
-		case MidiMessage::QUARTER_FRAME:
-				WARNINGLOG( "QUARTER_FRAME event not handled yet" );
+				if ( bClockSlave ) {
+					pSlave->songPosition( msg.m_nData1 | ( msg.m_nData2 << 7 ) );
+				} else {
+					ERRORLOG( "SONG_POS event not handled yet" );
+				}
 				break;
 
 		case MidiMessage::UNKNOWN:
@@ -170,6 +180,22 @@ void MidiInput::handleMidiMessage( const MidiMessage& msg )
 		INFOLOG("[end of handleMidiMessage]");
 }
 
+void MidiInput::handleSyncMessage( const MidiMessage& msg )
+{
+	MidiClockSlave* pSlave = Hydrogen::get_instance()->getMidiClockSlave();
+	if ( pSlave == NULL ) {
+		return;
+	}
+
+	double fTime = msg.m_fTime > 0.0 ? msg.m_fTime : Clock::now();
+	int nSource = Preferences::get_instance()->m_nMidiSyncInput;
+	if ( MidiMessage::TIMING_CLOCK == msg.m_type && nSource == MidiClockSlave::SYNC_CLOCK ) {
+		pSlave->clock( fTime );
+	} else if ( MidiMessage::QUARTER_FRAME == msg.m_type && nSource == MidiClockSlave::SYNC_TIMECODE ) {
+		pSlave->quarterFrame( msg.m_nData1, fTime );
+	}
+}
+
 void MidiInput::handleControlChangeMessage( const MidiMessage& msg )
 {
 	//INFOLOG( QString( "[handleMidiMessage] CONTROL_CHANGE Parameter: %1, Value: %2" ).arg( msg.m_nData1 ).arg( msg.m_nData2 ) );
@@ -178,7 +204,7 @@ void MidiInput::handleControlChangeMessage( const MidiMessage& msg )
 	MidiMap *mM = MidiMap::get_instance();
 
 	MidiAction *pAction = mM->getCCAction( msg.m_nData1 );
-	pAction->setParameter2( QString::number( msg.m_nData2 ) );
+	pAction->setParameter2( msg.m_nData2 );
 
 	aH->handleAction( pAction );
 
@@ -186,7 +212,8 @@ void MidiInput::handleControlChangeMessage( const MidiMessage& msg )
 		__hihat_cc_openess = msg.m_nData2;
 	}
 
-	pEngine->lastMidiEvent = "CC";
+	static const QString sEvent( "CC" );
+	pEngine->lastMidiEvent = sEvent;
 	pEngine->lastMidiEventParameter = msg.m_nData1;
 }
 
@@ -197,11 +224,12 @@ void MidiInput::handleProgramChangeMessage( const MidiMessage& msg )
 	MidiMap *mM = MidiMap::get_instance();
 
 	MidiAction *pAction = mM->getPCAction();
-	pAction->setParameter2( QString::number( msg.m_nData1 ) );
+	pAction->setParameter2( msg.m_nData1 );
 
 	aH->handleAction( pAction );
 
-	pEngine->lastMidiEvent = "PROGRAM_CHANGE";
+	static const QString sEvent( "PROGRAM_CHANGE" );
+	pEngine->lastMidiEvent = sEvent;
 	pEngine->lastMidiEventParameter = 0;
 }
 
@@ -221,7 +249,8 @@ void MidiInput::handleNoteOnMessage( const MidiMessage& msg )
 	MidiMap * mM = MidiMap::get_instance();
 	Hydrogen *pEngine = Hydrogen::get_instance();
 
-	pEngine->lastMidiEvent = "NOTE";
+	static const QString sEvent( "NOTE" );
+	pEngine->lastMidiEvent = sEvent;
 	pEngine->lastMidiEventParameter = msg.m_nData1;
 
 	bool action = aH->handleAction( mM->getNoteAction( msg.m_nData1 ) );
@@ -239,55 +268,22 @@ void MidiInput::handleNoteOnMessage( const MidiMessage& msg )
 		//INFOLOG( QString( "next pattern = %1" ).arg( patternNumber ) );
 		pEngine->sequencer_setNextPattern( patternNumber );
 
-	} else {
-		static const float fPan_L = 0.5f;
-		static const float fPan_R = 0.5f;
-
-		int nInstrument = nNote - 36;
-		if ( nInstrument < 0 ) {
-				if(Preferences::get_instance()->__playselectedinstrument)
-				{
-					//we're in instrument mode -> we accept all notes
-				} else {
-					//we're in drumkit mode, lets drop everything < 36
-					nInstrument = 0;
-					return;
-				}
-
-		}
-		if ( nInstrument > ( MAX_INSTRUMENTS -1 ) ) {
-				nInstrument = MAX_INSTRUMENTS - 1;
-		}
-
-		InstrumentList *instrList = pEngine->getSong()->get_instrument_list();
-		Instrument *instr = instrList->get( nInstrument );
-		/*
-		Only look to change instrument if the
-		current note is actually of hihat and
-		hihat openess is outside the instrument selected
-		*/
-		if ( instr != NULL &&
-			 instr->is_hihat() &&
-			 ( __hihat_cc_openess < instr->get_lower_cc() || __hihat_cc_openess > instr->get_higher_cc() ) )
-		{
-			for(int i=0 ; i<=instrList->size() ; i++)
-			{
-				Instrument *instr_contestant = instrList->get( i );
-				if( instr_contestant != NULL &&
-						instr_contestant->is_hihat() &&
-						__hihat_cc_openess >= instr_contestant->get_lower_cc() &&
-						__hihat_cc_openess <= instr_contestant->get_higher_cc() )
-				{
-					nInstrument = i;
-					break;
-				}
-			}
-		}
-
-		pEngine->addRealtimeNote( nInstrument, fVelocity, fPan_L, fPan_R, 0.0, false, true, nNote );
+	} else if ( !msg.m_bNotePosted && !postNote( msg, false ) ) {
+		ERRORLOG( "Too many MIDI notes in a cycle, note dropped" );
 	}
+}
 
-	__noteOnTick = pEngine->__getMidiRealtimeNoteTickPosition();
+bool MidiInput::postNote( const MidiMessage& msg, bool bNoteOff )
+{
+	// the instrument is looked up by the audio thread, with the engine locked
+	TimedNoteQueue::MidiNote note;
+	note.nNote = msg.m_nData1;
+	note.fVelocity = msg.m_nData2 / 127.0;
+	note.bNoteOff = bNoteOff;
+	note.nHihatOpenness = __hihat_cc_openess;
+	note.fTime = msg.m_fTime > 0.0 ? msg.m_fTime : Clock::now();
+	note.nFrame = msg.m_nFrame;
+	return Hydrogen::get_instance()->postMidiNote( note );
 }
 
 /*
@@ -308,64 +304,11 @@ void MidiInput::handleNoteOffMessage( const MidiMessage& msg, bool CymbalChoke )
 		return;
 	}
 
-	Hydrogen *pEngine = Hydrogen::get_instance();
-	Song *pSong = pEngine->getSong();
-
-	__noteOffTick = pEngine->getTickPosition();
-	unsigned long notelength = computeDeltaNoteOnOfftime();
-
-	int nNote = msg.m_nData1;
-	//float fVelocity = msg.m_nData2 / 127.0; //we need this in future to controll release velocity
-	int nInstrument = nNote - 36;
-	if ( nInstrument < 0 ) {
-		nInstrument = 0;
-	}
-	if ( nInstrument > ( MAX_INSTRUMENTS -1 ) ) {
-		nInstrument = MAX_INSTRUMENTS - 1;
-	}
-	Instrument *pInstr = pSong->get_instrument_list()->get( nInstrument );
-
-	float fStep = pow( 1.0594630943593, (nNote -36) );
-	if ( !Preferences::get_instance()->__playselectedinstrument )
-		fStep = 1;
-
-	if ( Preferences::get_instance()->__playselectedinstrument ){
-		nInstrument = pEngine->getSelectedInstrumentNumber();
-		pInstr= pEngine->getSong()->get_instrument_list()->get( pEngine->getSelectedInstrumentNumber());
-	}
-
-	bool use_note_off = AudioEngine::get_instance()->get_sampler()->is_instrument_playing( pInstr );
-	if(use_note_off){
-		if ( Preferences::get_instance()->__playselectedinstrument ){
-			AudioEngine::get_instance()->get_sampler()->midi_keyboard_note_off( msg.m_nData1 );
-		}else
-		{
-			if ( pSong->get_instrument_list()->size() < nInstrument +1 )
-				return;
-			Note *offnote = new Note( pInstr,
-						0.0,
-						0.0,
-						0.0,
-						0.0,
-						-1,
-						0 );
-			offnote->set_note_off( true );
-			AudioEngine::get_instance()->get_sampler()->note_on( offnote );
-			delete offnote;
-		}
-		if(Preferences::get_instance()->getRecordEvents())
-			AudioEngine::get_instance()->get_sampler()->setPlayingNotelength( pInstr, notelength * fStep, __noteOnTick );
+	if ( !msg.m_bNotePosted && !postNote( msg, true ) ) {
+		ERRORLOG( "Too many MIDI notes in a cycle, note off dropped" );
 	}
 }
 
-
-unsigned long MidiInput::computeDeltaNoteOnOfftime()
-{
-	unsigned long  __notelengthTicks = __noteOffTick - __noteOnTick;
-	return __notelengthTicks;
-
-}
-
 void MidiInput::handleSysexMessage( const MidiMessage& msg )
 {
 
@@ -389,6 +332,10 @@ void MidiInput::handleSysexMessage( const MidiMessage& msg )
 		Goto MMC message
 		0	1	2	3	4	5	6	7	8	9	10	11	12
 		240	127	id	6	68	6	1	hr	mn	sc	fr	ff	247
+
+		MTC full frame message, hr is 0rrhhhhh with the rate code rr
+		0	1	2	3	4	5	6	7	8	9
+		240	127	id	1	1	hr	mn	sc	fr	247
 	*/
 
 
@@ -398,6 +345,18 @@ void MidiInput::handleSysexMessage( const MidiMessage& msg )
 
 	pEngine->lastMidiEventParameter = msg.m_nData1;
 
+	if ( msg.m_sysexData.size() >= 10
+		 && msg.m_sysexData[0] == 240
+		 && msg.m_sysexData[1] == 127
+		 && msg.m_sysexData[3] == 1
+		 && msg.m_sysexData[4] == 1 ) {
+		MidiClockSlave* pSlave = pEngine->getMidiClockSlave();
+		if ( pSlave && Preferences::get_instance()->m_nMidiSyncInput == MidiClockSlave::SYNC_TIMECODE ) {
+			pSlave->fullFrame( msg.m_sysexData[5] & 0x1F, msg.m_sysexData[6], msg.m_sysexData[7],
+							   msg.m_sysexData[8], ( msg.m_sysexData[5] >> 5 ) & 3 );
+		}
+		return;
+	}
 
 	if ( msg.m_sysexData.size() == 6 ) {
 		if (
@@ -412,52 +371,52 @@ void MidiInput::handleSysexMessage( const MidiMessage& msg )
 			case 1:	// STOP
 			{
 				pEngine->lastMidiEvent = "MMC_STOP";
-				aH->handleAction(mM->getMMCAction("MMC_STOP"));
+				aH->handleAction( mM->getMMCAction( MidiMap::MMC_STOP ) );
 				break;
 			}
 
 			case 2:	// PLAY
 			{
 				pEngine->lastMidiEvent = "MMC_PLAY";
-				aH->handleAction(mM->getMMCAction("MMC_PLAY"));
+				aH->handleAction( mM->getMMCAction( MidiMap::MMC_PLAY ) );
 				break;
 			}
 
 			case 3:	//DEFERRED PLAY
 			{
 				pEngine->lastMidiEvent = "MMC_PLAY";
-				aH->handleAction(mM->getMMCAction("MMC_PLAY"));
+				aH->handleAction( mM->getMMCAction( MidiMap::MMC_PLAY ) );
 				break;
 			}
 
 			case 4:	// FAST FWD
 				pEngine->lastMidiEvent = "MMC_FAST_FORWARD";
-				aH->handleAction(mM->getMMCAction("MMC_FAST_FORWARD"));
+				aH->handleAction( mM->getMMCAction( MidiMap::MMC_FAST_FORWARD ) );
 				break;
 
 			case 5:	// REWIND
 				pEngine->lastMidiEvent = "MMC_REWIND";
-				aH->handleAction(mM->getMMCAction("MMC_REWIND"));
+				aH->handleAction( mM->getMMCAction( MidiMap::MMC_REWIND ) );
 				break;
 
 			case 6:	// RECORD STROBE (PUNCH IN)
 				pEngine->lastMidiEvent = "MMC_RECORD_STROBE";
-				aH->handleAction(mM->getMMCAction("MMC_RECORD_STROBE"));
+				aH->handleAction( mM->getMMCAction( MidiMap::MMC_RECORD_STROBE ) );
 				break;
 
 			case 7:	// RECORD EXIT (PUNCH OUT)
 				pEngine->lastMidiEvent = "MMC_RECORD_EXIT";
-				aH->handleAction(mM->getMMCAction("MMC_RECORD_EXIT"));
+				aH->handleAction( mM->getMMCAction( MidiMap::MMC_RECORD_EXIT ) );
 				break;
 
 			case 8:	// RECORD READY
 				pEngine->lastMidiEvent = "MMC_RECORD_READY";
-				aH->handleAction(mM->getMMCAction("MMC_RECORD_READY"));
+				aH->handleAction( mM->getMMCAction( MidiMap::MMC_RECORD_READY ) );
 				break;
 
 			case 9:	//PAUSE
 				pEngine->lastMidiEvent = "MMC_PAUSE";
-				aH->handleAction(mM->getMMCAction("MMC_PAUSE"));
+				aH->handleAction( mM->getMMCAction( MidiMap::MMC_PAUSE ) );
 				break;
 
 			default:
@@ -28,6 +28,7 @@
 #include <hydrogen/basics/instrument_list.h>
 #include <hydrogen/hydrogen.h>
 #include <hydrogen/globals.h>
+#include <hydrogen/helpers/clock.h>
 
 
 #ifdef WIN32
@@ -53,17 +54,31 @@ void* PortMidiDriver_thread( void* param )
 	PortMidiDriver *instance = ( PortMidiDriver* )param;
 	__INFOLOG( "PortMidiDriver_thread starting" );
 
+#ifndef WIN32
+	int nPriority = Preferences::get_instance()->m_nMidiThreadPriority;
+	if ( nPriority > 0 ) {
+		struct sched_param sched;
+		sched.sched_priority = nPriority;
+		if ( pthread_setschedparam( pthread_self(), SCHED_FIFO, &sched ) != 0 ) {
+			__ERRORLOG( "Can't set realtime scheduling for the MIDI input" );
+		}
+	}
+#endif
+
 	PmError status;
 	int length;
-	PmEvent buffer[1];
+	PmEvent buffer[64];
 	while ( instance->m_bRunning ) {
 		status = Pm_Poll( instance->m_pMidiIn );
 		if ( status == TRUE ) {
-			length = Pm_Read( instance->m_pMidiIn, buffer, 1 );
-			if ( length > 0 ) {
+			// all the pending events at once
+			length = Pm_Read( instance->m_pMidiIn, buffer, 64 );
+			double fTime = Clock::now();
+			for ( int i = 0; i < length; ++i ) {
 				MidiMessage msg;
+				msg.m_fTime = fTime;
 
-				int nEventType = Pm_MessageStatus( buffer[0].message );
+				int nEventType = Pm_MessageStatus( buffer[i].message );
 				if ( ( nEventType >= 128 ) && ( nEventType < 144 ) ) {	// note off
 					msg.m_nChannel = nEventType - 128;
 					msg.m_type = MidiMessage::NOTE_OFF;
@@ -91,14 +106,14 @@ void* PortMidiDriver_thread( void* param )
 				} else {
 					__ERRORLOG( "Unhandled midi message type: " + QString::number( nEventType ) );
 					__INFOLOG( "MIDI msg: " );
-					__INFOLOG( QString::number( buffer[0].timestamp ) );
-					__INFOLOG( QString::number( Pm_MessageStatus( buffer[0].message ) ) );
-					__INFOLOG( QString::number( Pm_MessageData1( buffer[0].message ) ) );
-					__INFOLOG( QString::number( Pm_MessageData2( buffer[0].message ) ) );
+					__INFOLOG( QString::number( buffer[i].timestamp ) );
+					__INFOLOG( QString::number( Pm_MessageStatus( buffer[i].message ) ) );
+					__INFOLOG( QString::number( Pm_MessageData1( buffer[i].message ) ) );
+					__INFOLOG( QString::number( Pm_MessageData2( buffer[i].message ) ) );
 				}
 
-				msg.m_nData1 = Pm_MessageData1( buffer[0].message );
-				msg.m_nData2 = Pm_MessageData2( buffer[0].message );
+				msg.m_nData1 = Pm_MessageData1( buffer[i].message );
+				msg.m_nData2 = Pm_MessageData2( buffer[i].message );
 
 				instance->handleMidiMessage( msg );
 			}
@@ -253,7 +268,7 @@ std::vector<QString> PortMidiDriver::getOutputPortList()
 	return portList;
 }
 
-void PortMidiDriver::handleQueueNote(Note* pNote)
+void PortMidiDriver::handleQueueNote( Note* pNote, unsigned /*nFrameOffset*/ )
 {
 	if ( m_pMidiOut == NULL ) {
 		ERRORLOG( "m_pMidiOut = NULL " );
@@ -280,7 +295,7 @@ void PortMidiDriver::handleQueueNote(Note* pNote)
 	Pm_Write(m_pMidiOut, &event, 1);
 }
 
-void PortMidiDriver::handleQueueNoteOff( int channel, int key, int velocity )
+void PortMidiDriver::handleQueueNoteOff( int channel, int key, int velocity, unsigned /*nFrameOffset*/ )
 {
 	if ( m_pMidiOut == NULL ) {
 		ERRORLOG( "m_pMidiOut = NULL " );
@@ -302,6 +317,28 @@ void PortMidiDriver::handleQueueNoteOff( int channel, int key, int velocity )
 	Pm_Write(m_pMidiOut, &event, 1);
 }
 
+void PortMidiDriver::handleQueueSystemMessage( const unsigned char* pData, unsigned nLength, unsigned /*nFrameOffset*/ )
+{
+	if ( m_pMidiOut == NULL ) {
+		ERRORLOG( "m_pMidiOut = NULL " );
+		return;
+	}
+
+	if ( nLength == 0 ) {
+		return;
+	}
+
+	if ( pData[0] == 0xF0 ) {
+		Pm_WriteSysEx( m_pMidiOut, 0, ( unsigned char* )pData );
+		return;
+	}
+
+	PmEvent event;
+	event.timestamp = 0;
+	event.message = Pm_Message( pData[0], nLength > 1 ? pData[1] : 0, nLength > 2 ? pData[2] : 0 );
+	Pm_Write(m_pMidiOut, &event, 1);
+}
+
 void PortMidiDriver::handleQueueAllNoteOff()
 {
 	if ( m_pMidiOut == NULL ) {
@@ -0,0 +1,131 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/IO/TimedNoteQueue.h>
+#include <hydrogen/basics/note.h>
+
+namespace H2Core
+{
+
+const char* TimedNoteQueue::__class_name = "TimedNoteQueue";
+
+TimedNoteQueue::TimedNoteQueue()
+	: Object( __class_name )
+	, m_nFirst( 0 )
+	, m_nCount( 0 )
+	, m_nPostWrite( 0 )
+	, m_nPostRead( 0 )
+{
+	for ( int i = 0; i < POST_SIZE; ++i ) {
+		m_postSequence[ i ].fetchAndStoreOrdered( i );
+	}
+}
+
+TimedNoteQueue::~TimedNoteQueue()
+{
+	clear();
+}
+
+bool TimedNoteQueue::post( const MidiNote& note )
+{
+	int nPos;
+	int nSlot;
+
+	// claim a slot, give up if the queue is full
+	for ( ;; ) {
+		nPos = m_nPostWrite;
+		nSlot = nPos & ( POST_SIZE - 1 );
+		int nDiff = m_postSequence[ nSlot ] - nPos;
+		if ( nDiff < 0 ) {
+			return false;
+		}
+		if ( nDiff == 0 && m_nPostWrite.testAndSetOrdered( nPos, nPos + 1 ) ) {
+			break;
+		}
+	}
+
+	m_posted[ nSlot ] = note;
+	m_postSequence[ nSlot ].fetchAndStoreRelease( nPos + 1 );
+	return true;
+}
+
+bool TimedNoteQueue::receive( MidiNote& note )
+{
+	int nSlot = m_nPostRead & ( POST_SIZE - 1 );
+	if ( m_postSequence[ nSlot ] != m_nPostRead + 1 ) {
+		// empty, or the producer is not done yet
+		return false;
+	}
+
+	note = m_posted[ nSlot ];
+	m_postSequence[ nSlot ].fetchAndStoreRelease( m_nPostRead + POST_SIZE );
+	++m_nPostRead;
+	return true;
+}
+
+bool TimedNoteQueue::push( Note* pNote, uint32_t nFrame )
+{
+	if ( m_nCount == SIZE ) {
+		return false;
+	}
+
+	TimedNote& note = m_notes[ ( m_nFirst + m_nCount ) & ( SIZE - 1 ) ];
+	note.pNote = pNote;
+	note.nFrame = nFrame;
+	++m_nCount;
+	return true;
+}
+
+Note* TimedNoteQueue::pop( uint32_t nCycleFrame, unsigned nFrames, unsigned& nOffset )
+{
+	if ( m_nCount == 0 ) {
+		return NULL;
+	}
+
+	// the frame time wraps around, compare the distance only
+	const TimedNote& next = m_notes[ m_nFirst ];
+	int32_t nDistance = ( int32_t )( next.nFrame - nCycleFrame );
+	if ( nDistance >= ( int32_t )nFrames ) {
+		return NULL;
+	}
+
+	nOffset = nDistance > 0 ? nDistance : 0;
+	Note* pNote = next.pNote;
+	m_nFirst = ( m_nFirst + 1 ) & ( SIZE - 1 );
+	--m_nCount;
+	return pNote;
+}
+
+void TimedNoteQueue::clear()
+{
+	MidiNote note;
+	while ( receive( note ) ) {
+	}
+
+	for ( unsigned i = 0; i < m_nCount; ++i ) {
+		delete m_notes[ ( m_nFirst + i ) & ( SIZE - 1 ) ].pNote;
+	}
+	m_nFirst = 0;
+	m_nCount = 0;
+}
+
+};
@@ -47,19 +47,22 @@ AudioEngine::AudioEngine()
 		: Object( __class_name )
 		, __sampler( NULL )
 		, __synth( NULL )
+		, __profiler( NULL )
 {
 	__instance = this;
 	INFOLOG( "INIT" );
 
 	pthread_mutex_init( &__engine_mutex, NULL );
 
-	__sampler = new Sampler;
-	__synth = new Synth;
-
 #ifdef H2CORE_HAVE_LADSPA
+	// the sampler sizes its FX sends from the slots
 	Effects::create_instance();
 #endif
 
+	__sampler = new Sampler;
+	__synth = new Synth;
+	__profiler = new Profiler;
+
 }
 
 
@@ -74,6 +77,7 @@ AudioEngine::~AudioEngine()
 //	delete Sequencer::get_instance();
 	delete __sampler;
 	delete __synth;
+	delete __profiler;
 }
 
 
@@ -93,6 +97,12 @@ Synth* AudioEngine::get_synth()
 	return __synth;
 }
 
+Profiler* AudioEngine::get_profiler()
+{
+	assert(__profiler);
+	return __profiler;
+}
+
 void AudioEngine::lock( const char* file, unsigned int line, const char* function )
 {
 	pthread_mutex_lock( &__engine_mutex );
@@ -22,10 +22,7 @@
 
 #include <hydrogen/basics/drumkit.h>
 #include <hydrogen/config.h>
-#ifdef H2CORE_HAVE_LIBARCHIVE
-#include <archive.h>
-#include <archive_entry.h>
-#else
+#ifndef H2CORE_HAVE_LIBARCHIVE
 #ifndef WIN32
 #include <fcntl.h>
 #include <errno.h>
@@ -41,6 +38,7 @@
 #include <hydrogen/basics/instrument_component.h>
 #include <hydrogen/basics/instrument_layer.h>
 
+#include <hydrogen/helpers/drumkit_archive.h>
 #include <hydrogen/helpers/xml.h>
 #include <hydrogen/helpers/filesystem.h>
 #include <hydrogen/helpers/legacy.h>
@@ -87,20 +85,24 @@ Drumkit* Drumkit::load_by_name ( const QString& dk_name, bool load_samples )
 	return load( dir, load_samples );
 }
 
-Drumkit* Drumkit::load( const QString& dk_dir, bool load_samples )
+Drumkit* Drumkit::load( const QString& dk_dir, bool load_samples, bool validate )
 {
 	INFOLOG( QString( "Load drumkit %1" ).arg( dk_dir ) );
 	if( !Filesystem::drumkit_valid( dk_dir ) ) {
 		ERRORLOG( QString( "%1 is not valid drumkit" ).arg( dk_dir ) );
 		return NULL;
 	}
-	return load_file( Filesystem::drumkit_file( dk_dir ), load_samples );
+	return load_file( Filesystem::drumkit_file( dk_dir ), load_samples, validate );
 }
 
-Drumkit* Drumkit::load_file( const QString& dk_path, bool load_samples )
+Drumkit* Drumkit::load_file( const QString& dk_path, bool load_samples, bool validate )
 {
 	XMLDoc doc;
-	if( !doc.read( dk_path, Filesystem::drumkit_xsd() ) ) {
+	if( !doc.read( dk_path, validate ? Filesystem::drumkit_xsd() : QString() ) ) {
+		return Legacy::load_drumkit( dk_path );
+	}
+	if( !validate && !doc.check_root( "drumkit_info", "drumkit" ) ) {
+		// the drumkits written before the XML Schema have no namespace
 		return Legacy::load_drumkit( dk_path );
 	}
 	XMLNode root = doc.firstChildElement( "drumkit_info" );
@@ -371,67 +373,7 @@ bool Drumkit::install( const QString& path )
 {
 	_INFOLOG( QString( "Install drumkit %1" ).arg( path ) );
 #ifdef H2CORE_HAVE_LIBARCHIVE
-	int r;
-	struct archive* arch;
-	struct archive_entry* entry;
-
-	arch = archive_read_new();
-
-#if ARCHIVE_VERSION_NUMBER < 3000000
-	archive_read_support_compression_all( arch );
-#else
-	archive_read_support_filter_all( arch );
-#endif
-
-	archive_read_support_format_all( arch );
-
-#if ARCHIVE_VERSION_NUMBER < 3000000
-	if ( ( r = archive_read_open_file( arch, path.toLocal8Bit(), 10240 ) ) ) {
-#else
-	if ( ( r = archive_read_open_filename( arch, path.toLocal8Bit(), 10240 ) ) ) {
-#endif
-		_ERRORLOG( QString( "archive_read_open_file() [%1] %2" ).arg( archive_errno( arch ) ).arg( archive_error_string( arch ) ) );
-		archive_read_close( arch );
-
-		#if ARCHIVE_VERSION_NUMBER < 3000000
-			archive_read_finish( arch );
-		#else
-			archive_read_free( arch );
-		#endif
-
-		return false;
-	}
-	bool ret = true;
-	QString dk_dir = Filesystem::usr_drumkits_dir() + "/";
-	while ( ( r = archive_read_next_header( arch, &entry ) ) != ARCHIVE_EOF ) {
-		if ( r != ARCHIVE_OK ) {
-			_ERRORLOG( QString( "archive_read_next_header() [%1] %2" ).arg( archive_errno( arch ) ).arg( archive_error_string( arch ) ) );
-			ret = false;
-			break;
-		}
-		QString np = dk_dir + archive_entry_pathname( entry );
-
-		QByteArray newpath = np.toLocal8Bit();
-
-		archive_entry_set_pathname( entry, newpath.data() );
-		r = archive_read_extract( arch, entry, 0 );
-		if ( r == ARCHIVE_WARN ) {
-			_WARNINGLOG( QString( "archive_read_extract() [%1] %2" ).arg( archive_errno( arch ) ).arg( archive_error_string( arch ) ) );
-		} else if ( r != ARCHIVE_OK ) {
-			_ERRORLOG( QString( "archive_read_extract() [%1] %2" ).arg( archive_errno( arch ) ).arg( archive_error_string( arch ) ) );
-			ret = false;
-			break;
-		}
-	}
-	archive_read_close( arch );
-
-	#if ARCHIVE_VERSION_NUMBER < 3000000
-		archive_read_finish( arch );
-	#else
-		archive_read_free( arch );
-	#endif
-
-	return ret;
+	return DrumkitArchive::extract( path, Filesystem::usr_drumkits_dir() );
 #else // H2CORE_HAVE_LIBARCHIVE
 #ifndef WIN32
 	// GUNZIP
@@ -26,6 +26,7 @@
 
 #include <hydrogen/audio_engine.h>
 
+#include <hydrogen/helpers/dsp.h>
 #include <hydrogen/helpers/xml.h>
 #include <hydrogen/helpers/filesystem.h>
 
@@ -80,20 +81,10 @@ void DrumkitComponent::reset_outs( uint32_t nFrames )
 	memset( __out_R, 0, nFrames * sizeof( float ) );
 }
 
-void DrumkitComponent::set_outs( int nBufferPos, float valL, float valR )
+void DrumkitComponent::update_peaks( uint32_t nFrames )
 {
-	__out_L[nBufferPos] += valL;
-	__out_R[nBufferPos] += valR;
-}
-
-float DrumkitComponent::get_out_L( int nBufferPos )
-{
-	return __out_L[nBufferPos];
-}
-
-float DrumkitComponent::get_out_R( int nBufferPos )
-{
-	return __out_R[nBufferPos];
+	__peak_l.raise( DSP::abs_peak( __out_L, nFrames, 0.0f ) );
+	__peak_r.raise( DSP::abs_peak( __out_R, nFrames, 0.0f ) );
 }
 
 void DrumkitComponent::load_from( DrumkitComponent* component, bool is_live )
@@ -23,6 +23,7 @@
 #include <hydrogen/basics/instrument.h>
 
 #include <cassert>
+#include <algorithm>
 
 #include <hydrogen/audio_engine.h>
 
@@ -36,11 +37,13 @@
 #include <hydrogen/basics/instrument_list.h>
 #include <hydrogen/basics/instrument_component.h>
 #include <hydrogen/basics/instrument_layer.h>
+#include <hydrogen/basics/layer_loader.h>
 
 namespace H2Core
 {
 
 const char* Instrument::__class_name = "Instrument";
+int Instrument::__fx_slots = MAX_FX;
 
 Instrument::Instrument( const int id, const QString& name, ADSR* adsr )
 	: Object( __class_name )
@@ -73,7 +76,7 @@ Instrument::Instrument( const int id, const QString& name, ADSR* adsr )
 	, __is_metronome_instrument(false)
 {
 	if ( __adsr==0 ) __adsr = new ADSR();
-	for ( int i=0; i<MAX_FX; i++ ) __fx_level[i] = 0.0;
+	__fx_level.assign( __fx_slots, 0.0 );
 	__components = new std::vector<InstrumentComponent*> ();
 }
 
@@ -107,12 +110,18 @@ Instrument::Instrument( Instrument* other )
 	, __is_preview_instrument(false)
 	, __is_metronome_instrument(false)
 {
-	for ( int i=0; i<MAX_FX; i++ ) __fx_level[i] = other->get_fx_level( i );
+	__fx_level.assign( __fx_slots, 0.0 );
+	for ( int i=0; i<__fx_slots; i++ ) __fx_level[i] = other->get_fx_level( i );
 
 	__components = new std::vector<InstrumentComponent*> ();
 	__components->assign( other->get_components()->begin(), other->get_components()->end() );
 }
 
+void Instrument::set_fx_slots( int slots )
+{
+	__fx_slots = std::max( slots, MAX_FX );
+}
+
 Instrument::~Instrument()
 {
 	__components->clear();
@@ -153,7 +162,7 @@ void Instrument::load_from( Drumkit* pDrumkit, Instrument* pInstrument, bool is_
 					AudioEngine::get_instance()->unlock();
 			} else {
 				QString sample_path =  pDrumkit->get_path() + "/" + src_layer->get_sample()->get_filename();
-				Sample* sample = Sample::load( sample_path );
+				Sample* sample = LayerLoader::create_sample( sample_path );
 				if ( sample==0 ) {
 					_ERRORLOG( QString( "Error loading sample %1. Creating a new empty layer." ).arg( sample_path ) );
 					if ( is_live )
@@ -247,7 +256,7 @@ Instrument* Instrument::load_from( XMLNode* node, const QString& dk_path, const
 	pInstrument->set_lower_cc( node->read_int( "lower_cc", 0, true ) );
 	pInstrument->set_higher_cc( node->read_int( "higher_cc", 127, true ) );
 
-	for ( int i=0; i<MAX_FX; i++ ) {
+	for ( int i=0; i<__fx_slots; i++ ) {
 		pInstrument->set_fx_level( node->read_float( QString( "FX%1Level" ).arg( i+1 ), 0.0 ), i );
 	}
 
@@ -306,7 +315,7 @@ void Instrument::save_to( XMLNode* node )
 	InstrumentNode.write_bool( "isHihat", __hihat );
 	InstrumentNode.write_int( "lower_cc", __lower_cc );
 	InstrumentNode.write_int( "higher_cc", __higher_cc );
-	for ( int i=0; i<MAX_FX; i++ ) {
+	for ( int i=0; i<(int)__fx_level.size(); i++ ) {
 		InstrumentNode.write_float( QString( "FX%1Level" ).arg( i+1 ), __fx_level[i] );
 	}
 	for (std::vector<InstrumentComponent*>::iterator it = __components->begin() ; it != __components->end(); ++it) {
@@ -35,7 +35,8 @@ InstrumentLayer::InstrumentLayer( Sample* sample ) : Object( __class_name ),
 	__end_velocity( 1.0 ),
 	__pitch( 0.0 ),
 	__gain( 1.0 ),
-	__sample( sample )
+	__sample( sample ),
+	__load_requested( false )
 {
 }
 
@@ -44,7 +45,8 @@ InstrumentLayer::InstrumentLayer( InstrumentLayer* other ) : Object( __class_nam
 	__end_velocity( other->get_end_velocity() ),
 	__pitch( other->get_pitch() ),
 	__gain( other->get_gain() ),
-	__sample( new Sample( other->get_sample() ) )
+	__sample( new Sample( other->get_sample() ) ),
+	__load_requested( false )
 {
 }
 
@@ -53,7 +55,8 @@ InstrumentLayer::InstrumentLayer( InstrumentLayer* other, Sample* sample ) : Obj
 	__end_velocity( other->get_end_velocity() ),
 	__pitch( other->get_pitch() ),
 	__gain( other->get_gain() ),
-	__sample( sample )
+	__sample( sample ),
+	__load_requested( false )
 {
 }
 
@@ -73,6 +76,11 @@ void InstrumentLayer::unload_sample()
 	if( __sample ) __sample->unload();
 }
 
+bool InstrumentLayer::is_loaded() const
+{
+	return ( __sample!=0 && __sample->get_data_l()!=0 );
+}
+
 InstrumentLayer* InstrumentLayer::load_from( XMLNode* node, const QString& dk_path )
 {
 	Sample* sample = new Sample( dk_path+"/"+node->read_string( "filename", "" ) );
@@ -30,11 +30,11 @@ namespace H2Core
 
 const char* InstrumentList::__class_name = "InstrumentList";
 
-InstrumentList::InstrumentList() : Object( __class_name )
+InstrumentList::InstrumentList() : Object( __class_name ), __indexes_valid( false )
 {
 }
 
-InstrumentList::InstrumentList( InstrumentList* other ) : Object( __class_name )
+InstrumentList::InstrumentList( InstrumentList* other ) : Object( __class_name ), __indexes_valid( false )
 {
 	assert( __instruments.size() == 0 );
 	for ( int i=0; i<other->size(); i++ ) {
@@ -102,6 +102,7 @@ void InstrumentList::operator<<( Instrument* instrument )
 		if( __instruments[i]==instrument ) return;
 	}
 	__instruments.push_back( instrument );
+	__indexes_valid = false;
 }
 
 void InstrumentList::add( Instrument* instrument )
@@ -111,6 +112,7 @@ void InstrumentList::add( Instrument* instrument )
 		if( __instruments[i]==instrument ) return;
 	}
 	__instruments.push_back( instrument );
+	__indexes_valid = false;
 }
 
 void InstrumentList::insert( int idx, Instrument* instrument )
@@ -120,6 +122,7 @@ void InstrumentList::insert( int idx, Instrument* instrument )
 		if( __instruments[i]==instrument ) return;
 	}
 	__instruments.insert( __instruments.begin() + idx, instrument );
+	__indexes_valid = false;
 }
 
 Instrument* InstrumentList::operator[]( int idx )
@@ -150,18 +153,44 @@ int InstrumentList::index( Instrument* instr )
 	return -1;
 }
 
+void InstrumentList::build_indexes()
+{
+	__id_indexes.clear();
+	__name_indexes.clear();
+	// backwards, the first of the instruments sharing an id or a name wins
+	for( int i=__instruments.size()-1; i>=0; i-- ) {
+		__id_indexes.insert( __instruments[i]->get_id(), i );
+		__name_indexes.insert( __instruments[i]->get_name(), i );
+	}
+	__indexes_valid = true;
+}
+
 Instrument*  InstrumentList::find( const int id )
 {
+	if( !__indexes_valid ) build_indexes();
+	int idx = __id_indexes.value( id, -1 );
+	if( idx >= 0 && __instruments[idx]->get_id()==id ) return __instruments[idx];
+	// the id may have been given to an instrument since the tables were built
 	for( int i=0; i<__instruments.size(); i++ ) {
-		if ( __instruments[i]->get_id()==id ) return __instruments[i];
+		if ( __instruments[i]->get_id()==id ) {
+			__indexes_valid = false;
+			return __instruments[i];
+		}
 	}
 	return 0;
 }
 
 Instrument*  InstrumentList::find( const QString& name )
 {
+	if( !__indexes_valid ) build_indexes();
+	int idx = __name_indexes.value( name, -1 );
+	if( idx >= 0 && __instruments[idx]->get_name()==name ) return __instruments[idx];
+	// the instrument may have been renamed since the tables were built
 	for( int i=0; i<__instruments.size(); i++ ) {
-		if ( __instruments[i]->get_name()==name ) return __instruments[i];
+		if ( __instruments[i]->get_name()==name ) {
+			__indexes_valid = false;
+			return __instruments[i];
+		}
 	}
 	return 0;
 }
@@ -171,6 +200,7 @@ Instrument* InstrumentList::del( int idx )
 	assert( idx >= 0 && idx < __instruments.size() );
 	Instrument* instrument = __instruments[idx];
 	__instruments.erase( __instruments.begin() + idx );
+	__indexes_valid = false;
 	return instrument;
 }
 
@@ -179,6 +209,7 @@ Instrument* InstrumentList::del( Instrument* instrument )
 	for( int i=0; i<__instruments.size(); i++ ) {
 		if( __instruments[i]==instrument ) {
 			__instruments.erase( __instruments.begin() + i );
+			__indexes_valid = false;
 			return instrument;
 		}
 	}
@@ -194,6 +225,7 @@ void InstrumentList::swap( int idx_a, int idx_b )
 	Instrument* tmp = __instruments[idx_a];
 	__instruments[idx_a] = __instruments[idx_b];
 	__instruments[idx_b] = tmp;
+	__indexes_valid = false;
 }
 
 void InstrumentList::move( int idx_a, int idx_b )
@@ -205,6 +237,7 @@ void InstrumentList::move( int idx_a, int idx_b )
 	Instrument* tmp = __instruments[idx_a];
 	__instruments.erase( __instruments.begin() + idx_a );
 	__instruments.insert( __instruments.begin() + idx_b, tmp );
+	__indexes_valid = false;
 }
 
 };
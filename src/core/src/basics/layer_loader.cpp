@@ -0,0 +1,367 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/basics/layer_loader.h>
+
+#include <hydrogen/audio_engine.h>
+#include <hydrogen/hydrogen.h>
+#include <hydrogen/Preferences.h>
+#include <hydrogen/basics/instrument.h>
+#include <hydrogen/basics/instrument_component.h>
+#include <hydrogen/basics/instrument_layer.h>
+#include <hydrogen/basics/instrument_list.h>
+#include <hydrogen/basics/note.h>
+#include <hydrogen/basics/pattern.h>
+#include <hydrogen/basics/pattern_list.h>
+#include <hydrogen/basics/sample.h>
+#include <hydrogen/basics/song.h>
+#include <hydrogen/helpers/filesystem.h>
+#include <hydrogen/sampler/Sampler.h>
+
+#include <algorithm>
+#include <set>
+
+namespace H2Core
+{
+
+const char* LayerLoader::__class_name = "LayerLoader";
+LayerLoader* LayerLoader::__instance = NULL;
+
+/// layers the sampler may request before the loader takes them
+#define LAYER_QUEUE_SIZE 1024
+
+void* layerLoader_thread( void* param )
+{
+	LayerLoader* pLoader = ( LayerLoader* )param;
+	pLoader->loaderLoop();
+	pthread_exit( NULL );
+	return NULL;
+}
+
+void LayerLoader::create_instance()
+{
+	if ( __instance == NULL ) {
+		__instance = new LayerLoader();
+	}
+}
+
+LayerLoader::LayerLoader()
+		: Object( __class_name )
+		, m_bThreadRunning( false )
+		, m_queue( LAYER_QUEUE_SIZE, ( InstrumentLayer* )NULL )
+		, m_nQueueHead( 0 )
+		, m_nQueued( 0 )
+		, m_bBusy( false )
+		, m_bQuit( false )
+{
+	pthread_mutex_init( &m_mutex, NULL );
+	pthread_cond_init( &m_workCond, NULL );
+	pthread_cond_init( &m_doneCond, NULL );
+
+	// set before the thread reads it
+	m_bThreadRunning = true;
+	if ( pthread_create( &m_thread, NULL, layerLoader_thread, this ) != 0 ) {
+		ERRORLOG( "Error creating the layer loader thread, the layers are loaded with their instrument" );
+		m_bThreadRunning = false;
+	}
+}
+
+
+
+LayerLoader::~LayerLoader()
+{
+	if ( m_bThreadRunning ) {
+		pthread_mutex_lock( &m_mutex );
+		m_nQueued = 0;
+		m_bQuit = true;
+		pthread_cond_signal( &m_workCond );
+		pthread_mutex_unlock( &m_mutex );
+		pthread_join( m_thread, NULL );
+	}
+
+	pthread_cond_destroy( &m_doneCond );
+	pthread_cond_destroy( &m_workCond );
+	pthread_mutex_destroy( &m_mutex );
+
+	__instance = NULL;
+}
+
+
+
+Sample* LayerLoader::create_sample( const QString& sFilepath )
+{
+	// without the thread, nobody would load them
+	if ( __instance == NULL || !__instance->m_bThreadRunning || !Preferences::get_instance()->m_bLazyLayerLoading ) {
+		return Sample::load( sFilepath );
+	}
+	if ( !Filesystem::file_readable( sFilepath ) ) {
+		_ERRORLOG( QString( "Unable to read %1" ).arg( sFilepath ) );
+		return NULL;
+	}
+	return new Sample( sFilepath );
+}
+
+
+
+void LayerLoader::request( InstrumentLayer* pLayer )
+{
+	if ( pLayer->is_load_requested() ) {
+		return;
+	}
+	// never wait in the audio thread
+	if ( pthread_mutex_trylock( &m_mutex ) != 0 ) {
+		return;
+	}
+	// the ring is allocated up front, it is requested again by the next buffer if it is full
+	if ( push_back( pLayer ) ) {
+		pLayer->set_load_requested( true );
+		pthread_cond_signal( &m_workCond );
+	}
+	pthread_mutex_unlock( &m_mutex );
+}
+
+
+
+int LayerLoader::prefetch( Song* pSong )
+{
+	if ( pSong == NULL ) {
+		return 0;
+	}
+	std::vector<InstrumentLayer*> layers;
+	int nQueued = 0;
+
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
+	needed_layers( pSong, layers );
+	pthread_mutex_lock( &m_mutex );
+	// ahead of the requests of the sampler, in the order of the song
+	for ( std::vector<InstrumentLayer*>::reverse_iterator it = layers.rbegin(); it != layers.rend(); ++it ) {
+		InstrumentLayer* pLayer = *it;
+		if ( pLayer->is_loaded() || pLayer->get_sample() == NULL || pLayer->is_load_requested() ) {
+			continue;
+		}
+		pLayer->set_load_requested( true );
+		push_front( pLayer );
+		nQueued++;
+	}
+	pthread_cond_signal( &m_workCond );
+	pthread_mutex_unlock( &m_mutex );
+	AudioEngine::get_instance()->unlock();
+
+	INFOLOG( QString( "%1 layers of the %2 the song needs queued" ).arg( nQueued ).arg( layers.size() ) );
+	if ( !m_bThreadRunning ) {
+		loaderLoop();
+	}
+	return nQueued;
+}
+
+
+
+void LayerLoader::wait()
+{
+	pthread_mutex_lock( &m_mutex );
+	while ( m_nQueued > 0 || m_bBusy ) {
+		pthread_cond_wait( &m_doneCond, &m_mutex );
+	}
+	pthread_mutex_unlock( &m_mutex );
+}
+
+
+
+void LayerLoader::needed_layers( Song* pSong, std::vector<InstrumentLayer*>& layers )
+{
+	std::set<InstrumentLayer*> found;
+	float fHumanize = pSong->get_humanize_velocity_value();
+	PatternList* pPatternList = pSong->get_pattern_list();
+	if ( pPatternList == NULL ) {
+		return;
+	}
+
+	for ( int nPattern = 0; nPattern < pPatternList->size(); nPattern++ ) {
+		const Pattern::notes_t* pNotes = pPatternList->get( nPattern )->get_notes();
+		FOREACH_NOTE_CST_IT_BEGIN_END( pNotes, it ) {
+			Note* pNote = it->second;
+			Instrument* pInstr = pNote->get_instrument();
+			if ( pInstr == NULL ) {
+				continue;
+			}
+			// the range the humanization moves the velocity in, see audioEngine_process_playNotes()
+			float fMin = std::max( pNote->get_velocity() - fHumanize / 2.0f, 0.0f );
+			float fMax = std::min( pNote->get_velocity() + fHumanize / 2.0f, 1.0f );
+
+			for ( std::vector<InstrumentComponent*>::iterator itCompo = pInstr->get_components()->begin(); itCompo != pInstr->get_components()->end(); ++itCompo ) {
+				InstrumentComponent* pCompo = *itCompo;
+				for ( int nLayer = 0; nLayer < MAX_LAYERS; nLayer++ ) {
+					InstrumentLayer* pLayer = pCompo->get_layer( nLayer );
+					if ( pLayer == NULL || pLayer->get_end_velocity() < fMin || pLayer->get_start_velocity() > fMax ) {
+						continue;
+					}
+					if ( found.insert( pLayer ).second ) {
+						layers.push_back( pLayer );
+					}
+					// the sampler plays the first layer a velocity falls in, the next ones are never hit
+					if ( pLayer->get_start_velocity() <= fMin && pLayer->get_end_velocity() >= fMax ) {
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+
+void LayerLoader::loaderLoop()
+{
+	pthread_mutex_lock( &m_mutex );
+	while ( m_nQueued > 0 || ( m_bThreadRunning && !m_bQuit ) ) {
+		if ( m_nQueued == 0 ) {
+			pthread_cond_wait( &m_workCond, &m_mutex );
+			continue;
+		}
+		InstrumentLayer* pLayer = pop_front();
+		m_bBusy = true;
+		pthread_mutex_unlock( &m_mutex );
+
+		load( pLayer );
+
+		pthread_mutex_lock( &m_mutex );
+		m_bBusy = false;
+		pthread_cond_broadcast( &m_doneCond );
+	}
+	pthread_mutex_unlock( &m_mutex );
+}
+
+
+
+bool LayerLoader::push_back( InstrumentLayer* pLayer )
+{
+	if ( m_nQueued == m_queue.size() ) {
+		return false;
+	}
+	m_queue[ ( m_nQueueHead + m_nQueued ) % m_queue.size() ] = pLayer;
+	m_nQueued++;
+	return true;
+}
+
+
+
+void LayerLoader::push_front( InstrumentLayer* pLayer )
+{
+	if ( m_nQueued == m_queue.size() ) {
+		// unroll the ring into a larger one
+		std::vector<InstrumentLayer*> queue( 2 * m_queue.size(), ( InstrumentLayer* )NULL );
+		for ( unsigned i = 0; i < m_nQueued; i++ ) {
+			queue[ i ] = m_queue[ ( m_nQueueHead + i ) % m_queue.size() ];
+		}
+		m_queue.swap( queue );
+		m_nQueueHead = 0;
+	}
+	m_nQueueHead = ( m_nQueueHead + m_queue.size() - 1 ) % m_queue.size();
+	m_queue[ m_nQueueHead ] = pLayer;
+	m_nQueued++;
+}
+
+
+
+InstrumentLayer* LayerLoader::pop_front()
+{
+	assert( m_nQueued > 0 );
+	InstrumentLayer* pLayer = m_queue[ m_nQueueHead ];
+	m_nQueueHead = ( m_nQueueHead + 1 ) % m_queue.size();
+	m_nQueued--;
+	return pLayer;
+}
+
+
+
+void LayerLoader::load( InstrumentLayer* pLayer )
+{
+	QString sFilepath;
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
+	if ( is_in_use( pLayer ) && !pLayer->is_loaded() && pLayer->get_sample() ) {
+		sFilepath = pLayer->get_sample()->get_filepath();
+	}
+	AudioEngine::get_instance()->unlock();
+	if ( sFilepath.isEmpty() ) {
+		return;
+	}
+
+	// the layer stays requested if it fails, the nearest layer goes on playing for it
+	Sample* pSample = Sample::load( sFilepath );
+	if ( pSample == NULL ) {
+		ERRORLOG( "Error loading sample: " + sFilepath );
+		return;
+	}
+
+	Sample* pOldSample = NULL;
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
+	// the layer may have been deleted and another one created at its address since
+	if ( is_in_use( pLayer ) && !pLayer->is_loaded() && pLayer->get_sample() && pLayer->get_sample()->get_filepath() == sFilepath ) {
+		pOldSample = pLayer->get_sample();
+		pLayer->set_sample( pSample );
+		pSample = NULL;
+	}
+	AudioEngine::get_instance()->unlock();
+
+	delete pOldSample;
+	delete pSample;
+}
+
+
+
+/// \return true if one of the components of the instrument holds the layer
+static bool has_layer( Instrument* pInstr, InstrumentLayer* pLayer )
+{
+	if ( pInstr == NULL ) {
+		return false;
+	}
+	for ( std::vector<InstrumentComponent*>::iterator it = pInstr->get_components()->begin(); it != pInstr->get_components()->end(); ++it ) {
+		for ( int nLayer = 0; nLayer < MAX_LAYERS; nLayer++ ) {
+			if ( ( *it )->get_layer( nLayer ) == pLayer ) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool LayerLoader::is_in_use( InstrumentLayer* pLayer )
+{
+	if ( has_layer( AudioEngine::get_instance()->get_sampler()->get_preview_instrument(), pLayer ) ) {
+		return true;
+	}
+	Song* pSong = Hydrogen::get_instance()->getSong();
+	if ( pSong == NULL || pSong->get_instrument_list() == NULL ) {
+		return false;
+	}
+	InstrumentList* pInstrList = pSong->get_instrument_list();
+	for ( int nInstr = 0; nInstr < pInstrList->size(); nInstr++ ) {
+		if ( has_layer( pInstrList->get( nInstr ), pLayer ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+};
+
+/* vim: set softtabstop=4 expandtab: */
@@ -69,6 +69,7 @@ Note::Note( Instrument* instrument, int position, float velocity, float pan_l, f
 		for (std::vector<InstrumentComponent*>::iterator it = __instrument->get_components()->begin() ; it !=__instrument->get_components()->end(); ++it) {
             InstrumentComponent *pCompo = *it;
             __samples_position[pCompo->get_drumkit_componentID()] = 0.0;
+            __layers_selected[pCompo->get_drumkit_componentID()] = -1;
 		}
 	}
 
@@ -109,6 +110,7 @@ Note::Note( Note* other, Instrument* instrument )
 		for (std::vector<InstrumentComponent*>::iterator it = __instrument->get_components()->begin() ; it !=__instrument->get_components()->end(); ++it) {
             InstrumentComponent *pCompo = *it;
             __samples_position[pCompo->get_drumkit_componentID()] = 0.0;
+            __layers_selected[pCompo->get_drumkit_componentID()] = -1;
         }
 	}
 }
@@ -208,21 +210,36 @@ void Note::save_to( XMLNode* node )
 	node->write_bool( "note_off", __note_off );
 }
 
-Note* Note::load_from( XMLNode* node, InstrumentList* instruments )
+Note* Note::load_from( XMLReader* reader, InstrumentList* instruments )
 {
-	Note* note = new Note(
-		0,
-		node->read_int( "position", 0 ),
-		node->read_float( "velocity", 0.8f ),
-		node->read_float( "pan_L", 0.5f ),
-		node->read_float( "pan_R", 0.5f ),
-		node->read_int( "length", -1 ),
-		node->read_float( "pitch", 0.0f )
-	);
-	note->set_lead_lag( node->read_float( "leadlag", 0, false, false ) );
-	note->set_key_octave( node->read_string( "key", "C0", false, false ) );
-	note->set_note_off( node->read_bool( "note_off", false, false, false ) );
-	note->set_instrument_id( node->read_int( "instrument", EMPTY_INSTR_ID ) );
+	int position = 0;
+	float velocity = 0.8f;
+	float pan_l = 0.5f;
+	float pan_r = 0.5f;
+	int length = -1;
+	float pitch = 0.0f;
+	float lead_lag = 0;
+	QString key = "C0";
+	bool note_off = false;
+	int instrument_id = EMPTY_INSTR_ID;
+	while( reader->readNextStartElement() ) {
+		if( reader->name_is( "position" ) )         position = reader->read_int( position );
+		else if( reader->name_is( "leadlag" ) )     lead_lag = reader->read_float( lead_lag );
+		else if( reader->name_is( "velocity" ) )    velocity = reader->read_float( velocity );
+		else if( reader->name_is( "pan_L" ) )       pan_l = reader->read_float( pan_l );
+		else if( reader->name_is( "pan_R" ) )       pan_r = reader->read_float( pan_r );
+		else if( reader->name_is( "pitch" ) )       pitch = reader->read_float( pitch );
+		else if( reader->name_is( "key" ) )         key = reader->read_string( key );
+		else if( reader->name_is( "length" ) )      length = reader->read_int( length );
+		else if( reader->name_is( "instrument" ) )  instrument_id = reader->read_int( instrument_id );
+		else if( reader->name_is( "note_off" ) )    note_off = reader->read_bool( note_off );
+		else reader->skipCurrentElement();
+	}
+	Note* note = new Note( 0, position, velocity, pan_l, pan_r, length, pitch );
+	note->set_lead_lag( lead_lag );
+	note->set_key_octave( key );
+	note->set_note_off( note_off );
+	note->set_instrument_id( instrument_id );
 	note->map_instrument( instruments );
 	return note;
 }
@@ -69,42 +69,52 @@ Pattern* Pattern::load_file( const QString& pattern_path, InstrumentList* instru
 {
 	INFOLOG( QString( "Load pattern %1" ).arg( pattern_path ) );
 	if ( !Filesystem::file_readable( pattern_path ) ) return 0;
-	XMLDoc doc;
-	if( !doc.read( pattern_path, Filesystem::drumkit_pattern_xsd() ) ) {
+	XMLReader reader;
+	if( !reader.read( pattern_path, "drumkit_pattern", Filesystem::drumkit_pattern_xsd() ) ) {
 		return Legacy::load_drumkit_pattern( pattern_path );
 	}
-	XMLNode root = doc.firstChildElement( "drumkit_pattern" );
-	if ( root.isNull() ) {
-		ERRORLOG( "drumkit_pattern node not found" );
-		return 0;
-	}
-	XMLNode pattern_node = root.firstChildElement( "pattern" );
-	if ( pattern_node.isNull() ) {
-		ERRORLOG( "pattern node not found" );
-		return 0;
+	while( reader.readNextStartElement() ) {
+		if( reader.name_is( "pattern" ) ) {
+			return load_from( &reader, instruments );
+		}
+		reader.skipCurrentElement();
 	}
-	return load_from( &pattern_node, instruments );
+	ERRORLOG( "pattern node not found" );
+	return 0;
 }
 
-Pattern* Pattern::load_from( XMLNode* node, InstrumentList* instruments )
+Pattern* Pattern::load_from( XMLReader* reader, InstrumentList* instruments )
 {
-	Pattern* pattern = new Pattern(
-		node->read_string( "name", "unknown", false, false ),
-		node->read_string( "info", "", false, false ),
-		node->read_string( "category", "unknown", false, false ),
-		node->read_int( "size", -1, false, false )
-	);
-	XMLNode note_list_node = node->firstChildElement( "noteList" );
-	if ( !note_list_node.isNull() ) {
-		XMLNode note_node = note_list_node.firstChildElement( "note" );
-		while ( !note_node.isNull() ) {
-			Note* note = Note::load_from( &note_node, instruments );
-			if( note ) {
-				pattern->insert_note( note );
+	Pattern* pattern = new Pattern( "unknown", "", "unknown", -1 );
+	while( reader->readNextStartElement() ) {
+		if( reader->name_is( "name" ) ) {
+			pattern->set_name( reader->read_string( "unknown" ) );
+		} else if( reader->name_is( "info" ) ) {
+			pattern->set_info( reader->read_string( "" ) );
+		} else if( reader->name_is( "category" ) ) {
+			pattern->set_category( reader->read_string( "unknown" ) );
+		} else if( reader->name_is( "size" ) ) {
+			pattern->set_length( reader->read_int( -1 ) );
+		} else if( reader->name_is( "noteList" ) ) {
+			while( reader->readNextStartElement() ) {
+				if( reader->name_is( "note" ) ) {
+					Note* note = Note::load_from( reader, instruments );
+					if( note ) {
+						pattern->insert_note( note );
+					}
+				} else {
+					reader->skipCurrentElement();
+				}
 			}
-			note_node = note_node.nextSiblingElement( "note" );
+		} else {
+			reader->skipCurrentElement();
 		}
 	}
+	if( reader->hasError() ) {
+		ERRORLOG( QString( "Unable to read pattern: %1" ).arg( reader->errorString() ) );
+		delete pattern;
+		return 0;
+	}
 	return pattern;
 }
 
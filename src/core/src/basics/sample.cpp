@@ -22,16 +22,22 @@
 
 
 
+#include <algorithm>
+#include <cstdio>
 #include <limits>
 
 #include <hydrogen/hydrogen.h>
 #include <hydrogen/Preferences.h>
 #include <hydrogen/helpers/filesystem.h>
 #include <hydrogen/basics/sample.h>
+#include <hydrogen/basics/sample_pool.h>
+
+#define RUBBERBAND_CACHE_SIZE       ( 256 * 1024 * 1024 )   ///< bytes of stretched data kept by the SamplePool
 
 #ifdef H2CORE_HAVE_RUBBERBAND
 #include <rubberband/RubberBandStretcher.h>
 #define RUBBERBAND_BUFFER_OVERSIZE  500
+#define RUBBERBAND_BLOCK_SIZE       1024
 #define RUBBERBAND_DEBUG            0
 #endif
 
@@ -52,7 +58,8 @@ Sample::Sample( const QString& filepath,  int frames, int sample_rate, float* da
 	__sample_rate( sample_rate ),
 	__data_l( data_l ),
 	__data_r( data_r ),
-	__is_modified( false )
+	__is_modified( false ),
+	__is_shared( false )
 {
 	assert( filepath.lastIndexOf( "/" ) >0 );
 }
@@ -65,12 +72,19 @@ Sample::Sample( Sample* pOther ): Object( __class_name ),
 	__data_r( 0 ),
 	__is_modified( pOther->get_is_modified() ),
 	__loops( pOther->__loops ),
-	__rubberband( pOther->__rubberband )
+	__rubberband( pOther->__rubberband ),
+	__is_shared( pOther->__is_shared )
 {
-	__data_l = new float[__frames];
-	__data_r = new float[__frames];
-	memcpy( __data_l, pOther->get_data_l(), __frames );
-	memcpy( __data_r, pOther->get_data_r(), __frames );
+	if( __is_shared ) {
+		__data_l = pOther->get_data_l();
+		__data_r = pOther->get_data_r();
+		SamplePool::retain( __data_l );
+	} else if( pOther->get_data_l() ) {
+		__data_l = new float[__frames];
+		__data_r = new float[__frames];
+		memcpy( __data_l, pOther->get_data_l(), __frames * sizeof( float ) );
+		memcpy( __data_r, pOther->get_data_r(), __frames * sizeof( float ) );
+	}
 
 	PanEnvelope* pPan = pOther->get_pan_envelope();
 	for( int i=0; i<pPan->size(); i++ )
@@ -88,8 +102,32 @@ Sample::Sample( Sample* pOther ): Object( __class_name ),
 
 Sample::~Sample()
 {
-	if( __data_l!=0 ) delete[] __data_l;
-	if( __data_r!=0 ) delete[] __data_r;
+	free_data();
+}
+
+void Sample::free_data()
+{
+	if( __is_shared ) {
+		SamplePool::release( __data_l );
+	} else {
+		if( __data_l!=0 ) delete[] __data_l;
+		if( __data_r!=0 ) delete[] __data_r;
+	}
+	__data_l = __data_r = 0;
+	__is_shared = false;
+}
+
+void Sample::detach()
+{
+	if( !__is_shared ) return;
+	float* data_l = new float[ __frames ];
+	float* data_r = new float[ __frames ];
+	memcpy( data_l, __data_l, __frames * sizeof( float ) );
+	memcpy( data_r, __data_r, __frames * sizeof( float ) );
+	SamplePool::release( __data_l );
+	__data_l = data_l;
+	__data_r = data_r;
+	__is_shared = false;
 }
 
 void Sample::set_filename( const QString& filename )
@@ -111,34 +149,181 @@ Sample* Sample::load( const QString& filepath )
 	return sample;
 }
 
+/** \return the part of the SamplePool key telling the transformations applied to the data */
+static QString edits_key( const Sample::Loops& loops, const Sample::Rubberband& rubber, const Sample::VelocityEnvelope& velocity, const Sample::PanEnvelope& pan )
+{
+	QString key = QString( "|%1,%2,%3,%4,%5|" ).arg( loops.start_frame ).arg( loops.loop_frame ).arg( loops.end_frame ).arg( loops.count ).arg( loops.mode );
+	for( int i=0; i<velocity.size(); i++ ) key += QString( "%1,%2;" ).arg( velocity[i].frame ).arg( velocity[i].value );
+	key += "|";
+	for( int i=0; i<pan.size(); i++ ) key += QString( "%1,%2;" ).arg( pan[i].frame ).arg( pan[i].value );
+	if( rubber.use ) {
+		// the stretch depends on the tempo
+		key += QString( "|%1,%2,%3,%4" ).arg( rubber.divider ).arg( rubber.pitch ).arg( rubber.c_settings ).arg( Hydrogen::get_instance()->getNewBpmJTM() );
+	}
+	return key;
+}
+
 Sample* Sample::load( const QString& filepath, const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan )
 {
-	Sample* sample = Sample::load( filepath );
-	if( !sample ) return 0;
-	sample->apply( loops, rubber, velocity, pan );
+	if( !Filesystem::file_readable( filepath ) ) {
+		ERRORLOG( QString( "Unable to read %1" ).arg( filepath ) );
+		return 0;
+	}
+	Sample* sample = new Sample( filepath );
+	QString key = SamplePool::file_key( filepath );
+	if( !key.isEmpty() ) key += edits_key( loops, rubber, velocity, pan );
+	if( !key.isEmpty() && SamplePool::acquire( key, sample->__frames, sample->__sample_rate, sample->__data_l, sample->__data_r ) ) {
+		// the parameters the transformations leave behind
+		sample->__is_shared = true;
+		sample->__loops = loops;
+		sample->__velocity_envelope = velocity;
+		sample->__pan_envelope = pan;
+		if( rubber.use ) sample->__rubberband = rubber;
+		sample->__is_modified = !( loops==Loops() ) || !velocity.empty() || !pan.empty() || rubber.use;
+		if( rubber.use ) SamplePool::keep( sample->__data_l, RUBBERBAND_CACHE_SIZE );
+		return sample;
+	}
+	sample->load();
+	// the data is still the shared one of the file if nothing was applied
+	if( sample->apply( loops, rubber, velocity, pan ) && !sample->__is_shared && !key.isEmpty() ) {
+		SamplePool::share( key, sample->__frames, sample->__sample_rate, sample->__data_l, sample->__data_r );
+		sample->__is_shared = true;
+		// the stretches outlive the tempo they were made for, the tempos of the timeline or of an export come back
+		if( rubber.use ) SamplePool::keep( sample->__data_l, RUBBERBAND_CACHE_SIZE );
+	}
+	return sample;
+}
+
+Sample* Sample::load( const QString& filepath, const QByteArray& content )
+{
+	Sample* sample = new Sample( filepath );
+	QString key = SamplePool::file_key( filepath );
+	if( !key.isEmpty() && SamplePool::acquire( key, sample->__frames, sample->__sample_rate, sample->__data_l, sample->__data_r ) ) {
+		sample->__is_shared = true;
+		return sample;
+	}
+	if( !sample->load_data( content ) ) {
+		delete sample;
+		return 0;
+	}
+	if( !key.isEmpty() ) {
+		SamplePool::share( key, sample->__frames, sample->__sample_rate, sample->__data_l, sample->__data_r );
+		sample->__is_shared = true;
+	}
 	return sample;
 }
 
-void Sample::apply( const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan )
+bool Sample::rubberband_available()
+{
+#ifdef H2CORE_HAVE_RUBBERBAND
+	return true;
+#else
+	return QFile( Preferences::get_instance()->m_rubberBandCLIexecutable ).exists();
+#endif
+}
+
+bool Sample::apply( const Loops& loops, const Rubberband& rubber, const VelocityEnvelope& velocity, const PanEnvelope& pan )
 {
-	apply_loops( loops );
+	bool ret = apply_loops( loops );
 	apply_velocity( velocity );
 	apply_pan( pan );
 #ifdef H2CORE_HAVE_RUBBERBAND
 	apply_rubberband( rubber );
 #else
-	exec_rubberband_cli( rubber );
+	ret = exec_rubberband_cli( rubber ) && ret;
 #endif
+	return ret;
 }
 
 void Sample::load()
+{
+	QString key = SamplePool::file_key( __filepath );
+	int frames, sample_rate;
+	float* data_l;
+	float* data_r;
+	if( !key.isEmpty() && SamplePool::acquire( key, frames, sample_rate, data_l, data_r ) ) {
+		unload();
+		__frames = frames;
+		__sample_rate = sample_rate;
+		__data_l = data_l;
+		__data_r = data_r;
+		__is_shared = true;
+		return;
+	}
+	if( load_data() && !key.isEmpty() ) {
+		SamplePool::share( key, __frames, __sample_rate, __data_l, __data_r );
+		__is_shared = true;
+	}
+}
+
+bool Sample::load_data()
 {
 	SF_INFO sound_info;
 	SNDFILE* file = sf_open( __filepath.toLocal8Bit(), SFM_READ, &sound_info );
 	if ( !file ) {
 		ERRORLOG( QString( "[Sample::load] Error loading file %1" ).arg( __filepath ) );
-		return;
+		return false;
+	}
+	return read_data( file, sound_info );
+}
+
+/** a file content in memory, read by libsndfile through the callbacks below */
+struct MemoryFile {
+	const QByteArray* content;
+	sf_count_t pos;
+};
+
+static sf_count_t memory_file_length( void* user_data )
+{
+	return ( ( MemoryFile* )user_data )->content->size();
+}
+
+static sf_count_t memory_file_seek( sf_count_t offset, int whence, void* user_data )
+{
+	MemoryFile* file = ( MemoryFile* )user_data;
+	sf_count_t pos = offset;
+	if( whence==SEEK_CUR ) pos += file->pos;
+	else if( whence==SEEK_END ) pos += file->content->size();
+	if( pos<0 || pos>file->content->size() ) return -1;
+	file->pos = pos;
+	return pos;
+}
+
+static sf_count_t memory_file_read( void* ptr, sf_count_t count, void* user_data )
+{
+	MemoryFile* file = ( MemoryFile* )user_data;
+	count = std::min( count, file->content->size() - file->pos );
+	memcpy( ptr, file->content->constData() + file->pos, count );
+	file->pos += count;
+	return count;
+}
+
+static sf_count_t memory_file_write( const void*, sf_count_t, void* )
+{
+	return 0;
+}
+
+static sf_count_t memory_file_tell( void* user_data )
+{
+	return ( ( MemoryFile* )user_data )->pos;
+}
+
+bool Sample::load_data( const QByteArray& content )
+{
+	SF_VIRTUAL_IO io = { memory_file_length, memory_file_seek, memory_file_read, memory_file_write, memory_file_tell };
+	MemoryFile memory_file = { &content, 0 };
+	SF_INFO sound_info;
+	memset( &sound_info, 0, sizeof( sound_info ) );
+	SNDFILE* file = sf_open_virtual( &io, SFM_READ, &sound_info, &memory_file );
+	if ( !file ) {
+		ERRORLOG( QString( "[Sample::load] Error decoding %1: %2" ).arg( __filepath ).arg( sf_strerror( 0 ) ) );
+		return false;
 	}
+	return read_data( file, sound_info );
+}
+
+bool Sample::read_data( SNDFILE* file, SF_INFO& sound_info )
+{
 	if ( sound_info.channels > SAMPLE_CHANNELS ) {
 		WARNINGLOG( QString( "can't handle %1 channels, only 2 will be used" ).arg( sound_info.channels ) );
 		sound_info.channels = SAMPLE_CHANNELS;
@@ -171,6 +356,7 @@ void Sample::load()
 		}
 	}
 	delete[] buffer;
+	return true;
 }
 
 bool Sample::apply_loops( const Loops& lo )
@@ -246,8 +432,7 @@ bool Sample::apply_loops( const Loops& lo )
 		assert( x==new_length );
 	}
 	__loops = lo;
-	delete [] __data_l;
-	delete [] __data_r;
+	free_data();
 	__data_l = new_data_l;
 	__data_r = new_data_r;
 	__frames = new_length;
@@ -264,6 +449,7 @@ void Sample::apply_velocity( const VelocityEnvelope& v )
 	if( v.empty() && __velocity_envelope.empty() ) return;
 	__velocity_envelope.clear();
 	if ( v.size() > 0 ) {
+		detach();
 		float inv_resolution = __frames / 841.0F;
 		for ( int i = 1; i < v.size(); i++ ) {
 			float y = ( 91 - v[i - 1].value ) / 91.0F;
@@ -290,6 +476,7 @@ void Sample::apply_pan( const PanEnvelope& p )
 	if( p.empty() && __pan_envelope.empty() ) return;
 	__pan_envelope.clear();
 	if ( p.size() > 0 ) {
+		detach();
 		float inv_resolution = __frames / 841.0F;
 		for ( int i = 1; i < p.size(); i++ ) {
 			float y = ( 45 - p[i - 1].value ) / 45.0F;
@@ -332,38 +519,27 @@ void Sample::apply_rubberband( const Rubberband& rb )
 	double time_ratio = output_duration / get_sample_duration();
 	RubberBand::RubberBandStretcher::Options options = compute_rubberband_options( rb );
 	double pitch_scale = compute_pitch_scale( rb );
-	// output buffer
-	int out_buffer_size = ( int )( __frames* time_ratio + 0.1 );
+	// output buffer, the stretcher may retrieve a few more frames than computed
+	int out_buffer_size = ( int )( __frames* time_ratio + 0.1 ) + RUBBERBAND_BUFFER_OVERSIZE;
 	// instanciate rubberband
-	RubberBand::RubberBandStretcher* rubber = new RubberBand::RubberBandStretcher( __sample_rate, 2, options, time_ratio, pitch_scale );
-	rubber->setDebugLevel( RUBBERBAND_DEBUG );
-	rubber->setExpectedInputDuration( __frames );
+	RubberBand::RubberBandStretcher rubber( __sample_rate, 2, options, time_ratio, pitch_scale );
+	rubber.setDebugLevel( RUBBERBAND_DEBUG );
+	rubber.setExpectedInputDuration( __frames );
 
 	//DEBUGLOG( QString( "on %1\n\toptions\t\t: %2\n\ttime ratio\t: %3\n\tpitch\t\t: %4" ).arg( get_filename() ).arg( options ).arg( time_ratio ).arg( pitch_scale ) );
 
-	int block_size = Hydrogen::get_instance()->getAudioOutput()->getBufferSize();
-	float* ibuf[2];
+	// the data is read in place, by blocks of a fixed size as it may be stretched out of the audio driver
+	const float* ibuf[2];
 	int studied = 0;
-
 	while( studied < __frames ) {
-		bool final = (studied + block_size >= __frames);
-		int ibs = (final ? (__frames-studied) : block_size );
-		//___DEBUGLOG( QString(" ibs : %1").arg( ibs ) );
-		float tempIbufL[ibs];
-		float tempIbufR[ibs];
-		for(int i = 0 ;i < ibs; i++){
-			tempIbufL[i] = __data_l[i + studied];
-			tempIbufR[i] = __data_r[i + studied];
-		}
-		ibuf[0] = tempIbufL;
-		ibuf[1] = tempIbufR;
-		rubber->study( ibuf, ibs, final );
+		int ibs = std::min( RUBBERBAND_BLOCK_SIZE, __frames - studied );
+		ibuf[0] = __data_l + studied;
+		ibuf[1] = __data_r + studied;
+		rubber.study( ibuf, ibs, studied + ibs >= __frames );
 		studied += ibs;
-		if( final ) break;
 	}
 
-	//int buffer_free = out_buffer_size;
-	float* out_data_l= new float[ out_buffer_size ];
+	float* out_data_l = new float[ out_buffer_size ];
 	float* out_data_r = new float[ out_buffer_size ];
 	// retrieve data
 	float* obuf[2];
@@ -371,58 +547,31 @@ void Sample::apply_rubberband( const Rubberband& rb )
 	int available = 0;
 	int retrieved = 0;
 	while( processed < __frames ) {
-		bool final = (processed + block_size >= __frames);
-		int ibs = (final ? (__frames-processed) : block_size );
-		float tempIbufL[ibs];
-		float tempIbufR[ibs];
-		for(int i = 0 ;i < ibs; i++){
-			tempIbufL[i] = __data_l[i + processed];
-			tempIbufR[i] = __data_r[i + processed];
-		}
-		ibuf[0] = tempIbufL;
-		ibuf[1] = tempIbufR;
-		rubber->process( ibuf, ibs, final );
+		int ibs = std::min( RUBBERBAND_BLOCK_SIZE, __frames - processed );
+		ibuf[0] = __data_l + processed;
+		ibuf[1] = __data_r + processed;
+		rubber.process( ibuf, ibs, processed + ibs >= __frames );
 		processed += ibs;
 
-		// first run of stretcher.retrieve() frames.
-		// we retrieve audio frames from stretcher until
-		// available is >0. but important here is that stretcher
-		// is not finished processing even available is 0.
-		// stretcher finished with -1. but this status we
-		// cannot reach here, because stretcher becomes new
-		// inputbuffer in this while loop.
-		// we need a final run of stretcher after input processing loop
-		// is finished
-		while( (available=rubber->available())>0) {
+		// the stretcher is not done while processing, even if nothing is available,
+		// it returns -1 once finished, after the final run below
+		while( ( available=rubber.available() ) > 0 && retrieved < out_buffer_size ) {
 			obuf[0] = &out_data_l[retrieved];
 			obuf[1] = &out_data_r[retrieved];
-			int n = rubber->retrieve( obuf, available);
-
-			retrieved += n;
-			//buffer_free -= n;
+			retrieved += rubber.retrieve( obuf, std::min( available, out_buffer_size - retrieved ) );
 		}
-		if( final ) break;
 	}
 
-	// second run of stretcher to retrieve all last
-	// frames until stretcher returns -1.
-	while( (available=rubber->available())!= -1) {
+	// final run of the stretcher, until it returns -1
+	while( ( available=rubber.available() ) != -1 && retrieved < out_buffer_size ) {
 		obuf[0] = &out_data_l[retrieved];
 		obuf[1] = &out_data_r[retrieved];
-		int n = rubber->retrieve( obuf, available);
-
-		retrieved += n;
-		//buffer_free -= n;
+		retrieved += rubber.retrieve( obuf, std::min( available, out_buffer_size - retrieved ) );
 	}
 
-//    qDebug()<<"outputbuffersize"<<out_buffer_size;
-//    qDebug()<<"retrieved frames"<<retrieved;
-//    qDebug()<<"stretcher status"<<rubber->available();
-
 	// DEBUGLOG( QString( "%1 frames processed, %2 frames retrieved" ).arg( __frames ).arg( retrieved ) );
 	// final data buffers
-	delete [] __data_l;
-	delete [] __data_r;
+	free_data();
 	__data_l = new float[ retrieved ];
 	__data_r = new float[ retrieved ];
 	memcpy( __data_l, out_data_l, retrieved*sizeof( float ) );
@@ -447,7 +596,9 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb )
 	}
 
 	if( rb.use ) {
-		QString outfilePath =  QDir::tempPath() + "/tmp_rb_outfile.wav";
+		// several samples may be stretched at once
+		QString tmpId = QString::number( ( quintptr )this, 16 );
+		QString outfilePath =  QDir::tempPath() + "/tmp_rb_outfile_" + tmpId + ".wav";
 		if( !write( outfilePath ) ) {
 			ERRORLOG( "unable to write sample" );
 			return false;
@@ -469,7 +620,7 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb )
 		QString rCs = QString( " %1" ).arg( rb.c_settings );
 		float pitch = pow( 1.0594630943593, ( double )rb.pitch );
 		QString rPs = QString( " %1" ).arg( pitch );
-		QString rubberResultPath = QDir::tempPath() + "/tmp_rb_result_file.wav";
+		QString rubberResultPath = QDir::tempPath() + "/tmp_rb_result_file_" + tmpId + ".wav";
 
 		arguments << "-D" << QString( " %1" ).arg( durationtime ) 	//stretch or squash to make output file X seconds long
 				  << "--threads"					//assume multi-CPU even if only one CPU is identified
@@ -484,13 +635,17 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb )
 		while( !	pRrubberbandProc->waitForFinished() ) {
 			//_ERRORLOG( QString( "prozessing" ));
 		}
+		// it has no parent to delete it
+		delete pRrubberbandProc;
 		if ( QFile( rubberResultPath ).exists() == false ) {
 			_ERRORLOG( QString( "Rubberband reimporter File %1 not found" ).arg( rubberResultPath ) );
 			return false;
 		}
 
-		Sample* p_Rubberbanded = Sample::load( rubberResultPath.toLocal8Bit() );
-		if( p_Rubberbanded==0 ) {
+		// not shared, the file is removed below
+		Sample* p_Rubberbanded = new Sample( rubberResultPath );
+		if( !p_Rubberbanded->load_data() ) {
+			delete p_Rubberbanded;
 			return false;
 		}
 
@@ -498,6 +653,7 @@ bool Sample::exec_rubberband_cli( const Rubberband& rb )
 
 		QFile( rubberResultPath ).remove();
 
+		free_data();
 		__frames = p_Rubberbanded->get_frames();
 		__data_l = p_Rubberbanded->get_data_l();
 		__data_r = p_Rubberbanded->get_data_r();
@@ -663,6 +819,8 @@ static RubberBand::RubberBandStretcher::Options compute_rubberband_options( cons
 	//if (formant)     options |= RubberBand::RubberBandStretcher::OptionFormantPreserved;
 	//if (hqpitch)     options |= RubberBand::RubberBandStretcher::OptionPitchHighQuality;
 	options |= RubberBand::RubberBandStretcher::OptionPitchHighQuality;
+	// the samples are stretched in parallel, one per thread, see Hydrogen::recalculateRubberband()
+	options |= RubberBand::RubberBandStretcher::OptionThreadingNever;
 	/*
 	switch (threading) {
 	case 0:
@@ -0,0 +1,192 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+
+#include <hydrogen/basics/sample_pool.h>
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+
+#include <pthread.h>
+
+namespace
+{
+
+/// data stored under a key
+struct Entry {
+	QString key;
+	int frames;
+	int sample_rate;
+	float* data_l;
+	float* data_r;
+	int refs;
+};
+
+pthread_mutex_t __mutex = PTHREAD_MUTEX_INITIALIZER;
+// allocated once and never deleted, samples may outlive the static objects
+QHash<QString, Entry*>* __entries = 0;
+QHash<const float*, Entry*>* __entries_by_data = 0;
+// the entries referenced by the pool itself, the least recently kept first
+QList<Entry*>* __kept = 0;
+qint64 __kept_bytes = 0;
+
+qint64 entry_bytes( const Entry* entry )
+{
+	return entry->frames * sizeof( float ) * 2;
+}
+
+/// drop a reference to an entry, the lock being held
+void unref( Entry* entry )
+{
+	if( --entry->refs==0 ) {
+		__entries->remove( entry->key );
+		__entries_by_data->remove( entry->data_l );
+		delete[] entry->data_l;
+		delete[] entry->data_r;
+		delete entry;
+	}
+}
+
+}//anonymous namespace
+
+namespace H2Core
+{
+
+const char* SamplePool::__class_name = "SamplePool";
+
+QString SamplePool::file_key( const QString& filepath )
+{
+	QFileInfo info( filepath );
+	if( !info.exists() ) return QString();
+	return QString( "%1:%2:%3" ).arg( info.canonicalFilePath() ).arg( info.size() ).arg( info.lastModified().toMSecsSinceEpoch() );
+}
+
+bool SamplePool::acquire( const QString& key, int& frames, int& sample_rate, float*& data_l, float*& data_r )
+{
+	pthread_mutex_lock( &__mutex );
+	Entry* entry = __entries ? __entries->value( key, 0 ) : 0;
+	if( entry ) {
+		entry->refs++;
+		frames = entry->frames;
+		sample_rate = entry->sample_rate;
+		data_l = entry->data_l;
+		data_r = entry->data_r;
+	}
+	pthread_mutex_unlock( &__mutex );
+	return entry!=0;
+}
+
+void SamplePool::share( const QString& key, int& frames, int& sample_rate, float*& data_l, float*& data_r )
+{
+	pthread_mutex_lock( &__mutex );
+	if( __entries==0 ) {
+		__entries = new QHash<QString, Entry*>();
+		__entries_by_data = new QHash<const float*, Entry*>();
+	}
+	Entry* entry = __entries->value( key, 0 );
+	if( entry ) {
+		// loaded by another thread meanwhile
+		delete[] data_l;
+		delete[] data_r;
+	} else {
+		entry = new Entry;
+		entry->key = key;
+		entry->frames = frames;
+		entry->sample_rate = sample_rate;
+		entry->data_l = data_l;
+		entry->data_r = data_r;
+		entry->refs = 0;
+		__entries->insert( key, entry );
+		__entries_by_data->insert( data_l, entry );
+	}
+	entry->refs++;
+	frames = entry->frames;
+	sample_rate = entry->sample_rate;
+	data_l = entry->data_l;
+	data_r = entry->data_r;
+	pthread_mutex_unlock( &__mutex );
+}
+
+void SamplePool::retain( const float* data_l )
+{
+	pthread_mutex_lock( &__mutex );
+	Entry* entry = __entries_by_data ? __entries_by_data->value( data_l, 0 ) : 0;
+	if( entry ) entry->refs++;
+	pthread_mutex_unlock( &__mutex );
+	if( entry==0 ) _ERRORLOG( "retaining data not in the pool" );
+}
+
+void SamplePool::release( const float* data_l )
+{
+	pthread_mutex_lock( &__mutex );
+	Entry* entry = __entries_by_data ? __entries_by_data->value( data_l, 0 ) : 0;
+	if( entry ) unref( entry );
+	pthread_mutex_unlock( &__mutex );
+	if( entry==0 ) _ERRORLOG( "releasing data not in the pool" );
+}
+
+void SamplePool::keep( const float* data_l, qint64 max_bytes )
+{
+	pthread_mutex_lock( &__mutex );
+	Entry* entry = __entries_by_data ? __entries_by_data->value( data_l, 0 ) : 0;
+	if( entry ) {
+		if( __kept==0 ) __kept = new QList<Entry*>();
+		int i = __kept->indexOf( entry );
+		if( i!=-1 ) {
+			__kept->move( i, __kept->size() - 1 );
+		} else {
+			entry->refs++;
+			__kept->append( entry );
+			__kept_bytes += entry_bytes( entry );
+		}
+		// the data just kept stays, whatever its size
+		while( __kept_bytes > max_bytes && __kept->size() > 1 ) {
+			Entry* oldest = __kept->takeFirst();
+			__kept_bytes -= entry_bytes( oldest );
+			unref( oldest );
+		}
+	}
+	pthread_mutex_unlock( &__mutex );
+	if( entry==0 ) _ERRORLOG( "keeping data not in the pool" );
+}
+
+int SamplePool::size( qint64* bytes )
+{
+	pthread_mutex_lock( &__mutex );
+	int count = __entries ? __entries->size() : 0;
+	if( bytes ) {
+		*bytes = 0;
+		if( __entries ) {
+			for( QHash<QString, Entry*>::const_iterator it = __entries->constBegin(); it!=__entries->constEnd(); ++it ) {
+				*bytes += entry_bytes( it.value() );
+			}
+		}
+	}
+	pthread_mutex_unlock( &__mutex );
+	return count;
+}
+
+};
+
+/* vim: set softtabstop=4 expandtab: */
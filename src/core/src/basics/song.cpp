@@ -32,24 +32,127 @@
 #include <hydrogen/globals.h>
 #include <hydrogen/timeline.h>
 #include <hydrogen/basics/song.h>
+#include <hydrogen/basics/song_snapshot.h>
 #include <hydrogen/basics/drumkit_component.h>
 #include <hydrogen/basics/sample.h>
 #include <hydrogen/basics/instrument.h>
 #include <hydrogen/basics/instrument_component.h>
 #include <hydrogen/basics/instrument_list.h>
 #include <hydrogen/basics/instrument_layer.h>
+#include <hydrogen/basics/layer_loader.h>
 #include <hydrogen/basics/pattern.h>
 #include <hydrogen/basics/pattern_list.h>
 #include <hydrogen/basics/note.h>
 #include <hydrogen/helpers/filesystem.h>
+#include <hydrogen/helpers/xml.h>
 #include <hydrogen/hydrogen.h>
 
 #include <QDomDocument>
 #include <QDir>
+#include <QHash>
 
 namespace
 {
 
+/// a layer of a song instrument, its sample is loaded once the whole instrument is read
+struct LayerInfo {
+	LayerInfo() : bIsModified( false ), fMin( 0.0 ), fMax( 1.0 ), fGain( 1.0 ), fPitch( 0.0 ) {
+		ro.divider = 0.0;
+		ro.c_settings = 1;
+		ro.pitch = 0.0;
+	}
+	QString sFilename;
+	bool bIsModified;
+	H2Core::Sample::Loops lo;
+	H2Core::Sample::Rubberband ro;
+	float fMin;
+	float fMax;
+	float fGain;
+	float fPitch;
+	H2Core::Sample::VelocityEnvelope velocity;
+	H2Core::Sample::PanEnvelope pan;
+};
+
+struct ComponentInfo {
+	int nId;
+	std::vector<LayerInfo> layers;
+};
+
+/// a LADSPA effect of the song, loaded once the whole song is read
+struct FxInfo {
+	FxInfo() : bEnabled( false ), fVolume( 1.0 ) {}
+	QString sName;
+	QString sFilename;
+	bool bEnabled;
+	float fVolume;
+	std::vector< std::pair<QString, float> > inputControlPorts;
+};
+
+/// reads the layer element the reader is at
+LayerInfo readLayer( H2Core::XMLReader& reader, bool bUseRubberband )
+{
+	LayerInfo layer;
+	H2Core::Sample::EnvelopePoint pt;
+	while ( reader.readNextStartElement() ) {
+		if ( reader.name_is( "filename" ) ) {
+			layer.sFilename = reader.read_string( "" );
+		} else if ( reader.name_is( "ismodified" ) ) {
+			layer.bIsModified = reader.read_bool( false );
+		} else if ( reader.name_is( "smode" ) ) {
+			layer.lo.mode = H2Core::Sample::parse_loop_mode( reader.read_string( "forward" ) );
+		} else if ( reader.name_is( "startframe" ) ) {
+			layer.lo.start_frame = reader.read_int( 0 );
+		} else if ( reader.name_is( "loopframe" ) ) {
+			layer.lo.loop_frame = reader.read_int( 0 );
+		} else if ( reader.name_is( "loops" ) ) {
+			layer.lo.count = reader.read_int( 0 );
+		} else if ( reader.name_is( "endframe" ) ) {
+			layer.lo.end_frame = reader.read_int( 0 );
+		} else if ( reader.name_is( "userubber" ) ) {
+			layer.ro.use = reader.read_int( 0 );
+		} else if ( reader.name_is( "rubberdivider" ) ) {
+			layer.ro.divider = reader.read_float( 0.0 );
+		} else if ( reader.name_is( "rubberCsettings" ) ) {
+			layer.ro.c_settings = reader.read_int( 1 );
+		} else if ( reader.name_is( "rubberPitch" ) ) {
+			layer.ro.pitch = reader.read_float( 0.0 );
+		} else if ( reader.name_is( "min" ) ) {
+			layer.fMin = reader.read_float( 0.0 );
+		} else if ( reader.name_is( "max" ) ) {
+			layer.fMax = reader.read_float( 1.0 );
+		} else if ( reader.name_is( "gain" ) ) {
+			layer.fGain = reader.read_float( 1.0 );
+		} else if ( reader.name_is( "pitch" ) ) {
+			layer.fPitch = reader.read_float( 0.0 );
+		} else if ( reader.name_is( "volume" ) || reader.name_is( "pan" ) ) {
+			bool bVolume = reader.name_is( "volume" );
+			pt.frame = 0;
+			pt.value = 0;
+			while ( reader.readNextStartElement() ) {
+				if ( reader.name_is( "volume-position" ) || reader.name_is( "pan-position" ) ) {
+					pt.frame = reader.read_int( 0 );
+				} else if ( reader.name_is( "volume-value" ) || reader.name_is( "pan-value" ) ) {
+					pt.value = reader.read_int( 0 );
+				} else {
+					reader.skipCurrentElement();
+				}
+			}
+			if ( bVolume ) {
+				layer.velocity.push_back( pt );
+			} else {
+				layer.pan.push_back( pt );
+			}
+		} else {
+			reader.skipCurrentElement();
+		}
+	}
+	//test the path. if test fails, disable rubberband
+	if ( !bUseRubberband ) {
+		layer.ro.use = false;
+	}
+	return layer;
+}
+
 }//anonymous namespace
 namespace H2Core
 {
@@ -125,9 +228,13 @@ Song* Song::load( const QString& filename )
 	return reader.readSong( filename );
 }
 
-/// Save a song to file
+/// Save a song to file, as a snapshot if the filename has its extension
 bool Song::save( const QString& filename )
 {
+	if ( filename.endsWith( SongSnapshot::extension ) ) {
+		return SongSnapshot::save( this, filename );
+	}
+
 	SongWriter writer;
 	int err;
 	err = writer.writeSong( this, filename );
@@ -391,53 +498,309 @@ const QString SongReader::getPath ( const QString& filename )
 ///
 /// Reads a song.
 /// return NULL = error reading song file.
+/// The binary snapshots are recognized by their magic and read by SongSnapshot.
+///
+/// The song is built while the file is read, without a tree of the
+/// document, in the order written by SongWriter: the instruments have
+/// to be read before the patterns and the patterns before the sequence.
 ///
 Song* SongReader::readSong( const QString& filename )
 {
 	QString FileName = getPath ( filename );
 	if ( FileName.isEmpty() ) return NULL;
 
-	INFOLOG( "Reading " + FileName );
-	Song* song = NULL;
+	if ( SongSnapshot::is_snapshot( FileName ) ) {
+		return SongSnapshot::load( FileName );
+	}
 
-	QDomDocument doc = LocalFileMng::openXmlDocument( FileName );
-	QDomNodeList nodeList = doc.elementsByTagName( "song" );
+	INFOLOG( "Reading " + FileName );
 
-	if( nodeList.isEmpty() ) {
+	XMLReader reader;
+	if ( !reader.read( FileName, "song" ) ) {
 		ERRORLOG( "Error reading song: song node not found" );
 		return NULL;
 	}
 
-	QDomNode songNode = nodeList.at( 0 );
-
-	m_sSongVersion = LocalFileMng::readXmlString( songNode , "version", "Unknown version" );
-
-	if ( m_sSongVersion != QString( get_version().c_str() ) ) {
-		WARNINGLOG( "Trying to load a song created with a different version of hydrogen." );
-		WARNINGLOG( "Song [" + FileName + "] saved with version " + m_sSongVersion );
-	}
-
-	float fBpm = LocalFileMng::readXmlFloat( songNode, "bpm", 120 );
-	Hydrogen::get_instance()->setNewBpmJTM( fBpm );
-	float fVolume = LocalFileMng::readXmlFloat( songNode, "volume", 0.5 );
-	float fMetronomeVolume = LocalFileMng::readXmlFloat( songNode, "metronomeVolume", 0.5 );
-	QString sName( LocalFileMng::readXmlString( songNode, "name", "Untitled Song" ) );
-	QString sAuthor( LocalFileMng::readXmlString( songNode, "author", "Unknown Author" ) );
-	QString sNotes( LocalFileMng::readXmlString( songNode, "notes", "..." ) );
-	QString sLicense( LocalFileMng::readXmlString( songNode, "license", "Unknown license" ) );
-	bool bLoopEnabled = LocalFileMng::readXmlBool( songNode, "loopEnabled", false );
-	Preferences::get_instance()->setPatternModePlaysSelected( LocalFileMng::readXmlBool( songNode, "patternModeMode", true ) );
+	m_sSongVersion = "Unknown version";
+	float fBpm = 120;
+	float fVolume = 0.5;
+	float fMetronomeVolume = 0.5;
+	QString sName( "Untitled Song" );
+	QString sAuthor( "Unknown Author" );
+	QString sNotes( "..." );
+	QString sLicense( "Unknown license" );
+	bool bLoopEnabled = false;
+	bool bPatternModePlaysSelected = true;
 	Song::SongMode nMode = Song::PATTERN_MODE;	// Mode (song/pattern)
-	QString sMode = LocalFileMng::readXmlString( songNode, "mode", "pattern" );
-	if ( sMode == "song" ) {
-		nMode = Song::SONG_MODE;
+	float fHumanizeTimeValue = 0.0;
+	float fHumanizeVelocityValue = 0.0;
+	float fSwingFactor = 0.0;
+
+	std::vector<DrumkitComponent*> components;
+	bool bComponentList = false;
+	InstrumentList* instrumentList = NULL;
+	QString sDrumkit;
+	PatternList* patternList = new PatternList();
+	QHash<QString, Pattern*> patternsByName;
+	std::vector<PatternList*>* pPatternGroupVector = new std::vector<PatternList*>;
+	std::vector<FxInfo> fxList;
+	bool bLadspa = false;
+	Timeline::HTimelineVector tlvector;
+	std::vector<Timeline::HTimelineVector> timelineVector;
+	bool bBPMTimeLine = false;
+	Timeline::HTimelineTagVector tltagvector;
+	std::vector<Timeline::HTimelineTagVector> timelineTagVector;
+	bool bTimeLineTag = false;
+
+	// the rubberband settings of the layers are only kept if the samples can be stretched
+	bool bUseRubberband = Sample::rubberband_available();
+
+	while ( reader.readNextStartElement() ) {
+		if ( reader.name_is( "version" ) ) {
+			m_sSongVersion = reader.read_string( m_sSongVersion );
+		} else if ( reader.name_is( "bpm" ) ) {
+			fBpm = reader.read_float( fBpm );
+		} else if ( reader.name_is( "volume" ) ) {
+			fVolume = reader.read_float( fVolume );
+		} else if ( reader.name_is( "metronomeVolume" ) ) {
+			fMetronomeVolume = reader.read_float( fMetronomeVolume );
+		} else if ( reader.name_is( "name" ) ) {
+			sName = reader.read_string( sName );
+		} else if ( reader.name_is( "author" ) ) {
+			sAuthor = reader.read_string( sAuthor );
+		} else if ( reader.name_is( "notes" ) ) {
+			sNotes = reader.read_string( sNotes );
+		} else if ( reader.name_is( "license" ) ) {
+			sLicense = reader.read_string( sLicense );
+		} else if ( reader.name_is( "loopEnabled" ) ) {
+			bLoopEnabled = reader.read_bool( bLoopEnabled );
+		} else if ( reader.name_is( "patternModeMode" ) ) {
+			bPatternModePlaysSelected = reader.read_bool( bPatternModePlaysSelected );
+		} else if ( reader.name_is( "mode" ) ) {
+			nMode = ( reader.read_string( "pattern" ) == "song" ) ? Song::SONG_MODE : Song::PATTERN_MODE;
+		} else if ( reader.name_is( "humanize_time" ) ) {
+			fHumanizeTimeValue = reader.read_float( fHumanizeTimeValue );
+		} else if ( reader.name_is( "humanize_velocity" ) ) {
+			fHumanizeVelocityValue = reader.read_float( fHumanizeVelocityValue );
+		} else if ( reader.name_is( "swing_factor" ) ) {
+			fSwingFactor = reader.read_float( fSwingFactor );
+		} else if ( reader.name_is( "componentList" ) ) {
+			bComponentList = true;
+			while ( reader.readNextStartElement() ) {
+				if ( !reader.name_is( "drumkitComponent" ) ) {
+					reader.skipCurrentElement();
+					continue;
+				}
+				int id = -1;
+				QString sComponentName = "";
+				float fComponentVolume = 1.0;
+				while ( reader.readNextStartElement() ) {
+					if ( reader.name_is( "id" ) ) {
+						id = reader.read_int( id );
+					} else if ( reader.name_is( "name" ) ) {
+						sComponentName = reader.read_string( sComponentName );
+					} else if ( reader.name_is( "volume" ) ) {
+						fComponentVolume = reader.read_float( fComponentVolume );
+					} else {
+						reader.skipCurrentElement();
+					}
+				}
+				DrumkitComponent* pDrumkitComponent = new DrumkitComponent( id, sComponentName );
+				pDrumkitComponent->set_volume( fComponentVolume );
+				components.push_back( pDrumkitComponent );
+			}
+		} else if ( reader.name_is( "instrumentList" ) ) {
+			if ( instrumentList == NULL ) {
+				instrumentList = new InstrumentList();
+			}
+			int instrumentList_count = 0;
+			while ( reader.readNextStartElement() ) {
+				if ( !reader.name_is( "instrument" ) ) {
+					reader.skipCurrentElement();
+					continue;
+				}
+				instrumentList_count++;
+				Instrument* pInstrument = readInstrument( reader, bUseRubberband );
+				if ( pInstrument ) {
+					sDrumkit = pInstrument->get_drumkit_name();
+					instrumentList->add( pInstrument );
+				}
+			}
+			if ( instrumentList_count == 0 ) {
+				WARNINGLOG( "0 instruments?" );
+			}
+		} else if ( reader.name_is( "patternList" ) ) {
+			if ( instrumentList == NULL ) {
+				ERRORLOG( "Error reading song: patternList found before instrumentList" );
+				reader.skipCurrentElement();
+				continue;
+			}
+			int pattern_count = 0;
+			while ( reader.readNextStartElement() ) {
+				if ( !reader.name_is( "pattern" ) ) {
+					reader.skipCurrentElement();
+					continue;
+				}
+				pattern_count++;
+				Pattern* pat = readPattern( reader, instrumentList );
+				patternList->add( pat );
+				if ( !patternsByName.contains( pat->get_name() ) ) {
+					patternsByName.insert( pat->get_name(), pat );
+				}
+			}
+			if ( pattern_count == 0 ) {
+				WARNINGLOG( "0 patterns?" );
+			}
+		} else if ( reader.name_is( "virtualPatternList" ) ) {
+			while ( reader.readNextStartElement() ) {
+				if ( !reader.name_is( "pattern" ) ) {
+					reader.skipCurrentElement();
+					continue;
+				}
+				Pattern* curPattern = NULL;
+				while ( reader.readNextStartElement() ) {
+					if ( reader.name_is( "name" ) ) {
+						curPattern = patternsByName.value( reader.read_string( "" ), NULL );
+					} else if ( reader.name_is( "virtual" ) ) {
+						Pattern* virtPattern = patternsByName.value( reader.read_string( "" ), NULL );
+						if ( curPattern == NULL ) {
+							continue;	// the name is written first, an invalid one is reported below
+						}
+						if ( virtPattern != NULL ) {
+							curPattern->virtual_patterns_add( virtPattern );
+						} else {
+							ERRORLOG( "Song had invalid virtual pattern list data (virtual)" );
+						}
+					} else {
+						reader.skipCurrentElement();
+					}
+				}
+				if ( curPattern == NULL ) {
+					ERRORLOG( "Song had invalid virtual pattern list data (name)" );
+				}
+			}
+		} else if ( reader.name_is( "patternSequence" ) ) {
+			while ( reader.readNextStartElement() ) {
+				if ( reader.name_is( "patternID" ) ) {
+					// back-compatibility code..
+					WARNINGLOG( "Using old patternSequence code for back compatibility" );
+					QString patId;
+					while ( reader.readNextStartElement() ) {
+						if ( patId.isNull() ) {
+							patId = reader.read_string( "" );
+						} else {
+							reader.skipCurrentElement();
+						}
+					}
+					Pattern* pat = patternsByName.value( patId, NULL );
+					if ( pat == NULL ) {
+						WARNINGLOG( QString( "patternid '%1' not found in patternSequence" ).arg( patId ) );
+						continue;
+					}
+					PatternList* patternSequence = new PatternList();
+					patternSequence->add( pat );
+					pPatternGroupVector->push_back( patternSequence );
+				} else if ( reader.name_is( "group" ) ) {
+					PatternList* patternSequence = new PatternList();
+					while ( reader.readNextStartElement() ) {
+						if ( !reader.name_is( "patternID" ) ) {
+							reader.skipCurrentElement();
+							continue;
+						}
+						Pattern* pat = patternsByName.value( reader.read_string( "" ), NULL );
+						if ( pat == NULL ) {
+							WARNINGLOG( "patternid not found in patternSequence" );
+							continue;
+						}
+						patternSequence->add( pat );
+					}
+					pPatternGroupVector->push_back( patternSequence );
+				} else {
+					reader.skipCurrentElement();
+				}
+			}
+		} else if ( reader.name_is( "ladspa" ) ) {
+			bLadspa = true;
+			while ( reader.readNextStartElement() ) {
+				if ( !reader.name_is( "fx" ) ) {
+					reader.skipCurrentElement();
+					continue;
+				}
+				FxInfo fx;
+				while ( reader.readNextStartElement() ) {
+					if ( reader.name_is( "name" ) ) {
+						fx.sName = reader.read_string( fx.sName );
+					} else if ( reader.name_is( "filename" ) ) {
+						fx.sFilename = reader.read_string( fx.sFilename );
+					} else if ( reader.name_is( "enabled" ) ) {
+						fx.bEnabled = reader.read_bool( fx.bEnabled );
+					} else if ( reader.name_is( "volume" ) ) {
+						fx.fVolume = reader.read_float( fx.fVolume );
+					} else if ( reader.name_is( "inputControlPort" ) ) {
+						QString sPortName = "";
+						float fValue = 0.0;
+						while ( reader.readNextStartElement() ) {
+							if ( reader.name_is( "name" ) ) {
+								sPortName = reader.read_string( sPortName );
+							} else if ( reader.name_is( "value" ) ) {
+								fValue = reader.read_float( fValue );
+							} else {
+								reader.skipCurrentElement();
+							}
+						}
+						fx.inputControlPorts.push_back( std::make_pair( sPortName, fValue ) );
+					} else {
+						reader.skipCurrentElement();
+					}
+				}
+				fxList.push_back( fx );
+			}
+		} else if ( reader.name_is( "BPMTimeLine" ) ) {
+			bBPMTimeLine = true;
+			while ( reader.readNextStartElement() ) {
+				if ( !reader.name_is( "newBPM" ) ) {
+					reader.skipCurrentElement();
+					continue;
+				}
+				tlvector.m_htimelinebeat = 0;
+				tlvector.m_htimelinebpm = 120.0;
+				while ( reader.readNextStartElement() ) {
+					if ( reader.name_is( "BAR" ) ) {
+						tlvector.m_htimelinebeat = reader.read_int( 0 );
+					} else if ( reader.name_is( "BPM" ) ) {
+						tlvector.m_htimelinebpm = reader.read_float( 120.0 );
+					} else {
+						reader.skipCurrentElement();
+					}
+				}
+				timelineVector.push_back( tlvector );
+			}
+		} else if ( reader.name_is( "timeLineTag" ) ) {
+			bTimeLineTag = true;
+			while ( reader.readNextStartElement() ) {
+				if ( !reader.name_is( "newTAG" ) ) {
+					reader.skipCurrentElement();
+					continue;
+				}
+				tltagvector.m_htimelinetagbeat = 0;
+				tltagvector.m_htimelinetag = "";
+				while ( reader.readNextStartElement() ) {
+					if ( reader.name_is( "BAR" ) ) {
+						tltagvector.m_htimelinetagbeat = reader.read_int( 0 );
+					} else if ( reader.name_is( "TAG" ) ) {
+						tltagvector.m_htimelinetag = reader.read_string( "" );
+					} else {
+						reader.skipCurrentElement();
+					}
+				}
+				timelineTagVector.push_back( tltagvector );
+			}
+		} else {
+			reader.skipCurrentElement();
+		}
 	}
 
-	float fHumanizeTimeValue = LocalFileMng::readXmlFloat( songNode, "humanize_time", 0.0 );
-	float fHumanizeVelocityValue = LocalFileMng::readXmlFloat( songNode, "humanize_velocity", 0.0 );
-	float fSwingFactor = LocalFileMng::readXmlFloat( songNode, "swing_factor", 0.0 );
-
-	song = new Song( sName, sAuthor, fBpm, fVolume );
+	Song* song = new Song( sName, sAuthor, fBpm, fVolume );
 	song->set_metronome_volume( fMetronomeVolume );
 	song->set_notes( sNotes );
 	song->set_license( sLicense );
@@ -446,476 +809,43 @@ Song* SongReader::readSong( const QString& filename )
 	song->set_humanize_time_value( fHumanizeTimeValue );
 	song->set_humanize_velocity_value( fHumanizeVelocityValue );
 	song->set_swing_factor( fSwingFactor );
-
-	/*
-	song->m_bDelayFXEnabled = LocalFileMng::readXmlBool( songNode, "delayFXEnabled", false, false );
-	song->m_fDelayFXWetLevel = LocalFileMng::readXmlFloat( songNode, "delayFXWetLevel", 1.0, false, false );
-	song->m_fDelayFXFeedback= LocalFileMng::readXmlFloat( songNode, "delayFXFeedback", 0.4, false, false );
-	song->m_nDelayFXTime = LocalFileMng::readXmlInt( songNode, "delayFXTime", MAX_NOTES / 4, false, false );
-	*/
-
-	QDomNode componentListNode = songNode.firstChildElement( "componentList" );
-	if ( ( ! componentListNode.isNull()  ) ) {
-		QDomNode componentNode = componentListNode.firstChildElement( "drumkitComponent" );
-		while ( ! componentNode.isNull()  ) {
-            int id = LocalFileMng::readXmlInt( componentNode, "id", -1 );			// instrument id
-			QString sName = LocalFileMng::readXmlString( componentNode, "name", "" );		// name
-			float fVolume = LocalFileMng::readXmlFloat( componentNode, "volume", 1.0 );	// volume
-			DrumkitComponent* pDrumkitComponent = new DrumkitComponent( id, sName );
-			pDrumkitComponent->set_volume( fVolume );
-
-            song->get_components()->push_back(pDrumkitComponent);
-
-            componentNode = ( QDomNode ) componentNode.nextSiblingElement( "drumkitComponent" );
-		}
-	}
-	else {
-        DrumkitComponent* pDrumkitComponent = new DrumkitComponent( 0, "Main" );
-        song->get_components()->push_back(pDrumkitComponent);
+	if ( bComponentList ) {
+		song->get_components()->insert( song->get_components()->end(), components.begin(), components.end() );
+	} else {
+		DrumkitComponent* pDrumkitComponent = new DrumkitComponent( 0, "Main" );
+		song->get_components()->push_back( pDrumkitComponent );
 	}
+	song->set_instrument_list( instrumentList );
+	song->set_pattern_list( patternList );
+	song->set_pattern_group_vector( pPatternGroupVector );
 
-	//  Instrument List
-	InstrumentList* instrumentList = new InstrumentList();
-
-	QDomNode instrumentListNode = songNode.firstChildElement( "instrumentList" );
-	if ( ( ! instrumentListNode.isNull()  ) ) {
-		// INSTRUMENT NODE
-		int instrumentList_count = 0;
-		QDomNode instrumentNode;
-		instrumentNode = instrumentListNode.firstChildElement( "instrument" );
-		while ( ! instrumentNode.isNull()  ) {
-			instrumentList_count++;
-
-			int id = LocalFileMng::readXmlInt( instrumentNode, "id", -1 );			// instrument id
-			QString sDrumkit = LocalFileMng::readXmlString( instrumentNode, "drumkit", "" );	// drumkit
-			Hydrogen::get_instance()->setCurrentDrumkitname( sDrumkit );
-			QString sName = LocalFileMng::readXmlString( instrumentNode, "name", "" );		// name
-			float fVolume = LocalFileMng::readXmlFloat( instrumentNode, "volume", 1.0 );	// volume
-			bool bIsMuted = LocalFileMng::readXmlBool( instrumentNode, "isMuted", false );	// is muted
-			float fPan_L = LocalFileMng::readXmlFloat( instrumentNode, "pan_L", 0.5 );	// pan L
-			float fPan_R = LocalFileMng::readXmlFloat( instrumentNode, "pan_R", 0.5 );	// pan R
-			float fFX1Level = LocalFileMng::readXmlFloat( instrumentNode, "FX1Level", 0.0 );	// FX level
-			float fFX2Level = LocalFileMng::readXmlFloat( instrumentNode, "FX2Level", 0.0 );	// FX level
-			float fFX3Level = LocalFileMng::readXmlFloat( instrumentNode, "FX3Level", 0.0 );	// FX level
-			float fFX4Level = LocalFileMng::readXmlFloat( instrumentNode, "FX4Level", 0.0 );	// FX level
-			float fGain = LocalFileMng::readXmlFloat( instrumentNode, "gain", 1.0, false, false );	// instrument gain
-
-			int fAttack = LocalFileMng::readXmlInt( instrumentNode, "Attack", 0, false, false );		// Attack
-			int fDecay = LocalFileMng::readXmlInt( instrumentNode, "Decay", 0, false, false );		// Decay
-			float fSustain = LocalFileMng::readXmlFloat( instrumentNode, "Sustain", 1.0, false, false );	// Sustain
-			int fRelease = LocalFileMng::readXmlInt( instrumentNode, "Release", 1000, false, false );	// Release
-
-			float fRandomPitchFactor = LocalFileMng::readXmlFloat( instrumentNode, "randomPitchFactor", 0.0f, false, false );
-
-			bool bFilterActive = LocalFileMng::readXmlBool( instrumentNode, "filterActive", false );
-			float fFilterCutoff = LocalFileMng::readXmlFloat( instrumentNode, "filterCutoff", 1.0f, false );
-			float fFilterResonance = LocalFileMng::readXmlFloat( instrumentNode, "filterResonance", 0.0f, false );
-			QString sMuteGroup = LocalFileMng::readXmlString( instrumentNode, "muteGroup", "-1", false );
-			QString sMidiOutChannel = LocalFileMng::readXmlString( instrumentNode, "midiOutChannel", "-1", false, false );
-			QString sMidiOutNote = LocalFileMng::readXmlString( instrumentNode, "midiOutNote", "60", false, false );
-			int nMuteGroup = sMuteGroup.toInt();
-			bool isStopNote = LocalFileMng::readXmlBool( instrumentNode, "isStopNote", false );
-			int nMidiOutChannel = sMidiOutChannel.toInt();
-			int nMidiOutNote = sMidiOutNote.toInt();
-
-			if ( id==-1 ) {
-				ERRORLOG( "Empty ID for instrument '" + sName + "'. skipping." );
-				instrumentNode = ( QDomNode ) instrumentNode.nextSiblingElement( "instrument" );
-				continue;
-			}
-
-
-			// create a new instrument
-			Instrument* pInstrument = new Instrument( id, sName, new ADSR( fAttack, fDecay, fSustain, fRelease ) );
-			pInstrument->set_volume( fVolume );
-			pInstrument->set_muted( bIsMuted );
-			pInstrument->set_pan_l( fPan_L );
-			pInstrument->set_pan_r( fPan_R );
-			pInstrument->set_drumkit_name( sDrumkit );
-			pInstrument->set_fx_level( fFX1Level, 0 );
-			pInstrument->set_fx_level( fFX2Level, 1 );
-			pInstrument->set_fx_level( fFX3Level, 2 );
-			pInstrument->set_fx_level( fFX4Level, 3 );
-			pInstrument->set_random_pitch_factor( fRandomPitchFactor );
-			pInstrument->set_filter_active( bFilterActive );
-			pInstrument->set_filter_cutoff( fFilterCutoff );
-			pInstrument->set_filter_resonance( fFilterResonance );
-			pInstrument->set_gain( fGain );
-			pInstrument->set_mute_group( nMuteGroup );
-			pInstrument->set_stop_notes( isStopNote );
-			pInstrument->set_midi_out_channel( nMidiOutChannel );
-			pInstrument->set_midi_out_note( nMidiOutNote );
-
-			QString drumkitPath;
-			if ( ( !sDrumkit.isEmpty() ) && ( sDrumkit != "-" ) ) {
-				drumkitPath = Filesystem::drumkit_path_search( sDrumkit );
-			}
-
-
-			QDomNode filenameNode = instrumentNode.firstChildElement( "filename" );
-
-			// back compatibility code ( song version <= 0.9.0 )
-			if ( ! filenameNode.isNull() ) {
-				WARNINGLOG( "Using back compatibility code. filename node found" );
-				QString sFilename = LocalFileMng::readXmlString( instrumentNode, "filename", "" );
-
-				if ( !QFile( sFilename ).exists() && !drumkitPath.isEmpty() ) {
-					sFilename = drumkitPath + "/" + sFilename;
-				}
-				Sample* pSample = Sample::load( sFilename );
-				if ( pSample == NULL ) {
-					// nel passaggio tra 0.8.2 e 0.9.0 il drumkit di default e' cambiato.
-					// Se fallisce provo a caricare il corrispettivo file in formato flac
-//					warningLog( "[readSong] Error loading sample: " + sFilename + " not found. Trying to load a flac..." );
-					sFilename = sFilename.left( sFilename.length() - 4 );
-					sFilename += ".flac";
-					pSample = Sample::load( sFilename );
-				}
-				if ( pSample == NULL ) {
-					ERRORLOG( "Error loading sample: " + sFilename + " not found" );
-					pInstrument->set_muted( true );
-				}
-				InstrumentComponent* pCompo = new InstrumentComponent ( 0 );
-				InstrumentLayer* pLayer = new InstrumentLayer( pSample );
-				pCompo->set_layer( pLayer, 0 );
-				pInstrument->get_components()->push_back( pCompo );
-			}
-			//~ back compatibility code
-			else {
-				bool p_foundAtLeastOneComponent = false;
-				QDomNode componentNode = instrumentNode.firstChildElement( "instrumentComponent" );
-                while (  ! componentNode.isNull()  ) {
-                    p_foundAtLeastOneComponent = true;
-                    int id = LocalFileMng::readXmlInt( componentNode, "component_id", 0 );
-                    InstrumentComponent* pCompo = new InstrumentComponent( id );
-                    float fGainCompo = LocalFileMng::readXmlFloat( componentNode, "gain", 1.0 );
-
-                    unsigned nLayer = 0;
-                    QDomNode layerNode = componentNode.firstChildElement( "layer" );
-                    while (  ! layerNode.isNull()  ) {
-                        if ( nLayer >= MAX_LAYERS ) {
-                            ERRORLOG( "nLayer > MAX_LAYERS" );
-                            continue;
-                        }
-                        //bool sIsModified = false;
-                        QString sFilename = LocalFileMng::readXmlString( layerNode, "filename", "" );
-                        bool sIsModified = LocalFileMng::readXmlBool( layerNode, "ismodified", false );
-                        Sample::Loops lo;
-                        lo.mode = Sample::parse_loop_mode( LocalFileMng::readXmlString( layerNode, "smode", "forward" ) );
-                        lo.start_frame = LocalFileMng::readXmlInt( layerNode, "startframe", 0 );
-                        lo.loop_frame = LocalFileMng::readXmlInt( layerNode, "loopframe", 0 );
-                        lo.count = LocalFileMng::readXmlInt( layerNode, "loops", 0 );
-                        lo.end_frame = LocalFileMng::readXmlInt( layerNode, "endframe", 0 );
-                        Sample::Rubberband ro;
-                        ro.use = LocalFileMng::readXmlInt( layerNode, "userubber", 0, false );
-                        ro.divider = LocalFileMng::readXmlFloat( layerNode, "rubberdivider", 0.0 );
-                        ro.c_settings = LocalFileMng::readXmlInt( layerNode, "rubberCsettings", 1 );
-                        ro.pitch = LocalFileMng::readXmlFloat( layerNode, "rubberPitch", 0.0 );
-
-                        float fMin = LocalFileMng::readXmlFloat( layerNode, "min", 0.0 );
-                        float fMax = LocalFileMng::readXmlFloat( layerNode, "max", 1.0 );
-                        float fGain = LocalFileMng::readXmlFloat( layerNode, "gain", 1.0 );
-                        float fPitch = LocalFileMng::readXmlFloat( layerNode, "pitch", 0.0, false, false );
-
-                        if ( !QFile( sFilename ).exists() && !drumkitPath.isEmpty() ) {
-                            sFilename = drumkitPath + "/" + sFilename;
-                        }
-
-                        QString program = Preferences::get_instance()->m_rubberBandCLIexecutable;
-                        //test the path. if test fails, disable rubberband
-                        if ( QFile( program ).exists() == false ) {
-                            ro.use = false;
-                        }
-
-                        Sample* pSample = NULL;
-                        if ( !sIsModified ) {
-                            pSample = Sample::load( sFilename );
-                        } else {
-                            Sample::EnvelopePoint pt;
-
-                            Sample::VelocityEnvelope velocity;
-                            QDomNode volumeNode = layerNode.firstChildElement( "volume" );
-                            while (  ! volumeNode.isNull()  ) {
-                                pt.frame = LocalFileMng::readXmlInt( volumeNode, "volume-position", 0 );
-                                pt.value = LocalFileMng::readXmlInt( volumeNode, "volume-value", 0 );
-                                velocity.push_back( pt );
-                                volumeNode = volumeNode.nextSiblingElement( "volume" );
-                                //ERRORLOG( QString("volume-posi %1").arg(LocalFileMng::readXmlInt( volumeNode, "volume-position", 0)) );
-                            }
-
-                            Sample::VelocityEnvelope pan;
-                            QDomNode  panNode = layerNode.firstChildElement( "pan" );
-                            while (  ! panNode.isNull()  ) {
-                                pt.frame = LocalFileMng::readXmlInt( panNode, "pan-position", 0 );
-                                pt.value = LocalFileMng::readXmlInt( panNode, "pan-value", 0 );
-                                pan.push_back( pt );
-                                panNode = panNode.nextSiblingElement( "pan" );
-                            }
-
-                            pSample = Sample::load( sFilename, lo, ro, velocity, pan );
-                        }
-                        if ( pSample == NULL ) {
-                            ERRORLOG( "Error loading sample: " + sFilename + " not found" );
-                            pInstrument->set_muted( true );
-                        }
-                        InstrumentLayer* pLayer = new InstrumentLayer( pSample );
-                        pLayer->set_start_velocity( fMin );
-                        pLayer->set_end_velocity( fMax );
-                        pLayer->set_gain( fGain );
-                        pLayer->set_pitch( fPitch );
-                        pCompo->set_layer( pLayer, nLayer );
-                        nLayer++;
-
-                        layerNode = ( QDomNode ) layerNode.nextSiblingElement( "layer" );
-                    }
-
-                    pInstrument->get_components()->push_back( pCompo );
-                    componentNode = ( QDomNode ) componentNode.nextSiblingElement( "instrumentComponent" );
-                }
-                if(!p_foundAtLeastOneComponent){
-                    InstrumentComponent* pCompo = new InstrumentComponent( 0 );
-                    float fGainCompo = LocalFileMng::readXmlFloat( componentNode, "gain", 1.0 );
-                    unsigned nLayer = 0;
-                    QDomNode layerNode = instrumentNode.firstChildElement( "layer" );
-                    while (  ! layerNode.isNull()  ) {
-                        if ( nLayer >= MAX_LAYERS ) {
-                            ERRORLOG( "nLayer > MAX_LAYERS" );
-                            continue;
-                        }
-                        QString sFilename = LocalFileMng::readXmlString( layerNode, "filename", "" );
-                        bool sIsModified = LocalFileMng::readXmlBool( layerNode, "ismodified", false );
-                        Sample::Loops lo;
-                        lo.mode = Sample::parse_loop_mode( LocalFileMng::readXmlString( layerNode, "smode", "forward" ) );
-                        lo.start_frame = LocalFileMng::readXmlInt( layerNode, "startframe", 0 );
-                        lo.loop_frame = LocalFileMng::readXmlInt( layerNode, "loopframe", 0 );
-                        lo.count = LocalFileMng::readXmlInt( layerNode, "loops", 0 );
-                        lo.end_frame = LocalFileMng::readXmlInt( layerNode, "endframe", 0 );
-                        Sample::Rubberband ro;
-                        ro.use = LocalFileMng::readXmlInt( layerNode, "userubber", 0, false );
-                        ro.divider = LocalFileMng::readXmlFloat( layerNode, "rubberdivider", 0.0 );
-                        ro.c_settings = LocalFileMng::readXmlInt( layerNode, "rubberCsettings", 1 );
-                        ro.pitch = LocalFileMng::readXmlFloat( layerNode, "rubberPitch", 0.0 );
-
-                        float fMin = LocalFileMng::readXmlFloat( layerNode, "min", 0.0 );
-                        float fMax = LocalFileMng::readXmlFloat( layerNode, "max", 1.0 );
-                        float fGain = LocalFileMng::readXmlFloat( layerNode, "gain", 1.0 );
-                        float fPitch = LocalFileMng::readXmlFloat( layerNode, "pitch", 0.0, false, false );
-
-                        if ( !QFile( sFilename ).exists() && !drumkitPath.isEmpty() ) {
-                            sFilename = drumkitPath + "/" + sFilename;
-                        }
-
-                        QString program = Preferences::get_instance()->m_rubberBandCLIexecutable;
-                        //test the path. if test fails, disable rubberband
-                        if ( QFile( program ).exists() == false ) {
-                            ro.use = false;
-                        }
-
-                        Sample* pSample = NULL;
-                        if ( !sIsModified ) {
-                            pSample = Sample::load( sFilename );
-                        } else {
-                            Sample::EnvelopePoint pt;
-
-                            Sample::VelocityEnvelope velocity;
-                            QDomNode volumeNode = layerNode.firstChildElement( "volume" );
-                            while (  ! volumeNode.isNull()  ) {
-                                pt.frame = LocalFileMng::readXmlInt( volumeNode, "volume-position", 0 );
-                                pt.value = LocalFileMng::readXmlInt( volumeNode, "volume-value", 0 );
-                                velocity.push_back( pt );
-                                volumeNode = volumeNode.nextSiblingElement( "volume" );
-                                //ERRORLOG( QString("volume-posi %1").arg(LocalFileMng::readXmlInt( volumeNode, "volume-position", 0)) );
-                            }
-
-                            Sample::VelocityEnvelope pan;
-                            QDomNode  panNode = layerNode.firstChildElement( "pan" );
-                            while (  ! panNode.isNull()  ) {
-                                pt.frame = LocalFileMng::readXmlInt( panNode, "pan-position", 0 );
-                                pt.value = LocalFileMng::readXmlInt( panNode, "pan-value", 0 );
-                                pan.push_back( pt );
-                                panNode = panNode.nextSiblingElement( "pan" );
-                            }
-
-                            pSample = Sample::load( sFilename, lo, ro, velocity, pan );
-                        }
-                        if ( pSample == NULL ) {
-                            ERRORLOG( "Error loading sample: " + sFilename + " not found" );
-                            pInstrument->set_muted( true );
-                        }
-                        InstrumentLayer* pLayer = new InstrumentLayer( pSample );
-                        pLayer->set_start_velocity( fMin );
-                        pLayer->set_end_velocity( fMax );
-                        pLayer->set_gain( fGain );
-                        pLayer->set_pitch( fPitch );
-                        pCompo->set_layer( pLayer, nLayer );
-                        nLayer++;
-
-                        layerNode = ( QDomNode ) layerNode.nextSiblingElement( "layer" );
-                    }
-                    pInstrument->get_components()->push_back( pCompo );
-                }
-            }
-            instrumentList->add( pInstrument );
-            instrumentNode = ( QDomNode ) instrumentNode.nextSiblingElement( "instrument" );
-		}
-
-		if ( instrumentList_count == 0 ) {
-			WARNINGLOG( "0 instruments?" );
-		}
-
-		song->set_instrument_list( instrumentList );
-	} else {
-		ERRORLOG( "Error reading song: instrumentList node not found" );
+	if ( reader.hasError() ) {
+		ERRORLOG( QString( "Error reading song: %1 at line %2" ).arg( reader.errorString() ).arg( reader.lineNumber() ) );
 		delete song;
 		return NULL;
 	}
-
-	// Pattern list
-	QDomNode patterns = songNode.firstChildElement( "patternList" );
-
-	PatternList* patternList = new PatternList();
-	int pattern_count = 0;
-
-	QDomNode patternNode =  patterns.firstChildElement( "pattern" );
-	while (  !patternNode.isNull()  ) {
-		pattern_count++;
-		Pattern* pat = getPattern( patternNode, instrumentList );
-		if ( pat ) {
-			patternList->add( pat );
-		} else {
-			ERRORLOG( "Error loading pattern" );
-			delete patternList;
-			delete song;
-			return NULL;
-		}
-		patternNode = ( QDomNode ) patternNode.nextSiblingElement( "pattern" );
-	}
-	if ( pattern_count == 0 ) {
-		WARNINGLOG( "0 patterns?" );
+	if ( instrumentList == NULL ) {
+		ERRORLOG( "Error reading song: instrumentList node not found" );
+		delete song;
+		return NULL;
 	}
-	song->set_pattern_list( patternList );
-
-	// Virtual Patterns
-	QDomNode  virtualPatternListNode = songNode.firstChildElement( "virtualPatternList" );
-	QDomNode virtualPatternNode = virtualPatternListNode.firstChildElement( "pattern" );
-	if ( !virtualPatternNode.isNull() ) {
 
-		while (  ! virtualPatternNode.isNull()  ) {
-			QString sName = "";
-			sName = LocalFileMng::readXmlString( virtualPatternNode, "name", sName );
-
-			Pattern* curPattern = NULL;
-			unsigned nPatterns = patternList->size();
-			for ( unsigned i = 0; i < nPatterns; i++ ) {
-				Pattern* pat = patternList->get( i );
-
-				if ( pat->get_name() == sName ) {
-					curPattern = pat;
-					break;
-				}//if
-			}//for
-
-			if ( curPattern != NULL ) {
-				QDomNode  virtualNode = virtualPatternNode.firstChildElement( "virtual" );
-				while (  !virtualNode.isNull()  ) {
-					QString virtName = virtualNode.firstChild().nodeValue();
-
-					Pattern* virtPattern = NULL;
-					for ( unsigned i = 0; i < nPatterns; i++ ) {
-						Pattern* pat = patternList->get( i );
-
-						if ( pat->get_name() == virtName ) {
-							virtPattern = pat;
-							break;
-						}//if
-					}//for
-
-					if ( virtPattern != NULL ) {
-						curPattern->virtual_patterns_add( virtPattern );
-					} else {
-						ERRORLOG( "Song had invalid virtual pattern list data (virtual)" );
-					}//if
-					virtualNode = ( QDomNode ) virtualNode.nextSiblingElement( "virtual" );
-				}//while
-			} else {
-				ERRORLOG( "Song had invalid virtual pattern list data (name)" );
-			}//if
-			virtualPatternNode = ( QDomNode ) virtualPatternNode.nextSiblingElement( "pattern" );
-		}//while
-	}//if
-
-	patternList->flattened_virtual_patterns_compute();
-
-	// Pattern sequence
-	QDomNode patternSequenceNode = songNode.firstChildElement( "patternSequence" );
-
-	std::vector<PatternList*>* pPatternGroupVector = new std::vector<PatternList*>;
-
-	// back-compatibility code..
-	QDomNode pPatternIDNode = patternSequenceNode.firstChildElement( "patternID" );
-	while ( ! pPatternIDNode.isNull()  ) {
-		WARNINGLOG( "Using old patternSequence code for back compatibility" );
-		PatternList* patternSequence = new PatternList();
-		QString patId = pPatternIDNode.firstChildElement().text();
-		ERRORLOG( patId );
-
-		Pattern* pat = NULL;
-		for ( unsigned i = 0; i < patternList->size(); i++ ) {
-			Pattern* tmp = patternList->get( i );
-			if ( tmp ) {
-				if ( tmp->get_name() == patId ) {
-					pat = tmp;
-					break;
-				}
-			}
-		}
-		if ( pat == NULL ) {
-			WARNINGLOG( "patternid not found in patternSequence" );
-			pPatternIDNode = ( QDomNode ) pPatternIDNode.nextSiblingElement( "patternID" );
-			continue;
-		}
-		patternSequence->add( pat );
-
-		pPatternGroupVector->push_back( patternSequence );
-
-		pPatternIDNode = ( QDomNode ) pPatternIDNode.nextSiblingElement( "patternID" );
+	if ( m_sSongVersion != QString( get_version().c_str() ) ) {
+		WARNINGLOG( "Trying to load a song created with a different version of hydrogen." );
+		WARNINGLOG( "Song [" + FileName + "] saved with version " + m_sSongVersion );
 	}
 
-	QDomNode groupNode = patternSequenceNode.firstChildElement( "group" );
-	while (  !groupNode.isNull()  ) {
-		PatternList* patternSequence = new PatternList();
-		QDomNode patternId = groupNode.firstChildElement( "patternID" );
-		while (  !patternId.isNull()  ) {
-			QString patId = patternId.firstChild().nodeValue();
-
-			Pattern* pat = NULL;
-			for ( unsigned i = 0; i < patternList->size(); i++ ) {
-				Pattern* tmp = patternList->get( i );
-				if ( tmp ) {
-					if ( tmp->get_name() == patId ) {
-						pat = tmp;
-						break;
-					}
-				}
-			}
-			if ( pat == NULL ) {
-				WARNINGLOG( "patternid not found in patternSequence" );
-				patternId = ( QDomNode ) patternId.nextSiblingElement( "patternID" );
-				continue;
-			}
-			patternSequence->add( pat );
-			patternId = ( QDomNode ) patternId.nextSiblingElement( "patternID" );
-		}
-		pPatternGroupVector->push_back( patternSequence );
-
-		groupNode = groupNode.nextSiblingElement( "group" );
+	Hydrogen::get_instance()->setNewBpmJTM( fBpm );
+	Preferences::get_instance()->setPatternModePlaysSelected( bPatternModePlaysSelected );
+	if ( instrumentList->size() > 0 ) {
+		Hydrogen::get_instance()->setCurrentDrumkitname( sDrumkit );
 	}
 
-	song->set_pattern_group_vector( pPatternGroupVector );
+	patternList->flattened_virtual_patterns_compute();
 
 #ifdef H2CORE_HAVE_LADSPA
 	// reset FX
-	for ( int fx = 0; fx < MAX_FX; ++fx ) {
+	for ( int fx = 0; fx < Effects::get_instance()->getNumberOfSlots(); ++fx ) {
 		//LadspaFX* pFX = Effects::get_instance()->getLadspaFX( fx );
 		//delete pFX;
 		Effects::get_instance()->setLadspaFX( NULL, fx );
@@ -923,82 +853,43 @@ Song* SongReader::readSong( const QString& filename )
 #endif
 
 	// LADSPA FX
-	QDomNode ladspaNode = songNode.firstChildElement( "ladspa" );
-	if ( !ladspaNode.isNull() ) {
-		int nFX = 0;
-		QDomNode fxNode = ladspaNode.firstChildElement( "fx" );
-		while (  !fxNode.isNull()  ) {
-			QString sName = LocalFileMng::readXmlString( fxNode, "name", "" );
-			QString sFilename = LocalFileMng::readXmlString( fxNode, "filename", "" );
-			bool bEnabled = LocalFileMng::readXmlBool( fxNode, "enabled", false );
-			float fVolume = LocalFileMng::readXmlFloat( fxNode, "volume", 1.0 );
-
-			if ( sName != "no plugin" ) {
+	if ( bLadspa ) {
+		for ( unsigned nFX = 0; nFX < fxList.size(); nFX++ ) {
+			const FxInfo& fx = fxList[ nFX ];
+			if ( fx.sName != "no plugin" ) {
 				// FIXME: il caricamento va fatto fare all'engine, solo lui sa il samplerate esatto
 #ifdef H2CORE_HAVE_LADSPA
-				LadspaFX* pFX = LadspaFX::load( sFilename, sName, 44100 );
+				LadspaFX* pFX = LadspaFX::load( fx.sFilename, fx.sName, 44100 );
 				Effects::get_instance()->setLadspaFX( pFX, nFX );
 				if ( pFX ) {
-					pFX->setEnabled( bEnabled );
-					pFX->setVolume( fVolume );
-					QDomNode inputControlNode = fxNode.firstChildElement( "inputControlPort" );
-					while ( !inputControlNode.isNull() ) {
-						QString sName = LocalFileMng::readXmlString( inputControlNode, "name", "" );
-						float fValue = LocalFileMng::readXmlFloat( inputControlNode, "value", 0.0 );
-
+					pFX->setEnabled( fx.bEnabled );
+					pFX->setVolume( fx.fVolume );
+					for ( unsigned i = 0; i < fx.inputControlPorts.size(); i++ ) {
 						for ( unsigned nPort = 0; nPort < pFX->inputControlPorts.size(); nPort++ ) {
 							LadspaControlPort* port = pFX->inputControlPorts[ nPort ];
-							if ( QString( port->sName ) == sName ) {
-								port->fControlValue = fValue;
+							if ( QString( port->sName ) == fx.inputControlPorts[ i ].first ) {
+								port->fControlValue = fx.inputControlPorts[ i ].second;
 							}
 						}
-						inputControlNode = ( QDomNode ) inputControlNode.nextSiblingElement( "inputControlPort" );
 					}
-
-					/*
-					TiXmlNode* outputControlNode;
-					for ( outputControlNode = fxNode->FirstChild( "outputControlPort" ); outputControlNode; outputControlNode = outputControlNode->NextSibling( "outputControlPort" ) ) {
-					}*/
 				}
 #endif
 			}
-			nFX++;
-			fxNode = ( QDomNode ) fxNode.nextSiblingElement( "fx" );
 		}
 	} else {
 		WARNINGLOG( "ladspa node not found" );
 	}
 
 	Timeline* pTimeline = Hydrogen::get_instance()->getTimeline();
-	pTimeline->m_timelinevector.clear();
-	Timeline::HTimelineVector tlvector;
-	QDomNode bpmTimeLine = songNode.firstChildElement( "BPMTimeLine" );
-	if ( !bpmTimeLine.isNull() ) {
-		QDomNode newBPMNode = bpmTimeLine.firstChildElement( "newBPM" );
-		while( !newBPMNode.isNull() ) {
-			tlvector.m_htimelinebeat = LocalFileMng::readXmlInt( newBPMNode, "BAR", 0 );
-			tlvector.m_htimelinebpm = LocalFileMng::readXmlFloat( newBPMNode, "BPM", 120.0 );
-			pTimeline->m_timelinevector.push_back( tlvector );
-			pTimeline->sortTimelineVector();
-			newBPMNode = newBPMNode.nextSiblingElement( "newBPM" );
-		}
-	} else {
+	pTimeline->m_timelinevector = timelineVector;
+	pTimeline->sortTimelineVector();
+	if ( !bBPMTimeLine ) {
 		WARNINGLOG( "bpmTimeLine node not found" );
 	}
 
-	pTimeline->m_timelinetagvector.clear();
-	Timeline::HTimelineTagVector tltagvector;
-	QDomNode timeLineTag = songNode.firstChildElement( "timeLineTag" );
-	if ( !timeLineTag.isNull() ) {
-		QDomNode newTAGNode = timeLineTag.firstChildElement( "newTAG" );
-		while( !newTAGNode.isNull() ) {
-			tltagvector.m_htimelinetagbeat = LocalFileMng::readXmlInt( newTAGNode, "BAR", 0 );
-			tltagvector.m_htimelinetag = LocalFileMng::readXmlString( newTAGNode, "TAG", "" );
-			pTimeline->m_timelinetagvector.push_back( tltagvector );
-			pTimeline->sortTimelineTagVector();
-			newTAGNode = newTAGNode.nextSiblingElement( "newTAG" );
-		}
-	} else {
+	pTimeline->m_timelinetagvector = timelineTagVector;
+	pTimeline->sortTimelineTagVector();
+	if ( !bTimeLineTag ) {
 		WARNINGLOG( "TagTimeLine node not found" );
 	}
 
@@ -1008,103 +899,310 @@ Song* SongReader::readSong( const QString& filename )
 	return song;
 }
 
-Pattern* SongReader::getPattern( QDomNode pattern, InstrumentList* instrList )
+
+
+Instrument* SongReader::readInstrument( XMLReader& reader, bool bUseRubberband )
 {
-	Pattern* pPattern = NULL;
-
-	QString sName;	// name
-	sName = LocalFileMng::readXmlString( pattern, "name", sName );
-	QString sInfo;
-	sInfo = LocalFileMng::readXmlString( pattern, "info", sInfo ,false ,false );
-	QString sCategory; // category
-	sCategory = LocalFileMng::readXmlString( pattern, "category", sCategory ,false ,false );
-
-	int nSize = -1;
-	nSize = LocalFileMng::readXmlInt( pattern, "size", nSize, false, false );
-
-	pPattern = new Pattern( sName, sInfo, sCategory, nSize );
-
-	QDomNode pNoteListNode = pattern.firstChildElement( "noteList" );
-	if ( ! pNoteListNode.isNull() ) {
-		// new code :)
-		QDomNode noteNode = pNoteListNode.firstChildElement( "note" );
-		while ( ! noteNode.isNull()  ) {
-
-			Note* pNote = NULL;
-
-			unsigned nPosition = LocalFileMng::readXmlInt( noteNode, "position", 0 );
-			float fLeadLag = LocalFileMng::readXmlFloat( noteNode, "leadlag", 0.0 , false , false );
-			float fVelocity = LocalFileMng::readXmlFloat( noteNode, "velocity", 0.8f );
-			float fPan_L = LocalFileMng::readXmlFloat( noteNode, "pan_L", 0.5 );
-			float fPan_R = LocalFileMng::readXmlFloat( noteNode, "pan_R", 0.5 );
-			int nLength = LocalFileMng::readXmlInt( noteNode, "length", -1, true );
-			float nPitch = LocalFileMng::readXmlFloat( noteNode, "pitch", 0.0, false, false );
-			QString sKey = LocalFileMng::readXmlString( noteNode, "key", "C0", false, false );
-			QString nNoteOff = LocalFileMng::readXmlString( noteNode, "note_off", "false", false, false );
-
-			int instrId = LocalFileMng::readXmlInt( noteNode, "instrument", -1 );
-
-			Instrument* instrRef = NULL;
-			// search instrument by ref
-			instrRef = instrList->find( instrId );
-			if ( !instrRef ) {
-				ERRORLOG( QString( "Instrument with ID: '%1' not found. Note skipped." ).arg( instrId ) );
-				noteNode = ( QDomNode ) noteNode.nextSiblingElement( "note" );
-				continue;
+	int id = -1;			// instrument id
+	QString sDrumkit = "";
+	QString sName = "";
+	float fVolume = 1.0;
+	bool bIsMuted = false;
+	float fPan_L = 0.5;
+	float fPan_R = 0.5;
+	std::vector<float> fFXLevel;	// FX1Level, FX2Level... one per FX slot
+	float fGain = 1.0;
+	int fAttack = 0;
+	int fDecay = 0;
+	float fSustain = 1.0;
+	int fRelease = 1000;
+	float fRandomPitchFactor = 0.0f;
+	bool bFilterActive = false;
+	float fFilterCutoff = 1.0f;
+	float fFilterResonance = 0.0f;
+	QString sMuteGroup = "-1";
+	QString sMidiOutChannel = "-1";
+	QString sMidiOutNote = "60";
+	bool isStopNote = false;
+
+	bool bFilename = false;
+	QString sFilename;		// back compatibility ( song version <= 0.9.0 )
+	std::vector<ComponentInfo> componentList;
+	std::vector<LayerInfo> instrumentLayers;	// back compatibility, layers without component
+
+	while ( reader.readNextStartElement() ) {
+		if ( reader.name_is( "id" ) ) {
+			id = reader.read_int( id );
+		} else if ( reader.name_is( "drumkit" ) ) {
+			sDrumkit = reader.read_string( sDrumkit );
+		} else if ( reader.name_is( "name" ) ) {
+			sName = reader.read_string( sName );
+		} else if ( reader.name_is( "volume" ) ) {
+			fVolume = reader.read_float( fVolume );
+		} else if ( reader.name_is( "isMuted" ) ) {
+			bIsMuted = reader.read_bool( bIsMuted );
+		} else if ( reader.name_is( "pan_L" ) ) {
+			fPan_L = reader.read_float( fPan_L );
+		} else if ( reader.name_is( "pan_R" ) ) {
+			fPan_R = reader.read_float( fPan_R );
+		} else if ( reader.name().startsWith( QLatin1String( "FX" ) ) && reader.name().endsWith( QLatin1String( "Level" ) ) ) {
+			QString sElement = reader.name().toString();
+			int nFX = sElement.mid( 2, sElement.length() - 7 ).toInt() - 1;
+			float fLevel = reader.read_float( 0.0 );
+			if ( nFX >= 0 && nFX < FX_SLOTS_MAX ) {
+				if ( nFX >= ( int )fFXLevel.size() ) {
+					fFXLevel.resize( nFX + 1, 0.0 );
+				}
+				fFXLevel[ nFX ] = fLevel;
+			}
+		} else if ( reader.name_is( "gain" ) ) {
+			fGain = reader.read_float( fGain );
+		} else if ( reader.name_is( "Attack" ) ) {
+			fAttack = reader.read_int( fAttack );
+		} else if ( reader.name_is( "Decay" ) ) {
+			fDecay = reader.read_int( fDecay );
+		} else if ( reader.name_is( "Sustain" ) ) {
+			fSustain = reader.read_float( fSustain );
+		} else if ( reader.name_is( "Release" ) ) {
+			fRelease = reader.read_int( fRelease );
+		} else if ( reader.name_is( "randomPitchFactor" ) ) {
+			fRandomPitchFactor = reader.read_float( fRandomPitchFactor );
+		} else if ( reader.name_is( "filterActive" ) ) {
+			bFilterActive = reader.read_bool( bFilterActive );
+		} else if ( reader.name_is( "filterCutoff" ) ) {
+			fFilterCutoff = reader.read_float( fFilterCutoff );
+		} else if ( reader.name_is( "filterResonance" ) ) {
+			fFilterResonance = reader.read_float( fFilterResonance );
+		} else if ( reader.name_is( "muteGroup" ) ) {
+			sMuteGroup = reader.read_string( sMuteGroup );
+		} else if ( reader.name_is( "midiOutChannel" ) ) {
+			sMidiOutChannel = reader.read_string( sMidiOutChannel );
+		} else if ( reader.name_is( "midiOutNote" ) ) {
+			sMidiOutNote = reader.read_string( sMidiOutNote );
+		} else if ( reader.name_is( "isStopNote" ) ) {
+			isStopNote = reader.read_bool( isStopNote );
+		} else if ( reader.name_is( "filename" ) ) {
+			bFilename = true;
+			sFilename = reader.read_string( "" );
+		} else if ( reader.name_is( "instrumentComponent" ) ) {
+			ComponentInfo component;
+			component.nId = 0;
+			while ( reader.readNextStartElement() ) {
+				if ( reader.name_is( "component_id" ) ) {
+					component.nId = reader.read_int( 0 );
+				} else if ( reader.name_is( "layer" ) ) {
+					component.layers.push_back( readLayer( reader, bUseRubberband ) );
+				} else {
+					reader.skipCurrentElement();
+				}
 			}
-			//assert( instrRef );
-			bool noteoff = false;
-			if ( nNoteOff == "true" )
-				noteoff = true;
-
-			pNote = new Note( instrRef, nPosition, fVelocity, fPan_L, fPan_R, nLength, nPitch );
-			pNote->set_key_octave( sKey );
-			pNote->set_lead_lag( fLeadLag );
-			pNote->set_note_off( noteoff );
-			pPattern->insert_note( pNote );
-
-			noteNode = ( QDomNode ) noteNode.nextSiblingElement( "note" );
+			componentList.push_back( component );
+		} else if ( reader.name_is( "layer" ) ) {
+			instrumentLayers.push_back( readLayer( reader, bUseRubberband ) );
+		} else {
+			reader.skipCurrentElement();
 		}
-	} else {
-		// Back compatibility code. Version < 0.9.4
-		QDomNode sequenceListNode = pattern.firstChildElement( "sequenceList" );
+	}
+
+	if ( id==-1 ) {
+		ERRORLOG( "Empty ID for instrument '" + sName + "'. skipping." );
+		return NULL;
+	}
 
-		int sequence_count = 0;
-		QDomNode sequenceNode = sequenceListNode.firstChildElement( "sequence" );
-		while ( ! sequenceNode.isNull()  ) {
-			sequence_count++;
+	// create a new instrument
+	Instrument* pInstrument = new Instrument( id, sName, new ADSR( fAttack, fDecay, fSustain, fRelease ) );
+	pInstrument->set_volume( fVolume );
+	pInstrument->set_muted( bIsMuted );
+	pInstrument->set_pan_l( fPan_L );
+	pInstrument->set_pan_r( fPan_R );
+	pInstrument->set_drumkit_name( sDrumkit );
+	for ( unsigned nFX = 0; nFX < fFXLevel.size(); nFX++ ) {
+		pInstrument->set_fx_level( fFXLevel[ nFX ], nFX );
+	}
+	pInstrument->set_random_pitch_factor( fRandomPitchFactor );
+	pInstrument->set_filter_active( bFilterActive );
+	pInstrument->set_filter_cutoff( fFilterCutoff );
+	pInstrument->set_filter_resonance( fFilterResonance );
+	pInstrument->set_gain( fGain );
+	pInstrument->set_mute_group( sMuteGroup.toInt() );
+	pInstrument->set_stop_notes( isStopNote );
+	pInstrument->set_midi_out_channel( sMidiOutChannel.toInt() );
+	pInstrument->set_midi_out_note( sMidiOutNote.toInt() );
+
+	QString drumkitPath;
+	if ( ( !sDrumkit.isEmpty() ) && ( sDrumkit != "-" ) ) {
+		drumkitPath = Filesystem::drumkit_path_search( sDrumkit );
+	}
 
-			QDomNode noteListNode = sequenceNode.firstChildElement( "noteList" );
-			QDomNode noteNode = noteListNode.firstChildElement( "note" );
-			while (  !noteNode.isNull() ) {
+	// back compatibility code ( song version <= 0.9.0 )
+	if ( bFilename ) {
+		WARNINGLOG( "Using back compatibility code. filename node found" );
+		if ( !QFile( sFilename ).exists() && !drumkitPath.isEmpty() ) {
+			sFilename = drumkitPath + "/" + sFilename;
+		}
+		Sample* pSample = Sample::load( sFilename );
+		if ( pSample == NULL ) {
+			// nel passaggio tra 0.8.2 e 0.9.0 il drumkit di default e' cambiato.
+			// Se fallisce provo a caricare il corrispettivo file in formato flac
+			sFilename = sFilename.left( sFilename.length() - 4 );
+			sFilename += ".flac";
+			pSample = Sample::load( sFilename );
+		}
+		if ( pSample == NULL ) {
+			ERRORLOG( "Error loading sample: " + sFilename + " not found" );
+			pInstrument->set_muted( true );
+		}
+		InstrumentComponent* pCompo = new InstrumentComponent ( 0 );
+		InstrumentLayer* pLayer = new InstrumentLayer( pSample );
+		pCompo->set_layer( pLayer, 0 );
+		pInstrument->get_components()->push_back( pCompo );
+		return pInstrument;
+	}
+	//~ back compatibility code
 
-				Note* pNote = NULL;
+	if ( componentList.empty() ) {
+		ComponentInfo component;
+		component.nId = 0;
+		component.layers = instrumentLayers;
+		componentList.push_back( component );
+	}
 
-				unsigned nPosition = LocalFileMng::readXmlInt( noteNode, "position", 0 );
-				float fLeadLag = LocalFileMng::readXmlFloat( noteNode, "leadlag", 0.0 , false , false );
-				float fVelocity = LocalFileMng::readXmlFloat( noteNode, "velocity", 0.8f );
-				float fPan_L = LocalFileMng::readXmlFloat( noteNode, "pan_L", 0.5 );
-				float fPan_R = LocalFileMng::readXmlFloat( noteNode, "pan_R", 0.5 );
-				int nLength = LocalFileMng::readXmlInt( noteNode, "length", -1, true );
-				float nPitch = LocalFileMng::readXmlFloat( noteNode, "pitch", 0.0, false, false );
+	for ( unsigned nComponent = 0; nComponent < componentList.size(); nComponent++ ) {
+		const ComponentInfo& component = componentList[ nComponent ];
+		InstrumentComponent* pCompo = new InstrumentComponent( component.nId );
+		for ( unsigned nLayer = 0; nLayer < component.layers.size(); nLayer++ ) {
+			if ( nLayer >= MAX_LAYERS ) {
+				ERRORLOG( "nLayer > MAX_LAYERS" );
+				break;
+			}
+			const LayerInfo& layer = component.layers[ nLayer ];
+			QString sLayerFilename = layer.sFilename;
+			if ( !QFile( sLayerFilename ).exists() && !drumkitPath.isEmpty() ) {
+				sLayerFilename = drumkitPath + "/" + sLayerFilename;
+			}
 
-				int instrId = LocalFileMng::readXmlInt( noteNode, "instrument", -1 );
+			Sample* pSample = NULL;
+			if ( !layer.bIsModified ) {
+				pSample = LayerLoader::create_sample( sLayerFilename );
+			} else {
+				pSample = Sample::load( sLayerFilename, layer.lo, layer.ro, layer.velocity, layer.pan );
+			}
+			if ( pSample == NULL ) {
+				ERRORLOG( "Error loading sample: " + sLayerFilename + " not found" );
+				pInstrument->set_muted( true );
+			}
+			InstrumentLayer* pLayer = new InstrumentLayer( pSample );
+			pLayer->set_start_velocity( layer.fMin );
+			pLayer->set_end_velocity( layer.fMax );
+			pLayer->set_gain( layer.fGain );
+			pLayer->set_pitch( layer.fPitch );
+			pCompo->set_layer( pLayer, nLayer );
+		}
+		pInstrument->get_components()->push_back( pCompo );
+	}
 
-				Instrument* instrRef = instrList->find( instrId );
-				assert( instrRef );
+	return pInstrument;
+}
 
-				pNote = new Note( instrRef, nPosition, fVelocity, fPan_L, fPan_R, nLength, nPitch );
-				pNote->set_lead_lag( fLeadLag );
 
-				//infoLog( "new note!! pos: " + toString( pNote->m_nPosition ) + "\t instr: " + instrId );
-				pPattern->insert_note( pNote );
 
-				noteNode = ( QDomNode ) noteNode.nextSiblingElement( "note" );
+Pattern* SongReader::readPattern( XMLReader& reader, InstrumentList* instrList )
+{
+	Pattern* pPattern = new Pattern( "", "", "", -1 );
+
+	while ( reader.readNextStartElement() ) {
+		if ( reader.name_is( "name" ) ) {
+			pPattern->set_name( reader.read_string( "" ) );
+		} else if ( reader.name_is( "info" ) ) {
+			pPattern->set_info( reader.read_string( "" ) );
+		} else if ( reader.name_is( "category" ) ) {
+			pPattern->set_category( reader.read_string( "" ) );
+		} else if ( reader.name_is( "size" ) ) {
+			pPattern->set_length( reader.read_int( -1 ) );
+		} else if ( reader.name_is( "noteList" ) ) {
+			readNoteList( reader, instrList, pPattern );
+		} else if ( reader.name_is( "sequenceList" ) ) {
+			// Back compatibility code. Version < 0.9.4
+			while ( reader.readNextStartElement() ) {
+				if ( !reader.name_is( "sequence" ) ) {
+					reader.skipCurrentElement();
+					continue;
+				}
+				while ( reader.readNextStartElement() ) {
+					if ( reader.name_is( "noteList" ) ) {
+						readNoteList( reader, instrList, pPattern );
+					} else {
+						reader.skipCurrentElement();
+					}
+				}
 			}
-			sequenceNode = ( QDomNode ) sequenceNode.nextSiblingElement( "sequence" );
+		} else {
+			reader.skipCurrentElement();
 		}
 	}
 
 	return pPattern;
 }
+
+
+
+void SongReader::readNoteList( XMLReader& reader, InstrumentList* instrList, Pattern* pPattern )
+{
+	while ( reader.readNextStartElement() ) {
+		if ( !reader.name_is( "note" ) ) {
+			reader.skipCurrentElement();
+			continue;
+		}
+
+		unsigned nPosition = 0;
+		float fLeadLag = 0.0;
+		float fVelocity = 0.8f;
+		float fPan_L = 0.5;
+		float fPan_R = 0.5;
+		int nLength = -1;
+		float nPitch = 0.0;
+		QString sKey = "C0";
+		bool noteoff = false;
+		int instrId = -1;
+
+		while ( reader.readNextStartElement() ) {
+			if ( reader.name_is( "position" ) ) {
+				nPosition = reader.read_int( 0 );
+			} else if ( reader.name_is( "leadlag" ) ) {
+				fLeadLag = reader.read_float( 0.0 );
+			} else if ( reader.name_is( "velocity" ) ) {
+				fVelocity = reader.read_float( 0.8f );
+			} else if ( reader.name_is( "pan_L" ) ) {
+				fPan_L = reader.read_float( 0.5 );
+			} else if ( reader.name_is( "pan_R" ) ) {
+				fPan_R = reader.read_float( 0.5 );
+			} else if ( reader.name_is( "length" ) ) {
+				nLength = reader.read_int( -1 );
+			} else if ( reader.name_is( "pitch" ) ) {
+				nPitch = reader.read_float( 0.0 );
+			} else if ( reader.name_is( "key" ) ) {
+				sKey = reader.read_string( "C0" );
+			} else if ( reader.name_is( "note_off" ) ) {
+				noteoff = ( reader.read_string( "false" ) == "true" );
+			} else if ( reader.name_is( "instrument" ) ) {
+				instrId = reader.read_int( -1 );
+			} else {
+				reader.skipCurrentElement();
+			}
+		}
+
+		// search instrument by ref
+		Instrument* instrRef = instrList->find( instrId );
+		if ( !instrRef ) {
+			ERRORLOG( QString( "Instrument with ID: '%1' not found. Note skipped." ).arg( instrId ) );
+			continue;
+		}
+
+		Note* pNote = new Note( instrRef, nPosition, fVelocity, fPan_L, fPan_R, nLength, nPitch );
+		pNote->set_key_octave( sKey );
+		pNote->set_lead_lag( fLeadLag );
+		pNote->set_note_off( noteoff );
+		pPattern->insert_note( pNote );
+	}
+}
 };
@@ -0,0 +1,179 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/basics/song_saver.h>
+#include <hydrogen/basics/song_snapshot.h>
+#include <hydrogen/audio_engine.h>
+#include <hydrogen/helpers/filesystem.h>
+
+namespace H2Core
+{
+
+const char* SongSaver::__class_name = "SongSaver";
+
+void* songSaver_thread( void* param )
+{
+	SongSaver* pSaver = ( SongSaver* )param;
+	pSaver->saverLoop();
+	pthread_exit( NULL );
+	return NULL;
+}
+
+SongSaver::SongSaver()
+		: Object( __class_name )
+		, m_bThreadRunning( false )
+		, m_bPending( false )
+		, m_bBusy( false )
+		, m_bQuit( false )
+		, m_bFailed( false )
+{
+	pthread_mutex_init( &m_mutex, NULL );
+	pthread_cond_init( &m_workCond, NULL );
+	pthread_cond_init( &m_doneCond, NULL );
+
+	// set before the thread reads it
+	m_bThreadRunning = true;
+	if ( pthread_create( &m_thread, NULL, songSaver_thread, this ) != 0 ) {
+		ERRORLOG( "Error creating the song saver thread, the songs are saved by the calling thread" );
+		m_bThreadRunning = false;
+	}
+}
+
+
+
+SongSaver::~SongSaver()
+{
+	if ( m_bThreadRunning ) {
+		pthread_mutex_lock( &m_mutex );
+		m_bQuit = true;
+		pthread_cond_signal( &m_workCond );
+		pthread_mutex_unlock( &m_mutex );
+		pthread_join( m_thread, NULL );
+	}
+
+	pthread_cond_destroy( &m_doneCond );
+	pthread_cond_destroy( &m_workCond );
+	pthread_mutex_destroy( &m_mutex );
+}
+
+
+
+bool SongSaver::save( Song* pSong, const QString& sFilename, bool bSkipUnchanged )
+{
+	// the audio thread changes the song too, it's held off while the snapshot is taken
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
+	QByteArray snapshot = SongSnapshot::encode( pSong, SongSnapshot::current_settings() );
+	AudioEngine::get_instance()->unlock();
+
+	pthread_mutex_lock( &m_mutex );
+	if ( bSkipUnchanged ) {
+		// compared with the latest save of the file, the pending one first
+		bool bUnchanged;
+		if ( m_bPending ) {
+			bUnchanged = m_sFilename == sFilename && m_snapshot == snapshot;
+		} else {
+			bUnchanged = m_sSavedFilename == sFilename && m_savedSnapshot == snapshot;
+		}
+		if ( bUnchanged ) {
+			pthread_mutex_unlock( &m_mutex );
+			return false;
+		}
+	}
+	if ( m_bPending ) {
+		INFOLOG( "Pending save of " + m_sFilename + " replaced" );
+	}
+	m_sFilename = sFilename;
+	m_snapshot = snapshot;
+	m_bPending = true;
+	pthread_cond_signal( &m_workCond );
+	pthread_mutex_unlock( &m_mutex );
+
+	if ( !m_bThreadRunning ) {
+		saverLoop();
+	}
+	return true;
+}
+
+
+
+bool SongSaver::wait()
+{
+	pthread_mutex_lock( &m_mutex );
+	while ( m_bPending || m_bBusy ) {
+		pthread_cond_wait( &m_doneCond, &m_mutex );
+	}
+	bool bOk = !m_bFailed;
+	m_bFailed = false;
+	pthread_mutex_unlock( &m_mutex );
+	return bOk;
+}
+
+
+
+void SongSaver::saverLoop()
+{
+	pthread_mutex_lock( &m_mutex );
+	while ( m_bPending || ( m_bThreadRunning && !m_bQuit ) ) {
+		if ( !m_bPending ) {
+			pthread_cond_wait( &m_workCond, &m_mutex );
+			continue;
+		}
+		QString sFilename = m_sFilename;
+		QByteArray snapshot = m_snapshot;
+		m_bPending = false;
+		m_bBusy = true;
+		pthread_mutex_unlock( &m_mutex );
+
+		bool bOk = write( sFilename, snapshot );
+
+		pthread_mutex_lock( &m_mutex );
+		m_bBusy = false;
+		if ( bOk ) {
+			m_sSavedFilename = sFilename;
+			m_savedSnapshot = snapshot;
+		} else {
+			m_bFailed = true;
+			m_savedSnapshot.clear();
+		}
+		pthread_cond_broadcast( &m_doneCond );
+	}
+	pthread_mutex_unlock( &m_mutex );
+}
+
+
+
+bool SongSaver::write( const QString& sFilename, const QByteArray& snapshot )
+{
+	INFOLOG( "Saving song " + sFilename );
+	QByteArray data = snapshot;
+	if ( !sFilename.endsWith( SongSnapshot::extension ) ) {
+		data = SongSnapshot::to_xml( snapshot );
+	}
+	if ( data.isEmpty() || !Filesystem::write_atomic( sFilename, data ) ) {
+		ERRORLOG( "Error saving song " + sFilename );
+		return false;
+	}
+	INFOLOG( QString( "Save was successful, %1 bytes" ).arg( data.size() ) );
+	return true;
+}
+
+};
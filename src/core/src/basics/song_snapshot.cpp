@@ -0,0 +1,1162 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/basics/song_snapshot.h>
+
+#include "hydrogen/version.h"
+
+#include <hydrogen/LocalFileMng.h>
+#include <hydrogen/Preferences.h>
+#include <hydrogen/fx/Effects.h>
+#include <hydrogen/globals.h>
+#include <hydrogen/hydrogen.h>
+#include <hydrogen/event_queue.h>
+#include <hydrogen/basics/adsr.h>
+#include <hydrogen/basics/song.h>
+#include <hydrogen/basics/drumkit_component.h>
+#include <hydrogen/basics/sample.h>
+#include <hydrogen/basics/instrument.h>
+#include <hydrogen/basics/instrument_component.h>
+#include <hydrogen/basics/instrument_list.h>
+#include <hydrogen/basics/instrument_layer.h>
+#include <hydrogen/basics/layer_loader.h>
+#include <hydrogen/basics/pattern.h>
+#include <hydrogen/basics/pattern_list.h>
+#include <hydrogen/basics/note.h>
+#include <hydrogen/helpers/filesystem.h>
+
+#include <QFile>
+#include <QHash>
+#include <QXmlStreamWriter>
+
+#include <cstring>
+
+namespace
+{
+
+const char MAGIC[ 4 ] = { 'H', '2', 'S', 'S' };
+const quint32 FORMAT_VERSION = 2;	///< 2: the FX sends of the instruments are counted, version 1 stores 4
+const int HEADER_SIZE = 16;		///< magic, version, offset and size of the string table
+const int NOTE_SIZE = 36;		///< packed note record
+
+inline quint32 readDWord( const unsigned char* pData )
+{
+	return pData[ 0 ] | ( pData[ 1 ] << 8 ) | ( pData[ 2 ] << 16 ) | ( ( quint32 )pData[ 3 ] << 24 );
+}
+
+inline float readFloat( const unsigned char* pData )
+{
+	quint32 nVal = readDWord( pData );
+	float fVal;
+	memcpy( &fVal, &nVal, 4 );
+	return fVal;
+}
+
+/// encodes the tables into a buffer, each string goes once into the string table
+class SnapshotWriter
+{
+public:
+	SnapshotWriter() {
+		m_buffer.append( MAGIC, 4 );
+		writeDWord( FORMAT_VERSION );
+		writeDWord( 0 );			// patched by finish()
+		writeDWord( 0 );
+	}
+
+	void reserve( int nBytes ) {
+		m_buffer.reserve( m_buffer.size() + nBytes );
+	}
+	void writeByte( int nVal ) {
+		m_buffer.append( ( char )nVal );
+	}
+	void writeBool( bool bVal ) {
+		writeByte( bVal ? 1 : 0 );
+	}
+	void writeDWord( quint32 nVal ) {
+		char bytes[ 4 ] = { ( char )nVal, ( char )( nVal >> 8 ), ( char )( nVal >> 16 ), ( char )( nVal >> 24 ) };
+		m_buffer.append( bytes, 4 );
+	}
+	void writeInt( int nVal ) {
+		writeDWord( ( quint32 )nVal );
+	}
+	void writeFloat( float fVal ) {
+		quint32 nVal;
+		memcpy( &nVal, &fVal, 4 );
+		writeDWord( nVal );
+	}
+	void writeString( const QString& sVal ) {
+		QHash<QString, quint32>::const_iterator it = m_stringIndexes.constFind( sVal );
+		if ( it != m_stringIndexes.constEnd() ) {
+			writeDWord( it.value() );
+			return;
+		}
+		quint32 nIndex = m_strings.size();
+		m_strings.push_back( sVal );
+		m_stringIndexes.insert( sVal, nIndex );
+		writeDWord( nIndex );
+	}
+
+	/// append the string table and \return the snapshot
+	const QByteArray& finish() {
+		quint32 nOffset = m_buffer.size();
+		for ( unsigned i = 0; i < m_strings.size(); i++ ) {
+			QByteArray utf8 = m_strings[ i ].toUtf8();
+			writeDWord( utf8.size() );
+			m_buffer.append( utf8 );
+		}
+		patchDWord( 8, nOffset );
+		patchDWord( 12, m_strings.size() );
+		return m_buffer;
+	}
+
+private:
+	QByteArray m_buffer;
+	std::vector<QString> m_strings;
+	QHash<QString, quint32> m_stringIndexes;
+
+	void patchDWord( int nOffset, quint32 nVal ) {
+		m_buffer[ nOffset ] = ( char )nVal;
+		m_buffer[ nOffset + 1 ] = ( char )( nVal >> 8 );
+		m_buffer[ nOffset + 2 ] = ( char )( nVal >> 16 );
+		m_buffer[ nOffset + 3 ] = ( char )( nVal >> 24 );
+	}
+};
+
+/// decodes the tables of a snapshot, reading past the end sets the error flag
+class SnapshotReader
+{
+public:
+	SnapshotReader( const unsigned char* pData, qint64 nSize, const std::vector<QString>* pStrings = NULL )
+		: m_pPos( pData )
+		, m_pEnd( pData + nSize )
+		, m_pStrings( pStrings )
+		, m_bError( false ) {
+	}
+
+	bool hasError() const {
+		return m_bError;
+	}
+	/// \return the address of the next byte to read
+	const unsigned char* position() const {
+		return m_pPos;
+	}
+	/// \return the address of the next nBytes bytes, NULL if there aren't so many left
+	const unsigned char* readBytes( quint32 nBytes ) {
+		if ( m_bError || ( quint64 )( m_pEnd - m_pPos ) < nBytes ) {
+			m_bError = true;
+			return NULL;
+		}
+		const unsigned char* pData = m_pPos;
+		m_pPos += nBytes;
+		return pData;
+	}
+	int readByte() {
+		const unsigned char* pData = readBytes( 1 );
+		return pData ? pData[ 0 ] : 0;
+	}
+	bool readBool() {
+		return readByte() != 0;
+	}
+	quint32 readDWord() {
+		const unsigned char* pData = readBytes( 4 );
+		return pData ? ::readDWord( pData ) : 0;
+	}
+	int readInt() {
+		return ( qint32 )readDWord();
+	}
+	float readFloat() {
+		const unsigned char* pData = readBytes( 4 );
+		return pData ? ::readFloat( pData ) : 0.0;
+	}
+	QString readString() {
+		quint32 nIndex = readDWord();
+		if ( m_pStrings == NULL || nIndex >= m_pStrings->size() ) {
+			m_bError = true;
+			return QString();
+		}
+		return ( *m_pStrings )[ nIndex ];
+	}
+	/// \return a number of records of at least nRecordSize bytes, 0 if they can't fit in the bytes left
+	quint32 readCount( int nRecordSize ) {
+		quint32 nCount = readDWord();
+		if ( m_bError || nCount > ( quint64 )( m_pEnd - m_pPos ) / nRecordSize ) {
+			m_bError = true;
+			return 0;
+		}
+		return nCount;
+	}
+
+private:
+	const unsigned char* m_pPos;
+	const unsigned char* m_pEnd;
+	const std::vector<QString>* m_pStrings;
+	bool m_bError;
+};
+
+void writeEnvelope( SnapshotWriter& writer, const H2Core::Sample::VelocityEnvelope& envelope )
+{
+	writer.writeDWord( envelope.size() );
+	for ( unsigned i = 0; i < envelope.size(); i++ ) {
+		writer.writeInt( envelope[ i ].frame );
+		writer.writeInt( envelope[ i ].value );
+	}
+}
+
+void readEnvelope( SnapshotReader& reader, H2Core::Sample::VelocityEnvelope& envelope )
+{
+	quint32 nPoints = reader.readCount( 8 );
+	for ( quint32 i = 0; i < nPoints; i++ ) {
+		int nFrame = reader.readInt();
+		envelope.push_back( H2Core::Sample::EnvelopePoint( nFrame, reader.readInt() ) );
+	}
+}
+
+/// number of FX send levels of an instrument
+quint32 readFXSendCount( SnapshotReader& reader, quint32 nVersion )
+{
+	return nVersion < 2 ? 4 : reader.readCount( 4 );
+}
+
+/**
+ * check the header and decode the string table
+ * \param nStringsOffset set to the offset of the string table, the end of the other tables
+ * \return an error message, empty if the header and the string table are valid
+ */
+QString readStringTable( const unsigned char* pBytes, qint64 nSize, std::vector<QString>& strings, quint32& nStringsOffset, quint32& nVersion )
+{
+	if ( nSize < HEADER_SIZE || memcmp( pBytes, MAGIC, 4 ) != 0 ) {
+		return "Not a song snapshot";
+	}
+	nVersion = readDWord( pBytes + 4 );
+	nStringsOffset = readDWord( pBytes + 8 );
+	quint32 nStrings = readDWord( pBytes + 12 );
+	if ( nVersion > FORMAT_VERSION ) {
+		return QString( "Song snapshot of format %1, newer than this version of hydrogen" ).arg( nVersion );
+	}
+	if ( nStringsOffset < ( quint32 )HEADER_SIZE || nStringsOffset > nSize ) {
+		return "Corrupted song snapshot: string table out of the file";
+	}
+
+	SnapshotReader stringReader( pBytes + nStringsOffset, nSize - nStringsOffset );
+	if ( nStrings > ( nSize - nStringsOffset ) / 4 ) {
+		return "Corrupted song snapshot: truncated string table";
+	}
+	strings.reserve( nStrings );
+	for ( quint32 i = 0; i < nStrings; i++ ) {
+		quint32 nLength = stringReader.readDWord();
+		const unsigned char* pString = stringReader.readBytes( nLength );
+		if ( stringReader.hasError() ) {
+			return "Corrupted song snapshot: truncated string table";
+		}
+		strings.push_back( QString::fromUtf8( ( const char* )pString, nLength ) );
+	}
+	return QString();
+}
+
+/// the XML of the numbers and the booleans, as LocalFileMng writes them
+inline void writeXmlNumber( QXmlStreamWriter& xml, const QString& sName, float fVal )
+{
+	xml.writeTextElement( sName, QString( "%1" ).arg( fVal ) );
+}
+
+inline void writeXmlNumber( QXmlStreamWriter& xml, const QString& sName, int nVal )
+{
+	xml.writeTextElement( sName, QString( "%1" ).arg( nVal ) );
+}
+
+inline void writeXmlBool( QXmlStreamWriter& xml, const QString& sName, bool bVal )
+{
+	xml.writeTextElement( sName, bVal ? "true" : "false" );
+}
+
+/// as Note::key_to_string() and Sample::get_loop_mode_string() write them
+const char* KEY_STRINGS[] = { "C", "Cs", "D", "Ef", "E", "F", "Fs", "G", "Af", "A", "Bf", "B" };
+const char* LOOP_MODE_STRINGS[] = { "forward", "reverse", "pingpong" };
+
+/// saves whose tables are larger, some 100000 notes, report their progress
+const qint64 PROGRESS_MIN_SIZE = 100000 * NOTE_SIZE;
+
+}//anonymous namespace
+
+namespace H2Core
+{
+
+const char* SongSnapshot::__class_name = "SongSnapshot";
+const char* SongSnapshot::extension = ".h2snap";
+
+bool SongSnapshot::is_snapshot( const QString& sFilename )
+{
+	QFile file( sFilename );
+	if ( !file.open( QIODevice::ReadOnly ) ) {
+		return false;
+	}
+	char magic[ 4 ];
+	return file.read( magic, 4 ) == 4 && memcmp( magic, MAGIC, 4 ) == 0;
+}
+
+
+
+SongSnapshot::Settings SongSnapshot::current_settings()
+{
+	Settings settings;
+	settings.bPatternModePlaysSelected = Preferences::get_instance()->patternModePlaysSelected();
+#ifdef H2CORE_HAVE_LADSPA
+	int nSlots = Effects::get_instance()->getNumberOfSlots();
+#else
+	int nSlots = MAX_FX;
+#endif
+	for ( int nFX = 0; nFX < nSlots; nFX++ ) {
+		Fx fx;
+		fx.sName = "no plugin";
+		fx.sFilename = "-";
+#ifdef H2CORE_HAVE_LADSPA
+		LadspaFX* pFX = Effects::get_instance()->getLadspaFX( nFX );
+		if ( pFX ) {
+			fx.sName = pFX->getPluginLabel();
+			fx.sFilename = pFX->getLibraryPath();
+			fx.bEnabled = pFX->isEnabled();
+			fx.fVolume = pFX->getVolume();
+			for ( unsigned nPort = 0; nPort < pFX->inputControlPorts.size(); nPort++ ) {
+				LadspaControlPort* pPort = pFX->inputControlPorts[ nPort ];
+				fx.inputControlPorts.push_back( std::make_pair( QString( pPort->sName ), ( float )pPort->fControlValue ) );
+			}
+		}
+#endif
+		settings.fx.push_back( fx );
+	}
+	Timeline* pTimeline = Hydrogen::get_instance()->getTimeline();
+	settings.timeline = pTimeline->m_timelinevector;
+	settings.timelineTags = pTimeline->m_timelinetagvector;
+	return settings;
+}
+
+
+
+bool SongSnapshot::save( Song* pSong, const QString& sFilename )
+{
+	_INFOLOG( "Saving song " + sFilename );
+
+	QByteArray data = encode( pSong, current_settings() );
+	if ( !Filesystem::write_atomic( sFilename, data ) ) {
+		return false;
+	}
+
+	pSong->set_is_modified( false );
+	pSong->set_filename( sFilename );
+	_INFOLOG( QString( "Save was successful, %1 bytes" ).arg( data.size() ) );
+	return true;
+}
+
+
+
+Song* SongSnapshot::load( const QString& sFilename )
+{
+	_INFOLOG( "Reading " + sFilename );
+
+	QFile file( sFilename );
+	if ( !file.open( QIODevice::ReadOnly ) ) {
+		_ERRORLOG( QString( "Error opening %1: %2" ).arg( sFilename ).arg( file.errorString() ) );
+		return NULL;
+	}
+	qint64 nSize = file.size();
+	const char* pData = ( const char* )file.map( 0, nSize );
+	QByteArray data;
+	if ( pData == NULL ) {
+		// not every file system can map files
+		data = file.readAll();
+		pData = data.constData();
+		nSize = data.size();
+	}
+
+	Settings settings;
+	// the rubberband settings of the layers are only kept if the samples can be stretched
+	bool bUseRubberband = Sample::rubberband_available();
+	Song* pSong = decode( pData, nSize, settings, bUseRubberband );
+	file.close();
+	if ( pSong == NULL ) {
+		_ERRORLOG( "Error reading song snapshot " + sFilename );
+		return NULL;
+	}
+
+	Hydrogen::get_instance()->setNewBpmJTM( pSong->__bpm );
+	Preferences::get_instance()->setPatternModePlaysSelected( settings.bPatternModePlaysSelected );
+	InstrumentList* pInstrList = pSong->get_instrument_list();
+	if ( pInstrList->size() > 0 ) {
+		Hydrogen::get_instance()->setCurrentDrumkitname( pInstrList->get( pInstrList->size() - 1 )->get_drumkit_name() );
+	}
+
+#ifdef H2CORE_HAVE_LADSPA
+	// reset FX
+	for ( int nFX = 0; nFX < Effects::get_instance()->getNumberOfSlots(); ++nFX ) {
+		Effects::get_instance()->setLadspaFX( NULL, nFX );
+	}
+	for ( unsigned nFX = 0; nFX < settings.fx.size() && ( int )nFX < Effects::get_instance()->getNumberOfSlots(); nFX++ ) {
+		const Fx& fx = settings.fx[ nFX ];
+		if ( fx.sName == "no plugin" ) {
+			continue;
+		}
+		LadspaFX* pFX = LadspaFX::load( fx.sFilename, fx.sName, 44100 );
+		Effects::get_instance()->setLadspaFX( pFX, nFX );
+		if ( pFX ) {
+			pFX->setEnabled( fx.bEnabled );
+			pFX->setVolume( fx.fVolume );
+			for ( unsigned i = 0; i < fx.inputControlPorts.size(); i++ ) {
+				for ( unsigned nPort = 0; nPort < pFX->inputControlPorts.size(); nPort++ ) {
+					LadspaControlPort* pPort = pFX->inputControlPorts[ nPort ];
+					if ( QString( pPort->sName ) == fx.inputControlPorts[ i ].first ) {
+						pPort->fControlValue = fx.inputControlPorts[ i ].second;
+					}
+				}
+			}
+		}
+	}
+#endif
+
+	Timeline* pTimeline = Hydrogen::get_instance()->getTimeline();
+	pTimeline->m_timelinevector = settings.timeline;
+	pTimeline->sortTimelineVector();
+	pTimeline->m_timelinetagvector = settings.timelineTags;
+	pTimeline->sortTimelineTagVector();
+
+	pSong->set_is_modified( false );
+	pSong->set_filename( sFilename );
+	return pSong;
+}
+
+
+
+QByteArray SongSnapshot::encode( Song* pSong, const Settings& settings )
+{
+	SnapshotWriter writer;
+
+	writer.writeString( QString( get_version().c_str() ) );
+	writer.writeString( pSong->__name );
+	writer.writeString( pSong->__author );
+	writer.writeString( pSong->get_notes() );
+	writer.writeString( pSong->get_license() );
+	writer.writeFloat( pSong->__bpm );
+	writer.writeFloat( pSong->get_volume() );
+	writer.writeFloat( pSong->get_metronome_volume() );
+	writer.writeFloat( pSong->get_humanize_time_value() );
+	writer.writeFloat( pSong->get_humanize_velocity_value() );
+	writer.writeFloat( pSong->get_swing_factor() );
+	writer.writeBool( pSong->is_loop_enabled() );
+	writer.writeBool( pSong->get_mode() == Song::SONG_MODE );
+	writer.writeBool( settings.bPatternModePlaysSelected );
+
+	std::vector<DrumkitComponent*>* pComponents = pSong->get_components();
+	writer.writeDWord( pComponents->size() );
+	for ( unsigned i = 0; i < pComponents->size(); i++ ) {
+		DrumkitComponent* pComponent = ( *pComponents )[ i ];
+		writer.writeInt( pComponent->get_id() );
+		writer.writeString( pComponent->get_name() );
+		writer.writeFloat( pComponent->get_volume() );
+	}
+
+	InstrumentList* pInstrList = pSong->get_instrument_list();
+	writer.writeDWord( pInstrList->size() );
+	for ( int nInstr = 0; nInstr < pInstrList->size(); nInstr++ ) {
+		Instrument* pInstr = pInstrList->get( nInstr );
+		ADSR* pAdsr = pInstr->get_adsr();
+		writer.writeInt( pInstr->get_id() );
+		writer.writeString( pInstr->get_name() );
+		writer.writeString( pInstr->get_drumkit_name() );
+		writer.writeFloat( pInstr->get_volume() );
+		writer.writeBool( pInstr->is_muted() );
+		writer.writeFloat( pInstr->get_pan_l() );
+		writer.writeFloat( pInstr->get_pan_r() );
+		writer.writeFloat( pInstr->get_gain() );
+		writer.writeBool( pInstr->is_filter_active() );
+		writer.writeFloat( pInstr->get_filter_cutoff() );
+		writer.writeFloat( pInstr->get_filter_resonance() );
+		writer.writeDWord( Instrument::get_fx_slots() );
+		for ( int nFX = 0; nFX < Instrument::get_fx_slots(); nFX++ ) {
+			writer.writeFloat( pInstr->get_fx_level( nFX ) );
+		}
+		writer.writeFloat( pAdsr->get_attack() );
+		writer.writeFloat( pAdsr->get_decay() );
+		writer.writeFloat( pAdsr->get_sustain() );
+		writer.writeFloat( pAdsr->get_release() );
+		writer.writeFloat( pInstr->get_random_pitch_factor() );
+		writer.writeInt( pInstr->get_mute_group() );
+		writer.writeBool( pInstr->is_stop_notes() );
+		writer.writeInt( pInstr->get_midi_out_channel() );
+		writer.writeInt( pInstr->get_midi_out_note() );
+
+		std::vector<InstrumentComponent*>* pInstrComponents = pInstr->get_components();
+		writer.writeDWord( pInstrComponents->size() );
+		for ( unsigned nComponent = 0; nComponent < pInstrComponents->size(); nComponent++ ) {
+			InstrumentComponent* pComponent = ( *pInstrComponents )[ nComponent ];
+			writer.writeInt( pComponent->get_drumkit_componentID() );
+			writer.writeFloat( pComponent->get_gain() );
+
+			// like in the XML, the layers without sample are dropped
+			std::vector<InstrumentLayer*> layers;
+			for ( int nLayer = 0; nLayer < MAX_LAYERS; nLayer++ ) {
+				InstrumentLayer* pLayer = pComponent->get_layer( nLayer );
+				if ( pLayer && pLayer->get_sample() ) {
+					layers.push_back( pLayer );
+				}
+			}
+			writer.writeDWord( layers.size() );
+			for ( unsigned nLayer = 0; nLayer < layers.size(); nLayer++ ) {
+				InstrumentLayer* pLayer = layers[ nLayer ];
+				Sample* pSample = pLayer->get_sample();
+				Sample::Loops lo = pSample->get_loops();
+				Sample::Rubberband ro = pSample->get_rubberband();
+				writer.writeString( prepare_filename( pSample->get_filepath() ) );
+				writer.writeBool( pSample->get_is_modified() );
+				writer.writeByte( lo.mode );
+				writer.writeInt( lo.start_frame );
+				writer.writeInt( lo.loop_frame );
+				writer.writeInt( lo.count );
+				writer.writeInt( lo.end_frame );
+				writer.writeBool( ro.use );
+				writer.writeFloat( ro.divider );
+				writer.writeInt( ro.c_settings );
+				writer.writeFloat( ro.pitch );
+				writer.writeFloat( pLayer->get_start_velocity() );
+				writer.writeFloat( pLayer->get_end_velocity() );
+				writer.writeFloat( pLayer->get_gain() );
+				writer.writeFloat( pLayer->get_pitch() );
+				writeEnvelope( writer, *pSample->get_velocity_envelope() );
+				writeEnvelope( writer, *pSample->get_pan_envelope() );
+			}
+		}
+	}
+
+	PatternList* pPatternList = pSong->get_pattern_list();
+	QHash<Pattern*, quint32> patternIndexes;
+	writer.writeDWord( pPatternList->size() );
+	for ( int nPattern = 0; nPattern < pPatternList->size(); nPattern++ ) {
+		Pattern* pPattern = pPatternList->get( nPattern );
+		patternIndexes.insert( pPattern, nPattern );
+		writer.writeString( pPattern->get_name() );
+		writer.writeString( pPattern->get_info() );
+		writer.writeString( pPattern->get_category() );
+		writer.writeInt( pPattern->get_length() );
+
+		const Pattern::notes_t* notes = pPattern->get_notes();
+		writer.writeDWord( notes->size() );
+		writer.reserve( notes->size() * NOTE_SIZE );
+		FOREACH_NOTE_CST_IT_BEGIN_END( notes, it ) {
+			Note* pNote = it->second;
+			writer.writeInt( pNote->get_position() );
+			writer.writeInt( pNote->get_instrument()->get_id() );
+			writer.writeFloat( pNote->get_velocity() );
+			writer.writeFloat( pNote->get_pan_l() );
+			writer.writeFloat( pNote->get_pan_r() );
+			writer.writeFloat( pNote->get_lead_lag() );
+			writer.writeFloat( pNote->get_pitch() );
+			writer.writeInt( pNote->get_length() );
+			writer.writeByte( pNote->get_key() );
+			writer.writeByte( pNote->get_octave() );
+			writer.writeBool( pNote->get_note_off() );
+			writer.writeByte( 0 );
+		}
+	}
+
+	for ( int nPattern = 0; nPattern < pPatternList->size(); nPattern++ ) {
+		const Pattern::virtual_patterns_t* pVirtuals = pPatternList->get( nPattern )->get_virtual_patterns();
+		std::vector<quint32> indexes;
+		for ( Pattern::virtual_patterns_cst_it_t it = pVirtuals->begin(); it != pVirtuals->end(); ++it ) {
+			if ( patternIndexes.contains( *it ) ) {
+				indexes.push_back( patternIndexes.value( *it ) );
+			}
+		}
+		writer.writeDWord( indexes.size() );
+		for ( unsigned i = 0; i < indexes.size(); i++ ) {
+			writer.writeDWord( indexes[ i ] );
+		}
+	}
+
+	std::vector<PatternList*>* pColumns = pSong->get_pattern_group_vector();
+	writer.writeDWord( pColumns->size() );
+	for ( unsigned nColumn = 0; nColumn < pColumns->size(); nColumn++ ) {
+		PatternList* pColumn = ( *pColumns )[ nColumn ];
+		std::vector<quint32> indexes;
+		for ( int i = 0; i < pColumn->size(); i++ ) {
+			if ( patternIndexes.contains( pColumn->get( i ) ) ) {
+				indexes.push_back( patternIndexes.value( pColumn->get( i ) ) );
+			}
+		}
+		writer.writeDWord( indexes.size() );
+		for ( unsigned i = 0; i < indexes.size(); i++ ) {
+			writer.writeDWord( indexes[ i ] );
+		}
+	}
+
+	writer.writeDWord( settings.fx.size() );
+	for ( unsigned nFX = 0; nFX < settings.fx.size(); nFX++ ) {
+		const Fx& fx = settings.fx[ nFX ];
+		writer.writeString( fx.sName );
+		writer.writeString( fx.sFilename );
+		writer.writeBool( fx.bEnabled );
+		writer.writeFloat( fx.fVolume );
+		writer.writeDWord( fx.inputControlPorts.size() );
+		for ( unsigned nPort = 0; nPort < fx.inputControlPorts.size(); nPort++ ) {
+			writer.writeString( fx.inputControlPorts[ nPort ].first );
+			writer.writeFloat( fx.inputControlPorts[ nPort ].second );
+		}
+	}
+
+	writer.writeDWord( settings.timeline.size() );
+	for ( unsigned i = 0; i < settings.timeline.size(); i++ ) {
+		writer.writeInt( settings.timeline[ i ].m_htimelinebeat );
+		writer.writeFloat( settings.timeline[ i ].m_htimelinebpm );
+	}
+	writer.writeDWord( settings.timelineTags.size() );
+	for ( unsigned i = 0; i < settings.timelineTags.size(); i++ ) {
+		writer.writeInt( settings.timelineTags[ i ].m_htimelinetagbeat );
+		writer.writeString( settings.timelineTags[ i ].m_htimelinetag );
+	}
+
+	return writer.finish();
+}
+
+
+
+Song* SongSnapshot::decode( const char* pData, qint64 nSize, Settings& settings, bool bUseRubberband )
+{
+	const unsigned char* pBytes = ( const unsigned char* )pData;
+	std::vector<QString> strings;
+	quint32 nStringsOffset;
+	quint32 nVersion;
+	QString sError = readStringTable( pBytes, nSize, strings, nStringsOffset, nVersion );
+	if ( !sError.isEmpty() ) {
+		_ERRORLOG( sError );
+		return NULL;
+	}
+
+	SnapshotReader reader( pBytes + HEADER_SIZE, nStringsOffset - HEADER_SIZE, &strings );
+
+	QString sVersion = reader.readString();
+	QString sName = reader.readString();
+	QString sAuthor = reader.readString();
+	QString sNotes = reader.readString();
+	QString sLicense = reader.readString();
+	float fBpm = reader.readFloat();
+	float fVolume = reader.readFloat();
+	Song* pSong = new Song( sName, sAuthor, fBpm, fVolume );
+	pSong->set_notes( sNotes );
+	pSong->set_license( sLicense );
+	pSong->set_metronome_volume( reader.readFloat() );
+	pSong->set_humanize_time_value( reader.readFloat() );
+	pSong->set_humanize_velocity_value( reader.readFloat() );
+	pSong->set_swing_factor( reader.readFloat() );
+	pSong->set_loop_enabled( reader.readBool() );
+	pSong->set_mode( reader.readBool() ? Song::SONG_MODE : Song::PATTERN_MODE );
+	settings.bPatternModePlaysSelected = reader.readBool();
+
+	if ( sVersion != QString( get_version().c_str() ) ) {
+		_WARNINGLOG( "Song snapshot saved with version " + sVersion );
+	}
+
+	quint32 nComponents = reader.readCount( 12 );
+	for ( quint32 i = 0; i < nComponents; i++ ) {
+		int nId = reader.readInt();
+		DrumkitComponent* pComponent = new DrumkitComponent( nId, reader.readString() );
+		pComponent->set_volume( reader.readFloat() );
+		pSong->get_components()->push_back( pComponent );
+	}
+
+	InstrumentList* pInstrList = new InstrumentList();
+	pSong->set_instrument_list( pInstrList );
+	QHash<int, Instrument*> instruments;
+	quint32 nInstruments = reader.readCount( 4 );
+	for ( quint32 nInstr = 0; nInstr < nInstruments && !reader.hasError(); nInstr++ ) {
+		int nId = reader.readInt();
+		QString sInstrName = reader.readString();
+		QString sDrumkit = reader.readString();
+		Instrument* pInstr = new Instrument( nId, sInstrName );
+		pInstrList->add( pInstr );
+		if ( !instruments.contains( nId ) ) {
+			instruments.insert( nId, pInstr );
+		}
+		pInstr->set_drumkit_name( sDrumkit );
+		pInstr->set_volume( reader.readFloat() );
+		pInstr->set_muted( reader.readBool() );
+		pInstr->set_pan_l( reader.readFloat() );
+		pInstr->set_pan_r( reader.readFloat() );
+		pInstr->set_gain( reader.readFloat() );
+		pInstr->set_filter_active( reader.readBool() );
+		pInstr->set_filter_cutoff( reader.readFloat() );
+		pInstr->set_filter_resonance( reader.readFloat() );
+		quint32 nSends = readFXSendCount( reader, nVersion );
+		for ( quint32 nFX = 0; nFX < nSends; nFX++ ) {
+			pInstr->set_fx_level( reader.readFloat(), nFX );
+		}
+		ADSR* pAdsr = pInstr->get_adsr();
+		pAdsr->set_attack( reader.readFloat() );
+		pAdsr->set_decay( reader.readFloat() );
+		pAdsr->set_sustain( reader.readFloat() );
+		pAdsr->set_release( reader.readFloat() );
+		pInstr->set_random_pitch_factor( reader.readFloat() );
+		pInstr->set_mute_group( reader.readInt() );
+		pInstr->set_stop_notes( reader.readBool() );
+		pInstr->set_midi_out_channel( reader.readInt() );
+		pInstr->set_midi_out_note( reader.readInt() );
+
+		QString sDrumkitPath;
+		if ( !sDrumkit.isEmpty() && sDrumkit != "-" ) {
+			sDrumkitPath = Filesystem::drumkit_path_search( sDrumkit );
+		}
+
+		quint32 nInstrComponents = reader.readCount( 12 );
+		for ( quint32 nComponent = 0; nComponent < nInstrComponents && !reader.hasError(); nComponent++ ) {
+			InstrumentComponent* pComponent = new InstrumentComponent( reader.readInt() );
+			pComponent->set_gain( reader.readFloat() );
+			pInstr->get_components()->push_back( pComponent );
+
+			quint32 nLayers = reader.readCount( 4 );
+			for ( quint32 nLayer = 0; nLayer < nLayers && !reader.hasError(); nLayer++ ) {
+				QString sFilename = reader.readString();
+				bool bIsModified = reader.readBool();
+				Sample::Loops lo;
+				lo.mode = ( Sample::Loops::LoopMode )reader.readByte();
+				lo.start_frame = reader.readInt();
+				lo.loop_frame = reader.readInt();
+				lo.count = reader.readInt();
+				lo.end_frame = reader.readInt();
+				Sample::Rubberband ro;
+				ro.use = reader.readBool();
+				ro.divider = reader.readFloat();
+				ro.c_settings = reader.readInt();
+				ro.pitch = reader.readFloat();
+				float fMin = reader.readFloat();
+				float fMax = reader.readFloat();
+				float fGain = reader.readFloat();
+				float fPitch = reader.readFloat();
+				Sample::VelocityEnvelope velocity;
+				Sample::PanEnvelope pan;
+				readEnvelope( reader, velocity );
+				readEnvelope( reader, pan );
+				if ( reader.hasError() ) {
+					break;
+				}
+				if ( nLayer >= MAX_LAYERS ) {
+					_ERRORLOG( "nLayer > MAX_LAYERS" );
+					continue;
+				}
+				if ( !bUseRubberband ) {
+					ro.use = false;
+				}
+
+				if ( !QFile( sFilename ).exists() && !sDrumkitPath.isEmpty() ) {
+					sFilename = sDrumkitPath + "/" + sFilename;
+				}
+				Sample* pSample = NULL;
+				if ( !bIsModified ) {
+					pSample = LayerLoader::create_sample( sFilename );
+				} else {
+					pSample = Sample::load( sFilename, lo, ro, velocity, pan );
+				}
+				if ( pSample == NULL ) {
+					_ERRORLOG( "Error loading sample: " + sFilename + " not found" );
+					pInstr->set_muted( true );
+				}
+				InstrumentLayer* pLayer = new InstrumentLayer( pSample );
+				pLayer->set_start_velocity( fMin );
+				pLayer->set_end_velocity( fMax );
+				pLayer->set_gain( fGain );
+				pLayer->set_pitch( fPitch );
+				pComponent->set_layer( pLayer, nLayer );
+			}
+		}
+	}
+
+	PatternList* pPatternList = new PatternList();
+	pSong->set_pattern_list( pPatternList );
+	quint32 nPatterns = reader.readCount( 20 );
+	for ( quint32 nPattern = 0; nPattern < nPatterns && !reader.hasError(); nPattern++ ) {
+		QString sPatternName = reader.readString();
+		QString sInfo = reader.readString();
+		QString sCategory = reader.readString();
+		Pattern* pPattern = new Pattern( sPatternName, sInfo, sCategory, reader.readInt() );
+		pPatternList->add( pPattern );
+
+		// the notes are decoded straight from the snapshot
+		quint32 nNotes = reader.readCount( NOTE_SIZE );
+		const unsigned char* pRecord = reader.readBytes( nNotes * NOTE_SIZE );
+		for ( quint32 i = 0; i < nNotes && pRecord; i++, pRecord += NOTE_SIZE ) {
+			int nInstrId = ( qint32 )readDWord( pRecord + 4 );
+			Instrument* pInstr = instruments.value( nInstrId, NULL );
+			if ( pInstr == NULL ) {
+				_ERRORLOG( QString( "Instrument with ID: '%1' not found. Note skipped." ).arg( nInstrId ) );
+				continue;
+			}
+			Note* pNote = new Note( pInstr, readDWord( pRecord ), readFloat( pRecord + 8 ), readFloat( pRecord + 12 ),
+									   readFloat( pRecord + 16 ), ( qint32 )readDWord( pRecord + 28 ), readFloat( pRecord + 24 ) );
+			pNote->set_lead_lag( readFloat( pRecord + 20 ) );
+			pNote->set_key_octave( ( Note::Key )( signed char )pRecord[ 32 ], ( Note::Octave )( signed char )pRecord[ 33 ] );
+			pNote->set_note_off( pRecord[ 34 ] != 0 );
+			pPattern->insert_note( pNote );
+		}
+	}
+
+	for ( int nPattern = 0; nPattern < pPatternList->size() && !reader.hasError(); nPattern++ ) {
+		Pattern* pPattern = pPatternList->get( nPattern );
+		quint32 nVirtuals = reader.readCount( 4 );
+		for ( quint32 i = 0; i < nVirtuals; i++ ) {
+			quint32 nIndex = reader.readDWord();
+			if ( nIndex < ( quint32 )pPatternList->size() ) {
+				pPattern->virtual_patterns_add( pPatternList->get( nIndex ) );
+			} else {
+				_ERRORLOG( "Song had invalid virtual pattern list data (virtual)" );
+			}
+		}
+	}
+	pPatternList->flattened_virtual_patterns_compute();
+
+	std::vector<PatternList*>* pColumns = new std::vector<PatternList*>;
+	pSong->set_pattern_group_vector( pColumns );
+	quint32 nColumns = reader.readCount( 4 );
+	for ( quint32 nColumn = 0; nColumn < nColumns && !reader.hasError(); nColumn++ ) {
+		PatternList* pColumn = new PatternList();
+		pColumns->push_back( pColumn );
+		quint32 nColumnPatterns = reader.readCount( 4 );
+		for ( quint32 i = 0; i < nColumnPatterns; i++ ) {
+			quint32 nIndex = reader.readDWord();
+			if ( nIndex < ( quint32 )pPatternList->size() ) {
+				pColumn->add( pPatternList->get( nIndex ) );
+			} else {
+				_WARNINGLOG( "patternid not found in patternSequence" );
+			}
+		}
+	}
+
+	settings.fx.clear();
+	quint32 nFXs = reader.readCount( 17 );
+	for ( quint32 nFX = 0; nFX < nFXs && !reader.hasError(); nFX++ ) {
+		Fx fx;
+		fx.sName = reader.readString();
+		fx.sFilename = reader.readString();
+		fx.bEnabled = reader.readBool();
+		fx.fVolume = reader.readFloat();
+		quint32 nPorts = reader.readCount( 8 );
+		for ( quint32 nPort = 0; nPort < nPorts; nPort++ ) {
+			QString sPortName = reader.readString();
+			fx.inputControlPorts.push_back( std::make_pair( sPortName, reader.readFloat() ) );
+		}
+		settings.fx.push_back( fx );
+	}
+
+	settings.timeline.clear();
+	quint32 nBpms = reader.readCount( 8 );
+	for ( quint32 i = 0; i < nBpms; i++ ) {
+		Timeline::HTimelineVector bpm;
+		bpm.m_htimelinebeat = reader.readInt();
+		bpm.m_htimelinebpm = reader.readFloat();
+		settings.timeline.push_back( bpm );
+	}
+	settings.timelineTags.clear();
+	quint32 nTags = reader.readCount( 8 );
+	for ( quint32 i = 0; i < nTags; i++ ) {
+		Timeline::HTimelineTagVector tag;
+		tag.m_htimelinetagbeat = reader.readInt();
+		tag.m_htimelinetag = reader.readString();
+		settings.timelineTags.push_back( tag );
+	}
+
+	if ( reader.hasError() ) {
+		_ERRORLOG( "Corrupted song snapshot: truncated tables" );
+		delete pSong;
+		return NULL;
+	}
+	return pSong;
+}
+
+
+QByteArray SongSnapshot::to_xml( const QByteArray& snapshot, bool bReportProgress )
+{
+	const unsigned char* pBytes = ( const unsigned char* )snapshot.constData();
+	std::vector<QString> strings;
+	quint32 nStringsOffset;
+	quint32 nVersion;
+	QString sError = readStringTable( pBytes, snapshot.size(), strings, nStringsOffset, nVersion );
+	if ( !sError.isEmpty() ) {
+		_ERRORLOG( sError );
+		return QByteArray();
+	}
+	SnapshotReader reader( pBytes + HEADER_SIZE, nStringsOffset - HEADER_SIZE, &strings );
+	// the progress follows the bytes read, the notes are most of them
+	bReportProgress = bReportProgress && nStringsOffset >= PROGRESS_MIN_SIZE;
+	int nProgress = 0;
+
+	QByteArray data;
+	QXmlStreamWriter xml( &data );
+	xml.setAutoFormatting( true );
+	xml.setAutoFormattingIndent( 1 );
+	xml.writeStartDocument();
+	xml.writeStartElement( "song" );
+
+	QString sVersion = reader.readString();
+	QString sName = reader.readString();
+	QString sAuthor = reader.readString();
+	QString sNotes = reader.readString();
+	QString sLicense = reader.readString();
+	float fBpm = reader.readFloat();
+	float fVolume = reader.readFloat();
+	float fMetronomeVolume = reader.readFloat();
+	float fHumanizeTime = reader.readFloat();
+	float fHumanizeVelocity = reader.readFloat();
+	float fSwingFactor = reader.readFloat();
+	bool bLoopEnabled = reader.readBool();
+	bool bSongMode = reader.readBool();
+	bool bPatternModePlaysSelected = reader.readBool();
+
+	xml.writeTextElement( "version", sVersion );
+	writeXmlNumber( xml, "bpm", fBpm );
+	writeXmlNumber( xml, "volume", fVolume );
+	writeXmlNumber( xml, "metronomeVolume", fMetronomeVolume );
+	xml.writeTextElement( "name", sName );
+	xml.writeTextElement( "author", sAuthor );
+	xml.writeTextElement( "notes", sNotes );
+	xml.writeTextElement( "license", sLicense );
+	writeXmlBool( xml, "loopEnabled", bLoopEnabled );
+	writeXmlBool( xml, "patternModeMode", bPatternModePlaysSelected );
+	xml.writeTextElement( "mode", bSongMode ? "song" : "pattern" );
+	writeXmlNumber( xml, "humanize_time", fHumanizeTime );
+	writeXmlNumber( xml, "humanize_velocity", fHumanizeVelocity );
+	writeXmlNumber( xml, "swing_factor", fSwingFactor );
+
+	xml.writeStartElement( "componentList" );
+	quint32 nComponents = reader.readCount( 12 );
+	for ( quint32 i = 0; i < nComponents; i++ ) {
+		xml.writeStartElement( "drumkitComponent" );
+		writeXmlNumber( xml, "id", reader.readInt() );
+		xml.writeTextElement( "name", reader.readString() );
+		writeXmlNumber( xml, "volume", reader.readFloat() );
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+
+	xml.writeStartElement( "instrumentList" );
+	quint32 nInstruments = reader.readCount( 4 );
+	for ( quint32 nInstr = 0; nInstr < nInstruments && !reader.hasError(); nInstr++ ) {
+		xml.writeStartElement( "instrument" );
+		writeXmlNumber( xml, "id", reader.readInt() );
+		xml.writeTextElement( "name", reader.readString() );
+		xml.writeTextElement( "drumkit", reader.readString() );
+		writeXmlNumber( xml, "volume", reader.readFloat() );
+		writeXmlBool( xml, "isMuted", reader.readBool() );
+		writeXmlNumber( xml, "pan_L", reader.readFloat() );
+		writeXmlNumber( xml, "pan_R", reader.readFloat() );
+		writeXmlNumber( xml, "gain", reader.readFloat() );
+		writeXmlBool( xml, "filterActive", reader.readBool() );
+		writeXmlNumber( xml, "filterCutoff", reader.readFloat() );
+		writeXmlNumber( xml, "filterResonance", reader.readFloat() );
+		quint32 nSends = readFXSendCount( reader, nVersion );
+		for ( quint32 nFX = 0; nFX < nSends; nFX++ ) {
+			writeXmlNumber( xml, QString( "FX%1Level" ).arg( nFX + 1 ), reader.readFloat() );
+		}
+		writeXmlNumber( xml, "Attack", reader.readFloat() );
+		writeXmlNumber( xml, "Decay", reader.readFloat() );
+		writeXmlNumber( xml, "Sustain", reader.readFloat() );
+		writeXmlNumber( xml, "Release", reader.readFloat() );
+		writeXmlNumber( xml, "randomPitchFactor", reader.readFloat() );
+		writeXmlNumber( xml, "muteGroup", reader.readInt() );
+		writeXmlBool( xml, "isStopNote", reader.readBool() );
+		writeXmlNumber( xml, "midiOutChannel", reader.readInt() );
+		writeXmlNumber( xml, "midiOutNote", reader.readInt() );
+
+		quint32 nInstrComponents = reader.readCount( 12 );
+		for ( quint32 nComponent = 0; nComponent < nInstrComponents && !reader.hasError(); nComponent++ ) {
+			xml.writeStartElement( "instrumentComponent" );
+			writeXmlNumber( xml, "component_id", reader.readInt() );
+			writeXmlNumber( xml, "gain", reader.readFloat() );
+
+			quint32 nLayers = reader.readCount( 4 );
+			for ( quint32 nLayer = 0; nLayer < nLayers && !reader.hasError(); nLayer++ ) {
+				xml.writeStartElement( "layer" );
+				xml.writeTextElement( "filename", reader.readString() );
+				writeXmlBool( xml, "ismodified", reader.readBool() );
+				int nMode = reader.readByte();
+				xml.writeTextElement( "smode", LOOP_MODE_STRINGS[ nMode < 3 ? nMode : 0 ] );
+				writeXmlNumber( xml, "startframe", reader.readInt() );
+				writeXmlNumber( xml, "loopframe", reader.readInt() );
+				writeXmlNumber( xml, "loops", reader.readInt() );
+				writeXmlNumber( xml, "endframe", reader.readInt() );
+				writeXmlNumber( xml, "userubber", ( int )reader.readBool() );
+				writeXmlNumber( xml, "rubberdivider", reader.readFloat() );
+				writeXmlNumber( xml, "rubberCsettings", reader.readInt() );
+				writeXmlNumber( xml, "rubberPitch", reader.readFloat() );
+				writeXmlNumber( xml, "min", reader.readFloat() );
+				writeXmlNumber( xml, "max", reader.readFloat() );
+				writeXmlNumber( xml, "gain", reader.readFloat() );
+				writeXmlNumber( xml, "pitch", reader.readFloat() );
+				quint32 nPoints = reader.readCount( 8 );
+				for ( quint32 i = 0; i < nPoints; i++ ) {
+					xml.writeStartElement( "volume" );
+					writeXmlNumber( xml, "volume-position", reader.readInt() );
+					writeXmlNumber( xml, "volume-value", reader.readInt() );
+					xml.writeEndElement();
+				}
+				nPoints = reader.readCount( 8 );
+				for ( quint32 i = 0; i < nPoints; i++ ) {
+					xml.writeStartElement( "pan" );
+					writeXmlNumber( xml, "pan-position", reader.readInt() );
+					writeXmlNumber( xml, "pan-value", reader.readInt() );
+					xml.writeEndElement();
+				}
+				xml.writeEndElement();
+			}
+			xml.writeEndElement();
+		}
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+
+	// the virtual patterns and the pattern groups reference the patterns by name
+	std::vector<QString> patternNames;
+	xml.writeStartElement( "patternList" );
+	quint32 nPatterns = reader.readCount( 20 );
+	for ( quint32 nPattern = 0; nPattern < nPatterns && !reader.hasError(); nPattern++ ) {
+		QString sPatternName = reader.readString();
+		QString sInfo = reader.readString();
+		QString sCategory = reader.readString();
+		int nLength = reader.readInt();
+		patternNames.push_back( sPatternName );
+		xml.writeStartElement( "pattern" );
+		xml.writeTextElement( "name", sPatternName );
+		xml.writeTextElement( "category", sCategory );
+		writeXmlNumber( xml, "size", nLength );
+		xml.writeTextElement( "info", sInfo );
+
+		xml.writeStartElement( "noteList" );
+		quint32 nNotes = reader.readCount( NOTE_SIZE );
+		const unsigned char* pRecord = reader.readBytes( nNotes * NOTE_SIZE );
+		for ( quint32 i = 0; i < nNotes && pRecord; i++, pRecord += NOTE_SIZE ) {
+			int nKey = ( signed char )pRecord[ 32 ];
+			xml.writeStartElement( "note" );
+			writeXmlNumber( xml, "position", ( qint32 )readDWord( pRecord ) );
+			writeXmlNumber( xml, "leadlag", readFloat( pRecord + 20 ) );
+			writeXmlNumber( xml, "velocity", readFloat( pRecord + 8 ) );
+			writeXmlNumber( xml, "pan_L", readFloat( pRecord + 12 ) );
+			writeXmlNumber( xml, "pan_R", readFloat( pRecord + 16 ) );
+			writeXmlNumber( xml, "pitch", readFloat( pRecord + 24 ) );
+			xml.writeTextElement( "key", QString( "%1%2" ).arg( KEY_STRINGS[ nKey >= 0 && nKey < 12 ? nKey : 0 ] )
+								  .arg( ( int )( signed char )pRecord[ 33 ] ) );
+			writeXmlNumber( xml, "length", ( qint32 )readDWord( pRecord + 28 ) );
+			writeXmlNumber( xml, "instrument", ( qint32 )readDWord( pRecord + 4 ) );
+			writeXmlBool( xml, "note_off", pRecord[ 34 ] != 0 );
+			xml.writeEndElement();
+
+			if ( bReportProgress && ( i % 1024 ) == 0 ) {
+				int nPercent = ( pRecord - pBytes ) * 100 / nStringsOffset;
+				if ( nPercent > nProgress ) {
+					nProgress = nPercent;
+					EventQueue::get_instance()->push_event( EVENT_PROGRESS, nProgress );
+				}
+			}
+		}
+		xml.writeEndElement();
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+
+	xml.writeStartElement( "virtualPatternList" );
+	for ( unsigned nPattern = 0; nPattern < patternNames.size() && !reader.hasError(); nPattern++ ) {
+		quint32 nVirtuals = reader.readCount( 4 );
+		if ( nVirtuals == 0 ) {
+			continue;
+		}
+		xml.writeStartElement( "pattern" );
+		xml.writeTextElement( "name", patternNames[ nPattern ] );
+		for ( quint32 i = 0; i < nVirtuals; i++ ) {
+			quint32 nIndex = reader.readDWord();
+			if ( nIndex < patternNames.size() ) {
+				xml.writeTextElement( "virtual", patternNames[ nIndex ] );
+			}
+		}
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+
+	xml.writeStartElement( "patternSequence" );
+	quint32 nColumns = reader.readCount( 4 );
+	for ( quint32 nColumn = 0; nColumn < nColumns && !reader.hasError(); nColumn++ ) {
+		xml.writeStartElement( "group" );
+		quint32 nColumnPatterns = reader.readCount( 4 );
+		for ( quint32 i = 0; i < nColumnPatterns; i++ ) {
+			quint32 nIndex = reader.readDWord();
+			if ( nIndex < patternNames.size() ) {
+				xml.writeTextElement( "patternID", patternNames[ nIndex ] );
+			}
+		}
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+
+	xml.writeStartElement( "ladspa" );
+	quint32 nFXs = reader.readCount( 17 );
+	for ( quint32 nFX = 0; nFX < nFXs && !reader.hasError(); nFX++ ) {
+		xml.writeStartElement( "fx" );
+		xml.writeTextElement( "name", reader.readString() );
+		xml.writeTextElement( "filename", reader.readString() );
+		writeXmlBool( xml, "enabled", reader.readBool() );
+		writeXmlNumber( xml, "volume", reader.readFloat() );
+		quint32 nPorts = reader.readCount( 8 );
+		for ( quint32 nPort = 0; nPort < nPorts; nPort++ ) {
+			xml.writeStartElement( "inputControlPort" );
+			xml.writeTextElement( "name", reader.readString() );
+			writeXmlNumber( xml, "value", reader.readFloat() );
+			xml.writeEndElement();
+		}
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+
+	xml.writeStartElement( "BPMTimeLine" );
+	quint32 nBpms = reader.readCount( 8 );
+	for ( quint32 i = 0; i < nBpms; i++ ) {
+		xml.writeStartElement( "newBPM" );
+		writeXmlNumber( xml, "BAR", reader.readInt() );
+		writeXmlNumber( xml, "BPM", reader.readFloat() );
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+
+	xml.writeStartElement( "timeLineTag" );
+	quint32 nTags = reader.readCount( 8 );
+	for ( quint32 i = 0; i < nTags; i++ ) {
+		xml.writeStartElement( "newTAG" );
+		writeXmlNumber( xml, "BAR", reader.readInt() );
+		xml.writeTextElement( "TAG", reader.readString() );
+		xml.writeEndElement();
+	}
+	xml.writeEndElement();
+
+	xml.writeEndElement();
+	xml.writeEndDocument();
+
+	if ( reader.hasError() ) {
+		_ERRORLOG( "Corrupted song snapshot: truncated tables" );
+		return QByteArray();
+	}
+	if ( bReportProgress ) {
+		EventQueue::get_instance()->push_event( EVENT_PROGRESS, 100 );
+	}
+	return data;
+}
+
+};
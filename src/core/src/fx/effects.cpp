@@ -26,11 +26,17 @@
 #include <hydrogen/Preferences.h>
 #include <hydrogen/fx/LadspaFX.h>
 #include <hydrogen/audio_engine.h>
+#include <hydrogen/basics/instrument.h>
+#ifdef H2CORE_HAVE_LV2
+#include <hydrogen/fx/Lv2FX.h>
+#endif
 
 #include <algorithm>
 #include <QDir>
 #include <QLibrary>
+#include <QThread>
 #include <cassert>
+#include <sched.h>
 
 #ifdef H2CORE_HAVE_LRDF
 #include <lrdf.h>
@@ -45,16 +51,42 @@ namespace H2Core
 Effects* Effects::__instance = NULL;
 const char* Effects::__class_name = "Effects";
 
+/// busy loops of the audio thread on the FX workers before it yields the CPU
+const int FX_SPIN_COUNT = 4000;
+
+void* effectsWorker_thread( void* param )
+{
+	Effects* pEffects = ( Effects* )param;
+	pEffects->workerLoop();
+	pthread_exit( NULL );
+	return NULL;
+}
+
 Effects::Effects()
 		: Object( __class_name )
 		, m_pRootGroup( NULL )
 		, m_pRecentGroup( NULL )
+		, m_nSlots( MAX_FX )
+		, m_nWorkers( 0 )
+		, m_nSchedPolicy( SCHED_OTHER )
+		, m_nSchedPriority( 0 )
+		, m_nGeneration( 0 )
+		, m_nBusyWorkers( 0 )
+		, m_bQuitWorkers( false )
+		, m_nJobs( 0 )
+		, m_nJobFrames( 0 )
 {
 	__instance = this;
 
-	for ( int nFX = 0; nFX < MAX_FX; ++nFX ) {
-		m_FXList[ nFX ] = NULL;
-	}
+	pthread_mutex_init( &m_workMutex, NULL );
+	pthread_cond_init( &m_workCond, NULL );
+
+	m_nSlots = std::max( 1, std::min( Preferences::get_instance()->m_nFXSlots, FX_SLOTS_MAX ) );
+	INFOLOG( QString( "Using %1 FX slots" ).arg( m_nSlots ) );
+	m_FXList.assign( m_nSlots, ( LadspaFX* )NULL );
+	m_workers.resize( m_nSlots - 1 );
+	m_jobs.assign( m_nSlots, ( LadspaFX* )NULL );
+	Instrument::set_fx_slots( m_nSlots );
 
 	getPluginList();
 }
@@ -74,6 +106,7 @@ void Effects::create_instance()
 Effects::~Effects()
 {
 	//INFOLOG( "DESTROY" );
+	stopWorkers();
 	if ( m_pRootGroup != NULL ) delete m_pRootGroup;
 
 	//INFOLOG( "destroying " + to_string( m_pluginList.size() ) + " LADSPA plugins" );
@@ -82,16 +115,21 @@ Effects::~Effects()
 	}
 	m_pluginList.clear();
 
-	for ( int nFX = 0; nFX < MAX_FX; ++nFX ) {
+	for ( int nFX = 0; nFX < m_nSlots; ++nFX ) {
 		delete m_FXList[ nFX ];
 	}
+
+	pthread_cond_destroy( &m_workCond );
+	pthread_mutex_destroy( &m_workMutex );
 }
 
 
 
 LadspaFX* Effects::getLadspaFX( int nFX )
 {
-	assert( nFX < MAX_FX );
+	if ( nFX < 0 || nFX >= m_nSlots ) {
+		return NULL;
+	}
 	return m_FXList[ nFX ];
 }
 
@@ -99,7 +137,11 @@ LadspaFX* Effects::getLadspaFX( int nFX )
 
 void  Effects::setLadspaFX( LadspaFX* pFX, int nFX )
 {
-	assert( nFX < MAX_FX );
+	if ( nFX < 0 || nFX >= m_nSlots ) {
+		ERRORLOG( QString( "FX slot %1 out of range, %2 slots in use" ).arg( nFX ).arg( m_nSlots ) );
+		delete pFX;
+		return;
+	}
 	//INFOLOG( "[setLadspaFX] FX: " + pFX->getPluginLabel() + ", " + to_string( nFX ) );
 
 	AudioEngine::get_instance()->lock( RIGHT_HERE );
@@ -119,6 +161,180 @@ void  Effects::setLadspaFX( LadspaFX* pFX, int nFX )
 
 
 	AudioEngine::get_instance()->unlock();
+
+	if ( pFX != NULL ) {
+		startWorkers();
+	}
+}
+
+
+
+void Effects::clearBuffers( unsigned nFrames )
+{
+	for ( int nFX = 0; nFX < m_nSlots; ++nFX ) {
+		if ( m_FXList[ nFX ] ) {
+			m_FXList[ nFX ]->clearBuffers( nFrames );
+		}
+	}
+}
+
+
+
+void Effects::processFX( unsigned nFrames )
+{
+	int nJobs = 0;
+	for ( int nFX = 0; nFX < m_nSlots; ++nFX ) {
+		LadspaFX* pFX = m_FXList[ nFX ];
+		if ( ( pFX ) && ( pFX->isEnabled() ) ) {
+			++nJobs;
+		}
+	}
+
+	// the audio thread never waits for the mutex: when a worker holds it,
+	// or is still leaving the last cycle, the plugins are run inline.
+	bool bDispatch = ( nJobs >= 2 && m_nWorkers > 0 );
+	if ( bDispatch ) {
+		updateWorkersPriority();
+		if ( pthread_mutex_trylock( &m_workMutex ) != 0 ) {
+			bDispatch = false;
+		} else if ( m_nBusyWorkers > 0 ) {
+			pthread_mutex_unlock( &m_workMutex );
+			bDispatch = false;
+		}
+	}
+
+	if ( !bDispatch ) {
+		for ( int nFX = 0; nFX < m_nSlots; ++nFX ) {
+			LadspaFX* pFX = m_FXList[ nFX ];
+			if ( ( pFX ) && ( pFX->isEnabled() ) ) {
+				pFX->processFX( nFrames );
+			}
+		}
+		return;
+	}
+
+	// no worker is in runJobs(), the jobs can be rewritten
+	nJobs = 0;
+	for ( int nFX = 0; nFX < m_nSlots; ++nFX ) {
+		LadspaFX* pFX = m_FXList[ nFX ];
+		if ( ( pFX ) && ( pFX->isEnabled() ) ) {
+			m_jobs[ nJobs++ ] = pFX;
+		}
+	}
+	m_nJobs = nJobs;
+	m_nJobFrames = nFrames;
+	m_nDoneJobs = 0;
+	m_nNextJob = 0;
+	++m_nGeneration;
+	pthread_cond_broadcast( &m_workCond );
+	pthread_mutex_unlock( &m_workMutex );
+
+	runJobs();
+
+	// the jobs left are already running in the workers: spin on their
+	// completion for a while, then yield the CPU to them.
+	int nSpins = 0;
+	while ( m_nDoneJobs.fetchAndAddOrdered( 0 ) < nJobs ) {
+		if ( ++nSpins > FX_SPIN_COUNT ) {
+			sched_yield();
+		}
+	}
+}
+
+
+
+void Effects::runJobs()
+{
+	int nJob;
+	while ( ( nJob = m_nNextJob.fetchAndAddOrdered( 1 ) ) < m_nJobs ) {
+		m_jobs[ nJob ]->processFX( m_nJobFrames );
+		m_nDoneJobs.fetchAndAddOrdered( 1 );
+	}
+}
+
+
+
+void Effects::workerLoop()
+{
+	unsigned nGeneration = 0;
+	pthread_mutex_lock( &m_workMutex );
+	while ( !m_bQuitWorkers ) {
+		if ( nGeneration == m_nGeneration ) {
+			pthread_cond_wait( &m_workCond, &m_workMutex );
+			continue;
+		}
+		nGeneration = m_nGeneration;
+		++m_nBusyWorkers;
+		pthread_mutex_unlock( &m_workMutex );
+
+		runJobs();
+
+		pthread_mutex_lock( &m_workMutex );
+		--m_nBusyWorkers;
+	}
+	pthread_mutex_unlock( &m_workMutex );
+}
+
+
+
+void Effects::startWorkers()
+{
+	if ( m_nWorkers > 0 ) {
+		return;
+	}
+
+	// the calling (audio) thread processes one slot itself, and more
+	// workers than cores would only preempt each other
+	int nCores = QThread::idealThreadCount();
+	int nWorkers = std::min( m_nSlots, nCores > 0 ? nCores : m_nSlots ) - 1;
+	for ( int i = 0; i < nWorkers; ++i ) {
+		pthread_attr_t attr;
+		pthread_attr_init( &attr );
+		if ( pthread_create( &m_workers[ m_nWorkers ], &attr, effectsWorker_thread, this ) != 0 ) {
+			ERRORLOG( "Error creating FX worker thread" );
+			pthread_attr_destroy( &attr );
+			break;
+		}
+		pthread_attr_destroy( &attr );
+		++m_nWorkers;
+	}
+	INFOLOG( QString( "Started %1 FX worker threads" ).arg( m_nWorkers ) );
+}
+
+
+
+void Effects::stopWorkers()
+{
+	pthread_mutex_lock( &m_workMutex );
+	m_bQuitWorkers = true;
+	pthread_cond_broadcast( &m_workCond );
+	pthread_mutex_unlock( &m_workMutex );
+
+	for ( int i = 0; i < m_nWorkers; ++i ) {
+		pthread_join( m_workers[ i ], NULL );
+	}
+	m_nWorkers = 0;
+}
+
+
+
+/// The workers are woken by the audio thread and it waits for them,
+/// so they have to run with its scheduling class.
+void Effects::updateWorkersPriority()
+{
+	int nPolicy;
+	struct sched_param param;
+	if ( pthread_getschedparam( pthread_self(), &nPolicy, &param ) != 0 ) {
+		return;
+	}
+	if ( nPolicy == m_nSchedPolicy && param.sched_priority == m_nSchedPriority ) {
+		return;
+	}
+	m_nSchedPolicy = nPolicy;
+	m_nSchedPriority = param.sched_priority;
+	for ( int i = 0; i < m_nWorkers; ++i ) {
+		pthread_setschedparam( m_workers[ i ], nPolicy, &param );
+	}
 }
 
 
@@ -219,6 +435,13 @@ std::vector<LadspaFXInfo*> Effects::getPluginList()
 	}
 
 	INFOLOG( QString( "Loaded %1 LADSPA plugins" ).arg( m_pluginList.size() ) );
+
+#ifdef H2CORE_HAVE_LV2
+	unsigned nLadspa = m_pluginList.size();
+	Lv2FX::getPluginList( m_pluginList );
+	INFOLOG( QString( "Loaded %1 LV2 plugins" ).arg( m_pluginList.size() - nLadspa ) );
+#endif
+
 	std::sort( m_pluginList.begin(), m_pluginList.end(), LadspaFXInfo::alphabeticOrder );
 	return m_pluginList;
 }
@@ -261,6 +484,16 @@ LadspaFXGroup* Effects::getLadspaFXGroup()
 	}
 
 
+#ifdef H2CORE_HAVE_LV2
+	LadspaFXGroup *pLv2Group = new LadspaFXGroup( "LV2" );
+	m_pRootGroup->addChild( pLv2Group );
+	for ( std::vector<LadspaFXInfo*>::iterator i = m_pluginList.begin(); i < m_pluginList.end(); i++ ) {
+		if ( Lv2FX::isLv2Path( (*i)->m_sFilename ) ) {
+			pLv2Group->addLadspaInfo( *i );
+		}
+	}
+#endif
+
 #ifdef H2CORE_HAVE_LRDF
 	LadspaFXGroup *pLRDFGroup = new LadspaFXGroup( "Categorized(LRDF)" );
 	m_pRootGroup->addChild( pLRDFGroup );
@@ -24,11 +24,16 @@
 
 #ifdef H2CORE_HAVE_LADSPA
 #include <hydrogen/Preferences.h>
+#include <hydrogen/helpers/dsp.h>
+#ifdef H2CORE_HAVE_LV2
+#include <hydrogen/fx/Lv2FX.h>
+#endif
 
 #include <QDir>
 
 #include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <vector>
 using namespace std;
 
@@ -121,8 +126,8 @@ bool LadspaFXInfo::alphabeticOrder( LadspaFXInfo* a, LadspaFXInfo* b )
 const char* LadspaFX::__class_name = "LadspaFX";
 
 // ctor
-LadspaFX::LadspaFX( const QString& sLibraryPath, const QString& sPluginLabel )
-		: Object( __class_name )
+LadspaFX::LadspaFX( const QString& sLibraryPath, const QString& sPluginLabel, const char* sClassName )
+		: Object( sClassName )
 //, m_nBufferSize( 0 )
 		, m_pBuffer_L( NULL )
 		, m_pBuffer_R( NULL )
@@ -135,6 +140,11 @@ LadspaFX::LadspaFX( const QString& sLibraryPath, const QString& sPluginLabel )
 		, m_d( NULL )
 		, m_handle( NULL )
 		, m_fVolume( 1.0f )
+		, m_nSampleRate( 0 )
+		, m_bInputActive( false )
+		, m_bOutputActive( false )
+		, m_bBufferDirty( true )
+		, m_nSilentFrames( 0 )
 		, m_nICPorts( 0 )
 		, m_nOCPorts( 0 )
 		, m_nIAPorts( 0 )
@@ -198,6 +208,12 @@ LadspaFX::~LadspaFX()
 // Static
 LadspaFX* LadspaFX::load( const QString& sLibraryPath, const QString& sPluginLabel, long nSampleRate )
 {
+#ifdef H2CORE_HAVE_LV2
+	if ( Lv2FX::isLv2Path( sLibraryPath ) ) {
+		return Lv2FX::load( sLibraryPath, nSampleRate );
+	}
+#endif
+
 	LadspaFX* pFX = new LadspaFX( sLibraryPath, sPluginLabel );
 
 	_INFOLOG( "INIT - " + sLibraryPath + " - " + sPluginLabel );
@@ -253,6 +269,7 @@ LadspaFX* LadspaFX::load( const QString& sLibraryPath, const QString& sPluginLab
 
 	//pFX->infoLog( "[LadspaFX::load] instantiate " + pFX->getPluginName() );
 	pFX->m_handle = pFX->m_d->instantiate( pFX->m_d, nSampleRate );
+	pFX->m_nSampleRate = nSampleRate;
 
 	for ( unsigned nPort = 0; nPort < pFX->m_d->PortCount; nPort++ ) {
 		LADSPA_PortDescriptor pd = pFX->m_d->PortDescriptors[ nPort ];
@@ -417,16 +434,52 @@ void LadspaFX::connectAudioPorts( float* pIn_L, float* pIn_R, float* pOut_L, flo
 
 
 
-void LadspaFX::processFX( unsigned nFrames )
+bool LadspaFX::processFX( unsigned nFrames )
 {
 //	infoLog( "[LadspaFX::applyFX()]" );
+	bool bInputActive = m_bInputActive;
+	m_bInputActive = false;
+
+	// Nothing was sent to the plugin and its tail has decayed for at
+	// least a second: the (in place) buffers are already silent.
+	if ( !bInputActive && m_nSilentFrames > m_nSampleRate ) {
+		m_bOutputActive = false;
+		return false;
+	}
+
+	runPlugin( nFrames );
+	m_bBufferDirty = true;
+	m_bOutputActive = true;
+
+	if ( !bInputActive
+	  && DSP::is_silent( m_pBuffer_L, nFrames )
+	  && ( m_pluginType != STEREO_FX || DSP::is_silent( m_pBuffer_R, nFrames ) ) ) {
+		m_nSilentFrames += nFrames;
+	} else {
+		m_nSilentFrames = 0;
+	}
+	return true;
+}
+
+void LadspaFX::runPlugin( unsigned nFrames )
+{
 	if( m_bActivated )
 	m_d->run( m_handle, nFrames );
 }
 
+void LadspaFX::clearBuffers( unsigned nFrames )
+{
+	if ( m_bBufferDirty ) {
+		memset( m_pBuffer_L, 0, nFrames * sizeof( float ) );
+		memset( m_pBuffer_R, 0, nFrames * sizeof( float ) );
+		m_bBufferDirty = false;
+	}
+}
+
 void LadspaFX::activate()
 {
-	if ( m_d->activate ) {
+	m_nSilentFrames = 0;
+	if ( m_d && m_d->activate ) {
 		INFOLOG( "activate " + getPluginName() );
 		m_bActivated = true;
 		m_d->activate( m_handle );
@@ -436,7 +489,7 @@ void LadspaFX::activate()
 
 void LadspaFX::deactivate()
 {
-	if ( m_d->deactivate && m_bActivated ) {
+	if ( m_d && m_d->deactivate && m_bActivated ) {
 		INFOLOG( "deactivate " + getPluginName() );
 		m_bActivated = false;
 		m_d->deactivate( m_handle );
@@ -0,0 +1,728 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/fx/Lv2FX.h>
+
+#if defined(H2CORE_HAVE_LADSPA) && defined(H2CORE_HAVE_LV2)
+
+#include <lv2/lv2plug.in/ns/lv2core/lv2.h>
+#include <lv2/lv2plug.in/ns/ext/atom/forge.h>
+#include <lv2/lv2plug.in/ns/ext/atom/util.h>
+#include <lv2/lv2plug.in/ns/ext/buf-size/buf-size.h>
+#include <lv2/lv2plug.in/ns/ext/patch/patch.h>
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sys/time.h>
+
+namespace H2Core
+{
+
+#define LV2_ATOM_BUFFER_SIZE	8192
+#define LV2_RING_SIZE			65536	// must be a power of two
+#define LV2_MAX_MESSAGE_SIZE	4096
+
+/**
+ * Single reader, single writer message queue.
+ * Each message is stored as its size followed by its data; a message
+ * is written completely or not at all.
+ */
+class Lv2Ring
+{
+public:
+	Lv2Ring()
+		: m_nRead( 0 )
+		, m_nWrite( 0 ) {
+		m_pData = new char[ LV2_RING_SIZE ];
+	}
+	~Lv2Ring() {
+		delete[] m_pData;
+	}
+
+	bool write( uint32_t nSize, const void* pData ) {
+		if ( nSize > LV2_MAX_MESSAGE_SIZE ) {
+			return false;
+		}
+		unsigned nWrite = ( unsigned )( int )m_nWrite;
+		unsigned nUsed = nWrite - ( unsigned )( int )m_nRead;
+		if ( LV2_RING_SIZE - nUsed < sizeof( nSize ) + nSize ) {
+			return false;
+		}
+		copyIn( nWrite, &nSize, sizeof( nSize ) );
+		copyIn( nWrite + sizeof( nSize ), pData, nSize );
+		m_nWrite.fetchAndStoreOrdered( ( int )( nWrite + sizeof( nSize ) + nSize ) );
+		return true;
+	}
+
+	/// \param pData has room for LV2_MAX_MESSAGE_SIZE bytes
+	bool read( void* pData, uint32_t* pSize ) {
+		unsigned nRead = ( unsigned )( int )m_nRead;
+		if ( nRead == ( unsigned )( int )m_nWrite ) {
+			return false;
+		}
+		copyOut( nRead, pSize, sizeof( *pSize ) );
+		copyOut( nRead + sizeof( *pSize ), pData, *pSize );
+		m_nRead.fetchAndStoreOrdered( ( int )( nRead + sizeof( *pSize ) + *pSize ) );
+		return true;
+	}
+
+private:
+	char* m_pData;
+	QAtomicInt m_nRead;		///< free running, wraps with unsigned arithmetic
+	QAtomicInt m_nWrite;
+
+	void copyIn( unsigned nPos, const void* pSrc, unsigned nSize ) {
+		unsigned nOffset = nPos & ( LV2_RING_SIZE - 1 );
+		unsigned nFirst = std::min( nSize, LV2_RING_SIZE - nOffset );
+		memcpy( m_pData + nOffset, pSrc, nFirst );
+		memcpy( m_pData, ( const char* )pSrc + nFirst, nSize - nFirst );
+	}
+	void copyOut( unsigned nPos, void* pDst, unsigned nSize ) {
+		unsigned nOffset = nPos & ( LV2_RING_SIZE - 1 );
+		unsigned nFirst = std::min( nSize, LV2_RING_SIZE - nOffset );
+		memcpy( pDst, m_pData + nOffset, nFirst );
+		memcpy( ( char* )pDst + nFirst, m_pData, nSize - nFirst );
+	}
+};
+
+
+
+// world and URID map, shared by all the instances
+static QMutex				__lv2_mutex;
+static LilvWorld*			__lv2_world = NULL;
+static QHash<QByteArray, LV2_URID>	__lv2_urids;
+static QList<QByteArray>	__lv2_uris;		///< URI of URID n at n-1
+
+static LilvNode*			__audio_port_node = NULL;
+static LilvNode*			__control_port_node = NULL;
+static LilvNode*			__atom_port_node = NULL;
+static LilvNode*			__input_port_node = NULL;
+static LilvNode*			__output_port_node = NULL;
+static LilvNode*			__optional_node = NULL;
+static LilvNode*			__toggled_node = NULL;
+static LilvNode*			__integer_node = NULL;
+static LilvNode*			__in_place_broken_node = NULL;
+
+/// host features accepted in lv2:requiredFeature
+static const char* __supported_features[] = {
+	LV2_URID__map,
+	LV2_URID__unmap,
+	LV2_WORKER__schedule,
+	LV2_OPTIONS__options,
+	LV2_BUF_SIZE__boundedBlockLength,
+	LV2_CORE__inPlaceBroken,
+	NULL
+};
+
+const char* Lv2FX::__class_name = "Lv2FX";
+const char* Lv2FX::URI_PREFIX = "lv2:";
+
+void* lv2Worker_thread( void* param )
+{
+	Lv2FX* pFX = ( Lv2FX* )param;
+	pFX->workerLoop();
+	pthread_exit( NULL );
+	return NULL;
+}
+
+
+
+Lv2FX::Lv2FX( const QString& sLibraryPath, const QString& sPluginURI )
+		: LadspaFX( sLibraryPath, sPluginURI, __class_name )
+		, m_pPlugin( NULL )
+		, m_pInstance( NULL )
+		, m_pWorkerInterface( NULL )
+		, m_nAtomInPort( -1 )
+		, m_nAtomOutPort( -1 )
+		, m_pAtomIn( NULL )
+		, m_pAtomOut( NULL )
+		, m_bInPlaceBroken( false )
+		, m_pOutBuffer_L( NULL )
+		, m_pOutBuffer_R( NULL )
+		, m_pOut_L( NULL )
+		, m_pOut_R( NULL )
+		, m_pAtomRequests( NULL )
+		, m_pWorkRequests( NULL )
+		, m_pWorkResponses( NULL )
+		, m_pMessageBuffer( NULL )
+		, m_bWorkerRunning( false )
+		, m_nMinBlockLength( 0 )
+		, m_nMaxBlockLength( MAX_BUFFER_SIZE )
+{
+	m_pAtomRequests = new Lv2Ring;
+	m_pWorkRequests = new Lv2Ring;
+	m_pWorkResponses = new Lv2Ring;
+	m_pMessageBuffer = new char[ LV2_MAX_MESSAGE_SIZE + sizeof( LV2_Atom_Event ) ];
+	pthread_mutex_init( &m_workerMutex, NULL );
+	pthread_cond_init( &m_workerCond, NULL );
+	initFeatures();
+}
+
+
+
+Lv2FX::~Lv2FX()
+{
+	stopWorker();
+	if ( m_pInstance ) {
+		deactivate();
+		lilv_instance_free( m_pInstance );
+	}
+	pthread_cond_destroy( &m_workerCond );
+	pthread_mutex_destroy( &m_workerMutex );
+
+	delete m_pAtomRequests;
+	delete m_pWorkRequests;
+	delete m_pWorkResponses;
+	delete[] m_pMessageBuffer;
+	free( m_pAtomIn );
+	free( m_pAtomOut );
+	delete[] m_pOutBuffer_L;
+	delete[] m_pOutBuffer_R;
+}
+
+
+
+bool Lv2FX::isLv2Path( const QString& sLibraryPath )
+{
+	return sLibraryPath.startsWith( URI_PREFIX );
+}
+
+
+
+LilvWorld* Lv2FX::world()
+{
+	QMutexLocker mx( &__lv2_mutex );
+	if ( __lv2_world == NULL ) {
+		__lv2_world = lilv_world_new();
+		lilv_world_load_all( __lv2_world );
+
+		__audio_port_node = lilv_new_uri( __lv2_world, LILV_URI_AUDIO_PORT );
+		__control_port_node = lilv_new_uri( __lv2_world, LILV_URI_CONTROL_PORT );
+		__atom_port_node = lilv_new_uri( __lv2_world, LV2_ATOM__AtomPort );
+		__input_port_node = lilv_new_uri( __lv2_world, LILV_URI_INPUT_PORT );
+		__output_port_node = lilv_new_uri( __lv2_world, LILV_URI_OUTPUT_PORT );
+		__optional_node = lilv_new_uri( __lv2_world, LV2_CORE__connectionOptional );
+		__toggled_node = lilv_new_uri( __lv2_world, LV2_CORE__toggled );
+		__integer_node = lilv_new_uri( __lv2_world, LV2_CORE__integer );
+		__in_place_broken_node = lilv_new_uri( __lv2_world, LV2_CORE__inPlaceBroken );
+	}
+	return __lv2_world;
+}
+
+
+
+LV2_URID Lv2FX::mapURI( const char* sURI )
+{
+	QMutexLocker mx( &__lv2_mutex );
+	QByteArray uri( sURI );
+	QHash<QByteArray, LV2_URID>::const_iterator it = __lv2_urids.find( uri );
+	if ( it != __lv2_urids.end() ) {
+		return it.value();
+	}
+	__lv2_uris.append( uri );
+	LV2_URID nURID = __lv2_uris.size();
+	__lv2_urids.insert( uri, nURID );
+	return nURID;
+}
+
+
+
+const char* Lv2FX::unmapURI( LV2_URID nURID )
+{
+	QMutexLocker mx( &__lv2_mutex );
+	if ( nURID == 0 || nURID > ( LV2_URID )__lv2_uris.size() ) {
+		return NULL;
+	}
+	return __lv2_uris.at( nURID - 1 ).constData();
+}
+
+
+
+LV2_URID Lv2FX::uridMap( LV2_URID_Map_Handle /*handle*/, const char* sURI )
+{
+	return mapURI( sURI );
+}
+
+
+
+const char* Lv2FX::uridUnmap( LV2_URID_Unmap_Handle /*handle*/, LV2_URID nURID )
+{
+	return unmapURI( nURID );
+}
+
+
+
+void Lv2FX::initFeatures()
+{
+	m_uridMap.handle = NULL;
+	m_uridMap.map = &Lv2FX::uridMap;
+	m_uridUnmap.handle = NULL;
+	m_uridUnmap.unmap = &Lv2FX::uridUnmap;
+	m_workerSchedule.handle = this;
+	m_workerSchedule.schedule_work = &Lv2FX::scheduleWork;
+
+	LV2_URID nIntType = mapURI( LV2_ATOM__Int );
+	LV2_Options_Option minBlock = { LV2_OPTIONS_INSTANCE, 0, mapURI( LV2_BUF_SIZE__minBlockLength ),
+									sizeof( int32_t ), nIntType, &m_nMinBlockLength };
+	LV2_Options_Option maxBlock = { LV2_OPTIONS_INSTANCE, 0, mapURI( LV2_BUF_SIZE__maxBlockLength ),
+									sizeof( int32_t ), nIntType, &m_nMaxBlockLength };
+	LV2_Options_Option end = { LV2_OPTIONS_INSTANCE, 0, 0, 0, 0, NULL };
+	m_options[ 0 ] = minBlock;
+	m_options[ 1 ] = maxBlock;
+	m_options[ 2 ] = end;
+
+	m_features[ 0 ].URI = LV2_URID__map;
+	m_features[ 0 ].data = &m_uridMap;
+	m_features[ 1 ].URI = LV2_URID__unmap;
+	m_features[ 1 ].data = &m_uridUnmap;
+	m_features[ 2 ].URI = LV2_WORKER__schedule;
+	m_features[ 2 ].data = &m_workerSchedule;
+	m_features[ 3 ].URI = LV2_OPTIONS__options;
+	m_features[ 3 ].data = m_options;
+	m_features[ 4 ].URI = LV2_BUF_SIZE__boundedBlockLength;
+	m_features[ 4 ].data = NULL;
+	for ( int i = 0; i < 5; ++i ) {
+		m_featureList[ i ] = &m_features[ i ];
+	}
+	m_featureList[ 5 ] = NULL;
+
+	m_nSequenceType = mapURI( LV2_ATOM__Sequence );
+	m_nChunkType = mapURI( LV2_ATOM__Chunk );
+	m_nPatchSet = mapURI( LV2_PATCH__Set );
+	m_nPatchProperty = mapURI( LV2_PATCH__property );
+	m_nPatchValue = mapURI( LV2_PATCH__value );
+}
+
+
+
+void Lv2FX::getPluginList( std::vector<LadspaFXInfo*>& pluginList )
+{
+	LilvWorld* pWorld = world();
+	const LilvPlugins* pPlugins = lilv_world_get_all_plugins( pWorld );
+
+	LILV_FOREACH( plugins, i, pPlugins ) {
+		const LilvPlugin* pPlugin = lilv_plugins_get( pPlugins, i );
+
+		LilvNode* pName = lilv_plugin_get_name( pPlugin );
+		if ( pName == NULL ) {
+			continue;
+		}
+		LadspaFXInfo* pFX = new LadspaFXInfo( QString::fromUtf8( lilv_node_as_string( pName ) ) );
+		lilv_node_free( pName );
+
+		QString sURI = QString::fromUtf8( lilv_node_as_uri( lilv_plugin_get_uri( pPlugin ) ) );
+		pFX->m_sFilename = URI_PREFIX + sURI;
+		pFX->m_sLabel = sURI;
+		pFX->m_sID = sURI;
+		LilvNode* pAuthor = lilv_plugin_get_author_name( pPlugin );
+		if ( pAuthor ) {
+			pFX->m_sMaker = QString::fromUtf8( lilv_node_as_string( pAuthor ) );
+			lilv_node_free( pAuthor );
+		}
+
+		for ( uint32_t nPort = 0; nPort < lilv_plugin_get_num_ports( pPlugin ); ++nPort ) {
+			const LilvPort* pPort = lilv_plugin_get_port_by_index( pPlugin, nPort );
+			bool bInput = lilv_port_is_a( pPlugin, pPort, __input_port_node );
+			if ( lilv_port_is_a( pPlugin, pPort, __audio_port_node ) ) {
+				bInput ? pFX->m_nIAPorts++ : pFX->m_nOAPorts++;
+			} else if ( lilv_port_is_a( pPlugin, pPort, __control_port_node ) ) {
+				bInput ? pFX->m_nICPorts++ : pFX->m_nOCPorts++;
+			}
+		}
+
+		if ( ( pFX->m_nIAPorts == 2 && pFX->m_nOAPorts == 2 )
+		  || ( pFX->m_nIAPorts == 1 && pFX->m_nOAPorts == 1 ) ) {
+			pluginList.push_back( pFX );
+		} else {
+			delete pFX;
+		}
+	}
+}
+
+
+
+Lv2FX* Lv2FX::load( const QString& sLibraryPath, long nSampleRate )
+{
+	QString sURI = sLibraryPath.mid( strlen( URI_PREFIX ) );
+	_INFOLOG( "INIT - " + sURI );
+
+	LilvWorld* pWorld = world();
+	LilvNode* pURI = lilv_new_uri( pWorld, sURI.toUtf8().constData() );
+	const LilvPlugin* pPlugin = lilv_plugins_get_by_uri( lilv_world_get_all_plugins( pWorld ), pURI );
+	lilv_node_free( pURI );
+	if ( pPlugin == NULL ) {
+		_ERRORLOG( "LV2 plugin not found: " + sURI );
+		return NULL;
+	}
+
+	// refuse plugins depending on features we don't provide
+	bool bSupported = true;
+	LilvNodes* pRequired = lilv_plugin_get_required_features( pPlugin );
+	LILV_FOREACH( nodes, i, pRequired ) {
+		const char* sFeature = lilv_node_as_uri( lilv_nodes_get( pRequired, i ) );
+		bool bFound = false;
+		for ( int n = 0; __supported_features[ n ]; ++n ) {
+			if ( strcmp( sFeature, __supported_features[ n ] ) == 0 ) {
+				bFound = true;
+				break;
+			}
+		}
+		if ( !bFound ) {
+			_ERRORLOG( QString( "%1 requires unsupported feature %2" ).arg( sURI ).arg( sFeature ) );
+			bSupported = false;
+		}
+	}
+	lilv_nodes_free( pRequired );
+	if ( !bSupported ) {
+		return NULL;
+	}
+
+	Lv2FX* pFX = new Lv2FX( sLibraryPath, sURI );
+	pFX->m_pPlugin = pPlugin;
+	pFX->m_nSampleRate = nSampleRate;
+
+	LilvNode* pName = lilv_plugin_get_name( pPlugin );
+	if ( pName ) {
+		pFX->setPluginName( QString::fromUtf8( lilv_node_as_string( pName ) ) );
+		lilv_node_free( pName );
+	}
+
+	pFX->m_pInstance = lilv_plugin_instantiate( pPlugin, nSampleRate, pFX->m_featureList );
+	if ( pFX->m_pInstance == NULL ) {
+		_ERRORLOG( "Error instantiating " + sURI );
+		delete pFX;
+		return NULL;
+	}
+
+	if ( !pFX->createPorts() ) {
+		delete pFX;
+		return NULL;
+	}
+
+	if ( lilv_plugin_has_feature( pPlugin, __in_place_broken_node ) ) {
+		pFX->m_bInPlaceBroken = true;
+		pFX->m_pOutBuffer_L = new float[ MAX_BUFFER_SIZE ];
+		pFX->m_pOutBuffer_R = new float[ MAX_BUFFER_SIZE ];
+		memset( pFX->m_pOutBuffer_L, 0, MAX_BUFFER_SIZE * sizeof( float ) );
+		memset( pFX->m_pOutBuffer_R, 0, MAX_BUFFER_SIZE * sizeof( float ) );
+	}
+
+	if ( pFX->m_audioInPorts.size() == 2 && pFX->m_audioOutPorts.size() == 2 ) {
+		pFX->m_pluginType = STEREO_FX;
+	} else if ( pFX->m_audioInPorts.size() == 1 && pFX->m_audioOutPorts.size() == 1 ) {
+		pFX->m_pluginType = MONO_FX;
+	} else {
+		_ERRORLOG( "Wrong number of ports" );
+		_ERRORLOG( QString( "in audio = %1" ).arg( pFX->m_audioInPorts.size() ) );
+		_ERRORLOG( QString( "out audio = %1" ).arg( pFX->m_audioOutPorts.size() ) );
+	}
+
+	pFX->m_pWorkerInterface = ( const LV2_Worker_Interface* )
+		lilv_instance_get_extension_data( pFX->m_pInstance, LV2_WORKER__interface );
+	if ( pFX->m_pWorkerInterface ) {
+		pFX->startWorker();
+	}
+
+	return pFX;
+}
+
+
+
+/// Sort the ports out and connect everything but the audio ports.
+bool Lv2FX::createPorts()
+{
+	uint32_t nPorts = lilv_plugin_get_num_ports( m_pPlugin );
+	std::vector<float> mins( nPorts ), maxes( nPorts ), defaults( nPorts );
+	lilv_plugin_get_port_ranges_float( m_pPlugin, &mins[ 0 ], &maxes[ 0 ], &defaults[ 0 ] );
+
+	for ( uint32_t nPort = 0; nPort < nPorts; ++nPort ) {
+		const LilvPort* pPort = lilv_plugin_get_port_by_index( m_pPlugin, nPort );
+		bool bInput = lilv_port_is_a( m_pPlugin, pPort, __input_port_node );
+
+		if ( lilv_port_is_a( m_pPlugin, pPort, __audio_port_node ) ) {
+			if ( bInput ) {
+				m_audioInPorts.push_back( nPort );
+				m_nIAPorts++;
+			} else {
+				m_audioOutPorts.push_back( nPort );
+				m_nOAPorts++;
+			}
+		} else if ( lilv_port_is_a( m_pPlugin, pPort, __control_port_node ) ) {
+			LilvNode* pName = lilv_port_get_name( m_pPlugin, pPort );
+			LadspaControlPort* pControl = new LadspaControlPort();
+			pControl->sName = QString::fromUtf8( lilv_node_as_string( pName ) );
+			lilv_node_free( pName );
+			pControl->fLowerBound = std::isnan( mins[ nPort ] ) ? 0.0 : mins[ nPort ];
+			pControl->fUpperBound = std::isnan( maxes[ nPort ] ) ? 1.0 : maxes[ nPort ];
+			pControl->fControlValue = std::isnan( defaults[ nPort ] ) ? pControl->fLowerBound : defaults[ nPort ];
+			pControl->isToggle = lilv_port_has_property( m_pPlugin, pPort, __toggled_node );
+			pControl->m_bIsInteger = pControl->isToggle
+									|| lilv_port_has_property( m_pPlugin, pPort, __integer_node );
+
+			if ( bInput ) {
+				inputControlPorts.push_back( pControl );
+				m_nICPorts++;
+			} else {
+				outputControlPorts.push_back( pControl );
+				m_nOCPorts++;
+			}
+			lilv_instance_connect_port( m_pInstance, nPort, &( pControl->fControlValue ) );
+		} else if ( lilv_port_is_a( m_pPlugin, pPort, __atom_port_node ) ) {
+			LV2_Atom_Sequence* pSeq = ( LV2_Atom_Sequence* )calloc( 1, LV2_ATOM_BUFFER_SIZE );
+			if ( bInput && m_nAtomInPort == -1 ) {
+				m_nAtomInPort = nPort;
+				m_pAtomIn = pSeq;
+			} else if ( !bInput && m_nAtomOutPort == -1 ) {
+				m_nAtomOutPort = nPort;
+				m_pAtomOut = pSeq;
+			} else {
+				free( pSeq );
+				pSeq = NULL;
+				if ( !lilv_port_has_property( m_pPlugin, pPort, __optional_node ) ) {
+					ERRORLOG( "too many atom ports.." );
+					return false;
+				}
+			}
+			lilv_instance_connect_port( m_pInstance, nPort, pSeq );
+		} else if ( lilv_port_has_property( m_pPlugin, pPort, __optional_node ) ) {
+			lilv_instance_connect_port( m_pInstance, nPort, NULL );
+		} else {
+			ERRORLOG( QString( "unknown port %1" ).arg( nPort ) );
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+void Lv2FX::connectAudioPorts( float* pIn_L, float* pIn_R, float* pOut_L, float* pOut_R )
+{
+	INFOLOG( "[connectAudioPorts]" );
+
+	if ( m_bInPlaceBroken ) {
+		m_pOut_L = pOut_L;
+		m_pOut_R = pOut_R;
+		pOut_L = m_pOutBuffer_L;
+		pOut_R = m_pOutBuffer_R;
+	}
+
+	for ( unsigned i = 0; i < m_audioInPorts.size() && i < 2; ++i ) {
+		lilv_instance_connect_port( m_pInstance, m_audioInPorts[ i ], i == 0 ? pIn_L : pIn_R );
+	}
+	for ( unsigned i = 0; i < m_audioOutPorts.size() && i < 2; ++i ) {
+		lilv_instance_connect_port( m_pInstance, m_audioOutPorts[ i ], i == 0 ? pOut_L : pOut_R );
+	}
+}
+
+
+
+void Lv2FX::activate()
+{
+	m_nSilentFrames = 0;
+	if ( m_pInstance && !m_bActivated ) {
+		INFOLOG( "activate " + getPluginName() );
+		m_bActivated = true;
+		lilv_instance_activate( m_pInstance );
+	}
+}
+
+
+
+void Lv2FX::deactivate()
+{
+	if ( m_pInstance && m_bActivated ) {
+		INFOLOG( "deactivate " + getPluginName() );
+		m_bActivated = false;
+		lilv_instance_deactivate( m_pInstance );
+	}
+}
+
+
+
+bool Lv2FX::setProperty( const QString& sPropertyURI, float fValue )
+{
+	if ( m_nAtomInPort == -1 ) {
+		return false;
+	}
+
+	uint8_t buffer[ 256 ];
+	LV2_Atom_Forge forge;
+	lv2_atom_forge_init( &forge, &m_uridMap );
+	lv2_atom_forge_set_buffer( &forge, buffer, sizeof( buffer ) );
+
+	LV2_Atom_Forge_Frame frame;
+	lv2_atom_forge_object( &forge, &frame, 0, m_nPatchSet );
+	lv2_atom_forge_key( &forge, m_nPatchProperty );
+	lv2_atom_forge_urid( &forge, mapURI( sPropertyURI.toUtf8().constData() ) );
+	lv2_atom_forge_key( &forge, m_nPatchValue );
+	lv2_atom_forge_float( &forge, fValue );
+	lv2_atom_forge_pop( &forge, &frame );
+
+	const LV2_Atom* pSet = ( const LV2_Atom* )buffer;
+	return m_pAtomRequests->write( lv2_atom_total_size( pSet ), pSet );
+}
+
+
+
+void Lv2FX::runPlugin( unsigned nFrames )
+{
+	if ( !m_bActivated ) {
+		return;
+	}
+
+	if ( m_pAtomIn ) {
+		lv2_atom_sequence_clear( m_pAtomIn );
+		m_pAtomIn->atom.type = m_nSequenceType;
+
+		// queued messages, all of them at the start of the cycle
+		LV2_Atom_Event* pEvent = ( LV2_Atom_Event* )m_pMessageBuffer;
+		uint32_t nSize;
+		while ( m_pAtomRequests->read( &pEvent->body, &nSize ) ) {
+			pEvent->time.frames = 0;
+			lv2_atom_sequence_append_event( m_pAtomIn, LV2_ATOM_BUFFER_SIZE - sizeof( LV2_Atom ), pEvent );
+		}
+	}
+	if ( m_pAtomOut ) {
+		m_pAtomOut->atom.type = m_nChunkType;
+		m_pAtomOut->atom.size = LV2_ATOM_BUFFER_SIZE - sizeof( LV2_Atom );
+	}
+
+	if ( m_pWorkerInterface ) {
+		LV2_Handle handle = lilv_instance_get_handle( m_pInstance );
+		uint32_t nSize;
+		while ( m_pWorkResponses->read( m_pMessageBuffer, &nSize ) ) {
+			m_pWorkerInterface->work_response( handle, nSize, m_pMessageBuffer );
+		}
+	}
+
+	lilv_instance_run( m_pInstance, nFrames );
+
+	if ( m_bInPlaceBroken ) {
+		if ( m_pOut_L ) {
+			memcpy( m_pOut_L, m_pOutBuffer_L, nFrames * sizeof( float ) );
+		}
+		if ( m_pOut_R && m_audioOutPorts.size() > 1 ) {
+			memcpy( m_pOut_R, m_pOutBuffer_R, nFrames * sizeof( float ) );
+		}
+	}
+
+	if ( m_pWorkerInterface && m_pWorkerInterface->end_run ) {
+		m_pWorkerInterface->end_run( lilv_instance_get_handle( m_pInstance ) );
+	}
+}
+
+
+
+LV2_Worker_Status Lv2FX::scheduleWork( LV2_Worker_Schedule_Handle handle, uint32_t nSize, const void* pData )
+{
+	Lv2FX* pFX = ( Lv2FX* )handle;
+	if ( !pFX->m_pWorkRequests->write( nSize, pData ) ) {
+		return LV2_WORKER_ERR_NO_SPACE;
+	}
+	// no lock here: called from the audio thread. A missed wakeup is
+	// caught by the timed wait of the worker.
+	pthread_cond_signal( &pFX->m_workerCond );
+	return LV2_WORKER_SUCCESS;
+}
+
+
+
+LV2_Worker_Status Lv2FX::respond( LV2_Worker_Respond_Handle handle, uint32_t nSize, const void* pData )
+{
+	Lv2FX* pFX = ( Lv2FX* )handle;
+	if ( !pFX->m_pWorkResponses->write( nSize, pData ) ) {
+		return LV2_WORKER_ERR_NO_SPACE;
+	}
+	return LV2_WORKER_SUCCESS;
+}
+
+
+
+void Lv2FX::startWorker()
+{
+	m_bWorkerRunning = true;
+	pthread_attr_t attr;
+	pthread_attr_init( &attr );
+	if ( pthread_create( &m_workerThread, &attr, lv2Worker_thread, this ) != 0 ) {
+		ERRORLOG( "Error creating LV2 worker thread" );
+		m_bWorkerRunning = false;
+	}
+	pthread_attr_destroy( &attr );
+}
+
+
+
+void Lv2FX::stopWorker()
+{
+	if ( !m_bWorkerRunning ) {
+		return;
+	}
+	pthread_mutex_lock( &m_workerMutex );
+	m_bWorkerRunning = false;
+	pthread_cond_signal( &m_workerCond );
+	pthread_mutex_unlock( &m_workerMutex );
+	pthread_join( m_workerThread, NULL );
+}
+
+
+
+void Lv2FX::workerLoop()
+{
+	char* pBuffer = new char[ LV2_MAX_MESSAGE_SIZE ];
+	uint32_t nSize;
+
+	pthread_mutex_lock( &m_workerMutex );
+	while ( m_bWorkerRunning ) {
+		pthread_mutex_unlock( &m_workerMutex );
+		while ( m_pWorkRequests->read( pBuffer, &nSize ) ) {
+			m_pWorkerInterface->work( lilv_instance_get_handle( m_pInstance ), &Lv2FX::respond, this, nSize, pBuffer );
+		}
+		pthread_mutex_lock( &m_workerMutex );
+		if ( m_bWorkerRunning ) {
+			struct timeval now;
+			gettimeofday( &now, NULL );
+			struct timespec timeout;
+			timeout.tv_sec = now.tv_sec;
+			timeout.tv_nsec = now.tv_usec * 1000 + 10000000;	// 10 ms
+			if ( timeout.tv_nsec >= 1000000000 ) {
+				timeout.tv_sec++;
+				timeout.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait( &m_workerCond, &m_workerMutex, &timeout );
+		}
+	}
+	pthread_mutex_unlock( &m_workerMutex );
+	delete[] pBuffer;
+}
+
+};
+
+#endif // H2CORE_HAVE_LV2
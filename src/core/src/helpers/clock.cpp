@@ -0,0 +1,261 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/helpers/clock.h>
+
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+
+#if defined(WIN32)
+#include <windows.h>
+#elif defined(Q_OS_MACX)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace H2Core
+{
+
+double Clock::now()
+{
+#if defined(WIN32)
+	static LARGE_INTEGER frequency = { 0 };
+	if ( frequency.QuadPart == 0 ) {
+		QueryPerformanceFrequency( &frequency );
+	}
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter( &counter );
+	return ( double )counter.QuadPart / ( double )frequency.QuadPart;
+#elif defined(Q_OS_MACX)
+	static mach_timebase_info_data_t timebase = { 0, 0 };
+	if ( timebase.denom == 0 ) {
+		mach_timebase_info( &timebase );
+	}
+	return mach_absolute_time() * ( double )timebase.numer / ( double )timebase.denom * 1e-9;
+#else
+	struct timespec now;
+#ifdef CLOCK_MONOTONIC_RAW
+	// not slewed by NTP, the DLL measures the soundcard against the crystal
+	clock_gettime( CLOCK_MONOTONIC_RAW, &now );
+#else
+	clock_gettime( CLOCK_MONOTONIC, &now );
+#endif
+	return now.tv_sec + now.tv_nsec * 1e-9;
+#endif
+}
+
+
+
+const char* AudioClock::__class_name = "AudioClock";
+
+AudioClock::AudioClock()
+		: Object( __class_name )
+		, m_fBandwidth( 0.5 )
+		, m_nSequence( 0 )
+		, m_nReadCount( 0 )
+		, m_nResetCount( 0 )
+{
+	reset();
+}
+
+void AudioClock::reset()
+{
+	m_fB = m_fC = 0.0;
+	m_fT0 = m_fT1 = m_fE2 = 0.0;
+	m_nFrames = 0;
+	m_nSampleRate = 0;
+	m_nFrame = 0;
+	m_bRunning = false;
+	m_fStartTime = 0.0;
+
+	m_stats.fProcessTime = 0.0f;
+	m_stats.fProcessTimeAvg = 0.0f;
+	m_stats.fProcessTimeMax = 0.0f;
+	m_stats.fPeriod = 0.0f;
+	m_stats.fJitter = 0.0f;
+	m_stats.fSampleRate = 0.0f;
+	m_stats.nLateCycles = 0;
+
+	m_state.fCycleTime = 0.0;
+	m_state.fPeriod = 0.0;
+	m_state.nCycleFrame = 0;
+	m_state.nFrames = 0;
+
+	publish();
+}
+
+void AudioClock::init( double fTime, unsigned nFrames, unsigned nSampleRate )
+{
+	m_nFrames = nFrames;
+	m_nSampleRate = nSampleRate;
+
+	m_fE2 = ( double )nFrames / nSampleRate;
+	m_fT0 = fTime;
+	m_fT1 = fTime + m_fE2;
+
+	double fOmega = 2.0 * M_PI * m_fBandwidth * m_fE2;
+	m_fB = sqrt( 2.0 ) * fOmega;
+	m_fC = fOmega * fOmega;
+
+	m_bRunning = true;
+}
+
+void AudioClock::cycleStart( double fTime, unsigned nFrames, unsigned nSampleRate )
+{
+	m_fStartTime = fTime;
+	if ( nFrames == 0 || nSampleRate == 0 ) {
+		return;
+	}
+
+	int nReadCount = m_nReadCount.fetchAndAddOrdered( 0 );
+	if ( nReadCount != m_nResetCount ) {
+		m_nResetCount = nReadCount;
+		m_stats.fProcessTimeMax = 0.0f;
+		m_stats.fJitter = 0.0f;
+	}
+
+	if ( m_bRunning ) {
+		m_nFrame += m_nFrames;
+	}
+
+	if ( !m_bRunning || nFrames != m_nFrames || nSampleRate != m_nSampleRate ) {
+		init( fTime, nFrames, nSampleRate );
+	} else {
+		double fError = fTime - m_fT1;
+		if ( fabs( fError ) > 4 * m_fE2 ) {
+			// xrun or stopped driver, the loop would take seconds to lock again
+			init( fTime, nFrames, nSampleRate );
+		} else {
+			m_fT0 = m_fT1;
+			m_fT1 += m_fB * fError + m_fE2;
+			m_fE2 += m_fC * fError;
+
+			float fJitter = fabs( fError ) * 1000.0;
+			if ( fJitter > m_stats.fJitter ) {
+				m_stats.fJitter = fJitter;
+			}
+		}
+	}
+
+	m_state.fCycleTime = m_fT0;
+	m_state.fPeriod = m_fT1 - m_fT0;
+	m_state.nCycleFrame = m_nFrame;
+	m_state.nFrames = m_nFrames;
+
+	m_stats.fPeriod = 1000.0 * nFrames / nSampleRate;
+	if ( m_stats.fSampleRate == 0.0f ) {
+		m_stats.fSampleRate = nSampleRate;
+	}
+	// one second time constant
+	double fAlpha = std::min( 1.0, m_fE2 );
+	m_stats.fSampleRate += fAlpha * ( nFrames / m_fE2 - m_stats.fSampleRate );
+
+	publish();
+}
+
+float AudioClock::cycleEnd()
+{
+	float fProcessTime = ( Clock::now() - m_fStartTime ) * 1000.0;
+
+	m_stats.fProcessTime = fProcessTime;
+	if ( fProcessTime > m_stats.fProcessTimeMax ) {
+		m_stats.fProcessTimeMax = fProcessTime;
+	}
+	if ( m_stats.fPeriod > 0.0f ) {
+		// one second time constant
+		float fAlpha = std::min( 1.0f, m_stats.fPeriod / 1000.0f );
+		m_stats.fProcessTimeAvg += fAlpha * ( fProcessTime - m_stats.fProcessTimeAvg );
+		if ( fProcessTime > m_stats.fPeriod ) {
+			++m_stats.nLateCycles;
+		}
+	}
+
+	publish();
+	return fProcessTime;
+}
+
+void AudioClock::publish()
+{
+	m_nSequence.fetchAndAddOrdered( 1 );
+	m_publishedStats = m_stats;
+	m_publishedState = m_state;
+	m_nSequence.fetchAndAddOrdered( 1 );
+}
+
+AudioClock::State AudioClock::readState()
+{
+	State state;
+	int nSequence;
+	do {
+		nSequence = m_nSequence.fetchAndAddOrdered( 0 );
+		state = m_publishedState;
+	} while ( ( nSequence & 1 ) || nSequence != m_nSequence.fetchAndAddOrdered( 0 ) );
+	return state;
+}
+
+double AudioClock::framesSinceCycleStart( double fTime )
+{
+	State state = readState();
+	if ( state.fPeriod <= 0.0 ) {
+		return 0.0;
+	}
+	return ( fTime - state.fCycleTime ) * state.nFrames / state.fPeriod;
+}
+
+double AudioClock::frameToTime( long long nFrame )
+{
+	State state = readState();
+	if ( state.nFrames == 0 ) {
+		return state.fCycleTime;
+	}
+	return state.fCycleTime + ( nFrame - state.nCycleFrame ) * state.fPeriod / state.nFrames;
+}
+
+double AudioClock::timeToFrame( double fTime )
+{
+	State state = readState();
+	if ( state.fPeriod <= 0.0 ) {
+		return state.nCycleFrame;
+	}
+	return state.nCycleFrame + ( fTime - state.fCycleTime ) * state.nFrames / state.fPeriod;
+}
+
+CycleStats AudioClock::read()
+{
+	CycleStats stats;
+	int nSequence;
+	do {
+		nSequence = m_nSequence.fetchAndAddOrdered( 0 );
+		stats = m_publishedStats;
+	} while ( ( nSequence & 1 ) || nSequence != m_nSequence.fetchAndAddOrdered( 0 ) );
+
+	m_nReadCount.fetchAndAddOrdered( 1 );
+	return stats;
+}
+
+};
@@ -0,0 +1,419 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/helpers/drumkit_archive.h>
+#include <hydrogen/config.h>
+#ifdef H2CORE_HAVE_LIBARCHIVE
+#include <archive.h>
+#include <archive_entry.h>
+#endif
+#ifdef H2CORE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <hydrogen/basics/sample.h>
+#include <hydrogen/basics/sample_pool.h>
+#include <hydrogen/helpers/worker_pool.h>
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QWaitCondition>
+#include <cstring>
+
+#define MAX_PENDING_FILES   16      ///< files read from the archive ahead of the threads writing them
+#define TAR_BLOCK           512
+#define KEPT_SAMPLES_SIZE   ( 256 * 1024 * 1024 )   ///< bytes of decoded samples kept by the SamplePool
+
+namespace H2Core
+{
+
+const char* DrumkitArchive::__class_name = "DrumkitArchive";
+
+double DrumkitArchive::Stats::throughput() const
+{
+	if ( elapsed <= 0 ) return 0.0;
+	return ( data_size / 1048576.0 ) / ( elapsed / 1000.0 );
+}
+
+#ifdef H2CORE_HAVE_LIBARCHIVE
+/** \return true if the file holds a sample, judging by its extension */
+static bool is_sample_file( const QString& filepath )
+{
+	static const char* extensions[] = { "wav", "flac", "aif", "aiff", "au", "caf", "w64", "ogg", "voc" };
+	QString suffix = QFileInfo( filepath ).suffix().toLower();
+	for ( unsigned i = 0; i < sizeof( extensions ) / sizeof( extensions[0] ); i++ ) {
+		if ( suffix == extensions[i] ) return true;
+	}
+	return false;
+}
+
+/** \return true if the path of an entry stays within the directory it is extracted to */
+static bool is_relative_path( const QString& path )
+{
+	if ( path.isEmpty() || QDir::isAbsolutePath( path ) ) return false;
+	return !path.split( "/" ).contains( ".." );
+}
+
+static void close_archive( struct archive* arch )
+{
+	archive_read_close( arch );
+#if ARCHIVE_VERSION_NUMBER < 3000000
+	archive_read_finish( arch );
+#else
+	archive_read_free( arch );
+#endif
+}
+
+/** what the jobs of an extraction share */
+struct ExtractState {
+	ExtractState() : ok( true ), keep_samples( false ), decoded( 0 ) {}
+	void fail() {
+		QMutexLocker lock( &mutex );
+		ok = false;
+	}
+	QMutex mutex;
+	bool ok;
+	bool keep_samples;
+	int decoded;
+};
+
+/** write a file of the archive, then decode it into the SamplePool if it's a sample */
+class ExtractJob : public WorkerPool::Job
+{
+	public:
+		ExtractJob( ExtractState* state, const QString& filepath, const QByteArray& content ) : __state( state ), __filepath( filepath ), __content( content ) {}
+		void run();
+	private:
+		ExtractState* __state;
+		QString __filepath;
+		QByteArray __content;
+};
+
+void ExtractJob::run()
+{
+	QFile file( __filepath );
+	if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) || file.write( __content )!=__content.size() ) {
+		___ERRORLOG( QString( "Unable to write %1: %2" ).arg( __filepath ).arg( file.errorString() ) );
+		__state->fail();
+		return;
+	}
+	file.close();
+	if ( !__state->keep_samples || !is_sample_file( __filepath ) ) return;
+	// the file exists, the data is shared under its key and kept for the drumkit to be loaded
+	Sample* sample = Sample::load( __filepath, __content );
+	if ( sample ) {
+		SamplePool::keep( sample->get_data_l(), KEPT_SAMPLES_SIZE );
+		delete sample;
+		QMutexLocker lock( &__state->mutex );
+		__state->decoded++;
+	}
+}
+#endif
+
+bool DrumkitArchive::extract( const QString& archive_path, const QString& dst_dir, Stats* stats, bool keep_samples )
+{
+#ifdef H2CORE_HAVE_LIBARCHIVE
+	_INFOLOG( QString( "Extract %1 to %2" ).arg( archive_path ).arg( dst_dir ) );
+	QElapsedTimer timer;
+	timer.start();
+
+	int r;
+	struct archive* arch = archive_read_new();
+#if ARCHIVE_VERSION_NUMBER < 3000000
+	archive_read_support_compression_all( arch );
+#else
+	archive_read_support_filter_all( arch );
+#endif
+	archive_read_support_format_all( arch );
+#if ARCHIVE_VERSION_NUMBER < 3000000
+	if ( ( r = archive_read_open_file( arch, archive_path.toLocal8Bit(), 65536 ) ) ) {
+#else
+	if ( ( r = archive_read_open_filename( arch, archive_path.toLocal8Bit(), 65536 ) ) ) {
+#endif
+		_ERRORLOG( QString( "archive_read_open_file() [%1] %2" ).arg( archive_errno( arch ) ).arg( archive_error_string( arch ) ) );
+		close_archive( arch );
+		return false;
+	}
+
+	Stats figures;
+	ExtractState state;
+	state.keep_samples = keep_samples;
+	QDir dir( dst_dir );
+	{
+		// the decompression is sequential, the files are written and decoded by the threads meanwhile
+		WorkerPool pool( 0, MAX_PENDING_FILES );
+		struct archive_entry* entry;
+		char buffer[ 65536 ];
+		while ( ( r = archive_read_next_header( arch, &entry ) ) != ARCHIVE_EOF ) {
+			if ( r == ARCHIVE_WARN ) {
+				_WARNINGLOG( QString( "archive_read_next_header() [%1] %2" ).arg( archive_errno( arch ) ).arg( archive_error_string( arch ) ) );
+			} else if ( r != ARCHIVE_OK ) {
+				_ERRORLOG( QString( "archive_read_next_header() [%1] %2" ).arg( archive_errno( arch ) ).arg( archive_error_string( arch ) ) );
+				state.fail();
+				break;
+			}
+			QString path = QString::fromUtf8( archive_entry_pathname( entry ) );
+			if ( !is_relative_path( path ) ) {
+				_ERRORLOG( QString( "%1 is out of the drumkits directory" ).arg( path ) );
+				state.fail();
+				break;
+			}
+			if ( archive_entry_filetype( entry ) == AE_IFDIR ) {
+				if ( !dir.mkpath( path ) ) {
+					_ERRORLOG( QString( "Unable to create %1" ).arg( dir.filePath( path ) ) );
+					state.fail();
+					break;
+				}
+				continue;
+			}
+			if ( archive_entry_filetype( entry ) != AE_IFREG ) {
+				_WARNINGLOG( QString( "%1 is not a regular file, skipped" ).arg( path ) );
+				continue;
+			}
+			// created here, the threads would race for the same directories
+			if ( !dir.mkpath( QFileInfo( path ).path() ) ) {
+				_ERRORLOG( QString( "Unable to create the directory of %1" ).arg( dir.filePath( path ) ) );
+				state.fail();
+				break;
+			}
+
+			QByteArray content;
+			if ( archive_entry_size_is_set( entry ) ) {
+				content.reserve( archive_entry_size( entry ) );
+			}
+			ssize_t len;
+			while ( ( len = archive_read_data( arch, buffer, sizeof( buffer ) ) ) > 0 ) {
+				content.append( buffer, len );
+			}
+			if ( len < 0 ) {
+				_ERRORLOG( QString( "archive_read_data() [%1] %2" ).arg( archive_errno( arch ) ).arg( archive_error_string( arch ) ) );
+				state.fail();
+				break;
+			}
+			figures.files++;
+			figures.data_size += content.size();
+			pool.add( new ExtractJob( &state, dir.filePath( path ), content ) );
+		}
+		pool.wait();
+	}
+	close_archive( arch );
+
+	figures.samples = state.decoded;
+	figures.archive_size = QFileInfo( archive_path ).size();
+	figures.elapsed = timer.elapsed();
+	if ( stats ) *stats = figures;
+	_INFOLOG( QString( "%1 files, %2 samples decoded, %3 MB/s" ).arg( figures.files ).arg( figures.samples ).arg( figures.throughput() ) );
+	return state.ok;
+#else
+	_ERRORLOG( "Drumkit archives are read with libarchive, which is not available" );
+	return false;
+#endif
+}
+
+#ifdef H2CORE_HAVE_ZLIB
+/** write a number in octal, zero padded, in a NUL terminated field of a tar header */
+static void tar_octal( char* field, int size, qint64 value )
+{
+	QByteArray digits = QByteArray::number( value, 8 ).rightJustified( size - 1, '0' );
+	memcpy( field, digits.constData(), size - 1 );
+	field[ size - 1 ] = 0;
+}
+
+/** \return the ustar header of a file, empty if its name doesn't fit in */
+static QByteArray tar_header( const QByteArray& name, qint64 size, qint64 mtime )
+{
+	QByteArray prefix;
+	QByteArray base = name;
+	if ( name.size() > 100 ) {
+		int slash = name.lastIndexOf( '/' );
+		if ( slash <= 0 || slash > 155 || name.size() - slash - 1 > 100 ) return QByteArray();
+		prefix = name.left( slash );
+		base = name.mid( slash + 1 );
+	}
+	// 11 octal digits
+	if ( size >= ( Q_INT64_C( 1 ) << 33 ) ) return QByteArray();
+
+	QByteArray header( TAR_BLOCK, 0 );
+	char* h = header.data();
+	memcpy( h, base.constData(), base.size() );
+	tar_octal( h + 100, 8, 0644 );          // mode
+	tar_octal( h + 108, 8, 0 );             // uid
+	tar_octal( h + 116, 8, 0 );             // gid
+	tar_octal( h + 124, 12, size );
+	tar_octal( h + 136, 12, mtime );
+	memset( h + 148, ' ', 8 );              // the checksum is computed with spaces in its field
+	h[156] = '0';                           // regular file
+	memcpy( h + 257, "ustar", 6 );
+	memcpy( h + 263, "00", 2 );
+	memcpy( h + 345, prefix.constData(), prefix.size() );
+	unsigned checksum = 0;
+	for ( int i = 0; i < TAR_BLOCK; i++ ) checksum += ( unsigned char )h[i];
+	tar_octal( h + 148, 7, checksum );      // followed by the remaining space
+	return header;
+}
+
+/** \return the data compressed in a gzip member, empty on error */
+static QByteArray gzip_member( const QByteArray& data )
+{
+	z_stream stream;
+	memset( &stream, 0, sizeof( stream ) );
+	// 15 bits window, +16 for the gzip header and trailer
+	if ( deflateInit2( &stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) return QByteArray();
+	// some versions of deflateBound() ignore the size of the gzip header
+	QByteArray member( deflateBound( &stream, data.size() ) + 64, 0 );
+	stream.next_in = ( Bytef* )data.constData();
+	stream.avail_in = data.size();
+	stream.next_out = ( Bytef* )member.data();
+	stream.avail_out = member.size();
+	int r = deflate( &stream, Z_FINISH );
+	member.resize( stream.total_out );
+	deflateEnd( &stream );
+	return ( r == Z_STREAM_END ? member : QByteArray() );
+}
+
+/** what the jobs of a creation share */
+struct CreateState {
+	CreateState( int files ) : members( files ), ready( files, false ) {}
+	QMutex mutex;
+	QWaitCondition done;                    ///< a member is ready
+	std::vector<QByteArray> members;        ///< the gzip members of the files, in order, empty on error
+	std::vector<bool> ready;
+};
+
+/** compress a file with its tar header in a gzip member */
+class CreateJob : public WorkerPool::Job
+{
+	public:
+		CreateJob( CreateState* state, int index, const QString& filepath, const QByteArray& name ) : __state( state ), __index( index ), __filepath( filepath ), __name( name ) {}
+		void run();
+	private:
+		CreateState* __state;
+		int __index;
+		QString __filepath;
+		QByteArray __name;                  ///< the name of the file within the archive
+};
+
+void CreateJob::run()
+{
+	QByteArray member;
+	QFile file( __filepath );
+	if ( file.open( QIODevice::ReadOnly ) ) {
+		QByteArray record = tar_header( __name, file.size(), QFileInfo( file ).lastModified().toTime_t() );
+		if ( record.isEmpty() ) {
+			___ERRORLOG( QString( "%1 can't be stored in a tar archive, its name or size is too long" ).arg( __filepath ) );
+		} else {
+			qint64 size = file.size();
+			record.append( file.readAll() );
+			record.append( QByteArray( ( TAR_BLOCK - size % TAR_BLOCK ) % TAR_BLOCK, 0 ) );
+			member = gzip_member( record );
+		}
+	} else {
+		___ERRORLOG( QString( "Unable to read %1: %2" ).arg( __filepath ).arg( file.errorString() ) );
+	}
+	QMutexLocker lock( &__state->mutex );
+	__state->members[ __index ] = member;
+	__state->ready[ __index ] = true;
+	__state->done.wakeAll();
+}
+
+/** wait for the member of a file and append it to the archive */
+static bool write_member( CreateState& state, int index, QFile& out )
+{
+	QByteArray member;
+	state.mutex.lock();
+	while ( !state.ready[ index ] ) {
+		state.done.wait( &state.mutex );
+	}
+	member = state.members[ index ];
+	state.members[ index ] = QByteArray();
+	state.mutex.unlock();
+	return !member.isEmpty() && out.write( member ) == member.size();
+}
+#endif
+
+bool DrumkitArchive::create( const QString& dk_dir, const QString& archive_path, Stats* stats )
+{
+#ifdef H2CORE_HAVE_ZLIB
+	_INFOLOG( QString( "Archive %1 to %2" ).arg( dk_dir ).arg( archive_path ) );
+	QElapsedTimer timer;
+	timer.start();
+
+	QDir dir( dk_dir );
+	QFileInfoList files = dir.entryInfoList( QDir::Files, QDir::Name );
+	if ( !dir.exists() || files.isEmpty() ) {
+		_ERRORLOG( QString( "No files to archive in %1" ).arg( dk_dir ) );
+		return false;
+	}
+	QFile out( archive_path );
+	if ( !out.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+		_ERRORLOG( QString( "Unable to write %1: %2" ).arg( archive_path ).arg( out.errorString() ) );
+		return false;
+	}
+
+	Stats figures;
+	CreateState state( files.size() );
+	bool ok = true;
+	{
+		WorkerPool pool;
+		// the members are written in the order of the files, as they get ready
+		int window = 2 * std::max( pool.workers(), 1 );
+		int written = 0;
+		for ( int i = 0; i < files.size() && ok; i++ ) {
+			while ( i - written >= window && ok ) {
+				ok = write_member( state, written++, out );
+			}
+			figures.data_size += files[i].size();
+			pool.add( new CreateJob( &state, i, files[i].absoluteFilePath(), ( dir.dirName() + "/" + files[i].fileName() ).toUtf8() ) );
+		}
+		while ( written < files.size() && ok ) {
+			ok = write_member( state, written++, out );
+		}
+		pool.wait();
+	}
+	// the end of the tar archive, two empty blocks
+	QByteArray end = gzip_member( QByteArray( 2 * TAR_BLOCK, 0 ) );
+	ok = ok && !end.isEmpty() && out.write( end ) == end.size();
+	out.close();
+	if ( !ok ) {
+		_ERRORLOG( QString( "Error writing %1" ).arg( archive_path ) );
+		out.remove();
+		return false;
+	}
+
+	figures.files = files.size();
+	figures.archive_size = QFileInfo( archive_path ).size();
+	figures.elapsed = timer.elapsed();
+	if ( stats ) *stats = figures;
+	_INFOLOG( QString( "%1 files, %2 bytes, %3 MB/s" ).arg( figures.files ).arg( figures.archive_size ).arg( figures.throughput() ) );
+	return true;
+#else
+	_ERRORLOG( "Drumkit archives are written with zlib, which is not available" );
+	return false;
+#endif
+}
+
+};
+
+/* vim: set softtabstop=4 expandtab: */
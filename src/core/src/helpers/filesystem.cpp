@@ -7,6 +7,11 @@
 #include <QtCore/QFileInfo>
 #include <QtCore/QCoreApplication>
 
+#include <cstdio>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
 // directories
 #define LOCAL_DATA_PATH "/data"
 #define IMG             "/img"
@@ -29,6 +34,7 @@
 #define CLICK_SAMPLE    "/click.wav"
 #define EMPTY_SAMPLE    "/emptySample.wav"
 #define EMPTY_SONG      "/DefaultSong.h2song"
+#define SOUND_LIBRARY_INDEX "/sound_library.index"
 
 // filters
 #define SONG_FILTER     "*.h2song"
@@ -180,6 +186,37 @@ bool Filesystem::write_to_file( const QString& dst, const QString& content )
 	return true;
 }
 
+bool Filesystem::write_atomic( const QString& dst, const QByteArray& data )
+{
+	// in the same directory, the rename doesn't cross file systems
+	QString tmp = dst + ".tmp";
+	QFile file( tmp );
+	if ( !file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+		ERRORLOG( QString( "unable to write to %1" ).arg( tmp ) );
+		return false;
+	}
+	bool ok = ( file.write( data ) == data.size() ) && file.flush();
+#ifndef WIN32
+	ok = ok && ( fsync( file.handle() ) == 0 );
+#endif
+	file.close();
+	if ( !ok ) {
+		ERRORLOG( QString( "unable to write to %1" ).arg( tmp ) );
+		file.remove();
+		return false;
+	}
+#ifdef WIN32
+	// rename doesn't replace an existing file
+	QFile::remove( dst );
+#endif
+	if ( rename( QFile::encodeName( tmp ).constData(), QFile::encodeName( dst ).constData() ) != 0 ) {
+		ERRORLOG( QString( "unable to rename %1 to %2" ).arg( tmp ).arg( dst ) );
+		file.remove();
+		return false;
+	}
+	return true;
+}
+
 bool Filesystem::file_copy( const QString& src, const QString& dst, bool overwrite )
 {
 	if( file_exists( dst, true ) && !overwrite ) {
@@ -329,6 +366,10 @@ QString Filesystem::usr_click_file()
 	if( file_readable( __usr_data_path + CLICK_SAMPLE, true ) ) return __usr_data_path + CLICK_SAMPLE;
 	return click_file();
 }
+QString Filesystem::sound_library_index()
+{
+	return __usr_data_path + CACHE + SOUND_LIBRARY_INDEX;
+}
 QString Filesystem::drumkit_xsd( )
 {
 	return xsd_dir() + "/" + DRUMKIT_XSD;
@@ -0,0 +1,298 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/helpers/meter.h>
+#include <hydrogen/helpers/dsp.h>
+#include <hydrogen/globals.h>
+
+#include <algorithm>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace H2Core
+{
+
+const char* Meter::__class_name = "Meter";
+const float Meter::LUFS_FLOOR = -70.0f;
+
+Meter::Meter()
+		: Object( __class_name )
+		, m_nSampleRate( 0 )
+		, m_nSequence( 0 )
+		, m_nReadCount( 0 )
+		, m_nResetCount( 0 )
+{
+	m_pHistory_L = new float[ TP_TAPS - 1 + MAX_BUFFER_SIZE ];
+	m_pHistory_R = new float[ TP_TAPS - 1 + MAX_BUFFER_SIZE ];
+
+	// 4x interpolator for the true peak: windowed sinc cut at the
+	// original Nyquist frequency, split in phases of TP_TAPS taps.
+	const int nLength = TP_TAPS * TP_PHASES;
+	const double fCenter = ( nLength - 1 ) / 2.0;
+	for ( int nPhase = 0; nPhase < TP_PHASES; ++nPhase ) {
+		double fSum = 0.0;
+		for ( int nTap = 0; nTap < TP_TAPS; ++nTap ) {
+			int n = nTap * TP_PHASES + nPhase;
+			double x = ( n - fCenter ) / TP_PHASES;
+			double fSinc = ( x == 0.0 ) ? 1.0 : sin( M_PI * x ) / ( M_PI * x );
+			double fWindow = 0.5 - 0.5 * cos( 2.0 * M_PI * ( n + 1 ) / ( nLength + 1 ) );
+			m_fTruePeakCoeffs[ nTap ][ nPhase ] = fSinc * fWindow;
+			fSum += fSinc * fWindow;
+		}
+		for ( int nTap = 0; nTap < TP_TAPS; ++nTap ) {
+			m_fTruePeakCoeffs[ nTap ][ nPhase ] /= fSum;
+		}
+	}
+
+	setSampleRate( 44100 );
+}
+
+
+
+Meter::~Meter()
+{
+	delete[] m_pHistory_L;
+	delete[] m_pHistory_R;
+}
+
+
+
+void Meter::reset()
+{
+	memset( m_pHistory_L, 0, ( TP_TAPS - 1 ) * sizeof( float ) );
+	memset( m_pHistory_R, 0, ( TP_TAPS - 1 ) * sizeof( float ) );
+	for ( int i = 0; i < 2; ++i ) {
+		m_shelf[ i ].z1 = m_shelf[ i ].z2 = 0.0;
+		m_highPass[ i ].z1 = m_highPass[ i ].z2 = 0.0;
+	}
+
+	m_nBlockFrames = 0;
+	m_fBlockLoudness = 0.0;
+	m_fBlockSquares_L = 0.0;
+	m_fBlockSquares_R = 0.0;
+	memset( m_loudnessBlocks, 0, sizeof( m_loudnessBlocks ) );
+	memset( m_squareBlocks_L, 0, sizeof( m_squareBlocks_L ) );
+	memset( m_squareBlocks_R, 0, sizeof( m_squareBlocks_R ) );
+	m_nBlocks = 0;
+	m_nBlockPos = 0;
+
+	memset( &m_values, 0, sizeof( m_values ) );
+	m_values.fLufs = LUFS_FLOOR;
+
+	m_nSequence.fetchAndAddOrdered( 1 );
+	m_published = m_values;
+	m_nSequence.fetchAndAddOrdered( 1 );
+}
+
+
+
+/// K-weighting filters of ITU-R BS.1770, computed for the sample rate.
+void Meter::setSampleRate( unsigned nSampleRate )
+{
+	m_nSampleRate = nSampleRate;
+	m_nBlockSize = nSampleRate / 10;
+
+	double f0 = 1681.974450955533;
+	double G = 3.999843853973347;
+	double Q = 0.7071752369554196;
+	double K = tan( M_PI * f0 / nSampleRate );
+	double Vh = pow( 10.0, G / 20.0 );
+	double Vb = pow( Vh, 0.4996667741545416 );
+	double a0 = 1.0 + K / Q + K * K;
+	Biquad shelf;
+	shelf.b0 = ( Vh + Vb * K / Q + K * K ) / a0;
+	shelf.b1 = 2.0 * ( K * K - Vh ) / a0;
+	shelf.b2 = ( Vh - Vb * K / Q + K * K ) / a0;
+	shelf.a1 = 2.0 * ( K * K - 1.0 ) / a0;
+	shelf.a2 = ( 1.0 - K / Q + K * K ) / a0;
+
+	f0 = 38.13547087602444;
+	Q = 0.5003270373238773;
+	K = tan( M_PI * f0 / nSampleRate );
+	a0 = 1.0 + K / Q + K * K;
+	Biquad highPass;
+	highPass.b0 = 1.0;
+	highPass.b1 = -2.0;
+	highPass.b2 = 1.0;
+	highPass.a1 = 2.0 * ( K * K - 1.0 ) / a0;
+	highPass.a2 = ( 1.0 - K / Q + K * K ) / a0;
+
+	for ( int i = 0; i < 2; ++i ) {
+		m_shelf[ i ] = shelf;
+		m_highPass[ i ] = highPass;
+	}
+	reset();
+}
+
+
+
+static inline void flush_denormals( double& z )
+{
+	if ( fabs( z ) < 1.0e-20 ) {
+		z = 0.0;
+	}
+}
+
+
+
+void Meter::process( const float* pBuf_L, const float* pBuf_R, unsigned nFrames, unsigned nSampleRate )
+{
+	if ( nSampleRate != m_nSampleRate && nSampleRate > 0 ) {
+		setSampleRate( nSampleRate );
+	}
+
+	// the GUI took the peaks, start over
+	int nReadCount = m_nReadCount.fetchAndAddOrdered( 0 );
+	if ( nReadCount != m_nResetCount ) {
+		m_nResetCount = nReadCount;
+		m_values.fPeak_L = m_values.fPeak_R = 0.0f;
+		m_values.fTruePeak_L = m_values.fTruePeak_R = 0.0f;
+	}
+
+	m_values.fPeak_L = DSP::abs_peak( pBuf_L, nFrames, m_values.fPeak_L );
+	m_values.fPeak_R = DSP::abs_peak( pBuf_R, nFrames, m_values.fPeak_R );
+	processTruePeak( m_pHistory_L, pBuf_L, nFrames, m_values.fTruePeak_L );
+	processTruePeak( m_pHistory_R, pBuf_R, nFrames, m_values.fTruePeak_R );
+	m_values.fTruePeak_L = std::max( m_values.fTruePeak_L, m_values.fPeak_L );
+	m_values.fTruePeak_R = std::max( m_values.fTruePeak_R, m_values.fPeak_R );
+
+	for ( unsigned i = 0; i < nFrames; ++i ) {
+		double fVal_L = pBuf_L[ i ];
+		double fVal_R = pBuf_R[ i ];
+		m_fBlockSquares_L += fVal_L * fVal_L;
+		m_fBlockSquares_R += fVal_R * fVal_R;
+
+		double fK_L = m_highPass[ 0 ].process( m_shelf[ 0 ].process( fVal_L ) );
+		double fK_R = m_highPass[ 1 ].process( m_shelf[ 1 ].process( fVal_R ) );
+		m_fBlockLoudness += fK_L * fK_L + fK_R * fK_R;
+
+		if ( ++m_nBlockFrames == m_nBlockSize ) {
+			endBlock();
+		}
+	}
+	for ( int i = 0; i < 2; ++i ) {
+		flush_denormals( m_shelf[ i ].z1 );
+		flush_denormals( m_shelf[ i ].z2 );
+		flush_denormals( m_highPass[ i ].z1 );
+		flush_denormals( m_highPass[ i ].z2 );
+	}
+
+	m_nSequence.fetchAndAddOrdered( 1 );
+	m_published = m_values;
+	m_nSequence.fetchAndAddOrdered( 1 );
+}
+
+
+
+void Meter::processTruePeak( float* pHistory, const float* pBuf, unsigned nFrames, float& fTruePeak )
+{
+	while ( nFrames > 0 ) {
+		unsigned nChunk = std::min( nFrames, ( unsigned )MAX_BUFFER_SIZE );
+		float* pSamples = pHistory + TP_TAPS - 1;
+		memcpy( pSamples, pBuf, nChunk * sizeof( float ) );
+
+#ifdef __SSE__
+		const __m128 vZero = _mm_setzero_ps();
+		__m128 vPeak = _mm_set1_ps( fTruePeak );
+		for ( unsigned i = 0; i < nChunk; ++i ) {
+			__m128 vAcc = _mm_setzero_ps();
+			for ( int nTap = 0; nTap < TP_TAPS; ++nTap ) {
+				vAcc = _mm_add_ps( vAcc, _mm_mul_ps( _mm_loadu_ps( m_fTruePeakCoeffs[ nTap ] ),
+													 _mm_set1_ps( pSamples[ ( int )i - nTap ] ) ) );
+			}
+			vPeak = _mm_max_ps( vPeak, _mm_max_ps( vAcc, _mm_sub_ps( vZero, vAcc ) ) );
+		}
+		fTruePeak = DSP::__hmax( vPeak );
+#else
+		for ( unsigned i = 0; i < nChunk; ++i ) {
+			for ( int nPhase = 0; nPhase < TP_PHASES; ++nPhase ) {
+				float fAcc = 0.0f;
+				for ( int nTap = 0; nTap < TP_TAPS; ++nTap ) {
+					fAcc += m_fTruePeakCoeffs[ nTap ][ nPhase ] * pSamples[ ( int )i - nTap ];
+				}
+				fAcc = fabsf( fAcc );
+				if ( fAcc > fTruePeak ) {
+					fTruePeak = fAcc;
+				}
+			}
+		}
+#endif
+		memmove( pHistory, pHistory + nChunk, ( TP_TAPS - 1 ) * sizeof( float ) );
+		pBuf += nChunk;
+		nFrames -= nChunk;
+	}
+}
+
+
+
+void Meter::endBlock()
+{
+	m_loudnessBlocks[ m_nBlockPos ] = m_fBlockLoudness;
+	m_squareBlocks_L[ m_nBlockPos % RMS_BLOCKS ] = m_fBlockSquares_L;
+	m_squareBlocks_R[ m_nBlockPos % RMS_BLOCKS ] = m_fBlockSquares_R;
+	m_nBlockPos = ( m_nBlockPos + 1 ) % LOUDNESS_BLOCKS;
+	if ( m_nBlocks < LOUDNESS_BLOCKS ) {
+		++m_nBlocks;
+	}
+	m_nBlockFrames = 0;
+	m_fBlockLoudness = 0.0;
+	m_fBlockSquares_L = 0.0;
+	m_fBlockSquares_R = 0.0;
+
+	// blocks not filled yet are zero
+	double fLoudness = 0.0;
+	for ( int i = 0; i < LOUDNESS_BLOCKS; ++i ) {
+		fLoudness += m_loudnessBlocks[ i ];
+	}
+	fLoudness /= ( double )m_nBlocks * m_nBlockSize;
+	m_values.fLufs = ( fLoudness > 0.0 ) ? std::max( LUFS_FLOOR, ( float )( -0.691 + 10.0 * log10( fLoudness ) ) ) : LUFS_FLOOR;
+
+	double fSquares_L = 0.0;
+	double fSquares_R = 0.0;
+	for ( int i = 0; i < RMS_BLOCKS; ++i ) {
+		fSquares_L += m_squareBlocks_L[ i ];
+		fSquares_R += m_squareBlocks_R[ i ];
+	}
+	double fFrames = ( double )std::min( m_nBlocks, ( int )RMS_BLOCKS ) * m_nBlockSize;
+	m_values.fRms_L = sqrt( fSquares_L / fFrames );
+	m_values.fRms_R = sqrt( fSquares_R / fFrames );
+}
+
+
+
+MeterValues Meter::read()
+{
+	MeterValues values;
+	int nSequence;
+	do {
+		nSequence = m_nSequence.fetchAndAddOrdered( 0 );
+		values = m_published;
+	} while ( ( nSequence & 1 ) || nSequence != m_nSequence.fetchAndAddOrdered( 0 ) );
+
+	m_nReadCount.fetchAndAddOrdered( 1 );
+	return values;
+}
+
+};
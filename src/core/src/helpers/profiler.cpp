@@ -0,0 +1,212 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/helpers/profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace H2Core
+{
+
+const char* Profiler::__class_name = "Profiler";
+
+Profiler::Profiler()
+		: Object( __class_name )
+		, m_bActive( false )
+		, m_nEnabled( 0 )
+		, m_nResetRequest( 0 )
+		, m_nResetCount( 0 )
+{
+	clear();
+}
+
+Profiler::~Profiler()
+{
+}
+
+const char* Profiler::sectionName( Section section )
+{
+	static const char* names[ SECTIONS ] = {
+		"cycle",
+		"transport",
+		"note queue",
+		"sampler",
+		"voice",
+		"synth",
+		"fx",
+		"metering"
+	};
+	return names[ section ];
+}
+
+void Profiler::setEnabled( bool bEnabled )
+{
+	m_nEnabled.fetchAndStoreOrdered( bEnabled ? 1 : 0 );
+}
+
+bool Profiler::isEnabled()
+{
+	return m_nEnabled.fetchAndAddOrdered( 0 ) != 0;
+}
+
+void Profiler::reset()
+{
+	m_nResetRequest.fetchAndAddOrdered( 1 );
+}
+
+void Profiler::clear()
+{
+	memset( m_histograms, 0, sizeof( m_histograms ) );
+	m_fVoicesAvg = 0.0f;
+	m_nVoicesMax = 0;
+	m_nLateCycles = 0;
+}
+
+void Profiler::beginCycle()
+{
+	m_bActive = m_nEnabled.fetchAndAddOrdered( 0 ) != 0;
+	if ( !m_bActive ) {
+		return;
+	}
+
+	int nResetRequest = m_nResetRequest.fetchAndAddOrdered( 0 );
+	if ( nResetRequest != m_nResetCount ) {
+		m_nResetCount = nResetRequest;
+		clear();
+	}
+}
+
+void Profiler::endCycle( float fProcessTime, int nVoices, float fPeriod )
+{
+	if ( !m_bActive ) {
+		return;
+	}
+	record( CYCLE, fProcessTime / 1000.0 );
+
+	if ( fProcessTime > fPeriod ) {
+		++m_nLateCycles;
+	}
+
+	// one second time constant
+	float fAlpha = std::min( 1.0f, fPeriod / 1000.0f );
+	m_fVoicesAvg += fAlpha * ( nVoices - m_fVoicesAvg );
+	if ( nVoices > m_nVoicesMax ) {
+		m_nVoicesMax = nVoices;
+	}
+}
+
+void Profiler::record( Section section, double fTime )
+{
+	float fMicroseconds = fTime * 1000000.0;
+	Histogram& histogram = m_histograms[ section ];
+	++histogram.buckets[ bucket( fMicroseconds ) ];
+	++histogram.nCount;
+	if ( fMicroseconds > histogram.fMax ) {
+		histogram.fMax = fMicroseconds;
+	}
+}
+
+int Profiler::bucket( float fMicroseconds )
+{
+	if ( !( fMicroseconds >= 1.0f ) ) {
+		return 0;
+	}
+	int nExponent;
+	float fMantissa = frexpf( fMicroseconds, &nExponent );	// fMicroseconds = fMantissa * 2^nExponent, 0.5 <= fMantissa < 1
+	int nBucket = 1 + ( nExponent - 1 ) * BUCKETS_PER_OCTAVE
+			+ ( int )( ( 2.0f * fMantissa - 1.0f ) * BUCKETS_PER_OCTAVE );
+	return std::min( nBucket, ( int )BUCKETS - 1 );
+}
+
+float Profiler::bucketValue( int nBucket )
+{
+	if ( nBucket == 0 ) {
+		return 0.5f;
+	}
+	int nOctave = ( nBucket - 1 ) / BUCKETS_PER_OCTAVE;
+	int nStep = ( nBucket - 1 ) % BUCKETS_PER_OCTAVE;
+	return ldexpf( 1.0f + ( nStep + 0.5f ) / BUCKETS_PER_OCTAVE, nOctave );
+}
+
+Profiler::Report Profiler::report()
+{
+	Report report;
+	for ( int nSection = 0; nSection < SECTIONS; ++nSection ) {
+		Histogram histogram = m_histograms[ nSection ];
+		SectionStats& stats = report.sections[ nSection ];
+		stats.nCount = histogram.nCount;
+		stats.fMax = histogram.fMax;
+		stats.fP50 = 0.0f;
+		stats.fP99 = 0.0f;
+
+		// the counts may be updated while they are copied, use their sum
+		unsigned nTotal = 0;
+		for ( int i = 0; i < BUCKETS; ++i ) {
+			nTotal += histogram.buckets[ i ];
+		}
+		unsigned nP50 = ( nTotal + 1 ) / 2;
+		unsigned nP99 = nTotal - nTotal / 100;
+		unsigned nSum = 0;
+		for ( int i = 0; i < BUCKETS && nTotal > 0; ++i ) {
+			unsigned nPrevious = nSum;
+			nSum += histogram.buckets[ i ];
+			if ( nPrevious < nP50 && nSum >= nP50 ) {
+				stats.fP50 = std::min( bucketValue( i ), histogram.fMax );
+			}
+			if ( nPrevious < nP99 && nSum >= nP99 ) {
+				stats.fP99 = std::min( bucketValue( i ), histogram.fMax );
+				break;
+			}
+		}
+	}
+	report.fVoicesAvg = m_fVoicesAvg;
+	report.nVoicesMax = m_nVoicesMax;
+	report.nLateCycles = m_nLateCycles;
+	return report;
+}
+
+QString Profiler::reportText()
+{
+	Report r = report();
+	QString sText = QString( "%1 %2 %3 %4 %5\n" )
+			.arg( "section", -12 )
+			.arg( "count", 10 )
+			.arg( "p50 us", 9 )
+			.arg( "p99 us", 9 )
+			.arg( "max us", 9 );
+	for ( int nSection = 0; nSection < SECTIONS; ++nSection ) {
+		const SectionStats& stats = r.sections[ nSection ];
+		sText += QString( "%1 %2 %3 %4 %5\n" )
+				.arg( sectionName( ( Section )nSection ), -12 )
+				.arg( stats.nCount, 10 )
+				.arg( stats.fP50, 9, 'f', 1 )
+				.arg( stats.fP99, 9, 'f', 1 )
+				.arg( stats.fMax, 9, 'f', 1 );
+	}
+	sText += QString( "voices: avg %1, max %2\n" ).arg( r.fVoicesAvg, 0, 'f', 1 ).arg( r.nVoicesMax );
+	sText += QString( "late cycles: %1" ).arg( r.nLateCycles );
+	return sText;
+}
+
+};
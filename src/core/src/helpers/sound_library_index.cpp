@@ -0,0 +1,328 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/helpers/sound_library_index.h>
+#include <hydrogen/helpers/filesystem.h>
+#include <hydrogen/helpers/xml.h>
+
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+#define INDEX_MAGIC     0x48324c49      // H2LI
+#define INDEX_VERSION   1
+#define PATTERN_EXT     ".h2pattern"
+
+namespace H2Core
+{
+
+const char* SoundLibraryIndex::__class_name = "SoundLibraryIndex";
+
+SoundLibraryIndex::SoundLibraryIndex()
+	: Object( __class_name )
+	, __index_path( Filesystem::sound_library_index() )
+	, __sys_drumkits_dir( Filesystem::sys_drumkits_dir() )
+	, __usr_drumkits_dir( Filesystem::usr_drumkits_dir() )
+	, __patterns_dir( Filesystem::patterns_dir() )
+	, __loaded( false )
+{
+}
+
+SoundLibraryIndex::SoundLibraryIndex( const QString& index_path, const QString& sys_drumkits_dir, const QString& usr_drumkits_dir, const QString& patterns_dir )
+	: Object( __class_name )
+	, __index_path( index_path )
+	, __sys_drumkits_dir( sys_drumkits_dir )
+	, __usr_drumkits_dir( usr_drumkits_dir )
+	, __patterns_dir( patterns_dir )
+	, __loaded( false )
+{
+}
+
+int SoundLibraryIndex::update()
+{
+	if( !__loaded ) {
+		__loaded = true;
+		if( !load() ) INFOLOG( QString( "no usable index in %1, the sound library is parsed" ).arg( __index_path ) );
+	}
+
+	QHash<QString, const DrumkitInfo*> previous_drumkits;
+	for( unsigned i = 0; i < __drumkits.size(); i++ ) previous_drumkits.insert( __drumkits[i].path, &__drumkits[i] );
+	QHash<QString, const PatternInfo*> previous_patterns;
+	for( unsigned i = 0; i < __patterns.size(); i++ ) previous_patterns.insert( __patterns[i].path, &__patterns[i] );
+
+	int parsed = 0;
+	std::vector<DrumkitInfo> drumkits;
+	parsed += scan_drumkits( __sys_drumkits_dir, false, previous_drumkits, drumkits );
+	parsed += scan_drumkits( __usr_drumkits_dir, true, previous_drumkits, drumkits );
+
+	// the patterns of the drumkits first, as LocalFileMng::getPatternDirList lists them
+	std::vector<PatternInfo> patterns;
+	QDir patterns_dir( __patterns_dir );
+	QStringList subdirs = patterns_dir.entryList( QDir::Dirs | QDir::NoDotAndDotDot );
+	for( int i = 0; i < subdirs.size(); i++ ) {
+		parsed += scan_patterns( __patterns_dir + "/" + subdirs[i], previous_patterns, patterns );
+	}
+	parsed += scan_patterns( __patterns_dir, previous_patterns, patterns );
+
+	bool changed = ( parsed > 0 || drumkits.size() != __drumkits.size() || patterns.size() != __patterns.size() );
+	__drumkits.swap( drumkits );
+	__patterns.swap( patterns );
+	__pattern_paths.clear();
+	for( unsigned i = 0; i < __patterns.size(); i++ ) __pattern_paths.insert( __patterns[i].path, i );
+
+	if( changed ) {
+		INFOLOG( QString( "%1 files parsed, %2 drumkits and %3 patterns indexed" ).arg( parsed ).arg( __drumkits.size() ).arg( __patterns.size() ) );
+		save();
+	}
+	return parsed;
+}
+
+int SoundLibraryIndex::scan_drumkits( const QString& dir, bool user, const QHash<QString, const DrumkitInfo*>& previous, std::vector<DrumkitInfo>& drumkits )
+{
+	int parsed = 0;
+	QStringList list = QDir( dir ).entryList( QDir::Dirs | QDir::NoDotAndDotDot );
+	for( int i = 0; i < list.size(); i++ ) {
+		QString path = dir + "/" + list[i];
+		QFileInfo file( Filesystem::drumkit_file( path ) );
+		if( !file.isReadable() ) continue;
+		qint64 mtime = file.lastModified().toMSecsSinceEpoch();
+
+		const DrumkitInfo* indexed = previous.value( path, 0 );
+		if( indexed && indexed->size == file.size() && indexed->mtime == mtime ) {
+			drumkits.push_back( *indexed );
+			continue;
+		}
+		DrumkitInfo drumkit;
+		parsed++;
+		if( !read_drumkit( file.filePath(), drumkit ) ) continue;
+		drumkit.path = path;
+		drumkit.user = user;
+		drumkit.size = file.size();
+		drumkit.mtime = mtime;
+		drumkits.push_back( drumkit );
+	}
+	return parsed;
+}
+
+int SoundLibraryIndex::scan_patterns( const QString& dir, const QHash<QString, const PatternInfo*>& previous, std::vector<PatternInfo>& patterns )
+{
+	int parsed = 0;
+	QFileInfoList list = QDir( dir ).entryInfoList( QDir::Files );
+	for( int i = 0; i < list.size(); i++ ) {
+		const QFileInfo& file = list[i];
+		if( !file.fileName().endsWith( PATTERN_EXT ) ) continue;
+		QString path = QDir::cleanPath( dir + "/" + file.fileName() );
+		qint64 mtime = file.lastModified().toMSecsSinceEpoch();
+
+		const PatternInfo* indexed = previous.value( path, 0 );
+		if( indexed && indexed->size == file.size() && indexed->mtime == mtime ) {
+			patterns.push_back( *indexed );
+			continue;
+		}
+		PatternInfo pattern;
+		parsed++;
+		if( !read_pattern( path, pattern ) ) continue;
+		pattern.path = path;
+		pattern.size = file.size();
+		pattern.mtime = mtime;
+		patterns.push_back( pattern );
+	}
+	return parsed;
+}
+
+bool SoundLibraryIndex::read_drumkit( const QString& filepath, DrumkitInfo& drumkit )
+{
+	// the defaults of Drumkit::load_from
+	drumkit.author = "undefined author";
+	drumkit.info = "No information available.";
+	drumkit.license = "undefined license";
+
+	XMLReader reader;
+	if( !reader.read( filepath, "drumkit_info" ) ) return false;
+	while( reader.readNextStartElement() ) {
+		if( reader.name_is( "name" ) ) {
+			drumkit.name = reader.read_string( "" );
+		} else if( reader.name_is( "author" ) ) {
+			drumkit.author = reader.read_string( drumkit.author );
+		} else if( reader.name_is( "info" ) ) {
+			drumkit.info = reader.read_string( drumkit.info );
+		} else if( reader.name_is( "license" ) ) {
+			drumkit.license = reader.read_string( drumkit.license );
+		} else if( reader.name_is( "instrumentList" ) ) {
+			while( reader.readNextStartElement() ) {
+				if( !reader.name_is( "instrument" ) ) {
+					reader.skipCurrentElement();
+					continue;
+				}
+				QString name;
+				while( reader.readNextStartElement() ) {
+					if( reader.name_is( "name" ) ) name = reader.read_string( "" );
+					else reader.skipCurrentElement();
+				}
+				drumkit.instruments << name;
+			}
+		} else {
+			reader.skipCurrentElement();
+		}
+	}
+	if( reader.hasError() ) {
+		_ERRORLOG( QString( "Unable to read %1: %2" ).arg( filepath ).arg( reader.errorString() ) );
+		return false;
+	}
+	if( drumkit.name.isEmpty() ) {
+		_ERRORLOG( QString( "Drumkit %1 has no name" ).arg( filepath ) );
+		return false;
+	}
+	return true;
+}
+
+bool SoundLibraryIndex::read_pattern( const QString& filepath, PatternInfo& pattern )
+{
+	// the defaults of SoundLibraryInfo
+	pattern.author = "undefined author";
+	pattern.license = "undefined license";
+	pattern.info = "No information available.";
+
+	XMLReader reader;
+	if( !reader.read( filepath, "drumkit_pattern" ) ) return false;
+	while( reader.readNextStartElement() ) {
+		if( reader.name_is( "drumkit_name" ) || reader.name_is( "pattern_for_drumkit" ) ) {
+			pattern.drumkit = reader.read_string( "" );
+		} else if( reader.name_is( "author" ) ) {
+			pattern.author = reader.read_string( pattern.author );
+		} else if( reader.name_is( "license" ) ) {
+			pattern.license = reader.read_string( pattern.license );
+		} else if( reader.name_is( "pattern" ) ) {
+			// name in the current format, pattern_name in the one of LocalFileMng::savePattern
+			while( reader.readNextStartElement() ) {
+				if( reader.name_is( "name" ) || reader.name_is( "pattern_name" ) ) {
+					pattern.name = reader.read_string( "" );
+				} else if( reader.name_is( "info" ) ) {
+					pattern.info = reader.read_string( pattern.info );
+				} else if( reader.name_is( "category" ) ) {
+					pattern.category = reader.read_string( "" );
+				} else {
+					reader.skipCurrentElement();
+				}
+			}
+		} else {
+			reader.skipCurrentElement();
+		}
+	}
+	if( reader.hasError() ) {
+		_ERRORLOG( QString( "Unable to read %1: %2" ).arg( filepath ).arg( reader.errorString() ) );
+		return false;
+	}
+	return true;
+}
+
+const SoundLibraryIndex::DrumkitInfo* SoundLibraryIndex::find_drumkit( const QString& name ) const
+{
+	const DrumkitInfo* found = 0;
+	for( unsigned i = 0; i < __drumkits.size(); i++ ) {
+		if( __drumkits[i].name != name ) continue;
+		if( __drumkits[i].user ) return &__drumkits[i];
+		if( !found ) found = &__drumkits[i];
+	}
+	return found;
+}
+
+const SoundLibraryIndex::PatternInfo* SoundLibraryIndex::find_pattern( const QString& path ) const
+{
+	int i = __pattern_paths.value( QDir::cleanPath( path ), -1 );
+	return ( i < 0 ) ? 0 : &__patterns[i];
+}
+
+QStringList SoundLibraryIndex::pattern_categories() const
+{
+	QStringList categories;
+	for( unsigned i = 0; i < __patterns.size(); i++ ) {
+		if( !categories.contains( __patterns[i].category ) ) categories << __patterns[i].category;
+	}
+	return categories;
+}
+
+bool SoundLibraryIndex::load()
+{
+	QFile file( __index_path );
+	if( !file.open( QIODevice::ReadOnly ) ) return false;
+	QDataStream in( &file );
+	in.setVersion( QDataStream::Qt_4_6 );
+
+	quint32 magic, version, count;
+	in >> magic >> version;
+	if( magic != INDEX_MAGIC || version != INDEX_VERSION ) {
+		WARNINGLOG( QString( "%1 is not an index of version %2" ).arg( __index_path ).arg( INDEX_VERSION ) );
+		return false;
+	}
+	std::vector<DrumkitInfo> drumkits;
+	in >> count;
+	for( quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++ ) {
+		DrumkitInfo drumkit;
+		in >> drumkit.path >> drumkit.name >> drumkit.author >> drumkit.info >> drumkit.license
+		   >> drumkit.instruments >> drumkit.user >> drumkit.size >> drumkit.mtime;
+		drumkits.push_back( drumkit );
+	}
+	std::vector<PatternInfo> patterns;
+	in >> count;
+	for( quint32 i = 0; i < count && in.status() == QDataStream::Ok; i++ ) {
+		PatternInfo pattern;
+		in >> pattern.path >> pattern.name >> pattern.info >> pattern.category >> pattern.author
+		   >> pattern.license >> pattern.drumkit >> pattern.size >> pattern.mtime;
+		patterns.push_back( pattern );
+	}
+	if( in.status() != QDataStream::Ok ) {
+		WARNINGLOG( QString( "%1 is truncated" ).arg( __index_path ) );
+		return false;
+	}
+	__drumkits.swap( drumkits );
+	__patterns.swap( patterns );
+	return true;
+}
+
+bool SoundLibraryIndex::save() const
+{
+	QByteArray data;
+	QDataStream out( &data, QIODevice::WriteOnly );
+	out.setVersion( QDataStream::Qt_4_6 );
+
+	out << ( quint32 )INDEX_MAGIC << ( quint32 )INDEX_VERSION;
+	out << ( quint32 )__drumkits.size();
+	for( unsigned i = 0; i < __drumkits.size(); i++ ) {
+		const DrumkitInfo& drumkit = __drumkits[i];
+		out << drumkit.path << drumkit.name << drumkit.author << drumkit.info << drumkit.license
+			<< drumkit.instruments << drumkit.user << drumkit.size << drumkit.mtime;
+	}
+	out << ( quint32 )__patterns.size();
+	for( unsigned i = 0; i < __patterns.size(); i++ ) {
+		const PatternInfo& pattern = __patterns[i];
+		out << pattern.path << pattern.name << pattern.info << pattern.category << pattern.author
+			<< pattern.license << pattern.drumkit << pattern.size << pattern.mtime;
+	}
+	return Filesystem::write_atomic( __index_path, data );
+}
+
+};
+
+/* vim: set softtabstop=4 expandtab: */
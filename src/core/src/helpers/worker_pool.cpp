@@ -0,0 +1,130 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2008 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/helpers/worker_pool.h>
+
+#include <QThread>
+
+namespace H2Core
+{
+
+const char* WorkerPool::__class_name = "WorkerPool";
+
+static void* workerPool_thread( void* param )
+{
+	WorkerPool* pPool = ( WorkerPool* )param;
+	pPool->workerLoop();
+	pthread_exit( NULL );
+	return NULL;
+}
+
+WorkerPool::WorkerPool( int nWorkers, int nMaxPending ) : Object( __class_name ),
+	__max_pending( nMaxPending ),
+	__busy( 0 ),
+	__quit( false )
+{
+	pthread_mutex_init( &__mutex, NULL );
+	pthread_cond_init( &__work_cond, NULL );
+	pthread_cond_init( &__done_cond, NULL );
+
+	if ( nWorkers <= 0 ) {
+		nWorkers = QThread::idealThreadCount();
+		if ( nWorkers <= 0 ) nWorkers = 1;
+	}
+	for ( int i = 0; i < nWorkers; i++ ) {
+		pthread_t thread;
+		if ( pthread_create( &thread, NULL, workerPool_thread, this ) != 0 ) {
+			ERRORLOG( QString( "Error creating worker thread %1" ).arg( i ) );
+			break;
+		}
+		__threads.push_back( thread );
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	pthread_mutex_lock( &__mutex );
+	__quit = true;
+	pthread_cond_broadcast( &__work_cond );
+	pthread_mutex_unlock( &__mutex );
+	for ( unsigned i = 0; i < __threads.size(); i++ ) {
+		pthread_join( __threads[i], NULL );
+	}
+
+	pthread_cond_destroy( &__done_cond );
+	pthread_cond_destroy( &__work_cond );
+	pthread_mutex_destroy( &__mutex );
+}
+
+void WorkerPool::add( Job* pJob )
+{
+	if ( __threads.empty() ) {
+		pJob->run();
+		delete pJob;
+		return;
+	}
+	pthread_mutex_lock( &__mutex );
+	while ( __max_pending > 0 && ( int )__jobs.size() >= __max_pending ) {
+		pthread_cond_wait( &__done_cond, &__mutex );
+	}
+	__jobs.push_back( pJob );
+	pthread_cond_signal( &__work_cond );
+	pthread_mutex_unlock( &__mutex );
+}
+
+void WorkerPool::wait()
+{
+	pthread_mutex_lock( &__mutex );
+	while ( !__jobs.empty() || __busy > 0 ) {
+		pthread_cond_wait( &__done_cond, &__mutex );
+	}
+	pthread_mutex_unlock( &__mutex );
+}
+
+void WorkerPool::workerLoop()
+{
+	pthread_mutex_lock( &__mutex );
+	while ( !__jobs.empty() || !__quit ) {
+		if ( __jobs.empty() ) {
+			pthread_cond_wait( &__work_cond, &__mutex );
+			continue;
+		}
+		Job* pJob = __jobs.front();
+		__jobs.pop_front();
+		__busy++;
+		// room for the next job
+		pthread_cond_broadcast( &__done_cond );
+		pthread_mutex_unlock( &__mutex );
+
+		pJob->run();
+		delete pJob;
+
+		pthread_mutex_lock( &__mutex );
+		__busy--;
+		pthread_cond_broadcast( &__done_cond );
+	}
+	pthread_mutex_unlock( &__mutex );
+}
+
+};
+
+/* vim: set softtabstop=4 expandtab: */
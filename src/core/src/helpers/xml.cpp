@@ -1,9 +1,13 @@
 
 #include <hydrogen/helpers/xml.h>
+#include <hydrogen/LocalFileMng.h>
 
 #include <QtCore/QFile>
+#include <QtCore/QHash>
 #include <QtCore/QLocale>
+#include <QtCore/QMutex>
 #include <QtCore/QString>
+#include <QtCore/QTextCodec>
 #include <QtCore/QTextStream>
 #include <QtXmlPatterns/QXmlSchema>
 #include <QtXmlPatterns/QXmlSchemaValidator>
@@ -114,44 +118,65 @@ XMLDoc::XMLDoc( ) : Object( __class_name ) { }
 
 bool XMLDoc::read( const QString& filepath, const QString& schemapath )
 {
+	QFile file( filepath );
+	if ( !file.open( QIODevice::ReadOnly ) ) {
+		ERRORLOG( QString( "Unable to open %1 for reading" ).arg( filepath ) );
+		return false;
+	}
+	// read once, for the validator and the parser
+	QByteArray data = file.readAll();
+	file.close();
+	if ( !schemapath.isEmpty() && !validate( data, filepath, schemapath ) ) {
+		return false;
+	}
+	if( !setContent( data ) ) {
+		ERRORLOG( QString( "Unable to read XML document %1" ).arg( filepath ) );
+		return false;
+	}
+	return true;
+}
+
+bool XMLDoc::check_root( const QString& node_name, const QString& xmlns )
+{
+	QDomElement root = documentElement();
+	return ( root.tagName()==node_name && root.attribute( "xmlns" )==XMLNS_BASE+xmlns );
+}
+
+bool XMLDoc::validate( const QByteArray& data, const QString& filepath, const QString& schemapath )
+{
+	static QMutex mutex;
+	static QHash<QString, QXmlSchema> schemas;
+
 	QXmlSchema schema;
-	bool schema_usable = false;
-	if( schemapath!=0 ) {
+	mutex.lock();
+	QHash<QString, QXmlSchema>::const_iterator it = schemas.find( schemapath );
+	if( it!=schemas.end() ) {
+		schema = it.value();
+	} else {
+		// an unusable schema is kept too, to be reported once
 		QFile file( schemapath );
 		if ( !file.open( QIODevice::ReadOnly ) ) {
-			ERRORLOG( QString( "Unable to open XML schema %1 for reading" ).arg( schemapath ) );
+			_ERRORLOG( QString( "Unable to open XML schema %1 for reading" ).arg( schemapath ) );
 		} else {
 			schema.load( &file, QUrl::fromLocalFile( file.fileName() ) );
 			file.close();
-			if ( schema.isValid() ) {
-				schema_usable = true;
-			} else {
-				ERRORLOG( QString( "%2 XML schema is not valid" ).arg( schemapath ) );
+			if ( !schema.isValid() ) {
+				_ERRORLOG( QString( "%1 XML schema is not valid" ).arg( schemapath ) );
 			}
 		}
+		schemas.insert( schemapath, schema );
 	}
-	QFile file( filepath );
-	if ( !file.open( QIODevice::ReadOnly ) ) {
-		ERRORLOG( QString( "Unable to open %1 for reading" ).arg( filepath ) );
-		return false;
-	}
-	if ( schema_usable ) {
-		QXmlSchemaValidator validator( schema );
-		if ( !validator.validate( &file, QUrl::fromLocalFile( file.fileName() ) ) ) {
-			ERRORLOG( QString( "XML document %1 is not valid (%2), loading may fail" ).arg( filepath ).arg( schemapath ) );
-			file.close();
-			return false;
-		} else {
-			INFOLOG( QString( "XML document %1 is valid (%2)" ).arg( filepath ).arg( schemapath ) );
-		}
-		file.seek( 0 );
+	mutex.unlock();
+
+	if ( !schema.isValid() ) {
+		return true;
 	}
-	if( !setContent( &file ) ) {
-		ERRORLOG( QString( "Unable to read XML document %1" ).arg( filepath ) );
-		file.close();
+	QXmlSchemaValidator validator( schema );
+	if ( !validator.validate( data, QUrl::fromLocalFile( filepath ) ) ) {
+		_ERRORLOG( QString( "XML document %1 is not valid (%2), loading may fail" ).arg( filepath ).arg( schemapath ) );
 		return false;
 	}
-	file.close();
+	_INFOLOG( QString( "XML document %1 is valid (%2)" ).arg( filepath ).arg( schemapath ) );
 	return true;
 }
 
@@ -185,6 +210,86 @@ void XMLDoc::set_root( const QString& node_name, const QString& xmlns )
 	appendChild( root );
 }
 
+
+const char* XMLReader::__class_name ="XMLReader";
+
+XMLReader::XMLReader( ) : Object( __class_name ) { }
+
+bool XMLReader::read( const QString& filepath, const QString& root_name, const QString& schemapath )
+{
+	QFile file( filepath );
+	if ( !file.open( QIODevice::ReadOnly ) ) {
+		ERRORLOG( QString( "Unable to open %1 for reading" ).arg( filepath ) );
+		return false;
+	}
+	__data = file.readAll();
+	file.close();
+
+	if( !__data.startsWith( "<?xml" ) ) {
+		WARNINGLOG( QString( "File '%1' is being read in TinyXML compatability mode" ).arg( filepath ) );
+		QString enc = QTextCodec::codecForLocale()->name();
+		if( enc == QString( "System" ) ) {
+			enc = "UTF-8";
+		}
+		LocalFileMng::convertFromTinyXMLString( &__data );
+		__data.prepend( QString( "<?xml version='1.0' encoding='%1' ?>\n" ).arg( enc ).toLocal8Bit() );
+	}
+
+	if( !schemapath.isEmpty() && !XMLDoc::validate( __data, filepath, schemapath ) ) {
+		return false;
+	}
+
+	clear();
+	addData( __data );
+	if( !readNextStartElement() ) {
+		ERRORLOG( QString( "Unable to read XML document %1: %2" ).arg( filepath ).arg( errorString() ) );
+		return false;
+	}
+	if( name()!=root_name ) {
+		ERRORLOG( QString( "%1 node not found in %2" ).arg( root_name ).arg( filepath ) );
+		return false;
+	}
+	return true;
+}
+
+QString XMLReader::read_string( const QString& default_value )
+{
+	QString ret = readElementText( QXmlStreamReader::IncludeChildElements );
+	if( ret.isEmpty() ) {
+		return default_value;
+	}
+	return ret;
+}
+
+float XMLReader::read_float( float default_value )
+{
+	QString ret = readElementText( QXmlStreamReader::IncludeChildElements );
+	if( ret.isEmpty() ) {
+		return default_value;
+	}
+	QLocale c_locale = QLocale::c();
+	return c_locale.toFloat( ret );
+}
+
+int XMLReader::read_int( int default_value )
+{
+	QString ret = readElementText( QXmlStreamReader::IncludeChildElements );
+	if( ret.isEmpty() ) {
+		return default_value;
+	}
+	QLocale c_locale = QLocale::c();
+	return c_locale.toInt( ret );
+}
+
+bool XMLReader::read_bool( bool default_value )
+{
+	QString ret = readElementText( QXmlStreamReader::IncludeChildElements );
+	if( ret.isEmpty() ) {
+		return default_value;
+	}
+	return ( ret=="true" );
+}
+
 };
 
 /* vim: set softtabstop=4 expandtab: */
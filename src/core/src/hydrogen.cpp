@@ -33,12 +33,15 @@
 #include <cassert>
 #include <cstdio>
 #include <deque>
+#include <map>
 #include <queue>
+#include <vector>
 #include <iostream>
 #include <ctime>
 #include <cmath>
 #include <algorithm>
 
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QMutex>
 #include <QtCore/QMutexLocker>
 
@@ -53,12 +56,17 @@
 #include <hydrogen/basics/instrument_component.h>
 #include <hydrogen/basics/instrument_list.h>
 #include <hydrogen/basics/instrument_layer.h>
+#include <hydrogen/basics/layer_loader.h>
 #include <hydrogen/basics/sample.h>
 #include <hydrogen/hydrogen.h>
 #include <hydrogen/basics/pattern.h>
 #include <hydrogen/basics/pattern_list.h>
 #include <hydrogen/basics/note.h>
 #include <hydrogen/helpers/filesystem.h>
+#include <hydrogen/helpers/worker_pool.h>
+#include <hydrogen/helpers/dsp.h>
+#include <hydrogen/helpers/meter.h>
+#include <hydrogen/helpers/clock.h>
 #include <hydrogen/fx/LadspaFX.h>
 #include <hydrogen/fx/Effects.h>
 
@@ -81,6 +89,9 @@
 #include <hydrogen/IO/TransportInfo.h>
 #include <hydrogen/IO/OssDriver.h>
 #include <hydrogen/IO/FakeDriver.h>
+#include <hydrogen/IO/TimedNoteQueue.h>
+#include <hydrogen/IO/MidiClockGenerator.h>
+#include <hydrogen/IO/MidiClockSlave.h>
 #include <hydrogen/IO/AlsaAudioDriver.h>
 #include <hydrogen/IO/PortAudioDriver.h>
 #include <hydrogen/IO/DiskWriterDriver.h>
@@ -96,8 +107,8 @@ namespace H2Core
 // GLOBALS
 
 // info
-float					m_fMasterPeak_L = 0.0f;		///< Master peak (left channel)
-float					m_fMasterPeak_R = 0.0f;		///< Master peak (right channel)
+Meter *				m_pMasterMeter = NULL;		///< Master bus levels
+AudioClock *			m_pAudioClock = NULL;		///< Time of the audio cycles
 float					m_fProcessTime = 0.0f;		///< time used in process function
 float					m_fMaxProcessTime = 0.0f;	///< max ms usable in process with no xrun
 //~ info
@@ -113,6 +124,16 @@ QMutex					mutex_OutputPointer;     ///< Mutex for audio output pointer, allows
 ///< When locking this AND AudioEngine, always lock AudioEngine first.
 MidiInput *				m_pMidiDriver = NULL;	///< MIDI input
 MidiOutput *			m_pMidiDriverOut = NULL;	///< MIDI output
+MidiClockGenerator *	m_pMidiClockGenerator = NULL;	///< MIDI clock and MTC sent to m_pMidiDriverOut
+MidiClockSlave *		m_pMidiClockSlave = NULL;	///< MIDI clock and MTC received by m_pMidiDriver
+float					m_fSyncBpm = 0.0f;			///< tempo of the engine following m_pMidiClockSlave, 0 when not syncing
+bool					m_bSyncRunning = false;		///< m_pMidiClockSlave was running at the last cycle
+float					m_fSyncShownBpm = 0.0f;		///< tempo of the master last sent with EVENT_TEMPO_CHANGED
+float					m_fSyncRubberbandBpm = 0.0f;	///< tempo of the master at the last EVENT_RECALCULATERUBBERBAND
+double					m_fSyncRubberbandTime = 0.0;	///< cycle time of the last EVENT_RECALCULATERUBBERBAND
+const float				SYNC_RUBBERBAND_BPM = 1.0f;		///< tempo change of the master which stretches the samples again
+const double			SYNC_RUBBERBAND_INTERVAL = 2.0;	///< seconds between two stretches of the samples
+QMutex					mutex_Rubberband;			///< held by Hydrogen::recalculateRubberband(), the layers are stretched by one thread at once
 
 // overload the the > operator of Note objects for priority_queue
 struct compare_pNotes {
@@ -128,6 +149,7 @@ struct compare_pNotes {
 /// Song Note FIFO
 std::priority_queue<Note*, std::deque<Note*>, compare_pNotes > m_songNoteQueue;
 std::deque<Note*>		m_midiNoteQueue;	///< Midi Note FIFO
+TimedNoteQueue*			m_pTimedNoteQueue = NULL;	///< Midi notes played at the frame of their event
 
 PatternList*			m_pNextPatterns;		///< Next pattern (used only in Pattern mode)
 bool					m_bAppendNextPattern;		///< Add the next pattern to the list instead of replace.
@@ -151,8 +173,8 @@ Hydrogen*				hydrogenInstance = NULL;   ///< Hydrogen class instance (used for l
 int						m_audioEngineState = STATE_UNINITIALIZED;	///< Audio engine state
 
 #ifdef H2CORE_HAVE_LADSPA
-float					m_fFXPeak_L[MAX_FX];
-float					m_fFXPeak_R[MAX_FX];
+std::vector<float>		m_fFXPeak_L;		///< one per FX slot
+std::vector<float>		m_fFXPeak_R;
 #endif
 
 int						m_nPatternStartTick = -1;
@@ -162,10 +184,9 @@ int						m_nLookaheadFrames = 0;
 // used in findPatternInTick
 int						m_nSongSizeInTicks = 0;
 
-struct timeval			m_currentTickTime;
-
 unsigned long			m_nRealtimeFrames = 0;
 unsigned int			m_naddrealtimenotetickposition = 0;
+unsigned long			m_nMidiNoteOnTick = 0;		///< tick of the last MIDI note on, for the length of the recorded notes
 
 // PROTOTYPES
 void					audioEngine_init();
@@ -175,12 +196,16 @@ void					audioEngine_stop( bool bLockEngine = false );
 void					audioEngine_setSong(Song *pNewSong );
 void					audioEngine_removeSong();
 static void				audioEngine_noteOn( Note *note );
+static void				audioEngine_timedNoteOn( Note *note, uint32_t nFrame );
 
 int						audioEngine_process( uint32_t nframes, void *arg );
 inline void				audioEngine_clearNoteQueue();
 inline void				audioEngine_process_checkBPMChanged(Song *pSong);
 inline void				audioEngine_process_playNotes( unsigned long nframes );
+inline void				audioEngine_process_timedNotes( unsigned long nframes );
 inline void				audioEngine_process_transport();
+inline void				audioEngine_process_midiSync( Song* pSong, unsigned nFrames );
+inline void				audioEngine_process_midiInput( uint32_t nFrames );
 
 inline unsigned			audioEngine_renderNote( Note* pNote, const unsigned& nBufferSize );
 inline int				audioEngine_updateNoteQueue( unsigned nFrames );
@@ -194,13 +219,6 @@ void					audioEngine_restartAudioDrivers();
 void					audioEngine_startAudioDrivers();
 void					audioEngine_stopAudioDrivers();
 
-inline timeval currentTime2()
-{
-	struct timeval now;
-	gettimeofday( &now, NULL );
-	return now;
-}
-
 inline int randomValue( int max )
 {
 	return rand() % max;
@@ -231,8 +249,9 @@ void updateTickSize()
 	Song* pSong = pHydrogen->getSong();
 
 	float sampleRate = ( float ) m_pAudioDriver->getSampleRate();
+	float fBpm = m_fSyncBpm > 0.0f ? m_fSyncBpm : pSong->__bpm;
 	m_pAudioDriver->m_transport.m_nTickSize =
-		( sampleRate * 60.0 /  pSong->__bpm / pSong->__resolution );
+		( sampleRate * 60.0 /  fBpm / pSong->__resolution );
 }
 
 void audioEngine_init()
@@ -258,6 +277,12 @@ void audioEngine_init()
 	m_pMainBuffer_L = NULL;
 	m_pMainBuffer_R = NULL;
 
+	m_pMasterMeter = new Meter();
+	m_pAudioClock = new AudioClock();
+	m_pTimedNoteQueue = new TimedNoteQueue();
+	m_pMidiClockGenerator = new MidiClockGenerator();
+	m_pMidiClockSlave = new MidiClockSlave();
+
 	srand( time( NULL ) );
 
 	// Create metronome instrument
@@ -275,9 +300,12 @@ void audioEngine_init()
 
 #ifdef H2CORE_HAVE_LADSPA
 	Effects::create_instance();
+	m_fFXPeak_L.assign( Effects::get_instance()->getNumberOfSlots(), 0.0 );
+	m_fFXPeak_R.assign( Effects::get_instance()->getNumberOfSlots(), 0.0 );
 #endif
 	AudioEngine::create_instance();
 	Playlist::create_instance();
+	LayerLoader::create_instance();
 
 	EventQueue::get_instance()->push_event( EVENT_STATE, STATE_INITIALIZED );
 
@@ -306,6 +334,8 @@ void audioEngine_destroy()
 		delete m_midiNoteQueue[i];
 	}
 	m_midiNoteQueue.clear();
+	delete m_pTimedNoteQueue;
+	m_pTimedNoteQueue = NULL;
 
 	// change the current audio engine state
 	m_audioEngineState = STATE_UNINITIALIZED;
@@ -321,6 +351,18 @@ void audioEngine_destroy()
 	delete m_pMetronomeInstrument;
 	m_pMetronomeInstrument = NULL;
 
+	delete m_pMasterMeter;
+	m_pMasterMeter = NULL;
+
+	delete m_pAudioClock;
+	m_pAudioClock = NULL;
+
+	delete m_pMidiClockGenerator;
+	m_pMidiClockGenerator = NULL;
+
+	delete m_pMidiClockSlave;
+	m_pMidiClockSlave = NULL;
+
 	AudioEngine::get_instance()->unlock();
 }
 
@@ -345,8 +387,7 @@ int audioEngine_start( bool bLockEngine, unsigned nTotalFrames )
 		return 0;	// FIXME!!
 	}
 
-	m_fMasterPeak_L = 0.0f;
-	m_fMasterPeak_R = 0.0f;
+	m_pMasterMeter->reset();
 	m_pAudioDriver->m_transport.m_nFrames = nTotalFrames;	// reset total frames
 	m_nSongPos = -1;
 	m_nPatternStartTick = -1;
@@ -386,8 +427,7 @@ void audioEngine_stop( bool bLockEngine )
 	m_audioEngineState = STATE_READY;
 	EventQueue::get_instance()->push_event( EVENT_STATE, STATE_READY );
 
-	m_fMasterPeak_L = 0.0f;
-	m_fMasterPeak_R = 0.0f;
+	m_pMasterMeter->reset();
 	//	m_nPatternTickPosition = 0;
 	m_nPatternStartTick = -1;
 
@@ -403,6 +443,7 @@ void audioEngine_stop( bool bLockEngine )
 		delete m_midiNoteQueue[i];
 	}
 	m_midiNoteQueue.clear();
+	m_pTimedNoteQueue->clear();
 
 	if ( bLockEngine ) {
 		AudioEngine::get_instance()->unlock();
@@ -419,7 +460,8 @@ inline void audioEngine_process_checkBPMChanged(Song* pSong)
 	) return;
 
 	float fOldTickSize = m_pAudioDriver->m_transport.m_nTickSize;
-	float fNewTickSize = m_pAudioDriver->getSampleRate() * 60.0 / pSong->__bpm / pSong->__resolution;
+	float fBpm = m_fSyncBpm > 0.0f ? m_fSyncBpm : pSong->__bpm;
+	float fNewTickSize = m_pAudioDriver->getSampleRate() * 60.0 / fBpm / pSong->__resolution;
 
 	// Nothing changed - avoid recomputing
 	if ( fNewTickSize == fOldTickSize )
@@ -431,11 +473,17 @@ inline void audioEngine_process_checkBPMChanged(Song* pSong)
 	if ( fNewTickSize == 0 || fOldTickSize == 0 )
 		return;
 
-	___WARNINGLOG( "Tempo change: Recomputing ticksize and frame position" );
-	float fTickNumber = m_pAudioDriver->m_transport.m_nFrames / fOldTickSize;
+	if ( m_fSyncBpm > 0.0f ) {
+		// the tempo of a MIDI clock master changes a little at each cycle, keep the exact tick
+		double fTickNumber = m_pAudioDriver->m_transport.m_nFrames / ( double )fOldTickSize;
+		m_pAudioDriver->m_transport.m_nFrames = ( long long )( fTickNumber * fNewTickSize + 0.5 );
+	} else {
+		___WARNINGLOG( "Tempo change: Recomputing ticksize and frame position" );
+		float fTickNumber = m_pAudioDriver->m_transport.m_nFrames / fOldTickSize;
 
-	// update frame position in transport class
-	m_pAudioDriver->m_transport.m_nFrames = ceil(fTickNumber) * fNewTickSize;
+		// update frame position in transport class
+		m_pAudioDriver->m_transport.m_nFrames = ceil(fTickNumber) * fNewTickSize;
+	}
 
 #ifdef H2CORE_HAVE_JACK
 	if ( JackOutput::class_name() == m_pAudioDriver->class_name()
@@ -444,7 +492,41 @@ inline void audioEngine_process_checkBPMChanged(Song* pSong)
 		static_cast< JackOutput* >( m_pAudioDriver )->calculateFrameOffset();
 	}
 #endif
-	EventQueue::get_instance()->push_event( EVENT_RECALCULATERUBBERBAND, -1);
+	if ( m_fSyncBpm == 0.0f ) {
+		EventQueue::get_instance()->push_event( EVENT_RECALCULATERUBBERBAND, -1);
+	}
+}
+
+/// Move the realtime notes due in this cycle to the song note queue, at
+/// the frame offset of their MIDI event.
+inline void audioEngine_process_timedNotes( unsigned long nframes )
+{
+	if ( m_pTimedNoteQueue->empty() ) {
+		return;
+	}
+
+	unsigned long framepos;
+	if (  m_audioEngineState == STATE_PLAYING ) {
+		framepos = m_pAudioDriver->m_transport.m_nFrames;
+	} else {
+		framepos = Hydrogen::get_instance()->getRealtimeFrames();
+	}
+
+	float fTickSize = m_pAudioDriver->m_transport.m_nTickSize;
+	uint32_t nCycleFrame = m_pAudioDriver->getCycleFrameTime();
+	unsigned nOffset;
+	Note* pNote;
+	while ( ( pNote = m_pTimedNoteQueue->pop( nCycleFrame, nframes, nOffset ) ) != NULL ) {
+		// the tick holds the note in this cycle, the humanize delay
+		// moves its start to the exact frame in the sampler
+		unsigned long nNoteFrame = framepos + nOffset;
+		int nTick = ( int )( nNoteFrame / fTickSize );
+		pNote->set_position( nTick );
+		pNote->set_humanize_delay( nNoteFrame - ( int )( nTick * fTickSize ) );
+
+		pNote->get_instrument()->enqueue();
+		m_songNoteQueue.push( pNote );
+	}
 }
 
 inline void audioEngine_process_playNotes( unsigned long nframes )
@@ -636,6 +718,107 @@ inline void audioEngine_process_transport()
 	}
 }
 
+/**
+ * Follow the MIDI clock or MTC master of m_pMidiClockSlave: start, stop
+ * and locate with it, and set the tempo of the engine to the tempo of the
+ * master, corrected to close the phase error within a second.
+ */
+inline void audioEngine_process_midiSync( Song* pSong, unsigned nFrames )
+{
+	int nSource = Preferences::get_instance()->m_nMidiSyncInput;
+	if ( nSource == MidiClockSlave::SYNC_NONE
+	  || ( m_audioEngineState != STATE_READY && m_audioEngineState != STATE_PLAYING )
+	) {
+		m_fSyncBpm = 0.0f;
+		m_bSyncRunning = false;
+		return;
+	}
+
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	MidiClockSlave::State state = m_pMidiClockSlave->read();
+	double fCycleTime = m_pAudioClock->getCycleTime();
+
+	// the master stopped sending
+	double fTimeout = std::max( 0.25, 4 * state.fPeriod );
+	if ( !state.bRunning || state.fPeriod <= 0.0 || fCycleTime - state.fTime > fTimeout ) {
+		if ( m_bSyncRunning && m_audioEngineState == STATE_PLAYING ) {
+			pHydrogen->sequencer_stop();
+		}
+		m_fSyncBpm = 0.0f;
+		m_bSyncRunning = false;
+		return;
+	}
+
+	// position and tempo of the master, in ticks of the song
+	double fTick, fBpm;
+	if ( nSource == MidiClockSlave::SYNC_CLOCK ) {
+		fTick = MidiClockSlave::position( state, fCycleTime ) * pSong->__resolution / MidiClockSlave::PULSES_PER_QUARTER;
+		fBpm = 60.0 / ( MidiClockSlave::PULSES_PER_QUARTER * state.fPeriod );
+	} else {
+		// a time code has no tempo, it is mapped at the tempo of the song
+		double fSeconds = MidiClockSlave::position( state, fCycleTime ) / ( 4.0 * state.nFps );
+		fTick = fSeconds * pSong->__bpm * pSong->__resolution / 60.0;
+		fBpm = pSong->__bpm / ( 4.0 * state.nFps * state.fPeriod );
+	}
+	if ( fBpm < 30.0 || fBpm > 500.0 ) {
+		return;
+	}
+
+	float fTickSize = m_pAudioDriver->m_transport.m_nTickSize;
+	if ( !m_bSyncRunning ) {
+		// the transport rolls at the next cycle
+		m_bSyncRunning = true;
+		m_fSyncBpm = fBpm;
+		m_fSyncShownBpm = pSong->__bpm;
+		m_fSyncRubberbandBpm = pSong->__bpm;
+		m_fSyncRubberbandTime = fCycleTime;
+		fTick += nFrames * fBpm * pSong->__resolution / ( 60.0 * m_pAudioDriver->getSampleRate() );
+		m_pAudioDriver->locate( ( unsigned long )( fTick * fTickSize ) );
+		if ( m_audioEngineState != STATE_PLAYING ) {
+			pHydrogen->sequencer_play();
+		}
+		return;
+	}
+	if ( m_audioEngineState != STATE_PLAYING || fTickSize <= 0.0f ) {
+		m_fSyncBpm = fBpm;
+		return;
+	}
+
+	double fError = ( fTick - m_pAudioDriver->m_transport.m_nFrames / fTickSize ) / pSong->__resolution;
+	if ( fabs( fError ) > 1.0 ) {
+		// more than a beat off, the master located
+		___INFOLOG( QString( "MIDI sync: locate to tick %1" ).arg( fTick ) );
+		m_pAudioDriver->locate( ( unsigned long )( fTick * fTickSize ) );
+		m_fSyncBpm = fBpm;
+		return;
+	}
+
+	// beats to gain per beat, to be on time within a second
+	double fCorrection = fError * 60.0 / fBpm;
+	fCorrection = std::min( 0.05, std::max( -0.05, fCorrection ) );
+	m_fSyncBpm = fBpm * ( 1.0 + fCorrection );
+
+	if ( nSource != MidiClockSlave::SYNC_CLOCK ) {
+		return;
+	}
+
+	// show the tempo of the master, the GUI sets it to the song
+	if ( fabs( m_fSyncShownBpm - fBpm ) > 0.25 ) {
+		m_fSyncShownBpm = floor( fBpm * 10.0 + 0.5 ) / 10.0;
+		EventQueue::get_instance()->push_event( EVENT_TEMPO_CHANGED, ( int )( m_fSyncShownBpm * 10.0 + 0.5 ) );
+	}
+
+	// stretching the samples takes a while, follow the master only
+	// once it moved away from the last stretched tempo, and not more
+	// than once every SYNC_RUBBERBAND_INTERVAL seconds
+	if ( fabs( m_fSyncRubberbandBpm - m_fSyncShownBpm ) >= SYNC_RUBBERBAND_BPM
+	  && fCycleTime - m_fSyncRubberbandTime >= SYNC_RUBBERBAND_INTERVAL ) {
+		m_fSyncRubberbandBpm = m_fSyncShownBpm;
+		m_fSyncRubberbandTime = fCycleTime;
+		EventQueue::get_instance()->push_event( EVENT_RECALCULATERUBBERBAND, -1 );
+	}
+}
+
 void audioEngine_clearNoteQueue()
 {
 	//___INFOLOG( "clear notes...");
@@ -654,9 +837,42 @@ void audioEngine_clearNoteQueue()
 		delete m_midiNoteQueue[i];
 	}
 	m_midiNoteQueue.clear();
+	m_pTimedNoteQueue->clear();
 
 }
 
+/**
+ * Play the notes posted by the MIDI drivers since the last cycle.
+ *
+ * The notes of the JACK MIDI ports of the audio client are stamped with
+ * their frame in this cycle. The others are played one period after
+ * their Clock time: at their offset in the last cycle, or in the next
+ * cycle when they came after its end.
+ *
+ * The engine is locked, the notes are built here rather than by the
+ * thread of the driver: no lock is taken and nothing is logged.
+ */
+inline void audioEngine_process_midiInput( uint32_t nFrames )
+{
+	Hydrogen* pHydrogen = Hydrogen::get_instance();
+	uint32_t nCycleFrame = m_pAudioDriver->getCycleFrameTime();
+	TimedNoteQueue::MidiNote note;
+	while ( m_pTimedNoteQueue->receive( note ) ) {
+		if ( note.nFrame >= 0 ) {
+			pHydrogen->__playMidiNote( note, ( uint32_t )note.nFrame );
+			continue;
+		}
+
+		// the audio clock still holds the start of the last cycle
+		double fOffset = m_pAudioClock->framesSinceCycleStart( note.fTime );
+		unsigned nOffset = 0;
+		if ( fOffset > 0.0 ) {
+			nOffset = std::min( ( unsigned )fOffset, 2 * nFrames - 1 );
+		}
+		pHydrogen->__playMidiNote( note, nCycleFrame + nOffset );
+	}
+}
+
 /// Clear all audio buffers
 inline void audioEngine_process_clearAudioBuffers( uint32_t nFrames )
 {
@@ -679,18 +895,7 @@ inline void audioEngine_process_clearAudioBuffers( uint32_t nFrames )
 #ifdef H2CORE_HAVE_JACK
 	JackOutput* jo = dynamic_cast<JackOutput*>(m_pAudioDriver);
 	if( jo && jo->has_track_outs() ) {
-		float* buf;
-		int k;
-		for( k=0 ; k<jo->getNumTracks() ; ++k ) {
-			buf = jo->getTrackOut_L(k);
-			if( buf ) {
-				memset( buf, 0, nFrames * sizeof( float ) );
-			}
-			buf = jo->getTrackOut_R(k);
-			if( buf ) {
-				memset( buf, 0, nFrames * sizeof( float ) );
-			}
-		}
+		jo->prepareTrackOutputs( nFrames );
 	}
 #endif
 
@@ -698,16 +903,8 @@ inline void audioEngine_process_clearAudioBuffers( uint32_t nFrames )
 
 #ifdef H2CORE_HAVE_LADSPA
 	if ( m_audioEngineState >= STATE_READY ) {
-		Effects* pEffects = Effects::get_instance();
-		for ( unsigned i = 0; i < MAX_FX; ++i ) {	// clear FX buffers
-			LadspaFX* pFX = pEffects->getLadspaFX( i );
-			if ( pFX ) {
-				assert( pFX->m_pBuffer_L );
-				assert( pFX->m_pBuffer_R );
-				memset( pFX->m_pBuffer_L, 0, nFrames * sizeof( float ) );
-				memset( pFX->m_pBuffer_R, 0, nFrames * sizeof( float ) );
-			}
-		}
+		// only the FX buffers written to in the last cycle need clearing
+		Effects::get_instance()->clearBuffers( nFrames );
 	}
 #endif
 }
@@ -715,7 +912,7 @@ inline void audioEngine_process_clearAudioBuffers( uint32_t nFrames )
 /// Main audio processing function. Called by audio drivers.
 int audioEngine_process( uint32_t nframes, void* /*arg*/ )
 {
-	timeval startTimeval = currentTime2();
+	double fStartTime = Clock::now();
 
 	audioEngine_process_clearAudioBuffers( nframes );
 
@@ -744,16 +941,27 @@ int audioEngine_process( uint32_t nframes, void* /*arg*/ )
 		m_nBufferSize = nframes;
 	}
 
+	audioEngine_process_midiInput( nframes );
+	m_pAudioClock->cycleStart( fStartTime, nframes, m_pAudioDriver->getSampleRate() );
+
+	Profiler* pProfiler = AudioEngine::get_instance()->get_profiler();
+	pProfiler->beginCycle();
+
 	Hydrogen* pHydrogen = Hydrogen::get_instance();
 	Song* pSong = pHydrogen->getSong();
 
+	double fSectionStart = pProfiler->start();
 	audioEngine_process_transport();
+	audioEngine_process_midiSync( pSong, nframes );
 	audioEngine_process_checkBPMChanged(pSong); // pSong->__bpm decides tick size
+	pProfiler->stop( Profiler::TRANSPORT, fSectionStart );
 
 	bool sendPatternChange = false;
 	// always update note queue.. could come from pattern or realtime input
 	// (midi, keyboard)
+	fSectionStart = pProfiler->start();
 	int res2 = audioEngine_updateNoteQueue( nframes );
+	pProfiler->stop( Profiler::NOTE_QUEUE, fSectionStart );
 	if ( res2 == -1 ) {	// end of song
 		___INFOLOG( "End of song received, calling engine_stop()" );
 		AudioEngine::get_instance()->unlock();
@@ -781,7 +989,23 @@ int audioEngine_process( uint32_t nframes, void* /*arg*/ )
 		sendPatternChange = true;
 	}
 
+	// MIDI clock and time code, on the ticks of the transport
+	if ( m_pMidiDriverOut ) {
+		Preferences* pPref = Preferences::get_instance();
+		m_pMidiClockGenerator->setClockEnabled( pPref->m_bMidiClockOutput );
+		m_pMidiClockGenerator->setTimecodeEnabled( pPref->m_bMidiTimecodeOutput );
+		m_pMidiClockGenerator->process( m_pMidiDriverOut,
+										m_audioEngineState == STATE_PLAYING,
+										m_pAudioDriver->m_transport.m_nFrames,
+										m_pAudioDriver->m_transport.m_nTickSize,
+										pSong->__resolution,
+										nframes,
+										m_pAudioDriver->getSampleRate() );
+	}
+
 	// play all notes
+	fSectionStart = pProfiler->start();
+	audioEngine_process_timedNotes( nframes );
 	audioEngine_process_playNotes( nframes );
 
 	// SAMPLER
@@ -792,8 +1016,10 @@ int audioEngine_process( uint32_t nframes, void* /*arg*/ )
 		m_pMainBuffer_L[ i ] += out_L[ i ];
 		m_pMainBuffer_R[ i ] += out_R[ i ];
 	}
+	pProfiler->stop( Profiler::SAMPLER, fSectionStart );
 
 	// SYNTH
+	fSectionStart = pProfiler->start();
 	AudioEngine::get_instance()->get_synth()->process( nframes );
 	out_L = AudioEngine::get_instance()->get_synth()->m_pOut_L;
 	out_R = AudioEngine::get_instance()->get_synth()->m_pOut_R;
@@ -801,18 +1027,23 @@ int audioEngine_process( uint32_t nframes, void* /*arg*/ )
 		m_pMainBuffer_L[ i ] += out_L[ i ];
 		m_pMainBuffer_R[ i ] += out_R[ i ];
 	}
+	pProfiler->stop( Profiler::SYNTH, fSectionStart );
 
-	timeval renderTime_end = currentTime2();
-	timeval ladspaTime_start = renderTime_end;
+	fSectionStart = pProfiler->start();
+#ifdef CONFIG_DEBUG
+	double fLadspaTime_start = Clock::now();
+#endif
 
 #ifdef H2CORE_HAVE_LADSPA
 	// Process LADSPA FX
 	if ( m_audioEngineState >= STATE_READY ) {
-		for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
-			LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
-			if ( ( pFX ) && ( pFX->isEnabled() ) ) {
-				pFX->processFX( nframes );
+		Effects* pEffects = Effects::get_instance();
+		pEffects->processFX( nframes );
 
+		int nSlots = pEffects->getNumberOfSlots();
+		for ( int nFX = 0; nFX < nSlots; ++nFX ) {
+			LadspaFX *pFX = pEffects->getLadspaFX( nFX );
+			if ( ( pFX ) && ( pFX->isEnabled() ) && ( pFX->isOutputActive() ) ) {
 				float *buf_L, *buf_R;
 				if ( pFX->getPluginType() == LadspaFX::STEREO_FX ) {
 					buf_L = pFX->m_pBuffer_L;
@@ -822,61 +1053,44 @@ int audioEngine_process( uint32_t nframes, void* /*arg*/ )
 					buf_R = buf_L;
 				}
 
-				for ( unsigned i = 0; i < nframes; ++i ) {
-					m_pMainBuffer_L[ i ] += buf_L[ i ];
-					m_pMainBuffer_R[ i ] += buf_R[ i ];
-					if ( buf_L[ i ] > m_fFXPeak_L[nFX] )
-						m_fFXPeak_L[nFX] = buf_L[ i ];
-
-					if ( buf_R[ i ] > m_fFXPeak_R[nFX] )
-						m_fFXPeak_R[nFX] = buf_R[ i ];
-				}
+				DSP::add( m_pMainBuffer_L, buf_L, nframes );
+				DSP::add( m_pMainBuffer_R, buf_R, nframes );
+				m_fFXPeak_L[nFX] = DSP::peak( buf_L, nframes, m_fFXPeak_L[nFX] );
+				m_fFXPeak_R[nFX] = DSP::peak( buf_R, nframes, m_fFXPeak_R[nFX] );
 			}
 		}
 	}
 #endif
-	timeval ladspaTime_end = currentTime2();
+#ifdef CONFIG_DEBUG
+	float fLadspaTime = ( Clock::now() - fLadspaTime_start ) * 1000.0;
+#endif
+	pProfiler->stop( Profiler::FX, fSectionStart );
 
-	// update master peaks
-	float val_L, val_R;
+	// update master and component levels
+	fSectionStart = pProfiler->start();
 	if ( m_audioEngineState >= STATE_READY ) {
-		for ( unsigned i = 0; i < nframes; ++i ) {
-			val_L = m_pMainBuffer_L[i];
-			val_R = m_pMainBuffer_R[i];
-
-			if ( val_L > m_fMasterPeak_L )
-				m_fMasterPeak_L = val_L;
-
-			if ( val_R > m_fMasterPeak_R )
-				m_fMasterPeak_R = val_R;
+		m_pMasterMeter->process( m_pMainBuffer_L, m_pMainBuffer_R, nframes, m_pAudioDriver->getSampleRate() );
 
-			for (std::vector<DrumkitComponent*>::iterator it = pSong->get_components()->begin() ; it != pSong->get_components()->end(); ++it) {
-				DrumkitComponent* drumkit_component = *it;
-
-				float compo_val_L = drumkit_component->get_out_L(i);
-				float compo_val_R = drumkit_component->get_out_R(i);
-
-				if( compo_val_L > drumkit_component->get_peak_l() )
-					drumkit_component->set_peak_l( compo_val_L );
-				if( compo_val_R > drumkit_component->get_peak_r() )
-					drumkit_component->set_peak_r( compo_val_R );
-			}
+		for (std::vector<DrumkitComponent*>::iterator it = pSong->get_components()->begin() ; it != pSong->get_components()->end(); ++it) {
+			( *it )->update_peaks( nframes );
 		}
 	}
+	pProfiler->stop( Profiler::METERING, fSectionStart );
 
 	// update total frames number
 	if ( m_audioEngineState == STATE_PLAYING ) {
 		m_pAudioDriver->m_transport.m_nFrames += nframes;
 	}
 
-	timeval finishTimeval = currentTime2();
-	m_fProcessTime =
-			( finishTimeval.tv_sec - startTimeval.tv_sec ) * 1000.0
-			+ ( finishTimeval.tv_usec - startTimeval.tv_usec ) / 1000.0;
+	m_fProcessTime = m_pAudioClock->cycleEnd();
 
 	float sampleRate = ( float )m_pAudioDriver->getSampleRate();
 	m_fMaxProcessTime = 1000.0 / ( sampleRate / nframes );
 
+	pProfiler->endCycle( m_fProcessTime,
+						 AudioEngine::get_instance()->get_sampler()->get_playing_notes_number(),
+						 m_fMaxProcessTime );
+
 #ifdef CONFIG_DEBUG
 	if ( m_fProcessTime > m_fMaxProcessTime ) {
 		___WARNINGLOG( "" );
@@ -915,10 +1129,11 @@ void audioEngine_setupLadspaFX( unsigned nBufferSize )
 	}
 
 #ifdef H2CORE_HAVE_LADSPA
-	for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
+	int nSlots = Effects::get_instance()->getNumberOfSlots();
+	for ( int nFX = 0; nFX < nSlots; ++nFX ) {
 		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
 		if ( pFX == NULL ) {
-			return;
+			continue;
 		}
 
 		pFX->deactivate();
@@ -1053,9 +1268,6 @@ inline int audioEngine_updateNoteQueue( unsigned nFrames )
 
 	// 	___WARNINGLOG( "Lookahead: " + to_string( lookahead
 	//	                                        / m_pAudioDriver->m_transport.m_nTickSize ) );
-	// get initial timestamp for first tick
-	gettimeofday( &m_currentTickTime, NULL );
-
 	for ( int tick = tickNumber_start; tick < tickNumber_end; tick++ ) {
 		// midi events now get put into the m_songNoteQueue as well,
 		// based on their timestamp
@@ -1386,6 +1598,14 @@ void audioEngine_noteOn( Note *note )
 	m_midiNoteQueue.push_back( note );
 }
 
+/// Play a realtime note at the frame of its MIDI event, see audioEngine_process_midiInput().
+void audioEngine_timedNoteOn( Note *note, uint32_t nFrame )
+{
+	if ( !m_pTimedNoteQueue->push( note, nFrame ) ) {
+		delete note;
+	}
+}
+
 AudioOutput* createDriver( const QString& sDriver )
 {
 	___INFOLOG( QString( "Driver: '%1'" ).arg( sDriver ) );
@@ -1629,6 +1849,14 @@ void audioEngine_stopAudioDrivers()
 	m_audioEngineState = STATE_INITIALIZED;
 	EventQueue::get_instance()->push_event( EVENT_STATE, STATE_INITIALIZED );
 
+#ifdef H2CORE_HAVE_JACK
+	// the JACK MIDI input runs in the audio callback and may be waiting
+	// for the engine lock, detach it first
+	if ( m_pAudioDriver && m_pAudioDriver->class_name() == JackOutput::class_name() ) {
+		static_cast< JackOutput* >( m_pAudioDriver )->setMidiDriver( NULL );
+	}
+#endif
+
 	AudioEngine::get_instance()->lock( RIGHT_HERE );
 
 	// delete MIDI driver
@@ -1716,6 +1944,8 @@ Hydrogen::~Hydrogen()
 	if ( m_audioEngineState == STATE_PLAYING ) {
 		audioEngine_stop();
 	}
+	// before the layers it loads are deleted
+	delete LayerLoader::get_instance();
 	removeSong();
 	audioEngine_stopAudioDrivers();
 	audioEngine_destroy();
@@ -1759,6 +1989,8 @@ void Hydrogen::initBeatcounter(void)
 	m_nBeatCount = 1;
 	m_nCoutOffset = 0;
 	m_nStartOffset = 0;
+	m_fCurrentTime = 0.0;
+	m_fLastTime = 0.0;
 }
 
 /// Start the internal sequencer
@@ -1808,6 +2040,8 @@ void Hydrogen::setSong( Song *pSong )
 	audioEngine_setSong ( pSong );
 
 	__song = pSong;
+
+	LayerLoader::get_instance()->prefetch( pSong );
 }
 
 /* Mean: remove current song from memory */
@@ -1833,6 +2067,20 @@ void Hydrogen::addRealtimeNote( int instrument,
 {
 	UNUSED( pitch );
 
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
+	__addRealtimeNote( instrument, velocity, pan_L, pan_R, noteOff, forcePlay, msg1, -1 );
+	AudioEngine::get_instance()->unlock(); // unlock the audio engine
+}
+
+void Hydrogen::__addRealtimeNote( int instrument,
+								  float velocity,
+								  float pan_L,
+								  float pan_R,
+								  bool noteOff,
+								  bool forcePlay,
+								  int msg1,
+								  long long nFrame )
+{
 	Preferences *pref = Preferences::get_instance();
 	unsigned int realcolumn = 0;
 	unsigned res = pref->getPatternEditorGridResolution();
@@ -1841,13 +2089,10 @@ void Hydrogen::addRealtimeNote( int instrument,
 	bool hearnote = forcePlay;
 	int currentPatternNumber;
 
-	AudioEngine::get_instance()->lock( RIGHT_HERE );
-
 	Song *pSong = getSong();
 	if ( !pref->__playselectedinstrument ) {
 		if ( instrument >= ( int ) pSong->get_instrument_list()->size() ) {
 			// unused instrument
-			AudioEngine::get_instance()->unlock();
 			return;
 		}
 	}
@@ -1865,7 +2110,6 @@ void Hydrogen::addRealtimeNote( int instrument,
 		PatternList *pPatternList = pSong->get_pattern_list();
 		int ipattern = getPatternPos(); // playlist index
 		if ( ipattern < 0 || ipattern >= (int) pPatternList->size() ) {
-			AudioEngine::get_instance()->unlock(); // unlock the audio engine
 			return;
 		}
 		// Locate column -- may need to jump back in the pattern list
@@ -1873,7 +2117,6 @@ void Hydrogen::addRealtimeNote( int instrument,
 		while ( column < lookaheadTicks ) {
 			ipattern -= 1;
 			if ( ipattern < 0 || ipattern >= (int) pPatternList->size() ) {
-				AudioEngine::get_instance()->unlock(); // unlock the audio engine
 				return;
 			}
 
@@ -1915,7 +2158,6 @@ void Hydrogen::addRealtimeNote( int instrument,
 		}
 
 		if ( ! currentPattern ) {
-			AudioEngine::get_instance()->unlock(); // unlock the audio engine
 			return;
 		}
 
@@ -2150,7 +2392,11 @@ void Hydrogen::addRealtimeNote( int instrument,
 	if ( !pref->__playselectedinstrument ) {
 		if ( hearnote && instrRef ) {
 			Note *note2 = new Note( instrRef, realcolumn, velocity, pan_L, pan_R, -1, 0 );
-			midi_noteOn( note2 );
+			if ( nFrame >= 0 ) {
+				audioEngine_timedNoteOn( note2, nFrame );
+			} else {
+				midi_noteOn( note2 );
+			}
 		}
 	} else if ( hearnote  ) {
 		Instrument* pInstr = pSong->get_instrument_list()->get( getSelectedInstrumentNumber() );
@@ -2162,20 +2408,31 @@ void Hydrogen::addRealtimeNote( int instrument,
 
 		//ERRORLOG( QString( "octave: %1, note: %2, instrument %3" ).arg( octave ).arg(notehigh).arg(instrument));
 		note2->set_midi_info( notehigh, octave, msg1 );
-		midi_noteOn( note2 );
+		if ( nFrame >= 0 ) {
+			audioEngine_timedNoteOn( note2, nFrame );
+		} else {
+			midi_noteOn( note2 );
+		}
 	}
 
-	AudioEngine::get_instance()->unlock(); // unlock the audio engine
 }
 
-float Hydrogen::getMasterPeak_L()
+CycleStats Hydrogen::readCycleStats()
 {
-	return m_fMasterPeak_L;
+	if ( m_pAudioClock == NULL ) {
+		CycleStats stats = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0 };
+		return stats;
+	}
+	return m_pAudioClock->read();
 }
 
-float Hydrogen::getMasterPeak_R()
+MeterValues Hydrogen::readMasterMeter()
 {
-	return m_fMasterPeak_R;
+	if ( m_pMasterMeter == NULL ) {
+		MeterValues values = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, Meter::LUFS_FLOOR };
+		return values;
+	}
+	return m_pMasterMeter->read();
 }
 
 unsigned long Hydrogen::getTickPosition()
@@ -2189,21 +2446,16 @@ unsigned long Hydrogen::getRealtimeTickPosition()
 	unsigned int initTick = ( unsigned int )( getRealtimeFrames() / m_pAudioDriver->m_transport.m_nTickSize );
 	unsigned long retTick;
 
-	struct timeval currtime;
-	struct timeval deltatime;
-
-	double sampleRate = ( double ) m_pAudioDriver->getSampleRate();
-	gettimeofday ( &currtime, NULL );
-
-	timersub( &currtime, &m_currentTickTime, &deltatime );
+	// frames played since the start of the cycle, from the filtered audio clock
+	double fFrames = m_pAudioClock->framesSinceCycleStart( Clock::now() );
+	if ( fFrames < 0.0 ) {
+		fFrames = 0.0;
+	}
 
 	// add a buffers worth for jitter resistance
-	double deltaSec =
-			( double ) deltatime.tv_sec
-			+ ( deltatime.tv_usec / 1000000.0 )
-			+ ( m_pAudioDriver->getBufferSize() / ( double )sampleRate );
+	fFrames += m_pAudioDriver->getBufferSize();
 
-	retTick = ( unsigned long ) ( ( sampleRate / ( double ) m_pAudioDriver->m_transport.m_nTickSize ) * deltaSec );
+	retTick = ( unsigned long ) ( fFrames / m_pAudioDriver->m_transport.m_nTickSize );
 
 	retTick += initTick;
 
@@ -2281,6 +2533,11 @@ void Hydrogen::startExportSong( const QString& filename, int rate, int depth )
 	Preferences *pPref = Preferences::get_instance();
 
 	Song* pSong = getSong();
+
+	// the export runs faster than the loader, it must not fall back on other layers
+	LayerLoader::get_instance()->prefetch( pSong );
+	LayerLoader::get_instance()->wait();
+
 	m_oldEngineMode = pSong->get_mode();
 	m_bOldLoopEnabled = pSong->is_loop_enabled();
 
@@ -2372,14 +2629,14 @@ MidiOutput* Hydrogen::getMidiOutput()
 	return m_pMidiDriverOut;
 }
 
-void Hydrogen::setMasterPeak_L( float value )
+MidiClockSlave* Hydrogen::getMidiClockSlave()
 {
-	m_fMasterPeak_L = value;
+	return m_pMidiClockSlave;
 }
 
-void Hydrogen::setMasterPeak_R( float value )
+AudioClock* Hydrogen::getAudioClock()
 {
-	m_fMasterPeak_R = value;
+	return m_pAudioClock;
 }
 
 int Hydrogen::getState()
@@ -2506,6 +2763,8 @@ int Hydrogen::loadDrumkit( Drumkit *pDrumkitInfo )
 
 	m_audioEngineState = old_ae_state;
 
+	LayerLoader::get_instance()->prefetch( getSong() );
+
 	return 0;	//ok
 }
 
@@ -2680,6 +2939,11 @@ void Hydrogen::setPatternPos( int pos )
 void Hydrogen::getLadspaFXPeak( int nFX, float *fL, float *fR )
 {
 #ifdef H2CORE_HAVE_LADSPA
+	if ( nFX < 0 || nFX >= ( int )m_fFXPeak_L.size() ) {
+		( *fL ) = 0;
+		( *fR ) = 0;
+		return;
+	}
 	( *fL ) = m_fFXPeak_L[nFX];
 	( *fR ) = m_fFXPeak_R[nFX];
 #else
@@ -2691,6 +2955,9 @@ void Hydrogen::getLadspaFXPeak( int nFX, float *fL, float *fR )
 void Hydrogen::setLadspaFXPeak( int nFX, float fL, float fR )
 {
 #ifdef H2CORE_HAVE_LADSPA
+	if ( nFX < 0 || nFX >= ( int )m_fFXPeak_L.size() ) {
+		return;
+	}
 	m_fFXPeak_L[nFX] = fL;
 	m_fFXPeak_R[nFX] = fR;
 #endif
@@ -2698,23 +2965,17 @@ void Hydrogen::setLadspaFXPeak( int nFX, float fL, float fR )
 
 void Hydrogen::onTapTempoAccelEvent()
 {
-#ifndef WIN32
 	INFOLOG( "tap tempo" );
-	static timeval oldTimeVal;
-
-	struct timeval now;
-	gettimeofday(&now, NULL);
+	static double fOldTime = 0.0;
 
-	float fInterval =
-			(now.tv_sec - oldTimeVal.tv_sec) * 1000.0
-			+ (now.tv_usec - oldTimeVal.tv_usec) / 1000.0;
+	double fNow = Clock::now();
+	float fInterval = ( fNow - fOldTime ) * 1000.0;
 
-	oldTimeVal = now;
+	fOldTime = fNow;
 
 	if ( fInterval < 1000.0 ) {
 		setTapTempo( fInterval );
 	}
-#endif
 }
 
 void Hydrogen::setTapTempo( float fInterval )
@@ -2789,6 +3050,116 @@ void Hydrogen::setBPM( float fBPM )
 	setNewBpmJTM ( fBPM );
 }
 
+/// stretch the sample of a layer, from the parameters of its current sample
+class RubberbandJob : public WorkerPool::Job
+{
+public:
+	RubberbandJob( Sample* pSample, Sample** ppResult )
+		: m_sFilepath( pSample->get_filepath() )
+		, m_loops( pSample->get_loops() )
+		, m_rubberband( pSample->get_rubberband() )
+		, m_velocity( *pSample->get_velocity_envelope() )
+		, m_pan( *pSample->get_pan_envelope() )
+		, m_ppResult( ppResult )
+	{
+	}
+	void run()
+	{
+		*m_ppResult = Sample::load( m_sFilepath, m_loops, m_rubberband, m_velocity, m_pan );
+	}
+private:
+	QString m_sFilepath;
+	Sample::Loops m_loops;
+	Sample::Rubberband m_rubberband;
+	Sample::VelocityEnvelope m_velocity;
+	Sample::PanEnvelope m_pan;
+	Sample** m_ppResult;
+};
+
+/// append the layers of the song whose sample is stretched, the audio engine must be locked
+static void rubberbandLayers( Song* pSong, std::vector<InstrumentLayer*>& layers )
+{
+	InstrumentList* pInstrList = pSong->get_instrument_list();
+	for ( int nInstr = 0; nInstr < pInstrList->size(); nInstr++ ) {
+		std::vector<InstrumentComponent*>* pComponents = pInstrList->get( nInstr )->get_components();
+		for ( std::vector<InstrumentComponent*>::iterator it = pComponents->begin(); it != pComponents->end(); ++it ) {
+			for ( int nLayer = 0; nLayer < MAX_LAYERS; nLayer++ ) {
+				InstrumentLayer* pLayer = ( *it )->get_layer( nLayer );
+				if ( pLayer && pLayer->get_sample() && pLayer->get_sample()->get_rubberband().use ) {
+					layers.push_back( pLayer );
+				}
+			}
+		}
+	}
+}
+
+int Hydrogen::recalculateRubberband( float fBpm )
+{
+	QMutexLocker rubberbandLock( &mutex_Rubberband );
+	setNewBpmJTM( fBpm );
+	Song* pSong = getSong();
+	if ( pSong == NULL ) {
+		return 0;
+	}
+
+	std::vector<InstrumentLayer*> layers;
+	std::vector<Sample*> oldSamples;
+	std::vector<WorkerPool::Job*> jobs;
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
+	rubberbandLayers( pSong, layers );
+	std::vector<Sample*> newSamples( layers.size(), ( Sample* )NULL );
+	for ( unsigned i = 0; i < layers.size(); i++ ) {
+		oldSamples.push_back( layers[i]->get_sample() );
+		jobs.push_back( new RubberbandJob( oldSamples[i], &newSamples[i] ) );
+	}
+	AudioEngine::get_instance()->unlock();
+	if ( layers.empty() ) {
+		return 0;
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+	{
+		WorkerPool pool;
+		for ( unsigned i = 0; i < jobs.size(); i++ ) {
+			pool.add( jobs[i] );
+		}
+		pool.wait();
+	}
+
+	// the song may have changed meanwhile, only the layers still in it get their sample
+	std::vector<InstrumentLayer*> currentLayers;
+	std::map<InstrumentLayer*, int> indexes;
+	for ( unsigned i = 0; i < layers.size(); i++ ) {
+		indexes[ layers[i] ] = i;
+	}
+	int nStretched = 0;
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
+	if ( getSong() == pSong ) {
+		rubberbandLayers( pSong, currentLayers );
+	}
+	for ( unsigned i = 0; i < currentLayers.size(); i++ ) {
+		std::map<InstrumentLayer*, int>::iterator it = indexes.find( currentLayers[i] );
+		if ( it == indexes.end() ) {
+			continue;
+		}
+		int n = it->second;
+		if ( newSamples[n] && currentLayers[i]->get_sample() == oldSamples[n] ) {
+			currentLayers[i]->set_sample( newSamples[n] );
+			// the old one is deleted below
+			newSamples[n] = oldSamples[n];
+			nStretched++;
+		}
+	}
+	AudioEngine::get_instance()->unlock();
+	for ( unsigned i = 0; i < newSamples.size(); i++ ) {
+		delete newSamples[i];
+	}
+
+	INFOLOG( QString( "%1 layers stretched to %2 bpm in %3 ms" ).arg( nStretched ).arg( fBpm ).arg( timer.elapsed() ) );
+	return nStretched;
+}
+
 void Hydrogen::restartLadspaFX()
 {
 	if ( m_pAudioDriver ) {
@@ -2904,27 +3275,20 @@ void Hydrogen::handleBeatCounter()
 {
 	// Get first time value:
 	if (m_nBeatCount == 1)
-		gettimeofday(&m_CurrentTime,NULL);
+		m_fCurrentTime = Clock::now();
 
 	m_nEventCount++;
 
-	// Set wm_LastTime to wm_CurrentTime to remind the time:
-	m_LastTime = m_CurrentTime;
+	// Set m_fLastTime to m_fCurrentTime to remind the time:
+	m_fLastTime = m_fCurrentTime;
 
 	// Get new time:
-	gettimeofday(&m_CurrentTime,NULL);
+	m_fCurrentTime = Clock::now();
 
 
 	// Build doubled time difference:
-	m_nLastBeatTime = (double)(
-				m_LastTime.tv_sec
-				+ (double)(m_LastTime.tv_usec * US_DIVIDER)
-				+ (int)m_nCoutOffset * .0001
-				);
-	m_nCurrentBeatTime = (double)(
-				m_CurrentTime.tv_sec
-				+ (double)(m_CurrentTime.tv_usec * US_DIVIDER)
-				);
+	m_nLastBeatTime = m_fLastTime + (int)m_nCoutOffset * .0001;
+	m_nCurrentBeatTime = m_fCurrentTime;
 	m_nBeatDiff = m_nBeatCount == 1 ? 0 : m_nCurrentBeatTime - m_nLastBeatTime;
 
 	//if differences are to big reset the beatconter
@@ -3179,6 +3543,88 @@ unsigned int Hydrogen::__getMidiRealtimeNoteTickPosition()
 	return m_naddrealtimenotetickposition;
 }
 
+bool Hydrogen::postMidiNote( const TimedNoteQueue::MidiNote& note )
+{
+	return m_pTimedNoteQueue->post( note );
+}
+
+void Hydrogen::__playMidiNote( const TimedNoteQueue::MidiNote& note, uint32_t nFrame )
+{
+	Preferences* pPref = Preferences::get_instance();
+	Song* pSong = getSong();
+	if ( pSong == NULL ) {
+		return;
+	}
+	InstrumentList* pInstrList = pSong->get_instrument_list();
+	Sampler* pSampler = AudioEngine::get_instance()->get_sampler();
+
+	if ( note.bNoteOff ) {
+		int nInstrument = std::max( 0, std::min( note.nNote - 36, MAX_INSTRUMENTS - 1 ) );
+		Instrument* pInstr = pInstrList->get( nInstrument );
+		unsigned long nNoteLength = getTickPosition() - m_nMidiNoteOnTick;
+
+		float fStep = 1;
+		if ( pPref->__playselectedinstrument ) {
+			fStep = pow( 1.0594630943593, ( note.nNote - 36 ) );
+			nInstrument = getSelectedInstrumentNumber();
+			pInstr = pInstrList->get( nInstrument );
+		}
+
+		if ( !pSampler->is_instrument_playing( pInstr ) ) {
+			return;
+		}
+		if ( pPref->__playselectedinstrument ) {
+			pSampler->midi_keyboard_note_off( note.nNote );
+		} else {
+			if ( pInstrList->size() < nInstrument + 1 ) {
+				return;
+			}
+			Note *pOffNote = new Note( pInstr, 0.0, 0.0, 0.0, 0.0, -1, 0 );
+			pOffNote->set_note_off( true );
+			pSampler->note_on( pOffNote );
+			delete pOffNote;
+		}
+		if ( pPref->getRecordEvents() ) {
+			pSampler->setPlayingNotelength( pInstr, nNoteLength * fStep, m_nMidiNoteOnTick );
+		}
+		return;
+	}
+
+	static const float fPan_L = 0.5f;
+	static const float fPan_R = 0.5f;
+
+	int nInstrument = note.nNote - 36;
+	if ( nInstrument < 0 && !pPref->__playselectedinstrument ) {
+		// in drumkit mode the notes below 36 are dropped
+		return;
+	}
+	if ( nInstrument > ( MAX_INSTRUMENTS - 1 ) ) {
+		nInstrument = MAX_INSTRUMENTS - 1;
+	}
+
+	/*
+	 * Only look to change instrument if the current note is actually of
+	 * hihat and hihat openess is outside the instrument selected
+	 */
+	Instrument *pInstr = pInstrList->get( nInstrument );
+	int nOpenness = note.nHihatOpenness;
+	if ( pInstr != NULL && pInstr->is_hihat()
+		 && ( nOpenness < pInstr->get_lower_cc() || nOpenness > pInstr->get_higher_cc() ) ) {
+		for ( int i = 0; i < pInstrList->size(); i++ ) {
+			Instrument *pContestant = pInstrList->get( i );
+			if ( pContestant != NULL && pContestant->is_hihat()
+				 && nOpenness >= pContestant->get_lower_cc()
+				 && nOpenness <= pContestant->get_higher_cc() ) {
+				nInstrument = i;
+				break;
+			}
+		}
+	}
+
+	__addRealtimeNote( nInstrument, note.fVelocity, fPan_L, fPan_R, false, true, note.nNote, nFrame );
+	m_nMidiNoteOnTick = m_naddrealtimenotetickposition;
+}
+
 
 // Get TimelineBPM for Pos
 float Hydrogen::getTimelineBpm( int Beat )
@@ -36,10 +36,14 @@
 #include <hydrogen/Preferences.h>
 #include <hydrogen/timeline.h>
 #include <hydrogen/basics/song.h>
+#include <hydrogen/basics/song_snapshot.h>
 #include <hydrogen/basics/drumkit.h>
 #include <hydrogen/basics/sample.h>
 #include <hydrogen/helpers/filesystem.h>
+#include <hydrogen/helpers/sound_library_index.h>
+#include <hydrogen/helpers/xml.h>
 #include <hydrogen/fx/Effects.h>
+#include <hydrogen/smf/SMF.h>
 
 #include <algorithm>
 #include <cassert>
@@ -48,6 +52,7 @@
 #include <sys/stat.h>
 
 #include <QDir>
+#include <QFileInfo>
 #include <QApplication>
 #include <QVector>
 #include <QDomDocument>
@@ -99,68 +104,91 @@ Pattern* LocalFileMng::loadPattern( const QString& directory )
 	}
 
 
-	QDomDocument doc  = LocalFileMng::openXmlDocument( patternInfoFile );
-	QFile file( patternInfoFile );
-
-	// root element
-	QDomNode rootNode = doc.firstChildElement( "drumkit_pattern" );	// root element
-	if (  rootNode.isNull() ) {
+	XMLReader reader;
+	if ( !reader.read( patternInfoFile, "drumkit_pattern" ) ) {
 		ERRORLOG( "Error reading Pattern: Pattern_drumkit_infonode not found" );
 		return NULL;
 	}
+	while ( reader.readNextStartElement() && !reader.name_is( "pattern" ) ) {
+		reader.skipCurrentElement();
+	}
+	pPattern = new Pattern( "", "", "", -1 );
+
+	while ( reader.readNextStartElement() ) {
+		if ( reader.name_is( "pattern_name" ) ) {
+			pPattern->set_name( reader.read_string( "" ) );
+		} else if ( reader.name_is( "info" ) ) {
+			pPattern->set_info( reader.read_string( "" ) );
+		} else if ( reader.name_is( "category" ) ) {
+			pPattern->set_category( reader.read_string( "" ) );
+		} else if ( reader.name_is( "size" ) ) {
+			pPattern->set_length( reader.read_int( -1 ) );
+		} else if ( reader.name_is( "noteList" ) ) {
+			// new code  :)
+			while ( reader.readNextStartElement() ) {
+				if ( !reader.name_is( "note" ) ) {
+					reader.skipCurrentElement();
+					continue;
+				}
+				unsigned nPosition = 0;
+				float fLeadLag = 0.0;
+				float fVelocity = 0.8f;
+				float fPan_L = 0.5;
+				float fPan_R = 0.5;
+				int nLength = -1;
+				float nPitch = 0.0;
+				QString sKey = "C0";
+				bool noteoff = false;
+				int instrId = 0;
+				while ( reader.readNextStartElement() ) {
+					if ( reader.name_is( "position" ) ) {
+						nPosition = reader.read_int( 0 );
+					} else if ( reader.name_is( "leadlag" ) ) {
+						fLeadLag = reader.read_float( 0.0 );
+					} else if ( reader.name_is( "velocity" ) ) {
+						fVelocity = reader.read_float( 0.8f );
+					} else if ( reader.name_is( "pan_L" ) ) {
+						fPan_L = reader.read_float( 0.5 );
+					} else if ( reader.name_is( "pan_R" ) ) {
+						fPan_R = reader.read_float( 0.5 );
+					} else if ( reader.name_is( "length" ) ) {
+						nLength = reader.read_int( -1 );
+					} else if ( reader.name_is( "pitch" ) ) {
+						nPitch = reader.read_float( 0.0 );
+					} else if ( reader.name_is( "key" ) ) {
+						sKey = reader.read_string( "C0" );
+					} else if ( reader.name_is( "note_off" ) ) {
+						noteoff = ( reader.read_string( "false" ) == "true" );
+					} else if ( reader.name_is( "instrument" ) ) {
+						instrId = reader.read_int( 0 );
+					} else {
+						reader.skipCurrentElement();
+					}
+				}
 
-	QDomNode patternNode = rootNode.firstChildElement( "pattern" );
-
-	QString sName( LocalFileMng::readXmlString( patternNode,"pattern_name", "" ) );
-	QString sInfo( LocalFileMng::readXmlString( patternNode,"info", "" ) );
-	QString sCategory( LocalFileMng::readXmlString( patternNode,"category", "" ) );
-
-
-	int nSize = -1;
-	nSize = LocalFileMng::readXmlInt( patternNode, "size",nSize ,false,false );
-	pPattern = new Pattern( sName, sInfo, sCategory, nSize );
-
-
+				Instrument *instrRef = instrList->find( instrId );
+				if ( !instrRef ) {
+					ERRORLOG( QString( "Instrument with ID: '%1' not found. Note skipped." ).arg( instrId ) );
+					continue;
+				}
 
-	QDomNode pNoteListNode = patternNode.firstChildElement( "noteList" );
-	if ( ! pNoteListNode.isNull() )
-	{
-		// new code  :)
-		QDomNode noteNode = pNoteListNode.firstChildElement( "note" );
-		while (  ! noteNode.isNull()  )
-		{
-			Note* pNote = NULL;
-			unsigned nPosition = LocalFileMng::readXmlInt( noteNode, "position", 0 );
-			float fLeadLag = LocalFileMng::readXmlFloat( noteNode, "leadlag", 0.0 , false , false);
-			float fVelocity = LocalFileMng::readXmlFloat( noteNode, "velocity", 0.8f );
-			float fPan_L = LocalFileMng::readXmlFloat( noteNode, "pan_L", 0.5 );
-			float fPan_R = LocalFileMng::readXmlFloat( noteNode, "pan_R", 0.5 );
-			int nLength = LocalFileMng::readXmlInt( noteNode, "length", -1, true );
-			float nPitch = LocalFileMng::readXmlFloat( noteNode, "pitch", 0.0, false, false );
-			QString sKey = LocalFileMng::readXmlString( noteNode, "key", "C0", false, false );
-			QString nNoteOff = LocalFileMng::readXmlString( noteNode, "note_off", "false", false, false );
-			int instrId = LocalFileMng::readXmlInt( noteNode, "instrument", 0, true );
-
-			Instrument *instrRef = instrList->find( instrId );
-			if ( !instrRef ) {
-				ERRORLOG( QString( "Instrument with ID: '%1' not found. Note skipped." ).arg( instrId ) );
-				noteNode = noteNode.nextSiblingElement( "note" );
-				continue;
+				Note* pNote = new Note( instrRef, nPosition, fVelocity, fPan_L, fPan_R, nLength, nPitch);
+				pNote->set_key_octave( sKey );
+				pNote->set_lead_lag(fLeadLag);
+				pNote->set_note_off( noteoff );
+				pPattern->insert_note( pNote );
 			}
-			//assert( instrRef );
-			bool noteoff = false;
-			if ( nNoteOff == "true" )
-				noteoff = true;
-
-			pNote = new Note( instrRef, nPosition, fVelocity, fPan_L, fPan_R, nLength, nPitch);
-			pNote->set_key_octave( sKey );
-			pNote->set_lead_lag(fLeadLag);
-			pNote->set_note_off( noteoff );
-			pPattern->insert_note( pNote );
-			noteNode = noteNode.nextSiblingElement( "note" );
+		} else {
+			reader.skipCurrentElement();
 		}
 	}
 
+	if ( reader.hasError() ) {
+		ERRORLOG( QString( "Error reading Pattern: %1" ).arg( reader.errorString() ) );
+		delete pPattern;
+		return NULL;
+	}
+
 	return pPattern;
 
 }
@@ -577,19 +605,16 @@ std::vector<QString> LocalFileMng::getAllPatternNames()
 {
 	std::vector<QString> alllist;
 
-	for (uint i = 0; i < m_allPatternList.size(); ++i) {
-		QString patternInfoFile =  m_allPatternList[i];
+	// the metadata comes from the index, only the modified patterns are read
+	SoundLibraryIndex index;
+	index.update();
 
-		QDomDocument doc  = LocalFileMng::openXmlDocument( patternInfoFile );
-
-		QDomNode rootNode =  doc.firstChildElement( "drumkit_pattern" );	// root element
-		if ( rootNode.isNull() ) {
+	for (uint i = 0; i < m_allPatternList.size(); ++i) {
+		const SoundLibraryIndex::PatternInfo* pInfo = index.find_pattern( m_allPatternList[i] );
+		if ( pInfo == NULL ) {
 			ERRORLOG( "Error reading Pattern: Pattern_drumkit_info node not found ");
 		}else{
-			QDomNode patternNode = rootNode.firstChildElement( "pattern" );
-
-			QString sPatternName( LocalFileMng::readXmlString( patternNode,"pattern_name", "" ) );
-			alllist.push_back(sPatternName);
+			alllist.push_back( pInfo->name );
 		}
 
 	}
@@ -607,19 +632,16 @@ std::vector<QString> LocalFileMng::getAllCategoriesFromPattern()
 	Preferences *pPref = H2Core::Preferences::get_instance();
 	std::list<QString>::const_iterator cur_testpatternCategories;
 
+	SoundLibraryIndex index;
+	index.update();
+
 	std::vector<QString> categorylist;
 	for (uint i = 0; i < m_allPatternList.size(); ++i) {
-		QString patternInfoFile =  m_allPatternList[i];
-		QDomDocument doc  = LocalFileMng::openXmlDocument( patternInfoFile );
-
-
-		QDomNode rootNode = doc.firstChildElement( "drumkit_pattern" );	// root element
-		if ( rootNode.isNull() ) {
+		const SoundLibraryIndex::PatternInfo* pInfo = index.find_pattern( m_allPatternList[i] );
+		if ( pInfo == NULL ) {
 			ERRORLOG( "Error reading Pattern: Pattern_drumkit_info node not found ");
 		}else{
-			QDomNode patternNode = rootNode.firstChildElement( "pattern" );
-			QString sCategoryName( LocalFileMng::readXmlString( patternNode,"category", "" ) );
-
+			QString sCategoryName( pInfo->category );
 
 			if ( sCategoryName.isEmpty() ){
 				sCategoryName = "No category";
@@ -774,6 +796,30 @@ int  LocalFileMng::mergeAllPatternList( std::vector<QString> current )
 }
 
 
+/**
+ * Append the notes of a Standard MIDI File to a song, one column per bar.
+ * The notes are mapped to the instruments by their MIDI out note, the
+ * tempo of the file, if any, becomes the tempo of the song.
+ * \param song The song to import into.
+ * \param filename The MIDI file.
+ * \return 0 on success.
+ */
+int LocalFileMng::importMidiFile( Song *song, const QString& filename )
+{
+	SMFReader reader;
+	if ( !reader.load( filename ) ) {
+		return 1;
+	}
+
+	if ( reader.getBPM() > 0 ) {
+		song->__bpm = reader.getBPM();
+	}
+	reader.createPatterns( song, QFileInfo( filename ).completeBaseName() );
+	song->set_is_modified( true );
+	return 0;
+}
+
+
 /**
  * Save the currently loaded playlist to disk.
  * \param playlist_name The filename of the output file.
@@ -1222,332 +1268,17 @@ QString prepare_filename( QString fname)
 	return fname;
 }
 
-// Returns 0 on success, passes the TinyXml error code otherwise.
+// Returns 0 on success, 1 otherwise.
 int SongWriter::writeSong( Song *song, const QString& filename )
 {
 	INFOLOG( "Saving song " + filename );
 	int rv = 0; // return value
 
-	// FIXME: has the file write-permssion?
-	// FIXME: verificare che il file non sia gia' esistente
-	// FIXME: effettuare copia di backup per il file gia' esistente
-
-
-	QDomDocument doc;
-	QDomProcessingInstruction header = doc.createProcessingInstruction( "xml", "version=\"1.0\" encoding=\"UTF-8\"");
-	doc.appendChild( header );
-
-	QDomNode songNode = doc.createElement( "song" );
-
-	LocalFileMng::writeXmlString( songNode, "version", QString( get_version().c_str() ) );
-	LocalFileMng::writeXmlString( songNode, "bpm", QString("%1").arg( song->__bpm ) );
-	LocalFileMng::writeXmlString( songNode, "volume", QString("%1").arg( song->get_volume() ) );
-	LocalFileMng::writeXmlString( songNode, "metronomeVolume", QString("%1").arg( song->get_metronome_volume() ) );
-	LocalFileMng::writeXmlString( songNode, "name", song->__name );
-	LocalFileMng::writeXmlString( songNode, "author", song->__author );
-	LocalFileMng::writeXmlString( songNode, "notes", song->get_notes() );
-	LocalFileMng::writeXmlString( songNode, "license", song->get_license() );
-	LocalFileMng::writeXmlBool( songNode, "loopEnabled", song->is_loop_enabled() );
-	LocalFileMng::writeXmlBool( songNode, "patternModeMode", Preferences::get_instance()->patternModePlaysSelected());
-
-	if ( song->get_mode() == Song::SONG_MODE ) {
-		LocalFileMng::writeXmlString( songNode, "mode", QString( "song" ) );
-	} else {
-		LocalFileMng::writeXmlString( songNode, "mode", QString( "pattern" ) );
-	}
-
-	LocalFileMng::writeXmlString( songNode, "humanize_time", QString("%1").arg( song->get_humanize_time_value() ) );
-	LocalFileMng::writeXmlString( songNode, "humanize_velocity", QString("%1").arg( song->get_humanize_velocity_value() ) );
-	LocalFileMng::writeXmlString( songNode, "swing_factor", QString("%1").arg( song->get_swing_factor() ) );
-
-    // component List
-    QDomNode componentListNode = doc.createElement( "componentList" );
-    for (std::vector<DrumkitComponent*>::iterator it = song->get_components()->begin() ; it != song->get_components()->end(); ++it) {
-        DrumkitComponent* pCompo = *it;
-
-        QDomNode componentNode = doc.createElement( "drumkitComponent" );
-
-        LocalFileMng::writeXmlString( componentNode, "id", QString("%1").arg( pCompo->get_id() ) );
-        LocalFileMng::writeXmlString( componentNode, "name", pCompo->get_name() );
-        LocalFileMng::writeXmlString( componentNode, "volume", QString("%1").arg( pCompo->get_volume() ) );
-
-        componentListNode.appendChild( componentNode );
-    }
-    songNode.appendChild( componentListNode );
-
-	// instrument list
-	QDomNode instrumentListNode = doc.createElement( "instrumentList" );
-	unsigned nInstrument = song->get_instrument_list()->size();
-
-	// INSTRUMENT NODE
-	for ( unsigned i = 0; i < nInstrument; i++ ) {
-		Instrument *instr = song->get_instrument_list()->get( i );
-		assert( instr );
-
-		QDomNode instrumentNode = doc.createElement( "instrument" );
-
-		LocalFileMng::writeXmlString( instrumentNode, "id", QString("%1").arg( instr->get_id() ) );
-		LocalFileMng::writeXmlString( instrumentNode, "name", instr->get_name() );
-		LocalFileMng::writeXmlString( instrumentNode, "drumkit", instr->get_drumkit_name() );
-		LocalFileMng::writeXmlString( instrumentNode, "volume", QString("%1").arg( instr->get_volume() ) );
-		LocalFileMng::writeXmlBool( instrumentNode, "isMuted", instr->is_muted() );
-		LocalFileMng::writeXmlString( instrumentNode, "pan_L", QString("%1").arg( instr->get_pan_l() ) );
-		LocalFileMng::writeXmlString( instrumentNode, "pan_R", QString("%1").arg( instr->get_pan_r() ) );
-		LocalFileMng::writeXmlString( instrumentNode, "gain", QString("%1").arg( instr->get_gain() ) );
-
-		LocalFileMng::writeXmlBool( instrumentNode, "filterActive", instr->is_filter_active() );
-		LocalFileMng::writeXmlString( instrumentNode, "filterCutoff", QString("%1").arg( instr->get_filter_cutoff() ) );
-		LocalFileMng::writeXmlString( instrumentNode, "filterResonance", QString("%1").arg( instr->get_filter_resonance() ) );
-
-		LocalFileMng::writeXmlString( instrumentNode, "FX1Level", QString("%1").arg( instr->get_fx_level( 0 ) ) );
-		LocalFileMng::writeXmlString( instrumentNode, "FX2Level", QString("%1").arg( instr->get_fx_level( 1 ) ) );
-		LocalFileMng::writeXmlString( instrumentNode, "FX3Level", QString("%1").arg( instr->get_fx_level( 2 ) ) );
-		LocalFileMng::writeXmlString( instrumentNode, "FX4Level", QString("%1").arg( instr->get_fx_level( 3 ) ) );
-
-		assert( instr->get_adsr() );
-		LocalFileMng::writeXmlString( instrumentNode, "Attack", QString("%1").arg( instr->get_adsr()->get_attack() ) );
-		LocalFileMng::writeXmlString( instrumentNode, "Decay", QString("%1").arg( instr->get_adsr()->get_decay() ) );
-		LocalFileMng::writeXmlString( instrumentNode, "Sustain", QString("%1").arg( instr->get_adsr()->get_sustain() ) );
-		LocalFileMng::writeXmlString( instrumentNode, "Release", QString("%1").arg( instr->get_adsr()->get_release() ) );
-
-		LocalFileMng::writeXmlString( instrumentNode, "randomPitchFactor", QString("%1").arg( instr->get_random_pitch_factor() ) );
-
-		LocalFileMng::writeXmlString( instrumentNode, "muteGroup", QString("%1").arg( instr->get_mute_group() ) );
-		LocalFileMng::writeXmlBool( instrumentNode, "isStopNote", instr->is_stop_notes() );
-
-		LocalFileMng::writeXmlString( instrumentNode, "midiOutChannel", QString("%1").arg( instr->get_midi_out_channel() ) );
-		LocalFileMng::writeXmlString( instrumentNode, "midiOutNote", QString("%1").arg( instr->get_midi_out_note() ) );
-
-        for (std::vector<InstrumentComponent*>::iterator it = instr->get_components()->begin() ; it != instr->get_components()->end(); ++it) {
-            InstrumentComponent* pComponent = *it;
-
-            QDomNode componentNode = doc.createElement( "instrumentComponent" );
-
-            LocalFileMng::writeXmlString( componentNode, "component_id", QString("%1").arg( pComponent->get_drumkit_componentID() ) );
-            LocalFileMng::writeXmlString( componentNode, "gain", QString("%1").arg( pComponent->get_gain() ) );
-
-            for ( unsigned nLayer = 0; nLayer < MAX_LAYERS; nLayer++ ) {
-                InstrumentLayer *pLayer = pComponent->get_layer( nLayer );
-
-                if ( pLayer == NULL ) continue;
-                Sample *pSample = pLayer->get_sample();
-                if ( pSample == NULL ) continue;
-
-                bool sIsModified = pSample->get_is_modified();
-                Sample::Loops lo = pSample->get_loops();
-                Sample::Rubberband ro = pSample->get_rubberband();
-                QString sMode = pSample->get_loop_mode_string();
-
-
-                QDomNode layerNode = doc.createElement( "layer" );
-                LocalFileMng::writeXmlString( layerNode, "filename", prepare_filename( pSample->get_filepath() ) );
-                LocalFileMng::writeXmlBool( layerNode, "ismodified", sIsModified);
-                LocalFileMng::writeXmlString( layerNode, "smode", pSample->get_loop_mode_string() );
-                LocalFileMng::writeXmlString( layerNode, "startframe", QString("%1").arg( lo.start_frame ) );
-                LocalFileMng::writeXmlString( layerNode, "loopframe", QString("%1").arg( lo.loop_frame ) );
-                LocalFileMng::writeXmlString( layerNode, "loops", QString("%1").arg( lo.count ) );
-                LocalFileMng::writeXmlString( layerNode, "endframe", QString("%1").arg( lo.end_frame ) );
-                LocalFileMng::writeXmlString( layerNode, "userubber", QString("%1").arg( ro.use ) );
-                LocalFileMng::writeXmlString( layerNode, "rubberdivider", QString("%1").arg( ro.divider ) );
-                LocalFileMng::writeXmlString( layerNode, "rubberCsettings", QString("%1").arg( ro.c_settings ) );
-                LocalFileMng::writeXmlString( layerNode, "rubberPitch", QString("%1").arg( ro.pitch ) );
-                LocalFileMng::writeXmlString( layerNode, "min", QString("%1").arg( pLayer->get_start_velocity() ) );
-                LocalFileMng::writeXmlString( layerNode, "max", QString("%1").arg( pLayer->get_end_velocity() ) );
-                LocalFileMng::writeXmlString( layerNode, "gain", QString("%1").arg( pLayer->get_gain() ) );
-                LocalFileMng::writeXmlString( layerNode, "pitch", QString("%1").arg( pLayer->get_pitch() ) );
-
-
-                Sample::VelocityEnvelope* velocity = pSample->get_velocity_envelope();
-                for (int y = 0; y < velocity->size(); y++){
-                    QDomNode volumeNode = doc.createElement( "volume" );
-                    LocalFileMng::writeXmlString( volumeNode, "volume-position", QString("%1").arg( velocity->at(y).frame ) );
-                    LocalFileMng::writeXmlString( volumeNode, "volume-value", QString("%1").arg( velocity->at(y).value ) );
-                    layerNode.appendChild( volumeNode );
-                }
-
-                Sample::PanEnvelope* pan = pSample->get_pan_envelope();
-                for (int y = 0; y < pan->size(); y++){
-                    QDomNode panNode = doc.createElement( "pan" );
-                    LocalFileMng::writeXmlString( panNode, "pan-position", QString("%1").arg( pan->at(y).frame ) );
-                    LocalFileMng::writeXmlString( panNode, "pan-value", QString("%1").arg( pan->at(y).value ) );
-                    layerNode.appendChild( panNode );
-                }
-
-                componentNode.appendChild( layerNode );
-            }
-            instrumentNode.appendChild( componentNode );
-        }
-
-		instrumentListNode.appendChild( instrumentNode );
-	}
-	songNode.appendChild( instrumentListNode );
-
-
-	// pattern list
-	QDomNode patternListNode = doc.createElement( "patternList" );
-
-	unsigned nPatterns = song->get_pattern_list()->size();
-	for ( unsigned i = 0; i < nPatterns; i++ ) {
-		Pattern *pat = song->get_pattern_list()->get( i );
-
-		// pattern
-		QDomNode patternNode = doc.createElement( "pattern" );
-		LocalFileMng::writeXmlString( patternNode, "name", pat->get_name() );
-		LocalFileMng::writeXmlString( patternNode, "category", pat->get_category() );
-		LocalFileMng::writeXmlString( patternNode, "size", QString("%1").arg( pat->get_length() ) );
-		LocalFileMng::writeXmlString( patternNode, "info", pat->get_info() );
-
-		QDomNode noteListNode = doc.createElement( "noteList" );
-		const Pattern::notes_t* notes = pat->get_notes();
-		FOREACH_NOTE_CST_IT_BEGIN_END(notes,it) {
-			Note *pNote = it->second;
-			assert( pNote );
-
-			QDomNode noteNode = doc.createElement( "note" );
-			LocalFileMng::writeXmlString( noteNode, "position", QString("%1").arg( pNote->get_position() ) );
-			LocalFileMng::writeXmlString( noteNode, "leadlag", QString("%1").arg( pNote->get_lead_lag() ) );
-			LocalFileMng::writeXmlString( noteNode, "velocity", QString("%1").arg( pNote->get_velocity() ) );
-			LocalFileMng::writeXmlString( noteNode, "pan_L", QString("%1").arg( pNote->get_pan_l() ) );
-			LocalFileMng::writeXmlString( noteNode, "pan_R", QString("%1").arg( pNote->get_pan_r() ) );
-			LocalFileMng::writeXmlString( noteNode, "pitch", QString("%1").arg( pNote->get_pitch() ) );
-
-			LocalFileMng::writeXmlString( noteNode, "key", pNote->key_to_string() );
-
-			LocalFileMng::writeXmlString( noteNode, "length", QString("%1").arg( pNote->get_length() ) );
-			LocalFileMng::writeXmlString( noteNode, "instrument", QString("%1").arg( pNote->get_instrument()->get_id() ) );
-
-			QString noteoff = "false";
-			if ( pNote->get_note_off() ) noteoff = "true";
-			LocalFileMng::writeXmlString( noteNode, "note_off", noteoff );
-			noteListNode.appendChild( noteNode );
-
-		}
-		patternNode.appendChild( noteListNode );
-
-		patternListNode.appendChild( patternNode );
-	}
-	songNode.appendChild( patternListNode );
-
-	QDomNode virtualPatternListNode = doc.createElement( "virtualPatternList" );
-	for ( unsigned i = 0; i < nPatterns; i++ ) {
-		Pattern *pat = song->get_pattern_list()->get( i );
-
-		// pattern
-		if (pat->get_virtual_patterns()->empty() == false) {
-			QDomNode patternNode = doc.createElement( "pattern" );
-			LocalFileMng::writeXmlString( patternNode, "name", pat->get_name() );
-
-			for (Pattern::virtual_patterns_it_t  virtIter = pat->get_virtual_patterns()->begin(); virtIter != pat->get_virtual_patterns()->end(); ++virtIter) {
-				LocalFileMng::writeXmlString( patternNode, "virtual", (*virtIter)->get_name() );
-			}//for
-
-			virtualPatternListNode.appendChild( patternNode );
-		}//if
-	}//for
-	songNode.appendChild(virtualPatternListNode);
-
-	// pattern sequence
-	QDomNode patternSequenceNode = doc.createElement( "patternSequence" );
-
-	unsigned nPatternGroups = song->get_pattern_group_vector()->size();
-	for ( unsigned i = 0; i < nPatternGroups; i++ ) {
-		QDomNode groupNode = doc.createElement( "group" );
-
-		PatternList *pList = ( *song->get_pattern_group_vector() )[i];
-		for ( unsigned j = 0; j < pList->size(); j++ ) {
-			Pattern *pPattern = pList->get( j );
-			LocalFileMng::writeXmlString( groupNode, "patternID", pPattern->get_name() );
-		}
-		patternSequenceNode.appendChild( groupNode );
-	}
-
-	songNode.appendChild( patternSequenceNode );
-
-
-	// LADSPA FX
-	QDomNode ladspaFxNode = doc.createElement( "ladspa" );
-
-	for ( unsigned nFX = 0; nFX < MAX_FX; nFX++ ) {
-		QDomNode fxNode = doc.createElement( "fx" );
-
-#ifdef H2CORE_HAVE_LADSPA
-		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
-		if ( pFX ) {
-			LocalFileMng::writeXmlString( fxNode, "name", pFX->getPluginLabel() );
-			LocalFileMng::writeXmlString( fxNode, "filename", pFX->getLibraryPath() );
-			LocalFileMng::writeXmlBool( fxNode, "enabled", pFX->isEnabled() );
-			LocalFileMng::writeXmlString( fxNode, "volume", QString("%1").arg( pFX->getVolume() ) );
-			for ( unsigned nControl = 0; nControl < pFX->inputControlPorts.size(); nControl++ ) {
-				LadspaControlPort *pControlPort = pFX->inputControlPorts[ nControl ];
-				QDomNode controlPortNode = doc.createElement( "inputControlPort" );
-				LocalFileMng::writeXmlString( controlPortNode, "name", pControlPort->sName );
-				LocalFileMng::writeXmlString( controlPortNode, "value", QString("%1").arg( pControlPort->fControlValue ) );
-				fxNode.appendChild( controlPortNode );
-			}
-			for ( unsigned nControl = 0; nControl < pFX->outputControlPorts.size(); nControl++ ) {
-				LadspaControlPort *pControlPort = pFX->inputControlPorts[ nControl ];
-				QDomNode controlPortNode = doc.createElement( "outputControlPort" );
-				LocalFileMng::writeXmlString( controlPortNode, "name", pControlPort->sName );
-				LocalFileMng::writeXmlString( controlPortNode, "value", QString("%1").arg( pControlPort->fControlValue ) );
-				fxNode.appendChild( controlPortNode );
-			}
-		}
-#else
-		if ( false ) {
-		}
-#endif
-		else {
-			LocalFileMng::writeXmlString( fxNode, "name", QString( "no plugin" ) );
-			LocalFileMng::writeXmlString( fxNode, "filename", QString( "-" ) );
-			LocalFileMng::writeXmlBool( fxNode, "enabled", false );
-			LocalFileMng::writeXmlString( fxNode, "volume", "0.0" );
-		}
-		ladspaFxNode.appendChild( fxNode );
-	}
-
-	songNode.appendChild( ladspaFxNode );
-	doc.appendChild( songNode );
-
-
-	//bpm time line
-	Timeline * pTimeline = Hydrogen::get_instance()->getTimeline();
-
-	QDomNode bpmTimeLine = doc.createElement( "BPMTimeLine" );
-
-	if(pTimeline->m_timelinevector.size() >= 1 ){
-		for ( int t = 0; t < static_cast<int>(pTimeline->m_timelinevector.size()); t++){
-			QDomNode newBPMNode = doc.createElement( "newBPM" );
-			LocalFileMng::writeXmlString( newBPMNode, "BAR",QString("%1").arg( pTimeline->m_timelinevector[t].m_htimelinebeat ));
-			LocalFileMng::writeXmlString( newBPMNode, "BPM", QString("%1").arg( pTimeline->m_timelinevector[t].m_htimelinebpm  ) );
-			bpmTimeLine.appendChild( newBPMNode );
-		}
-	}
-	songNode.appendChild( bpmTimeLine );
-
-	//time line tag
-	QDomNode timeLineTag = doc.createElement( "timeLineTag" );
-	if(pTimeline->m_timelinetagvector.size() >= 1 ){
-		for ( int t = 0; t < static_cast<int>(pTimeline->m_timelinetagvector.size()); t++){
-			QDomNode newTAGNode = doc.createElement( "newTAG" );
-			LocalFileMng::writeXmlString( newTAGNode, "BAR",QString("%1").arg( pTimeline->m_timelinetagvector[t].m_htimelinetagbeat ));
-			LocalFileMng::writeXmlString( newTAGNode, "TAG", QString("%1").arg( pTimeline->m_timelinetagvector[t].m_htimelinetag  ) );
-			timeLineTag.appendChild( newTAGNode );
-		}
-	}
-	songNode.appendChild( timeLineTag );
-
-	QFile file(filename);
-	if ( !file.open(QIODevice::WriteOnly) )
+	// the XML is written from a snapshot of the song, like the SongSaver thread does
+	QByteArray xml = SongSnapshot::to_xml( SongSnapshot::encode( song, SongSnapshot::current_settings() ), true );
+	if ( xml.isEmpty() || !Filesystem::write_atomic( filename, xml ) )
 		rv = 1;
 
-	QTextStream TextStream( &file );
-	doc.save( TextStream, 1 );
-
-	if( file.size() == 0)
-		rv = 1;
-
-	file.close();
-
 	if( rv ) {
 		WARNINGLOG("File save reported an error.");
 	} else {
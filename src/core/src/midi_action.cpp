@@ -100,8 +100,10 @@ const char* MidiAction::__class_name = "MidiAction";
 MidiAction::MidiAction( QString typeString ) : Object( __class_name ) {
 
 	type = typeString;
-	QString parameter1 = "0";
-	QString parameter2 = "0" ;
+	__parameter1_value = 0;
+	__parameter2_value = 0;
+	__parameter2_from_value = false;
+	__handler_id = -1;
 }
 
 /**
@@ -191,6 +193,51 @@ MidiActionManager::MidiActionManager() : Object( __class_name )
 			  << "NOTE"
 			  << "CC"
 			  << "PROGRAM_CHANGE";
+
+	registerHandler( "NOTHING", &MidiActionManager::nothing );
+	registerHandler( "PLAY", &MidiActionManager::play );
+	registerHandler( "PLAY/STOP_TOGGLE", &MidiActionManager::playStopToggle );
+	registerHandler( "PLAY/PAUSE_TOGGLE", &MidiActionManager::playPauseToggle );
+	registerHandler( "PAUSE", &MidiActionManager::pause );
+	registerHandler( "STOP", &MidiActionManager::stop );
+	registerHandler( "MUTE", &MidiActionManager::mute );
+	registerHandler( "UNMUTE", &MidiActionManager::unmute );
+	registerHandler( "MUTE_TOGGLE", &MidiActionManager::muteToggle );
+	registerHandler( "BEATCOUNTER", &MidiActionManager::beatcounter );
+	registerHandler( "TAP_TEMPO", &MidiActionManager::tapTempo );
+	registerHandler( "SELECT_NEXT_PATTERN", &MidiActionManager::selectNextPattern );
+	registerHandler( "SELECT_NEXT_PATTERN_RELATIVE", &MidiActionManager::selectNextPatternRelative );
+	registerHandler( "SELECT_PREV_PATTERN_RELATIVE", &MidiActionManager::selectPrevPatternRelative );
+	registerHandler( "SELECT_NEXT_PATTERN_CC_ABSOLUT", &MidiActionManager::selectNextPatternCcAbsolute );
+	registerHandler( "SELECT_NEXT_PATTERN_PROMPTLY", &MidiActionManager::selectNextPatternPromptly );
+	registerHandler( "SELECT_AND_PLAY_PATTERN", &MidiActionManager::selectAndPlayPattern );
+	registerHandler( "SELECT_INSTRUMENT", &MidiActionManager::selectInstrument );
+	registerHandler( "EFFECT1_LEVEL_ABSOLUTE", &MidiActionManager::effect1LevelAbsolute );
+	registerHandler( "EFFECT2_LEVEL_ABSOLUTE", &MidiActionManager::effect2LevelAbsolute );
+	registerHandler( "EFFECT3_LEVEL_ABSOLUTE", &MidiActionManager::effect3LevelAbsolute );
+	registerHandler( "EFFECT4_LEVEL_ABSOLUTE", &MidiActionManager::effect4LevelAbsolute );
+	registerHandler( "MASTER_VOLUME_RELATIVE", &MidiActionManager::masterVolumeRelative );
+	registerHandler( "MASTER_VOLUME_ABSOLUTE", &MidiActionManager::masterVolumeAbsolute );
+	registerHandler( "STRIP_VOLUME_RELATIVE", &MidiActionManager::stripVolumeRelative );
+	registerHandler( "STRIP_VOLUME_ABSOLUTE", &MidiActionManager::stripVolumeAbsolute );
+	registerHandler( "PAN_ABSOLUTE", &MidiActionManager::panAbsolute );
+	registerHandler( "PAN_RELATIVE", &MidiActionManager::panRelative );
+	registerHandler( "BPM_CC_RELATIVE", &MidiActionManager::bpmCcRelative );
+	registerHandler( "BPM_FINE_CC_RELATIVE", &MidiActionManager::bpmFineCcRelative );
+	registerHandler( "BPM_INCR", &MidiActionManager::bpmIncr );
+	registerHandler( "BPM_DECR", &MidiActionManager::bpmDecr );
+	registerHandler( ">>_NEXT_BAR", &MidiActionManager::nextBar );
+	registerHandler( "<<_PREVIOUS_BAR", &MidiActionManager::previousBar );
+	registerHandler( "PLAYLIST_SONG", &MidiActionManager::playlistSong );
+	registerHandler( "PLAYLIST_NEXT_SONG", &MidiActionManager::playlistNextSong );
+	registerHandler( "PLAYLIST_PREV_SONG", &MidiActionManager::playlistPrevSong );
+	registerHandler( "RECORD_READY", &MidiActionManager::recordReady );
+	registerHandler( "RECORD/STROBE_TOGGLE", &MidiActionManager::recordStrobeToggle );
+	registerHandler( "RECORD_STROBE", &MidiActionManager::recordStrobe );
+	registerHandler( "RECORD_EXIT", &MidiActionManager::recordExit );
+	registerHandler( "TOGGLE_METRONOME", &MidiActionManager::toggleMetronome );
+	registerHandler( "UNDO_ACTION", &MidiActionManager::undoAction );
+	registerHandler( "REDO_ACTION", &MidiActionManager::redoAction );
 }
 
 
@@ -206,631 +253,619 @@ void MidiActionManager::create_instance()
 	}
 }
 
+void MidiActionManager::registerHandler( const QString& sType, action_f handler )
+{
+	actionHandlerIds[ sType ] = actionHandlers.size();
+	actionHandlers.push_back( handler );
+}
+
+int MidiActionManager::resolveHandler( const QString& sType )
+{
+	std::map<QString, int>::const_iterator it = actionHandlerIds.find( sType );
+	if ( it == actionHandlerIds.end() ) {
+		return 0;
+	}
+	return it->second;
+}
+
 /**
  * The handleAction method is the heard of the MidiActionManager class.
  * It executes the operations that are needed to carry the desired action.
+ *
+ * The handler of an action is looked up by its type on the first call
+ * only, after that the action is dispatched through the index it keeps.
+ * The midi map replaces its actions when it changes, so the index is
+ * never stale.
  */
 bool MidiActionManager::handleAction( MidiAction * pAction ){
 
-	Hydrogen *pEngine = Hydrogen::get_instance();
-
 	/*
 		return false if action is null
 		(for example if no Action exists for an event)
 	*/
 	if( pAction == NULL )	return false;
 
-	QString sActionString = pAction->getType();
-
-
-	if( sActionString == "PLAY" )
-	{
-		int nState = pEngine->getState();
-		if ( nState == STATE_READY ){
-			pEngine->sequencer_play();
-		}
-		return true;
+	int nId = pAction->getHandlerId();
+	if ( nId < 0 ) {
+		nId = resolveHandler( pAction->getType() );
+		pAction->setHandlerId( nId );
 	}
 
-	if( sActionString == "PLAY/STOP_TOGGLE" || sActionString == "PLAY/PAUSE_TOGGLE" )
-	{
-		int nState = pEngine->getState();
-		switch ( nState )
-		{
-		case STATE_READY:
-			pEngine->sequencer_play();
-			break;
-
-		case STATE_PLAYING:
-			if( sActionString == "PLAY/STOP_TOGGLE" ) pEngine->setPatternPos( 0 );
-			pEngine->sequencer_stop();
-			pEngine->setTimelineBpm();
-			break;
-
-		default:
-			ERRORLOG( "[Hydrogen::ActionManager(PLAY): Unhandled case" );
-		}
+	return ( this->*actionHandlers[ nId ] )( pAction );
+}
 
-		return true;
-	}
+bool MidiActionManager::nothing( MidiAction* )
+{
+	return false;
+}
 
-	if( sActionString == "PAUSE" )
-	{
-		pEngine->sequencer_stop();
-		return true;
+bool MidiActionManager::play( MidiAction* )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	int nState = pEngine->getState();
+	if ( nState == STATE_READY ){
+		pEngine->sequencer_play();
 	}
+	return true;
+}
 
-	if( sActionString == "STOP" )
+bool MidiActionManager::togglePlay( bool bRewind )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	int nState = pEngine->getState();
+	switch ( nState )
 	{
+	case STATE_READY:
+		pEngine->sequencer_play();
+		break;
+
+	case STATE_PLAYING:
+		if( bRewind ) pEngine->setPatternPos( 0 );
 		pEngine->sequencer_stop();
-		pEngine->setPatternPos( 0 );
 		pEngine->setTimelineBpm();
-		return true;
-	}
-
-	if( sActionString == "MUTE" ){
-		//mutes the master, not a single strip
-		pEngine->getSong()->__is_muted = true;
-		return true;
-	}
-
-	if( sActionString == "UNMUTE" ){
-		pEngine->getSong()->__is_muted = false;
-		return true;
-	}
-
-	if( sActionString == "MUTE_TOGGLE" ){
-		pEngine->getSong()->__is_muted = !Hydrogen::get_instance()->getSong()->__is_muted;
-		return true;
-	}
+		break;
 
-	if( sActionString == "BEATCOUNTER" ){
-		pEngine->handleBeatCounter();
-		return true;
+	default:
+		ERRORLOG( "[Hydrogen::ActionManager(PLAY): Unhandled case" );
 	}
 
-	if( sActionString == "TAP_TEMPO" ){
-		pEngine->onTapTempoAccelEvent();
-		return true;
-	}
+	return true;
+}
 
-	if( sActionString == "SELECT_NEXT_PATTERN" ){
-		bool ok;
-		int row = pAction->getParameter1().toInt(&ok,10);
-		if( row> pEngine->getSong()->get_pattern_list()->size() -1 ){
-			return false;
-		}
+bool MidiActionManager::playStopToggle( MidiAction* )
+{
+	return togglePlay( true );
+}
 
-		if(Preferences::get_instance()->patternModePlaysSelected()){
-			pEngine->setSelectedPatternNumber( row );
-		}
-		else
-		{
-			pEngine->sequencer_setNextPattern( row );
-		}
+bool MidiActionManager::playPauseToggle( MidiAction* )
+{
+	return togglePlay( false );
+}
 
-		return true;
-	}
+bool MidiActionManager::pause( MidiAction* )
+{
+	Hydrogen::get_instance()->sequencer_stop();
+	return true;
+}
 
-	if( sActionString == "SELECT_NEXT_PATTERN_RELATIVE" ){
+bool MidiActionManager::stop( MidiAction* )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	pEngine->sequencer_stop();
+	pEngine->setPatternPos( 0 );
+	pEngine->setTimelineBpm();
+	return true;
+}
 
-		bool ok;
+bool MidiActionManager::mute( MidiAction* )
+{
+	//mutes the master, not a single strip
+	Hydrogen::get_instance()->getSong()->__is_muted = true;
+	return true;
+}
 
-		if(!Preferences::get_instance()->patternModePlaysSelected())
-		{
-			return true;
-		}
+bool MidiActionManager::unmute( MidiAction* )
+{
+	Hydrogen::get_instance()->getSong()->__is_muted = false;
+	return true;
+}
 
-		int row = pEngine->getSelectedPatternNumber() + pAction->getParameter1().toInt(&ok,10);
+bool MidiActionManager::muteToggle( MidiAction* )
+{
+	Song *pSong = Hydrogen::get_instance()->getSong();
+	pSong->__is_muted = !pSong->__is_muted;
+	return true;
+}
 
-		if( row> pEngine->getSong()->get_pattern_list()->size() -1 )
-		{
-			return false;
-		}
+bool MidiActionManager::beatcounter( MidiAction* )
+{
+	Hydrogen::get_instance()->handleBeatCounter();
+	return true;
+}
 
-		pEngine->setSelectedPatternNumber( row );
+bool MidiActionManager::tapTempo( MidiAction* )
+{
+	Hydrogen::get_instance()->onTapTempoAccelEvent();
+	return true;
+}
 
-		return true;
+bool MidiActionManager::selectNextPattern( MidiAction* pAction )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	int row = pAction->getParameter1Value();
+	if( row> pEngine->getSong()->get_pattern_list()->size() -1 ){
+		return false;
 	}
 
-	if( sActionString == "SELECT_PREV_PATTERN_RELATIVE" ){
-		bool ok;
-		if(!Preferences::get_instance()->patternModePlaysSelected())
-			return true;
-		int row = pEngine->getSelectedPatternNumber() - pAction->getParameter1().toInt(&ok,10);
-		if( row < 0 )
-			return false;
-
+	if(Preferences::get_instance()->patternModePlaysSelected()){
 		pEngine->setSelectedPatternNumber( row );
-		return true;
 	}
-
-	if( sActionString == "SELECT_NEXT_PATTERN_CC_ABSOLUT" ){
-		bool ok;
-		int row = pAction->getParameter2().toInt(&ok,10);
-		if( row> pEngine->getSong()->get_pattern_list()->size() -1 )
-			return false;
-		if(Preferences::get_instance()->patternModePlaysSelected())
-			pEngine->setSelectedPatternNumber( row );
-		else
-			return true;// only usefully in normal pattern mode
-		return true;
-	}
-
-	if( sActionString == "SELECT_NEXT_PATTERN_PROMPTLY" ){// obsolete, use SELECT_NEXT_PATTERN_CC_ABSOLUT instead
-		bool ok;
-		int row = pAction->getParameter2().toInt(&ok,10);
-		pEngine->setSelectedPatternNumberWithoutGuiEvent( row );
-		return true;
-	}
-
-	if( sActionString == "SELECT_AND_PLAY_PATTERN"){
-		bool ok;
-		int row = pAction->getParameter1().toInt(&ok,10);
-		pEngine->setSelectedPatternNumber( row );
+	else
+	{
 		pEngine->sequencer_setNextPattern( row );
+	}
 
-		int nState = pEngine->getState();
-		if ( nState == STATE_READY ){
-			pEngine->sequencer_play();
-		}
+	return true;
+}
 
-		return true;
-	}
+bool MidiActionManager::selectNextPatternRelative( MidiAction* pAction )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
 
-	if( sActionString == "SELECT_INSTRUMENT" ){
-		bool ok;
-		int  instrument_number = pAction->getParameter2().toInt(&ok,10) ;
-		if ( pEngine->getSong()->get_instrument_list()->size() < instrument_number )
-			instrument_number = pEngine->getSong()->get_instrument_list()->size() -1;
-		pEngine->setSelectedInstrumentNumber( instrument_number );
+	if(!Preferences::get_instance()->patternModePlaysSelected())
+	{
 		return true;
 	}
 
-	if( sActionString == "EFFECT1_LEVEL_ABSOLUTE" ){
-		bool ok;
-		int nLine = pAction->getParameter1().toInt(&ok,10);
-		int fx_param = pAction->getParameter2().toInt(&ok,10);
-		setAbsoluteFXLevel( nLine, 0 , fx_param );
-	}
-
-	if( sActionString == "EFFECT2_LEVEL_ABSOLUTE" ){
-		bool ok;
-		int nLine = pAction->getParameter1().toInt(&ok,10);
-		int fx_param = pAction->getParameter2().toInt(&ok,10);
-		setAbsoluteFXLevel( nLine, 1 , fx_param );
-	}
+	int row = pEngine->getSelectedPatternNumber() + pAction->getParameter1Value();
 
-	if( sActionString == "EFFECT3_LEVEL_ABSOLUTE" ){
-		bool ok;
-		int nLine = pAction->getParameter1().toInt(&ok,10);
-		int fx_param = pAction->getParameter2().toInt(&ok,10);
-		setAbsoluteFXLevel( nLine, 2 , fx_param );
+	if( row> pEngine->getSong()->get_pattern_list()->size() -1 )
+	{
+		return false;
 	}
 
-	if( sActionString == "EFFECT4_LEVEL_ABSOLUTE" ){
-		bool ok;
-		int nLine = pAction->getParameter1().toInt(&ok,10);
-		int fx_param = pAction->getParameter2().toInt(&ok,10);
-		setAbsoluteFXLevel( nLine, 3 , fx_param );
-	}
+	pEngine->setSelectedPatternNumber( row );
 
-	if( sActionString == "MASTER_VOLUME_RELATIVE" ){
-		//increments/decrements the volume of the whole song
+	return true;
+}
 
-		bool ok;
-		int vol_param = pAction->getParameter2().toInt(&ok,10);
+bool MidiActionManager::selectPrevPatternRelative( MidiAction* pAction )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	if(!Preferences::get_instance()->patternModePlaysSelected())
+		return true;
+	int row = pEngine->getSelectedPatternNumber() - pAction->getParameter1Value();
+	if( row < 0 )
+		return false;
 
-		Hydrogen *engine = Hydrogen::get_instance();
-		Song *song = engine->getSong();
+	pEngine->setSelectedPatternNumber( row );
+	return true;
+}
 
+bool MidiActionManager::selectNextPatternCcAbsolute( MidiAction* pAction )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	int row = pAction->getParameter2Value();
+	if( row> pEngine->getSong()->get_pattern_list()->size() -1 )
+		return false;
+	if(Preferences::get_instance()->patternModePlaysSelected())
+		pEngine->setSelectedPatternNumber( row );
+	else
+		return true;// only usefully in normal pattern mode
+	return true;
+}
 
+// obsolete, use SELECT_NEXT_PATTERN_CC_ABSOLUT instead
+bool MidiActionManager::selectNextPatternPromptly( MidiAction* pAction )
+{
+	Hydrogen::get_instance()->setSelectedPatternNumberWithoutGuiEvent( pAction->getParameter2Value() );
+	return true;
+}
 
-		if( vol_param != 0 ){
-			if ( vol_param == 1 && song->get_volume() < 1.5 ){
-				song->set_volume( song->get_volume() + 0.05 );
-			}  else  {
-				if( song->get_volume() >= 0.0 ){
-					song->set_volume( song->get_volume() - 0.05 );
-				}
-			}
-		} else {
-			song->set_volume( 0 );
-		}
+bool MidiActionManager::selectAndPlayPattern( MidiAction* pAction )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	int row = pAction->getParameter1Value();
+	pEngine->setSelectedPatternNumber( row );
+	pEngine->sequencer_setNextPattern( row );
 
+	int nState = pEngine->getState();
+	if ( nState == STATE_READY ){
+		pEngine->sequencer_play();
 	}
 
-	if( sActionString == "MASTER_VOLUME_ABSOLUTE" ){
-		//sets the volume of a master output to a given level (percentage)
-
-		bool ok;
-		int vol_param = pAction->getParameter2().toInt(&ok,10);
-
-
-		Hydrogen *engine = Hydrogen::get_instance();
-		Song *song = engine->getSong();
-
+	return true;
+}
 
-		if( vol_param != 0 ){
-			song->set_volume( 1.5* ( (float) (vol_param / 127.0 ) ));
-		} else {
-			song->set_volume( 0 );
-		}
+bool MidiActionManager::selectInstrument( MidiAction* pAction )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	int  instrument_number = pAction->getParameter2Value();
+	if ( pEngine->getSong()->get_instrument_list()->size() < instrument_number )
+		instrument_number = pEngine->getSong()->get_instrument_list()->size() -1;
+	pEngine->setSelectedInstrumentNumber( instrument_number );
+	return true;
+}
 
-	}
+bool MidiActionManager::effect1LevelAbsolute( MidiAction* pAction )
+{
+	return setAbsoluteFXLevel( pAction->getParameter1Value(), 0, pAction->getParameter2Value() );
+}
 
-	if( sActionString == "STRIP_VOLUME_RELATIVE" ){
-		//increments/decrements the volume of one mixer strip
+bool MidiActionManager::effect2LevelAbsolute( MidiAction* pAction )
+{
+	return setAbsoluteFXLevel( pAction->getParameter1Value(), 1, pAction->getParameter2Value() );
+}
 
-		bool ok;
-		int nLine = pAction->getParameter1().toInt(&ok,10);
-		int vol_param = pAction->getParameter2().toInt(&ok,10);
+bool MidiActionManager::effect3LevelAbsolute( MidiAction* pAction )
+{
+	return setAbsoluteFXLevel( pAction->getParameter1Value(), 2, pAction->getParameter2Value() );
+}
 
-		Hydrogen::get_instance()->setSelectedInstrumentNumber( nLine );
+bool MidiActionManager::effect4LevelAbsolute( MidiAction* pAction )
+{
+	return setAbsoluteFXLevel( pAction->getParameter1Value(), 3, pAction->getParameter2Value() );
+}
 
-		Hydrogen *engine = Hydrogen::get_instance();
-		Song *song = engine->getSong();
-		InstrumentList *instrList = song->get_instrument_list();
+bool MidiActionManager::masterVolumeRelative( MidiAction* pAction )
+{
+	//increments/decrements the volume of the whole song
 
-		Instrument *instr = instrList->get( nLine );
+	int vol_param = pAction->getParameter2Value();
 
-		if ( instr == NULL) return 0;
+	Song *song = Hydrogen::get_instance()->getSong();
 
-		if( vol_param != 0 ){
-			if ( vol_param == 1 && instr->get_volume() < 1.5 ){
-				instr->set_volume( instr->get_volume() + 0.1 );
-			}  else  {
-				if( instr->get_volume() >= 0.0 ){
-					instr->set_volume( instr->get_volume() - 0.1 );
-				}
+	if( vol_param != 0 ){
+		if ( vol_param == 1 && song->get_volume() < 1.5 ){
+			song->set_volume( song->get_volume() + 0.05 );
+		}  else  {
+			if( song->get_volume() >= 0.0 ){
+				song->set_volume( song->get_volume() - 0.05 );
 			}
-		} else {
-			instr->set_volume( 0 );
 		}
-
-		Hydrogen::get_instance()->setSelectedInstrumentNumber(nLine);
+	} else {
+		song->set_volume( 0 );
 	}
 
-	if( sActionString == "STRIP_VOLUME_ABSOLUTE" ){
-		//sets the volume of a mixer strip to a given level (percentage)
-
-		bool ok;
-		int nLine = pAction->getParameter1().toInt(&ok,10);
-		int vol_param = pAction->getParameter2().toInt(&ok,10);
-
-		Hydrogen::get_instance()->setSelectedInstrumentNumber( nLine );
-
-		Hydrogen *engine = Hydrogen::get_instance();
-		Song *song = engine->getSong();
-		InstrumentList *instrList = song->get_instrument_list();
+	return true;
+}
 
-		Instrument *instr = instrList->get( nLine );
+bool MidiActionManager::masterVolumeAbsolute( MidiAction* pAction )
+{
+	//sets the volume of a master output to a given level (percentage)
 
-		if ( instr == NULL) return 0;
+	int vol_param = pAction->getParameter2Value();
 
-		if( vol_param != 0 ){
-			instr->set_volume( 1.5* ( (float) (vol_param / 127.0 ) ));
-		} else {
-			instr->set_volume( 0 );
-		}
+	Song *song = Hydrogen::get_instance()->getSong();
 
-		Hydrogen::get_instance()->setSelectedInstrumentNumber(nLine);
+	if( vol_param != 0 ){
+		song->set_volume( 1.5* ( (float) (vol_param / 127.0 ) ));
+	} else {
+		song->set_volume( 0 );
 	}
 
-	if( sActionString == "PAN_ABSOLUTE" ){
-
-		// sets the absolute panning of a given mixer channel
-
-		bool ok;
-		int nLine = pAction->getParameter1().toInt(&ok,10);
-		int pan_param = pAction->getParameter2().toInt(&ok,10);
-
-
-		float pan_L;
-		float pan_R;
-
-		Hydrogen *engine = Hydrogen::get_instance();
-		engine->setSelectedInstrumentNumber( nLine );
-		Song *song = engine->getSong();
-		InstrumentList *instrList = song->get_instrument_list();
-
-		Instrument *instr = instrList->get( nLine );
+	return true;
+}
 
-		if( instr == NULL )
-			return false;
+bool MidiActionManager::stripVolumeRelative( MidiAction* pAction )
+{
+	//increments/decrements the volume of one mixer strip
 
-		pan_L = instr->get_pan_l();
-		pan_R = instr->get_pan_r();
+	int nLine = pAction->getParameter1Value();
+	int vol_param = pAction->getParameter2Value();
 
-		// pan
-		float fPanValue = 0.0;
-		if (pan_R == 1.0) {
-			fPanValue = 1.0 - (pan_L / 2.0);
-		}
-		else {
-			fPanValue = pan_R / 2.0;
-		}
+	Hydrogen *engine = Hydrogen::get_instance();
+	engine->setSelectedInstrumentNumber( nLine );
 
+	Song *song = engine->getSong();
+	InstrumentList *instrList = song->get_instrument_list();
 
-		fPanValue = 1 * ( ((float) pan_param) / 127.0 );
+	Instrument *instr = instrList->get( nLine );
 
+	if ( instr == NULL) return false;
 
-		if (fPanValue >= 0.5) {
-			pan_L = (1.0 - fPanValue) * 2;
-			pan_R = 1.0;
-		}
-		else {
-			pan_L = 1.0;
-			pan_R = fPanValue * 2;
+	if( vol_param != 0 ){
+		if ( vol_param == 1 && instr->get_volume() < 1.5 ){
+			instr->set_volume( instr->get_volume() + 0.1 );
+		}  else  {
+			if( instr->get_volume() >= 0.0 ){
+				instr->set_volume( instr->get_volume() - 0.1 );
+			}
 		}
+	} else {
+		instr->set_volume( 0 );
+	}
 
+	engine->setSelectedInstrumentNumber(nLine);
 
-		instr->set_pan_l( pan_L );
-		instr->set_pan_r( pan_R );
-
-		Hydrogen::get_instance()->setSelectedInstrumentNumber(nLine);
+	return true;
+}
 
-		return true;
-	}
+bool MidiActionManager::stripVolumeAbsolute( MidiAction* pAction )
+{
+	//sets the volume of a mixer strip to a given level (percentage)
 
-	if( sActionString == "PAN_RELATIVE" ){
+	int nLine = pAction->getParameter1Value();
+	int vol_param = pAction->getParameter2Value();
 
-		// changes the panning of a given mixer channel
-		// this is useful if the panning is set by a rotary control knob
+	Hydrogen *engine = Hydrogen::get_instance();
+	engine->setSelectedInstrumentNumber( nLine );
 
-		bool ok;
-		int nLine = pAction->getParameter1().toInt(&ok,10);
-		int pan_param = pAction->getParameter2().toInt(&ok,10);
+	Song *song = engine->getSong();
+	InstrumentList *instrList = song->get_instrument_list();
 
-		float pan_L;
-		float pan_R;
+	Instrument *instr = instrList->get( nLine );
 
-		Hydrogen *engine = Hydrogen::get_instance();
-		engine->setSelectedInstrumentNumber( nLine );
-		Song *song = engine->getSong();
-		InstrumentList *instrList = song->get_instrument_list();
+	if ( instr == NULL) return false;
 
-		Instrument *instr = instrList->get( nLine );
+	if( vol_param != 0 ){
+		instr->set_volume( 1.5* ( (float) (vol_param / 127.0 ) ));
+	} else {
+		instr->set_volume( 0 );
+	}
 
-		if( instr == NULL )
-			return false;
+	engine->setSelectedInstrumentNumber(nLine);
 
-		pan_L = instr->get_pan_l();
-		pan_R = instr->get_pan_r();
+	return true;
+}
 
-		// pan
-		float fPanValue = 0.0;
-		if (pan_R == 1.0) {
-			fPanValue = 1.0 - (pan_L / 2.0);
-		}
-		else {
-			fPanValue = pan_R / 2.0;
-		}
+bool MidiActionManager::panAbsolute( MidiAction* pAction )
+{
+	// sets the absolute panning of a given mixer channel
 
-		if( pan_param == 1 && fPanValue < 1 ){
-			fPanValue += 0.05;
-		}
+	int nLine = pAction->getParameter1Value();
+	int pan_param = pAction->getParameter2Value();
 
-		if( pan_param != 1 && fPanValue > 0 ){
-			fPanValue -= 0.05;
-		}
+	float pan_L;
+	float pan_R;
 
-		if (fPanValue >= 0.5) {
-			pan_L = (1.0 - fPanValue) * 2;
-			pan_R = 1.0;
-		}
-		else {
-			pan_L = 1.0;
-			pan_R = fPanValue * 2;
-		}
+	Hydrogen *engine = Hydrogen::get_instance();
+	engine->setSelectedInstrumentNumber( nLine );
+	Song *song = engine->getSong();
+	InstrumentList *instrList = song->get_instrument_list();
 
+	Instrument *instr = instrList->get( nLine );
 
-		instr->set_pan_l( pan_L );
-		instr->set_pan_r( pan_R );
+	if( instr == NULL )
+		return false;
 
-		Hydrogen::get_instance()->setSelectedInstrumentNumber(nLine);
+	float fPanValue = 1 * ( ((float) pan_param) / 127.0 );
 
-		return true;
+	if (fPanValue >= 0.5) {
+		pan_L = (1.0 - fPanValue) * 2;
+		pan_R = 1.0;
+	}
+	else {
+		pan_L = 1.0;
+		pan_R = fPanValue * 2;
 	}
 
-	if( sActionString == "BPM_CC_RELATIVE" ){
-		/*
-		 * increments/decrements the BPM
-		 * this is useful if the bpm is set by a rotary control knob
-		*/
-
-		AudioEngine::get_instance()->lock( RIGHT_HERE );
-
-		int mult = 1;
+	instr->set_pan_l( pan_L );
+	instr->set_pan_r( pan_R );
 
-		//second parameter of cc command
-		//this value should be 1 to decrement and something other then 1 to increment the bpm
-		int cc_param = 1;
+	engine->setSelectedInstrumentNumber(nLine);
 
-		//this Action should be triggered only by CC commands
+	return true;
+}
 
-		bool ok;
-		mult = pAction->getParameter1().toInt(&ok,10);
-		cc_param = pAction->getParameter2().toInt(&ok,10);
+bool MidiActionManager::panRelative( MidiAction* pAction )
+{
+	// changes the panning of a given mixer channel
+	// this is useful if the panning is set by a rotary control knob
 
-		if( m_nLastBpmChangeCCParameter == -1)
-		{
-			m_nLastBpmChangeCCParameter = cc_param;
-		}
+	int nLine = pAction->getParameter1Value();
+	int pan_param = pAction->getParameter2Value();
 
-		Song* pSong = pEngine->getSong();
+	float pan_L;
+	float pan_R;
 
-		if ( m_nLastBpmChangeCCParameter >= cc_param && pSong->__bpm  < 300) {
-			pEngine->setBPM( pSong->__bpm - 1*mult );
-		}
+	Hydrogen *engine = Hydrogen::get_instance();
+	engine->setSelectedInstrumentNumber( nLine );
+	Song *song = engine->getSong();
+	InstrumentList *instrList = song->get_instrument_list();
 
-		if ( m_nLastBpmChangeCCParameter < cc_param && pSong->__bpm  > 40 ) {
-			pEngine->setBPM( pSong->__bpm + 1*mult );
-		}
+	Instrument *instr = instrList->get( nLine );
 
-		m_nLastBpmChangeCCParameter = cc_param;
+	if( instr == NULL )
+		return false;
 
-		AudioEngine::get_instance()->unlock();
+	pan_L = instr->get_pan_l();
+	pan_R = instr->get_pan_r();
 
-		return true;
+	// pan
+	float fPanValue = 0.0;
+	if (pan_R == 1.0) {
+		fPanValue = 1.0 - (pan_L / 2.0);
+	}
+	else {
+		fPanValue = pan_R / 2.0;
 	}
 
-	if( sActionString == "BPM_FINE_CC_RELATIVE" ){
-		/*
-		 * increments/decrements the BPM
-		 * this is useful if the bpm is set by a rotary control knob
-		 */
+	if( pan_param == 1 && fPanValue < 1 ){
+		fPanValue += 0.05;
+	}
 
-		AudioEngine::get_instance()->lock( RIGHT_HERE );
+	if( pan_param != 1 && fPanValue > 0 ){
+		fPanValue -= 0.05;
+	}
 
-		int mult = 1;
+	if (fPanValue >= 0.5) {
+		pan_L = (1.0 - fPanValue) * 2;
+		pan_R = 1.0;
+	}
+	else {
+		pan_L = 1.0;
+		pan_R = fPanValue * 2;
+	}
 
-		//second parameter of cc command
-		//this value should be 1 to decrement and something other then 1 to increment the bpm
-		int cc_param = 1;
+	instr->set_pan_l( pan_L );
+	instr->set_pan_r( pan_R );
 
-		//this Action should be triggered only by CC commands
+	engine->setSelectedInstrumentNumber(nLine);
 
-		bool ok;
-		mult = pAction->getParameter1().toInt(&ok,10);
-		cc_param = pAction->getParameter2().toInt(&ok,10);
+	return true;
+}
 
-		if( m_nLastBpmChangeCCParameter == -1)
-		{
-			m_nLastBpmChangeCCParameter = cc_param;
-		}
+/*
+ * increments/decrements the BPM
+ * this is useful if the bpm is set by a rotary control knob
+ */
+bool MidiActionManager::changeBpmCc( MidiAction* pAction, float fStep )
+{
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
 
-		Song* pSong = pEngine->getSong();
+	Hydrogen *pEngine = Hydrogen::get_instance();
 
-		if ( m_nLastBpmChangeCCParameter >= cc_param && pSong->__bpm  < 300) {
-			pEngine->setBPM( pSong->__bpm - 0.01*mult );
-		}
+	//this Action should be triggered only by CC commands
+	int mult = pAction->getParameter1Value();
 
-		if ( m_nLastBpmChangeCCParameter < cc_param && pSong->__bpm  > 40 ) {
-			pEngine->setBPM( pSong->__bpm + 0.01*mult );
-		}
+	//second parameter of cc command
+	//this value should be 1 to decrement and something other then 1 to increment the bpm
+	int cc_param = pAction->getParameter2Value();
 
+	if( m_nLastBpmChangeCCParameter == -1)
+	{
 		m_nLastBpmChangeCCParameter = cc_param;
-
-		AudioEngine::get_instance()->unlock();
-
-		return true;
 	}
 
-	if( sActionString == "BPM_INCR" ){
-		AudioEngine::get_instance()->lock( RIGHT_HERE );
+	Song* pSong = pEngine->getSong();
 
-		int mult = 1;
+	if ( m_nLastBpmChangeCCParameter >= cc_param && pSong->__bpm  < 300) {
+		pEngine->setBPM( pSong->__bpm - fStep*mult );
+	}
 
-		bool ok;
-		mult = pAction->getParameter1().toInt(&ok,10);
+	if ( m_nLastBpmChangeCCParameter < cc_param && pSong->__bpm  > 40 ) {
+		pEngine->setBPM( pSong->__bpm + fStep*mult );
+	}
 
+	m_nLastBpmChangeCCParameter = cc_param;
 
-		Song* pSong = pEngine->getSong();
-		if (pSong->__bpm  < 300) {
-			pEngine->setBPM( pSong->__bpm + 1*mult );
-		}
-		AudioEngine::get_instance()->unlock();
+	AudioEngine::get_instance()->unlock();
 
-		return true;
-	}
+	return true;
+}
 
-	if( sActionString == "BPM_DECR" ){
-		AudioEngine::get_instance()->lock( RIGHT_HERE );
+bool MidiActionManager::bpmCcRelative( MidiAction* pAction )
+{
+	return changeBpmCc( pAction, 1 );
+}
 
-		int mult = 1;
+bool MidiActionManager::bpmFineCcRelative( MidiAction* pAction )
+{
+	return changeBpmCc( pAction, 0.01 );
+}
 
-		bool ok;
-		mult = pAction->getParameter1().toInt(&ok,10);
+bool MidiActionManager::bpmIncr( MidiAction* pAction )
+{
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
 
-		Song* pSong = pEngine->getSong();
-		if (pSong->__bpm  > 40 ) {
-			pEngine->setBPM( pSong->__bpm - 1*mult );
-		}
-		AudioEngine::get_instance()->unlock();
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	int mult = pAction->getParameter1Value();
 
-		return true;
+	Song* pSong = pEngine->getSong();
+	if (pSong->__bpm  < 300) {
+		pEngine->setBPM( pSong->__bpm + 1*mult );
 	}
+	AudioEngine::get_instance()->unlock();
 
-	if( sActionString == ">>_NEXT_BAR"){
-		pEngine->setPatternPos(pEngine->getPatternPos() +1 );
-		pEngine->setTimelineBpm();
-		return true;
-	}
+	return true;
+}
 
-	if( sActionString == "<<_PREVIOUS_BAR"){
-		pEngine->setPatternPos(pEngine->getPatternPos() -1 );
-		pEngine->setTimelineBpm();
-		return true;
-	}
+bool MidiActionManager::bpmDecr( MidiAction* pAction )
+{
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
 
-	if( sActionString == "PLAYLIST_SONG"){
-		bool ok;
-		int songnumber = pAction->getParameter2().toInt(&ok,10);
-		return setSong( songnumber );
-	}
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	int mult = pAction->getParameter1Value();
 
-	if( sActionString == "PLAYLIST_NEXT_SONG"){
-		int songnumber = Playlist::get_instance()->getActiveSongNumber();
-		return setSong( ++songnumber );
+	Song* pSong = pEngine->getSong();
+	if (pSong->__bpm  > 40 ) {
+		pEngine->setBPM( pSong->__bpm - 1*mult );
 	}
+	AudioEngine::get_instance()->unlock();
 
-	if( sActionString == "PLAYLIST_PREV_SONG"){
-		int songnumber = Playlist::get_instance()->getActiveSongNumber();
-		return setSong( --songnumber );
-	}
+	return true;
+}
 
-	if( sActionString == "RECORD_READY"){
-		if ( pEngine->getState() != STATE_PLAYING ) {
-			if (!Preferences::get_instance()->getRecordEvents()) {
-				Preferences::get_instance()->setRecordEvents(true);
-			}
-			else {
-				Preferences::get_instance()->setRecordEvents(false);
-			}
-		}
-		return true;
-	}
-	if( sActionString == "RECORD/STROBE_TOGGLE"){
-		if (!Preferences::get_instance()->getRecordEvents()) {
-			Preferences::get_instance()->setRecordEvents(true);
-		}
-		else {
-			Preferences::get_instance()->setRecordEvents(false);
-		}
-		return true;
-	}
+bool MidiActionManager::nextBar( MidiAction* )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	pEngine->setPatternPos(pEngine->getPatternPos() +1 );
+	pEngine->setTimelineBpm();
+	return true;
+}
 
-	if( sActionString == "RECORD_STROBE"){
+bool MidiActionManager::previousBar( MidiAction* )
+{
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	pEngine->setPatternPos(pEngine->getPatternPos() -1 );
+	pEngine->setTimelineBpm();
+	return true;
+}
 
-		if (!Preferences::get_instance()->getRecordEvents()) {
-			Preferences::get_instance()->setRecordEvents(true);
-		}
-		return true;
-	}
+bool MidiActionManager::playlistSong( MidiAction* pAction )
+{
+	return setSong( pAction->getParameter2Value() );
+}
 
-	if( sActionString == "RECORD_EXIT"){
+bool MidiActionManager::playlistNextSong( MidiAction* )
+{
+	int songnumber = Playlist::get_instance()->getActiveSongNumber();
+	return setSong( ++songnumber );
+}
 
-		if (Preferences::get_instance()->getRecordEvents()) {
-			Preferences::get_instance()->setRecordEvents(false);
-		}
-		return true;
+bool MidiActionManager::playlistPrevSong( MidiAction* )
+{
+	int songnumber = Playlist::get_instance()->getActiveSongNumber();
+	return setSong( --songnumber );
+}
+
+bool MidiActionManager::recordReady( MidiAction* )
+{
+	if ( Hydrogen::get_instance()->getState() != STATE_PLAYING ) {
+		Preferences *pPref = Preferences::get_instance();
+		pPref->setRecordEvents( !pPref->getRecordEvents() );
 	}
+	return true;
+}
 
-	if( sActionString == "TOGGLE_METRONOME"){
+bool MidiActionManager::recordStrobeToggle( MidiAction* )
+{
+	Preferences *pPref = Preferences::get_instance();
+	pPref->setRecordEvents( !pPref->getRecordEvents() );
+	return true;
+}
 
-		Preferences::get_instance()->m_bUseMetronome = !Preferences::get_instance()->m_bUseMetronome;
-		return true;
+bool MidiActionManager::recordStrobe( MidiAction* )
+{
+	if (!Preferences::get_instance()->getRecordEvents()) {
+		Preferences::get_instance()->setRecordEvents(true);
 	}
+	return true;
+}
 
-	if( sActionString == "UNDO_ACTION"){
-		EventQueue::get_instance()->push_event( EVENT_UNDO_REDO, 0);// 0 = undo
-		return true;
+bool MidiActionManager::recordExit( MidiAction* )
+{
+	if (Preferences::get_instance()->getRecordEvents()) {
+		Preferences::get_instance()->setRecordEvents(false);
 	}
+	return true;
+}
 
-	if( sActionString == "REDO_ACTION"){
-		EventQueue::get_instance()->push_event( EVENT_UNDO_REDO, 1);// 1 = redo
-		return true;
-	}
-	return false;
+bool MidiActionManager::toggleMetronome( MidiAction* )
+{
+	Preferences::get_instance()->m_bUseMetronome = !Preferences::get_instance()->m_bUseMetronome;
+	return true;
+}
+
+bool MidiActionManager::undoAction( MidiAction* )
+{
+	EventQueue::get_instance()->push_event( EVENT_UNDO_REDO, 0);// 0 = undo
+	return true;
+}
+
+bool MidiActionManager::redoAction( MidiAction* )
+{
+	EventQueue::get_instance()->push_event( EVENT_UNDO_REDO, 1);// 1 = redo
+	return true;
 }
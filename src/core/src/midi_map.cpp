@@ -56,6 +56,10 @@ MidiMap::MidiMap()
 		__cc_array[ note ] = new MidiAction("NOTHING");
 	}
 	__pc_action = new MidiAction("NOTHING");
+
+	for( int i = 0; i < MMC_COMMANDS; i++ ) {
+		__mmc_array[ i ] = NULL;
+	}
 }
 
 MidiMap::~MidiMap()
@@ -105,6 +109,10 @@ void MidiMap::reset()
 	}
 	mmcMap.clear();
 
+	for( int i = 0; i < MMC_COMMANDS; i++ ) {
+		__mmc_array[ i ] = NULL;
+	}
+
 	int i;
 	for( i = 0 ; i < 128 ; ++i ) {
 		delete __note_array[ i ];
@@ -133,6 +141,11 @@ void MidiMap::registerMMCEvent( QString eventString , MidiAction* pAction )
 		delete mmcMap[ eventString ];
 	}
 	mmcMap[ eventString ] = pAction;
+
+	int nCommand = mmcCommand( eventString );
+	if( nCommand > 0 ) {
+		__mmc_array[ nCommand ] = pAction;
+	}
 }
 
 
@@ -184,6 +197,45 @@ MidiAction* MidiMap::getMMCAction( QString eventString )
 	return mmcMap[eventString];
 }
 
+/**
+ * Returns the mmc action which was linked to the given MMCCommand,
+ * without looking up the event string.
+ */
+MidiAction* MidiMap::getMMCAction( int nCommand )
+{
+	QMutexLocker mx(&__mutex);
+	if( nCommand <= 0 || nCommand >= MMC_COMMANDS ) {
+		return NULL;
+	}
+	return __mmc_array[ nCommand ];
+}
+
+/**
+ * \return the MMCCommand of an mmc event string, 0 if the event is unknown
+ */
+int MidiMap::mmcCommand( const QString& sEventString )
+{
+	static const char* eventStrings[ MMC_COMMANDS ] = {
+		NULL,
+		"MMC_STOP",
+		"MMC_PLAY",
+		"MMC_DEFERRED_PLAY",
+		"MMC_FAST_FORWARD",
+		"MMC_REWIND",
+		"MMC_RECORD_STROBE",
+		"MMC_RECORD_EXIT",
+		"MMC_RECORD_READY",
+		"MMC_PAUSE"
+	};
+
+	for( int i = 1; i < MMC_COMMANDS; i++ ) {
+		if( sEventString == eventStrings[ i ] ) {
+			return i;
+		}
+	}
+	return 0;
+}
+
 /**
  * Returns the note action which was linked to the given event.
  */
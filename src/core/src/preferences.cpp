@@ -85,7 +85,6 @@ Preferences::Preferences()
 
 	//rubberband bpm change queue
 	m_useTheRubberbandBpmChangeEvent = false;
-		__rubberBandCalcTime = 5;
 
 	QString rubberBandCLIPath = getenv( "PATH" );
 	QStringList rubberBandCLIPathList = rubberBandCLIPath.split(":");//linx use ":" as seperator. maybe windows and osx use other seperators
@@ -185,6 +184,8 @@ Preferences::Preferences()
 	m_bUseMetronome = false;
 	m_fMetronomeVolume = 0.5;
 	m_nMaxNotes = 256;
+	m_bLazyLayerLoading = true;
+	m_nFXSlots = MAX_FX;
 	m_nBufferSize = 1024;
 	m_nSampleRate = 44100;
 
@@ -197,6 +198,10 @@ Preferences::Preferences()
 	m_nMidiChannelFilter = -1;
 	m_bMidiNoteOffIgnore = false;
 	m_bMidiDiscardNoteAfterAction = false;
+	m_bMidiClockOutput = false;
+	m_bMidiTimecodeOutput = false;
+	m_nMidiSyncInput = 0;
+	m_nMidiThreadPriority = 40;
 
 	//___  alsa audio driver properties ___
 	m_sAlsaAudioDevice = QString("hw:0");
@@ -249,10 +254,6 @@ Preferences::Preferences()
 	songEditorProperties.set(10, 10, 600, 250, true);
 	drumkitManagerProperties.set(500, 20, 526, 437, true);
 	audioEngineInfoProperties.set(720, 120, 0, 0, false);
-	m_ladspaProperties[0].set(2, 20, 0, 0, false);
-	m_ladspaProperties[1].set(2, 20, 0, 0, false);
-	m_ladspaProperties[2].set(2, 20, 0, 0, false);
-	m_ladspaProperties[3].set(2, 20, 0, 0, false);
 
 	m_nColoringMethod = 0;
 	m_nColoringMethodAuxValue = 0;
@@ -473,6 +474,8 @@ void Preferences::loadPreferences( bool bGlobal )
 				m_bUseMetronome = LocalFileMng::readXmlBool( audioEngineNode, "use_metronome", m_bUseMetronome );
 				m_fMetronomeVolume = LocalFileMng::readXmlFloat( audioEngineNode, "metronome_volume", 0.5f );
 				m_nMaxNotes = LocalFileMng::readXmlInt( audioEngineNode, "maxNotes", m_nMaxNotes );
+				m_bLazyLayerLoading = LocalFileMng::readXmlBool( audioEngineNode, "lazy_layer_loading", m_bLazyLayerLoading );
+				m_nFXSlots = LocalFileMng::readXmlInt( audioEngineNode, "fx_slots", m_nFXSlots );
 				m_nBufferSize = LocalFileMng::readXmlInt( audioEngineNode, "buffer_size", m_nBufferSize );
 				m_nSampleRate = LocalFileMng::readXmlInt( audioEngineNode, "samplerate", m_nSampleRate );
 
@@ -535,6 +538,10 @@ void Preferences::loadPreferences( bool bGlobal )
 					m_sMidiPortName = LocalFileMng::readXmlString( midiDriverNode, "port_name", "None" );
 					m_nMidiChannelFilter = LocalFileMng::readXmlInt( midiDriverNode, "channel_filter", -1 );
 					m_bMidiNoteOffIgnore = LocalFileMng::readXmlBool( midiDriverNode, "ignore_note_off", true );
+					m_bMidiClockOutput = LocalFileMng::readXmlBool( midiDriverNode, "clock_output", false, false );
+					m_bMidiTimecodeOutput = LocalFileMng::readXmlBool( midiDriverNode, "timecode_output", false, false );
+					m_nMidiSyncInput = LocalFileMng::readXmlInt( midiDriverNode, "sync_input", 0, false, false );
+					m_nMidiThreadPriority = LocalFileMng::readXmlInt( midiDriverNode, "thread_priority", 40, false, false );
 				}
 
 
@@ -615,9 +622,9 @@ void Preferences::loadPreferences( bool bGlobal )
 				__expandSongItem = LocalFileMng::readXmlBool( guiNode, "expandSongItem", __expandSongItem );
 				__expandPatternItem = LocalFileMng::readXmlBool( guiNode, "expandPatternItem", __expandPatternItem );
 
-				for ( unsigned nFX = 0; nFX < MAX_FX; nFX++ ) {
+				for ( int nFX = 0; nFX < m_nFXSlots; nFX++ ) {
 					QString sNodeName = QString("ladspaFX_properties%1").arg( nFX );
-					setLadspaProperties( nFX, readWindowProperties( guiNode, sNodeName, m_ladspaProperties[nFX] ) );
+					setLadspaProperties( nFX, readWindowProperties( guiNode, sNodeName, getLadspaProperties( nFX ) ) );
 				}
 
 				QDomNode pUIStyle = guiNode.firstChildElement( "UI_Style" );
@@ -835,6 +842,8 @@ void Preferences::savePreferences()
 		LocalFileMng::writeXmlString( audioEngineNode, "use_metronome", m_bUseMetronome ? "true": "false" );
 		LocalFileMng::writeXmlString( audioEngineNode, "metronome_volume", QString("%1").arg( m_fMetronomeVolume ) );
 		LocalFileMng::writeXmlString( audioEngineNode, "maxNotes", QString("%1").arg( m_nMaxNotes ) );
+		LocalFileMng::writeXmlString( audioEngineNode, "lazy_layer_loading", m_bLazyLayerLoading ? "true": "false" );
+		LocalFileMng::writeXmlString( audioEngineNode, "fx_slots", QString("%1").arg( m_nFXSlots ) );
 		LocalFileMng::writeXmlString( audioEngineNode, "buffer_size", QString("%1").arg( m_nBufferSize ) );
 		LocalFileMng::writeXmlString( audioEngineNode, "samplerate", QString("%1").arg( m_nSampleRate ) );
 
@@ -914,6 +923,11 @@ void Preferences::savePreferences()
 			} else {
 				LocalFileMng::writeXmlString( midiDriverNode, "discard_note_after_action", "false" );
 			}
+
+			LocalFileMng::writeXmlBool( midiDriverNode, "clock_output", m_bMidiClockOutput );
+			LocalFileMng::writeXmlBool( midiDriverNode, "timecode_output", m_bMidiTimecodeOutput );
+			LocalFileMng::writeXmlString( midiDriverNode, "sync_input", QString("%1").arg( m_nMidiSyncInput ) );
+			LocalFileMng::writeXmlString( midiDriverNode, "thread_priority", QString("%1").arg( m_nMidiThreadPriority ) );
 		}
 		audioEngineNode.appendChild( midiDriverNode );
 
@@ -946,7 +960,7 @@ void Preferences::savePreferences()
 		writeWindowProperties( guiNode, "songEditor_properties", songEditorProperties );
 		writeWindowProperties( guiNode, "drumkitManager_properties", drumkitManagerProperties );
 		writeWindowProperties( guiNode, "audioEngineInfo_properties", audioEngineInfoProperties );
-		for ( unsigned nFX = 0; nFX < MAX_FX; nFX++ ) {
+		for ( unsigned nFX = 0; nFX < m_ladspaProperties.size(); nFX++ ) {
 			QString sNode = QString("ladspaFX_properties%1").arg( nFX );
 			writeWindowProperties( guiNode, sNode, m_ladspaProperties[nFX] );
 		}
@@ -35,6 +35,7 @@
 #include <hydrogen/basics/instrument_component.h>
 #include <hydrogen/basics/instrument_list.h>
 #include <hydrogen/basics/instrument_layer.h>
+#include <hydrogen/basics/layer_loader.h>
 #include <hydrogen/basics/note.h>
 #include <hydrogen/Preferences.h>
 #include <hydrogen/basics/sample.h>
@@ -59,6 +60,7 @@ Sampler::Sampler()
 		: Object( __class_name )
 		, __main_out_L( NULL )
 		, __main_out_R( NULL )
+		, __note_end_frame( 0 )
 		, __preview_instrument( NULL )
 {
 	INFOLOG( "INIT" );
@@ -66,6 +68,13 @@ Sampler::Sampler()
 	__main_out_L = new float[ MAX_BUFFER_SIZE ];
 	__main_out_R = new float[ MAX_BUFFER_SIZE ];
 
+#ifdef H2CORE_HAVE_LADSPA
+	int nSlots = Effects::get_instance()->getNumberOfSlots();
+	__fx_buf_L.resize( nSlots );
+	__fx_buf_R.resize( nSlots );
+	__fx_cost.resize( nSlots );
+#endif
+
 	// instrument used in file preview
 	QString sEmptySampleFilename = Filesystem::empty_sample();
 	__preview_instrument = new Instrument( EMPTY_INSTR_ID, sEmptySampleFilename );
@@ -118,31 +127,31 @@ void Sampler::process( uint32_t nFrames, Song* pSong )
 
 
 	// eseguo tutte le note nella lista di note in esecuzione
+	MidiOutput* midiOut = Hydrogen::get_instance()->getMidiOutput();
+	Profiler* pProfiler = AudioEngine::get_instance()->get_profiler();
 	unsigned i = 0;
 	Note* pNote;
 	while ( i < __playing_notes_queue.size() ) {
 		pNote = __playing_notes_queue[ i ];		// recupero una nuova nota
+		double fVoiceStart = pProfiler->start();
 		unsigned res = __render_note( pNote, nFrames, pSong );
+		pProfiler->stop( Profiler::VOICE, fVoiceStart );
 		if ( res == 1 ) {	// la nota e' finita
 			__playing_notes_queue.erase( __playing_notes_queue.begin() + i );
 			pNote->get_instrument()->dequeue();
 			__queuedNoteOffs.push_back( pNote );
-//			delete pNote;
-//			pNote = NULL;
+
+			// midi note off at the frame where the note ended
+			if( midiOut != NULL ){
+				midiOut->handleQueueNoteOff( pNote->get_instrument()->get_midi_out_channel(), pNote->get_midi_key(),  pNote->get_midi_velocity(), __note_end_frame );
+			}
 		} else {
 			++i; // carico la prox nota
 		}
 	}
 
-	//Queue midi note off messages for notes that have a length specified for them
-
 	while ( !__queuedNoteOffs.empty() ) {
 		pNote =  __queuedNoteOffs[0];
-		MidiOutput* midiOut = Hydrogen::get_instance()->getMidiOutput();
-		if( midiOut != NULL ){
-			midiOut->handleQueueNoteOff( pNote->get_instrument()->get_midi_out_channel(), pNote->get_midi_key(),  pNote->get_midi_velocity() );
-
-		}
 		__queuedNoteOffs.erase( __queuedNoteOffs.begin() );
 		if( pNote != NULL) delete pNote;
 		pNote = NULL;
@@ -247,6 +256,7 @@ unsigned Sampler::__render_note( Note* pNote, unsigned nBufferSize, Song* pSong
 	}
 
 	int nReturnValue = 0;
+	__note_end_frame = 0;
 
 	for (std::vector<InstrumentComponent*>::iterator it = pInstr->get_components()->begin() ; it !=pInstr->get_components()->end(); ++it) {
 		InstrumentComponent *pCompo = *it;
@@ -265,17 +275,19 @@ unsigned Sampler::__render_note( Note* pNote, unsigned nBufferSize, Song* pSong
 		float fLayerPitch = 0.0;
 
 		// scelgo il sample da usare in base alla velocity
+		int nCompoID = pCompo->get_drumkit_componentID();
+		int nLayer = pNote->get_layer_selected( nCompoID );
+		if ( nLayer < 0 || pNote->get_sample_position( nCompoID ) == 0 ) {
+			// a started note keeps its layer, even once the one of its velocity is loaded
+			nLayer = __select_layer( pCompo, pNote->get_velocity() );
+			pNote->set_layer_selected( nCompoID, nLayer );
+		}
+		InstrumentLayer *pLayer = ( nLayer < 0 ? NULL : pCompo->get_layer( nLayer ) );
 		Sample *pSample = NULL;
-		for ( unsigned nLayer = 0; nLayer < MAX_LAYERS; ++nLayer ) {
-			InstrumentLayer *pLayer = pCompo->get_layer( nLayer );
-			if ( pLayer == NULL ) continue;
-
-			if ( ( pNote->get_velocity() >= pLayer->get_start_velocity() ) && ( pNote->get_velocity() <= pLayer->get_end_velocity() ) ) {
-				pSample = pLayer->get_sample();
-				fLayerGain = pLayer->get_gain();
-				fLayerPitch = pLayer->get_pitch();
-				break;
-			}
+		if ( pLayer ) {
+			pSample = pLayer->get_sample();
+			fLayerGain = pLayer->get_gain();
+			fLayerPitch = pLayer->get_pitch();
 		}
 		if ( !pSample ) {
 			QString dummy = QString( "NULL sample for instrument %1. Note velocity: %2" ).arg( pInstr->get_name() ).arg( pNote->get_velocity() );
@@ -283,6 +295,11 @@ unsigned Sampler::__render_note( Note* pNote, unsigned nBufferSize, Song* pSong
 			nReturnValue = 1;
 			continue;
 		}
+		if ( !pLayer->is_loaded() ) {
+			// no layer of the component is loaded yet, the note is lost
+			nReturnValue = 1;
+			continue;
+		}
 
 		if ( pNote->get_sample_position( pCompo->get_drumkit_componentID() ) >= pSample->get_frames() ) {
 			WARNINGLOG( "sample position out of bounds. The layer has been resized during note play?" );
@@ -383,7 +400,7 @@ unsigned Sampler::__render_note( Note* pNote, unsigned nBufferSize, Song* pSong
 		if( ( int )pNote->get_sample_position(pCompo->get_drumkit_componentID()) == 0 )
 		{
 			if( Hydrogen::get_instance()->getMidiOutput() != NULL ){
-				Hydrogen::get_instance()->getMidiOutput()->handleQueueNote( pNote );
+				Hydrogen::get_instance()->getMidiOutput()->handleQueueNote( pNote, nInitialSilence );
 			}
 		}
 
@@ -399,6 +416,69 @@ unsigned Sampler::__render_note( Note* pNote, unsigned nBufferSize, Song* pSong
 	return nReturnValue;
 }
 
+#ifdef H2CORE_HAVE_LADSPA
+/// Collect the FX buses the instrument sends to.
+/// Returns the number of active sends written into the arrays.
+int Sampler::__get_fx_sends( Instrument *pInstr, Song* pSong, float **pBuf_L, float **pBuf_R, float *pCost )
+{
+	float fMasterVol = pSong->get_volume();
+	Effects* pEffects = Effects::get_instance();
+	int nSlots = pEffects->getNumberOfSlots();
+	int nSends = 0;
+	for ( int nFX = 0; nFX < nSlots; ++nFX ) {
+		LadspaFX *pFX = pEffects->getLadspaFX( nFX );
+		float fLevel = pInstr->get_fx_level( nFX );
+		if ( ( pFX ) && ( fLevel != 0.0 ) ) {
+			pFX->setInputActive();
+			pBuf_L[ nSends ] = pFX->m_pBuffer_L;
+			pBuf_R[ nSends ] = pFX->m_pBuffer_R;
+			pCost[ nSends ] = fLevel * pFX->getVolume() * fMasterVol;
+			++nSends;
+		}
+	}
+	return nSends;
+}
+#endif
+
+int Sampler::__select_layer( InstrumentComponent* pCompo, float fVelocity )
+{
+	int nSelected = -1;
+	for ( int nLayer = 0; nLayer < MAX_LAYERS; ++nLayer ) {
+		InstrumentLayer *pLayer = pCompo->get_layer( nLayer );
+		if ( pLayer == NULL ) continue;
+
+		if ( ( fVelocity >= pLayer->get_start_velocity() ) && ( fVelocity <= pLayer->get_end_velocity() ) ) {
+			nSelected = nLayer;
+			break;
+		}
+	}
+	if ( nSelected < 0 ) {
+		return -1;
+	}
+	InstrumentLayer *pSelected = pCompo->get_layer( nSelected );
+	if ( pSelected->get_sample() == NULL || pSelected->is_loaded() ) {
+		return nSelected;
+	}
+
+	// the data of the layer is loaded in the background, the nearest loaded layer plays meanwhile
+	LayerLoader::get_instance()->request( pSelected );
+	int nNearest = -1;
+	float fNearest = 0.0;
+	for ( int nLayer = 0; nLayer < MAX_LAYERS; ++nLayer ) {
+		InstrumentLayer *pLayer = pCompo->get_layer( nLayer );
+		if ( pLayer == NULL || !pLayer->is_loaded() ) continue;
+
+		float fDistance = ( fVelocity < pLayer->get_start_velocity() ) ? pLayer->get_start_velocity() - fVelocity : fVelocity - pLayer->get_end_velocity();
+		if ( nNearest < 0 || fDistance < fNearest ) {
+			nNearest = nLayer;
+			fNearest = fDistance;
+		}
+	}
+	return ( nNearest < 0 ? nSelected : nNearest );
+}
+
+
+
 int Sampler::__render_note_no_resample(
 	Sample *pSample,
 	Note *pNote,
@@ -460,6 +540,13 @@ int Sampler::__render_note_no_resample(
 	}
 #endif
 
+#ifdef H2CORE_HAVE_LADSPA
+	float **pFXBuf_L = &__fx_buf_L[ 0 ];
+	float **pFXBuf_R = &__fx_buf_R[ 0 ];
+	float *fFXCost = &__fx_cost[ 0 ];
+	int nFXSends = __get_fx_sends( pNote->get_instrument(), pSong, pFXBuf_L, pFXBuf_R, fFXCost );
+#endif
+
 	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
 		if ( ( nNoteLength != -1 ) && ( nNoteLength <= pNote->get_sample_position(pCompo->get_drumkit_componentID()) )  ) {
 						if ( pNote->get_adsr()->release() == 0 ) {
@@ -485,6 +572,14 @@ int Sampler::__render_note_no_resample(
 		}
 #endif
 
+#ifdef H2CORE_HAVE_LADSPA
+		// FX sends are fed from the same enveloped and filtered frame as the main mix
+		for ( int nFX = 0; nFX < nFXSends; ++nFX ) {
+			pFXBuf_L[ nFX ][ nBufferPos ] += fVal_L * fFXCost[ nFX ];
+			pFXBuf_R[ nFX ][ nBufferPos ] += fVal_R * fFXCost[ nFX ];
+		}
+#endif
+
 		fVal_L = fVal_L * cost_L;
 		fVal_R = fVal_R * cost_R;
 
@@ -508,36 +603,9 @@ int Sampler::__render_note_no_resample(
 	pNote->get_instrument()->set_peak_l( fInstrPeak_L );
 	pNote->get_instrument()->set_peak_r( fInstrPeak_R );
 
-
-#ifdef H2CORE_HAVE_LADSPA
-		float masterVol =  pSong->get_volume();
-	// LADSPA
-	for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
-		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
-
-		float fLevel = pNote->get_instrument()->get_fx_level( nFX );
-
-		if ( ( pFX ) && ( fLevel != 0.0 ) ) {
-			fLevel = fLevel * pFX->getVolume();
-			float *pBuf_L = pFX->m_pBuffer_L;
-			float *pBuf_R = pFX->m_pBuffer_R;
-
-			float fFXCost_L = fLevel * masterVol;
-			float fFXCost_R = fLevel * masterVol;
-
-			int nBufferPos = nInitialBufferPos;
-			int nSamplePos = nInitialSamplePos;
-			for ( int i = 0; i < nAvail_bytes; ++i ) {
-				pBuf_L[ nBufferPos ] += pSample_data_L[ nSamplePos ] * fFXCost_L;
-				pBuf_R[ nBufferPos ] += pSample_data_R[ nSamplePos ] * fFXCost_R;
-				++nSamplePos;
-				++nBufferPos;
-			}
-		}
+	if ( retValue == 1 && nTimes > __note_end_frame ) {
+		__note_end_frame = nTimes;
 	}
-	// ~LADSPA
-#endif
-
 	return retValue;
 }
 
@@ -584,7 +652,6 @@ int Sampler::__render_note_resample(
 	//	ADSR *pADSR = pNote->m_pADSR;
 
 	int nInitialBufferPos = nInitialSilence;
-	float fInitialSamplePos = pNote->get_sample_position( pCompo->get_drumkit_componentID() );
 	double fSamplePos = pNote->get_sample_position( pCompo->get_drumkit_componentID() );
 	int nTimes = nInitialBufferPos + nAvail_bytes;
 
@@ -612,6 +679,13 @@ int Sampler::__render_note_resample(
 	}
 #endif
 
+#ifdef H2CORE_HAVE_LADSPA
+	float **pFXBuf_L = &__fx_buf_L[ 0 ];
+	float **pFXBuf_R = &__fx_buf_R[ 0 ];
+	float *fFXCost = &__fx_cost[ 0 ];
+	int nFXSends = __get_fx_sends( pNote->get_instrument(), pSong, pFXBuf_L, pFXBuf_R, fFXCost );
+#endif
+
 	for ( int nBufferPos = nInitialBufferPos; nBufferPos < nTimes; ++nBufferPos ) {
 		if ( ( nNoteLength != -1 ) && ( nNoteLength <= pNote->get_sample_position( pCompo->get_drumkit_componentID() ) )  ) {
 						if ( pNote->get_adsr()->release() == 0 ) {
@@ -685,6 +759,14 @@ int Sampler::__render_note_resample(
 		}
 #endif
 
+#ifdef H2CORE_HAVE_LADSPA
+		// FX sends are fed from the same enveloped and filtered frame as the main mix
+		for ( int nFX = 0; nFX < nFXSends; ++nFX ) {
+			pFXBuf_L[ nFX ][ nBufferPos ] += fVal_L * fFXCost[ nFX ];
+			pFXBuf_R[ nFX ][ nBufferPos ] += fVal_R * fFXCost[ nFX ];
+		}
+#endif
+
 		fVal_L = fVal_L * cost_L;
 		fVal_R = fVal_R * cost_R;
 
@@ -708,83 +790,9 @@ int Sampler::__render_note_resample(
 	pNote->get_instrument()->set_peak_l( fInstrPeak_L );
 	pNote->get_instrument()->set_peak_r( fInstrPeak_R );
 
-
-
-#ifdef H2CORE_HAVE_LADSPA
-	// LADSPA
-	float masterVol = pSong->get_volume();
-	for ( unsigned nFX = 0; nFX < MAX_FX; ++nFX ) {
-		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
-		float fLevel = pNote->get_instrument()->get_fx_level( nFX );
-		if ( ( pFX ) && ( fLevel != 0.0 ) ) {
-			fLevel = fLevel * pFX->getVolume();
-
-			float *pBuf_L = pFX->m_pBuffer_L;
-			float *pBuf_R = pFX->m_pBuffer_R;
-
-//			float fFXCost_L = cost_L * fLevel;
-//			float fFXCost_R = cost_R * fLevel;
-			float fFXCost_L = fLevel * masterVol;
-			float fFXCost_R = fLevel * masterVol;
-
-			int nBufferPos = nInitialBufferPos;
-			float fSamplePos = fInitialSamplePos;
-			for ( int i = 0; i < nAvail_bytes; ++i ) {
-				int nSamplePos = ( int )fSamplePos;
-				double fDiff = fSamplePos - nSamplePos;
-
-				if ( ( nSamplePos + 1 ) >= nSampleFrames ) {
-					//we reach the last audioframe.
-					//set this last frame to zero do nothin wrong.
-					fVal_L = 0.0;
-					fVal_R = 0.0;
-				} else {
-					// some interpolation methods need 4 frames data.
-					float last_l;
-					float last_r;
-					if ( ( nSamplePos + 2 ) >= nSampleFrames ) {
-						last_l = 0.0;
-						last_r = 0.0;
-					}else
-					{
-						last_l =  pSample_data_L[nSamplePos + 2];
-						last_r =  pSample_data_R[nSamplePos + 2];
-					}
-
-					switch( __interpolateMode ){
-
-					case LINEAR:
-						fVal_L = pSample_data_L[nSamplePos] * (1 - fDiff ) + pSample_data_L[nSamplePos + 1] * fDiff;
-						fVal_R = pSample_data_R[nSamplePos] * (1 - fDiff ) + pSample_data_R[nSamplePos + 1] * fDiff;
-						break;
-					case COSINE:
-						fVal_L = cosine_Interpolate( pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], fDiff);
-						fVal_R = cosine_Interpolate( pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], fDiff);
-						break;
-					case THIRD:
-						fVal_L = third_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
-						fVal_R = third_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
-						break;
-					case CUBIC:
-						fVal_L = cubic_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
-						fVal_R = cubic_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
-						break;
-					case HERMITE:
-						fVal_L = hermite_Interpolate( pSample_data_L[ nSamplePos -1], pSample_data_L[nSamplePos], pSample_data_L[nSamplePos + 1], last_l, fDiff);
-						fVal_R = hermite_Interpolate( pSample_data_R[ nSamplePos -1], pSample_data_R[nSamplePos], pSample_data_R[nSamplePos + 1], last_r, fDiff);
-						break;
-					}
-				}
-
-				pBuf_L[ nBufferPos ] += fVal_L * fFXCost_L;
-								pBuf_R[ nBufferPos ] += fVal_R * fFXCost_R;
-				fSamplePos += fStep;
-				++nBufferPos;
-			}
-		}
+	if ( retValue == 1 && nTimes > __note_end_frame ) {
+		__note_end_frame = nTimes;
 	}
-#endif
-
 	return retValue;
 }
 
@@ -27,6 +27,8 @@
 #include <hydrogen/basics/instrument.h>
 #include <hydrogen/basics/instrument_list.h>
 
+#include <algorithm>
+#include <ctime>
 #include <fstream>
 
 using std::vector;
@@ -204,6 +206,231 @@ vector<char> SMF::getBuffer()
 
 
 
+// :::::::::::::::::::...
+
+
+const char* SMFStream::__class_name = "SMFStream";
+
+SMFStream::SMFStream( int nFormat, int nTPQN )
+		: Object( __class_name )
+		, m_nTrackStart( 0 )
+		, m_nTrackTicks( 0 )
+		, m_nTracks( 0 )
+{
+	writeDWord( 1297377380 );		// MThd
+	writeDWord( 6 );				// Header length = 6
+	writeWord( nFormat );
+	writeWord( 0 );					// number of tracks, patched by beginTrack()
+	writeWord( nTPQN );
+}
+
+
+
+SMFStream::~SMFStream()
+{
+}
+
+
+
+void SMFStream::reserve( size_t nBytes )
+{
+	if ( m_buffer.size() + nBytes > m_buffer.capacity() ) {
+		m_buffer.reserve( m_buffer.size() + nBytes );
+	}
+}
+
+
+
+void SMFStream::writeWord( int nVal )
+{
+	writeByte( nVal >> 8 );
+	writeByte( nVal );
+}
+
+
+
+void SMFStream::writeDWord( long nVal )
+{
+	writeByte( nVal >> 24 );
+	writeByte( nVal >> 16 );
+	writeByte( nVal >> 8 );
+	writeByte( nVal );
+}
+
+
+
+void SMFStream::writeVarLen( unsigned long nVal )
+{
+	// 7 bits per byte, most significant first, the high bit is set on all but the last byte
+	unsigned char bytes[ 5 ];
+	int nBytes = 0;
+	do {
+		bytes[ nBytes++ ] = nVal & 0x7f;
+		nVal >>= 7;
+	} while ( nVal > 0 && nBytes < 5 );
+
+	while ( nBytes > 1 ) {
+		writeByte( bytes[ --nBytes ] | 0x80 );
+	}
+	writeByte( bytes[ 0 ] );
+}
+
+
+
+void SMFStream::writeString( const QString& sMsg )
+{
+	QByteArray data = sMsg.toLocal8Bit();
+	writeVarLen( data.size() );
+	m_buffer.insert( m_buffer.end(), data.constData(), data.constData() + data.size() );
+}
+
+
+
+void SMFStream::patchWord( size_t nOffset, int nVal )
+{
+	m_buffer[ nOffset ] = nVal >> 8;
+	m_buffer[ nOffset + 1 ] = nVal;
+}
+
+
+
+void SMFStream::patchDWord( size_t nOffset, long nVal )
+{
+	m_buffer[ nOffset ] = nVal >> 24;
+	m_buffer[ nOffset + 1 ] = nVal >> 16;
+	m_buffer[ nOffset + 2 ] = nVal >> 8;
+	m_buffer[ nOffset + 3 ] = nVal;
+}
+
+
+
+void SMFStream::beginTrack()
+{
+	patchWord( 10, ++m_nTracks );
+
+	m_nTrackStart = m_buffer.size();
+	m_nTrackTicks = 0;
+	writeDWord( 1297379947 );		// MTrk
+	writeDWord( 0 );				// Track length, patched by endTrack()
+}
+
+
+
+void SMFStream::endTrack()
+{
+	//  track end
+	writeByte( 0x00 );		// delta
+	writeByte( 0xFF );
+	writeByte( END_OF_TRACK );
+	writeByte( 0x00 );
+
+	patchDWord( m_nTrackStart + 4, m_buffer.size() - m_nTrackStart - 8 );
+}
+
+
+
+void SMFStream::writeCopyRightNotice( const QString& sAuthor, unsigned nDeltaTime )
+{
+	time_t now = time( 0 );
+	tm *ltm = localtime( &now );
+
+	// "(C) [Author] [CurrentYear]"
+	QString sCopyRightString = "(C) " + sAuthor + " " + QString::number( 1900 + ltm->tm_year );
+
+	writeVarLen( nDeltaTime );
+	writeByte( 0xFF );
+	writeByte( COPYRIGHT_NOTICE );
+	writeString( sCopyRightString );
+}
+
+
+
+void SMFStream::writeTrackName( const QString& sTrackName, unsigned nDeltaTime )
+{
+	writeVarLen( nDeltaTime );
+	writeByte( 0xFF );
+	writeByte( TRACK_NAME );
+	writeString( sTrackName );
+}
+
+
+
+void SMFStream::writeTempo( float fBPM, unsigned nDeltaTime )
+{
+	long msPerBeat = long( 60000000 / fBPM ); // 60 seconds * mills \ BPM
+
+	writeVarLen( nDeltaTime );
+	writeByte( 0xFF );
+	writeByte( SET_TEMPO );
+	writeByte( 0x03 );	// Length
+	writeByte( msPerBeat >> 16 );
+	writeByte( msPerBeat >> 8 );
+	writeByte( msPerBeat );
+}
+
+
+
+void SMFStream::writeTimeSignature( unsigned nBeats, unsigned nNote, unsigned nMTPMC, unsigned nTSNP24, unsigned nDeltaTime )
+{
+	unsigned nNote2Log = 0;
+	while ( nNote >>= 1 ) {
+		++nNote2Log;		// so 8 (as in 6/8) becomes 3
+	}
+
+	writeVarLen( nDeltaTime );
+	writeByte( 0xFF );
+	writeByte( TIME_SIGNATURE );
+	writeByte( 0x04 );		// Event length in bytes.
+	writeByte( nBeats );
+	writeByte( nNote2Log );
+	writeByte( nMTPMC );
+	writeByte( nTSNP24 );
+}
+
+
+
+static bool eventBefore( const SMFStream::Event& a, const SMFStream::Event& b )
+{
+	return a.nTicks < b.nTicks;
+}
+
+
+
+void SMFStream::writeEvents( vector<Event>& events )
+{
+	std::stable_sort( events.begin(), events.end(), eventBefore );
+
+	// at most 4 bytes of delta time and 3 bytes of data per event
+	reserve( events.size() * 7 + 4 );
+
+	for ( vector<Event>::const_iterator it = events.begin(); it != events.end(); ++it ) {
+		writeVarLen( it->nTicks - m_nTrackTicks );
+		m_nTrackTicks = it->nTicks;
+
+		writeByte( it->nStatus );
+		writeByte( it->nData1 );
+		writeByte( it->nData2 );
+	}
+}
+
+
+
+bool SMFStream::save( const QString& sFilename )
+{
+	FILE *file = fopen( sFilename.toLocal8Bit(), "wb" );
+	if ( file == NULL ) {
+		return false;
+	}
+
+	bool bOk = fwrite( &m_buffer[ 0 ], 1, m_buffer.size(), file ) == m_buffer.size();
+	if ( fclose( file ) != 0 ) {
+		bOk = false;
+	}
+	return bOk;
+}
+
+
+
 // :::::::::::::::::::...
 
 
@@ -211,7 +438,6 @@ const char* SMFWriter::__class_name = "SMFWriter";
 
 SMFWriter::SMFWriter()
 		: Object( __class_name )
-		, m_file( NULL )
 {
 	INFOLOG( "INIT" );
 }
@@ -225,37 +451,21 @@ SMFWriter::~SMFWriter()
 
 
 
-void SMFWriter::save( const QString& sFilename, Song *pSong )
+void SMFWriter::save( const QString& sFilename, Song *pSong, bool bTrackPerInstrument )
 {
 	INFOLOG( "save" );
 	const int DRUM_CHANNEL = 9;
 
-	vector<SMFEvent*> eventList;
-
-	SMF smf;
-
+	InstrumentList *iList = pSong->get_instrument_list();
 
-	// Standard MIDI format 1 files should have the first track being the tempo map
-	// which is a track that contains global meta events only.
-	SMFTrack *pTrack0 = new SMFTrack();
-	pTrack0->addEvent( new SMFCopyRightNoticeMetaEvent( pSong->__author , 0 ) );
-	pTrack0->addEvent( new SMFTrackNameMetaEvent( pSong->__name , 0 ) );
-	pTrack0->addEvent( new SMFSetTempoMetaEvent( pSong->__bpm , 0 ) );
-	pTrack0->addEvent( new SMFTimeSignatureMetaEvent( 4 , 4 , 24 , 8 , 0 ) );
-	smf.addTrack( pTrack0 );
-
-	
-	// Standard MIDI Format 1 files should have note events in tracks =>2
-	SMFTrack *pTrack1 = new SMFTrack();
-	smf.addTrack( pTrack1 );
+	// the events of a single note track, or of one track per instrument
+	vector< vector<SMFStream::Event> > tracks( bTrackPerInstrument ? iList->size() : 1 );
+	size_t nEvents = 0;
 
-	InstrumentList *iList = pSong->get_instrument_list();
-	// ogni pattern sara' una diversa traccia
-	int nTick = 1;
+	int nTick = 0;
 	for ( unsigned nPatternList = 0 ;
 		  nPatternList < pSong->get_pattern_group_vector()->size() ;
 		  nPatternList++ ) {
-		// infoLog( "[save] pattern list pos: " + toString( nPatternList ) );
 		PatternList *pPatternList =
 			( *(pSong->get_pattern_group_vector()) )[ nPatternList ];
 
@@ -265,90 +475,77 @@ void SMFWriter::save( const QString& sFilename, Song *pSong )
 			  nPattern < pPatternList->size() ;
 			  nPattern++ ) {
 			Pattern *pPattern = pPatternList->get( nPattern );
-			// infoLog( "      |-> pattern: " + pPattern->getName() );
 			if ( ( int )pPattern->get_length() > nMaxPatternLength ) {
 				nMaxPatternLength = pPattern->get_length();
 			}
 
+			const Pattern::notes_t* notes = pPattern->get_notes();
 			for ( unsigned nNote = 0; nNote < pPattern->get_length(); nNote++ ) {
-				const Pattern::notes_t* notes = pPattern->get_notes();
 				FOREACH_NOTE_CST_IT_BOUND(notes,it,nNote) {
 					Note *pNote = it->second;
-					if ( pNote ) {
-						int nVelocity =
-							(int)( 127.0 * pNote->get_velocity() );
-						
-						int nInstr = iList->index(pNote->get_instrument());
-						Instrument *pInstr = pNote->get_instrument();
-						int nPitch = pInstr->get_midi_out_note();
-						
-						eventList.push_back(
-							new SMFNoteOnEvent(
-								nStartTicks + nNote,
-								DRUM_CHANNEL,
-								nPitch,
-								nVelocity
-								)
-							);
-						int nLength = 12;
-						if ( pNote->get_length() != -1 ) {
-							nLength = pNote->get_length();
+					if ( pNote == NULL ) {
+						continue;
+					}
+					int nTrack = 0;
+					if ( bTrackPerInstrument ) {
+						nTrack = iList->index( pNote->get_instrument() );
+						if ( nTrack < 0 ) {
+							continue;
 						}
-						eventList.push_back(
-							new SMFNoteOffEvent(
-								nStartTicks + nNote + nLength,
-								DRUM_CHANNEL,
-								nPitch,
-								nVelocity
-								)
-							);
 					}
+
+					int nVelocity = (int)( 127.0 * pNote->get_velocity() );
+					int nPitch = pNote->get_instrument()->get_midi_out_note();
+					int nLength = 12;
+					if ( pNote->get_length() != -1 ) {
+						nLength = pNote->get_length();
+					}
+
+					SMFStream::Event event;
+					event.nData1 = nPitch;
+					event.nData2 = nVelocity;
+					// 48 ticks per quarter note in the song, 192 in the file
+					event.nTicks = ( nStartTicks + nNote ) * 4;
+					event.nStatus = NOTE_ON + DRUM_CHANNEL;
+					tracks[ nTrack ].push_back( event );
+					event.nTicks = ( nStartTicks + nNote + nLength ) * 4;
+					event.nStatus = NOTE_OFF + DRUM_CHANNEL;
+					tracks[ nTrack ].push_back( event );
+					nEvents += 2;
 				}
 			}
 		}
 		nTick += nMaxPatternLength;
 	}
 
-	// awful bubble sort..
-	for ( unsigned i = 0; i < eventList.size(); i++ ) {
-		for ( vector<SMFEvent*>::iterator it = eventList.begin() ;
-			  it != ( eventList.end() - 1 ) ;
-			  it++ ) {
-			SMFEvent *pEvent = *it;
-			SMFEvent *pNextEvent = *( it + 1 );
-			if ( pNextEvent->m_nTicks < pEvent->m_nTicks ) {
-				// swap
-				*it = pNextEvent;
-				*( it +1 ) = pEvent;
-			}
-		}
-	}
-
-	unsigned nLastTick = 1;
-	for ( vector<SMFEvent*>::iterator it = eventList.begin() ;
-		  it != eventList.end();
-		  it++ ) {
-		SMFEvent *pEvent = *it;
-		pEvent->m_nDeltaTime = ( pEvent->m_nTicks - nLastTick ) * 4;
-		nLastTick = pEvent->m_nTicks;
+	// Standard MIDI format 1 files should have the first track being the tempo map
+	// which is a track that contains global meta events only.
+	SMFStream stream( 1, 192 );
+	stream.reserve( 256 + 64 * tracks.size() + 7 * nEvents );
 
-		// infoLog( " pos: " + toString( (*it)->m_nTicks ) + ", delta: "
-		//          + toString( (*it)->m_nDeltaTime ) );
+	stream.beginTrack();
+	stream.writeCopyRightNotice( pSong->__author, 0 );
+	stream.writeTrackName( pSong->__name, 0 );
+	stream.writeTempo( pSong->__bpm, 0 );
+	stream.writeTimeSignature( 4, 4, 24, 8, 0 );
+	stream.endTrack();
 
-		pTrack1->addEvent( *it );
+	// Standard MIDI Format 1 files should have note events in tracks =>2
+	for ( unsigned nTrack = 0; nTrack < tracks.size(); nTrack++ ) {
+		if ( bTrackPerInstrument && tracks[ nTrack ].empty() ) {
+			continue;
+		}
+		stream.beginTrack();
+		if ( bTrackPerInstrument ) {
+			stream.writeTrackName( iList->get( nTrack )->get_name(), 0 );
+		}
+		stream.writeEvents( tracks[ nTrack ] );
+		stream.endTrack();
 	}
 
-	// save the midi file
-	m_file = fopen( sFilename.toLocal8Bit(), "wb" );
-
-	if( m_file == NULL )
-		return;
-
-	vector<char> smfVect = smf.getBuffer();
-	for ( unsigned i = 0; i < smfVect.size(); i++ ) {
-		fwrite( &smfVect[ i ], 1, 1, m_file );
+	if ( !stream.save( sFilename ) ) {
+		ERRORLOG( QString( "Error writing %1" ).arg( sFilename ) );
 	}
-	fclose( m_file );
 }
 
 };
@@ -0,0 +1,358 @@
+/*
+ * Hydrogen
+ * Copyright(c) 2002-2004 by Alex >Comix< Cominu [comix@users.sourceforge.net]
+ *
+ * http://www.hydrogen-music.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY, without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <hydrogen/smf/SMF.h>
+#include <hydrogen/basics/pattern.h>
+#include <hydrogen/basics/pattern_list.h>
+#include <hydrogen/basics/note.h>
+#include <hydrogen/basics/instrument.h>
+#include <hydrogen/basics/instrument_list.h>
+
+#include <algorithm>
+#include <map>
+
+using std::vector;
+
+namespace H2Core
+{
+
+const char* SMFReader::__class_name = "SMFReader";
+
+SMFReader::SMFReader()
+		: Object( __class_name )
+		, m_nFormat( 0 )
+		, m_nTPQN( 0 )
+		, m_fBPM( 0 )
+		, m_nBeats( 4 )
+		, m_nNote( 4 )
+{
+	INFOLOG( "INIT" );
+}
+
+
+
+SMFReader::~SMFReader()
+{
+	INFOLOG( "DESTROY" );
+}
+
+
+
+static unsigned readWord( const unsigned char* pData )
+{
+	return ( pData[ 0 ] << 8 ) | pData[ 1 ];
+}
+
+
+
+static unsigned readDWord( const unsigned char* pData )
+{
+	return ( readWord( pData ) << 16 ) | readWord( pData + 2 );
+}
+
+
+
+/// \return false if the number doesn't end before pEnd
+static bool readVarLen( const unsigned char*& pData, const unsigned char* pEnd, unsigned& nVal )
+{
+	nVal = 0;
+	for ( int i = 0; i < 4 && pData < pEnd; i++ ) {
+		unsigned char nByte = *pData++;
+		nVal = ( nVal << 7 ) | ( nByte & 0x7f );
+		if ( !( nByte & 0x80 ) ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+static bool noteBefore( const SMFReader::Note& a, const SMFReader::Note& b )
+{
+	return a.nTicks < b.nTicks;
+}
+
+
+
+bool SMFReader::load( const QString& sFilename )
+{
+	INFOLOG( "load " + sFilename );
+	m_notes.clear();
+	m_fBPM = 0;
+	m_nBeats = 4;
+	m_nNote = 4;
+
+	FILE *file = fopen( sFilename.toLocal8Bit(), "rb" );
+	if ( file == NULL ) {
+		ERRORLOG( QString( "Error opening %1" ).arg( sFilename ) );
+		return false;
+	}
+
+	unsigned char header[ 14 ];
+	if ( fread( header, 1, 14, file ) != 14 || readDWord( header ) != 1297377380 ) {	// MThd
+		ERRORLOG( QString( "%1 is not a MIDI file" ).arg( sFilename ) );
+		fclose( file );
+		return false;
+	}
+	unsigned nHeaderLength = readDWord( header + 4 );
+	m_nFormat = readWord( header + 8 );
+	unsigned nDivision = readWord( header + 12 );
+	if ( nHeaderLength < 6 || m_nFormat > 1 || ( nDivision & 0x8000 ) || nDivision == 0 ) {
+		ERRORLOG( QString( "Unsupported MIDI file: format %1, division %2" ).arg( m_nFormat ).arg( nDivision ) );
+		fclose( file );
+		return false;
+	}
+	m_nTPQN = nDivision;
+	fseek( file, nHeaderLength - 6, SEEK_CUR );
+
+	// one chunk at a time, the unknown ones are skipped
+	unsigned char chunk[ 8 ];
+	while ( fread( chunk, 1, 8, file ) == 8 ) {
+		unsigned nLength = readDWord( chunk + 4 );
+		if ( readDWord( chunk ) != 1297379947 ) {		// MTrk
+			fseek( file, nLength, SEEK_CUR );
+			continue;
+		}
+
+		m_track.resize( nLength );
+		size_t nRead = nLength > 0 ? fread( &m_track[ 0 ], 1, nLength, file ) : 0;
+		if ( nRead != nLength ) {
+			WARNINGLOG( QString( "Truncated track in %1" ).arg( sFilename ) );
+			m_track.resize( nRead );
+		}
+		if ( !readTrack() ) {
+			WARNINGLOG( QString( "Corrupted track in %1" ).arg( sFilename ) );
+		}
+	}
+	fclose( file );
+
+	// the tracks of a format 1 file are merged
+	std::stable_sort( m_notes.begin(), m_notes.end(), noteBefore );
+
+	INFOLOG( QString( "format %1, %2 ticks per quarter, %3 notes" )
+			 .arg( m_nFormat ).arg( m_nTPQN ).arg( m_notes.size() ) );
+	return true;
+}
+
+
+
+bool SMFReader::readTrack()
+{
+	if ( m_track.empty() ) {
+		return true;
+	}
+	const unsigned char* pData = &m_track[ 0 ];
+	const unsigned char* pEnd = pData + m_track.size();
+	unsigned nTicks = 0;
+	unsigned char nStatus = 0;
+
+	while ( pData < pEnd ) {
+		unsigned nDeltaTime;
+		if ( !readVarLen( pData, pEnd, nDeltaTime ) || pData >= pEnd ) {
+			return false;
+		}
+		nTicks += nDeltaTime;
+
+		if ( *pData == 0xFF ) {
+			// meta event
+			if ( pEnd - pData < 2 ) {
+				return false;
+			}
+			unsigned char nType = pData[ 1 ];
+			pData += 2;
+			unsigned nLength;
+			if ( !readVarLen( pData, pEnd, nLength ) || ( unsigned )( pEnd - pData ) < nLength ) {
+				return false;
+			}
+			if ( nType == END_OF_TRACK ) {
+				return true;
+			} else if ( nType == SET_TEMPO && nLength == 3 && m_fBPM == 0 ) {
+				unsigned nMicroseconds = ( pData[ 0 ] << 16 ) | ( pData[ 1 ] << 8 ) | pData[ 2 ];
+				if ( nMicroseconds > 0 ) {
+					m_fBPM = 60000000.0 / nMicroseconds;
+				}
+			} else if ( nType == TIME_SIGNATURE && nLength == 4 && nTicks == 0 && pData[ 0 ] > 0 && pData[ 1 ] < 8 ) {
+				m_nBeats = pData[ 0 ];
+				m_nNote = 1 << pData[ 1 ];
+			}
+			pData += nLength;
+			nStatus = 0;
+		} else if ( *pData == 0xF0 || *pData == 0xF7 ) {
+			// sysex
+			pData++;
+			unsigned nLength;
+			if ( !readVarLen( pData, pEnd, nLength ) || ( unsigned )( pEnd - pData ) < nLength ) {
+				return false;
+			}
+			pData += nLength;
+			nStatus = 0;
+		} else {
+			if ( *pData & 0x80 ) {
+				nStatus = *pData++;
+			} else if ( nStatus == 0 ) {
+				// running status without a previous channel event
+				return false;
+			}
+			int nType = nStatus & 0xF0;
+			int nDataBytes = ( nType == 0xC0 || nType == 0xD0 ) ? 1 : 2;
+			if ( pEnd - pData < nDataBytes ) {
+				return false;
+			}
+			if ( nType == NOTE_ON && pData[ 1 ] > 0 ) {
+				Note note;
+				note.nTicks = nTicks;
+				note.nChannel = nStatus & 0x0F;
+				note.nKey = pData[ 0 ] & 0x7F;
+				note.nVelocity = pData[ 1 ] & 0x7F;
+				m_notes.push_back( note );
+			}
+			pData += nDataBytes;
+		}
+	}
+	// missing end of track
+	return true;
+}
+
+
+
+/// note of a bar, in ticks of the song
+struct BarNote {
+	int nPosition;
+	int nInstrument;
+	int nVelocity;
+
+	bool operator<( const BarNote& other ) const {
+		if ( nPosition != other.nPosition ) {
+			return nPosition < other.nPosition;
+		}
+		if ( nInstrument != other.nInstrument ) {
+			return nInstrument < other.nInstrument;
+		}
+		return nVelocity < other.nVelocity;
+	}
+};
+
+
+
+int SMFReader::createPatterns( Song *pSong, const QString& sName )
+{
+	InstrumentList *pInstrList = pSong->get_instrument_list();
+	PatternList *pPatternList = pSong->get_pattern_list();
+	vector<PatternList*> *pColumns = pSong->get_pattern_group_vector();
+	if ( m_nTPQN <= 0 ) {
+		return 0;
+	}
+
+	// the first instrument playing a note wins
+	int instruments[ 128 ];
+	for ( int nKey = 0; nKey < 128; nKey++ ) {
+		instruments[ nKey ] = -1;
+	}
+	for ( int nInstr = pInstrList->size() - 1; nInstr >= 0; nInstr-- ) {
+		int nKey = pInstrList->get( nInstr )->get_midi_out_note();
+		if ( nKey >= 0 && nKey < 128 ) {
+			instruments[ nKey ] = nInstr;
+		}
+	}
+
+	int nResolution = pSong->__resolution;
+	int nBarLength = m_nBeats * nResolution * 4 / m_nNote;
+	if ( nBarLength <= 0 ) {
+		nBarLength = nResolution * 4;
+	}
+
+	std::map< vector<BarNote>, Pattern* > patterns;
+	vector<BarNote> bar;
+	int nBar = 0;
+	int nColumns = 0;
+	int nPatterns = 0;
+	int nUnmapped = 0;
+	unsigned nNote = 0;
+	while ( nNote < m_notes.size() ) {
+		// notes are quantized to the ticks of the song
+		bar.clear();
+		for ( ; nNote < m_notes.size(); nNote++ ) {
+			const Note& note = m_notes[ nNote ];
+			long long nTick = ( ( long long )note.nTicks * nResolution + m_nTPQN / 2 ) / m_nTPQN;
+			if ( nTick >= ( long long )( nBar + 1 ) * nBarLength ) {
+				break;
+			}
+			if ( instruments[ note.nKey ] < 0 ) {
+				nUnmapped++;
+				continue;
+			}
+			BarNote barNote;
+			barNote.nPosition = nTick - ( long long )nBar * nBarLength;
+			barNote.nInstrument = instruments[ note.nKey ];
+			barNote.nVelocity = note.nVelocity;
+			bar.push_back( barNote );
+		}
+		nBar++;
+
+		// a single note per tick and instrument, the loudest
+		std::sort( bar.begin(), bar.end() );
+		vector<BarNote> notes;
+		for ( unsigned i = 0; i < bar.size(); i++ ) {
+			if ( !notes.empty() && notes.back().nPosition == bar[ i ].nPosition
+				 && notes.back().nInstrument == bar[ i ].nInstrument ) {
+				notes.back().nVelocity = bar[ i ].nVelocity;
+			} else {
+				notes.push_back( bar[ i ] );
+			}
+		}
+
+		PatternList *pColumn = new PatternList();
+		pColumns->push_back( pColumn );
+		nColumns++;
+		// an empty column lasts MAX_NOTES ticks, other bars need an empty pattern
+		if ( notes.empty() && nBarLength == MAX_NOTES ) {
+			continue;
+		}
+
+		Pattern *pPattern = patterns[ notes ];
+		if ( pPattern == NULL ) {
+			QString sPatternName;
+			do {
+				sPatternName = QString( "%1 %2" ).arg( sName ).arg( ++nPatterns );
+			} while ( pPatternList->find( sPatternName ) != NULL );
+
+			pPattern = new Pattern( sPatternName, "", "not_categorized", nBarLength );
+			for ( unsigned i = 0; i < notes.size(); i++ ) {
+				pPattern->insert_note(
+					new H2Core::Note( pInstrList->get( notes[ i ].nInstrument ), notes[ i ].nPosition,
+									  notes[ i ].nVelocity / 127.0, 0.5, 0.5, -1, 0 ) );
+			}
+			pPatternList->add( pPattern );
+			patterns[ notes ] = pPattern;
+		}
+		pColumn->add( pPattern );
+	}
+
+	if ( nUnmapped > 0 ) {
+		WARNINGLOG( QString( "%1 notes without an instrument of the same MIDI out note" ).arg( nUnmapped ) );
+	}
+	INFOLOG( QString( "%1 columns, %2 patterns" ).arg( nColumns ).arg( patterns.size() ) );
+	return nColumns;
+}
+
+};
@@ -51,6 +51,8 @@ AudioEngineInfoForm::AudioEngineInfoForm(QWidget* parent)
 
 	setWindowTitle( trUtf8( "Audio Engine Info" ) );
 
+	profileCheckBox->setChecked( AudioEngine::get_instance()->get_profiler()->isEnabled() );
+
 	updateInfo();
 	//currentPatternLbl->setText("NULL pattern");
 
@@ -96,6 +98,20 @@ void AudioEngineInfoForm::hideEvent ( QHideEvent* )
 
 
 
+void AudioEngineInfoForm::on_profileCheckBox_toggled( bool bChecked )
+{
+	Profiler* pProfiler = AudioEngine::get_instance()->get_profiler();
+	if ( bChecked ) {
+		pProfiler->reset();
+	} else {
+		profileReportLbl->setText( "" );
+	}
+	pProfiler->setEnabled( bChecked );
+}
+
+
+
+
 void AudioEngineInfoForm::updateInfo()
 {
 	Hydrogen *pEngine = Hydrogen::get_instance();
@@ -120,6 +136,22 @@ void AudioEngineInfoForm::updateInfo()
 	sprintf(tmp, "%#.2f / %#.2f  (%d%%)", pEngine->getProcessTime(), pEngine->getMaxProcessTime(), perc );
 	processTimeLbl->setText(tmp);
 
+	// Audio cycles
+	CycleStats stats = pEngine->readCycleStats();
+	cycleProcessTimeLbl->setText( QString( "%1 / %2 ms" )
+								  .arg( stats.fProcessTimeAvg, 0, 'f', 2 )
+								  .arg( stats.fProcessTimeMax, 0, 'f', 2 ) );
+	cycleJitterLbl->setText( QString( "%1 ms, %2 late cycles" )
+							 .arg( stats.fJitter, 0, 'f', 3 )
+							 .arg( stats.nLateCycles ) );
+	cycleSampleRateLbl->setText( QString( "%1 Hz" ).arg( stats.fSampleRate, 0, 'f', 1 ) );
+
+	// DSP profile
+	Profiler* pProfiler = AudioEngine::get_instance()->get_profiler();
+	if ( pProfiler->isEnabled() ) {
+		profileReportLbl->setText( pProfiler->reportText() );
+	}
+
 	// Song state
 	if (pSong == NULL) {
 		songStateLbl->setText( "NULL song" );
@@ -57,6 +57,7 @@ class AudioEngineInfoForm : public QWidget, public Ui_AudioEngineInfoForm_UI, pu
 
 	public slots:
 		void updateInfo();
+		void on_profileCheckBox_toggled( bool bChecked );
 };
 
 #endif
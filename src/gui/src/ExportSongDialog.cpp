@@ -47,10 +47,7 @@
 #include <hydrogen/event_queue.h>
 
 #include <memory>
-
-#ifdef WIN32
-#include <time.h>
-#endif
+#include <set>
 
 using namespace H2Core;
 
@@ -118,9 +115,9 @@ ExportSongDialog::ExportSongDialog(QWidget* parent)
 	resampleComboBox->setCurrentIndex( m_oldInterpolation );
 	connect(resampleComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(resampleComboBoIndexChanged(int)));
 
-	// if rubberbandBatch calculate time needed by lib rubberband to resample samples
+	// if rubberbandBatch, the samples are stretched once and kept for the export
 	if(b_oldRubberbandBatchMode){
-		calculateRubberbandTime();
+		prepareRubberband();
 	}
 }
 
@@ -514,7 +511,7 @@ void ExportSongDialog::toggleRubberbandBatchMode(bool toggled)
 {
 	Preferences::get_instance()->setRubberBandBatchMode(toggled);
 	if(toggled){
-		calculateRubberbandTime();
+		prepareRubberband();
 	}
 }
 
@@ -550,7 +547,7 @@ void ExportSongDialog::setResamplerMode(int index)
 }
 
 
-void ExportSongDialog::calculateRubberbandTime()
+void ExportSongDialog::prepareRubberband()
 {
 	QApplication::setOverrideCursor(Qt::WaitCursor);
 	closeBtn->setEnabled(false);
@@ -559,64 +556,18 @@ void ExportSongDialog::calculateRubberbandTime()
 	Hydrogen* pHydrogen = Hydrogen::get_instance();
 	Timeline* pTimeline = pHydrogen->getTimeline();
 
+	// the SamplePool keeps the stretched samples, the export finds them ready
 	float oldBPM = pHydrogen->getSong()->__bpm;
-	float lowBPM = oldBPM;
-
-	if( pTimeline->m_timelinevector.size() >= 1 ){
-		for ( int t = 0; t < pTimeline->m_timelinevector.size(); t++){
-			if(pTimeline->m_timelinevector[t].m_htimelinebpm < lowBPM){
-				lowBPM =  pTimeline->m_timelinevector[t].m_htimelinebpm;
-			}
-
-		}
+	std::set<float> tempos;
+	for ( int t = 0; t < pTimeline->m_timelinevector.size(); t++){
+		tempos.insert( pTimeline->m_timelinevector[t].m_htimelinebpm );
 	}
-
-	pHydrogen->setBPM(lowBPM);
-	time_t sTime = time(NULL);
-	Hydrogen *pEngine = Hydrogen::get_instance();
-	Song *song = pEngine->getSong();
-	assert(song);
-	if(song){
-		InstrumentList *songInstrList = song->get_instrument_list();
-		assert(songInstrList);
-		for ( unsigned nInstr = 0; nInstr < songInstrList->size(); ++nInstr ) {
-			Instrument *pInstr = songInstrList->get( nInstr );
-			assert( pInstr );
-			if ( pInstr ){
-                for (std::vector<InstrumentComponent*>::iterator it = pInstr->get_components()->begin() ; it != pInstr->get_components()->end(); ++it) {
-                    InstrumentComponent* pCompo = *it;
-                    for ( int nLayer = 0; nLayer < MAX_LAYERS; nLayer++ ) {
-                        InstrumentLayer *pLayer = pCompo->get_layer( nLayer );
-                        if ( pLayer ) {
-                            Sample *pSample = pLayer->get_sample();
-                            if ( pSample ) {
-                                if( pSample->get_rubberband().use ) {
-                                    Sample *newSample = Sample::load(
-                                                pSample->get_filepath(),
-                                                pSample->get_loops(),
-                                                pSample->get_rubberband(),
-                                                *pSample->get_velocity_envelope(),
-                                                *pSample->get_pan_envelope()
-                                                );
-                                    if( !newSample  ){
-                                        continue;
-                                    }
-                                    delete pSample;
-                                    // insert new sample from newInstrument
-                                    AudioEngine::get_instance()->lock( RIGHT_HERE );
-                                    pLayer->set_sample( newSample );
-                                    AudioEngine::get_instance()->unlock();
-
-                                }
-                            }
-						}
-					}
-				}
-			}
-		}
+	tempos.erase( oldBPM );
+	for ( std::set<float>::iterator it = tempos.begin(); it != tempos.end(); ++it ) {
+		pHydrogen->recalculateRubberband( *it );
 	}
-	Preferences::get_instance()->setRubberBandCalcTime(time(NULL) - sTime);
-	pHydrogen->setBPM(oldBPM);
+	pHydrogen->recalculateRubberband( oldBPM );
+
 	closeBtn->setEnabled(true);
 	resampleComboBox->setEnabled(true);
 	okBtn->setEnabled(true);
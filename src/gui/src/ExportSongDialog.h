@@ -59,7 +59,8 @@ private slots:
 private:
 
 	void setResamplerMode(int index);
-	void calculateRubberbandTime();
+	/// stretch the samples to the tempos of the song ahead of the export
+	void prepareRubberband();
 	bool checkUseOfRubberband();
 
 	bool m_bExporting;
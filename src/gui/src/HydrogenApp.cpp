@@ -23,8 +23,10 @@
 #include <hydrogen/config.h>
 #include <hydrogen/version.h>
 #include <hydrogen/hydrogen.h>
+#include <hydrogen/audio_engine.h>
 #include <hydrogen/event_queue.h>
 #include <hydrogen/fx/LadspaFX.h>
+#include <hydrogen/fx/Effects.h>
 #include <hydrogen/Preferences.h>
 #include <hydrogen/helpers/filesystem.h>
 
@@ -142,7 +144,7 @@ HydrogenApp::~HydrogenApp()
 	}
 
 	#ifdef H2CORE_HAVE_LADSPA
-	for (uint nFX = 0; nFX < MAX_FX; nFX++) {
+	for (uint nFX = 0; nFX < m_pLadspaFXProperties.size(); nFX++) {
 		delete m_pLadspaFXProperties[nFX];
 	}
 	#endif
@@ -267,8 +269,8 @@ void HydrogenApp::setupSinglePanedInterface()
 
 #ifdef H2CORE_HAVE_LADSPA
 	// LADSPA FX
-	for (uint nFX = 0; nFX < MAX_FX; nFX++) {
-		m_pLadspaFXProperties[nFX] = new LadspaFXProperties( NULL, nFX );
+	for (int nFX = 0; nFX < Effects::get_instance()->getNumberOfSlots(); nFX++) {
+		m_pLadspaFXProperties.push_back( new LadspaFXProperties( NULL, nFX ) );
 		m_pLadspaFXProperties[nFX]->hide();
 		WindowProperties prop = pPref->getLadspaProperties(nFX);
 		m_pLadspaFXProperties[nFX]->move( prop.x, prop.y );
@@ -297,7 +299,7 @@ void HydrogenApp::currentTabChanged(int index)
 void HydrogenApp::closeFXProperties()
 {
 #ifdef H2CORE_HAVE_LADSPA
-	for (uint nFX = 0; nFX < MAX_FX; nFX++) {
+	for (uint nFX = 0; nFX < m_pLadspaFXProperties.size(); nFX++) {
 		m_pLadspaFXProperties[nFX]->close();
 	}
 #endif
@@ -452,6 +454,19 @@ void HydrogenApp::songModifiedEvent()
 	updateWindowTitle();
 }
 
+/// The audio engine follows a MIDI clock master on its own, the song
+/// takes its tempo here, away from the audio thread.
+void HydrogenApp::tempoChangedEvent( int nValue )
+{
+	Hydrogen* pEngine = Hydrogen::get_instance();
+	if ( pEngine->getSong() == NULL ) {
+		return;
+	}
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
+	pEngine->setBPM( nValue / 10.0 );
+	AudioEngine::get_instance()->unlock();
+}
+
 void HydrogenApp::onEventQueueTimer()
 {
 	// use the timer to do schedule instrument slaughter;
@@ -459,6 +474,10 @@ void HydrogenApp::onEventQueueTimer()
 
 	Event event;
 	while ( ( event = pQueue->pop_event() ).type != EVENT_NONE ) {
+		if ( event.type == EVENT_TEMPO_CHANGED ) {
+			tempoChangedEvent( event.value );
+		}
+
 		for (int i = 0; i < (int)m_eventListeners.size(); i++ ) {
 			EventListener *pListener = m_eventListeners[ i ];
 
@@ -527,6 +546,10 @@ void HydrogenApp::onEventQueueTimer()
 				pListener->undoRedoActionEvent( event.value );
 				break;
 
+			case EVENT_TEMPO_CHANGED:
+				// applied above, once
+				break;
+
 			default:
 				ERRORLOG( QString("[onEventQueueTimer] Unhandled event: %1").arg( event.type ) );
 			}
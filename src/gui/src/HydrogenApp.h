@@ -101,6 +101,7 @@ class HydrogenApp : public QObject, public H2Core::Object
 
 #ifdef H2CORE_HAVE_LADSPA
 		LadspaFXProperties* getLadspaFXProperties(uint nFX) {	return m_pLadspaFXProperties[nFX];	}
+		uint getLadspaFXPropertiesCount() {	return m_pLadspaFXProperties.size();	}
 #endif
 		void addEventListener( EventListener* pListener );
 		void removeEventListener( EventListener* pListener );
@@ -121,7 +122,7 @@ class HydrogenApp : public QObject, public H2Core::Object
 		static HydrogenApp *m_pInstance;	///< HydrogenApp instance
 
 #ifdef H2CORE_HAVE_LADSPA
-		LadspaFXProperties *m_pLadspaFXProperties[MAX_FX];
+		std::vector<LadspaFXProperties*> m_pLadspaFXProperties;	///< one per FX slot
 #endif
 
 		MainForm *m_pMainForm;
@@ -145,6 +146,7 @@ class HydrogenApp : public QObject, public H2Core::Object
 
 		void setupSinglePanedInterface();
 		virtual void songModifiedEvent();
+		void tempoChangedEvent( int nValue );
 };
 
 
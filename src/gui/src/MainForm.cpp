@@ -211,7 +211,9 @@ MainForm::MainForm( QApplication *app, const QString& songFilename )
 
 MainForm::~MainForm()
 {
-	// remove the autosave file
+	// remove the autosave file, once the pending autosave is written
+	m_autosaveTimer.stop();
+	m_autoSaver.wait();
 	QFile file( getAutoSaveFilename() );
 	file.remove();
 
@@ -269,6 +271,7 @@ void MainForm::createMenuBar()
 
 	m_pFileMenu->addAction ( trUtf8 ( "Open &Pattern" ), this, SLOT ( action_file_openPattern() ), QKeySequence ( "" ) );
 	m_pFileMenu->addAction( trUtf8( "Expor&t pattern as..." ), this, SLOT( action_file_export_pattern_as() ), QKeySequence( "Ctrl+P" ) );
+	m_pFileMenu->addAction( trUtf8( "&Import MIDI file" ), this, SLOT( action_file_import_midi() ), QKeySequence( "" ) );
 
 	m_pFileMenu->addSeparator();				// -----
 
@@ -750,6 +753,46 @@ void MainForm::action_file_openPattern()
 	HydrogenApp::get_instance()->getSongEditorPanel()->updateAll();
 }
 
+void MainForm::action_file_import_midi()
+{
+	if ( ((Hydrogen::get_instance())->getState() == STATE_PLAYING) ) {
+		Hydrogen::get_instance()->sequencer_stop();
+	}
+
+	QFileDialog fd(this);
+	fd.setFileMode( QFileDialog::ExistingFile );
+	fd.setFilter( trUtf8("Midi file (*.mid *.midi)") );
+	fd.setDirectory( QDir::homePath() );
+	fd.setWindowTitle( trUtf8( "Import MIDI file" ) );
+	fd.setWindowIcon( QPixmap( Skin::getImagePath() + "/icon16.png" ) );
+
+	QString sFilename;
+	if ( fd.exec() == QDialog::Accepted ) {
+		sFilename = fd.selectedFiles().first();
+	}
+	if ( sFilename.isEmpty() ) {
+		return;
+	}
+
+	Hydrogen *pEngine = Hydrogen::get_instance();
+	Song *pSong = pEngine->getSong();
+
+	AudioEngine::get_instance()->lock( RIGHT_HERE );
+	LocalFileMng fileMng;
+	int err = fileMng.importMidiFile( pSong, sFilename );
+	if ( err == 0 ) {
+		pEngine->setBPM( pSong->__bpm );
+	}
+	AudioEngine::get_instance()->unlock();
+
+	if ( err != 0 ) {
+		QMessageBox::warning( this, "Hydrogen", trUtf8( "Could not import the MIDI file %1" ).arg( sFilename ) );
+		return;
+	}
+	EventQueue::get_instance()->push_event( EVENT_SONG_MODIFIED, -1 );
+	HydrogenApp::get_instance()->getSongEditorPanel()->updateAll();
+}
+
 /// \todo parametrizzare il metodo action_file_open ed eliminare il seguente...
 void MainForm::action_file_openDemo()
 {
@@ -1017,7 +1060,7 @@ void MainForm::closeAll() {
 
 #ifdef H2CORE_HAVE_LADSPA
 	// save LADSPA FX window properties
-	for (uint nFX = 0; nFX < MAX_FX; nFX++) {
+	for (uint nFX = 0; nFX < h2app->getLadspaFXPropertiesCount(); nFX++) {
 		WindowProperties prop;
 		prop.x = h2app->getLadspaFXProperties(nFX)->x();
 		prop.y = h2app->getLadspaFXProperties(nFX)->y();
@@ -1410,15 +1453,19 @@ void MainForm::action_file_export_midi()
 
 	QFileDialog fd(this);
 	fd.setFileMode(QFileDialog::AnyFile);
-	fd.setFilter( trUtf8("Midi file (*.mid)") );
+	QString sSingleTrackFilter = trUtf8("Midi file (*.mid)");
+	QString sTrackPerInstrumentFilter = trUtf8("Midi file, one track per instrument (*.mid)");
+	fd.setFilters( QStringList() << sSingleTrackFilter << sTrackPerInstrumentFilter );
 	fd.setDirectory( QDir::homePath() );
 	fd.setWindowTitle( trUtf8( "Export MIDI file" ) );
 	fd.setAcceptMode( QFileDialog::AcceptSave );
 	fd.setWindowIcon( QPixmap( Skin::getImagePath() + "/icon16.png" ) );
 
 	QString sFilename;
+	bool bTrackPerInstrument = false;
 	if ( fd.exec() == QDialog::Accepted ) {
 		sFilename = fd.selectedFiles().first();
+		bTrackPerInstrument = fd.selectedFilter() == sTrackPerInstrumentFilter;
 	}
 
 	if ( !sFilename.isEmpty() ) {
@@ -1430,7 +1477,7 @@ void MainForm::action_file_export_midi()
 
 		// create the Standard Midi File object
 		SMFWriter *pSmfWriter = new SMFWriter();
-		pSmfWriter->save( sFilename, pSong );
+		pSmfWriter->save( sFilename, pSong, bTrackPerInstrument );
 
 		delete pSmfWriter;
 	}
@@ -1577,13 +1624,15 @@ QString MainForm::getAutoSaveFilename()
 void MainForm::onAutoSaveTimer()
 {
 	//INFOLOG( "[onAutoSaveTimer]" );
+	// the song is not in its usual state during an export
+	if ( QApplication::activeModalWidget() ) {
+		return;
+	}
 	Song *pSong = Hydrogen::get_instance()->getSong();
 	assert( pSong );
-	QString sOldFilename = pSong->get_filename();
-
-	pSong->save( getAutoSaveFilename() );
 
-	pSong->set_filename(sOldFilename);
+	// written by the saver thread, skipped if nothing changed
+	m_autoSaver.save( pSong, getAutoSaveFilename() );
 }
 
 
@@ -33,6 +33,7 @@
 
 #include <hydrogen/config.h>
 #include <hydrogen/object.h>
+#include <hydrogen/basics/song_saver.h>
 
 class HydrogenApp;
 class QUndoView;///debug only
@@ -71,6 +72,7 @@ public slots:
 		void action_file_save_as();
 		void action_file_openPattern();
 		void action_file_export_pattern_as();
+		void action_file_import_midi();
 		bool action_file_exit();
 
 		void action_file_export();
@@ -149,6 +151,7 @@ public slots:
 		QHttp m_http;
 
 		QTimer m_autosaveTimer;
+		H2Core::SongSaver m_autoSaver;
 
 		/** Create the menubar */
 		void createMenuBar();
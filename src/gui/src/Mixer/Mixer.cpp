@@ -43,6 +43,7 @@
 using namespace H2Core;
 
 #include <cassert>
+#include <algorithm>
 
 #define MIXER_STRIP_WIDTH	56
 #define MASTERMIXER_STRIP_WIDTH	126
@@ -84,22 +85,41 @@ Mixer::Mixer( QWidget* pParent )
 
 
 // fX frame
+#ifdef H2CORE_HAVE_LADSPA
+	int nSlots = Effects::get_instance()->getNumberOfSlots();
+#else
+	int nSlots = MAX_FX;
+#endif
+	m_nFirstFX = 0;
 	m_pFXFrame = new PixmapWidget( NULL );
-	m_pFXFrame->setFixedSize( 213, height() );
+	m_pFXFrame->setFixedSize( 213, std::max( height(), 43 * ( nSlots - MAX_FX ) + height() ) );
 	m_pFXFrame->setPixmap( "/mixerPanel/background_FX.png" );
-	for (uint nFX = 0; nFX < MAX_FX; nFX++) {
-		m_pLadspaFXLine[nFX] = new LadspaFXMixerLine( m_pFXFrame );
-		m_pLadspaFXLine[nFX]->move( 13, 43 * nFX + 84 );
-		connect( m_pLadspaFXLine[nFX], SIGNAL( activeBtnClicked(LadspaFXMixerLine*) ), this, SLOT( ladspaActiveBtnClicked( LadspaFXMixerLine*) ) );
-		connect( m_pLadspaFXLine[nFX], SIGNAL( editBtnClicked(LadspaFXMixerLine*) ), this, SLOT( ladspaEditBtnClicked( LadspaFXMixerLine*) ) );
-		connect( m_pLadspaFXLine[nFX], SIGNAL( volumeChanged(LadspaFXMixerLine*) ), this, SLOT( ladspaVolumeChanged( LadspaFXMixerLine*) ) );
-	}
+	for (int nFX = 0; nFX < nSlots; nFX++) {
+		LadspaFXMixerLine *pLine = new LadspaFXMixerLine( m_pFXFrame );
+		pLine->move( 13, 43 * nFX + 84 );
+		connect( pLine, SIGNAL( activeBtnClicked(LadspaFXMixerLine*) ), this, SLOT( ladspaActiveBtnClicked( LadspaFXMixerLine*) ) );
+		connect( pLine, SIGNAL( editBtnClicked(LadspaFXMixerLine*) ), this, SLOT( ladspaEditBtnClicked( LadspaFXMixerLine*) ) );
+		connect( pLine, SIGNAL( volumeChanged(LadspaFXMixerLine*) ), this, SLOT( ladspaVolumeChanged( LadspaFXMixerLine*) ) );
+		m_pLadspaFXLine.push_back( pLine );
+	}
+
+	// the FX sends of the strips follow the slots shown in the panel
+	m_pFXScrollArea = new QScrollArea( NULL );
+	m_pFXScrollArea->setFrameShape( QFrame::NoFrame );
+	m_pFXScrollArea->setHorizontalScrollBarPolicy( Qt::ScrollBarAlwaysOff );
+	m_pFXScrollArea->setVerticalScrollBarPolicy( nSlots > MAX_FX ? Qt::ScrollBarAlwaysOn : Qt::ScrollBarAlwaysOff );
+	m_pFXScrollArea->verticalScrollBar()->setSingleStep( 43 );
+	m_pFXScrollArea->verticalScrollBar()->setPageStep( 43 * MAX_FX );
+	m_pFXScrollArea->setWidget( m_pFXFrame );
+	int nScrollBarWidth = nSlots > MAX_FX ? m_pFXScrollArea->verticalScrollBar()->sizeHint().width() : 0;
+	m_pFXScrollArea->setFixedWidth( m_pFXFrame->width() + nScrollBarWidth );
+	connect( m_pFXScrollArea->verticalScrollBar(), SIGNAL( valueChanged(int) ), this, SLOT( fxPanelScrolled(int) ) );
 
 	if ( Preferences::get_instance()->isFXTabVisible() ) {
-		m_pFXFrame->show();
+		m_pFXScrollArea->show();
 	}
 	else {
-		m_pFXFrame->hide();
+		m_pFXScrollArea->hide();
 	}
 //~ fX frame
 
@@ -150,7 +170,7 @@ Mixer::Mixer( QWidget* pParent )
 	pLayout->setMargin( 0 );
 
 	pLayout->addWidget( m_pFaderScrollArea );
-	pLayout->addWidget( m_pFXFrame );
+	pLayout->addWidget( m_pFXScrollArea );
 	pLayout->addWidget( m_pMasterLine );
 	this->setLayout( pLayout );
 
@@ -183,6 +203,7 @@ MixerLine* Mixer::createMixerLine( int nInstr )
 	connect( pMixerLine, SIGNAL( instrumentNameSelected(MixerLine*) ), this, SLOT( nameSelected(MixerLine*) ) );
 	connect( pMixerLine, SIGNAL( panChanged(MixerLine*) ), this, SLOT( panChanged( MixerLine*) ) );
 	connect( pMixerLine, SIGNAL( knobChanged(MixerLine*, int) ), this, SLOT( knobChanged( MixerLine*, int) ) );
+	pMixerLine->setFirstFXKnob( m_nFirstFX );
 
 	return pMixerLine;
 }
@@ -548,7 +569,7 @@ void Mixer::updateMixer()
 				pLine->setPlayClicked( false );
 			}
 
-			for (uint nFX = 0; nFX < MAX_FX; nFX++) {
+			for (uint nFX = 0; nFX < m_pLadspaFXLine.size(); nFX++) {
 				pLine->setFXLevel( nFX, pInstr->get_fx_level( nFX ) );
 			}
 
@@ -574,11 +595,8 @@ void Mixer::updateMixer()
 
 		ComponentMixerLine *pLine = m_pComponentMixerLine[ p_compo->get_id() ];
 
-		float fNewPeak_L = p_compo->get_peak_l();
-		p_compo->set_peak_l( 0.0f );	// reset instrument peak
-
-		float fNewPeak_R = p_compo->get_peak_r();
-		p_compo->set_peak_r( 0.0f );	// reset instrument peak
+		float fNewPeak_L = p_compo->take_peak_l();
+		float fNewPeak_R = p_compo->take_peak_r();
 
 		float fNewVolume = p_compo->get_volume();
 		bool bMuted = p_compo->is_muted();
@@ -667,12 +685,12 @@ void Mixer::updateMixer()
 
 
 	// update MasterPeak
+	MeterValues masterLevels = pEngine->readMasterMeter();
 	float oldPeak_L = m_pMasterLine->getPeak_L();
-	float newPeak_L = pEngine->getMasterPeak_L();
-	pEngine->setMasterPeak_L(0.0);
+	float newPeak_L = masterLevels.fPeak_L;
 	float oldPeak_R = m_pMasterLine->getPeak_R();
-	float newPeak_R = pEngine->getMasterPeak_R();
-	pEngine->setMasterPeak_R(0.0);
+	float newPeak_R = masterLevels.fPeak_R;
+	m_pMasterLine->setLevels( masterLevels );
 
 	if (!bShowPeaks) {
 		newPeak_L = 0.0;
@@ -706,7 +724,7 @@ void Mixer::updateMixer()
 
 #ifdef H2CORE_HAVE_LADSPA
 	// LADSPA
-	for (uint nFX = 0; nFX < MAX_FX; nFX++) {
+	for (uint nFX = 0; nFX < m_pLadspaFXLine.size(); nFX++) {
 		LadspaFX *pFX = Effects::get_instance()->getLadspaFX( nFX );
 		if ( pFX ) {
 			m_pLadspaFXLine[nFX]->setName( pFX->getPluginName() );
@@ -838,11 +856,11 @@ void Mixer::resizeEvent ( QResizeEvent *ev )
 void Mixer::showFXPanelClicked(Button* ref)
 {
 	if ( ref->isPressed() ) {
-		m_pFXFrame->show();
+		m_pFXScrollArea->show();
 		Preferences::get_instance()->setFXTabVisible( true );
 	}
 	else {
-		m_pFXFrame->hide();
+		m_pFXScrollArea->hide();
 		Preferences::get_instance()->setFXTabVisible( false );
 	}
 
@@ -872,7 +890,7 @@ void Mixer::ladspaActiveBtnClicked( LadspaFXMixerLine* ref )
 #ifdef H2CORE_HAVE_LADSPA
 	bool bActive = ref->isFxActive();
 
-	for (uint nFX = 0; nFX < MAX_FX; nFX++) {
+	for (uint nFX = 0; nFX < m_pLadspaFXLine.size(); nFX++) {
 		if (ref == m_pLadspaFXLine[ nFX ] ) {
 			LadspaFX *pFX = Effects::get_instance()->getLadspaFX(nFX);
 			if (pFX) {
@@ -890,7 +908,7 @@ void Mixer::ladspaEditBtnClicked( LadspaFXMixerLine *ref )
 {
 #ifdef H2CORE_HAVE_LADSPA
 
-	for (uint nFX = 0; nFX < MAX_FX; nFX++) {
+	for (uint nFX = 0; nFX < m_pLadspaFXLine.size(); nFX++) {
 		if (ref == m_pLadspaFXLine[ nFX ] ) {
 			HydrogenApp::get_instance()->getLadspaFXProperties(nFX)->hide();
 			HydrogenApp::get_instance()->getLadspaFXProperties(nFX)->show();
@@ -908,7 +926,7 @@ void Mixer::ladspaVolumeChanged( LadspaFXMixerLine* ref)
 	Song *pSong = (Hydrogen::get_instance() )->getSong();
 	pSong->set_is_modified( true );
 
-	for (uint nFX = 0; nFX < MAX_FX; nFX++) {
+	for (uint nFX = 0; nFX < m_pLadspaFXLine.size(); nFX++) {
 		if (ref == m_pLadspaFXLine[ nFX ] ) {
 			LadspaFX *pFX = Effects::get_instance()->getLadspaFX(nFX);
 			if (pFX) {
@@ -924,6 +942,23 @@ void Mixer::ladspaVolumeChanged( LadspaFXMixerLine* ref)
 
 
 
+void Mixer::fxPanelScrolled( int nValue )
+{
+	int nFirstFX = ( nValue + 21 ) / 43;
+	if ( nFirstFX == m_nFirstFX ) {
+		return;
+	}
+	m_nFirstFX = nFirstFX;
+	for ( uint i = 0; i < MAX_INSTRUMENTS; ++i ) {
+		if ( m_pMixerLine[ i ] ) {
+			m_pMixerLine[ i ]->setFirstFXKnob( m_nFirstFX );
+		}
+	}
+}
+
+
+
+
 void Mixer::getPeaksInMixerLine( uint nMixerLine, float& fPeak_L, float& fPeak_R )
 {
 	if ( nMixerLine < MAX_INSTRUMENTS ) {
@@ -78,10 +78,12 @@ class Mixer : public QWidget, public EventListener, public H2Core::Object
 		void ladspaActiveBtnClicked( LadspaFXMixerLine* ref );
 		void ladspaEditBtnClicked( LadspaFXMixerLine *ref );
 		void ladspaVolumeChanged( LadspaFXMixerLine* ref);
+		void fxPanelScrolled( int nValue );
 
 	private:
 		QHBoxLayout *m_pFaderHBox;
-		LadspaFXMixerLine *m_pLadspaFXLine[MAX_FX];
+		std::vector<LadspaFXMixerLine*> m_pLadspaFXLine;	///< one per FX slot
+		int m_nFirstFX;			///< first FX slot shown by the FX sends of the strips
 
 		QScrollArea* m_pFaderScrollArea;
 		ToggleButton *m_pShowFXPanelBtn;
@@ -93,6 +95,7 @@ class Mixer : public QWidget, public EventListener, public H2Core::Object
 		std::map<int, ComponentMixerLine*> m_pComponentMixerLine;
 
 		PixmapWidget *m_pFXFrame;
+		QScrollArea* m_pFXScrollArea;	///< scrolls m_pFXFrame when there are more than MAX_FX slots
 
 		QTimer *m_pUpdateTimer;
 
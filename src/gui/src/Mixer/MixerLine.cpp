@@ -21,6 +21,8 @@
  */
 
 #include <stdio.h>
+#include <algorithm>
+#include <cmath>
 
 #include <QPainter>
 
@@ -36,6 +38,7 @@
 #include <hydrogen/Preferences.h>
 #include <hydrogen/audio_engine.h>
 #include <hydrogen/midi_action.h>
+#include <hydrogen/fx/Effects.h>
 using namespace H2Core;
 
 #include "MixerLine.h"
@@ -128,21 +131,20 @@ MixerLine::MixerLine(QWidget* parent, int nInstr)
 	m_pPanRotary->setAction(pAction);
 
 	// FX send
-	uint y = 0;
-	for (uint i = 0; i < MAX_FX; i++) {
-		m_pKnob[i] = new Knob(this);
+#ifdef H2CORE_HAVE_LADSPA
+	int nSlots = Effects::get_instance()->getNumberOfSlots();
+#else
+	int nSlots = MAX_FX;
+#endif
+	for (int i = 0; i < nSlots; i++) {
+		Knob *pKnob = new Knob(this);
 		pAction = new MidiAction(QString( "EFFECT%1_LEVEL_ABSOLUTE" ).arg( QString::number(i+1) ));
 		pAction->setParameter1( QString::number( nInstr ) );
-		m_pKnob[i]->setAction( pAction );
-		if ( (i % 2) == 0 ) {
-			m_pKnob[i]->move( 9, 63 + (20 * y) );
-		}
-		else {
-			m_pKnob[i]->move( 30, 63 + (20 * y) );
-			y++;
-		}
-		connect( m_pKnob[i], SIGNAL( valueChanged(Knob*) ), this, SLOT( knobChanged(Knob*) ) );
+		pKnob->setAction( pAction );
+		connect( pKnob, SIGNAL( valueChanged(Knob*) ), this, SLOT( knobChanged(Knob*) ) );
+		m_pKnob.push_back( pKnob );
 	}
+	setFirstFXKnob( 0 );
 
 	Preferences *pref = Preferences::get_instance();
 
@@ -431,7 +433,7 @@ void MixerLine::setPlayClicked( bool clicked ) {
 void MixerLine::knobChanged(Knob* pRef)
 {
 //	infoLog( "knobChanged" );
-	for (uint i = 0; i < MAX_FX; i++) {
+	for (uint i = 0; i < m_pKnob.size(); i++) {
 		if (m_pKnob[i] == pRef) {
 			emit knobChanged( this, i );
 			break;
@@ -442,8 +444,8 @@ void MixerLine::knobChanged(Knob* pRef)
 
 void MixerLine::setFXLevel( uint nFX, float fValue )
 {
-	if (nFX > MAX_FX) {
-		ERRORLOG( QString("[setFXLevel] nFX > MAX_FX (nFX=%1)").arg(nFX) );
+	if (nFX >= m_pKnob.size()) {
+		ERRORLOG( QString("[setFXLevel] nFX >= FX slots (nFX=%1)").arg(nFX) );
 		return;
 	}
 	m_pKnob[nFX]->setValue( fValue );
@@ -451,13 +453,27 @@ void MixerLine::setFXLevel( uint nFX, float fValue )
 
 float MixerLine::getFXLevel(uint nFX)
 {
-	if (nFX > MAX_FX) {
-		ERRORLOG( QString("[setFXLevel] nFX > MAX_FX (nFX=%1)").arg(nFX) );
+	if (nFX >= m_pKnob.size()) {
+		ERRORLOG( QString("[getFXLevel] nFX >= FX slots (nFX=%1)").arg(nFX) );
 		return 0.0f;
 	}
 	return m_pKnob[nFX]->getValue();
 }
 
+void MixerLine::setFirstFXKnob( int nFirstFX )
+{
+	// two knobs per row, the strip has room for MAX_FX of them
+	for (int i = 0; i < (int)m_pKnob.size(); i++) {
+		int nPos = i - nFirstFX;
+		if ( nPos < 0 || nPos >= MAX_FX ) {
+			m_pKnob[i]->hide();
+			continue;
+		}
+		m_pKnob[i]->move( (nPos % 2) == 0 ? 9 : 30, 63 + 20 * (nPos / 2) );
+		m_pKnob[i]->show();
+	}
+}
+
 
 void MixerLine::setSelected( bool bIsSelected )
 {
@@ -896,6 +912,22 @@ void MasterMixerLine::setPeak_R(float peak) {
 
 
 
+void MasterMixerLine::setLevels( const MeterValues& levels )
+{
+	// dB values share the floor of the loudness meter
+	float fTruePeak = std::max( levels.fTruePeak_L, levels.fTruePeak_R );
+	float fRms = std::max( levels.fRms_L, levels.fRms_R );
+	double fTruePeak_dB = std::max( (double)Meter::LUFS_FLOOR, 20.0 * log10( std::max( fTruePeak, 1.0e-6f ) ) );
+	double fRms_dB = std::max( (double)Meter::LUFS_FLOOR, 20.0 * log10( std::max( fRms, 1.0e-6f ) ) );
+	QString sTip = trUtf8( "True peak: %1 dBTP\nRMS: %2 dB\nShort term loudness: %3 LUFS" )
+			.arg( fTruePeak_dB, 0, 'f', 1 )
+			.arg( fRms_dB, 0, 'f', 1 )
+			.arg( levels.fLufs, 0, 'f', 1 );
+	m_pPeakLCD->setToolTip( sTip );
+}
+
+
+
 float MasterMixerLine::getPeak_R() {
 	return m_pMasterFader->getPeak_R();
 }
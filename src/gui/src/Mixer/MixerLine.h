@@ -24,9 +24,11 @@
 
 
 #include <QtGui>
+#include <vector>
 
 #include <hydrogen/object.h>
 #include <hydrogen/globals.h>
+#include <hydrogen/helpers/meter.h>
 
 class Fader;
 class MasterFader;
@@ -114,6 +116,8 @@ class MixerLine: public PixmapWidget
 
 		void setFXLevel( uint nFX, float fValue );
 		float getFXLevel( uint nFX );
+		/// show the MAX_FX send knobs from FX slot nFirstFX
+		void setFirstFXKnob( int nFirstFX );
 
 		void setSelected( bool bIsSelected );
 
@@ -153,7 +157,7 @@ class MixerLine: public PixmapWidget
 		ToggleButton *m_pSoloBtn;
 		Button *m_pPlaySampleBtn;
 		Button *m_pTriggerSampleLED;
-		Knob *m_pKnob[MAX_FX];
+		std::vector<Knob*> m_pKnob;		///< one FX send per FX slot
 
 		LCDDisplay *m_pPeakLCD;
 };
@@ -267,6 +271,9 @@ class MasterMixerLine: public PixmapWidget
 		void setPeak_R(float peak);
 		float getPeak_R();
 
+		/// true peak, RMS and loudness shown in the peak display tooltip
+		void setLevels( const H2Core::MeterValues& levels );
+
 
 	signals:
 		void volumeChanged(MasterMixerLine *ref);
@@ -119,6 +119,9 @@ PreferencesDialog::PreferencesDialog(QWidget* parent)
 	}
 
 	m_pIgnoreNoteOffCheckBox->setChecked( pPref->m_bMidiNoteOffIgnore );
+	m_pMidiClockOutputCheckBox->setChecked( pPref->m_bMidiClockOutput );
+	m_pMidiTimecodeOutputCheckBox->setChecked( pPref->m_bMidiTimecodeOutput );
+	m_pMidiSyncInputComboBox->setCurrentIndex( pPref->m_nMidiSyncInput );
 
 	updateDriverInfo();
 
@@ -130,6 +133,14 @@ PreferencesDialog::PreferencesDialog(QWidget* parent)
 	// max voices
 	maxVoicesTxt->setValue( pPref->m_nMaxNotes );
 
+	// FX slots
+	fxSlotsSpinBox->setMaximum( FX_SLOTS_MAX );
+	fxSlotsSpinBox->setValue( pPref->m_nFXSlots );
+#ifndef H2CORE_HAVE_LADSPA
+	fxSlotsLbl->hide();
+	fxSlotsSpinBox->hide();
+#endif
+
 	// JACK
 	trackOutsCheckBox->setChecked( pPref->m_bJackTrackOuts );
 	connect(trackOutsCheckBox, SIGNAL(toggled(bool)), this, SLOT(toggleTrackOutsCheckBox( bool )));
@@ -391,6 +402,12 @@ void PreferencesDialog::on_okBtn_clicked()
 	// maxVoices
 	pPref->m_nMaxNotes = maxVoicesTxt->value();
 
+	// FX slots, the rack is built at startup
+	if ( pPref->m_nFXSlots != fxSlotsSpinBox->value() ) {
+		pPref->m_nFXSlots = fxSlotsSpinBox->value();
+		QMessageBox::information( this, "Hydrogen", trUtf8( "Please restart hydrogen to change the number of FX slots" ) );
+	}
+
 	if ( m_pMidiDriverComboBox->currentText() == "ALSA" ) {
 		pPref->m_sMidiDriver = "ALSA";
 	}
@@ -407,6 +424,9 @@ void PreferencesDialog::on_okBtn_clicked()
 
 
 	pPref->m_bMidiNoteOffIgnore = m_pIgnoreNoteOffCheckBox->isChecked();
+	pPref->m_bMidiClockOutput = m_pMidiClockOutputCheckBox->isChecked();
+	pPref->m_bMidiTimecodeOutput = m_pMidiTimecodeOutputCheckBox->isChecked();
+	pPref->m_nMidiSyncInput = m_pMidiSyncInputComboBox->currentIndex();
 
 	// Mixer falloff
 	QString falloffStr = mixerFalloffComboBox->currentText();
@@ -18,6 +18,7 @@
 #include <hydrogen/LocalFileMng.h>
 #include <hydrogen/Preferences.h>
 #include <hydrogen/basics/drumkit.h>
+#include <hydrogen/helpers/sound_library_index.h>
 
 using namespace H2Core;
 
@@ -29,6 +30,7 @@ SoundLibraryDatabase::SoundLibraryDatabase() : Object( __class_name )
 {
 	INFOLOG( "INIT" );
 	patternVector = new soundLibraryInfoVector();
+	index = new SoundLibraryIndex();
 	updatePatterns();
 }
 
@@ -42,6 +44,7 @@ SoundLibraryDatabase::~SoundLibraryDatabase()
 	}
 
 	delete patternVector;
+	delete index;
 }
 
 void SoundLibraryDatabase::create_instance()
@@ -83,49 +86,37 @@ void SoundLibraryDatabase::update()
 
 void SoundLibraryDatabase::updatePatterns()
 {
-	//Clear the current pattern informations, then start to fill it again..
+	//Clear the current pattern informations, then fill it again from the index
+	soundLibraryInfoVector::iterator mapIterator;
+	for( mapIterator=patternVector->begin(); mapIterator != patternVector->end(); mapIterator++ )
+	{
+		delete *mapIterator;
+	}
 	patternVector->clear();
 	patternCategories = QStringList();
 
-	/* First location to store patterns: inside .hydrogen/data/patterns/GMkit etc.
-	 * each subdir builds a relationship between the pattern and the drumkit
+	/* The patterns of .hydrogen/data/patterns/GMkit etc. come first,
+	 * then the ones of .hydrogen/data/patterns which do not belong to a certain drumkit.
+	 * Only the pattern files modified since the last update are read.
 	 */
-
-	std::vector<QString> perDrumkitPatternDirectories = LocalFileMng::getDrumkitsFromDirectory( Preferences::get_instance()->getDataDirectory() + "patterns" );
-	std::vector<QString>::iterator drumkitIterator;
-
-	for( drumkitIterator = perDrumkitPatternDirectories.begin(); drumkitIterator != perDrumkitPatternDirectories.end(); drumkitIterator++ )
-	{
-		getPatternFromDirectory( *drumkitIterator, patternVector);
-	}
-
-	//2. This is the general location for patterns which do not belong to a certain drumkit.
-	QString userPatternDirectory = Preferences::get_instance()->getDataDirectory() + "patterns";
-	getPatternFromDirectory( userPatternDirectory, patternVector);
-}
-
-int SoundLibraryDatabase::getPatternFromDirectory( const QString& sPatternDir, std::vector<SoundLibraryInfo*>* patternVector )
-{
-	QDir dir( sPatternDir );
-
-	if ( !dir.exists() ) {
-		ERRORLOG( QString( "[getPatternList] Directory %1 not found" ).arg( sPatternDir ) );
-	} else {
-		dir.setFilter( QDir::Files );
-		QFileInfoList fileList = dir.entryInfoList();
-
-		for ( int i = 0; i < fileList.size(); ++i ) {
-			QString sFile = sPatternDir + "/" + fileList.at( i ).fileName();
-
-			if( sFile.endsWith(".h2pattern") ){
-				SoundLibraryInfo* slInfo = new SoundLibraryInfo( sFile );
-				patternVector->push_back( slInfo );
-
-				if(! patternCategories.contains( slInfo->getCategory() ) ) patternCategories << slInfo->getCategory();
-			}
-		}
+	index->update();
+
+	const std::vector<SoundLibraryIndex::PatternInfo>& patterns = index->patterns();
+	for ( uint i = 0; i < patterns.size(); ++i ) {
+		const SoundLibraryIndex::PatternInfo& pattern = patterns[i];
+		SoundLibraryInfo* slInfo = new SoundLibraryInfo();
+		slInfo->setType( "pattern" );
+		slInfo->setPath( pattern.path );
+		slInfo->setName( pattern.name );
+		slInfo->setInfo( pattern.info );
+		slInfo->setCategory( pattern.category );
+		slInfo->setAuthor( pattern.author );
+		slInfo->setLicense( pattern.license );
+		slInfo->setDrumkitName( pattern.drumkit );
+		patternVector->push_back( slInfo );
+
+		if(! patternCategories.contains( slInfo->getCategory() ) ) patternCategories << slInfo->getCategory();
 	}
-	return 0;
 }
 
 
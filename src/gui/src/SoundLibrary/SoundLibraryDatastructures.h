@@ -6,12 +6,19 @@
 
 class SoundLibraryInfo;
 
+namespace H2Core
+{
+	class SoundLibraryIndex;
+}
+
 /**
 * @class SoundLibraryDatabase
 *
 * @brief This class holds informations about all installed soundlibrary items.
 *
 * This class organizes the metadata of all locally installed soundlibrary items.
+* The metadata is read from the H2Core::SoundLibraryIndex, which only parses
+* the files modified since the last update.
 *
 * @author Sebastian Moors
 *
@@ -28,6 +35,10 @@ class SoundLibraryDatabase:  public H2Core::Object
 
 		//bool isItemInstalled( const SoundLibraryInfo& item );
 		soundLibraryInfoVector* getAllPatterns() const;
+		/// the installed drumkits and patterns, up to date since the last update()
+		const H2Core::SoundLibraryIndex* getIndex() const {
+			return index;
+		}
 		QStringList getAllPatternCategories() const {
 			return patternCategories;
 		}
@@ -35,7 +46,6 @@ class SoundLibraryDatabase:  public H2Core::Object
 		void update();
 		void updatePatterns();
 		void printPatterns();
-		int getPatternFromDirectory(const QString& path, soundLibraryInfoVector* );
 		bool isPatternInstalled( const QString& patternName);
 
 		static void create_instance();
@@ -46,6 +56,7 @@ class SoundLibraryDatabase:  public H2Core::Object
 		static SoundLibraryDatabase *__instance;
 		soundLibraryInfoVector* patternVector;
 		QStringList patternCategories;
+		H2Core::SoundLibraryIndex* index;
 };
 
 
@@ -97,6 +108,10 @@ class SoundLibraryInfo :  public H2Core::Object
 			return m_sLicense;
 		}
 
+		QString getDrumkitName() const {
+			return m_sDrumkitName;
+		}
+
 		void setName( const QString& name ){
 			m_sName = name;
 		}
@@ -125,6 +140,10 @@ class SoundLibraryInfo :  public H2Core::Object
 			m_sLicense = license;
 		}
 
+		void setDrumkitName( const QString& drumkitName ){
+			m_sDrumkitName = drumkitName;
+		}
+
 		void setPath( const QString& path){
 			m_sPath = path;
 		}
@@ -143,6 +162,7 @@ class SoundLibraryInfo :  public H2Core::Object
 		QString m_sType;
 		QString m_sLicense;
 		QString m_sPath;
+		QString m_sDrumkitName;
 };
 
 #endif // SOUNDLIBRARYDATASTRUCTURES_H
@@ -21,9 +21,12 @@
  */
 
 #include "SoundLibraryExportDialog.h"
+#include "SoundLibraryDatastructures.h"
 
 #include <hydrogen/hydrogen.h>
+#include <hydrogen/helpers/drumkit_archive.h>
 #include <hydrogen/helpers/filesystem.h>
+#include <hydrogen/helpers/sound_library_index.h>
 #include <hydrogen/Preferences.h>
 #include <hydrogen/h2_exception.h>
 
@@ -33,12 +36,6 @@
 #include <QFileDialog>
 #include <memory>
 #include <QtGui>
-#if defined(H2CORE_HAVE_LIBARCHIVE)
-#include <archive.h>
-#include <archive_entry.h>
-#include <fcntl.h>
-#include <cstdio>
-#endif
 
 using namespace H2Core;
 
@@ -63,12 +60,6 @@ SoundLibraryExportDialog::SoundLibraryExportDialog( QWidget* pParent,  const QSt
 SoundLibraryExportDialog::~SoundLibraryExportDialog()
 {
 	INFOLOG( "DESTROY" );
-
-	for (uint i = 0; i < drumkitInfoList.size(); i++ ) {
-		Drumkit* info = drumkitInfoList[i];
-		delete info;
-	}
-	drumkitInfoList.clear();
 }
 
 
@@ -81,63 +72,21 @@ void SoundLibraryExportDialog::on_exportBtn_clicked()
 	QString drumkitDir = Filesystem::drumkit_dir_search( drumkitName );
 	QString saveDir = drumkitPathTxt->text();
 
-#if defined(H2CORE_HAVE_LIBARCHIVE)
+#if defined(H2CORE_HAVE_ZLIB)
 	QString fullDir = drumkitDir + "/" + drumkitName;
-	QDir sourceDir(fullDir);
-
-	sourceDir.setFilter(QDir::Files);
-	QStringList filesList = sourceDir.entryList();
-
 	QString outname = saveDir + "/" + drumkitName + ".h2drumkit";
 
-	struct archive *a;
-	struct archive_entry *entry;
-	struct stat st;
-	char buff[8192];
-	int len;
-	int fd;
-
-	a = archive_write_new();
-
-	#if ARCHIVE_VERSION_NUMBER < 3000000
-		archive_write_set_compression_gzip(a);
-	#else
-		archive_write_add_filter_gzip(a);
-	#endif
-
-	archive_write_set_format_pax_restricted(a);
-	archive_write_open_filename(a, outname.toUtf8().constData());
-	for (int i = 0; i < filesList.size(); i++) {
-		QString filename = fullDir + "/" + filesList.at(i);
-		QString targetFilename = drumkitName + "/" + filesList.at(i);
-		stat(filename.toUtf8().constData(), &st);
-		entry = archive_entry_new();
-		archive_entry_set_pathname(entry, targetFilename.toUtf8().constData());
-		archive_entry_set_size(entry, st.st_size);
-		archive_entry_set_filetype(entry, AE_IFREG);
-		archive_entry_set_perm(entry, 0644);
-		archive_write_header(a, entry);
-		fd = ::open(filename.toUtf8().constData(), O_RDONLY);
-		len = read(fd, buff, sizeof(buff));
-		while ( len > 0 ) {
-				archive_write_data(a, buff, len);
-				len = read(fd, buff, sizeof(buff));
-		}
-		::close(fd);
-		archive_entry_free(entry);
-	}
-	archive_write_close(a);
-
-	#if ARCHIVE_VERSION_NUMBER < 3000000
-		archive_write_finish(a);
-	#else
-		archive_write_free(a);
-	#endif
-
-	filesList.clear();
+	// the files are compressed in parallel
+	DrumkitArchive::Stats stats;
+	bool ok = DrumkitArchive::create( fullDir, outname, &stats );
 
 	QApplication::restoreOverrideCursor();
-	QMessageBox::information( this, "Hydrogen", "Drumkit exported." );
+	if ( ok ) {
+		INFOLOG( QString( "%1 exported, %2 MB/s" ).arg( outname ).arg( stats.throughput() ) );
+		QMessageBox::information( this, "Hydrogen", "Drumkit exported." );
+	} else {
+		QMessageBox::warning( this, "Hydrogen", "Drumkit not exported." );
+	}
 #elif !defined(WIN32)
 	QString cmd = QString( "cd " ) + drumkitDir + "; tar czf \"" + saveDir + "/" + drumkitName + ".h2drumkit\" -- \"" + drumkitName + "\"";
 	int ret = system( cmd.toLocal8Bit() );
@@ -181,30 +130,12 @@ void SoundLibraryExportDialog::updateDrumkitList()
 
 	drumkitList->clear();
 
-	for (uint i = 0; i < drumkitInfoList.size(); i++ ) {
-		Drumkit* info = drumkitInfoList[i];
-		delete info;
-	}
-	drumkitInfoList.clear();
-
-	QStringList sysDrumkits = Filesystem::sys_drumkits_list();
-	for (int i = 0; i < sysDrumkits.size(); ++i) {
-		QString absPath = Filesystem::sys_drumkits_dir() + "/" + sysDrumkits.at(i);
-		Drumkit *info = Drumkit::load( absPath );
-		if (info) {
-			drumkitInfoList.push_back( info );
-			drumkitList->addItem( info->get_name() );
-		}
-	}
-
-	QStringList userDrumkits = Filesystem::usr_drumkits_list();
-	for (int i = 0; i < userDrumkits.size(); ++i) {
-		QString absPath = Filesystem::usr_drumkits_dir() + "/" + userDrumkits.at(i);
-		Drumkit *info = Drumkit::load( absPath );
-		if (info) {
-			drumkitInfoList.push_back( info );
-			drumkitList->addItem( info->get_name() );
-		}
+	// the names come from the index, the system drumkits first
+	SoundLibraryDatabase* db = SoundLibraryDatabase::get_instance();
+	db->update();
+	const std::vector<SoundLibraryIndex::DrumkitInfo>& drumkits = db->getIndex()->drumkits();
+	for (uint i = 0; i < drumkits.size(); i++ ) {
+		drumkitList->addItem( drumkits[i].name );
 	}
 
 	/*
@@ -48,7 +48,6 @@ private slots:
 	void on_drumkitPathTxt_textChanged( QString str );
 	void updateDrumkitList();
 private:
-	std::vector<H2Core::Drumkit*> drumkitInfoList;
 	QString preselectedKit;
 };
 
@@ -56,6 +56,7 @@
 #include <hydrogen/basics/sample.h>
 #include <hydrogen/basics/song.h>
 #include <hydrogen/helpers/filesystem.h>
+#include <hydrogen/helpers/sound_library_index.h>
 
 using namespace H2Core;
 
@@ -133,16 +134,6 @@ SoundLibraryPanel::SoundLibraryPanel( QWidget *pParent )
 
 SoundLibraryPanel::~SoundLibraryPanel()
 {
-	for (uint i = 0; i < __system_drumkit_info_list.size(); ++i ) {
-		delete __system_drumkit_info_list[i];
-	}
-	__system_drumkit_info_list.clear();
-
-	for (uint i = 0; i < __user_drumkit_info_list.size(); ++i ) {
-		delete __user_drumkit_info_list[i];
-	}
-	__user_drumkit_info_list.clear();
-
 }
 
 
@@ -151,8 +142,6 @@ void SoundLibraryPanel::updateDrumkitList()
 {
 	QString currentSL = Hydrogen::get_instance()->getCurrentDrumkitname();
 
-	LocalFileMng mng;
-
 	__sound_library_tree->clear();
 
 
@@ -167,57 +156,22 @@ void SoundLibraryPanel::updateDrumkitList()
 
 	
 
-	for (uint i = 0; i < __system_drumkit_info_list.size(); ++i ) {
-		delete __system_drumkit_info_list[i];
-	}
-	__system_drumkit_info_list.clear();
-
-	for (uint i = 0; i < __user_drumkit_info_list.size(); ++i ) {
-		delete __user_drumkit_info_list[i];
-	}
-	__user_drumkit_info_list.clear();
-
-	//User drumkit list
-    QStringList usr_dks = Filesystem::usr_drumkits_list();
-    for (int i = 0; i < usr_dks.size(); ++i) {
-		QString absPath = Filesystem::usr_drumkits_dir() + "/" + usr_dks[i];
-		Drumkit *pInfo = Drumkit::load( absPath );
-		if (pInfo) {
-			__user_drumkit_info_list.push_back( pInfo );
-			QTreeWidgetItem* pDrumkitItem = new QTreeWidgetItem( __user_drumkits_item );
-			pDrumkitItem->setText( 0, pInfo->get_name() );
-			if ( QString(pInfo->get_name() ) == currentSL ){
-				pDrumkitItem->setBackgroundColor( 0, QColor( 50, 50, 50) );
-			}
-			InstrumentList *pInstrList = pInfo->get_instruments();
-			for ( uint nInstr = 0; nInstr < pInstrList->size(); ++nInstr ) {
-				Instrument *pInstr = pInstrList->get( nInstr );
-				QTreeWidgetItem* pInstrumentItem = new QTreeWidgetItem( pDrumkitItem );
-				pInstrumentItem->setText( 0, QString( "[%1] " ).arg( nInstr + 1 ) + pInstr->get_name() );
-				pInstrumentItem->setToolTip( 0, pInstr->get_name() );
-			}
+	// the drumkits and patterns are listed from the index, without reading their files
+	SoundLibraryDatabase* db = SoundLibraryDatabase::get_instance();
+	db->update();
+
+	const std::vector<SoundLibraryIndex::DrumkitInfo>& drumkits = db->getIndex()->drumkits();
+	for (uint i = 0; i < drumkits.size(); ++i) {
+		const SoundLibraryIndex::DrumkitInfo& info = drumkits[i];
+		QTreeWidgetItem* pDrumkitItem = new QTreeWidgetItem( info.user ? __user_drumkits_item : __system_drumkits_item );
+		pDrumkitItem->setText( 0, info.name );
+		if ( info.name == currentSL ){
+			pDrumkitItem->setBackgroundColor( 0, QColor( 50, 50, 50) );
 		}
-	}
-
-	//System drumkit list
-	QStringList sys_dks = Filesystem::sys_drumkits_list();
-	for (int i = 0; i < sys_dks.size(); ++i) {
-		QString absPath = Filesystem::sys_drumkits_dir() + "/" + sys_dks[i];
-		Drumkit *pInfo = Drumkit::load( absPath );
-		if (pInfo) {
-			__system_drumkit_info_list.push_back( pInfo );
-			QTreeWidgetItem* pDrumkitItem = new QTreeWidgetItem( __system_drumkits_item );
-			pDrumkitItem->setText( 0, pInfo->get_name() );
-			if ( QString( pInfo->get_name() ) == currentSL ){
-				pDrumkitItem->setBackgroundColor( 0, QColor( 50, 50, 50) );
-			}
-			InstrumentList *pInstrList = pInfo->get_instruments();
-			for ( uint nInstr = 0; nInstr < pInstrList->size(); ++nInstr ) {
-				Instrument *pInstr = pInstrList->get( nInstr );
-				QTreeWidgetItem* pInstrumentItem = new QTreeWidgetItem( pDrumkitItem );
-				pInstrumentItem->setText( 0, QString( "[%1] " ).arg( nInstr + 1 ) + pInstr->get_name() );
-				pInstrumentItem->setToolTip( 0, pInstr->get_name() );
-			}
+		for ( int nInstr = 0; nInstr < info.instruments.size(); ++nInstr ) {
+			QTreeWidgetItem* pInstrumentItem = new QTreeWidgetItem( pDrumkitItem );
+			pInstrumentItem->setText( 0, QString( "[%1] " ).arg( nInstr + 1 ) + info.instruments[ nInstr ] );
+			pInstrumentItem->setToolTip( 0, info.instruments[ nInstr ] );
 		}
 	}
 	
@@ -238,24 +192,14 @@ void SoundLibraryPanel::updateDrumkitList()
 
 
 	//Pattern list
-	std::vector<QString> patternDirList = mng.getPatternDirList();
-	if ( patternDirList.size() > 0 ) {
+	soundLibraryInfoVector* allPatternDirList = db->getAllPatterns();
+	if ( allPatternDirList->size() > 0 ) {
 		
 		__pattern_item = new QTreeWidgetItem( __sound_library_tree );
 		__pattern_item->setText( 0, trUtf8( "Patterns" ) );
 		__pattern_item->setToolTip( 0, "double click to expand the list" );
 		__sound_library_tree->setItemExpanded( __pattern_item, __expand_pattern_list );
-			
-		//this is to push the mng.getPatternList in all patterns/drumkit dirs
-		for (uint i = 0; i < patternDirList.size(); ++i) {
-			QString absPath =  patternDirList[i];
-			mng.getPatternList( absPath );
-		}
-		
-		//this is the second step to push the mng.funktion
-		//SoundLibraryDatabase::create_instance();
-		SoundLibraryDatabase* db = SoundLibraryDatabase::get_instance();
-		soundLibraryInfoVector* allPatternDirList = db->getAllPatterns();
+
 		QStringList allCategoryNameList = db->getAllPatternCategories();
 
 		//now sorting via category
@@ -274,7 +218,7 @@ void SoundLibraryPanel::updateDrumkitList()
 					QTreeWidgetItem* pPatternItem = new QTreeWidgetItem( pCategoryItem );
 					pPatternItem->setText( 0, (*mapIterator)->getName());
 					pPatternItem->setText( 1, (*mapIterator)->getPath() );
-					pPatternItem->setToolTip( 0, mng.getDrumkitNameForPattern( (*mapIterator)->getPath() ));
+					pPatternItem->setToolTip( 0, (*mapIterator)->getDrumkitName() );
 					INFOLOG( "Path" +  (*mapIterator)->getPath() );
 				}
 			}
@@ -465,27 +409,18 @@ void SoundLibraryPanel::on_drumkitLoadAction()
 
 	QString sDrumkitName = __sound_library_tree->currentItem()->text(0);
 
-	Drumkit *drumkitInfo = NULL;
-
-	// find the drumkit in the list
-	for ( uint i = 0; i < __system_drumkit_info_list.size(); i++ ) {
-		Drumkit *pInfo = __system_drumkit_info_list[i];
-		if ( pInfo->get_name() == sDrumkitName ) {
-			drumkitInfo = pInfo;
-			break;
-		}
-	}
-	for ( uint i = 0; i < __user_drumkit_info_list.size(); i++ ) {
-		Drumkit *pInfo = __user_drumkit_info_list[i];
-		if ( pInfo->get_name() == sDrumkitName ) {
-			drumkitInfo = pInfo;
-			break;
-		}
-	}
-	assert( drumkitInfo );
+	// find the drumkit in the index
+	const SoundLibraryIndex::DrumkitInfo *pInfo = SoundLibraryDatabase::get_instance()->getIndex()->find_drumkit( sDrumkitName );
+	assert( pInfo );
 
 	QApplication::setOverrideCursor(Qt::WaitCursor);
 
+	Drumkit *drumkitInfo = Drumkit::load( pInfo->path, false, false );
+	if ( drumkitInfo == NULL ) {
+		QApplication::restoreOverrideCursor();
+		QMessageBox::warning( this, "Hydrogen", QString( "Unable to load the drumkit %1" ).arg( sDrumkitName ) );
+		return;
+	}
 	Hydrogen::get_instance()->loadDrumkit( drumkitInfo );
 	Hydrogen::get_instance()->getSong()->set_is_modified( true );
 	HydrogenApp::get_instance()->onDrumkitLoad( drumkitInfo->get_name() );
@@ -493,6 +428,7 @@ void SoundLibraryPanel::on_drumkitLoadAction()
 	HydrogenApp::get_instance()->getPatternEditorPanel()->updatePianorollEditor();
 
 	InstrumentEditorPanel::get_instance()->notifyOfDrumkitChange();
+	delete drumkitInfo;
 
 	__sound_library_tree->currentItem()->setBackgroundColor ( 0, QColor( 50, 50, 50) );
 	QApplication::restoreOverrideCursor();
@@ -587,57 +523,29 @@ void SoundLibraryPanel::on_drumkitExportAction()
 void SoundLibraryPanel::on_drumkitPropertiesAction()
 {
 	QString sDrumkitName = __sound_library_tree->currentItem()->text(0);
+	const SoundLibraryIndex* index = SoundLibraryDatabase::get_instance()->getIndex();
 
-	Drumkit *drumkitInfo = NULL;
-
-	// find the drumkit in the list
-	for ( uint i = 0; i < __system_drumkit_info_list.size(); i++ ) {
-		Drumkit *pInfo = __system_drumkit_info_list[i];
-		if ( pInfo->get_name() == sDrumkitName ) {
-			drumkitInfo = pInfo;
-			break;
-		}
-	}
-	for ( uint i = 0; i < __user_drumkit_info_list.size(); i++ ) {
-		Drumkit*pInfo = __user_drumkit_info_list[i];
-		if ( pInfo->get_name() == sDrumkitName ) {
-			drumkitInfo = pInfo;
-			break;
-		}
-	}
-
-	assert( drumkitInfo );
+	// find the drumkit in the index
+	const SoundLibraryIndex::DrumkitInfo *pInfo = index->find_drumkit( sDrumkitName );
+	assert( pInfo );
 
 	QString sPreDrumkitName = Hydrogen::get_instance()->getCurrentDrumkitname();
+	const SoundLibraryIndex::DrumkitInfo *pPreInfo = index->find_drumkit( sPreDrumkitName );
 
-	Drumkit *preDrumkitInfo = NULL;
-	
-
-	// find the drumkit in the list
-	for ( uint i = 0; i < __system_drumkit_info_list.size(); i++ ) {
-		Drumkit *prInfo = __system_drumkit_info_list[i];
-		if ( prInfo->get_name() == sPreDrumkitName ) {
-			preDrumkitInfo = prInfo;
-			break;
-		}
-	}
-	for ( uint i = 0; i < __user_drumkit_info_list.size(); i++ ) {
-		Drumkit *prInfo = __user_drumkit_info_list[i];
-		if ( prInfo->get_name() == sPreDrumkitName ) {
-			preDrumkitInfo = prInfo;
-			break;
-		}
-	}
-
-	if ( preDrumkitInfo == NULL ){
+	if ( pPreInfo == NULL ){
 		QMessageBox::warning( this, "Hydrogen", QString( "The current loaded song missing his soundlibrary.\nPlease load a existing soundlibrary first") );
 		return;
 	}
-	assert( preDrumkitInfo );
-	
-	//open the soundlibrary save dialog 
-	SoundLibraryPropertiesDialog dialog( this , drumkitInfo, preDrumkitInfo );
-	dialog.exec();
+
+	Drumkit *drumkitInfo = Drumkit::load( pInfo->path, false, false );
+	Drumkit *preDrumkitInfo = Drumkit::load( pPreInfo->path, false, false );
+	if ( drumkitInfo && preDrumkitInfo ) {
+		//open the soundlibrary save dialog 
+		SoundLibraryPropertiesDialog dialog( this , drumkitInfo, preDrumkitInfo );
+		dialog.exec();
+	}
+	delete drumkitInfo;
+	delete preDrumkitInfo;
 }
 
 
@@ -0,0 +1,94 @@
+#include "audio_clock_test.h"
+
+#include <hydrogen/helpers/clock.h>
+
+#include <cmath>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( AudioClockTest );
+
+using namespace H2Core;
+
+static const unsigned nBufferSize = 256;
+static const unsigned nSampleRate = 44100;
+static const double fActualRate = 44100 * 1.0002;	/* soundcard crystal off by 200ppm */
+static const double fWakeupJitter = 0.0002;			/* seconds */
+
+static unsigned nSeed;
+
+/* uniform in [-1, 1] */
+static double nextRandom()
+{
+	nSeed = nSeed * 1103515245 + 12345;
+	return ( ( nSeed >> 16 ) & 0x7fff ) / 16383.5 - 1.0;
+}
+
+/* start time of cycle nCycle, as seen by the audio thread */
+static double wakeupTime( int nCycle )
+{
+	return 100.0 + nCycle * nBufferSize / fActualRate + fWakeupJitter * nextRandom();
+}
+
+void AudioClockTest::testMonotonic()
+{
+	double fPrevious = Clock::now();
+	for ( int i = 0; i < 1000; ++i ) {
+		double fNow = Clock::now();
+		CPPUNIT_ASSERT( fNow >= fPrevious );
+		fPrevious = fNow;
+	}
+}
+
+void AudioClockTest::testJitterFilter()
+{
+	AudioClock clock;
+	nSeed = 1;
+
+	const int nCycles = 4000;
+	double fMaxError = 0.0;
+	for ( int nCycle = 0; nCycle < nCycles; ++nCycle ) {
+		clock.cycleStart( wakeupTime( nCycle ), nBufferSize, nSampleRate );
+		clock.cycleEnd();
+
+		/* let the loop settle for a few seconds */
+		if ( nCycle > nCycles / 2 ) {
+			double fExpected = 100.0 + nCycle * nBufferSize / fActualRate;
+			double fError = fabs( clock.frameToTime( ( long long )nCycle * nBufferSize ) - fExpected );
+			fMaxError = std::max( fMaxError, fError );
+		}
+	}
+
+	CycleStats stats = clock.read();
+	___INFOLOG( QString( "DLL time error %1 ms for %2 ms of wakeup jitter, sample rate %3" )
+				.arg( fMaxError * 1000.0 ).arg( fWakeupJitter * 1000.0 ).arg( stats.fSampleRate ) );
+
+	CPPUNIT_ASSERT( fMaxError < fWakeupJitter / 3 );
+	CPPUNIT_ASSERT( fabs( stats.fSampleRate - fActualRate ) < 1.0 );
+	CPPUNIT_ASSERT( stats.fJitter > 0.0f );
+	CPPUNIT_ASSERT( stats.fJitter <= fWakeupJitter * 2 * 1000.0 + 0.01 );
+
+	/* frames and time of the audio clock agree */
+	double fTime = clock.frameToTime( ( long long )( nCycles - 1 ) * nBufferSize + 100 );
+	CPPUNIT_ASSERT( fabs( clock.timeToFrame( fTime ) - ( ( nCycles - 1 ) * nBufferSize + 100 ) ) < 1e-3 );
+	CPPUNIT_ASSERT( fabs( clock.framesSinceCycleStart( fTime ) - 100 ) < 1e-3 );
+}
+
+void AudioClockTest::testXrun()
+{
+	AudioClock clock;
+	nSeed = 1;
+
+	for ( int nCycle = 0; nCycle < 1000; ++nCycle ) {
+		clock.cycleStart( wakeupTime( nCycle ), nBufferSize, nSampleRate );
+		clock.cycleEnd();
+	}
+
+	/* the driver stalls for a second, the loop restarts at the next cycle */
+	double fRestart = wakeupTime( 1000 ) + 1.0;
+	clock.cycleStart( fRestart, nBufferSize, nSampleRate );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( fRestart, clock.frameToTime( 1000LL * nBufferSize ), 1e-9 );
+	CPPUNIT_ASSERT( clock.framesSinceCycleStart( fRestart - 1.0 ) < 0.0 );
+
+	/* and after a buffer size change */
+	clock.cycleStart( fRestart + 0.01, 2 * nBufferSize, nSampleRate );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( fRestart + 0.01, clock.frameToTime( 1001LL * nBufferSize ), 1e-9 );
+}
@@ -0,0 +1,19 @@
+#ifndef AUDIO_CLOCK_TEST_H
+#define AUDIO_CLOCK_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class AudioClockTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( AudioClockTest );
+	CPPUNIT_TEST( testMonotonic );
+	CPPUNIT_TEST( testJitterFilter );
+	CPPUNIT_TEST( testXrun );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testMonotonic();
+	void testJitterFilter();
+	void testXrun();
+};
+
+#endif
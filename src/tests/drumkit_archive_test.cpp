@@ -0,0 +1,83 @@
+#include "drumkit_archive_test.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <hydrogen/basics/sample.h>
+#include <hydrogen/basics/sample_pool.h>
+#include <hydrogen/helpers/drumkit_archive.h>
+#include <hydrogen/helpers/filesystem.h>
+
+#define BASE_DIR    "./src/tests/data"
+
+CPPUNIT_TEST_SUITE_REGISTRATION( DrumkitArchiveTest );
+
+using namespace H2Core;
+
+/* A drumkit archived then extracted gives back its files, the samples decoded from the archive are kept for the drumkit to be loaded. */
+void DrumkitArchiveTest::testRoundTrip()
+{
+#if defined(H2CORE_HAVE_ZLIB) && defined(H2CORE_HAVE_LIBARCHIVE)
+	QString root = Filesystem::tmp_dir() + "/archive";
+	QString archive = root + "/drumkit.h2drumkit";
+	QString dst_dir = root + "/extracted";
+	Filesystem::rm( root, true );
+	CPPUNIT_ASSERT( QDir().mkpath( dst_dir ) );
+
+	DrumkitArchive::Stats created;
+	CPPUNIT_ASSERT( DrumkitArchive::create( BASE_DIR"/drumkit", archive, &created ) );
+	CPPUNIT_ASSERT_EQUAL( 5, created.files );
+	CPPUNIT_ASSERT( created.archive_size > 0 );
+
+	DrumkitArchive::Stats extracted;
+	CPPUNIT_ASSERT( DrumkitArchive::extract( archive, dst_dir, &extracted ) );
+	CPPUNIT_ASSERT_EQUAL( 5, extracted.files );
+	CPPUNIT_ASSERT_EQUAL( 4, extracted.samples );
+	CPPUNIT_ASSERT_EQUAL( created.data_size, extracted.data_size );
+
+	QFileInfoList files = QDir( BASE_DIR"/drumkit" ).entryInfoList( QDir::Files );
+	for ( int i = 0; i < files.size(); i++ ) {
+		QFileInfo copy( dst_dir + "/drumkit/" + files[i].fileName() );
+		CPPUNIT_ASSERT( copy.exists() );
+		CPPUNIT_ASSERT_EQUAL( files[i].size(), copy.size() );
+	}
+	for ( int i = 0; i < files.size(); i++ ) {
+		if ( files[i].suffix() != "wav" ) continue;
+		QString copy = dst_dir + "/drumkit/" + files[i].fileName();
+		int frames, sample_rate;
+		float* data_l;
+		float* data_r;
+		// decoded while extracted, the pool has the data of the copy
+		CPPUNIT_ASSERT( SamplePool::acquire( SamplePool::file_key( copy ), frames, sample_rate, data_l, data_r ) );
+		SamplePool::release( data_l );
+		Sample* pOriginal = Sample::load( files[i].filePath() );
+		Sample* pCopy = Sample::load( copy );
+		CPPUNIT_ASSERT( pOriginal && pCopy );
+		CPPUNIT_ASSERT_EQUAL( pOriginal->get_frames(), pCopy->get_frames() );
+		CPPUNIT_ASSERT( pCopy->get_data_l() == data_l );
+		delete pOriginal;
+		delete pCopy;
+	}
+
+	Filesystem::rm( root, true );
+#endif
+}
+
+/* A sample decoded from the content of its file shares the data of the file once loaded. */
+void DrumkitArchiveTest::testLoadFromMemory()
+{
+	QFile file( BASE_DIR"/drumkit/snare.wav" );
+	CPPUNIT_ASSERT( file.open( QIODevice::ReadOnly ) );
+	QByteArray content = file.readAll();
+
+	Sample* pDecoded = Sample::load( BASE_DIR"/drumkit/snare.wav", content );
+	Sample* pLoaded = Sample::load( BASE_DIR"/drumkit/snare.wav" );
+	CPPUNIT_ASSERT( pDecoded && pLoaded );
+	CPPUNIT_ASSERT_EQUAL( pLoaded->get_frames(), pDecoded->get_frames() );
+	CPPUNIT_ASSERT( pLoaded->get_data_l() == pDecoded->get_data_l() );
+	delete pDecoded;
+	delete pLoaded;
+
+	CPPUNIT_ASSERT( Sample::load( BASE_DIR"/drumkit/missing.wav", QByteArray( "not a sample" ) ) == 0 );
+}
@@ -0,0 +1,17 @@
+#ifndef DRUMKIT_ARCHIVE_TEST_H
+#define DRUMKIT_ARCHIVE_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class DrumkitArchiveTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( DrumkitArchiveTest );
+	CPPUNIT_TEST( testRoundTrip );
+	CPPUNIT_TEST( testLoadFromMemory );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testRoundTrip();
+	void testLoadFromMemory();
+};
+
+#endif
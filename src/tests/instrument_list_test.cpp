@@ -0,0 +1,116 @@
+#include "instrument_list_test.h"
+
+#include <QElapsedTimer>
+
+#include <hydrogen/basics/instrument.h>
+#include <hydrogen/basics/instrument_list.h>
+#include <hydrogen/basics/note.h>
+#include <hydrogen/basics/pattern.h>
+#include <hydrogen/helpers/filesystem.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( InstrumentListTest );
+
+using namespace H2Core;
+
+/* The lookups follow the changes of the list and of the instruments. */
+void InstrumentListTest::testFind()
+{
+	InstrumentList* pList = new InstrumentList();
+	Instrument* pKick = new Instrument( 10, "Kick" );
+	Instrument* pSnare = new Instrument( 20, "Snare" );
+	Instrument* pHat = new Instrument( 30, "Hat" );
+	pList->add( pKick );
+	pList->add( pSnare );
+	CPPUNIT_ASSERT( pList->find( 20 ) == pSnare );
+	CPPUNIT_ASSERT( pList->find( "Kick" ) == pKick );
+	CPPUNIT_ASSERT( pList->find( 30 ) == 0 );
+
+	pList->insert( 0, pHat );
+	pList->swap( 0, 2 );
+	pList->move( 2, 0 );
+	CPPUNIT_ASSERT( pList->find( 30 ) == pHat );
+	CPPUNIT_ASSERT( pList->find( "Snare" ) == pSnare );
+	CPPUNIT_ASSERT( pList->del( pKick ) == pKick );
+	CPPUNIT_ASSERT( pList->find( 10 ) == 0 );
+	CPPUNIT_ASSERT( pList->find( "Kick" ) == 0 );
+
+	// changed on the instruments, behind the back of the list
+	pSnare->set_id( 40 );
+	pHat->set_name( "Ride" );
+	CPPUNIT_ASSERT( pList->find( 20 ) == 0 );
+	CPPUNIT_ASSERT( pList->find( 40 ) == pSnare );
+	CPPUNIT_ASSERT( pList->find( "Hat" ) == 0 );
+	CPPUNIT_ASSERT( pList->find( "Ride" ) == pHat );
+
+	// the first of the instruments sharing an id
+	pKick->set_id( 40 );
+	pList->insert( 0, pKick );
+	CPPUNIT_ASSERT( pList->find( 40 ) == pKick );
+
+	delete pList;
+}
+
+/*
+ * A pattern of a 64 instruments kit is loaded, each note looking its
+ * instrument up. The lookups are timed against the scans of the list
+ * they replace.
+ */
+void InstrumentListTest::testPatternLoadTime()
+{
+	const int nInstruments = 64;
+	const int nNotes = 20000;
+	const int nLookups = 100000;
+	QString pat_path = Filesystem::tmp_dir() + "/instruments.h2pattern";
+
+	InstrumentList* pList = new InstrumentList();
+	for ( int i = 0; i < nInstruments; i++ ) {
+		pList->add( new Instrument( i, QString( "Instrument %1" ).arg( i ) ) );
+	}
+	Pattern* pPattern = new Pattern( "instruments", "", "benchmark", nNotes );
+	for ( int i = 0; i < nNotes; i++ ) {
+		pPattern->insert_note( new Note( pList->get( ( i * 7 ) % nInstruments ), i, 0.8f, 0.5f, 0.5f, -1, 0 ) );
+	}
+	CPPUNIT_ASSERT( pPattern->save_file( pat_path, true ) );
+
+	QElapsedTimer timer;
+	timer.start();
+	Pattern* pLoaded = Pattern::load_file( pat_path, pList );
+	qint64 nLoad = timer.nsecsElapsed();
+	CPPUNIT_ASSERT( pLoaded );
+	CPPUNIT_ASSERT_EQUAL( pPattern->get_notes()->size(), pLoaded->get_notes()->size() );
+	Pattern::notes_cst_it_t it0 = pPattern->get_notes()->begin();
+	Pattern::notes_cst_it_t it1 = pLoaded->get_notes()->begin();
+	for ( ; it0 != pPattern->get_notes()->end(); ++it0, ++it1 ) {
+		CPPUNIT_ASSERT( it0->second->get_instrument() == it1->second->get_instrument() );
+	}
+
+	int nFound = 0;
+	timer.start();
+	for ( int i = 0; i < nLookups; i++ ) {
+		nFound += ( pList->find( nInstruments - 1 - i % nInstruments ) != 0 );
+	}
+	qint64 nFind = timer.nsecsElapsed();
+
+	int nScanned = 0;
+	timer.start();
+	for ( int i = 0; i < nLookups; i++ ) {
+		int nId = nInstruments - 1 - i % nInstruments;
+		for ( int j = 0; j < pList->size(); j++ ) {
+			if ( pList->get( j )->get_id() == nId ) {
+				nScanned++;
+				break;
+			}
+		}
+	}
+	qint64 nScan = timer.nsecsElapsed();
+	CPPUNIT_ASSERT_EQUAL( nLookups, nFound );
+	CPPUNIT_ASSERT_EQUAL( nLookups, nScanned );
+
+	___INFOLOG( QString( "%1 notes loaded in %2 ms, %3 lookups by id in %4 ms, scans of the list %5 ms" )
+				.arg( nNotes ).arg( nLoad / 1000000.0 ).arg( nLookups )
+				.arg( nFind / 1000000.0 ).arg( nScan / 1000000.0 ) );
+
+	delete pLoaded;
+	delete pPattern;
+	delete pList;
+}
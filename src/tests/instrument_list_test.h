@@ -0,0 +1,17 @@
+#ifndef INSTRUMENT_LIST_TEST_H
+#define INSTRUMENT_LIST_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class InstrumentListTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( InstrumentListTest );
+	CPPUNIT_TEST( testFind );
+	CPPUNIT_TEST( testPatternLoadTime );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testFind();
+	void testPatternLoadTime();
+};
+
+#endif
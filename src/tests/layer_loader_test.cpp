@@ -0,0 +1,129 @@
+#include "layer_loader_test.h"
+
+#include <hydrogen/basics/instrument.h>
+#include <hydrogen/basics/instrument_component.h>
+#include <hydrogen/basics/instrument_layer.h>
+#include <hydrogen/basics/instrument_list.h>
+#include <hydrogen/basics/layer_loader.h>
+#include <hydrogen/basics/note.h>
+#include <hydrogen/basics/pattern.h>
+#include <hydrogen/basics/pattern_list.h>
+#include <hydrogen/basics/sample.h>
+#include <hydrogen/basics/song.h>
+
+#include <vector>
+
+#define BASE_DIR    "./src/tests/data"
+
+CPPUNIT_TEST_SUITE_REGISTRATION( LayerLoaderTest );
+
+using namespace H2Core;
+
+/* An instrument with a soft, a medium and a hard layer, none of them loaded. */
+static Instrument* create_instrument( int nId )
+{
+	const char* samples[] = { "hh.wav", "snare.wav", "kick.wav" };
+	Instrument* pInstr = new Instrument( nId, QString( "Instrument %1" ).arg( nId ) );
+	InstrumentComponent* pCompo = new InstrumentComponent( 0 );
+	for ( int i = 0; i < 3; i++ ) {
+		InstrumentLayer* pLayer = new InstrumentLayer( new Sample( QString( BASE_DIR"/drumkit/%1" ).arg( samples[i] ) ) );
+		pLayer->set_start_velocity( i / 3.0 );
+		pLayer->set_end_velocity( ( i + 1 ) / 3.0 );
+		pCompo->set_layer( pLayer, i );
+	}
+	pInstr->get_components()->push_back( pCompo );
+	return pInstr;
+}
+
+static bool contains( const std::vector<InstrumentLayer*>& layers, InstrumentLayer* pLayer )
+{
+	for ( unsigned i = 0; i < layers.size(); i++ ) {
+		if ( layers[i] == pLayer ) return true;
+	}
+	return false;
+}
+
+/* Only the layers the velocities of the notes fall in are needed, the humanization widens the velocities. */
+void LayerLoaderTest::testNeededLayers()
+{
+	Song* pSong = new Song( "layers", "", 120, 0.5 );
+	InstrumentList* pInstrList = new InstrumentList();
+	Instrument* pSoft = create_instrument( 0 );
+	Instrument* pHard = create_instrument( 1 );
+	Instrument* pUnused = create_instrument( 2 );
+	pInstrList->add( pSoft );
+	pInstrList->add( pHard );
+	pInstrList->add( pUnused );
+	pSong->set_instrument_list( pInstrList );
+
+	Pattern* pPattern = new Pattern( "layers", "", "", 192 );
+	for ( int i = 0; i < 16; i++ ) {
+		pPattern->insert_note( new Note( pSoft, i * 12, 0.1f + i * 0.01f, 0.5f, 0.5f, -1, 0 ) );
+		pPattern->insert_note( new Note( pHard, i * 12, 0.5f, 0.5f, 0.5f, -1, 0 ) );
+	}
+	pPattern->insert_note( new Note( pHard, 0, 1.0f, 0.5f, 0.5f, -1, 0 ) );
+	PatternList* pPatternList = new PatternList();
+	pPatternList->add( pPattern );
+	pSong->set_pattern_list( pPatternList );
+
+	std::vector<InstrumentLayer*> layers;
+	LayerLoader::needed_layers( pSong, layers );
+	CPPUNIT_ASSERT_EQUAL( 3, (int)layers.size() );
+	CPPUNIT_ASSERT( contains( layers, pSoft->get_component( 0 )->get_layer( 0 ) ) );
+	CPPUNIT_ASSERT( contains( layers, pHard->get_component( 0 )->get_layer( 1 ) ) );
+	CPPUNIT_ASSERT( contains( layers, pHard->get_component( 0 )->get_layer( 2 ) ) );
+	for ( unsigned i = 0; i < layers.size(); i++ ) {
+		CPPUNIT_ASSERT( !layers[i]->is_loaded() );
+	}
+
+	// +/- 0.25 reaches the medium layer of the soft instrument and the three of the hard one
+	pSong->set_humanize_velocity_value( 0.5 );
+	layers.clear();
+	LayerLoader::needed_layers( pSong, layers );
+	CPPUNIT_ASSERT_EQUAL( 5, (int)layers.size() );
+	CPPUNIT_ASSERT( contains( layers, pSoft->get_component( 0 )->get_layer( 1 ) ) );
+	CPPUNIT_ASSERT( !contains( layers, pSoft->get_component( 0 )->get_layer( 2 ) ) );
+	CPPUNIT_ASSERT( contains( layers, pHard->get_component( 0 )->get_layer( 0 ) ) );
+	CPPUNIT_ASSERT( !contains( layers, pUnused->get_component( 0 )->get_layer( 0 ) ) );
+
+	delete pSong;
+}
+
+/* Without a running LayerLoader, the samples are loaded right away. */
+void LayerLoaderTest::testCreateSample()
+{
+	Sample* pSample = LayerLoader::create_sample( BASE_DIR"/drumkit/kick.wav" );
+	CPPUNIT_ASSERT( pSample );
+	CPPUNIT_ASSERT( pSample->get_data_l() != 0 );
+	CPPUNIT_ASSERT( pSample->get_frames() > 0 );
+	InstrumentLayer* pLayer = new InstrumentLayer( pSample );
+	CPPUNIT_ASSERT( pLayer->is_loaded() );
+	pLayer->set_load_requested( true );
+	pLayer->set_sample( new Sample( BASE_DIR"/drumkit/kick.wav" ) );
+	CPPUNIT_ASSERT( !pLayer->is_loaded() );
+	CPPUNIT_ASSERT( !pLayer->is_load_requested() );
+	delete pSample;
+	delete pLayer;
+
+	CPPUNIT_ASSERT( LayerLoader::create_sample( BASE_DIR"/drumkit/missing.wav" ) == 0 );
+}
+
+/* The note holds a layer for each component of its instrument from its creation, the sampler never inserts one. */
+void LayerLoaderTest::testLayerSelected()
+{
+	Instrument* pInstr = create_instrument( 0 );
+	Note* pNote = new Note( pInstr, 0, 0.5f, 0.5f, 0.5f, -1, 0 );
+	CPPUNIT_ASSERT_EQUAL( -1, pNote->get_layer_selected( 0 ) );
+	pNote->set_layer_selected( 0, 1 );
+	CPPUNIT_ASSERT_EQUAL( 1, pNote->get_layer_selected( 0 ) );
+
+	Note* pCopy = new Note( pNote, 0 );
+	CPPUNIT_ASSERT_EQUAL( -1, pCopy->get_layer_selected( 0 ) );
+
+	pNote->set_layer_selected( 5, 2 );
+	CPPUNIT_ASSERT_EQUAL( -1, pNote->get_layer_selected( 5 ) );
+
+	delete pCopy;
+	delete pNote;
+	delete pInstr;
+}
@@ -0,0 +1,19 @@
+#ifndef LAYER_LOADER_TEST_H
+#define LAYER_LOADER_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class LayerLoaderTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( LayerLoaderTest );
+	CPPUNIT_TEST( testNeededLayers );
+	CPPUNIT_TEST( testCreateSample );
+	CPPUNIT_TEST( testLayerSelected );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testNeededLayers();
+	void testCreateSample();
+	void testLayerSelected();
+};
+
+#endif
@@ -0,0 +1,54 @@
+#include "lv2_fx_test.h"
+
+#include <hydrogen/config.h>
+#include <hydrogen/object.h>
+
+#if defined(H2CORE_HAVE_LADSPA) && defined(H2CORE_HAVE_LV2)
+#include <hydrogen/fx/Lv2FX.h>
+#endif
+
+#include <cmath>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( Lv2FXTest );
+
+using namespace H2Core;
+
+static const long nSampleRate = 44100;
+static const unsigned nFrames = 256;
+/* amplifier of the LV2 book, installed with the LV2 sdk, 0dB by default */
+static const char* sPluginPath = "lv2:http://lv2plug.in/plugins/eg-amp";
+
+void Lv2FXTest::testProcess()
+{
+#if defined(H2CORE_HAVE_LADSPA) && defined(H2CORE_HAVE_LV2)
+	LadspaFX* pFX = LadspaFX::load( sPluginPath, "", nSampleRate );
+	if ( pFX == NULL ) {
+		___WARNINGLOG( QString( "%1 is not installed, skipped" ).arg( sPluginPath ) );
+		return;
+	}
+	CPPUNIT_ASSERT( Lv2FX::isLv2Path( pFX->getLibraryPath() ) );
+	CPPUNIT_ASSERT_EQUAL( ( int )LadspaFX::MONO_FX, pFX->getPluginType() );
+
+	/* connected in place, as the audio engine does */
+	pFX->connectAudioPorts( pFX->m_pBuffer_L, pFX->m_pBuffer_R, pFX->m_pBuffer_L, pFX->m_pBuffer_R );
+	pFX->activate();
+
+	for ( unsigned i = 0; i < nFrames; ++i ) {
+		pFX->m_pBuffer_L[ i ] = 0.5 * sin( 2.0 * M_PI * i / 64.0 );
+	}
+	pFX->setInputActive();
+	CPPUNIT_ASSERT( pFX->processFX( nFrames ) );
+	CPPUNIT_ASSERT( pFX->isOutputActive() );
+	for ( unsigned i = 0; i < nFrames; ++i ) {
+		CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.5 * sin( 2.0 * M_PI * i / 64.0 ), pFX->m_pBuffer_L[ i ], 1e-5 );
+	}
+
+	pFX->clearBuffers( nFrames );
+	CPPUNIT_ASSERT_EQUAL( 0.0f, pFX->m_pBuffer_L[ 0 ] );
+
+	pFX->deactivate();
+	delete pFX;
+#else
+	___INFOLOG( "LV2 support not built" );
+#endif
+}
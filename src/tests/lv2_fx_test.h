@@ -0,0 +1,15 @@
+#ifndef LV2_FX_TEST_H
+#define LV2_FX_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class Lv2FXTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( Lv2FXTest );
+	CPPUNIT_TEST( testProcess );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testProcess();
+};
+
+#endif
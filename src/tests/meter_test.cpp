@@ -0,0 +1,72 @@
+#include "meter_test.h"
+
+#include <hydrogen/helpers/meter.h>
+#include <cmath>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MeterTest );
+
+using namespace H2Core;
+
+static const unsigned nSampleRate = 48000;
+static const unsigned nFrames = 512;
+
+/* feed nCycles of a sine on both channels */
+static void feed( Meter* pMeter, float fAmplitude, double fFreq, double fPhase, int nCycles )
+{
+	float buf[ nFrames ];
+	for ( int nCycle = 0; nCycle < nCycles; ++nCycle ) {
+		for ( unsigned i = 0; i < nFrames; ++i ) {
+			buf[ i ] = fAmplitude * sin( fPhase );
+			fPhase += 2.0 * M_PI * fFreq / nSampleRate;
+		}
+		pMeter->process( buf, buf, nFrames, nSampleRate );
+	}
+}
+
+void MeterTest::setUp()
+{
+	m_pMeter = new Meter();
+}
+
+void MeterTest::tearDown()
+{
+	delete m_pMeter;
+}
+
+void MeterTest::testSine()
+{
+	/* 4 seconds of a 1kHz sine at -20dBFS */
+	feed( m_pMeter, 0.1f, 1000.0, 0.0, 4 * nSampleRate / nFrames );
+	MeterValues values = m_pMeter->read();
+
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.1, values.fPeak_L, 0.001 );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.1 / sqrt( 2.0 ), values.fRms_R, 0.001 );
+	/* K-weighting is about +0.7dB at 1kHz, so two channels read -20 LUFS */
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( -20.0, values.fLufs, 0.1 );
+}
+
+void MeterTest::testTruePeak()
+{
+	/* fs/4 sine sampled at +-45 degrees: samples at 0.707, true peak at 1.0 */
+	feed( m_pMeter, 1.0f, nSampleRate / 4.0, M_PI / 4.0, 4 );
+	MeterValues values = m_pMeter->read();
+
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.7071, values.fPeak_L, 0.001 );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 1.0, values.fTruePeak_L, 0.02 );
+}
+
+void MeterTest::testPeakReset()
+{
+	feed( m_pMeter, 0.5f, 1000.0, 0.0, 4 );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.5, m_pMeter->read().fPeak_L, 0.001 );
+
+	/* the peak restarts after a read, the next cycle only sees the quiet signal */
+	feed( m_pMeter, 0.1f, 1000.0, 0.0, 4 );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.1, m_pMeter->read().fPeak_R, 0.001 );
+
+	AtomicPeak peak;
+	peak.raise( 0.5f );
+	peak.raise( 0.25f );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.5, peak.take(), 0.0 );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.0, peak.get(), 0.0 );
+}
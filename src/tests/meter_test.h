@@ -0,0 +1,29 @@
+#ifndef METER_TEST_H
+#define METER_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace H2Core {
+	class Meter;
+};
+
+class MeterTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( MeterTest );
+	CPPUNIT_TEST( testSine );
+	CPPUNIT_TEST( testTruePeak );
+	CPPUNIT_TEST( testPeakReset );
+	CPPUNIT_TEST_SUITE_END();
+
+	private:
+	H2Core::Meter* m_pMeter;
+
+	public:
+	virtual void setUp();
+	virtual void tearDown();
+
+	void testSine();
+	void testTruePeak();
+	void testPeakReset();
+};
+
+#endif
@@ -0,0 +1,153 @@
+#include "midi_action_test.h"
+
+#include <hydrogen/event_queue.h>
+#include <hydrogen/midi_action.h>
+#include <hydrogen/midi_map.h>
+
+#include <QElapsedTimer>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MidiActionTest );
+
+using namespace H2Core;
+
+static const int nMessages = 100000;
+
+/* the action types in the order handleAction() compared them to before the handler table */
+static const char* __legacy_types[] = {
+	"PLAY", "PLAY/STOP_TOGGLE", "PLAY/PAUSE_TOGGLE", "PAUSE", "STOP", "MUTE", "UNMUTE",
+	"MUTE_TOGGLE", "BEATCOUNTER", "TAP_TEMPO", "SELECT_NEXT_PATTERN",
+	"SELECT_NEXT_PATTERN_RELATIVE", "SELECT_PREV_PATTERN_RELATIVE",
+	"SELECT_NEXT_PATTERN_CC_ABSOLUT", "SELECT_NEXT_PATTERN_PROMPTLY",
+	"SELECT_AND_PLAY_PATTERN", "SELECT_INSTRUMENT", "EFFECT1_LEVEL_ABSOLUTE",
+	"EFFECT2_LEVEL_ABSOLUTE", "EFFECT3_LEVEL_ABSOLUTE", "EFFECT4_LEVEL_ABSOLUTE",
+	"MASTER_VOLUME_RELATIVE", "MASTER_VOLUME_ABSOLUTE", "STRIP_VOLUME_RELATIVE",
+	"STRIP_VOLUME_ABSOLUTE", "PAN_ABSOLUTE", "PAN_RELATIVE", "BPM_CC_RELATIVE",
+	"BPM_FINE_CC_RELATIVE", "BPM_INCR", "BPM_DECR", ">>_NEXT_BAR", "<<_PREVIOUS_BAR",
+	"PLAYLIST_SONG", "PLAYLIST_NEXT_SONG", "PLAYLIST_PREV_SONG", "RECORD_READY",
+	"RECORD/STROBE_TOGGLE", "RECORD_STROBE", "RECORD_EXIT", "TOGGLE_METRONOME",
+	"UNDO_ACTION", "REDO_ACTION", NULL
+};
+
+/*
+ * The former if/else chain of handleAction(): the type string is
+ * compared to each action name until one matches. Only the undo and
+ * redo actions, the last ones of the chain, are carried out.
+ */
+static bool legacyHandleAction( MidiAction* pAction )
+{
+	if ( pAction == NULL ) return false;
+
+	QString sActionString = pAction->getType();
+	for ( int i = 0; __legacy_types[ i ]; ++i ) {
+		if ( sActionString == __legacy_types[ i ] ) {
+			if ( sActionString == "UNDO_ACTION" ) {
+				EventQueue::get_instance()->push_event( EVENT_UNDO_REDO, 0 );
+				return true;
+			}
+			if ( sActionString == "REDO_ACTION" ) {
+				EventQueue::get_instance()->push_event( EVENT_UNDO_REDO, 1 );
+				return true;
+			}
+			return false;
+		}
+	}
+	return false;
+}
+
+void MidiActionTest::setUp()
+{
+	EventQueue::create_instance();
+	MidiMap::create_instance();
+	MidiActionManager::create_instance();
+}
+
+void MidiActionTest::tearDown()
+{
+	delete MidiActionManager::get_instance();
+	delete MidiMap::get_instance();
+}
+
+void MidiActionTest::testDispatch()
+{
+	MidiActionManager* pManager = MidiActionManager::get_instance();
+
+	MidiAction nothing( "NOTHING" );
+	CPPUNIT_ASSERT( !pManager->handleAction( &nothing ) );
+
+	MidiAction unknown( "NO_SUCH_ACTION" );
+	CPPUNIT_ASSERT( !pManager->handleAction( &unknown ) );
+	CPPUNIT_ASSERT( !pManager->handleAction( &unknown ) );
+
+	MidiAction redo( "REDO_ACTION" );
+	CPPUNIT_ASSERT_EQUAL( -1, redo.getHandlerId() );
+	CPPUNIT_ASSERT( pManager->handleAction( &redo ) );
+	CPPUNIT_ASSERT( redo.getHandlerId() > 0 );
+
+	Event ev;
+	do {
+		ev = EventQueue::get_instance()->pop_event();
+	} while ( ev.type != EVENT_NONE && ev.type != EVENT_UNDO_REDO );
+	CPPUNIT_ASSERT_EQUAL( EVENT_UNDO_REDO, ev.type );
+	CPPUNIT_ASSERT_EQUAL( 1, ev.value );
+
+	redo.setParameter2( QString( "42" ) );
+	CPPUNIT_ASSERT_EQUAL( 42, redo.getParameter2Value() );
+	CPPUNIT_ASSERT_EQUAL( QString( "42" ), redo.getParameter2() );
+	redo.setParameter2( 17 );
+	CPPUNIT_ASSERT_EQUAL( 17, redo.getParameter2Value() );
+	CPPUNIT_ASSERT_EQUAL( QString( "17" ), redo.getParameter2() );
+
+	/* text parameters are kept as they are */
+	redo.setParameter2( QString( "next" ) );
+	CPPUNIT_ASSERT_EQUAL( QString( "next" ), redo.getParameter2() );
+	CPPUNIT_ASSERT_EQUAL( 0, redo.getParameter2Value() );
+	CPPUNIT_ASSERT_EQUAL( QString(), MidiAction( "NOTHING" ).getParameter2() );
+}
+
+/*
+ * CC messages through the midi map, as done by
+ * MidiInput::handleControlChangeMessage(), compared to the former
+ * dispatch which set the value as a string and went through the
+ * if/else chain. UNDO_ACTION is near the end of the chain.
+ */
+void MidiActionTest::testCCThroughput()
+{
+	MidiActionManager* pManager = MidiActionManager::get_instance();
+	MidiMap* pMap = MidiMap::get_instance();
+	for ( int nCC = 0; nCC < 128; nCC += 2 ) {
+		pMap->registerCCEvent( nCC, new MidiAction( "UNDO_ACTION" ) );
+	}
+	EventQueue* pQueue = EventQueue::get_instance();
+
+	QElapsedTimer timer;
+	timer.start();
+	int nHandled = 0;
+	for ( int i = 0; i < nMessages; ++i ) {
+		MidiAction* pAction = pMap->getCCAction( i % 128 );
+		pAction->setParameter2( i % 127 );
+		if ( pManager->handleAction( pAction ) ) {
+			++nHandled;
+		}
+	}
+	qint64 nDispatch = timer.nsecsElapsed();
+	CPPUNIT_ASSERT_EQUAL( nMessages / 2, nHandled );
+
+	while ( pQueue->pop_event().type != EVENT_NONE ) { }
+
+	timer.start();
+	int nLegacy = 0;
+	for ( int i = 0; i < nMessages; ++i ) {
+		MidiAction* pAction = pMap->getCCAction( i % 128 );
+		pAction->setParameter2( QString::number( i % 127 ) );
+		if ( legacyHandleAction( pAction ) ) {
+			++nLegacy;
+		}
+	}
+	qint64 nChain = timer.nsecsElapsed();
+	CPPUNIT_ASSERT_EQUAL( nMessages / 2, nLegacy );
+
+	___INFOLOG( QString( "%1 CC messages: handler table %2 ns/msg, former if/else chain %3 ns/msg" )
+				.arg( nMessages )
+				.arg( nDispatch / ( double )nMessages )
+				.arg( nChain / ( double )nMessages ) );
+}
@@ -0,0 +1,19 @@
+#ifndef MIDI_ACTION_TEST_H
+#define MIDI_ACTION_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class MidiActionTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( MidiActionTest );
+	CPPUNIT_TEST( testDispatch );
+	CPPUNIT_TEST( testCCThroughput );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void setUp();
+	void tearDown();
+	void testDispatch();
+	void testCCThroughput();
+};
+
+#endif
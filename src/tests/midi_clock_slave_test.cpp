@@ -0,0 +1,162 @@
+#include "midi_clock_slave_test.h"
+
+#include <hydrogen/IO/MidiClockSlave.h>
+
+#include <algorithm>
+#include <cmath>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MidiClockSlaveTest );
+
+using namespace H2Core;
+
+static double bpm( const MidiClockSlave::State& state )
+{
+	return 60.0 / ( MidiClockSlave::PULSES_PER_QUARTER * state.fPeriod );
+}
+
+static unsigned nSeed;
+
+/*
+ * Receive time of a pulse sent at fTime through a USB MIDI interface:
+ * the events are polled every millisecond and the wakeup of the MIDI
+ * thread adds up to half a millisecond. This is a model of the interface,
+ * not a capture of one; the noise is pseudo random, restarted by each test.
+ */
+static double jitter( double fTime )
+{
+	nSeed = nSeed * 1103515245 + 12345;
+	double fNoise = ( ( nSeed >> 16 ) & 0x7FFF ) / 32768.0 * 0.0005;
+	return ceil( fTime * 1000.0 ) / 1000.0 + fNoise;
+}
+
+/* send the pulses of nSeconds at fBpm from fTime, return the time after them */
+static double play( MidiClockSlave& slave, double fTime, double fBpm, double nSeconds,
+					double* pMaxDeviation = 0 )
+{
+	double fPeriod = 60.0 / ( MidiClockSlave::PULSES_PER_QUARTER * fBpm );
+	int nPulses = ( int )( nSeconds / fPeriod );
+	for ( int i = 0; i < nPulses; ++i ) {
+		slave.clock( jitter( fTime ) );
+		fTime += fPeriod;
+		if ( pMaxDeviation ) {
+			*pMaxDeviation = std::max( *pMaxDeviation, fabs( bpm( slave.read() ) - fBpm ) );
+		}
+	}
+	return fTime;
+}
+
+void MidiClockSlaveTest::setUp()
+{
+	nSeed = 12345;
+}
+
+void MidiClockSlaveTest::testJitter()
+{
+	MidiClockSlave slave;
+	slave.start();
+
+	/* the loop locks within a few seconds */
+	double fTime = play( slave, 100.0, 120.0, 5.0 );
+	MidiClockSlave::State state = slave.read();
+	CPPUNIT_ASSERT( state.bRunning );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 120.0, bpm( state ), 0.1 );
+
+	/* the tempo of a single interval is off by up to 9bpm, the filtered one is stable */
+	double fMaxDeviation = 0.0;
+	fTime = play( slave, fTime, 120.0, 60.0, &fMaxDeviation );
+	CPPUNIT_ASSERT( fMaxDeviation < 0.1 );
+
+	/* the extrapolated position is within a tenth of a pulse */
+	state = slave.read();
+	double fPeriod = 60.0 / ( MidiClockSlave::PULSES_PER_QUARTER * 120.0 );
+	double fPosition = MidiClockSlave::position( state, fTime - fPeriod / 2 );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( state.fPosition + 0.5, fPosition, 0.1 );
+}
+
+void MidiClockSlaveTest::testTempoChange()
+{
+	MidiClockSlave slave;
+	slave.start();
+
+	double fTime = play( slave, 100.0, 120.0, 10.0 );
+
+	/* a step of 20bpm is followed without restarting the loop */
+	double fPosition = slave.read().fPosition;
+	fTime = play( slave, fTime, 140.0, 4.0 );
+	MidiClockSlave::State state = slave.read();
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 140.0, bpm( state ), 0.5 );
+	CPPUNIT_ASSERT_EQUAL( fPosition + ( int )( 4.0 * 140.0 * 24 / 60.0 ), state.fPosition );
+
+	double fMaxDeviation = 0.0;
+	play( slave, fTime, 140.0, 30.0, &fMaxDeviation );
+	CPPUNIT_ASSERT( fMaxDeviation < 0.1 );
+}
+
+void MidiClockSlaveTest::testSongPosition()
+{
+	MidiClockSlave slave;
+	slave.start();
+	double fTime = play( slave, 100.0, 120.0, 1.0 );
+	CPPUNIT_ASSERT_EQUAL( 47.0, slave.read().fPosition );
+
+	/* pulses without start are not counted */
+	slave.stop();
+	fTime = play( slave, fTime, 120.0, 1.0 );
+	CPPUNIT_ASSERT( !slave.read().bRunning );
+
+	/* continue from the fifth beat, the first pulse is the position */
+	slave.songPosition( 16 );
+	slave.cont();
+	CPPUNIT_ASSERT( !slave.read().bRunning );
+	slave.clock( jitter( fTime ) );
+	fTime += 60.0 / ( MidiClockSlave::PULSES_PER_QUARTER * 120.0 );
+	MidiClockSlave::State state = slave.read();
+	CPPUNIT_ASSERT( state.bRunning );
+	CPPUNIT_ASSERT_EQUAL( 96.0, state.fPosition );
+
+	/* start from the beginning */
+	slave.start();
+	slave.clock( jitter( fTime ) );
+	CPPUNIT_ASSERT_EQUAL( 0.0, slave.read().fPosition );
+
+	/* the position is not extrapolated further than the next pulse */
+	state = slave.read();
+	CPPUNIT_ASSERT_EQUAL( 1.0, MidiClockSlave::position( state, state.fTime + 1.0 ) );
+}
+
+/* send the eight quarter frames of the time code h:m:s:f at 25fps */
+static double quarterFrames( MidiClockSlave& slave, double fTime, int h, int m, int s, int f )
+{
+	int pieces[ 8 ] = { f & 0xF, f >> 4, s & 0xF, s >> 4, m & 0xF, m >> 4, h & 0xF, ( h >> 4 ) | ( 1 << 1 ) };
+	for ( int nPiece = 0; nPiece < 8; ++nPiece ) {
+		slave.quarterFrame( ( nPiece << 4 ) | pieces[ nPiece ], jitter( fTime ) );
+		fTime += 1.0 / 100.0;
+	}
+	return fTime;
+}
+
+void MidiClockSlaveTest::testTimecode()
+{
+	MidiClockSlave slave;
+
+	/* located at 01:02:03:04 */
+	slave.fullFrame( 1, 2, 3, 4, 1 );
+	CPPUNIT_ASSERT( !slave.read().bRunning );
+
+	/* play 20 seconds, the quarter frames are counted from the full frame */
+	double fTime = 100.0;
+	long long nFrame = ( ( 1 * 60 + 2 ) * 60 + 3 ) * 25 + 4;
+	for ( int i = 0; i < 250; ++i, nFrame += 2 ) {
+		fTime = quarterFrames( slave, fTime, nFrame / 90000, nFrame / 1500 % 60, nFrame / 25 % 60, nFrame % 25 );
+		CPPUNIT_ASSERT_EQUAL( ( double )( nFrame * 4 + 7 ), slave.read().fPosition );
+	}
+	MidiClockSlave::State state = slave.read();
+	CPPUNIT_ASSERT( state.bRunning );
+	CPPUNIT_ASSERT_EQUAL( 25, state.nFps );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 0.01, state.fPeriod, 0.00001 );
+
+	/* the master jumps without a full frame, the decoded time code wins */
+	nFrame = 25 * 60;
+	fTime = quarterFrames( slave, fTime, 0, 1, 0, 0 );
+	CPPUNIT_ASSERT_EQUAL( ( double )( nFrame * 4 + 7 ), slave.read().fPosition );
+}
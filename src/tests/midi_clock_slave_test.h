@@ -0,0 +1,22 @@
+#ifndef MIDI_CLOCK_SLAVE_TEST_H
+#define MIDI_CLOCK_SLAVE_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class MidiClockSlaveTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( MidiClockSlaveTest );
+	CPPUNIT_TEST( testJitter );
+	CPPUNIT_TEST( testTempoChange );
+	CPPUNIT_TEST( testSongPosition );
+	CPPUNIT_TEST( testTimecode );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	virtual void setUp();
+	void testJitter();
+	void testTempoChange();
+	void testSongPosition();
+	void testTimecode();
+};
+
+#endif
@@ -0,0 +1,168 @@
+#include "midi_clock_test.h"
+
+#include <hydrogen/IO/MidiOutput.h>
+#include <hydrogen/IO/MidiClockGenerator.h>
+
+#include <cmath>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MidiClockTest );
+
+using namespace H2Core;
+
+static const unsigned nBufferSize = 256;
+static const unsigned nSampleRate = 48000;
+static const int nResolution = 48;
+static const float fTickSize = 500.0;		/* 48000Hz, 120bpm, 48 ticks per beat */
+
+struct Message {
+	std::vector<unsigned char> data;
+	long long nFrame;			/* transport frame of the message */
+};
+
+/* records the system messages with their frame */
+class RecordingMidiOutput : public MidiOutput
+{
+	H2_OBJECT
+public:
+	std::vector<Message> messages;
+	long long nCycleFrame;
+
+	RecordingMidiOutput() : Object( __class_name ), MidiOutput( __class_name ), nCycleFrame( 0 ) { }
+
+	virtual void handleQueueNote( Note*, unsigned ) { }
+	virtual void handleQueueNoteOff( int, int, int, unsigned ) { }
+	virtual void handleQueueAllNoteOff() { }
+	virtual void handleQueueSystemMessage( const unsigned char* pData, unsigned nLength, unsigned nFrameOffset ) {
+		CPPUNIT_ASSERT( nFrameOffset < nBufferSize );
+		Message msg;
+		msg.data.assign( pData, pData + nLength );
+		msg.nFrame = nCycleFrame + nFrameOffset;
+		messages.push_back( msg );
+	}
+
+	/* frames of the messages with status nStatus */
+	std::vector<long long> frames( unsigned char nStatus ) const {
+		std::vector<long long> result;
+		for ( size_t i = 0; i < messages.size(); ++i ) {
+			if ( messages[i].data[0] == nStatus ) {
+				result.push_back( messages[i].nFrame );
+			}
+		}
+		return result;
+	}
+};
+
+const char* RecordingMidiOutput::__class_name = "RecordingMidiOutput";
+
+/* run nCycles cycles from nFrame, return the position after them */
+static long long run( MidiClockGenerator& generator, RecordingMidiOutput& out,
+					  long long nFrame, float fTicks, int nCycles )
+{
+	for ( int i = 0; i < nCycles; ++i ) {
+		out.nCycleFrame = nFrame;
+		generator.process( &out, true, nFrame, fTicks, nResolution, nBufferSize, nSampleRate );
+		nFrame += nBufferSize;
+	}
+	return nFrame;
+}
+
+void MidiClockTest::testClock()
+{
+	MidiClockGenerator generator;
+	RecordingMidiOutput out;
+	generator.setClockEnabled( true );
+
+	/* one second, 2 beats */
+	long long nFrame = run( generator, out, 0, fTickSize, 188 );
+	CPPUNIT_ASSERT_EQUAL( 0xFA, ( int )out.messages[0].data[0] );
+
+	/* a pulse every 2 ticks */
+	std::vector<long long> pulses = out.frames( 0xF8 );
+	CPPUNIT_ASSERT_EQUAL( ( size_t )( ( nFrame - 1 ) / 1000 + 1 ), pulses.size() );
+	for ( size_t i = 0; i < pulses.size(); ++i ) {
+		CPPUNIT_ASSERT_EQUAL( ( long long )i * 1000, pulses[i] );
+	}
+
+	/* stopped */
+	out.nCycleFrame = nFrame;
+	generator.process( &out, false, nFrame, fTickSize, nResolution, nBufferSize, nSampleRate );
+	CPPUNIT_ASSERT_EQUAL( 0xFC, ( int )out.messages.back().data[0] );
+}
+
+void MidiClockTest::testTempoChange()
+{
+	MidiClockGenerator generator;
+	RecordingMidiOutput out;
+	generator.setClockEnabled( true );
+
+	long long nFrame = run( generator, out, 0, fTickSize, 100 );
+	size_t nPulses = out.frames( 0xF8 ).size();
+
+	/* double the tempo, like audioEngine_process_checkBPMChanged() does */
+	float fNewTickSize = fTickSize / 2;
+	double fTick = ceil( nFrame / fTickSize );
+	nFrame = ( long long )( fTick * fNewTickSize );
+	run( generator, out, nFrame, fNewTickSize, 100 );
+
+	CPPUNIT_ASSERT( out.frames( 0xFC ).empty() );
+	std::vector<long long> pulses = out.frames( 0xF8 );
+	for ( size_t i = nPulses + 1; i < pulses.size(); ++i ) {
+		CPPUNIT_ASSERT_EQUAL( 500LL, pulses[i] - pulses[i - 1] );
+	}
+}
+
+void MidiClockTest::testSeek()
+{
+	MidiClockGenerator generator;
+	RecordingMidiOutput out;
+	generator.setClockEnabled( true );
+
+	run( generator, out, 0, fTickSize, 100 );
+	out.messages.clear();
+
+	/* relocate to tick 100, the slave starts on the next sixteenth */
+	run( generator, out, 100 * 500, fTickSize, 20 );
+	CPPUNIT_ASSERT_EQUAL( 0xFC, ( int )out.messages[0].data[0] );
+	CPPUNIT_ASSERT_EQUAL( 0xF2, ( int )out.messages[1].data[0] );
+	int nBeat = out.messages[1].data[1] | ( out.messages[1].data[2] << 7 );
+	CPPUNIT_ASSERT_EQUAL( 9, nBeat );	/* tick 108 */
+	CPPUNIT_ASSERT_EQUAL( 0xFB, ( int )out.messages[2].data[0] );
+
+	std::vector<long long> pulses = out.frames( 0xF8 );
+	CPPUNIT_ASSERT_EQUAL( 108LL * 500, pulses[0] );
+}
+
+void MidiClockTest::testTimecode()
+{
+	MidiClockGenerator generator;
+	RecordingMidiOutput out;
+	generator.setTimecodeEnabled( true );
+
+	/* from 1:02:03:05 */
+	long long nStart = ( ( ( 1 * 60 + 2 ) * 60 + 3 ) * 25 + 5 ) * ( long long )nSampleRate / 25;
+	long long nFrame = run( generator, out, nStart, fTickSize, 188 );
+
+	const Message& fullFrame = out.messages[0];
+	CPPUNIT_ASSERT_EQUAL( ( size_t )10, fullFrame.data.size() );
+	CPPUNIT_ASSERT_EQUAL( 0x21, ( int )fullFrame.data[5] );	/* 25 fps, 1 hour */
+	CPPUNIT_ASSERT_EQUAL( 2, ( int )fullFrame.data[6] );
+	CPPUNIT_ASSERT_EQUAL( 3, ( int )fullFrame.data[7] );
+	CPPUNIT_ASSERT_EQUAL( 5, ( int )fullFrame.data[8] );
+
+	/* 100 quarter frames per second */
+	std::vector<long long> quarterFrames = out.frames( 0xF1 );
+	CPPUNIT_ASSERT_EQUAL( ( size_t )( ( nFrame - nStart - 1 ) / 480 + 1 ), quarterFrames.size() );
+
+	/* the eight pieces of the first sequence give the start time back */
+	int nValues[8];
+	for ( int i = 0; i < 8; ++i ) {
+		const Message& msg = out.messages[1 + i];
+		CPPUNIT_ASSERT_EQUAL( i, msg.data[1] >> 4 );
+		nValues[i] = msg.data[1] & 0xF;
+	}
+	CPPUNIT_ASSERT_EQUAL( 5, nValues[0] | ( nValues[1] << 4 ) );
+	CPPUNIT_ASSERT_EQUAL( 3, nValues[2] | ( nValues[3] << 4 ) );
+	CPPUNIT_ASSERT_EQUAL( 2, nValues[4] | ( nValues[5] << 4 ) );
+	CPPUNIT_ASSERT_EQUAL( 1, nValues[6] | ( ( nValues[7] & 1 ) << 4 ) );
+}
@@ -0,0 +1,21 @@
+#ifndef MIDI_CLOCK_TEST_H
+#define MIDI_CLOCK_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class MidiClockTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( MidiClockTest );
+	CPPUNIT_TEST( testClock );
+	CPPUNIT_TEST( testTempoChange );
+	CPPUNIT_TEST( testSeek );
+	CPPUNIT_TEST( testTimecode );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testClock();
+	void testTempoChange();
+	void testSeek();
+	void testTimecode();
+};
+
+#endif
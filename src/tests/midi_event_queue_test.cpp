@@ -0,0 +1,98 @@
+#include "midi_event_queue_test.h"
+
+#include <hydrogen/IO/MidiEventQueue.h>
+
+#include <pthread.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( MidiEventQueueTest );
+
+using namespace H2Core;
+
+static const int nMessages = 100000;
+
+static MidiMessage note( int nNote )
+{
+	MidiMessage msg;
+	msg.m_type = MidiMessage::NOTE_ON;
+	msg.m_nData1 = nNote;
+	msg.m_nData2 = 100;
+	msg.m_nChannel = 9;
+	msg.m_fTime = nNote * 0.001;
+	return msg;
+}
+
+void MidiEventQueueTest::testFull()
+{
+	MidiEventQueue queue;
+	MidiMessage msg;
+	CPPUNIT_ASSERT( !queue.pop( msg ) );
+
+	for ( int i = 0; i < MidiEventQueue::SIZE; ++i ) {
+		CPPUNIT_ASSERT( queue.push( note( i ) ) );
+	}
+	CPPUNIT_ASSERT( !queue.push( note( 0 ) ) );
+
+	/* wrap around several times */
+	for ( int i = 0; i < 5 * MidiEventQueue::SIZE; ++i ) {
+		CPPUNIT_ASSERT( queue.pop( msg ) );
+		CPPUNIT_ASSERT_EQUAL( i, msg.m_nData1 );
+		CPPUNIT_ASSERT( queue.push( note( i + MidiEventQueue::SIZE ) ) );
+	}
+
+	CPPUNIT_ASSERT( queue.pop( msg ) );
+	CPPUNIT_ASSERT_EQUAL( MidiMessage::NOTE_ON, msg.m_type );
+	CPPUNIT_ASSERT_EQUAL( 100, msg.m_nData2 );
+	CPPUNIT_ASSERT_EQUAL( 9, msg.m_nChannel );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( msg.m_nData1 * 0.001, msg.m_fTime, 1e-9 );
+}
+
+static void* producer( void* param )
+{
+	MidiEventQueue* pQueue = ( MidiEventQueue* )param;
+	for ( int i = 0; i < nMessages; ++i ) {
+		while ( !pQueue->push( note( i ) ) ) {
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+void MidiEventQueueTest::testThreads()
+{
+	/* the messages arrive once and in order */
+	MidiEventQueue queue;
+	pthread_t thread;
+	pthread_create( &thread, NULL, producer, &queue );
+
+	MidiMessage msg;
+	int nNext = 0;
+	while ( nNext < nMessages ) {
+		if ( queue.pop( msg ) ) {
+			CPPUNIT_ASSERT_EQUAL( nNext, msg.m_nData1 );
+			++nNext;
+		}
+	}
+	pthread_join( thread, NULL );
+	CPPUNIT_ASSERT( !queue.pop( msg ) );
+}
+
+void MidiEventQueueTest::testSysex()
+{
+	/* MMC stop, the data longer than SYSEX_SIZE is cut */
+	MidiEventQueue queue;
+	MidiMessage msg;
+	msg.m_type = MidiMessage::SYSEX;
+	const unsigned char stop[] = { 0xF0, 0x7F, 0x7F, 0x06, 0x01, 0xF7 };
+	msg.m_sysexData.assign( stop, stop + sizeof( stop ) );
+	CPPUNIT_ASSERT( queue.push( msg ) );
+	msg.m_sysexData.resize( MidiEventQueue::SYSEX_SIZE + 4, 0x00 );
+	CPPUNIT_ASSERT( queue.push( msg ) );
+
+	MidiMessage out;
+	CPPUNIT_ASSERT( queue.pop( out ) );
+	CPPUNIT_ASSERT_EQUAL( MidiMessage::SYSEX, out.m_type );
+	CPPUNIT_ASSERT( out.m_sysexData == std::vector<unsigned char>( stop, stop + sizeof( stop ) ) );
+	CPPUNIT_ASSERT( queue.pop( out ) );
+	CPPUNIT_ASSERT_EQUAL( ( size_t )MidiEventQueue::SYSEX_SIZE, out.m_sysexData.size() );
+	CPPUNIT_ASSERT( !queue.pop( out ) );
+}
@@ -0,0 +1,19 @@
+#ifndef MIDI_EVENT_QUEUE_TEST_H
+#define MIDI_EVENT_QUEUE_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class MidiEventQueueTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( MidiEventQueueTest );
+	CPPUNIT_TEST( testFull );
+	CPPUNIT_TEST( testThreads );
+	CPPUNIT_TEST( testSysex );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testFull();
+	void testThreads();
+	void testSysex();
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "profiler_test.h"
+
+#include <hydrogen/helpers/profiler.h>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( ProfilerTest );
+
+using namespace H2Core;
+
+/* bucket resolution is a quarter of an octave */
+static const float fTolerance = 0.2f;
+
+static bool near( float fValue, float fExpected )
+{
+	return fValue >= fExpected * ( 1.0f - fTolerance ) && fValue <= fExpected * ( 1.0f + fTolerance );
+}
+
+void ProfilerTest::testDisabled()
+{
+	Profiler profiler;
+	profiler.beginCycle();
+	double fStart = profiler.start();
+	CPPUNIT_ASSERT_EQUAL( 0.0, fStart );
+	profiler.stop( Profiler::SAMPLER, fStart );
+	profiler.endCycle( 1.0f, 4, 5.0f );
+
+	Profiler::Report report = profiler.report();
+	CPPUNIT_ASSERT_EQUAL( 0u, report.sections[ Profiler::SAMPLER ].nCount );
+	CPPUNIT_ASSERT_EQUAL( 0u, report.sections[ Profiler::CYCLE ].nCount );
+	CPPUNIT_ASSERT_EQUAL( 0, report.nVoicesMax );
+}
+
+void ProfilerTest::testPercentiles()
+{
+	Profiler profiler;
+	profiler.setEnabled( true );
+
+	/* 1 to 1000 us */
+	for ( int i = 1; i <= 1000; ++i ) {
+		profiler.beginCycle();
+		profiler.record( Profiler::VOICE, i * 1e-6 );
+		profiler.endCycle( i == 1000 ? 6.0f : 1.0f, i % 8, 5.0f );
+	}
+
+	Profiler::Report report = profiler.report();
+	const Profiler::SectionStats& voice = report.sections[ Profiler::VOICE ];
+	CPPUNIT_ASSERT_EQUAL( 1000u, voice.nCount );
+	CPPUNIT_ASSERT( near( voice.fP50, 500.0f ) );
+	CPPUNIT_ASSERT( near( voice.fP99, 990.0f ) );
+	CPPUNIT_ASSERT( voice.fP99 <= voice.fMax );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 1000.0f, voice.fMax, 0.01 );
+
+	CPPUNIT_ASSERT_EQUAL( 1000u, report.sections[ Profiler::CYCLE ].nCount );
+	CPPUNIT_ASSERT_EQUAL( 7, report.nVoicesMax );
+	CPPUNIT_ASSERT_EQUAL( 1u, report.nLateCycles );
+}
+
+void ProfilerTest::testReset()
+{
+	Profiler profiler;
+	profiler.setEnabled( true );
+	profiler.beginCycle();
+	profiler.record( Profiler::FX, 1e-3 );
+
+	profiler.reset();
+	/* applied by the audio thread */
+	CPPUNIT_ASSERT_EQUAL( 1u, profiler.report().sections[ Profiler::FX ].nCount );
+	profiler.beginCycle();
+	CPPUNIT_ASSERT_EQUAL( 0u, profiler.report().sections[ Profiler::FX ].nCount );
+}
@@ -0,0 +1,19 @@
+#ifndef PROFILER_TEST_H
+#define PROFILER_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class ProfilerTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( ProfilerTest );
+	CPPUNIT_TEST( testDisabled );
+	CPPUNIT_TEST( testPercentiles );
+	CPPUNIT_TEST( testReset );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testDisabled();
+	void testPercentiles();
+	void testReset();
+};
+
+#endif
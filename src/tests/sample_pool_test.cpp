@@ -0,0 +1,124 @@
+#include "sample_pool_test.h"
+
+#include <hydrogen/basics/sample.h>
+#include <hydrogen/basics/sample_pool.h>
+
+#define BASE_DIR    "./src/tests/data"
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SamplePoolTest );
+
+using namespace H2Core;
+
+/* The samples of a file share its data, copies included, until the last one is deleted. */
+void SamplePoolTest::testShared()
+{
+	int nEntries = SamplePool::size();
+
+	Sample* pSnare = Sample::load( BASE_DIR"/drumkit/snare.wav" );
+	Sample* pSnare2 = Sample::load( BASE_DIR"/drumkit/../drumkit/snare.wav" );
+	Sample* pKick = Sample::load( BASE_DIR"/drumkit/kick.wav" );
+	CPPUNIT_ASSERT( pSnare && pSnare2 && pKick );
+	CPPUNIT_ASSERT( pSnare->get_data_l() == pSnare2->get_data_l() );
+	CPPUNIT_ASSERT( pSnare->get_data_l() != pKick->get_data_l() );
+	CPPUNIT_ASSERT_EQUAL( nEntries + 2, SamplePool::size() );
+
+	Sample* pCopy = new Sample( pSnare );
+	CPPUNIT_ASSERT( pCopy->get_data_r() == pSnare->get_data_r() );
+	CPPUNIT_ASSERT_EQUAL( pSnare->get_frames(), pCopy->get_frames() );
+
+	Sample* pUnloaded = new Sample( BASE_DIR"/drumkit/kick.wav" );
+	pUnloaded->load();
+	CPPUNIT_ASSERT( pUnloaded->get_data_l() == pKick->get_data_l() );
+	pUnloaded->unload();
+	CPPUNIT_ASSERT( pUnloaded->get_data_l() == 0 );
+
+	delete pSnare;
+	delete pSnare2;
+	delete pKick;
+	CPPUNIT_ASSERT_EQUAL( nEntries + 2, SamplePool::size() );
+	delete pUnloaded;
+	CPPUNIT_ASSERT_EQUAL( nEntries + 1, SamplePool::size() );
+	delete pCopy;
+	CPPUNIT_ASSERT_EQUAL( nEntries, SamplePool::size() );
+}
+
+/* The edited data is shared apart from the one of the file, modified on private copies. */
+void SamplePoolTest::testEdits()
+{
+	Sample* pSample = Sample::load( BASE_DIR"/drumkit/hh.wav" );
+	CPPUNIT_ASSERT( pSample );
+	Sample::Loops loops;
+	loops.end_frame = pSample->get_frames() / 2;
+	Sample::VelocityEnvelope velocity;
+	velocity.push_back( Sample::EnvelopePoint( 0, 0 ) );
+	velocity.push_back( Sample::EnvelopePoint( 841, 45 ) );
+	Sample::Rubberband rubber;
+	Sample::PanEnvelope pan;
+
+	Sample* pEdited = Sample::load( BASE_DIR"/drumkit/hh.wav", loops, rubber, velocity, pan );
+	Sample* pEdited2 = Sample::load( BASE_DIR"/drumkit/hh.wav", loops, rubber, velocity, pan );
+	CPPUNIT_ASSERT( pEdited && pEdited2 );
+	CPPUNIT_ASSERT( pEdited->get_data_l() == pEdited2->get_data_l() );
+	CPPUNIT_ASSERT( pEdited->get_data_l() != pSample->get_data_l() );
+	CPPUNIT_ASSERT_EQUAL( loops.end_frame, pEdited2->get_frames() );
+	CPPUNIT_ASSERT( pEdited2->get_is_modified() );
+	CPPUNIT_ASSERT( pEdited2->get_loops() == loops );
+	CPPUNIT_ASSERT_EQUAL( velocity.size(), pEdited2->get_velocity_envelope()->size() );
+
+	// applied on the shared data of the file, on a copy
+	float fFirst = pSample->get_data_l()[ 0 ];
+	Sample* pCopy = new Sample( pSample );
+	pCopy->apply_velocity( velocity );
+	CPPUNIT_ASSERT( pCopy->get_data_l() != pSample->get_data_l() );
+	CPPUNIT_ASSERT_EQUAL( fFirst, pSample->get_data_l()[ 0 ] );
+
+	delete pCopy;
+	delete pEdited2;
+	delete pEdited;
+	delete pSample;
+}
+
+/* The kept data outlives its samples, the least recently kept is released first beyond the size given. */
+void SamplePoolTest::testKeep()
+{
+	int nEntries = SamplePool::size();
+	Sample::Rubberband rubber;
+	Sample::VelocityEnvelope velocity;
+	Sample::PanEnvelope pan;
+	Sample::Loops half;
+	half.end_frame = 100;
+	Sample::Loops quarter;
+	quarter.end_frame = 50;
+	Sample::Loops tenth;
+	tenth.end_frame = 10;
+	// room for the half and the quarter
+	qint64 nBytes = 150 * sizeof( float ) * 2;
+
+	Sample* pHalf = Sample::load( BASE_DIR"/drumkit/kick.wav", half, rubber, velocity, pan );
+	Sample* pQuarter = Sample::load( BASE_DIR"/drumkit/kick.wav", quarter, rubber, velocity, pan );
+	CPPUNIT_ASSERT( pHalf && pQuarter );
+	const float* pHalfData = pHalf->get_data_l();
+	SamplePool::keep( pHalf->get_data_l(), nBytes );
+	SamplePool::keep( pQuarter->get_data_l(), nBytes );
+	delete pHalf;
+	delete pQuarter;
+	CPPUNIT_ASSERT_EQUAL( nEntries + 2, SamplePool::size() );
+
+	// found again, and kept as the most recent
+	pHalf = Sample::load( BASE_DIR"/drumkit/kick.wav", half, rubber, velocity, pan );
+	CPPUNIT_ASSERT( pHalf->get_data_l() == pHalfData );
+	SamplePool::keep( pHalf->get_data_l(), nBytes );
+	delete pHalf;
+
+	// no room left for the tenth, the quarter goes
+	Sample* pTenth = Sample::load( BASE_DIR"/drumkit/kick.wav", tenth, rubber, velocity, pan );
+	SamplePool::keep( pTenth->get_data_l(), nBytes );
+	delete pTenth;
+	CPPUNIT_ASSERT_EQUAL( nEntries + 2, SamplePool::size() );
+
+	// with no room at all, only the last one kept stays
+	pQuarter = Sample::load( BASE_DIR"/drumkit/kick.wav", quarter, rubber, velocity, pan );
+	SamplePool::keep( pQuarter->get_data_l(), 0 );
+	delete pQuarter;
+	CPPUNIT_ASSERT_EQUAL( nEntries + 1, SamplePool::size() );
+}
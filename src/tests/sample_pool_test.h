@@ -0,0 +1,19 @@
+#ifndef SAMPLE_POOL_TEST_H
+#define SAMPLE_POOL_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class SamplePoolTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SamplePoolTest );
+	CPPUNIT_TEST( testShared );
+	CPPUNIT_TEST( testEdits );
+	CPPUNIT_TEST( testKeep );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testShared();
+	void testEdits();
+	void testKeep();
+};
+
+#endif
@@ -0,0 +1,305 @@
+#include "smf_test.h"
+
+#include <hydrogen/smf/SMF.h>
+#include <hydrogen/basics/song.h>
+#include <hydrogen/basics/note.h>
+#include <hydrogen/basics/pattern.h>
+#include <hydrogen/basics/pattern_list.h>
+#include <hydrogen/basics/instrument.h>
+#include <hydrogen/basics/instrument_list.h>
+#include <hydrogen/helpers/filesystem.h>
+
+#include <QElapsedTimer>
+#include <QFile>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SMFTest );
+
+using namespace H2Core;
+
+static const int DRUM_CHANNEL = 9;
+
+/* 30 minutes at 120bpm, 192 ticks per quarter note */
+static const unsigned nQuarters = 3600;
+static const unsigned nTPQN = 192;
+
+/*
+ * Dense drum part: hi-hat in 32nd notes, kick and snare on the beats,
+ * crash every 4 bars.
+ */
+static std::vector<SMFStream::Event> createEvents()
+{
+	std::vector<SMFStream::Event> events;
+	for ( unsigned nQuarter = 0; nQuarter < nQuarters; ++nQuarter ) {
+		for ( unsigned nStep = 0; nStep < 8; ++nStep ) {
+			unsigned nTicks = nQuarter * nTPQN + nStep * nTPQN / 8;
+			int nPitch = 42;
+			if ( nStep == 0 ) {
+				nPitch = nQuarter % 2 ? 38 : 36;
+			}
+			SMFStream::Event event;
+			event.nStatus = NOTE_ON + DRUM_CHANNEL;
+			event.nTicks = nTicks;
+			event.nData1 = nPitch;
+			event.nData2 = 100;
+			events.push_back( event );
+			event.nStatus = NOTE_OFF + DRUM_CHANNEL;
+			event.nTicks = nTicks + 48;
+			events.push_back( event );
+			if ( nStep == 0 && nQuarter % 16 == 0 ) {
+				event.nStatus = NOTE_ON + DRUM_CHANNEL;
+				event.nTicks = nTicks;
+				event.nData1 = 49;
+				event.nData2 = 127;
+				events.push_back( event );
+			}
+		}
+	}
+	return events;
+}
+
+
+/*
+ * The tempo track and a note track written with the SMFTrack and SMFEvent
+ * objects and with SMFStream must give the same bytes. The events are
+ * passed sorted to the SMFTrack, the bubble sort of the former
+ * SMFWriter::save() is not part of the timing.
+ */
+void SMFTest::testStreamMatchesTracks()
+{
+	std::vector<SMFStream::Event> events = createEvents();
+
+	QElapsedTimer timer;
+	timer.start();
+
+	SMFStream stream( 1, nTPQN );
+	stream.beginTrack();
+	stream.writeCopyRightNotice( "author", 0 );
+	stream.writeTrackName( "song", 0 );
+	stream.writeTempo( 120, 0 );
+	stream.writeTimeSignature( 4, 4, 24, 8, 0 );
+	stream.endTrack();
+	stream.beginTrack();
+	stream.writeEvents( events );
+	stream.endTrack();
+
+	qint64 nStream = timer.nsecsElapsed();
+	timer.start();
+
+	SMF smf;
+	SMFTrack *pTrack0 = new SMFTrack();
+	pTrack0->addEvent( new SMFCopyRightNoticeMetaEvent( "author", 0 ) );
+	pTrack0->addEvent( new SMFTrackNameMetaEvent( "song", 0 ) );
+	pTrack0->addEvent( new SMFSetTempoMetaEvent( 120, 0 ) );
+	pTrack0->addEvent( new SMFTimeSignatureMetaEvent( 4, 4, 24, 8, 0 ) );
+	smf.addTrack( pTrack0 );
+	SMFTrack *pTrack1 = new SMFTrack();
+	smf.addTrack( pTrack1 );
+	unsigned nLastTicks = 0;
+	for ( unsigned i = 0; i < events.size(); ++i ) {
+		const SMFStream::Event& event = events[ i ];
+		SMFEvent *pEvent;
+		if ( event.nStatus == NOTE_ON + DRUM_CHANNEL ) {
+			pEvent = new SMFNoteOnEvent( event.nTicks, DRUM_CHANNEL, event.nData1, event.nData2 );
+		} else {
+			pEvent = new SMFNoteOffEvent( event.nTicks, DRUM_CHANNEL, event.nData1, event.nData2 );
+		}
+		pEvent->m_nDeltaTime = event.nTicks - nLastTicks;
+		nLastTicks = event.nTicks;
+		pTrack1->addEvent( pEvent );
+	}
+	std::vector<char> buffer = smf.getBuffer();
+
+	qint64 nTracks = timer.nsecsElapsed();
+
+	CPPUNIT_ASSERT( stream.getBuffer() == buffer );
+
+	___INFOLOG( QString( "%1 events, %2 bytes: SMFStream %3 ms, SMFTrack %4 ms" )
+				.arg( events.size() )
+				.arg( buffer.size() )
+				.arg( nStream / 1e6 )
+				.arg( nTracks / 1e6 ) );
+}
+
+
+static int readWord( const QByteArray& data, int nOffset )
+{
+	return ( ( unsigned char )data[ nOffset ] << 8 ) | ( unsigned char )data[ nOffset + 1 ];
+}
+
+static long readDWord( const QByteArray& data, int nOffset )
+{
+	return ( ( long )readWord( data, nOffset ) << 16 ) | readWord( data, nOffset + 2 );
+}
+
+
+static const char* names[] = { "Kick", "Snare", "Hat", "Unused" };
+static const int pitches[] = { 36, 38, 42, 49 };
+
+/*
+ * Song with 4 instruments and, if bPatterns, a pattern of hi-hat in 32th
+ * notes with kick and snare played 4 times.
+ */
+static Song* createSong( bool bPatterns )
+{
+	Song *pSong = new Song( "song", "author", 120, 0.5 );
+
+	InstrumentList *pInstruments = new InstrumentList();
+	for ( int i = 0; i < 4; ++i ) {
+		Instrument *pInstrument = new Instrument( i, names[ i ] );
+		pInstrument->set_midi_out_note( pitches[ i ] );
+		pInstruments->add( pInstrument );
+	}
+	pSong->set_instrument_list( pInstruments );
+
+	PatternList *pPatterns = new PatternList();
+	pSong->set_pattern_list( pPatterns );
+	std::vector<PatternList*> *pColumns = new std::vector<PatternList*>;
+	pSong->set_pattern_group_vector( pColumns );
+	if ( !bPatterns ) {
+		return pSong;
+	}
+
+	Pattern *pPattern = new Pattern( "pattern", "", "", 192 );
+	for ( int nPos = 0; nPos < 192; nPos += 6 ) {
+		pPattern->insert_note( new Note( pInstruments->get( 2 ), nPos, 0.8, 0.5, 0.5, -1, 0 ) );
+	}
+	for ( int nPos = 0; nPos < 192; nPos += 48 ) {
+		pPattern->insert_note( new Note( pInstruments->get( nPos % 96 ? 1 : 0 ), nPos, 1.0, 0.5, 0.5, -1, 0 ) );
+	}
+	pPatterns->add( pPattern );
+
+	for ( int i = 0; i < 4; ++i ) {
+		PatternList *pColumn = new PatternList();
+		pColumn->add( pPattern );
+		pColumns->push_back( pColumn );
+	}
+	return pSong;
+}
+
+
+void SMFTest::testTrackPerInstrument()
+{
+	Song *pSong = createSong( true );
+
+	QString sFilename = Filesystem::tmp_dir() + "/tracks.mid";
+	SMFWriter writer;
+	writer.save( sFilename, pSong, true );
+	delete pSong;
+
+	QFile file( sFilename );
+	CPPUNIT_ASSERT( file.open( QIODevice::ReadOnly ) );
+	QByteArray data = file.readAll();
+
+	CPPUNIT_ASSERT_EQUAL( 1297377380L, readDWord( data, 0 ) );	// MThd
+	CPPUNIT_ASSERT_EQUAL( 1, readWord( data, 8 ) );
+	// tempo track and a track for each instrument with notes
+	CPPUNIT_ASSERT_EQUAL( 4, readWord( data, 10 ) );
+
+	int nOffset = 14;
+	int nNotes[ 4 ] = { 0, 0, 0, 0 };
+	for ( int nTrack = 0; nTrack < 4; ++nTrack ) {
+		CPPUNIT_ASSERT_EQUAL( 1297379947L, readDWord( data, nOffset ) );	// MTrk
+		int nEnd = nOffset + 8 + readDWord( data, nOffset + 4 );
+		CPPUNIT_ASSERT( nEnd <= data.size() );
+		CPPUNIT_ASSERT( data.mid( nEnd - 4, 4 ) == QByteArray( "\x00\xff\x2f\x00", 4 ) );
+		if ( nTrack > 0 ) {
+			// track name, then the notes of a single instrument
+			QByteArray name( names[ nTrack - 1 ] );
+			CPPUNIT_ASSERT( data.mid( nOffset + 8, 4 + name.size() )
+							== QByteArray( "\x00\xff\x03", 3 ) + char( name.size() ) + name );
+			for ( int i = nOffset + 12 + name.size(); i < nEnd - 4; i += 4 ) {
+				unsigned char nStatus = data[ i + 1 ];
+				CPPUNIT_ASSERT( nStatus == NOTE_ON + DRUM_CHANNEL || nStatus == NOTE_OFF + DRUM_CHANNEL );
+				CPPUNIT_ASSERT_EQUAL( pitches[ nTrack - 1 ], ( int )data[ i + 2 ] );
+				if ( nStatus == NOTE_ON + DRUM_CHANNEL ) {
+					++nNotes[ nTrack - 1 ];
+				}
+			}
+		}
+		nOffset = nEnd;
+	}
+	CPPUNIT_ASSERT_EQUAL( data.size(), nOffset );
+	CPPUNIT_ASSERT_EQUAL( 8, nNotes[ 0 ] );
+	CPPUNIT_ASSERT_EQUAL( 8, nNotes[ 1 ] );
+	CPPUNIT_ASSERT_EQUAL( 128, nNotes[ 2 ] );
+}
+
+
+/* An exported song imported in a song with the same instruments gives the same patterns */
+void SMFTest::testImport()
+{
+	Song *pSong = createSong( true );
+	QString sFilename = Filesystem::tmp_dir() + "/song.mid";
+	SMFWriter writer;
+	writer.save( sFilename, pSong );
+	delete pSong;
+
+	SMFReader reader;
+	CPPUNIT_ASSERT( reader.load( sFilename ) );
+	CPPUNIT_ASSERT_EQUAL( 1, reader.getFormat() );
+	CPPUNIT_ASSERT_EQUAL( 192, reader.getTPQN() );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 120.0, reader.getBPM(), 0.01 );
+	CPPUNIT_ASSERT_EQUAL( 4 * 36, ( int )reader.getNotes().size() );
+
+	pSong = createSong( false );
+	CPPUNIT_ASSERT_EQUAL( 4, reader.createPatterns( pSong, "groove" ) );
+	std::vector<PatternList*> *pColumns = pSong->get_pattern_group_vector();
+	CPPUNIT_ASSERT_EQUAL( 4, ( int )pColumns->size() );
+	// the repeated bars share a pattern
+	CPPUNIT_ASSERT_EQUAL( 1, pSong->get_pattern_list()->size() );
+	Pattern *pPattern = pSong->get_pattern_list()->get( 0 );
+	CPPUNIT_ASSERT( pPattern->get_name() == "groove 1" );
+	CPPUNIT_ASSERT_EQUAL( 192, pPattern->get_length() );
+	for ( int i = 0; i < 4; ++i ) {
+		CPPUNIT_ASSERT( ( *pColumns )[ i ]->get( 0 ) == pPattern );
+	}
+	CPPUNIT_ASSERT_EQUAL( 36, ( int )pPattern->get_notes()->size() );
+	InstrumentList *pInstruments = pSong->get_instrument_list();
+	CPPUNIT_ASSERT( pPattern->find_note( 0, -1, pInstruments->get( 0 ) ) != NULL );
+	CPPUNIT_ASSERT( pPattern->find_note( 48, -1, pInstruments->get( 1 ) ) != NULL );
+	CPPUNIT_ASSERT( pPattern->find_note( 186, -1, pInstruments->get( 2 ) ) != NULL );
+	delete pSong;
+}
+
+
+/*
+ * Format 0 file in 3/4 at 96 ticks per quarter note, with running status,
+ * note on of velocity 0 as note off and a note without an instrument.
+ */
+void SMFTest::testImportRunningStatus()
+{
+	const unsigned char data[] = {
+		'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0, 96,
+		'M', 'T', 'r', 'k', 0, 0, 0, 36,
+		0x00, 0xFF, 0x58, 0x04, 0x03, 0x02, 0x18, 0x08,		// 3/4
+		0x00, 0xFF, 0x51, 0x03, 0x09, 0x27, 0xC0,			// 100 bpm
+		0x00, 0x99, 36, 100,
+		0x00, 60, 100,										// no instrument
+		0x30, 36, 0,										// note off
+		0x81, 0x70, 38, 90,									// 3 quarters, 2nd bar
+		0x18, 38, 0,
+		0x00, 0xFF, 0x2F, 0x00
+	};
+	QString sFilename = Filesystem::tmp_dir() + "/running_status.mid";
+	QFile file( sFilename );
+	CPPUNIT_ASSERT( file.open( QIODevice::WriteOnly ) );
+	file.write( ( const char* )data, sizeof( data ) );
+	file.close();
+
+	SMFReader reader;
+	CPPUNIT_ASSERT( reader.load( sFilename ) );
+	CPPUNIT_ASSERT_EQUAL( 0, reader.getFormat() );
+	CPPUNIT_ASSERT_DOUBLES_EQUAL( 100.0, reader.getBPM(), 0.01 );
+	CPPUNIT_ASSERT_EQUAL( 3u, reader.getBeats() );
+	CPPUNIT_ASSERT_EQUAL( 4u, reader.getNote() );
+	CPPUNIT_ASSERT_EQUAL( 3, ( int )reader.getNotes().size() );
+	CPPUNIT_ASSERT_EQUAL( 288u, reader.getNotes()[ 2 ].nTicks );
+
+	Song *pSong = createSong( false );
+	CPPUNIT_ASSERT_EQUAL( 2, reader.createPatterns( pSong, "groove" ) );
+	CPPUNIT_ASSERT_EQUAL( 2, pSong->get_pattern_list()->size() );
+	Pattern *pPattern = ( *pSong->get_pattern_group_vector() )[ 1 ]->get( 0 );
+	CPPUNIT_ASSERT_EQUAL( 144, pPattern->get_length() );
+	CPPUNIT_ASSERT( pPattern->find_note( 0, -1, pSong->get_instrument_list()->get( 1 ) ) != NULL );
+	delete pSong;
+}
@@ -0,0 +1,21 @@
+#ifndef SMF_TEST_H
+#define SMF_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class SMFTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SMFTest );
+	CPPUNIT_TEST( testStreamMatchesTracks );
+	CPPUNIT_TEST( testTrackPerInstrument );
+	CPPUNIT_TEST( testImport );
+	CPPUNIT_TEST( testImportRunningStatus );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testStreamMatchesTracks();
+	void testTrackPerInstrument();
+	void testImport();
+	void testImportRunningStatus();
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "song_snapshot_test.h"
+
+#include <hydrogen/basics/song.h>
+#include <hydrogen/basics/song_snapshot.h>
+#include <hydrogen/basics/drumkit.h>
+#include <hydrogen/basics/note.h>
+#include <hydrogen/basics/pattern.h>
+#include <hydrogen/basics/pattern_list.h>
+#include <hydrogen/basics/instrument.h>
+#include <hydrogen/basics/instrument_list.h>
+#include <hydrogen/helpers/filesystem.h>
+
+#include <QDomDocument>
+#include <QElapsedTimer>
+#include <QFile>
+
+#define BASE_DIR    "./src/tests/data"
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SongSnapshotTest );
+
+using namespace H2Core;
+
+/*
+ * Song of nPatterns patterns of nNotes notes each, played in sequence,
+ * with a virtual pattern. If pDrumkit is given its instruments are used,
+ * else 4 instruments without samples.
+ */
+static Song* createSong( int nPatterns, int nNotes, Drumkit* pDrumkit )
+{
+	Song *pSong = new Song( "snapshot", "hydrogen", 133, 0.7 );
+	pSong->set_notes( "notes\nwith non ASCII \xc3\xa9" );
+	pSong->set_license( "GPL" );
+	pSong->set_loop_enabled( true );
+	pSong->set_mode( Song::SONG_MODE );
+	pSong->set_swing_factor( 0.25 );
+
+	InstrumentList *pInstruments = new InstrumentList();
+	for ( int i = 0; i < 4; ++i ) {
+		Instrument *pInstrument;
+		if ( pDrumkit ) {
+			pInstrument = new Instrument( pDrumkit->get_instruments()->get( i ) );
+			pInstrument->set_drumkit_name( pDrumkit->get_name() );
+		} else {
+			pInstrument = new Instrument( i, QString( "instrument %1" ).arg( i ) );
+		}
+		pInstrument->set_midi_out_note( 36 + i );
+		pInstrument->set_pan_l( 0.25 * i );
+		pInstruments->add( pInstrument );
+	}
+	pSong->set_instrument_list( pInstruments );
+
+	PatternList *pPatterns = new PatternList();
+	pSong->set_pattern_list( pPatterns );
+	std::vector<PatternList*> *pColumns = new std::vector<PatternList*>;
+	pSong->set_pattern_group_vector( pColumns );
+	for ( int nPattern = 0; nPattern < nPatterns; ++nPattern ) {
+		Pattern *pPattern = new Pattern( QString( "pattern %1" ).arg( nPattern ), "info", "benchmark", nNotes );
+		for ( int i = 0; i < nNotes; ++i ) {
+			Note *pNote = new Note( pInstruments->get( i % 4 ), i, ( i % 100 ) / 100.0f, 0.5f, 0.3f, i % 7 ? -1 : 12, 0.5f * ( i % 3 ) );
+			pNote->set_key_octave( ( Note::Key )( i % 12 ), ( Note::Octave )( i % 7 - 3 ) );
+			pNote->set_lead_lag( ( i % 5 ) / 10.0f );
+			pNote->set_note_off( i % 11 == 0 );
+			pPattern->insert_note( pNote );
+		}
+		pPatterns->add( pPattern );
+
+		PatternList *pColumn = new PatternList();
+		pColumn->add( pPattern );
+		pColumns->push_back( pColumn );
+	}
+	if ( nPatterns > 1 ) {
+		pPatterns->get( 0 )->virtual_patterns_add( pPatterns->get( 1 ) );
+		pPatterns->flattened_virtual_patterns_compute();
+	}
+	return pSong;
+}
+
+
+static SongSnapshot::Settings createSettings()
+{
+	SongSnapshot::Settings settings;
+	settings.bPatternModePlaysSelected = false;
+	SongSnapshot::Fx fx;
+	fx.sName = "no plugin";
+	fx.sFilename = "-";
+	settings.fx.push_back( fx );
+	fx.sName = "delay";
+	fx.sFilename = "/usr/lib/ladspa/delay.so";
+	fx.bEnabled = true;
+	fx.fVolume = 0.5;
+	fx.inputControlPorts.push_back( std::make_pair( QString( "Delay" ), 0.3f ) );
+	settings.fx.push_back( fx );
+	Timeline::HTimelineVector bpm;
+	bpm.m_htimelinebeat = 4;
+	bpm.m_htimelinebpm = 140;
+	settings.timeline.push_back( bpm );
+	Timeline::HTimelineTagVector tag;
+	tag.m_htimelinetagbeat = 8;
+	tag.m_htimelinetag = "chorus";
+	settings.timelineTags.push_back( tag );
+	return settings;
+}
+
+
+/*
+ * A decoded song gives the same snapshot again, as the XML of a song
+ * read from a snapshot is the one it was converted from.
+ */
+void SongSnapshotTest::testRoundTrip()
+{
+	Drumkit *pDrumkit = Drumkit::load( BASE_DIR"/drumkit" );
+	CPPUNIT_ASSERT( pDrumkit );
+	Song *pSong = createSong( 3, 64, pDrumkit );
+	QByteArray data = SongSnapshot::encode( pSong, createSettings() );
+
+	SongSnapshot::Settings settings;
+	Song *pLoaded = SongSnapshot::decode( data.constData(), data.size(), settings, false );
+	CPPUNIT_ASSERT( pLoaded );
+
+	CPPUNIT_ASSERT( pLoaded->__name == "snapshot" );
+	CPPUNIT_ASSERT( pLoaded->get_notes() == pSong->get_notes() );
+	CPPUNIT_ASSERT_EQUAL( 133.0f, pLoaded->__bpm );
+	CPPUNIT_ASSERT( pLoaded->get_mode() == Song::SONG_MODE );
+	CPPUNIT_ASSERT( pLoaded->is_loop_enabled() );
+	CPPUNIT_ASSERT_EQUAL( 4, pLoaded->get_instrument_list()->size() );
+	CPPUNIT_ASSERT( pLoaded->get_instrument_list()->get( 2 )->get_drumkit_name() == pDrumkit->get_name() );
+	CPPUNIT_ASSERT_EQUAL( 3, pLoaded->get_pattern_list()->size() );
+	CPPUNIT_ASSERT_EQUAL( ( size_t )3, pLoaded->get_pattern_group_vector()->size() );
+	CPPUNIT_ASSERT_EQUAL( ( size_t )1, pLoaded->get_pattern_list()->get( 0 )->get_virtual_patterns()->size() );
+	CPPUNIT_ASSERT( !settings.bPatternModePlaysSelected );
+	CPPUNIT_ASSERT_EQUAL( ( size_t )2, settings.fx.size() );
+	CPPUNIT_ASSERT( settings.fx[ 1 ].inputControlPorts[ 0 ].first == "Delay" );
+	CPPUNIT_ASSERT( settings.timelineTags[ 0 ].m_htimelinetag == "chorus" );
+
+	const Pattern::notes_t* pNotes = pSong->get_pattern_list()->get( 1 )->get_notes();
+	const Pattern::notes_t* pLoadedNotes = pLoaded->get_pattern_list()->get( 1 )->get_notes();
+	CPPUNIT_ASSERT_EQUAL( pNotes->size(), pLoadedNotes->size() );
+	Pattern::notes_cst_it_t it0 = pNotes->begin();
+	Pattern::notes_cst_it_t it1 = pLoadedNotes->begin();
+	for( ; it0!=pNotes->end(); ++it0, ++it1 ) {
+		CPPUNIT_ASSERT_EQUAL( it0->second->get_position(), it1->second->get_position() );
+		CPPUNIT_ASSERT_EQUAL( it0->second->get_velocity(), it1->second->get_velocity() );
+		CPPUNIT_ASSERT_EQUAL( it0->second->get_length(), it1->second->get_length() );
+		CPPUNIT_ASSERT( it0->second->get_instrument()->get_id() == it1->second->get_instrument()->get_id() );
+		CPPUNIT_ASSERT( it0->second->key_to_string() == it1->second->key_to_string() );
+		CPPUNIT_ASSERT( it0->second->get_note_off() == it1->second->get_note_off() );
+	}
+
+	CPPUNIT_ASSERT( SongSnapshot::encode( pLoaded, settings ) == data );
+
+	delete pLoaded;
+	delete pSong;
+	delete pDrumkit;
+}
+
+
+/* Truncated or corrupted snapshots are refused, without reading past their end. */
+void SongSnapshotTest::testCorrupted()
+{
+	Song *pSong = createSong( 2, 16, NULL );
+	QByteArray data = SongSnapshot::encode( pSong, createSettings() );
+	delete pSong;
+
+	SongSnapshot::Settings settings;
+	for ( int nSize = 0; nSize < data.size(); nSize += 7 ) {
+		QByteArray truncated = data.left( nSize );
+		CPPUNIT_ASSERT( SongSnapshot::decode( truncated.constData(), truncated.size(), settings, false ) == NULL );
+	}
+
+	QByteArray corrupted = data;
+	corrupted[ 11 ] = 0x7f;	// string table offset
+	CPPUNIT_ASSERT( SongSnapshot::decode( corrupted.constData(), corrupted.size(), settings, false ) == NULL );
+
+	QFile file( Filesystem::tmp_dir() + "/song.h2snap" );
+	CPPUNIT_ASSERT( file.open( QIODevice::WriteOnly | QIODevice::Truncate ) );
+	file.write( data );
+	file.close();
+	CPPUNIT_ASSERT( SongSnapshot::is_snapshot( file.fileName() ) );
+	CPPUNIT_ASSERT( !SongSnapshot::is_snapshot( BASE_DIR"/pattern/pat.h2pattern" ) );
+}
+
+
+/* The XML of a snapshot is the one of a .h2song, written atomically. */
+void SongSnapshotTest::testToXml()
+{
+	Song *pSong = createSong( 3, 16, NULL );
+	QByteArray data = SongSnapshot::encode( pSong, createSettings() );
+	delete pSong;
+
+	QByteArray xml = SongSnapshot::to_xml( data );
+	QString sSong = Filesystem::tmp_dir() + "/snapshot.h2song";
+	CPPUNIT_ASSERT( Filesystem::write_atomic( sSong, xml ) );
+	CPPUNIT_ASSERT( Filesystem::write_atomic( sSong, xml ) );
+	CPPUNIT_ASSERT( !Filesystem::file_exists( sSong + ".tmp", true ) );
+	CPPUNIT_ASSERT( !SongSnapshot::is_snapshot( sSong ) );
+
+	QDomDocument doc;
+	QFile file( sSong );
+	CPPUNIT_ASSERT( file.open( QIODevice::ReadOnly ) );
+	CPPUNIT_ASSERT( doc.setContent( &file ) );
+	QDomElement song = doc.documentElement();
+	CPPUNIT_ASSERT( song.tagName() == "song" );
+	CPPUNIT_ASSERT( song.firstChildElement( "notes" ).text() == "notes\nwith non ASCII \xc3\xa9" );
+	CPPUNIT_ASSERT( song.firstChildElement( "mode" ).text() == "song" );
+	CPPUNIT_ASSERT( song.firstChildElement( "patternModeMode" ).text() == "false" );
+	CPPUNIT_ASSERT_EQUAL( 4, song.firstChildElement( "instrumentList" ).elementsByTagName( "instrument" ).size() );
+	QDomElement pattern = song.firstChildElement( "patternList" ).firstChildElement( "pattern" ).nextSiblingElement();
+	CPPUNIT_ASSERT( pattern.firstChildElement( "name" ).text() == "pattern 1" );
+	QDomNodeList notes = pattern.firstChildElement( "noteList" ).elementsByTagName( "note" );
+	CPPUNIT_ASSERT_EQUAL( 16, notes.size() );
+	CPPUNIT_ASSERT( notes.at( 7 ).firstChildElement( "key" ).text() == "G-3" );
+	CPPUNIT_ASSERT( notes.at( 11 ).firstChildElement( "note_off" ).text() == "true" );
+	QDomElement virtualPattern = song.firstChildElement( "virtualPatternList" ).firstChildElement( "pattern" );
+	CPPUNIT_ASSERT( virtualPattern.firstChildElement( "virtual" ).text() == "pattern 1" );
+	CPPUNIT_ASSERT_EQUAL( 3, song.firstChildElement( "patternSequence" ).elementsByTagName( "patternID" ).size() );
+	CPPUNIT_ASSERT_EQUAL( 2, song.firstChildElement( "ladspa" ).elementsByTagName( "fx" ).size() );
+	CPPUNIT_ASSERT( song.firstChildElement( "timeLineTag" ).firstChildElement( "newTAG" ).firstChildElement( "TAG" ).text() == "chorus" );
+
+	CPPUNIT_ASSERT( SongSnapshot::to_xml( data.left( data.size() / 2 ) ).isEmpty() );
+}
+
+
+/*
+ * The notes of a large song are saved and read back as a snapshot, and
+ * timed against the XML of the same patterns written and read by Pattern.
+ * Song::save() and Song::load() need a running engine, the XML of the
+ * patterns stands for the bulk of a .h2song.
+ */
+void SongSnapshotTest::testSaveLoadTime()
+{
+	const int nPatterns = 32;
+	const int nNotes = 2000;
+	Song *pSong = createSong( nPatterns, nNotes, NULL );
+	QString sSnapshot = Filesystem::tmp_dir() + "/large.h2snap";
+
+	QElapsedTimer timer;
+	timer.start();
+	QByteArray data = SongSnapshot::encode( pSong, SongSnapshot::Settings() );
+	QFile file( sSnapshot );
+	CPPUNIT_ASSERT( file.open( QIODevice::WriteOnly | QIODevice::Truncate ) );
+	CPPUNIT_ASSERT_EQUAL( ( qint64 )data.size(), file.write( data ) );
+	file.close();
+	qint64 nSnapshotSave = timer.nsecsElapsed();
+
+	timer.start();
+	CPPUNIT_ASSERT( file.open( QIODevice::ReadOnly ) );
+	const char* pData = ( const char* )file.map( 0, file.size() );
+	CPPUNIT_ASSERT( pData );
+	SongSnapshot::Settings settings;
+	Song *pLoaded = SongSnapshot::decode( pData, file.size(), settings, false );
+	file.close();
+	qint64 nSnapshotLoad = timer.nsecsElapsed();
+	CPPUNIT_ASSERT( pLoaded );
+	CPPUNIT_ASSERT_EQUAL( ( size_t )nNotes, pLoaded->get_pattern_list()->get( nPatterns - 1 )->get_notes()->size() );
+
+	timer.start();
+	for ( int i = 0; i < nPatterns; ++i ) {
+		CPPUNIT_ASSERT( pSong->get_pattern_list()->get( i )->save_file( Filesystem::tmp_dir() + QString( "/large%1.h2pattern" ).arg( i ), true ) );
+	}
+	qint64 nXmlSave = timer.nsecsElapsed();
+
+	timer.start();
+	qint64 nXmlSize = 0;
+	for ( int i = 0; i < nPatterns; ++i ) {
+		QString sPattern = Filesystem::tmp_dir() + QString( "/large%1.h2pattern" ).arg( i );
+		Pattern *pPattern = Pattern::load_file( sPattern, pSong->get_instrument_list() );
+		CPPUNIT_ASSERT( pPattern );
+		delete pPattern;
+		nXmlSize += QFile( sPattern ).size();
+	}
+	qint64 nXmlLoad = timer.nsecsElapsed();
+
+	___INFOLOG( QString( "%1 notes: snapshot %2 bytes, save %3 ms, load %4 ms; XML %5 bytes, save %6 ms, load %7 ms" )
+				.arg( nPatterns * nNotes )
+				.arg( data.size() ).arg( nSnapshotSave / 1e6 ).arg( nSnapshotLoad / 1e6 )
+				.arg( nXmlSize ).arg( nXmlSave / 1e6 ).arg( nXmlLoad / 1e6 ) );
+
+	delete pLoaded;
+	delete pSong;
+}
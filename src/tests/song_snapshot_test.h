@@ -0,0 +1,21 @@
+#ifndef SONG_SNAPSHOT_TEST_H
+#define SONG_SNAPSHOT_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class SongSnapshotTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SongSnapshotTest );
+	CPPUNIT_TEST( testRoundTrip );
+	CPPUNIT_TEST( testCorrupted );
+	CPPUNIT_TEST( testToXml );
+	CPPUNIT_TEST( testSaveLoadTime );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testRoundTrip();
+	void testCorrupted();
+	void testToXml();
+	void testSaveLoadTime();
+};
+
+#endif
@@ -0,0 +1,63 @@
+#include "sound_library_index_test.h"
+
+#include <hydrogen/helpers/filesystem.h>
+#include <hydrogen/helpers/sound_library_index.h>
+
+#define BASE_DIR    "./src/tests/data"
+
+CPPUNIT_TEST_SUITE_REGISTRATION( SoundLibraryIndexTest );
+
+using namespace H2Core;
+
+/* Only the new and modified files are parsed, the index is kept from a run to the next. */
+void SoundLibraryIndexTest::testUpdate()
+{
+	QString root = Filesystem::tmp_dir() + "/library";
+	QString index_path = root + "/sound_library.index";
+	QString sys_dir = root + "/sys";
+	QString usr_dir = root + "/usr";
+	QString patterns_dir = root + "/patterns";
+	CPPUNIT_ASSERT( Filesystem::mkdir( sys_dir ) );
+	CPPUNIT_ASSERT( Filesystem::mkdir( usr_dir + "/kit" ) );
+	CPPUNIT_ASSERT( Filesystem::mkdir( patterns_dir + "/GMkit" ) );
+	CPPUNIT_ASSERT( Filesystem::file_copy( BASE_DIR"/drumkit/drumkit.xml", usr_dir + "/kit/drumkit.xml" ) );
+	CPPUNIT_ASSERT( Filesystem::file_copy( BASE_DIR"/pattern/pat.h2pattern", patterns_dir + "/GMkit/pat.h2pattern" ) );
+	CPPUNIT_ASSERT( Filesystem::write_to_file( patterns_dir + "/legacy.h2pattern",
+				"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<drumkit_pattern>"
+				"<pattern_for_drumkit>H2 test DK</pattern_for_drumkit><author>me</author><license>GPL</license>"
+				"<pattern><pattern_name>legacy</pattern_name><category>fills</category><size>192</size><noteList/></pattern>"
+				"</drumkit_pattern>" ) );
+
+	SoundLibraryIndex index( index_path, sys_dir, usr_dir, patterns_dir );
+	CPPUNIT_ASSERT_EQUAL( 3, index.update() );
+	CPPUNIT_ASSERT_EQUAL( 0, index.update() );
+	CPPUNIT_ASSERT_EQUAL( ( size_t )1, index.drumkits().size() );
+	const SoundLibraryIndex::DrumkitInfo* drumkit = index.find_drumkit( "H2 test DK" );
+	CPPUNIT_ASSERT( drumkit );
+	CPPUNIT_ASSERT( drumkit->user );
+	CPPUNIT_ASSERT( drumkit->license == "MIT" );
+	CPPUNIT_ASSERT_EQUAL( 4, drumkit->instruments.size() );
+	CPPUNIT_ASSERT( drumkit->instruments[0] == "Crash" );
+
+	CPPUNIT_ASSERT_EQUAL( ( size_t )2, index.patterns().size() );
+	CPPUNIT_ASSERT( index.patterns()[0].drumkit == "GMkit" );
+	const SoundLibraryIndex::PatternInfo* pattern = index.find_pattern( patterns_dir + "/legacy.h2pattern" );
+	CPPUNIT_ASSERT( pattern );
+	CPPUNIT_ASSERT( pattern->name == "legacy" );
+	CPPUNIT_ASSERT( pattern->author == "me" );
+	CPPUNIT_ASSERT( index.pattern_categories() == QStringList() << "unknown" << "fills" );
+
+	// read back from the file, a modified pattern is parsed again and a removed drumkit dropped
+	CPPUNIT_ASSERT( Filesystem::write_to_file( patterns_dir + "/legacy.h2pattern",
+				"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<drumkit_pattern>"
+				"<pattern><pattern_name>renamed</pattern_name><category>fills</category><size>192</size><noteList/></pattern>"
+				"</drumkit_pattern>" ) );
+	CPPUNIT_ASSERT( Filesystem::rm( usr_dir + "/kit", true ) );
+	SoundLibraryIndex index2( index_path, sys_dir, usr_dir, patterns_dir );
+	CPPUNIT_ASSERT_EQUAL( 1, index2.update() );
+	CPPUNIT_ASSERT( index2.drumkits().empty() );
+	CPPUNIT_ASSERT( index2.find_pattern( patterns_dir + "/legacy.h2pattern" )->name == "renamed" );
+	CPPUNIT_ASSERT( index2.find_pattern( patterns_dir + "/GMkit/pat.h2pattern" )->name == "1" );
+
+	Filesystem::rm( root, true );
+}
@@ -0,0 +1,15 @@
+#ifndef SOUND_LIBRARY_INDEX_TEST_H
+#define SOUND_LIBRARY_INDEX_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class SoundLibraryIndexTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( SoundLibraryIndexTest );
+	CPPUNIT_TEST( testUpdate );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testUpdate();
+};
+
+#endif
@@ -0,0 +1,305 @@
+#include "timed_note_test.h"
+
+#include <hydrogen/hydrogen.h>
+#include <hydrogen/Preferences.h>
+#include <hydrogen/IO/FakeDriver.h>
+#include <hydrogen/IO/TimedNoteQueue.h>
+#include <hydrogen/basics/drumkit_component.h>
+#include <hydrogen/basics/instrument.h>
+#include <hydrogen/basics/instrument_component.h>
+#include <hydrogen/basics/instrument_layer.h>
+#include <hydrogen/basics/instrument_list.h>
+#include <hydrogen/basics/note.h>
+#include <hydrogen/basics/sample.h>
+#include <hydrogen/helpers/clock.h>
+
+#include <cmath>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TimedNoteTest );
+
+using namespace H2Core;
+
+static const unsigned nBufferSize = 256;
+static const int nCycles = 2000;
+static const float fTickSize = 459.375;		/* 44100Hz, 120bpm, 48 ticks per beat */
+
+/*
+ * Trigger latency of the MIDI notes, in frames of the driver clock,
+ * measured on the output of the engine: the notes are posted like the
+ * MIDI drivers do and played by an instrument with an impulse sample.
+ */
+struct Latency {
+	long nMin;
+	long nMax;
+	long long nSum;
+	int nCount;
+
+	Latency() : nMin( 0 ), nMax( 0 ), nSum( 0 ), nCount( 0 ) { }
+
+	void add( long nLatency ) {
+		if ( nCount == 0 || nLatency < nMin ) nMin = nLatency;
+		if ( nCount == 0 || nLatency > nMax ) nMax = nLatency;
+		nSum += nLatency;
+		++nCount;
+	}
+	QString toString() const {
+		return QString( "%1 notes, latency %2 frames, jitter %3 frames" )
+			.arg( nCount ).arg( nCount ? nSum / ( double )nCount : 0.0 ).arg( nMax - nMin );
+	}
+};
+
+static Hydrogen* pHydrogen;
+static FakeDriver* pFakeDriver;
+static Song* pSong;
+static unsigned nSeed;
+static std::vector<uint32_t> eventFrames;
+static std::vector<uint32_t> onsetFrames;
+
+static unsigned nextRandom()
+{
+	nSeed = nSeed * 1103515245 + 12345;
+	return ( nSeed >> 16 ) & 0x7fff;
+}
+
+/* one instrument playing fFirst on the first frame of its sample and fRest after */
+static void startEngine( float fFirst, float fRest )
+{
+	Preferences::create_instance();
+	Preferences* pPref = Preferences::get_instance();
+	pPref->m_sAudioDriver = "Fake";
+	pPref->m_sMidiDriver = "";
+	pPref->m_nBufferSize = nBufferSize;
+	pPref->m_bUseMetronome = false;
+	pPref->__playselectedinstrument = false;
+	pPref->setRecordEvents( false );
+
+	Hydrogen::create_instance();
+	pHydrogen = Hydrogen::get_instance();
+	pFakeDriver = dynamic_cast<FakeDriver*>( pHydrogen->getAudioOutput() );
+	CPPUNIT_ASSERT( pFakeDriver != NULL );
+
+	pSong = Song::get_default_song();
+	pSong->get_components()->push_back( new DrumkitComponent( 0, "Main" ) );
+	float* pData_L = new float[ 4 * nBufferSize ];
+	float* pData_R = new float[ 4 * nBufferSize ];
+	for ( unsigned i = 0; i < 4 * nBufferSize; ++i ) {
+		pData_L[ i ] = pData_R[ i ] = i == 0 ? fFirst : fRest;
+	}
+	InstrumentComponent* pCompo = new InstrumentComponent( 0 );
+	pCompo->set_layer( new InstrumentLayer( new Sample( "test", 4 * nBufferSize, 44100, pData_L, pData_R ) ), 0 );
+	pSong->get_instrument_list()->get( 0 )->get_components()->push_back( pCompo );
+	pHydrogen->setSong( pSong );
+
+	/* the first cycle starts the audio clock and the transport */
+	CPPUNIT_ASSERT_EQUAL( 0, pFakeDriver->processCycle() );
+	CPPUNIT_ASSERT_EQUAL( ( int )STATE_PLAYING, pHydrogen->getState() );
+
+	nSeed = 1;
+	eventFrames.clear();
+	onsetFrames.clear();
+}
+
+static void stopEngine()
+{
+	delete pHydrogen;
+	delete pSong;
+}
+
+/* note on of the first instrument, as posted by MidiInput */
+static void postNote( double fTime, long long nFrame )
+{
+	TimedNoteQueue::MidiNote note;
+	note.nNote = 36;
+	note.fVelocity = 1.0;
+	note.bNoteOff = false;
+	note.nHihatOpenness = 127;
+	note.fTime = fTime;
+	note.nFrame = nFrame;
+	CPPUNIT_ASSERT( pHydrogen->postMidiNote( note ) );
+}
+
+/* run a cycle, the impulses in its output are the starts of the notes */
+static void runCycle()
+{
+	uint32_t nCycleFrame = pFakeDriver->getCycleFrameTime();
+	CPPUNIT_ASSERT_EQUAL( 0, pFakeDriver->processCycle() );
+	float* pOut_L = pFakeDriver->getOut_L();
+	for ( unsigned i = 0; i < nBufferSize; ++i ) {
+		if ( pOut_L[ i ] != 0.0f ) {
+			onsetFrames.push_back( nCycleFrame + i );
+		}
+	}
+}
+
+static Latency measureLatency()
+{
+	/* the last notes may start in the next cycles */
+	for ( int i = 0; i < 3; ++i ) {
+		runCycle();
+	}
+
+	CPPUNIT_ASSERT_EQUAL( eventFrames.size(), onsetFrames.size() );
+	Latency latency;
+	for ( unsigned i = 0; i < eventFrames.size(); ++i ) {
+		latency.add( ( long )( int32_t )( onsetFrames[ i ] - eventFrames[ i ] ) );
+	}
+	return latency;
+}
+
+void TimedNoteTest::testSameCycle()
+{
+	/*
+	 * JACK MIDI port on the client of the audio driver: the events are
+	 * read at the start of the process callback, before the engine, and
+	 * stamped with their frame in the cycle.
+	 */
+	startEngine( 1.0, 0.0 );
+	Latency quantized;
+	for ( int nCycle = 0; nCycle < nCycles; ++nCycle ) {
+		uint32_t nCycleFrame = pFakeDriver->getCycleFrameTime();
+		unsigned nOffset = 0;
+		int nEvents = nextRandom() % 4;
+		for ( int i = 0; i < nEvents; ++i ) {
+			nOffset += 1 + nextRandom() % ( nBufferSize / 3 );
+			uint32_t nFrame = nCycleFrame + nOffset;
+			postNote( Clock::now(), nFrame );
+			eventFrames.push_back( nFrame );
+
+			/* tick quantized playback: first tick of the next cycle */
+			uint32_t nNextCycle = nCycleFrame + nBufferSize;
+			quantized.add( ( long )( ceil( nNextCycle / fTickSize ) * fTickSize ) - nFrame );
+		}
+		runCycle();
+	}
+	Latency timed = measureLatency();
+	stopEngine();
+
+	___INFOLOG( QString( "frame offset: %1" ).arg( timed.toString() ) );
+	___INFOLOG( QString( "tick quantized: %1" ).arg( quantized.toString() ) );
+	CPPUNIT_ASSERT( timed.nCount > 0 );
+	CPPUNIT_ASSERT_EQUAL( 0L, timed.nMin );
+	CPPUNIT_ASSERT_EQUAL( 0L, timed.nMax );
+	CPPUNIT_ASSERT( quantized.nMax - quantized.nMin > ( long )nBufferSize / 2 );
+}
+
+void TimedNoteTest::testLateEvents()
+{
+	/*
+	 * Drivers which only know the Clock time of the events. A cycle
+	 * receives the events up to a random delay after its start, the
+	 * events after the end of the last cycle included: all the notes are
+	 * played one period after their event.
+	 */
+	startEngine( 1.0, 0.0 );
+	AudioClock* pClock = pHydrogen->getAudioClock();
+	unsigned nNext = 0;		/* offset of the next event from the start of the last cycle */
+	int nLate = 0;
+	for ( int nCycle = 0; nCycle < nCycles; ++nCycle ) {
+		uint32_t nLastCycle = pFakeDriver->getCycleFrameTime() - nBufferSize;
+		long long nClockFrame = ( long long )( pClock->timeToFrame( pClock->getCycleTime() ) + 0.5 );
+		unsigned nReceived = nBufferSize + nextRandom() % nBufferSize;
+		while ( nNext < nReceived ) {
+			/* in the middle of the frame of the event */
+			double fTime = ( pClock->frameToTime( nClockFrame + nNext ) + pClock->frameToTime( nClockFrame + nNext + 1 ) ) / 2;
+			postNote( fTime, -1 );
+			eventFrames.push_back( nLastCycle + nNext );
+			if ( nNext >= nBufferSize ) {
+				++nLate;
+			}
+			nNext += 1 + nextRandom() % ( nBufferSize / 3 );
+		}
+		runCycle();
+		nNext -= nBufferSize;
+	}
+	Latency timed = measureLatency();
+	stopEngine();
+
+	___INFOLOG( QString( "Clock time: %1, %2 after the end of their cycle" ).arg( timed.toString() ).arg( nLate ) );
+	CPPUNIT_ASSERT( nLate > 0 );
+	CPPUNIT_ASSERT_EQUAL( ( long )nBufferSize, timed.nMin );
+	CPPUNIT_ASSERT_EQUAL( ( long )nBufferSize, timed.nMax );
+}
+
+void TimedNoteTest::testFrameTimeWrap()
+{
+	TimedNoteQueue queue;
+	uint32_t nCycleFrame = 0xffffffff - 100;
+	CPPUNIT_ASSERT( queue.push( new Note( NULL, 0, 1.0, 1.0, 1.0, -1, 0 ), nCycleFrame + 50 ) );
+	CPPUNIT_ASSERT( queue.push( new Note( NULL, 1, 1.0, 1.0, 1.0, -1, 0 ), nCycleFrame + 300 ) );
+
+	unsigned nOffset;
+	Note* pNote = queue.pop( nCycleFrame, nBufferSize, nOffset );
+	CPPUNIT_ASSERT( pNote != NULL );
+	CPPUNIT_ASSERT_EQUAL( 0, pNote->get_position() );
+	CPPUNIT_ASSERT_EQUAL( 50u, nOffset );
+	delete pNote;
+	CPPUNIT_ASSERT( queue.pop( nCycleFrame, nBufferSize, nOffset ) == NULL );
+
+	nCycleFrame += nBufferSize;
+	pNote = queue.pop( nCycleFrame, nBufferSize, nOffset );
+	CPPUNIT_ASSERT( pNote != NULL );
+	CPPUNIT_ASSERT_EQUAL( 1, pNote->get_position() );
+	CPPUNIT_ASSERT_EQUAL( 44u, nOffset );
+	delete pNote;
+
+	CPPUNIT_ASSERT( queue.push( new Note( NULL, 2, 1.0, 1.0, 1.0, -1, 0 ), nCycleFrame - 2 * nBufferSize ) );
+	pNote = queue.pop( nCycleFrame, nBufferSize, nOffset );
+	CPPUNIT_ASSERT( pNote != NULL );
+	CPPUNIT_ASSERT_EQUAL( 0u, nOffset );
+	delete pNote;
+
+	CPPUNIT_ASSERT( queue.empty() );
+}
+
+void TimedNoteTest::testQueueFull()
+{
+	/* the notes are stored in place, the queue never grows */
+	TimedNoteQueue queue;
+	Note* pNote = new Note( NULL, 0, 1.0, 1.0, 1.0, -1, 0 );
+	for ( int i = 0; i < TimedNoteQueue::SIZE; ++i ) {
+		CPPUNIT_ASSERT( queue.push( new Note( NULL, i, 1.0, 1.0, 1.0, -1, 0 ), i ) );
+	}
+	CPPUNIT_ASSERT( !queue.push( pNote, 0 ) );
+
+	unsigned nOffset;
+	Note* pFirst = queue.pop( 0, nBufferSize, nOffset );
+	CPPUNIT_ASSERT( pFirst != NULL );
+	CPPUNIT_ASSERT_EQUAL( 0, pFirst->get_position() );
+	delete pFirst;
+	CPPUNIT_ASSERT( queue.push( pNote, TimedNoteQueue::SIZE ) );
+	queue.clear();
+	CPPUNIT_ASSERT( queue.empty() );
+}
+
+void TimedNoteTest::testEngineOffset()
+{
+	/* one instrument playing a constant sample from its first frame */
+	startEngine( 0.5, 0.5 );
+	float* pOut_L = pFakeDriver->getOut_L();
+	for ( unsigned i = 0; i < nBufferSize; ++i ) {
+		CPPUNIT_ASSERT_EQUAL( 0.0f, pOut_L[ i ] );
+	}
+
+	/* MIDI event between frames 100 and 101 of the last cycle */
+	AudioClock* pClock = pHydrogen->getAudioClock();
+	long long nCycleFrame = ( long long )( pClock->timeToFrame( pClock->getCycleTime() ) + 0.5 );
+	double fTime = ( pClock->frameToTime( nCycleFrame + 100 ) + pClock->frameToTime( nCycleFrame + 101 ) ) / 2;
+	postNote( fTime, -1 );
+
+	/* the note starts at the same offset in the next cycle */
+	CPPUNIT_ASSERT_EQUAL( 0, pFakeDriver->processCycle() );
+	unsigned nFirst = nBufferSize;
+	for ( unsigned i = 0; i < nBufferSize; ++i ) {
+		if ( pOut_L[ i ] != 0.0f ) {
+			nFirst = i;
+			break;
+		}
+	}
+	CPPUNIT_ASSERT_EQUAL( 100u, nFirst );
+	for ( unsigned i = nFirst; i < nBufferSize; ++i ) {
+		CPPUNIT_ASSERT( pOut_L[ i ] > 0.0f );
+	}
+
+	stopEngine();
+}
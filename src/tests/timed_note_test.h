@@ -0,0 +1,23 @@
+#ifndef TIMED_NOTE_TEST_H
+#define TIMED_NOTE_TEST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class TimedNoteTest : public CppUnit::TestCase {
+	CPPUNIT_TEST_SUITE( TimedNoteTest );
+	CPPUNIT_TEST( testSameCycle );
+	CPPUNIT_TEST( testLateEvents );
+	CPPUNIT_TEST( testFrameTimeWrap );
+	CPPUNIT_TEST( testQueueFull );
+	CPPUNIT_TEST( testEngineOffset );
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+	void testSameCycle();
+	void testLateEvents();
+	void testFrameTimeWrap();
+	void testQueueFull();
+	void testEngineOffset();
+};
+
+#endif
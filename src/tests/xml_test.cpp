@@ -2,6 +2,13 @@
 
 #include <unistd.h>
 
+#include <QDomDocument>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextCodec>
+#include <QtXmlPatterns/QXmlSchema>
+#include <QtXmlPatterns/QXmlSchemaValidator>
+
 #include <hydrogen/basics/drumkit.h>
 #include <hydrogen/basics/pattern.h>
 #include <hydrogen/basics/instrument.h>
@@ -9,8 +16,15 @@
 #include <hydrogen/basics/instrument_layer.h>
 #include <hydrogen/basics/instrument_component.h>
 #include <hydrogen/basics/sample.h>
+#include <hydrogen/basics/song.h>
+#include <hydrogen/basics/note.h>
+#include <hydrogen/basics/pattern_list.h>
+#include <hydrogen/hydrogen.h>
+#include <hydrogen/LocalFileMng.h>
+#include <hydrogen/Preferences.h>
 
 #include <hydrogen/helpers/filesystem.h>
+#include <hydrogen/helpers/xml.h>
 #define BASE_DIR    "./src/tests/data"
 
 CPPUNIT_TEST_SUITE_REGISTRATION( XmlTest );
@@ -122,3 +136,228 @@ void XmlTest::testPattern()
 	delete dk0;
 }
 
+/*
+ * The notes of the patterns of a song read the way SongReader::readSong()
+ * used to: a QDomDocument tree of the file, then a firstChildElement()
+ * search and a conversion per value. The instruments and the sequence,
+ * a few nodes only, are left out.
+ */
+static int dom_load_notes( const QString& song_path, H2Core::InstrumentList* instruments, H2Core::PatternList* patterns )
+{
+	int nNotes = 0;
+	QDomDocument doc = H2Core::LocalFileMng::openXmlDocument( song_path );
+	QDomNode patternNode = doc.firstChildElement( "song" ).firstChildElement( "patternList" ).firstChildElement( "pattern" );
+	while( !patternNode.isNull() ) {
+		QString sName = H2Core::LocalFileMng::readXmlString( patternNode, "name", "" );
+		QString sInfo = H2Core::LocalFileMng::readXmlString( patternNode, "info", "", false, false );
+		QString sCategory = H2Core::LocalFileMng::readXmlString( patternNode, "category", "", false, false );
+		int nSize = H2Core::LocalFileMng::readXmlInt( patternNode, "size", -1, false, false );
+		H2Core::Pattern* pPattern = new H2Core::Pattern( sName, sInfo, sCategory, nSize );
+
+		QDomNode noteNode = patternNode.firstChildElement( "noteList" ).firstChildElement( "note" );
+		while( !noteNode.isNull() ) {
+			int nPosition = H2Core::LocalFileMng::readXmlInt( noteNode, "position", 0 );
+			float fLeadLag = H2Core::LocalFileMng::readXmlFloat( noteNode, "leadlag", 0.0, false, false );
+			float fVelocity = H2Core::LocalFileMng::readXmlFloat( noteNode, "velocity", 0.8f );
+			float fPan_L = H2Core::LocalFileMng::readXmlFloat( noteNode, "pan_L", 0.5 );
+			float fPan_R = H2Core::LocalFileMng::readXmlFloat( noteNode, "pan_R", 0.5 );
+			int nLength = H2Core::LocalFileMng::readXmlInt( noteNode, "length", -1, true );
+			float fPitch = H2Core::LocalFileMng::readXmlFloat( noteNode, "pitch", 0.0, false, false );
+			QString sKey = H2Core::LocalFileMng::readXmlString( noteNode, "key", "C0", false, false );
+			QString sNoteOff = H2Core::LocalFileMng::readXmlString( noteNode, "note_off", "false", false, false );
+			int nInstrument = H2Core::LocalFileMng::readXmlInt( noteNode, "instrument", -1 );
+
+			H2Core::Instrument* pInstrument = instruments->find( nInstrument );
+			if( pInstrument ) {
+				H2Core::Note* pNote = new H2Core::Note( pInstrument, nPosition, fVelocity, fPan_L, fPan_R, nLength, fPitch );
+				pNote->set_key_octave( sKey );
+				pNote->set_lead_lag( fLeadLag );
+				pNote->set_note_off( sNoteOff == "true" );
+				pPattern->insert_note( pNote );
+				nNotes++;
+			}
+			noteNode = noteNode.nextSiblingElement( "note" );
+		}
+		patterns->add( pPattern );
+		patternNode = patternNode.nextSiblingElement( "pattern" );
+	}
+	return nNotes;
+}
+
+/*
+ * A large synthetic song is read back by Song::load(), which builds the
+ * notes while the file is read. It is timed against the QDomDocument
+ * path the former reader took.
+ */
+void XmlTest::testSongLoadTime()
+{
+	QString song_path = H2Core::Filesystem::tmp_dir()+"/large.h2song";
+	const int nPatterns = 50;
+	const int nPatternNotes = 2000;
+
+	// Song::load() sets the tempo, the drumkit name and the timeline of the engine
+	H2Core::Preferences::create_instance();
+	H2Core::Preferences* pPref = H2Core::Preferences::get_instance();
+	pPref->m_sAudioDriver = "Fake";
+	pPref->m_sMidiDriver = "";
+	H2Core::Hydrogen::create_instance();
+	H2Core::Hydrogen* pHydrogen = H2Core::Hydrogen::get_instance();
+
+	H2Core::Song* pSong = new H2Core::Song( "large", "hydrogen", 120, 0.5 );
+	H2Core::InstrumentList* pInstruments = new H2Core::InstrumentList();
+	for( int i=0; i<4; i++ ) {
+		pInstruments->add( new H2Core::Instrument( i, QString( "instrument %1" ).arg( i ) ) );
+	}
+	pSong->set_instrument_list( pInstruments );
+	H2Core::PatternList* pPatterns = new H2Core::PatternList();
+	pSong->set_pattern_list( pPatterns );
+	std::vector<H2Core::PatternList*>* pColumns = new std::vector<H2Core::PatternList*>;
+	pSong->set_pattern_group_vector( pColumns );
+	for( int nPattern=0; nPattern<nPatterns; nPattern++ ) {
+		H2Core::Pattern* pPattern = new H2Core::Pattern( QString( "pattern %1" ).arg( nPattern ), "", "benchmark", nPatternNotes );
+		for( int i=0; i<nPatternNotes; i++ ) {
+			H2Core::Note* pNote = new H2Core::Note( pInstruments->get( i % 4 ), i, ( i % 100 ) / 100.0f, 0.5f, 0.5f, -1, 0 );
+			pNote->set_key_octave( ( H2Core::Note::Key )( i % 12 ), H2Core::Note::P8 );
+			pPattern->insert_note( pNote );
+		}
+		pPatterns->add( pPattern );
+		H2Core::PatternList* pColumn = new H2Core::PatternList();
+		pColumn->add( pPattern );
+		pColumns->push_back( pColumn );
+	}
+	CPPUNIT_ASSERT( pSong->save( song_path ) );
+
+	QElapsedTimer timer;
+	timer.start();
+	H2Core::Song* pLoaded = H2Core::Song::load( song_path );
+	qint64 nStream = timer.nsecsElapsed();
+	CPPUNIT_ASSERT( pLoaded );
+
+	H2Core::PatternList* pDomPatterns = new H2Core::PatternList();
+	timer.start();
+	int nDomNotes = dom_load_notes( song_path, pLoaded->get_instrument_list(), pDomPatterns );
+	qint64 nDom = timer.nsecsElapsed();
+
+	CPPUNIT_ASSERT_EQUAL( nPatterns * nPatternNotes, nDomNotes );
+	CPPUNIT_ASSERT_EQUAL( nPatterns, pLoaded->get_pattern_list()->size() );
+	CPPUNIT_ASSERT_EQUAL( ( size_t )nPatterns, pLoaded->get_pattern_group_vector()->size() );
+	for( int nPattern=0; nPattern<nPatterns; nPattern++ ) {
+		const H2Core::Pattern::notes_t* pNotes = pPatterns->get( nPattern )->get_notes();
+		const H2Core::Pattern::notes_t* pLoadedNotes = pLoaded->get_pattern_list()->get( nPattern )->get_notes();
+		const H2Core::Pattern::notes_t* pDomNotes = pDomPatterns->get( nPattern )->get_notes();
+		CPPUNIT_ASSERT_EQUAL( pNotes->size(), pLoadedNotes->size() );
+		CPPUNIT_ASSERT_EQUAL( pNotes->size(), pDomNotes->size() );
+		H2Core::Pattern::notes_cst_it_t it0 = pNotes->begin();
+		H2Core::Pattern::notes_cst_it_t it1 = pLoadedNotes->begin();
+		H2Core::Pattern::notes_cst_it_t it2 = pDomNotes->begin();
+		for( ; it0!=pNotes->end(); ++it0, ++it1, ++it2 ) {
+			CPPUNIT_ASSERT_EQUAL( it0->second->get_position(), it1->second->get_position() );
+			CPPUNIT_ASSERT_DOUBLES_EQUAL( it0->second->get_velocity(), it1->second->get_velocity(), 1e-6 );
+			CPPUNIT_ASSERT( it0->second->get_instrument()->get_id()==it1->second->get_instrument()->get_id() );
+			CPPUNIT_ASSERT( it0->second->key_to_string()==it1->second->key_to_string() );
+			CPPUNIT_ASSERT( it1->second->get_instrument()==it2->second->get_instrument() );
+			CPPUNIT_ASSERT( it1->second->key_to_string()==it2->second->key_to_string() );
+		}
+	}
+
+	___INFOLOG( QString( "%1 notes: Song::load() %2 ms, QDomDocument path %3 ms" )
+				.arg( nPatterns * nPatternNotes ).arg( nStream / 1000000.0 ).arg( nDom / 1000000.0 ) );
+
+	delete pDomPatterns;
+	delete pLoaded;
+	delete pSong;
+	delete pHydrogen;
+}
+
+
+/*
+ * A file written by TinyXML has no xml declaration and escapes the bytes
+ * of the non ASCII characters, each as a character of its own: read as
+ * XML, "\xc3\xa9" would give two characters. XMLReader converts the file
+ * before reading it, in the encoding of the locale, here UTF-8.
+ */
+void XmlTest::testTinyXMLCompat()
+{
+	QString path = H2Core::Filesystem::tmp_dir()+"/tinyxml.h2pattern";
+	QFile file( path );
+	CPPUNIT_ASSERT( file.open( QIODevice::WriteOnly | QIODevice::Truncate ) );
+	file.write( "<drumkit_pattern>\n"
+				" <pattern>\n"
+				"  <name>tiny&#xC3;&#xA9;</name>\n"
+				"  <size>96</size>\n"
+				" </pattern>\n"
+				"</drumkit_pattern>\n" );
+	file.close();
+
+	QString name;
+	int size = -1;
+	QTextCodec* pLocaleCodec = QTextCodec::codecForLocale();
+	QTextCodec::setCodecForLocale( QTextCodec::codecForName( "UTF-8" ) );
+	H2Core::XMLReader reader;
+	bool bRead = reader.read( path, "drumkit_pattern" );
+	QTextCodec::setCodecForLocale( pLocaleCodec );
+	CPPUNIT_ASSERT( bRead );
+	CPPUNIT_ASSERT( reader.readNextStartElement() );
+	CPPUNIT_ASSERT( reader.name_is( "pattern" ) );
+	while( reader.readNextStartElement() ) {
+		if( reader.name_is( "name" ) ) name = reader.read_string( "" );
+		else if( reader.name_is( "size" ) ) size = reader.read_int( -1 );
+		else reader.skipCurrentElement();
+	}
+	CPPUNIT_ASSERT( !reader.hasError() );
+	CPPUNIT_ASSERT( name==QString::fromUtf8( "tiny\xc3\xa9" ) );
+	CPPUNIT_ASSERT_EQUAL( 96, size );
+}
+
+
+/*
+ * The drumkit file read like in a scan of the sound library: with the
+ * schema compiled for each file and the file read twice, as XMLDoc::read()
+ * used to do, with the cached schema, and without validation.
+ */
+void XmlTest::testDrumkitValidationTime()
+{
+	QString dk_path = BASE_DIR"/drumkit/drumkit.xml";
+	QString xsd_path = H2Core::Filesystem::drumkit_xsd();
+	const int nFiles = 50;
+	QElapsedTimer timer;
+
+	timer.start();
+	for( int i=0; i<nFiles; i++ ) {
+		QXmlSchema schema;
+		QFile xsd( xsd_path );
+		CPPUNIT_ASSERT( xsd.open( QIODevice::ReadOnly ) );
+		schema.load( &xsd, QUrl::fromLocalFile( xsd_path ) );
+		QFile file( dk_path );
+		CPPUNIT_ASSERT( file.open( QIODevice::ReadOnly ) );
+		QXmlSchemaValidator validator( schema );
+		CPPUNIT_ASSERT( validator.validate( &file, QUrl::fromLocalFile( dk_path ) ) );
+		file.seek( 0 );
+		QDomDocument doc;
+		CPPUNIT_ASSERT( doc.setContent( &file ) );
+	}
+	qint64 nCompiled = timer.nsecsElapsed();
+
+	timer.start();
+	for( int i=0; i<nFiles; i++ ) {
+		H2Core::XMLDoc doc;
+		CPPUNIT_ASSERT( doc.read( dk_path, xsd_path ) );
+	}
+	qint64 nCached = timer.nsecsElapsed();
+
+	timer.start();
+	for( int i=0; i<nFiles; i++ ) {
+		H2Core::XMLDoc doc;
+		CPPUNIT_ASSERT( doc.read( dk_path ) );
+		CPPUNIT_ASSERT( doc.check_root( "drumkit_info", "drumkit" ) );
+	}
+	qint64 nUnvalidated = timer.nsecsElapsed();
+
+	H2Core::Drumkit* dk0 = H2Core::Drumkit::load( BASE_DIR"/drumkit", false, false );
+	CPPUNIT_ASSERT( dk0!=0 );
+	CPPUNIT_ASSERT_EQUAL( 4, dk0->get_instruments()->size() );
+	delete dk0;
+
+	___INFOLOG( QString( "%1 drumkit files: schema compiled per file %2 ms, cached %3 ms, not validated %4 ms" )
+				.arg( nFiles ).arg( nCompiled / 1000000.0 ).arg( nCached / 1000000.0 ).arg( nUnvalidated / 1000000.0 ) );
+}
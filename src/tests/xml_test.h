@@ -7,11 +7,17 @@ class XmlTest : public CppUnit::TestCase {
 	CPPUNIT_TEST_SUITE(XmlTest);
 	CPPUNIT_TEST(testDrumkit);
 	CPPUNIT_TEST(testPattern);
+	CPPUNIT_TEST(testSongLoadTime);
+	CPPUNIT_TEST(testTinyXMLCompat);
+	CPPUNIT_TEST(testDrumkitValidationTime);
 	CPPUNIT_TEST_SUITE_END();
 
 	public:
 	void testDrumkit();
 	void testPattern();
+	void testSongLoadTime();
+	void testTinyXMLCompat();
+	void testDrumkitValidationTime();
 };
 
 